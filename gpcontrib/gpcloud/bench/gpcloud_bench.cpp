@@ -0,0 +1,375 @@
+// gpcloud_bench drives S3BucketReader/S3KeyReader and S3KeyWriter end-to-end against an
+// in-process S3 stand-in (S3StubServer), through the real S3InterfaceService and
+// S3RESTfulService. It reports throughput and client CPU per MB for each combination of
+// threadnum and chunksize, so that these knobs can be tuned and regressions caught.
+
+#include <getopt.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "gpreader.h"
+#include "s3bucket_reader.h"
+#include "s3key_reader.h"
+#include "s3key_writer.h"
+#include "s3log.h"
+#include "s3params.h"
+#include "s3restful_service.h"
+#include "s3stub_server.h"
+
+#define BENCH_BUCKET "bench"
+#define BENCH_BUF_SIZE (64 * 1024)
+
+bool hasHeader = false;
+
+char eolString[EOL_CHARS_MAX_LEN + 1] = "\n";  // LF by default
+
+string s3extErrorMessage;
+
+volatile bool QueryCancelPending = false;
+
+bool S3QueryIsAbortInProgress(void) {
+    return QueryCancelPending;
+}
+
+void MaskThreadSignals() {
+}
+
+void *S3Alloc(size_t size) {
+    return malloc(size);
+}
+
+void S3Free(void *p) {
+    free(p);
+}
+
+struct BenchOptions {
+    BenchOptions()
+        : numKeys(4),
+          keySize(64 * 1024 * 1024),
+          latencyUs(0),
+          bandwidth(0),
+          rounds(1),
+          doRead(true),
+          doWrite(true) {
+        threadNums.push_back(1);
+        threadNums.push_back(4);
+        threadNums.push_back(8);
+        chunkSizes.push_back(8 * 1024 * 1024);
+        chunkSizes.push_back(64 * 1024 * 1024);
+    }
+
+    vector<uint64_t> threadNums;
+    vector<uint64_t> chunkSizes;
+    uint64_t numKeys;
+    uint64_t keySize;
+    uint64_t latencyUs;
+    uint64_t bandwidth;
+    uint64_t rounds;
+    bool doRead;
+    bool doWrite;
+};
+
+struct BenchResult {
+    uint64_t bytes;
+    double seconds;
+    double cpuSeconds;
+    uint64_t requests;
+    uint64_t connections;
+    uint64_t reused;     // client side, requests on a kept-alive connection
+    double handshakeMs;  // client side, time spent connecting and in TLS handshakes
+};
+
+static uint64_t monotonicNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t processCpuNanos() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return ((uint64_t)usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000ULL +
+           ((uint64_t)usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ULL;
+}
+
+// Parse "1,4,8" or "8M,64M" into a list, accepting K/M/G suffixes.
+static vector<uint64_t> parseSizeList(const char *arg) {
+    vector<uint64_t> result;
+    stringstream ss(arg);
+    string item;
+
+    while (std::getline(ss, item, ',')) {
+        char *end = NULL;
+        uint64_t value = strtoull(item.c_str(), &end, 10);
+        switch (end != NULL ? toupper(*end) : 0) {
+            case 'G':
+                value *= 1024;
+                // fall through
+            case 'M':
+                value *= 1024;
+                // fall through
+            case 'K':
+                value *= 1024;
+                break;
+            default:
+                break;
+        }
+        if (value > 0) {
+            result.push_back(value);
+        }
+    }
+
+    return result;
+}
+
+// Build a key with newline-terminated rows, like a CSV file would look like.
+static string makeKeyData(uint64_t size, uint64_t seed) {
+    string data(size, 'x');
+    for (uint64_t i = 0; i < size; i++) {
+        data[i] = 'a' + (char)((i + seed) % 26);
+        if (i % 128 == 127) {
+            data[i] = '\n';
+        }
+    }
+    if (size > 0) {
+        data[size - 1] = '\n';
+    }
+    return data;
+}
+
+static S3Params makeParams(const S3StubServer &server, const string &prefix, uint64_t threadNum,
+                           uint64_t chunkSize) {
+    stringstream url;
+    url << "s3://127.0.0.1:" << server.getPort() << "/" << BENCH_BUCKET << "/" << prefix;
+
+    S3Params params(url.str(), false, "2", "us-east-1");
+    params.setCred("bench-access-id", "bench-secret", "");
+    params.setNumOfChunks(threadNum);
+    params.setChunkSize(chunkSize);
+    params.setLowSpeedLimit(0);
+    params.setLowSpeedTime(0);
+    params.setVerifyCert(false);
+
+    PrepareS3MemContext(params);
+
+    return params;
+}
+
+static BenchResult runRead(S3StubServer &server, const BenchOptions &opts, uint64_t threadNum,
+                           uint64_t chunkSize) {
+    S3Params params = makeParams(server, "read/", threadNum, chunkSize);
+
+    S3RESTfulService restfulService(params);
+    S3InterfaceService s3Interface(params);
+    s3Interface.setRESTfulService(&restfulService);
+
+    S3KeyReader keyReader;
+    keyReader.setS3InterfaceService(&s3Interface);
+
+    S3BucketReader bucketReader;
+    bucketReader.setS3InterfaceService(&s3Interface);
+    bucketReader.setUpstreamReader(&keyReader);
+
+    vector<char> buf(BENCH_BUF_SIZE);
+    BenchResult result = {0, 0, 0, 0, 0, 0, 0};
+
+    server.resetStats();
+    S3ConnectionStats connStart = S3RESTfulService::getConnectionStats();
+    uint64_t wallStart = monotonicNanos();
+    uint64_t cpuStart = processCpuNanos();
+
+    bucketReader.open(params);
+    uint64_t n;
+    while ((n = bucketReader.read(buf.data(), buf.size())) > 0) {
+        result.bytes += n;
+    }
+    bucketReader.close();
+
+    uint64_t cpu = processCpuNanos() - cpuStart - server.getCpuNanos();
+    result.seconds = (monotonicNanos() - wallStart) / 1e9;
+    result.cpuSeconds = cpu / 1e9;
+    result.requests = server.getRequestCount();
+    result.connections = server.getConnectionCount();
+
+    S3ConnectionStats connEnd = S3RESTfulService::getConnectionStats();
+    result.reused = connEnd.reusedConnections - connStart.reusedConnections;
+    result.handshakeMs = (connEnd.handshakeUs - connStart.handshakeUs) / 1000.0;
+
+    return result;
+}
+
+static BenchResult runWrite(S3StubServer &server, const BenchOptions &opts, uint64_t threadNum,
+                            uint64_t chunkSize) {
+    S3Params params = makeParams(server, "write/", threadNum, chunkSize);
+
+    S3RESTfulService restfulService(params);
+    S3InterfaceService s3Interface(params);
+    s3Interface.setRESTfulService(&restfulService);
+
+    string data = makeKeyData(BENCH_BUF_SIZE, 7);
+    BenchResult result = {0, 0, 0, 0, 0, 0, 0};
+
+    server.resetStats();
+    S3ConnectionStats connStart = S3RESTfulService::getConnectionStats();
+    uint64_t wallStart = monotonicNanos();
+    uint64_t cpuStart = processCpuNanos();
+
+    for (uint64_t k = 0; k < opts.numKeys; k++) {
+        stringstream key;
+        key << "write/key" << k << ".csv";
+
+        S3KeyWriter writer;
+        writer.setS3InterfaceService(&s3Interface);
+        writer.open(params.setPrefix(key.str()));
+
+        for (uint64_t written = 0; written < opts.keySize;) {
+            uint64_t len = std::min((uint64_t)data.size(), opts.keySize - written);
+            writer.write(data.data(), len);
+            written += len;
+        }
+        writer.close();
+
+        result.bytes += opts.keySize;
+    }
+
+    uint64_t cpu = processCpuNanos() - cpuStart - server.getCpuNanos();
+    result.seconds = (monotonicNanos() - wallStart) / 1e9;
+    result.cpuSeconds = cpu / 1e9;
+    result.requests = server.getRequestCount();
+    result.connections = server.getConnectionCount();
+
+    S3ConnectionStats connEnd = S3RESTfulService::getConnectionStats();
+    result.reused = connEnd.reusedConnections - connStart.reusedConnections;
+    result.handshakeMs = (connEnd.handshakeUs - connStart.handshakeUs) / 1000.0;
+
+    return result;
+}
+
+static void printResult(const char *mode, uint64_t threadNum, uint64_t chunkSize,
+                        const BenchResult &r) {
+    double mb = r.bytes / (1024.0 * 1024.0);
+    printf("%-5s %9" PRIu64 " %10" PRIu64 " %10.1f %9.3f %10.1f %12.2f %9" PRIu64 " %9" PRIu64
+           " %9" PRIu64 " %9.1f\n",
+           mode, threadNum, chunkSize / 1024, mb, r.seconds, r.seconds > 0 ? mb / r.seconds : 0,
+           mb > 0 ? r.cpuSeconds * 1000.0 / mb : 0, r.requests, r.connections, r.reused,
+           r.handshakeMs);
+    fflush(stdout);
+}
+
+static void printUsage(FILE *stream) {
+    fprintf(stream,
+            "Usage: gpcloud_bench [options]\n"
+            "  -t LIST   threadnum values to sweep, e.g. 1,4,8 (default 1,4,8)\n"
+            "  -c LIST   chunksize values to sweep, e.g. 8M,64M (default 8M,64M)\n"
+            "  -n NUM    number of keys (default 4)\n"
+            "  -s SIZE   size of each key, e.g. 64M (default 64M)\n"
+            "  -l USEC   server latency per request in microseconds (default 0)\n"
+            "  -b RATE   server bandwidth per connection in bytes/s, e.g. 100M (default "
+            "unlimited)\n"
+            "  -r NUM    rounds per setting (default 1)\n"
+            "  -m MODE   read, write or both (default both)\n"
+            "  -v        print gpcloud debug log\n"
+            "  -h        show this help\n");
+}
+
+int main(int argc, char *argv[]) {
+    BenchOptions opts;
+    int opt;
+
+    s3ext_segid = 0;
+    s3ext_segnum = 1;
+    s3ext_loglevel = EXT_ERROR;
+    s3ext_logtype = STDERR_LOG;
+
+    while ((opt = getopt(argc, argv, "t:c:n:s:l:b:r:m:vh")) != -1) {
+        switch (opt) {
+            case 't':
+                opts.threadNums = parseSizeList(optarg);
+                break;
+            case 'c':
+                opts.chunkSizes = parseSizeList(optarg);
+                break;
+            case 'n':
+                opts.numKeys = strtoull(optarg, NULL, 10);
+                break;
+            case 's':
+                opts.keySize = parseSizeList(optarg).at(0);
+                break;
+            case 'l':
+                opts.latencyUs = strtoull(optarg, NULL, 10);
+                break;
+            case 'b':
+                opts.bandwidth = parseSizeList(optarg).at(0);
+                break;
+            case 'r':
+                opts.rounds = strtoull(optarg, NULL, 10);
+                break;
+            case 'm':
+                opts.doRead = strcmp(optarg, "write") != 0;
+                opts.doWrite = strcmp(optarg, "read") != 0;
+                break;
+            case 'v':
+                s3ext_loglevel = EXT_DEBUG;
+                break;
+            case 'h':
+                printUsage(stdout);
+                exit(EXIT_SUCCESS);
+            default:
+                printUsage(stderr);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (opts.threadNums.empty() || opts.chunkSizes.empty() || opts.numKeys == 0 ||
+        opts.keySize == 0) {
+        printUsage(stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    thread_setup();
+
+    S3StubServer server;
+    server.setLatencyUs(opts.latencyUs);
+    server.setBandwidth(opts.bandwidth);
+    server.start();
+
+    for (uint64_t k = 0; k < opts.numKeys; k++) {
+        stringstream key;
+        key << "read/key" << k << ".csv";
+        server.putObject(BENCH_BUCKET, key.str(), makeKeyData(opts.keySize, k));
+    }
+
+    printf("# stub server 127.0.0.1:%u, %" PRIu64 " keys x %" PRIu64 " bytes, latency %" PRIu64
+           " us, bandwidth %" PRIu64 " B/s\n",
+           server.getPort(), opts.numKeys, opts.keySize, opts.latencyUs, opts.bandwidth);
+    printf("%-5s %9s %10s %10s %9s %10s %12s %9s %9s %9s %9s\n", "mode", "threadnum", "chunk_kb",
+           "mb", "seconds", "mb/s", "cpu_ms/mb", "requests", "conns", "reused", "hs_ms");
+
+    int ret = EXIT_SUCCESS;
+    try {
+        for (size_t t = 0; t < opts.threadNums.size(); t++) {
+            for (size_t c = 0; c < opts.chunkSizes.size(); c++) {
+                for (uint64_t r = 0; r < opts.rounds; r++) {
+                    if (opts.doRead) {
+                        BenchResult result =
+                            runRead(server, opts, opts.threadNums[t], opts.chunkSizes[c]);
+                        printResult("read", opts.threadNums[t], opts.chunkSizes[c], result);
+                    }
+                    if (opts.doWrite) {
+                        BenchResult result =
+                            runWrite(server, opts, opts.threadNums[t], opts.chunkSizes[c]);
+                        printResult("write", opts.threadNums[t], opts.chunkSizes[c], result);
+                    }
+                }
+            }
+        }
+    } catch (S3Exception &e) {
+        fprintf(stderr, "Benchmark failed: %s\n", e.getFullMessage().c_str());
+        ret = EXIT_FAILURE;
+    }
+
+    server.stop();
+    thread_cleanup();
+
+    return ret;
+}
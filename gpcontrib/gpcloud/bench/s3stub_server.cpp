@@ -0,0 +1,575 @@
+#include "s3stub_server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "s3exception.h"
+#include "s3macros.h"
+#include "s3utils.h"
+
+#define STUB_IO_SLICE (64 * 1024)
+
+static uint64_t monotonicNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t threadCpuNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static string toLower(const string& s) {
+    string r(s);
+    std::transform(r.begin(), r.end(), r.begin(), ::tolower);
+    return r;
+}
+
+static const char* reasonPhrase(int code) {
+    switch (code) {
+        case 200:
+            return "OK";
+        case 204:
+            return "No Content";
+        case 206:
+            return "Partial Content";
+        case 400:
+            return "Bad Request";
+        case 404:
+            return "Not Found";
+        case 416:
+            return "Requested Range Not Satisfiable";
+        default:
+            return "Internal Server Error";
+    }
+}
+
+static string errorXML(const string& code, const string& message) {
+    stringstream ss;
+    ss << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<Error><Code>" << code << "</Code><Message>"
+       << message << "</Message></Error>";
+    return ss.str();
+}
+
+struct ConnectionArgs {
+    S3StubServer* server;
+    int fd;
+};
+
+S3StubServer::S3StubServer()
+    : listenFd(-1),
+      port(0),
+      running(false),
+      acceptThread(0),
+      latencyUs(0),
+      bandwidth(0),
+      nextUploadId(1),
+      requestCount(0),
+      connectionCount(0),
+      cpuNanos(0) {
+    pthread_mutex_init(&this->objectsLock, NULL);
+    pthread_mutex_init(&this->connLock, NULL);
+}
+
+S3StubServer::~S3StubServer() {
+    this->stop();
+    pthread_mutex_destroy(&this->objectsLock);
+    pthread_mutex_destroy(&this->connLock);
+}
+
+void S3StubServer::start(uint16_t port) {
+    S3_CHECK_OR_DIE(!this->running, S3RuntimeError, "stub server is already running");
+
+    this->listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    S3_CHECK_OR_DIE(this->listenFd >= 0, S3RuntimeError, "failed to create socket");
+
+    int on = 1;
+    setsockopt(this->listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+
+    S3_CHECK_OR_DIE(bind(this->listenFd, (struct sockaddr*)&addr, sizeof(addr)) == 0,
+                    S3RuntimeError, string("failed to bind stub server: ") + strerror(errno));
+    S3_CHECK_OR_DIE(listen(this->listenFd, 128) == 0, S3RuntimeError,
+                    string("failed to listen: ") + strerror(errno));
+
+    socklen_t len = sizeof(addr);
+    getsockname(this->listenFd, (struct sockaddr*)&addr, &len);
+    this->port = ntohs(addr.sin_port);
+
+    this->running = true;
+    pthread_create(&this->acceptThread, NULL, AcceptThreadFunc, this);
+}
+
+void S3StubServer::stop() {
+    if (!this->running) {
+        return;
+    }
+
+    this->running = false;
+    shutdown(this->listenFd, SHUT_RDWR);
+    close(this->listenFd);
+    pthread_join(this->acceptThread, NULL);
+    this->listenFd = -1;
+
+    vector<pthread_t> threads;
+    {
+        UniqueLock lock(&this->connLock);
+        for (size_t i = 0; i < this->connFds.size(); i++) {
+            shutdown(this->connFds[i], SHUT_RDWR);
+        }
+        threads.swap(this->connThreads);
+    }
+
+    for (size_t i = 0; i < threads.size(); i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+void S3StubServer::putObject(const string& bucket, const string& key, const string& data) {
+    UniqueLock lock(&this->objectsLock);
+    this->objects[bucket + "/" + key] = data;
+}
+
+bool S3StubServer::getObject(const string& bucket, const string& key, string& data) {
+    UniqueLock lock(&this->objectsLock);
+    map<string, string>::iterator it = this->objects.find(bucket + "/" + key);
+    if (it == this->objects.end()) {
+        return false;
+    }
+    data = it->second;
+    return true;
+}
+
+void S3StubServer::clear() {
+    UniqueLock lock(&this->objectsLock);
+    this->objects.clear();
+    this->uploads.clear();
+}
+
+void* S3StubServer::AcceptThreadFunc(void* p) {
+    S3StubServer* server = static_cast<S3StubServer*>(p);
+
+    while (server->running) {
+        int fd = accept(server->listenFd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        server->connectionCount++;
+
+        ConnectionArgs* args = new ConnectionArgs();
+        args->server = server;
+        args->fd = fd;
+
+        UniqueLock lock(&server->connLock);
+        pthread_t thread;
+        pthread_create(&thread, NULL, ConnectionThreadFunc, args);
+        server->connThreads.push_back(thread);
+        server->connFds.push_back(fd);
+    }
+
+    return NULL;
+}
+
+void* S3StubServer::ConnectionThreadFunc(void* p) {
+    ConnectionArgs* args = static_cast<ConnectionArgs*>(p);
+    S3StubServer* server = args->server;
+    int fd = args->fd;
+    delete args;
+
+    uint64_t cpuStart = threadCpuNanos();
+    server->serveConnection(fd);
+    server->cpuNanos += threadCpuNanos() - cpuStart;
+
+    {
+        UniqueLock lock(&server->connLock);
+        vector<int>::iterator it = std::find(server->connFds.begin(), server->connFds.end(), fd);
+        if (it != server->connFds.end()) {
+            server->connFds.erase(it);
+        }
+    }
+    close(fd);
+
+    return NULL;
+}
+
+void S3StubServer::serveConnection(int fd) {
+    string pending;
+
+    while (this->running) {
+        Request req;
+        if (!this->readRequest(fd, pending, req)) {
+            return;
+        }
+
+        this->requestCount++;
+
+        bool keepAlive = toLower(req.headers["connection"]) != "close";
+
+        if (this->latencyUs > 0) {
+            usleep(this->latencyUs);
+        }
+
+        this->handleRequest(fd, req, keepAlive);
+
+        if (!keepAlive) {
+            return;
+        }
+    }
+}
+
+// Parse one request from the connection. "pending" carries bytes read past the end of the
+// previous request, which happens when the client pipelines or reuses the connection.
+bool S3StubServer::readRequest(int fd, string& pending, Request& req) {
+    char buf[STUB_IO_SLICE];
+    size_t headerEnd;
+
+    while ((headerEnd = pending.find("\r\n\r\n")) == string::npos) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            return false;
+        }
+        pending.append(buf, n);
+    }
+
+    string head = pending.substr(0, headerEnd);
+    pending.erase(0, headerEnd + 4);
+
+    stringstream ss(head);
+    string line;
+    std::getline(ss, line);
+    if (!line.empty() && line[line.size() - 1] == '\r') {
+        line.erase(line.size() - 1);
+    }
+
+    stringstream requestLine(line);
+    string target, version;
+    requestLine >> req.method >> target >> version;
+
+    size_t qpos = target.find('?');
+    req.path = UriDecode(target.substr(0, qpos));
+    if (qpos != string::npos) {
+        stringstream qs(target.substr(qpos + 1));
+        string pair;
+        while (std::getline(qs, pair, '&')) {
+            size_t eq = pair.find('=');
+            if (eq == string::npos) {
+                req.query[UriDecode(pair)] = "";
+            } else {
+                req.query[UriDecode(pair.substr(0, eq))] = UriDecode(pair.substr(eq + 1));
+            }
+        }
+    }
+
+    while (std::getline(ss, line)) {
+        if (!line.empty() && line[line.size() - 1] == '\r') {
+            line.erase(line.size() - 1);
+        }
+        size_t colon = line.find(':');
+        if (colon == string::npos) {
+            continue;
+        }
+        size_t valueStart = line.find_first_not_of(' ', colon + 1);
+        req.headers[toLower(line.substr(0, colon))] =
+            valueStart == string::npos ? "" : line.substr(valueStart);
+    }
+
+    uint64_t contentLength = 0;
+    if (req.headers.count("content-length")) {
+        contentLength = strtoull(req.headers["content-length"].c_str(), NULL, 10);
+    }
+
+    if (contentLength > 0 && toLower(req.headers["expect"]) == "100-continue") {
+        const char* cont = "HTTP/1.1 100 Continue\r\n\r\n";
+        if (!this->sendAll(fd, cont, strlen(cont), false)) {
+            return false;
+        }
+    }
+
+    uint64_t startNs = monotonicNanos();
+    uint64_t received = pending.size() < contentLength ? pending.size() : contentLength;
+    while (pending.size() < contentLength) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            return false;
+        }
+        pending.append(buf, n);
+        this->throttle(n, startNs, received);
+    }
+
+    req.body = pending.substr(0, contentLength);
+    pending.erase(0, contentLength);
+
+    return true;
+}
+
+void S3StubServer::handleRequest(int fd, const Request& req, bool keepAlive) {
+    // path-style: "/bucket" or "/bucket/" or "/bucket/key..."
+    string path = req.path.size() > 0 && req.path[0] == '/' ? req.path.substr(1) : req.path;
+    size_t slash = path.find('/');
+    string bucket = path.substr(0, slash);
+    string key = slash == string::npos ? "" : path.substr(slash + 1);
+
+    if (req.method == "GET" && key.empty()) {
+        this->handleList(fd, bucket, req, keepAlive);
+    } else if (req.method == "GET") {
+        this->handleGet(fd, bucket, key, req, keepAlive);
+    } else if (req.method == "HEAD") {
+        this->handleHead(fd, bucket, key, keepAlive);
+    } else if (req.method == "POST") {
+        this->handlePost(fd, bucket, key, req, keepAlive);
+    } else if (req.method == "PUT") {
+        this->handlePut(fd, bucket, key, req, keepAlive);
+    } else if (req.method == "DELETE") {
+        this->handleDelete(fd, req, keepAlive);
+    } else {
+        string body = errorXML("NotImplemented", "Unsupported method " + req.method);
+        this->sendResponse(fd, 400, "", body.data(), body.size(), keepAlive);
+    }
+}
+
+void S3StubServer::handleList(int fd, const string& bucket, const Request& req, bool keepAlive) {
+    const uint64_t maxKeys = 1000;
+
+    map<string, string>::const_iterator prefixIt = req.query.find("prefix");
+    map<string, string>::const_iterator markerIt = req.query.find("marker");
+    string prefix = prefixIt == req.query.end() ? "" : prefixIt->second;
+    string marker = markerIt == req.query.end() ? "" : markerIt->second;
+
+    stringstream body;
+    body << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+         << "<ListBucketResult><Name>" << bucket << "</Name><Prefix>" << prefix << "</Prefix>";
+
+    string lastKey;
+    uint64_t count = 0;
+    bool truncated = false;
+    {
+        UniqueLock lock(&this->objectsLock);
+        string from = bucket + "/" + (marker.empty() ? prefix : marker);
+        map<string, string>::const_iterator it = this->objects.lower_bound(from);
+        for (; it != this->objects.end(); ++it) {
+            if (it->first.compare(0, bucket.size() + 1, bucket + "/") != 0) {
+                break;
+            }
+
+            string key = it->first.substr(bucket.size() + 1);
+            if (key.compare(0, prefix.size(), prefix) != 0) {
+                break;
+            }
+            if (!marker.empty() && key <= marker) {
+                continue;
+            }
+            if (count == maxKeys) {
+                truncated = true;
+                break;
+            }
+
+            body << "<Contents><Key>" << key << "</Key><Size>" << it->second.size()
+                 << "</Size></Contents>";
+            lastKey = key;
+            count++;
+        }
+    }
+
+    body << "<IsTruncated>" << (truncated ? "true" : "false") << "</IsTruncated>";
+    if (truncated) {
+        body << "<NextMarker>" << lastKey << "</NextMarker>";
+    }
+    body << "</ListBucketResult>";
+
+    string xml = body.str();
+    this->sendResponse(fd, 200, "Content-Type: application/xml\r\n", xml.data(), xml.size(),
+                       keepAlive);
+}
+
+void S3StubServer::handleGet(int fd, const string& bucket, const string& key, const Request& req,
+                             bool keepAlive) {
+    string data;
+    if (!this->getObject(bucket, key, data)) {
+        string body = errorXML("NoSuchKey", "The specified key does not exist.");
+        this->sendResponse(fd, 404, "", body.data(), body.size(), keepAlive);
+        return;
+    }
+
+    map<string, string>::const_iterator rangeIt = req.headers.find("range");
+    if (rangeIt == req.headers.end()) {
+        this->sendResponse(fd, 200, "", data.data(), data.size(), keepAlive);
+        return;
+    }
+
+    uint64_t first = 0, last = 0;
+    if (sscanf(rangeIt->second.c_str(), "bytes=%" SCNu64 "-%" SCNu64, &first, &last) != 2 ||
+        first > last || first >= data.size()) {
+        string body = errorXML("InvalidRange", "The requested range is not satisfiable");
+        this->sendResponse(fd, 416, "", body.data(), body.size(), keepAlive);
+        return;
+    }
+
+    last = std::min(last, (uint64_t)data.size() - 1);
+
+    stringstream extra;
+    extra << "Content-Range: bytes " << first << "-" << last << "/" << data.size() << "\r\n";
+    this->sendResponse(fd, 206, extra.str(), data.data() + first, last - first + 1, keepAlive);
+}
+
+void S3StubServer::handleHead(int fd, const string& bucket, const string& key, bool keepAlive) {
+    string data;
+    bool found = this->getObject(bucket, key, data);
+    this->sendResponse(fd, found ? 200 : 404, "", NULL, found ? data.size() : 0, keepAlive, true);
+}
+
+void S3StubServer::handlePost(int fd, const string& bucket, const string& key, const Request& req,
+                              bool keepAlive) {
+    stringstream body;
+
+    if (req.query.count("uploads")) {
+        string uploadId;
+        {
+            UniqueLock lock(&this->objectsLock);
+            uploadId = "stub-upload-" + std::to_string((unsigned long long)this->nextUploadId++);
+            Upload& upload = this->uploads[uploadId];
+            upload.bucket = bucket;
+            upload.key = key;
+        }
+
+        body << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+             << "<InitiateMultipartUploadResult><Bucket>" << bucket << "</Bucket><Key>" << key
+             << "</Key><UploadId>" << uploadId << "</UploadId></InitiateMultipartUploadResult>";
+    } else if (req.query.count("uploadId")) {
+        UniqueLock lock(&this->objectsLock);
+        map<string, Upload>::iterator it = this->uploads.find(req.query.at("uploadId"));
+        if (it == this->uploads.end()) {
+            string err = errorXML("NoSuchUpload", "The specified upload does not exist.");
+            this->sendResponse(fd, 404, "", err.data(), err.size(), keepAlive);
+            return;
+        }
+
+        string data;
+        for (map<uint64_t, string>::iterator part = it->second.parts.begin();
+             part != it->second.parts.end(); ++part) {
+            data += part->second;
+        }
+        this->objects[it->second.bucket + "/" + it->second.key].swap(data);
+        this->uploads.erase(it);
+
+        body << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+             << "<CompleteMultipartUploadResult><Bucket>" << bucket << "</Bucket><Key>" << key
+             << "</Key></CompleteMultipartUploadResult>";
+    } else {
+        string err = errorXML("InvalidRequest", "Unsupported POST request");
+        this->sendResponse(fd, 400, "", err.data(), err.size(), keepAlive);
+        return;
+    }
+
+    string xml = body.str();
+    this->sendResponse(fd, 200, "Content-Type: application/xml\r\n", xml.data(), xml.size(),
+                       keepAlive);
+}
+
+void S3StubServer::handlePut(int fd, const string& bucket, const string& key, const Request& req,
+                             bool keepAlive) {
+    if (!req.query.count("uploadId") || !req.query.count("partNumber")) {
+        this->putObject(bucket, key, req.body);
+        this->sendResponse(fd, 200, "", NULL, 0, keepAlive);
+        return;
+    }
+
+    uint64_t partNumber = strtoull(req.query.at("partNumber").c_str(), NULL, 10);
+    {
+        UniqueLock lock(&this->objectsLock);
+        map<string, Upload>::iterator it = this->uploads.find(req.query.at("uploadId"));
+        if (it == this->uploads.end()) {
+            string err = errorXML("NoSuchUpload", "The specified upload does not exist.");
+            this->sendResponse(fd, 404, "", err.data(), err.size(), keepAlive);
+            return;
+        }
+        it->second.parts[partNumber] = req.body;
+    }
+
+    stringstream extra;
+    extra << "ETag: \"stub-etag-" << partNumber << "\"\r\n";
+    this->sendResponse(fd, 200, extra.str(), NULL, 0, keepAlive);
+}
+
+void S3StubServer::handleDelete(int fd, const Request& req, bool keepAlive) {
+    if (req.query.count("uploadId")) {
+        UniqueLock lock(&this->objectsLock);
+        this->uploads.erase(req.query.at("uploadId"));
+    }
+    this->sendResponse(fd, 204, "", NULL, 0, keepAlive);
+}
+
+void S3StubServer::sendResponse(int fd, int code, const string& extraHeaders, const char* body,
+                                uint64_t bodyLen, bool keepAlive, bool headOnly) {
+    stringstream head;
+    head << "HTTP/1.1 " << code << " " << reasonPhrase(code) << "\r\n"
+         << "Server: gpcloud-s3stub\r\n"
+         << "Content-Length: " << bodyLen << "\r\n"
+         << "Connection: " << (keepAlive ? "keep-alive" : "close") << "\r\n"
+         << extraHeaders << "\r\n";
+
+    string headStr = head.str();
+    if (!this->sendAll(fd, headStr.data(), headStr.size(), false)) {
+        return;
+    }
+
+    if (!headOnly && bodyLen > 0) {
+        this->sendAll(fd, body, bodyLen, true);
+    }
+}
+
+bool S3StubServer::sendAll(int fd, const char* buf, uint64_t len, bool throttled) {
+    uint64_t startNs = monotonicNanos();
+    uint64_t sent = 0;
+
+    while (sent < len) {
+        uint64_t slice = std::min((uint64_t)STUB_IO_SLICE, len - sent);
+        ssize_t n = send(fd, buf + sent, slice, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        if (throttled) {
+            uint64_t before = sent;
+            this->throttle(n, startNs, before);
+        }
+        sent += n;
+    }
+
+    return true;
+}
+
+// Sleep until "sentBytes + bytes" would not exceed the configured bandwidth since "startNs".
+void S3StubServer::throttle(uint64_t bytes, uint64_t startNs, uint64_t& sentBytes) {
+    sentBytes += bytes;
+
+    if (this->bandwidth == 0) {
+        return;
+    }
+
+    uint64_t expectedNs = sentBytes * 1000000000ULL / this->bandwidth;
+    uint64_t elapsedNs = monotonicNanos() - startNs;
+    if (expectedNs > elapsedNs) {
+        usleep((expectedNs - elapsedNs) / 1000);
+    }
+}
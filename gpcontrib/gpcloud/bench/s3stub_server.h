@@ -0,0 +1,122 @@
+#ifndef __S3_STUB_SERVER_H__
+#define __S3_STUB_SERVER_H__
+
+#include <atomic>
+
+#include "s3common_headers.h"
+
+// S3StubServer is a small in-process HTTP/1.1 server implementing the subset of the S3 REST API
+// that gpcloud uses: ranged GET on objects, ListObjects (v1, with prefix/marker paging), HEAD,
+// and multipart upload (initiate, upload part, complete, abort). Requests are answered with
+// path-style addressing, i.e. "/bucket/key".
+//
+// It is meant for benchmarking only: signatures are not verified and objects live in memory.
+// Latency and bandwidth are configurable so that the stub can stand in for a remote endpoint.
+class S3StubServer {
+   public:
+    S3StubServer();
+    ~S3StubServer();
+
+    // Listen on 127.0.0.1. Port 0 means an ephemeral port is chosen; see getPort().
+    void start(uint16_t port = 0);
+    void stop();
+
+    uint16_t getPort() const {
+        return port;
+    }
+
+    // Delay applied before every response, in microseconds.
+    void setLatencyUs(uint64_t latencyUs) {
+        this->latencyUs = latencyUs;
+    }
+
+    // Per-connection bandwidth limit applied to request and response bodies, in bytes per
+    // second. 0 means unlimited.
+    void setBandwidth(uint64_t bytesPerSec) {
+        this->bandwidth = bytesPerSec;
+    }
+
+    void putObject(const string& bucket, const string& key, const string& data);
+    bool getObject(const string& bucket, const string& key, string& data);
+    void clear();
+
+    uint64_t getRequestCount() const {
+        return requestCount.load();
+    }
+
+    uint64_t getConnectionCount() const {
+        return connectionCount.load();
+    }
+
+    // CPU time consumed by the server threads, in nanoseconds. Benchmarks subtract this from the
+    // process CPU time to get the cost of the client side alone.
+    uint64_t getCpuNanos() const {
+        return cpuNanos.load();
+    }
+
+    void resetStats() {
+        requestCount = 0;
+        connectionCount = 0;
+        cpuNanos = 0;
+    }
+
+   private:
+    struct Request {
+        string method;
+        string path;
+        map<string, string> query;
+        map<string, string> headers;  // names are lower case
+        string body;
+    };
+
+    struct Upload {
+        string bucket;
+        string key;
+        map<uint64_t, string> parts;
+    };
+
+    static void* AcceptThreadFunc(void* p);
+    static void* ConnectionThreadFunc(void* p);
+
+    void serveConnection(int fd);
+    bool readRequest(int fd, string& pending, Request& req);
+    void handleRequest(int fd, const Request& req, bool keepAlive);
+
+    void handleList(int fd, const string& bucket, const Request& req, bool keepAlive);
+    void handleGet(int fd, const string& bucket, const string& key, const Request& req,
+                   bool keepAlive);
+    void handleHead(int fd, const string& bucket, const string& key, bool keepAlive);
+    void handlePost(int fd, const string& bucket, const string& key, const Request& req,
+                    bool keepAlive);
+    void handlePut(int fd, const string& bucket, const string& key, const Request& req,
+                   bool keepAlive);
+    void handleDelete(int fd, const Request& req, bool keepAlive);
+
+    void sendResponse(int fd, int code, const string& extraHeaders, const char* body,
+                      uint64_t bodyLen, bool keepAlive, bool headOnly = false);
+    bool sendAll(int fd, const char* buf, uint64_t len, bool throttle);
+    void throttle(uint64_t bytes, uint64_t startNs, uint64_t& sentBytes);
+
+    int listenFd;
+    uint16_t port;
+    bool running;
+    pthread_t acceptThread;
+
+    uint64_t latencyUs;
+    uint64_t bandwidth;
+
+    pthread_mutex_t objectsLock;
+    map<string, string> objects;  // "bucket/key" -> data
+    map<string, Upload> uploads;  // uploadId -> parts
+    uint64_t nextUploadId;
+
+    pthread_mutex_t connLock;
+    vector<pthread_t> connThreads;
+    vector<int> connFds;
+
+    std::atomic<uint64_t> requestCount;
+    std::atomic<uint64_t> connectionCount;
+    std::atomic<uint64_t> cpuNanos;
+};
+
+#endif
@@ -0,0 +1,277 @@
+#ifndef INCLUDE_PARQUET_READER_H_
+#define INCLUDE_PARQUET_READER_H_
+
+#include "reader.h"
+#include "s3common_headers.h"
+#include "s3exception.h"
+#include "s3interface.h"
+
+// Parquet physical types
+enum ParquetType {
+    PARQUET_BOOLEAN = 0,
+    PARQUET_INT32 = 1,
+    PARQUET_INT64 = 2,
+    PARQUET_INT96 = 3,
+    PARQUET_FLOAT = 4,
+    PARQUET_DOUBLE = 5,
+    PARQUET_BYTE_ARRAY = 6,
+    PARQUET_FIXED_LEN_BYTE_ARRAY = 7,
+};
+
+// Parquet converted (logical) types we care about. Timestamp units from the newer LogicalType
+// annotation are folded into these as well.
+enum ParquetConvertedType {
+    PARQUET_CT_NONE = -1,
+    PARQUET_CT_UTF8 = 0,
+    PARQUET_CT_DECIMAL = 5,
+    PARQUET_CT_DATE = 6,
+    PARQUET_CT_TIMESTAMP_MILLIS = 9,
+    PARQUET_CT_TIMESTAMP_MICROS = 10,
+    PARQUET_CT_UINT_8 = 11,
+    PARQUET_CT_UINT_16 = 12,
+    PARQUET_CT_UINT_32 = 13,
+    PARQUET_CT_UINT_64 = 14,
+    PARQUET_CT_INT_8 = 15,
+    PARQUET_CT_INT_16 = 16,
+    PARQUET_CT_INT_32 = 17,
+    PARQUET_CT_INT_64 = 18,
+    PARQUET_CT_TIMESTAMP_NANOS = 100,  // LogicalType only, no converted type exists
+};
+
+enum ParquetCodec {
+    PARQUET_CODEC_UNCOMPRESSED = 0,
+    PARQUET_CODEC_SNAPPY = 1,
+    PARQUET_CODEC_GZIP = 2,
+};
+
+enum ParquetQualOp {
+    PARQUET_QUAL_EQ,
+    PARQUET_QUAL_LT,
+    PARQUET_QUAL_LE,
+    PARQUET_QUAL_GT,
+    PARQUET_QUAL_GE,
+};
+
+enum ParquetQualKind {
+    PARQUET_QUAL_INT,        // intValue
+    PARQUET_QUAL_DOUBLE,     // doubleValue
+    PARQUET_QUAL_STRING,     // stringValue
+    PARQUET_QUAL_DATE,       // intValue, days since 1970-01-01
+    PARQUET_QUAL_TIMESTAMP,  // intValue, microseconds since 1970-01-01 00:00:00
+};
+
+// A simple "column op constant" predicate used to skip row groups by their min/max statistics.
+// Quals are only used for skipping, rows that are returned are still filtered by the executor.
+struct ParquetQual {
+    ParquetQual()
+        : column(0), op(PARQUET_QUAL_EQ), kind(PARQUET_QUAL_INT), intValue(0), doubleValue(0) {
+    }
+
+    uint64_t column;  // index into ParquetScanSpec::columnNames
+    ParquetQualOp op;
+    ParquetQualKind kind;
+    int64_t intValue;
+    double doubleValue;
+    string stringValue;
+};
+
+// Describes what the external table needs from a Parquet file: all its columns (by name, in table
+// order), which of them are referenced by the query, and the pushed-down quals.
+struct ParquetScanSpec {
+    ParquetScanSpec()
+        : csv(false), delimiter('\t'), quote('"'), escape('\\'), nullString("\\N") {
+    }
+
+    vector<string> columnNames;
+    vector<bool> projected;
+    vector<ParquetQual> quals;
+
+    // Output format of generated rows, must match the table's FORMAT clause.
+    bool csv;
+    char delimiter;
+    char quote;
+    char escape;  // '\0' if escaping is off (TEXT only)
+    string nullString;
+};
+
+struct ParquetColumnStats {
+    ParquetColumnStats() : hasMinMax(false), hasNullCount(false), nullCount(0) {
+    }
+
+    bool hasMinMax;
+    string minValue;
+    string maxValue;
+    bool hasNullCount;
+    int64_t nullCount;
+};
+
+// Schema of one leaf column. Only flat schemas are supported.
+struct ParquetColumnSchema {
+    ParquetColumnSchema()
+        : physicalType(PARQUET_INT32),
+          typeLength(0),
+          convertedType(PARQUET_CT_NONE),
+          scale(0),
+          optional(false) {
+    }
+
+    string name;
+    int32_t physicalType;
+    int32_t typeLength;
+    int32_t convertedType;
+    int32_t scale;
+    bool optional;
+};
+
+struct ParquetColumnChunk {
+    ParquetColumnChunk()
+        : codec(PARQUET_CODEC_UNCOMPRESSED),
+          numValues(0),
+          dataPageOffset(0),
+          dictionaryPageOffset(0),
+          totalCompressedSize(0),
+          minMaxOrdered(true) {
+    }
+
+    uint64_t startOffset() const {
+        if (dictionaryPageOffset > 0 && dictionaryPageOffset < dataPageOffset) {
+            return dictionaryPageOffset;
+        }
+        return dataPageOffset;
+    }
+
+    int32_t codec;
+    int64_t numValues;
+    int64_t dataPageOffset;
+    int64_t dictionaryPageOffset;
+    int64_t totalCompressedSize;
+    ParquetColumnStats stats;
+    // false if stats only come from the deprecated min/max fields, whose sort order is undefined
+    // for byte arrays.
+    bool minMaxOrdered;
+};
+
+struct ParquetRowGroup {
+    ParquetRowGroup() : numRows(0) {
+    }
+
+    int64_t numRows;
+    vector<ParquetColumnChunk> columns;
+};
+
+struct ParquetFileMetaData {
+    ParquetFileMetaData() : numRows(0) {
+    }
+
+    int64_t numRows;
+    vector<ParquetColumnSchema> columns;
+    vector<ParquetRowGroup> rowGroups;
+};
+
+// Decoded values of one column chunk. Integers, booleans and dates live in ints, floating point
+// values in doubles and everything else (byte arrays, INT96) in strings.
+struct ParquetColumnValues {
+    void clear() {
+        nulls.clear();
+        ints.clear();
+        doubles.clear();
+        strings.clear();
+    }
+
+    vector<uint8_t> nulls;  // one per row
+    vector<int64_t> ints;   // one per non-null row
+    vector<double> doubles;
+    vector<string> strings;
+};
+
+// Parse the Thrift-encoded FileMetaData of a Parquet footer.
+ParquetFileMetaData ParseParquetFooter(const uint8_t* data, uint64_t len);
+
+// Decode all pages of a column chunk.
+void DecodeParquetColumnChunk(const ParquetColumnSchema& schema, const ParquetColumnChunk& chunk,
+                              const uint8_t* data, uint64_t len, int64_t numRows,
+                              ParquetColumnValues& values);
+
+// Return false if statistics prove that no row of the chunk can satisfy the qual.
+bool ParquetChunkMayMatch(const ParquetColumnSchema& schema, const ParquetColumnChunk& chunk,
+                          int64_t numRows, const ParquetQual& qual);
+
+// ParquetReader reads one Parquet key (set by open()), fetching only the footer and the column
+// chunks of projected columns with range GETs, and produces TEXT or CSV rows for the formatter.
+// Columns that are not projected are emitted as NULL. Row groups whose statistics show they can't
+// satisfy the pushed-down quals are skipped without being fetched.
+class ParquetReader : public Reader {
+   public:
+    ParquetReader()
+        : s3Interface(NULL),
+          rowGroupIndex(0),
+          rowIndex(0),
+          rowGroupRows(0),
+          outputPos(0),
+          skippedRowGroups(0),
+          fetchedBytes(0) {
+    }
+
+    virtual ~ParquetReader() {
+        this->close();
+    }
+
+    virtual void open(const S3Params& params);
+
+    // read() attempts to read up to count bytes into the buffer.
+    // Return 0 if EOF. Throw exception if encounters errors.
+    virtual uint64_t read(char* buf, uint64_t count);
+
+    // This should be reentrant, has no side effects when called multiple times.
+    virtual void close();
+
+    void setS3InterfaceService(S3Interface* s3) {
+        this->s3Interface = s3;
+    }
+
+    void setScanSpec(const ParquetScanSpec& spec) {
+        this->spec = spec;
+    }
+
+    const ParquetFileMetaData& getMetaData() const {
+        return metaData;
+    }
+
+    uint64_t getSkippedRowGroups() const {
+        return skippedRowGroups;
+    }
+
+    uint64_t getFetchedBytes() const {
+        return fetchedBytes;
+    }
+
+   private:
+    void fetchRange(uint64_t offset, uint64_t len, vector<uint8_t>& out);
+    void readFooter();
+    bool loadNextRowGroup();
+    void formatRow(int64_t row);
+    void appendValue(uint64_t column, uint64_t valueIndex);
+    void appendText(const char* p, uint64_t len);
+
+    S3Interface* s3Interface;
+    S3Params params;
+    ParquetScanSpec spec;
+    ParquetFileMetaData metaData;
+
+    // table column -> parquet leaf column, -1 if the file has no such column
+    vector<int64_t> columnMap;
+
+    uint64_t rowGroupIndex;
+    int64_t rowIndex;
+    int64_t rowGroupRows;
+    vector<ParquetColumnValues> columnValues;  // per table column, only projected ones filled
+    vector<uint64_t> valueCursor;              // next non-null value per table column
+
+    string output;
+    uint64_t outputPos;
+
+    uint64_t skippedRowGroups;
+    uint64_t fetchedBytes;
+};
+
+#endif /* INCLUDE_PARQUET_READER_H_ */
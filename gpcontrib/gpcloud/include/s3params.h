@@ -7,6 +7,8 @@
 
 enum S3SSEType { SSE_NONE, SSE_S3 };
 
+enum S3FileFormat { FILE_FORMAT_TEXT, FILE_FORMAT_PARQUET };
+
 class S3Params {
    public:
     S3Params(const string& sourceUrl = "", bool useHttps = true, const string& version = "",
@@ -22,6 +24,7 @@ class S3Params {
           autoCompress(false),
           verifyCert(false),
           sseType(SSE_NONE),
+          fileFormat(FILE_FORMAT_TEXT),
           gpcheckcloud_newline("") {
     }
 
@@ -131,6 +134,14 @@ class S3Params {
         this->sseType = sseType;
     }
 
+    S3FileFormat getFileFormat() const {
+        return fileFormat;
+    }
+
+    void setFileFormat(S3FileFormat fileFormat) {
+        this->fileFormat = fileFormat;
+    }
+
     const string& getProxy() const {
         return proxy;
     }
@@ -169,6 +180,8 @@ class S3Params {
 
     S3SSEType sseType;
 
+    S3FileFormat fileFormat;  // format of keys, TEXT/CSV keys are passed through as is
+
     S3MemoryContext memoryContext;
 
     string gpcheckcloud_newline;  // newline LF, CRLF, CR
@@ -10,6 +10,17 @@
 #include "s3macros.h"
 #include "s3params.h"
 
+// Process-wide counters of the connections used by S3RESTfulService requests.
+struct S3ConnectionStats {
+    S3ConnectionStats() : requests(0), newConnections(0), reusedConnections(0), handshakeUs(0) {
+    }
+
+    uint64_t requests;
+    uint64_t newConnections;     // requests that had to connect (and do a TLS handshake)
+    uint64_t reusedConnections;  // requests served on a kept-alive connection
+    uint64_t handshakeUs;        // total TCP connect + TLS handshake time of new connections
+};
+
 class S3RESTfulService : public RESTfulService {
    public:
     S3RESTfulService();
@@ -27,6 +38,8 @@ class S3RESTfulService : public RESTfulService {
 
     Response deleteRequest(const string& url, HTTPHeaders& headers);
 
+    static S3ConnectionStats getConnectionStats();
+
    private:
     uint64_t lowSpeedLimit;
     uint64_t lowSpeedTime;
@@ -12,15 +12,24 @@ extern "C" {
 #endif
 
 #include "access/extprotocol.h"
+#include "access/fileam.h"
 #include "access/xact.h"
 #include "catalog/pg_exttable.h"
 #include "catalog/pg_proc.h"
+#include "catalog/pg_type.h"
 #include "fmgr.h"
 #include "funcapi.h"
+#include "nodes/execnodes.h"
+#include "optimizer/var.h"
 #include "utils/array.h"
 #include "utils/builtins.h"
+#include "utils/date.h"
+#include "utils/guc.h"
+#include "utils/lsyscache.h"
 #include "utils/memutils.h"
+#include "utils/rel.h"
 #include "utils/resowner.h"
+#include "utils/timestamp.h"
 
 #ifdef __clang__
 #pragma clang diagnostic pop
@@ -171,6 +180,257 @@ static void parseFormatOpts(FunctionCallInfo fcinfo) {
     }
 }
 
+/*
+ * Get the value of a quoted format option, e.g. "null '\N'". The catalog stores them in the order
+ * delimiter, null, escape, quote, so the value ends at the quote that precedes the next option.
+ */
+static bool getFmtOptValue(const char *fmtopts, const char *name, const char *next,
+                           string &value) {
+    string key = string(name) + " '";
+    const char *start = strstr(fmtopts, key.c_str());
+    if (start == NULL) {
+        return false;
+    }
+    start += key.size();
+
+    const char *end = NULL;
+    if (next != NULL) {
+        end = strstr(start, (string("' ") + next + " '").c_str());
+    }
+    if (end == NULL) {
+        end = strchr(start + 1, '\'');
+    }
+    if (end == NULL) {
+        return false;
+    }
+
+    value.assign(start, end - start);
+    return true;
+}
+
+/*
+ * Collect the attribute numbers referenced by an expression. Return false if it references the
+ * whole row, in which case every column is needed.
+ */
+static bool collectVarAttnos(Node *expr, vector<bool> &attnos) {
+    List *vars = pull_var_clause(expr, PVC_RECURSE_AGGREGATES, PVC_RECURSE_PLACEHOLDERS);
+    ListCell *lc;
+
+    foreach (lc, vars) {
+        Var *var = (Var *)lfirst(lc);
+        if (var->varattno <= 0 || var->varattno > (AttrNumber)attnos.size()) {
+            list_free(vars);
+            return false;
+        }
+        attnos[var->varattno - 1] = true;
+    }
+
+    list_free(vars);
+    return true;
+}
+
+/*
+ * Convert "column op constant" into a ParquetQual, only for built-in btree comparison operators
+ * whose semantics are the same as comparing the Parquet statistics.
+ */
+static bool makeParquetQual(Expr *clause, const vector<int> &attnoToColumn, ParquetQual &qual) {
+    if (!IsA(clause, OpExpr) || list_length(((OpExpr *)clause)->args) != 2) {
+        return false;
+    }
+
+    OpExpr *opexpr = (OpExpr *)clause;
+    if (opexpr->opno >= FirstNormalObjectId) {
+        return false;
+    }
+
+    Node *left = (Node *)linitial(opexpr->args);
+    Node *right = (Node *)lsecond(opexpr->args);
+    bool commuted = false;
+
+    while (IsA(left, RelabelType)) left = (Node *)((RelabelType *)left)->arg;
+    while (IsA(right, RelabelType)) right = (Node *)((RelabelType *)right)->arg;
+
+    if (IsA(left, Const) && IsA(right, Var)) {
+        std::swap(left, right);
+        commuted = true;
+    }
+    if (!IsA(left, Var) || !IsA(right, Const) || ((Const *)right)->constisnull) {
+        return false;
+    }
+
+    Var *var = (Var *)left;
+    Const *con = (Const *)right;
+    if (var->varattno <= 0 || var->varattno > (AttrNumber)attnoToColumn.size() ||
+        attnoToColumn[var->varattno - 1] < 0) {
+        return false;
+    }
+
+    char *opname = get_opname(opexpr->opno);
+    if (opname == NULL) {
+        return false;
+    }
+
+    // "const < col" is "col > const"
+    if (strcmp(opname, "=") == 0) {
+        qual.op = PARQUET_QUAL_EQ;
+    } else if (strcmp(opname, "<") == 0) {
+        qual.op = commuted ? PARQUET_QUAL_GT : PARQUET_QUAL_LT;
+    } else if (strcmp(opname, "<=") == 0) {
+        qual.op = commuted ? PARQUET_QUAL_GE : PARQUET_QUAL_LE;
+    } else if (strcmp(opname, ">") == 0) {
+        qual.op = commuted ? PARQUET_QUAL_LT : PARQUET_QUAL_GT;
+    } else if (strcmp(opname, ">=") == 0) {
+        qual.op = commuted ? PARQUET_QUAL_LE : PARQUET_QUAL_GE;
+    } else {
+        return false;
+    }
+
+    switch (con->consttype) {
+        case INT2OID:
+            qual.kind = PARQUET_QUAL_INT;
+            qual.intValue = DatumGetInt16(con->constvalue);
+            break;
+        case INT4OID:
+            qual.kind = PARQUET_QUAL_INT;
+            qual.intValue = DatumGetInt32(con->constvalue);
+            break;
+        case INT8OID:
+            qual.kind = PARQUET_QUAL_INT;
+            qual.intValue = DatumGetInt64(con->constvalue);
+            break;
+        case FLOAT4OID:
+            qual.kind = PARQUET_QUAL_DOUBLE;
+            qual.doubleValue = DatumGetFloat4(con->constvalue);
+            break;
+        case FLOAT8OID:
+            qual.kind = PARQUET_QUAL_DOUBLE;
+            qual.doubleValue = DatumGetFloat8(con->constvalue);
+            break;
+        case TEXTOID:
+        case VARCHAROID: {
+            char *str = TextDatumGetCString(con->constvalue);
+            qual.kind = PARQUET_QUAL_STRING;
+            qual.stringValue = str;
+            pfree(str);
+            break;
+        }
+        case DATEOID: {
+            DateADT date = DatumGetDateADT(con->constvalue);
+            if (DATE_NOT_FINITE(date)) {
+                return false;
+            }
+            qual.kind = PARQUET_QUAL_DATE;
+            qual.intValue = (int64_t)date + (POSTGRES_EPOCH_JDATE - UNIX_EPOCH_JDATE);
+            break;
+        }
+#ifdef HAVE_INT64_TIMESTAMP
+        case TIMESTAMPOID: {
+            Timestamp ts = DatumGetTimestamp(con->constvalue);
+            if (TIMESTAMP_NOT_FINITE(ts)) {
+                return false;
+            }
+            qual.kind = PARQUET_QUAL_TIMESTAMP;
+            qual.intValue = ts + (POSTGRES_EPOCH_JDATE - UNIX_EPOCH_JDATE) * USECS_PER_DAY;
+            break;
+        }
+#endif
+        default:
+            return false;
+    }
+
+    qual.column = attnoToColumn[var->varattno - 1];
+    return true;
+}
+
+/*
+ * Describe the columns, projection and simple quals of the scan to the Parquet reader, so that it
+ * fetches only the column chunks the query needs and skips row groups by their statistics.
+ */
+static ParquetScanSpec buildParquetScanSpec(FunctionCallInfo fcinfo) {
+    Relation rel = EXTPROTOCOL_GET_RELATION(fcinfo);
+    ExtTableEntry *exttbl = GetExtTableEntry(rel->rd_id);
+    ExternalSelectDesc desc = EXTPROTOCOL_GET_EXTERNAL_SELECT_DESC(fcinfo);
+    TupleDesc tupdesc = RelationGetDescr(rel);
+    ParquetScanSpec spec;
+
+    // Parquet columns are matched by name, dropped columns are not in the data at all.
+    vector<int> attnoToColumn(tupdesc->natts, -1);
+    for (int i = 0; i < tupdesc->natts; i++) {
+        if (tupdesc->attrs[i]->attisdropped) continue;
+        attnoToColumn[i] = spec.columnNames.size();
+        spec.columnNames.push_back(NameStr(tupdesc->attrs[i]->attname));
+    }
+    spec.projected.assign(spec.columnNames.size(), true);
+
+    /*
+     * Quals are evaluated on the scan tuple, before projection, so columns can only be pruned
+     * when we know all the quals, i.e. when they are pushed down.
+     */
+    if (desc != NULL && desc->projInfo != NULL && gp_external_enable_filter_pushdown) {
+        ProjectionInfo *projInfo = desc->projInfo;
+        vector<bool> needed(tupdesc->natts, false);
+        bool needAll = false;
+        ListCell *lc;
+
+        for (int i = 0; i < projInfo->pi_numSimpleVars; i++) {
+            needed[projInfo->pi_varNumbers[i] - 1] = true;
+        }
+
+        foreach (lc, projInfo->pi_targetlist) {
+            GenericExprState *gstate = (GenericExprState *)lfirst(lc);
+            needAll = needAll || !collectVarAttnos((Node *)gstate->arg->expr, needed);
+        }
+
+        needAll = needAll || !collectVarAttnos((Node *)desc->filter_quals, needed);
+
+        if (!needAll) {
+            for (int i = 0; i < tupdesc->natts; i++) {
+                if (attnoToColumn[i] >= 0) {
+                    spec.projected[attnoToColumn[i]] = needed[i];
+                }
+            }
+        }
+    }
+
+    if (desc != NULL && gp_external_enable_filter_pushdown) {
+        ListCell *lc;
+        foreach (lc, desc->filter_quals) {
+            ParquetQual qual;
+            if (makeParquetQual((Expr *)lfirst(lc), attnoToColumn, qual)) {
+                spec.quals.push_back(qual);
+            }
+        }
+    }
+
+    // Rows must be formatted the way the table's formatter parses them.
+    spec.csv = fmttype_is_csv(exttbl->fmtcode);
+    if (spec.csv) {
+        spec.delimiter = ',';
+        spec.escape = '"';
+        spec.nullString = "";
+    }
+
+    string value;
+    if (getFmtOptValue(exttbl->fmtopts, "delimiter", "null", value) && value.size() == 1) {
+        spec.delimiter = value[0];
+    }
+    if (getFmtOptValue(exttbl->fmtopts, "null", "escape", value)) {
+        spec.nullString = value;
+    }
+    if (getFmtOptValue(exttbl->fmtopts, "escape", "quote", value)) {
+        if (pg_strcasecmp(value.c_str(), "off") == 0) {
+            spec.escape = '\0';
+        } else if (value.size() == 1) {
+            spec.escape = value[0];
+        }
+    }
+    if (spec.csv && getFmtOptValue(exttbl->fmtopts, "quote", NULL, value) && value.size() == 1) {
+        spec.quote = value[0];
+    }
+
+    return spec;
+}
+
 typedef struct gpcloudResHandle {
     GPReader *gpreader;
     GPWriter *gpwriter;
@@ -296,7 +556,11 @@ Datum s3_import(PG_FUNCTION_ARGS) {
 
         thread_setup();
 
-        resHandle->gpreader = reader_init(url_with_options);
+        {
+            // scoped, so that it's destructed before ereport() below jumps out
+            ParquetScanSpec parquetSpec = buildParquetScanSpec(fcinfo);
+            resHandle->gpreader = reader_init(url_with_options, &parquetSpec);
+        }
         if (!resHandle->gpreader) {
             ereport(ERROR, (0, errmsg("Failed to init gpcloud extension (segid = %d, "
                                       "segnum = %d), please check your "
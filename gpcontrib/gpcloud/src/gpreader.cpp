@@ -66,8 +66,16 @@ GPReader::GPReader(const S3Params& params)
 void GPReader::open(const S3Params& params) {
     this->s3InterfaceService.setRESTfulService(this->restfulServicePtr);
     this->bucketReader.setS3InterfaceService(&this->s3InterfaceService);
-    this->bucketReader.setUpstreamReader(&this->commonReader);
-    this->commonReader.setS3InterfaceService(&this->s3InterfaceService);
+    if (this->params.getFileFormat() == FILE_FORMAT_PARQUET) {
+        // a header line would be taken as a row, and Parquet keys don't have one anyway
+        S3_CHECK_OR_DIE(!hasHeader, S3ConfigError, "HEADER is not supported for Parquet keys",
+                        "fileformat");
+        this->bucketReader.setUpstreamReader(&this->parquetReader);
+        this->parquetReader.setS3InterfaceService(&this->s3InterfaceService);
+    } else {
+        this->bucketReader.setUpstreamReader(&this->commonReader);
+        this->commonReader.setS3InterfaceService(&this->s3InterfaceService);
+    }
     this->bucketReader.open(this->params);
 }
 
@@ -83,7 +91,7 @@ void GPReader::close() {
 }
 
 // invoked by s3_import(), need to be exception safe
-GPReader* reader_init(const char* url_with_options) {
+GPReader* reader_init(const char* url_with_options, const ParquetScanSpec* parquetSpec) {
     GPReader* reader = NULL;
     s3extErrorMessage.clear();
 
@@ -106,6 +114,10 @@ GPReader* reader_init(const char* url_with_options) {
             return NULL;
         }
 
+        if (parquetSpec != NULL) {
+            reader->setParquetScanSpec(*parquetSpec);
+        }
+
         reader->open(params);
         return reader;
     } catch (S3Exception& e) {
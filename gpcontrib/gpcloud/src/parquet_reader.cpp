@@ -0,0 +1,1542 @@
+#include "parquet_reader.h"
+
+#include <strings.h>
+#include <cmath>
+
+#include "gpcommon.h"
+#include "s3log.h"
+#include "s3macros.h"
+
+#define PARQUET_MAGIC "PAR1"
+#define PARQUET_MAGIC_LEN 4
+
+// Bytes fetched from the end of a key in the first GET, in the hope that the whole footer fits.
+#define PARQUET_FOOTER_PREFETCH (64 * 1024)
+
+// Column chunks of one row group closer than this are fetched with a single range GET.
+#define PARQUET_COALESCE_GAP (1024 * 1024)
+
+// Julian day number of 1970-01-01, used by INT96 timestamps.
+#define PARQUET_UNIX_EPOCH_JULIAN_DAY 2440588
+
+#define MICROS_PER_DAY 86400000000LL
+
+enum ParquetPageType {
+    PARQUET_DATA_PAGE = 0,
+    PARQUET_INDEX_PAGE = 1,
+    PARQUET_DICTIONARY_PAGE = 2,
+    PARQUET_DATA_PAGE_V2 = 3,
+};
+
+enum ParquetEncoding {
+    PARQUET_ENCODING_PLAIN = 0,
+    PARQUET_ENCODING_PLAIN_DICTIONARY = 2,
+    PARQUET_ENCODING_RLE = 3,
+    PARQUET_ENCODING_RLE_DICTIONARY = 8,
+};
+
+// ================== Thrift compact protocol ===================
+
+enum ThriftType {
+    THRIFT_STOP = 0,
+    THRIFT_TRUE = 1,
+    THRIFT_FALSE = 2,
+    THRIFT_BYTE = 3,
+    THRIFT_I16 = 4,
+    THRIFT_I32 = 5,
+    THRIFT_I64 = 6,
+    THRIFT_DOUBLE = 7,
+    THRIFT_BINARY = 8,
+    THRIFT_LIST = 9,
+    THRIFT_SET = 10,
+    THRIFT_MAP = 11,
+    THRIFT_STRUCT = 12,
+};
+
+// Minimal reader of the Thrift compact protocol, which is what Parquet uses for its footer and
+// page headers. Only the parts needed to walk Parquet structures are implemented.
+class ThriftCompactReader {
+   public:
+    ThriftCompactReader(const uint8_t* data, uint64_t len) : data(data), len(len), pos(0) {
+    }
+
+    uint64_t getPos() const {
+        return pos;
+    }
+
+    uint8_t readByte() {
+        S3_CHECK_OR_DIE(pos < len, S3RuntimeError, "Truncated Parquet metadata");
+        return data[pos++];
+    }
+
+    uint64_t readVarint() {
+        uint64_t result = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t b = readByte();
+            result |= (uint64_t)(b & 0x7f) << shift;
+            if ((b & 0x80) == 0) {
+                return result;
+            }
+        }
+        S3_DIE(S3RuntimeError, "Invalid varint in Parquet metadata");
+    }
+
+    int64_t readZigZag() {
+        uint64_t v = readVarint();
+        return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+    }
+
+    int32_t readI32() {
+        return (int32_t)readZigZag();
+    }
+
+    int64_t readI64() {
+        return readZigZag();
+    }
+
+    double readDouble() {
+        S3_CHECK_OR_DIE(pos + 8 <= len, S3RuntimeError, "Truncated Parquet metadata");
+        double d;
+        memcpy(&d, data + pos, 8);
+        pos += 8;
+        return d;
+    }
+
+    string readBinary() {
+        uint64_t n = readVarint();
+        S3_CHECK_OR_DIE(n <= len - pos, S3RuntimeError, "Truncated Parquet metadata");
+        string s((const char*)data + pos, n);
+        pos += n;
+        return s;
+    }
+
+    // Read a field header. Return false on STOP. Boolean fields carry their value in the type.
+    bool readFieldHeader(int16_t& lastId, int16_t& fieldId, uint8_t& type) {
+        uint8_t b = readByte();
+        type = b & 0x0f;
+        if (type == THRIFT_STOP) {
+            return false;
+        }
+
+        uint8_t delta = b >> 4;
+        fieldId = delta != 0 ? lastId + delta : (int16_t)readZigZag();
+        lastId = fieldId;
+        return true;
+    }
+
+    void readListHeader(uint8_t& elemType, uint64_t& size) {
+        uint8_t b = readByte();
+        elemType = b & 0x0f;
+        size = b >> 4;
+        if (size == 15) {
+            size = readVarint();
+        }
+    }
+
+    void skip(uint8_t type) {
+        switch (type) {
+            case THRIFT_TRUE:
+            case THRIFT_FALSE:
+                break;
+            case THRIFT_BYTE:
+                readByte();
+                break;
+            case THRIFT_I16:
+            case THRIFT_I32:
+            case THRIFT_I64:
+                readVarint();
+                break;
+            case THRIFT_DOUBLE:
+                readDouble();
+                break;
+            case THRIFT_BINARY:
+                readBinary();
+                break;
+            case THRIFT_LIST:
+            case THRIFT_SET: {
+                uint8_t elemType;
+                uint64_t size;
+                readListHeader(elemType, size);
+                for (uint64_t i = 0; i < size; i++) {
+                    skipElement(elemType);
+                }
+                break;
+            }
+            case THRIFT_MAP: {
+                uint64_t size = readVarint();
+                if (size > 0) {
+                    uint8_t kv = readByte();
+                    for (uint64_t i = 0; i < size; i++) {
+                        skipElement(kv >> 4);
+                        skipElement(kv & 0x0f);
+                    }
+                }
+                break;
+            }
+            case THRIFT_STRUCT: {
+                int16_t lastId = 0, fieldId;
+                uint8_t fieldType;
+                while (readFieldHeader(lastId, fieldId, fieldType)) {
+                    skip(fieldType);
+                }
+                break;
+            }
+            default:
+                S3_DIE(S3RuntimeError, "Unknown Thrift type in Parquet metadata");
+        }
+    }
+
+   private:
+    // Inside containers booleans take a whole byte.
+    void skipElement(uint8_t type) {
+        if (type == THRIFT_TRUE || type == THRIFT_FALSE) {
+            readByte();
+        } else {
+            skip(type);
+        }
+    }
+
+    const uint8_t* data;
+    uint64_t len;
+    uint64_t pos;
+};
+
+struct ParquetPageHeader {
+    ParquetPageHeader()
+        : type(-1),
+          uncompressedSize(0),
+          compressedSize(0),
+          numValues(0),
+          encoding(PARQUET_ENCODING_PLAIN),
+          defLevelEncoding(PARQUET_ENCODING_RLE),
+          numNulls(0),
+          defLevelsLength(0),
+          repLevelsLength(0),
+          isCompressed(true) {
+    }
+
+    int32_t type;
+    int32_t uncompressedSize;
+    int32_t compressedSize;
+    int32_t numValues;
+    int32_t encoding;
+    int32_t defLevelEncoding;
+
+    // DATA_PAGE_V2 only
+    int32_t numNulls;
+    int32_t defLevelsLength;
+    int32_t repLevelsLength;
+    bool isCompressed;
+};
+
+static void parseStatistics(ThriftCompactReader& r, ParquetColumnChunk& chunk) {
+    int16_t lastId = 0, fieldId;
+    uint8_t type;
+    string legacyMin, legacyMax, minValue, maxValue;
+    bool hasLegacyMin = false, hasLegacyMax = false, hasMin = false, hasMax = false;
+
+    while (r.readFieldHeader(lastId, fieldId, type)) {
+        if (fieldId == 1 && type == THRIFT_BINARY) {
+            legacyMax = r.readBinary();
+            hasLegacyMax = true;
+        } else if (fieldId == 2 && type == THRIFT_BINARY) {
+            legacyMin = r.readBinary();
+            hasLegacyMin = true;
+        } else if (fieldId == 3 && type == THRIFT_I64) {
+            chunk.stats.nullCount = r.readI64();
+            chunk.stats.hasNullCount = true;
+        } else if (fieldId == 5 && type == THRIFT_BINARY) {
+            maxValue = r.readBinary();
+            hasMax = true;
+        } else if (fieldId == 6 && type == THRIFT_BINARY) {
+            minValue = r.readBinary();
+            hasMin = true;
+        } else {
+            r.skip(type);
+        }
+    }
+
+    if (hasMin && hasMax) {
+        chunk.stats.hasMinMax = true;
+        chunk.stats.minValue = minValue;
+        chunk.stats.maxValue = maxValue;
+        chunk.minMaxOrdered = true;
+    } else if (hasLegacyMin && hasLegacyMax) {
+        chunk.stats.hasMinMax = true;
+        chunk.stats.minValue = legacyMin;
+        chunk.stats.maxValue = legacyMax;
+        chunk.minMaxOrdered = false;
+    }
+}
+
+static void parseColumnMetaData(ThriftCompactReader& r, ParquetColumnChunk& chunk) {
+    int16_t lastId = 0, fieldId;
+    uint8_t type;
+
+    while (r.readFieldHeader(lastId, fieldId, type)) {
+        if (fieldId == 4 && type == THRIFT_I32) {
+            chunk.codec = r.readI32();
+        } else if (fieldId == 5 && type == THRIFT_I64) {
+            chunk.numValues = r.readI64();
+        } else if (fieldId == 7 && type == THRIFT_I64) {
+            chunk.totalCompressedSize = r.readI64();
+        } else if (fieldId == 9 && type == THRIFT_I64) {
+            chunk.dataPageOffset = r.readI64();
+        } else if (fieldId == 11 && type == THRIFT_I64) {
+            chunk.dictionaryPageOffset = r.readI64();
+        } else if (fieldId == 12 && type == THRIFT_STRUCT) {
+            parseStatistics(r, chunk);
+        } else {
+            r.skip(type);
+        }
+    }
+}
+
+static void parseColumnChunk(ThriftCompactReader& r, ParquetColumnChunk& chunk) {
+    int16_t lastId = 0, fieldId;
+    uint8_t type;
+
+    while (r.readFieldHeader(lastId, fieldId, type)) {
+        if (fieldId == 1 && type == THRIFT_BINARY) {
+            S3_CHECK_OR_DIE(r.readBinary().empty(), S3RuntimeError,
+                            "Parquet column chunks in external files are not supported");
+        } else if (fieldId == 3 && type == THRIFT_STRUCT) {
+            parseColumnMetaData(r, chunk);
+        } else {
+            r.skip(type);
+        }
+    }
+}
+
+static void parseRowGroup(ThriftCompactReader& r, ParquetRowGroup& rowGroup) {
+    int16_t lastId = 0, fieldId;
+    uint8_t type;
+
+    while (r.readFieldHeader(lastId, fieldId, type)) {
+        if (fieldId == 1 && type == THRIFT_LIST) {
+            uint8_t elemType;
+            uint64_t size;
+            r.readListHeader(elemType, size);
+            rowGroup.columns.resize(size);
+            for (uint64_t i = 0; i < size; i++) {
+                parseColumnChunk(r, rowGroup.columns[i]);
+            }
+        } else if (fieldId == 3 && type == THRIFT_I64) {
+            rowGroup.numRows = r.readI64();
+        } else {
+            r.skip(type);
+        }
+    }
+}
+
+// LogicalType is a union; DECIMAL(5), DATE(6) and TIMESTAMP(8) matter to us.
+static void parseLogicalType(ThriftCompactReader& r, ParquetColumnSchema& column) {
+    int16_t lastId = 0, fieldId;
+    uint8_t type;
+
+    while (r.readFieldHeader(lastId, fieldId, type)) {
+        if (fieldId == 1 && type == THRIFT_STRUCT) {
+            column.convertedType = PARQUET_CT_UTF8;
+            r.skip(type);
+        } else if (fieldId == 5 && type == THRIFT_STRUCT) {
+            int16_t decLastId = 0, decFieldId;
+            uint8_t decType;
+            column.convertedType = PARQUET_CT_DECIMAL;
+            while (r.readFieldHeader(decLastId, decFieldId, decType)) {
+                if (decFieldId == 1 && decType == THRIFT_I32) {
+                    column.scale = r.readI32();
+                } else {
+                    r.skip(decType);
+                }
+            }
+        } else if (fieldId == 6 && type == THRIFT_STRUCT) {
+            column.convertedType = PARQUET_CT_DATE;
+            r.skip(type);
+        } else if (fieldId == 8 && type == THRIFT_STRUCT) {
+            int16_t tsLastId = 0, tsFieldId;
+            uint8_t tsType;
+            while (r.readFieldHeader(tsLastId, tsFieldId, tsType)) {
+                if (tsFieldId != 2 || tsType != THRIFT_STRUCT) {
+                    r.skip(tsType);
+                    continue;
+                }
+
+                // TimeUnit union: MILLIS(1), MICROS(2), NANOS(3)
+                int16_t unitLastId = 0, unitFieldId;
+                uint8_t unitType;
+                while (r.readFieldHeader(unitLastId, unitFieldId, unitType)) {
+                    if (unitFieldId == 1) {
+                        column.convertedType = PARQUET_CT_TIMESTAMP_MILLIS;
+                    } else if (unitFieldId == 2) {
+                        column.convertedType = PARQUET_CT_TIMESTAMP_MICROS;
+                    } else if (unitFieldId == 3) {
+                        column.convertedType = PARQUET_CT_TIMESTAMP_NANOS;
+                    }
+                    r.skip(unitType);
+                }
+            }
+        } else {
+            r.skip(type);
+        }
+    }
+}
+
+static void parseSchemaElement(ThriftCompactReader& r, ParquetColumnSchema& column,
+                               int32_t& numChildren, int32_t& repetition) {
+    int16_t lastId = 0, fieldId;
+    uint8_t type;
+    bool hasLogicalType = false;
+    ParquetColumnSchema logical;
+
+    numChildren = 0;
+    repetition = 0;
+
+    while (r.readFieldHeader(lastId, fieldId, type)) {
+        if (fieldId == 1 && type == THRIFT_I32) {
+            column.physicalType = r.readI32();
+        } else if (fieldId == 2 && type == THRIFT_I32) {
+            column.typeLength = r.readI32();
+        } else if (fieldId == 3 && type == THRIFT_I32) {
+            repetition = r.readI32();
+        } else if (fieldId == 4 && type == THRIFT_BINARY) {
+            column.name = r.readBinary();
+        } else if (fieldId == 5 && type == THRIFT_I32) {
+            numChildren = r.readI32();
+        } else if (fieldId == 6 && type == THRIFT_I32) {
+            column.convertedType = r.readI32();
+        } else if (fieldId == 7 && type == THRIFT_I32) {
+            column.scale = r.readI32();
+        } else if (fieldId == 10 && type == THRIFT_STRUCT) {
+            parseLogicalType(r, logical);
+            hasLogicalType = true;
+        } else {
+            r.skip(type);
+        }
+    }
+
+    // LogicalType is authoritative when present, and the only way to express NANOS.
+    if (hasLogicalType && logical.convertedType != PARQUET_CT_NONE) {
+        column.convertedType = logical.convertedType;
+        if (logical.convertedType == PARQUET_CT_DECIMAL) {
+            column.scale = logical.scale;
+        }
+    }
+
+    column.optional = (repetition == 1);
+}
+
+ParquetFileMetaData ParseParquetFooter(const uint8_t* data, uint64_t len) {
+    ThriftCompactReader r(data, len);
+    ParquetFileMetaData metaData;
+    int16_t lastId = 0, fieldId;
+    uint8_t type;
+
+    while (r.readFieldHeader(lastId, fieldId, type)) {
+        if (fieldId == 2 && type == THRIFT_LIST) {
+            uint8_t elemType;
+            uint64_t size;
+            r.readListHeader(elemType, size);
+            for (uint64_t i = 0; i < size; i++) {
+                ParquetColumnSchema column;
+                int32_t numChildren, repetition;
+                parseSchemaElement(r, column, numChildren, repetition);
+
+                // The first element is the root of the schema.
+                if (i == 0) {
+                    S3_CHECK_OR_DIE((uint64_t)numChildren == size - 1, S3RuntimeError,
+                                    "Nested Parquet schemas are not supported");
+                    continue;
+                }
+
+                S3_CHECK_OR_DIE(numChildren == 0, S3RuntimeError,
+                                "Nested Parquet column '" + column.name + "' is not supported");
+                S3_CHECK_OR_DIE(repetition != 2, S3RuntimeError,
+                                "Repeated Parquet column '" + column.name + "' is not supported");
+                metaData.columns.push_back(column);
+            }
+        } else if (fieldId == 3 && type == THRIFT_I64) {
+            metaData.numRows = r.readI64();
+        } else if (fieldId == 4 && type == THRIFT_LIST) {
+            uint8_t elemType;
+            uint64_t size;
+            r.readListHeader(elemType, size);
+            metaData.rowGroups.resize(size);
+            for (uint64_t i = 0; i < size; i++) {
+                parseRowGroup(r, metaData.rowGroups[i]);
+                S3_CHECK_OR_DIE(metaData.rowGroups[i].columns.size() == metaData.columns.size(),
+                                S3RuntimeError, "Parquet row group doesn't match the schema");
+            }
+        } else {
+            r.skip(type);
+        }
+    }
+
+    return metaData;
+}
+
+static void parseDataPageHeader(ThriftCompactReader& r, ParquetPageHeader& header) {
+    int16_t lastId = 0, fieldId;
+    uint8_t type;
+
+    while (r.readFieldHeader(lastId, fieldId, type)) {
+        if (fieldId == 1 && type == THRIFT_I32) {
+            header.numValues = r.readI32();
+        } else if (fieldId == 2 && type == THRIFT_I32) {
+            header.encoding = r.readI32();
+        } else if (fieldId == 3 && type == THRIFT_I32) {
+            header.defLevelEncoding = r.readI32();
+        } else {
+            r.skip(type);
+        }
+    }
+}
+
+static void parseDataPageHeaderV2(ThriftCompactReader& r, ParquetPageHeader& header) {
+    int16_t lastId = 0, fieldId;
+    uint8_t type;
+
+    while (r.readFieldHeader(lastId, fieldId, type)) {
+        if (fieldId == 1 && type == THRIFT_I32) {
+            header.numValues = r.readI32();
+        } else if (fieldId == 2 && type == THRIFT_I32) {
+            header.numNulls = r.readI32();
+        } else if (fieldId == 4 && type == THRIFT_I32) {
+            header.encoding = r.readI32();
+        } else if (fieldId == 5 && type == THRIFT_I32) {
+            header.defLevelsLength = r.readI32();
+        } else if (fieldId == 6 && type == THRIFT_I32) {
+            header.repLevelsLength = r.readI32();
+        } else if (fieldId == 7 && (type == THRIFT_TRUE || type == THRIFT_FALSE)) {
+            header.isCompressed = (type == THRIFT_TRUE);
+        } else {
+            r.skip(type);
+        }
+    }
+}
+
+static void parseDictionaryPageHeader(ThriftCompactReader& r, ParquetPageHeader& header) {
+    int16_t lastId = 0, fieldId;
+    uint8_t type;
+
+    while (r.readFieldHeader(lastId, fieldId, type)) {
+        if (fieldId == 1 && type == THRIFT_I32) {
+            header.numValues = r.readI32();
+        } else if (fieldId == 2 && type == THRIFT_I32) {
+            header.encoding = r.readI32();
+        } else {
+            r.skip(type);
+        }
+    }
+}
+
+static ParquetPageHeader parsePageHeader(ThriftCompactReader& r) {
+    ParquetPageHeader header;
+    int16_t lastId = 0, fieldId;
+    uint8_t type;
+
+    while (r.readFieldHeader(lastId, fieldId, type)) {
+        if (fieldId == 1 && type == THRIFT_I32) {
+            header.type = r.readI32();
+        } else if (fieldId == 2 && type == THRIFT_I32) {
+            header.uncompressedSize = r.readI32();
+        } else if (fieldId == 3 && type == THRIFT_I32) {
+            header.compressedSize = r.readI32();
+        } else if (fieldId == 5 && type == THRIFT_STRUCT) {
+            parseDataPageHeader(r, header);
+        } else if (fieldId == 7 && type == THRIFT_STRUCT) {
+            parseDictionaryPageHeader(r, header);
+        } else if (fieldId == 8 && type == THRIFT_STRUCT) {
+            parseDataPageHeaderV2(r, header);
+        } else {
+            r.skip(type);
+        }
+    }
+
+    S3_CHECK_OR_DIE(header.compressedSize >= 0 && header.uncompressedSize >= 0, S3RuntimeError,
+                    "Invalid Parquet page header");
+    return header;
+}
+
+// ================== Decompression ===================
+
+static void snappyUncompress(const uint8_t* in, uint64_t inLen, uint8_t* out, uint64_t outLen) {
+    uint64_t ip = 0, op = 0;
+
+    // preamble: uncompressed length as varint
+    uint64_t expected = 0;
+    for (int shift = 0;; shift += 7) {
+        S3_CHECK_OR_DIE(ip < inLen && shift < 64, S3RuntimeError, "Corrupted snappy data");
+        uint8_t b = in[ip++];
+        expected |= (uint64_t)(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) break;
+    }
+    S3_CHECK_OR_DIE(expected == outLen, S3RuntimeError, "Unexpected snappy uncompressed length");
+
+    while (ip < inLen) {
+        uint8_t tag = in[ip++];
+        uint64_t len, offset;
+
+        if ((tag & 3) == 0) {  // literal
+            len = (tag >> 2) + 1;
+            if (len > 60) {
+                uint64_t bytes = len - 60;
+                S3_CHECK_OR_DIE(ip + bytes <= inLen, S3RuntimeError, "Corrupted snappy data");
+                len = 0;
+                for (uint64_t i = 0; i < bytes; i++) {
+                    len |= (uint64_t)in[ip++] << (8 * i);
+                }
+                len += 1;
+            }
+            S3_CHECK_OR_DIE(ip + len <= inLen && op + len <= outLen, S3RuntimeError,
+                            "Corrupted snappy data");
+            memcpy(out + op, in + ip, len);
+            ip += len;
+            op += len;
+            continue;
+        }
+
+        if ((tag & 3) == 1) {
+            S3_CHECK_OR_DIE(ip + 1 <= inLen, S3RuntimeError, "Corrupted snappy data");
+            len = ((tag >> 2) & 7) + 4;
+            offset = ((uint64_t)(tag >> 5) << 8) | in[ip++];
+        } else if ((tag & 3) == 2) {
+            S3_CHECK_OR_DIE(ip + 2 <= inLen, S3RuntimeError, "Corrupted snappy data");
+            len = (tag >> 2) + 1;
+            offset = in[ip] | ((uint64_t)in[ip + 1] << 8);
+            ip += 2;
+        } else {
+            S3_CHECK_OR_DIE(ip + 4 <= inLen, S3RuntimeError, "Corrupted snappy data");
+            len = (tag >> 2) + 1;
+            offset = in[ip] | ((uint64_t)in[ip + 1] << 8) | ((uint64_t)in[ip + 2] << 16) |
+                     ((uint64_t)in[ip + 3] << 24);
+            ip += 4;
+        }
+
+        S3_CHECK_OR_DIE(offset > 0 && offset <= op && op + len <= outLen, S3RuntimeError,
+                        "Corrupted snappy data");
+        // byte by byte, the source may overlap with the destination
+        for (uint64_t i = 0; i < len; i++, op++) {
+            out[op] = out[op - offset];
+        }
+    }
+
+    S3_CHECK_OR_DIE(op == outLen, S3RuntimeError, "Corrupted snappy data");
+}
+
+static void gzipUncompress(const uint8_t* in, uint64_t inLen, uint8_t* out, uint64_t outLen) {
+    z_stream zstream;
+    memset(&zstream, 0, sizeof(zstream));
+
+    S3_CHECK_OR_DIE(inflateInit2(&zstream, S3_INFLATE_WINDOWSBITS) == Z_OK, S3RuntimeError,
+                    "Failed to initialize zlib");
+
+    zstream.next_in = (Bytef*)in;
+    zstream.avail_in = inLen;
+    zstream.next_out = (Bytef*)out;
+    zstream.avail_out = outLen;
+
+    int ret = inflate(&zstream, Z_FINISH);
+    uint64_t produced = zstream.total_out;
+    inflateEnd(&zstream);
+
+    S3_CHECK_OR_DIE(ret == Z_STREAM_END && produced == outLen, S3RuntimeError,
+                    "Failed to decompress gzip Parquet page");
+}
+
+static void uncompressPage(int32_t codec, const uint8_t* in, uint64_t inLen,
+                           vector<uint8_t>& out, uint64_t outLen) {
+    out.resize(outLen);
+    switch (codec) {
+        case PARQUET_CODEC_UNCOMPRESSED:
+            S3_CHECK_OR_DIE(inLen == outLen, S3RuntimeError, "Invalid uncompressed Parquet page");
+            memcpy(out.data(), in, inLen);
+            break;
+        case PARQUET_CODEC_SNAPPY:
+            snappyUncompress(in, inLen, out.data(), outLen);
+            break;
+        case PARQUET_CODEC_GZIP:
+            gzipUncompress(in, inLen, out.data(), outLen);
+            break;
+        default:
+            S3_DIE(S3RuntimeError, "Unsupported Parquet compression codec " +
+                                       std::to_string((long long)codec));
+    }
+}
+
+// ================== Value decoding ===================
+
+// Decoder of Parquet's RLE/bit-packing hybrid encoding, used for definition levels and
+// dictionary indices.
+class RleBitPackedDecoder {
+   public:
+    RleBitPackedDecoder(const uint8_t* data, uint64_t len, int bitWidth)
+        : data(data), len(len), pos(0), bitWidth(bitWidth), rleLeft(0), rleValue(0),
+          packedLeft(0), packedBitPos(0) {
+        S3_CHECK_OR_DIE(bitWidth >= 0 && bitWidth <= 32, S3RuntimeError,
+                        "Invalid bit width in Parquet page");
+    }
+
+    uint32_t next() {
+        while (rleLeft == 0 && packedLeft == 0) {
+            readRunHeader();
+        }
+
+        if (rleLeft > 0) {
+            rleLeft--;
+            return rleValue;
+        }
+
+        uint32_t value = 0;
+        for (int i = 0; i < bitWidth; i++, packedBitPos++) {
+            uint64_t byte = pos + packedBitPos / 8;
+            S3_CHECK_OR_DIE(byte < len, S3RuntimeError, "Truncated Parquet page");
+            value |= (uint32_t)((data[byte] >> (packedBitPos % 8)) & 1) << i;
+        }
+
+        if (--packedLeft == 0) {
+            pos += (packedBitPos + 7) / 8;
+            packedBitPos = 0;
+        }
+        return value;
+    }
+
+   private:
+    void readRunHeader() {
+        uint64_t header = 0;
+        for (int shift = 0;; shift += 7) {
+            S3_CHECK_OR_DIE(pos < len && shift < 64, S3RuntimeError, "Truncated Parquet page");
+            uint8_t b = data[pos++];
+            header |= (uint64_t)(b & 0x7f) << shift;
+            if ((b & 0x80) == 0) break;
+        }
+
+        if (header & 1) {
+            packedLeft = (header >> 1) * 8;
+            packedBitPos = 0;
+            S3_CHECK_OR_DIE(packedLeft > 0, S3RuntimeError, "Invalid bit-packed run");
+        } else {
+            rleLeft = header >> 1;
+            rleValue = 0;
+            int bytes = (bitWidth + 7) / 8;
+            S3_CHECK_OR_DIE(pos + bytes <= len, S3RuntimeError, "Truncated Parquet page");
+            for (int i = 0; i < bytes; i++) {
+                rleValue |= (uint32_t)data[pos++] << (8 * i);
+            }
+        }
+    }
+
+    const uint8_t* data;
+    uint64_t len;
+    uint64_t pos;
+    int bitWidth;
+
+    uint64_t rleLeft;
+    uint32_t rleValue;
+    uint64_t packedLeft;
+    uint64_t packedBitPos;
+};
+
+template <typename T>
+static T readLE(const uint8_t* p) {
+    T v;
+    memcpy(&v, p, sizeof(T));
+    return v;
+}
+
+// Decode "count" PLAIN values and append them to values.
+static void decodePlain(const ParquetColumnSchema& schema, const uint8_t* data, uint64_t len,
+                        uint64_t count, ParquetColumnValues& values) {
+    uint64_t pos = 0;
+
+    switch (schema.physicalType) {
+        case PARQUET_BOOLEAN:
+            S3_CHECK_OR_DIE((count + 7) / 8 <= len, S3RuntimeError, "Truncated Parquet page");
+            for (uint64_t i = 0; i < count; i++) {
+                values.ints.push_back((data[i / 8] >> (i % 8)) & 1);
+            }
+            break;
+        case PARQUET_INT32:
+            S3_CHECK_OR_DIE(count * 4 <= len, S3RuntimeError, "Truncated Parquet page");
+            for (uint64_t i = 0; i < count; i++) {
+                if (schema.convertedType == PARQUET_CT_UINT_32) {
+                    values.ints.push_back(readLE<uint32_t>(data + i * 4));
+                } else {
+                    values.ints.push_back(readLE<int32_t>(data + i * 4));
+                }
+            }
+            break;
+        case PARQUET_INT64:
+            S3_CHECK_OR_DIE(count * 8 <= len, S3RuntimeError, "Truncated Parquet page");
+            for (uint64_t i = 0; i < count; i++) {
+                values.ints.push_back(readLE<int64_t>(data + i * 8));
+            }
+            break;
+        case PARQUET_FLOAT:
+            S3_CHECK_OR_DIE(count * 4 <= len, S3RuntimeError, "Truncated Parquet page");
+            for (uint64_t i = 0; i < count; i++) {
+                values.doubles.push_back(readLE<float>(data + i * 4));
+            }
+            break;
+        case PARQUET_DOUBLE:
+            S3_CHECK_OR_DIE(count * 8 <= len, S3RuntimeError, "Truncated Parquet page");
+            for (uint64_t i = 0; i < count; i++) {
+                values.doubles.push_back(readLE<double>(data + i * 8));
+            }
+            break;
+        case PARQUET_INT96:
+            S3_CHECK_OR_DIE(count * 12 <= len, S3RuntimeError, "Truncated Parquet page");
+            for (uint64_t i = 0; i < count; i++) {
+                values.strings.push_back(string((const char*)data + i * 12, 12));
+            }
+            break;
+        case PARQUET_BYTE_ARRAY:
+            for (uint64_t i = 0; i < count; i++) {
+                S3_CHECK_OR_DIE(pos + 4 <= len, S3RuntimeError, "Truncated Parquet page");
+                uint32_t n = readLE<uint32_t>(data + pos);
+                pos += 4;
+                S3_CHECK_OR_DIE(n <= len - pos, S3RuntimeError, "Truncated Parquet page");
+                values.strings.push_back(string((const char*)data + pos, n));
+                pos += n;
+            }
+            break;
+        case PARQUET_FIXED_LEN_BYTE_ARRAY:
+            S3_CHECK_OR_DIE(count * schema.typeLength <= len, S3RuntimeError,
+                            "Truncated Parquet page");
+            for (uint64_t i = 0; i < count; i++) {
+                values.strings.push_back(
+                    string((const char*)data + i * schema.typeLength, schema.typeLength));
+            }
+            break;
+        default:
+            S3_DIE(S3RuntimeError, "Unknown Parquet physical type");
+    }
+}
+
+static void appendFromDictionary(const ParquetColumnSchema& schema,
+                                 const ParquetColumnValues& dict, uint32_t index,
+                                 ParquetColumnValues& values) {
+    switch (schema.physicalType) {
+        case PARQUET_FLOAT:
+        case PARQUET_DOUBLE:
+            S3_CHECK_OR_DIE(index < dict.doubles.size(), S3RuntimeError,
+                            "Invalid Parquet dictionary index");
+            values.doubles.push_back(dict.doubles[index]);
+            break;
+        case PARQUET_INT96:
+        case PARQUET_BYTE_ARRAY:
+        case PARQUET_FIXED_LEN_BYTE_ARRAY:
+            S3_CHECK_OR_DIE(index < dict.strings.size(), S3RuntimeError,
+                            "Invalid Parquet dictionary index");
+            values.strings.push_back(dict.strings[index]);
+            break;
+        default:
+            S3_CHECK_OR_DIE(index < dict.ints.size(), S3RuntimeError,
+                            "Invalid Parquet dictionary index");
+            values.ints.push_back(dict.ints[index]);
+            break;
+    }
+}
+
+static void decodeValues(const ParquetColumnSchema& schema, int32_t encoding,
+                         const ParquetColumnValues& dict, bool hasDict, const uint8_t* data,
+                         uint64_t len, uint64_t count, ParquetColumnValues& values) {
+    if (encoding == PARQUET_ENCODING_PLAIN) {
+        decodePlain(schema, data, len, count, values);
+    } else if (encoding == PARQUET_ENCODING_PLAIN_DICTIONARY ||
+               encoding == PARQUET_ENCODING_RLE_DICTIONARY) {
+        S3_CHECK_OR_DIE(hasDict, S3RuntimeError, "Parquet page refers to a missing dictionary");
+        if (count == 0) {
+            return;
+        }
+        S3_CHECK_OR_DIE(len >= 1, S3RuntimeError, "Truncated Parquet page");
+
+        RleBitPackedDecoder decoder(data + 1, len - 1, data[0]);
+        for (uint64_t i = 0; i < count; i++) {
+            appendFromDictionary(schema, dict, decoder.next(), values);
+        }
+    } else {
+        S3_DIE(S3RuntimeError, "Unsupported Parquet encoding " +
+                                   std::to_string((long long)encoding) + " of column '" +
+                                   schema.name + "'");
+    }
+}
+
+// Decode definition levels (max level 1) into null flags, and return the number of non-nulls.
+static uint64_t decodeNulls(const uint8_t* data, uint64_t len, uint64_t count,
+                            ParquetColumnValues& values) {
+    RleBitPackedDecoder decoder(data, len, 1);
+    uint64_t nonNulls = 0;
+
+    for (uint64_t i = 0; i < count; i++) {
+        uint32_t level = decoder.next();
+        values.nulls.push_back(level == 0);
+        nonNulls += (level != 0);
+    }
+
+    return nonNulls;
+}
+
+void DecodeParquetColumnChunk(const ParquetColumnSchema& schema, const ParquetColumnChunk& chunk,
+                              const uint8_t* data, uint64_t len, int64_t numRows,
+                              ParquetColumnValues& values) {
+    ParquetColumnValues dict;
+    bool hasDict = false;
+    vector<uint8_t> page;
+    uint64_t pos = 0;
+
+    values.clear();
+    values.nulls.reserve(numRows);
+
+    while ((int64_t)values.nulls.size() < numRows) {
+        S3_CHECK_OR_DIE(pos < len, S3RuntimeError,
+                        "Parquet column chunk of '" + schema.name + "' ended early");
+
+        ThriftCompactReader r(data + pos, len - pos);
+        ParquetPageHeader header = parsePageHeader(r);
+        pos += r.getPos();
+
+        S3_CHECK_OR_DIE((uint64_t)header.compressedSize <= len - pos, S3RuntimeError,
+                        "Truncated Parquet page of '" + schema.name + "'");
+        const uint8_t* body = data + pos;
+        pos += header.compressedSize;
+
+        if (header.type == PARQUET_DICTIONARY_PAGE) {
+            uncompressPage(chunk.codec, body, header.compressedSize, page,
+                           header.uncompressedSize);
+            dict.clear();
+            decodePlain(schema, page.data(), page.size(), header.numValues, dict);
+            hasDict = true;
+        } else if (header.type == PARQUET_DATA_PAGE) {
+            uncompressPage(chunk.codec, body, header.compressedSize, page,
+                           header.uncompressedSize);
+
+            const uint8_t* p = page.data();
+            uint64_t left = page.size();
+            uint64_t nonNulls = header.numValues;
+
+            if (schema.optional) {
+                S3_CHECK_OR_DIE(header.defLevelEncoding == PARQUET_ENCODING_RLE, S3RuntimeError,
+                                "Unsupported Parquet definition level encoding");
+                S3_CHECK_OR_DIE(left >= 4, S3RuntimeError, "Truncated Parquet page");
+                uint32_t levelsLen = readLE<uint32_t>(p);
+                S3_CHECK_OR_DIE(levelsLen <= left - 4, S3RuntimeError, "Truncated Parquet page");
+                nonNulls = decodeNulls(p + 4, levelsLen, header.numValues, values);
+                p += 4 + levelsLen;
+                left -= 4 + levelsLen;
+            } else {
+                values.nulls.insert(values.nulls.end(), header.numValues, 0);
+            }
+
+            decodeValues(schema, header.encoding, dict, hasDict, p, left, nonNulls, values);
+        } else if (header.type == PARQUET_DATA_PAGE_V2) {
+            uint64_t levelsLen = (uint64_t)header.defLevelsLength + header.repLevelsLength;
+            S3_CHECK_OR_DIE(levelsLen <= (uint64_t)header.compressedSize &&
+                                levelsLen <= (uint64_t)header.uncompressedSize,
+                            S3RuntimeError, "Invalid Parquet page header");
+
+            uint64_t nonNulls = header.numValues;
+            if (schema.optional) {
+                nonNulls = decodeNulls(body + header.repLevelsLength, header.defLevelsLength,
+                                       header.numValues, values);
+            } else {
+                values.nulls.insert(values.nulls.end(), header.numValues, 0);
+            }
+
+            if (header.isCompressed) {
+                uncompressPage(chunk.codec, body + levelsLen, header.compressedSize - levelsLen,
+                               page, header.uncompressedSize - levelsLen);
+            } else {
+                page.assign(body + levelsLen, body + header.compressedSize);
+            }
+
+            decodeValues(schema, header.encoding, dict, hasDict, page.data(), page.size(),
+                         nonNulls, values);
+        }
+        // index pages and unknown page types are skipped
+    }
+
+    S3_CHECK_OR_DIE((int64_t)values.nulls.size() == numRows, S3RuntimeError,
+                    "Parquet column chunk of '" + schema.name + "' has too many values");
+}
+
+// ================== Statistics ===================
+
+template <typename T>
+static int compareValues(T a, T b) {
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+// True if a value comparing to the constant as "minCmp" (min vs const) and "maxCmp" (max vs
+// const) may satisfy the qual.
+static bool rangeMayMatch(ParquetQualOp op, int minCmp, int maxCmp) {
+    switch (op) {
+        case PARQUET_QUAL_EQ:
+            return minCmp <= 0 && maxCmp >= 0;
+        case PARQUET_QUAL_LT:
+            return minCmp < 0;
+        case PARQUET_QUAL_LE:
+            return minCmp <= 0;
+        case PARQUET_QUAL_GT:
+            return maxCmp > 0;
+        case PARQUET_QUAL_GE:
+            return maxCmp >= 0;
+    }
+    return true;
+}
+
+static bool decodeIntStat(const ParquetColumnSchema& schema, const string& s, int64_t& v) {
+    if (schema.physicalType == PARQUET_INT32 && s.size() == 4) {
+        v = readLE<int32_t>((const uint8_t*)s.data());
+        return true;
+    }
+    if (schema.physicalType == PARQUET_INT64 && s.size() == 8) {
+        v = readLE<int64_t>((const uint8_t*)s.data());
+        return true;
+    }
+    return false;
+}
+
+static bool decodeDoubleStat(const ParquetColumnSchema& schema, const string& s, double& v) {
+    if (schema.physicalType == PARQUET_FLOAT && s.size() == 4) {
+        v = readLE<float>((const uint8_t*)s.data());
+        return !std::isnan(v);
+    }
+    if (schema.physicalType == PARQUET_DOUBLE && s.size() == 8) {
+        v = readLE<double>((const uint8_t*)s.data());
+        return !std::isnan(v);
+    }
+    int64_t i;
+    if (decodeIntStat(schema, s, i)) {
+        v = (double)i;
+        return true;
+    }
+    return false;
+}
+
+static int64_t floorDiv(int64_t a, int64_t b) {
+    return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+}
+
+bool ParquetChunkMayMatch(const ParquetColumnSchema& schema, const ParquetColumnChunk& chunk,
+                          int64_t numRows, const ParquetQual& qual) {
+    const ParquetColumnStats& stats = chunk.stats;
+
+    // Comparisons are never true for NULLs.
+    if (stats.hasNullCount && numRows > 0 && stats.nullCount >= numRows) {
+        return false;
+    }
+
+    if (!stats.hasMinMax) {
+        return true;
+    }
+
+    int ct = schema.convertedType;
+    // Unsigned and decimal columns don't compare like their physical type, leave them alone.
+    bool isPlainInt =
+        (schema.physicalType == PARQUET_INT32 || schema.physicalType == PARQUET_INT64) &&
+        (ct == PARQUET_CT_NONE || (ct >= PARQUET_CT_INT_8 && ct <= PARQUET_CT_INT_64));
+    bool isFloat =
+        schema.physicalType == PARQUET_FLOAT || schema.physicalType == PARQUET_DOUBLE;
+
+    switch (qual.kind) {
+        case PARQUET_QUAL_INT: {
+            int64_t minV, maxV;
+            if (isPlainInt && decodeIntStat(schema, stats.minValue, minV) &&
+                decodeIntStat(schema, stats.maxValue, maxV)) {
+                return rangeMayMatch(qual.op, compareValues(minV, qual.intValue),
+                                     compareValues(maxV, qual.intValue));
+            }
+            double minD, maxD;
+            if (isFloat && decodeDoubleStat(schema, stats.minValue, minD) &&
+                decodeDoubleStat(schema, stats.maxValue, maxD)) {
+                return rangeMayMatch(qual.op, compareValues(minD, (double)qual.intValue),
+                                     compareValues(maxD, (double)qual.intValue));
+            }
+            return true;
+        }
+        case PARQUET_QUAL_DOUBLE: {
+            double minD, maxD;
+            if ((isFloat || isPlainInt) && decodeDoubleStat(schema, stats.minValue, minD) &&
+                decodeDoubleStat(schema, stats.maxValue, maxD)) {
+                return rangeMayMatch(qual.op, compareValues(minD, qual.doubleValue),
+                                     compareValues(maxD, qual.doubleValue));
+            }
+            return true;
+        }
+        case PARQUET_QUAL_DATE: {
+            int64_t minV, maxV;
+            if (ct == PARQUET_CT_DATE && decodeIntStat(schema, stats.minValue, minV) &&
+                decodeIntStat(schema, stats.maxValue, maxV)) {
+                return rangeMayMatch(qual.op, compareValues(minV, qual.intValue),
+                                     compareValues(maxV, qual.intValue));
+            }
+            return true;
+        }
+        case PARQUET_QUAL_TIMESTAMP: {
+            int64_t minV, maxV;
+            if (schema.physicalType != PARQUET_INT64 ||
+                !decodeIntStat(schema, stats.minValue, minV) ||
+                !decodeIntStat(schema, stats.maxValue, maxV)) {
+                return true;
+            }
+
+            // normalize to microseconds, rounding the range outwards
+            if (ct == PARQUET_CT_TIMESTAMP_MILLIS) {
+                minV *= 1000;
+                maxV *= 1000;
+            } else if (ct == PARQUET_CT_TIMESTAMP_NANOS) {
+                minV = floorDiv(minV, 1000);
+                maxV = -floorDiv(-maxV, 1000);
+            } else if (ct != PARQUET_CT_TIMESTAMP_MICROS) {
+                return true;
+            }
+
+            return rangeMayMatch(qual.op, compareValues(minV, qual.intValue),
+                                 compareValues(maxV, qual.intValue));
+        }
+        case PARQUET_QUAL_STRING:
+            // Only equality is safe: the server may sort text with a non-C collation, while
+            // Parquet orders byte arrays as unsigned bytes.
+            if (qual.op == PARQUET_QUAL_EQ && chunk.minMaxOrdered &&
+                schema.physicalType == PARQUET_BYTE_ARRAY &&
+                (ct == PARQUET_CT_NONE || ct == PARQUET_CT_UTF8)) {
+                return rangeMayMatch(qual.op, stats.minValue.compare(qual.stringValue),
+                                     stats.maxValue.compare(qual.stringValue));
+            }
+            return true;
+    }
+
+    return true;
+}
+
+// ================== Formatting ===================
+
+// Convert days since 1970-01-01 to a civil date, see http://howardhinnant.github.io/date_algorithms.html
+static void civilFromDays(int64_t days, int64_t& y, unsigned& m, unsigned& d) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    unsigned doe = (unsigned)(days - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    y = (int64_t)yoe + era * 400;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y += (m <= 2);
+}
+
+static int formatDate(char* buf, size_t size, int64_t days) {
+    int64_t y;
+    unsigned m, d;
+    civilFromDays(days, y, m, d);
+    if (y <= 0) {
+        return snprintf(buf, size, "%04" PRId64 "-%02u-%02u BC", 1 - y, m, d);
+    }
+    return snprintf(buf, size, "%04" PRId64 "-%02u-%02u", y, m, d);
+}
+
+static int formatTimestamp(char* buf, size_t size, int64_t micros) {
+    int64_t days = floorDiv(micros, MICROS_PER_DAY);
+    int64_t rem = micros - days * MICROS_PER_DAY;
+    int64_t y;
+    unsigned m, d;
+    civilFromDays(days, y, m, d);
+
+    int64_t secs = rem / 1000000;
+    int64_t frac = rem % 1000000;
+    const char* era = "";
+    if (y <= 0) {
+        y = 1 - y;
+        era = " BC";
+    }
+
+    return snprintf(buf, size, "%04" PRId64 "-%02u-%02u %02d:%02d:%02d.%06d%s", y, m, d,
+                    (int)(secs / 3600), (int)(secs / 60 % 60), (int)(secs % 60), (int)frac, era);
+}
+
+static int formatDecimal(char* buf, size_t size, __int128 v, int32_t scale) {
+    char digits[64];
+    int n = 0;
+    bool negative = v < 0;
+    unsigned __int128 u = negative ? -(unsigned __int128)v : (unsigned __int128)v;
+
+    do {
+        digits[n++] = '0' + (int)(u % 10);
+        u /= 10;
+    } while (u != 0 && n < (int)sizeof(digits));
+
+    while (n <= scale && n < (int)sizeof(digits)) {
+        digits[n++] = '0';
+    }
+
+    int out = 0;
+    if (negative && out < (int)size - 1) buf[out++] = '-';
+    for (int i = n - 1; i >= 0 && out < (int)size - 2; i--) {
+        buf[out++] = digits[i];
+        if (i == scale && scale > 0) buf[out++] = '.';
+    }
+    buf[out] = '\0';
+    return out;
+}
+
+// Big-endian two's complement, as used by DECIMAL on (FIXED_LEN_)BYTE_ARRAY.
+static __int128 decodeBigEndianDecimal(const string& s) {
+    S3_CHECK_OR_DIE(s.size() <= 16, S3RuntimeError, "Parquet DECIMAL wider than 128 bits");
+    __int128 v = (s.size() > 0 && (s[0] & 0x80)) ? -1 : 0;
+    for (size_t i = 0; i < s.size(); i++) {
+        v = (__int128)(((unsigned __int128)v << 8) | (uint8_t)s[i]);
+    }
+    return v;
+}
+
+static int formatDouble(char* buf, size_t size, double v, bool isFloat) {
+    if (std::isnan(v)) return snprintf(buf, size, "NaN");
+    if (std::isinf(v)) return snprintf(buf, size, v > 0 ? "Infinity" : "-Infinity");
+    return snprintf(buf, size, isFloat ? "%.9g" : "%.17g", v);
+}
+
+// ================== ParquetReader ===================
+
+void ParquetReader::fetchRange(uint64_t offset, uint64_t len, vector<uint8_t>& out) {
+    uint64_t chunkSize = this->params.getChunkSize();
+    S3_CHECK_OR_DIE(chunkSize > 0, S3RuntimeError, "chunk size must be greater than zero");
+
+    out.clear();
+    out.reserve(len);
+
+    // Each fetch takes one preallocated chunk from the memory context, so never ask for more.
+    while (len > 0) {
+        uint64_t n = std::min(len, chunkSize);
+        S3VectorUInt8 piece(this->params.getMemoryContext());
+        uint64_t got = this->s3Interface->fetchData(offset, piece, n, this->params.getS3Url());
+        S3_CHECK_OR_DIE(got == n, S3PartialResponseError, n, got);
+
+        out.insert(out.end(), piece.begin(), piece.end());
+        this->fetchedBytes += n;
+
+        offset += n;
+        len -= n;
+    }
+}
+
+void ParquetReader::readFooter() {
+    uint64_t keySize = this->params.getKeySize();
+    S3_CHECK_OR_DIE(keySize >= 2 * PARQUET_MAGIC_LEN + 4, S3RuntimeError,
+                    "Key is too small to be a Parquet file");
+
+    vector<uint8_t> tail;
+    uint64_t tailLen = std::min(keySize, (uint64_t)PARQUET_FOOTER_PREFETCH);
+    this->fetchRange(keySize - tailLen, tailLen, tail);
+
+    S3_CHECK_OR_DIE(memcmp(tail.data() + tailLen - PARQUET_MAGIC_LEN, PARQUET_MAGIC,
+                           PARQUET_MAGIC_LEN) == 0,
+                    S3RuntimeError, "Key is not a Parquet file (magic number mismatch)");
+
+    uint64_t footerLen = readLE<uint32_t>(tail.data() + tailLen - PARQUET_MAGIC_LEN - 4);
+    S3_CHECK_OR_DIE(footerLen + PARQUET_MAGIC_LEN * 2 + 4 <= keySize, S3RuntimeError,
+                    "Invalid Parquet footer length");
+
+    if (footerLen + PARQUET_MAGIC_LEN + 4 > tailLen) {
+        // footer is larger than what we prefetched
+        this->fetchRange(keySize - PARQUET_MAGIC_LEN - 4 - footerLen, footerLen, tail);
+        this->metaData = ParseParquetFooter(tail.data(), footerLen);
+    } else {
+        this->metaData = ParseParquetFooter(
+            tail.data() + tailLen - PARQUET_MAGIC_LEN - 4 - footerLen, footerLen);
+    }
+
+    S3DEBUG("Parquet key %s: %zu columns, %zu row groups, %" PRId64 " rows",
+            this->params.getS3Url().getFullUrlForCurl().c_str(), this->metaData.columns.size(),
+            this->metaData.rowGroups.size(), this->metaData.numRows);
+}
+
+void ParquetReader::open(const S3Params& params) {
+    S3_CHECK_OR_DIE(this->s3Interface != NULL, S3RuntimeError, "s3Interface must not be NULL");
+
+    this->close();
+    this->params = params;
+
+    this->readFooter();
+
+    // Without a spec (e.g. gpcheckcloud), output every column of the file.
+    if (this->spec.columnNames.empty()) {
+        for (size_t i = 0; i < this->metaData.columns.size(); i++) {
+            this->spec.columnNames.push_back(this->metaData.columns[i].name);
+        }
+        this->spec.projected.assign(this->spec.columnNames.size(), true);
+    }
+
+    this->columnMap.assign(this->spec.columnNames.size(), -1);
+    for (size_t i = 0; i < this->spec.columnNames.size(); i++) {
+        for (size_t j = 0; j < this->metaData.columns.size(); j++) {
+            if (strcasecmp(this->spec.columnNames[i].c_str(),
+                           this->metaData.columns[j].name.c_str()) == 0) {
+                this->columnMap[i] = j;
+                break;
+            }
+        }
+
+        if (this->columnMap[i] < 0) {
+            S3WARN("Column \"%s\" is not found in Parquet key %s, it will be NULL",
+                   this->spec.columnNames[i].c_str(),
+                   this->params.getS3Url().getFullUrlForCurl().c_str());
+        }
+    }
+
+    this->columnValues.resize(this->spec.columnNames.size());
+    this->valueCursor.assign(this->spec.columnNames.size(), 0);
+}
+
+bool ParquetReader::loadNextRowGroup() {
+    while (this->rowGroupIndex < this->metaData.rowGroups.size()) {
+        const ParquetRowGroup& rowGroup = this->metaData.rowGroups[this->rowGroupIndex++];
+
+        bool mayMatch = true;
+        for (size_t i = 0; i < this->spec.quals.size() && mayMatch; i++) {
+            const ParquetQual& qual = this->spec.quals[i];
+            if (qual.column >= this->columnMap.size() || this->columnMap[qual.column] < 0) {
+                continue;
+            }
+
+            int64_t col = this->columnMap[qual.column];
+            mayMatch = ParquetChunkMayMatch(this->metaData.columns[col], rowGroup.columns[col],
+                                            rowGroup.numRows, qual);
+        }
+
+        if (!mayMatch) {
+            this->skippedRowGroups++;
+            S3DEBUG("Skipped Parquet row group %" PRIu64 " (%" PRId64 " rows) by statistics",
+                    this->rowGroupIndex - 1, rowGroup.numRows);
+            continue;
+        }
+
+        // Gather the byte ranges of projected column chunks, and merge nearby ones so that
+        // adjacent columns are fetched with one range GET.
+        vector<std::pair<uint64_t, uint64_t> > chunks;  // (start, table column)
+        for (size_t i = 0; i < this->spec.columnNames.size(); i++) {
+            this->columnValues[i].clear();
+            this->valueCursor[i] = 0;
+
+            if (this->spec.projected[i] && this->columnMap[i] >= 0) {
+                const ParquetColumnChunk& chunk = rowGroup.columns[this->columnMap[i]];
+                chunks.push_back(std::make_pair(chunk.startOffset(), i));
+            }
+        }
+        std::sort(chunks.begin(), chunks.end());
+
+        size_t first = 0;
+        vector<uint8_t> buffer;
+        while (first < chunks.size()) {
+            const ParquetColumnChunk& firstChunk =
+                rowGroup.columns[this->columnMap[chunks[first].second]];
+            uint64_t rangeStart = firstChunk.startOffset();
+            uint64_t rangeEnd = rangeStart + firstChunk.totalCompressedSize;
+
+            size_t last = first + 1;
+            for (; last < chunks.size(); last++) {
+                const ParquetColumnChunk& chunk =
+                    rowGroup.columns[this->columnMap[chunks[last].second]];
+                if (chunk.startOffset() > rangeEnd + PARQUET_COALESCE_GAP) {
+                    break;
+                }
+                rangeEnd = std::max(rangeEnd, chunk.startOffset() + chunk.totalCompressedSize);
+            }
+
+            S3_CHECK_OR_DIE(rangeEnd <= this->params.getKeySize(), S3RuntimeError,
+                            "Parquet column chunk is out of the key's range");
+            this->fetchRange(rangeStart, rangeEnd - rangeStart, buffer);
+
+            for (size_t k = first; k < last; k++) {
+                uint64_t column = chunks[k].second;
+                int64_t leaf = this->columnMap[column];
+                const ParquetColumnChunk& chunk = rowGroup.columns[leaf];
+
+                DecodeParquetColumnChunk(this->metaData.columns[leaf], chunk,
+                                         buffer.data() + (chunk.startOffset() - rangeStart),
+                                         chunk.totalCompressedSize, rowGroup.numRows,
+                                         this->columnValues[column]);
+            }
+
+            first = last;
+        }
+
+        this->rowGroupRows = rowGroup.numRows;
+        this->rowIndex = 0;
+        return true;
+    }
+
+    return false;
+}
+
+void ParquetReader::appendText(const char* p, uint64_t len) {
+    const ParquetScanSpec& spec = this->spec;
+
+    if (spec.csv) {
+        bool needQuote =
+            (len == spec.nullString.size() && memcmp(p, spec.nullString.data(), len) == 0);
+        for (uint64_t i = 0; i < len && !needQuote; i++) {
+            needQuote = p[i] == spec.delimiter || p[i] == spec.quote || p[i] == '\n' ||
+                        p[i] == '\r';
+        }
+
+        if (!needQuote) {
+            this->output.append(p, len);
+            return;
+        }
+
+        this->output.push_back(spec.quote);
+        for (uint64_t i = 0; i < len; i++) {
+            if (p[i] == spec.quote || p[i] == spec.escape) {
+                this->output.push_back(spec.escape);
+            }
+            this->output.push_back(p[i]);
+        }
+        this->output.push_back(spec.quote);
+        return;
+    }
+
+    if (spec.escape == '\0') {
+        this->output.append(p, len);
+        return;
+    }
+
+    for (uint64_t i = 0; i < len; i++) {
+        char c = p[i];
+        if (c == spec.escape || c == spec.delimiter) {
+            this->output.push_back(spec.escape);
+            this->output.push_back(c);
+        } else if (c == '\n') {
+            this->output.push_back(spec.escape);
+            this->output.push_back('n');
+        } else if (c == '\r') {
+            this->output.push_back(spec.escape);
+            this->output.push_back('r');
+        } else {
+            this->output.push_back(c);
+        }
+    }
+}
+
+void ParquetReader::appendValue(uint64_t column, uint64_t valueIndex) {
+    const ParquetColumnSchema& schema = this->metaData.columns[this->columnMap[column]];
+    const ParquetColumnValues& values = this->columnValues[column];
+    char buf[128];
+    int n = 0;
+
+    switch (schema.physicalType) {
+        case PARQUET_BOOLEAN:
+            n = snprintf(buf, sizeof(buf), "%s", values.ints[valueIndex] ? "t" : "f");
+            break;
+        case PARQUET_INT32:
+        case PARQUET_INT64: {
+            int64_t v = values.ints[valueIndex];
+            switch (schema.convertedType) {
+                case PARQUET_CT_DATE:
+                    n = formatDate(buf, sizeof(buf), v);
+                    break;
+                case PARQUET_CT_TIMESTAMP_MILLIS:
+                    n = formatTimestamp(buf, sizeof(buf), v * 1000);
+                    break;
+                case PARQUET_CT_TIMESTAMP_MICROS:
+                    n = formatTimestamp(buf, sizeof(buf), v);
+                    break;
+                case PARQUET_CT_TIMESTAMP_NANOS:
+                    n = formatTimestamp(buf, sizeof(buf), floorDiv(v, 1000));
+                    break;
+                case PARQUET_CT_DECIMAL:
+                    n = formatDecimal(buf, sizeof(buf), v, schema.scale);
+                    break;
+                case PARQUET_CT_UINT_64:
+                    n = snprintf(buf, sizeof(buf), "%" PRIu64, (uint64_t)v);
+                    break;
+                default:
+                    n = snprintf(buf, sizeof(buf), "%" PRId64, v);
+                    break;
+            }
+            break;
+        }
+        case PARQUET_FLOAT:
+        case PARQUET_DOUBLE:
+            n = formatDouble(buf, sizeof(buf), values.doubles[valueIndex],
+                             schema.physicalType == PARQUET_FLOAT);
+            break;
+        case PARQUET_INT96: {
+            // legacy Impala/Hive timestamp: nanoseconds of day, then Julian day
+            const uint8_t* p = (const uint8_t*)values.strings[valueIndex].data();
+            int64_t nanos = readLE<int64_t>(p);
+            int64_t julianDay = readLE<int32_t>(p + 8);
+            n = formatTimestamp(
+                buf, sizeof(buf),
+                (julianDay - PARQUET_UNIX_EPOCH_JULIAN_DAY) * MICROS_PER_DAY + nanos / 1000);
+            break;
+        }
+        default: {
+            const string& s = values.strings[valueIndex];
+            if (schema.convertedType == PARQUET_CT_DECIMAL) {
+                n = formatDecimal(buf, sizeof(buf), decodeBigEndianDecimal(s), schema.scale);
+                break;
+            }
+            this->appendText(s.data(), s.size());
+            return;
+        }
+    }
+
+    this->appendText(buf, std::min(n, (int)sizeof(buf) - 1));
+}
+
+void ParquetReader::formatRow(int64_t row) {
+    for (size_t i = 0; i < this->spec.columnNames.size(); i++) {
+        if (i > 0) {
+            this->output.push_back(this->spec.delimiter);
+        }
+
+        if (!this->spec.projected[i] || this->columnMap[i] < 0 ||
+            this->columnValues[i].nulls[row]) {
+            this->output.append(this->spec.nullString);
+            continue;
+        }
+
+        this->appendValue(i, this->valueCursor[i]++);
+    }
+
+    this->output.append(eolString);
+}
+
+uint64_t ParquetReader::read(char* buf, uint64_t count) {
+    while (this->outputPos >= this->output.size()) {
+        this->output.clear();
+        this->outputPos = 0;
+
+        if (this->rowIndex >= this->rowGroupRows && !this->loadNextRowGroup()) {
+            return 0;
+        }
+
+        while (this->rowIndex < this->rowGroupRows && this->output.size() < count) {
+            this->formatRow(this->rowIndex++);
+        }
+    }
+
+    uint64_t n = std::min(count, (uint64_t)(this->output.size() - this->outputPos));
+    memcpy(buf, this->output.data() + this->outputPos, n);
+    this->outputPos += n;
+
+    return n;
+}
+
+void ParquetReader::close() {
+    if (this->skippedRowGroups > 0) {
+        S3INFO("Skipped %" PRIu64 " of %zu Parquet row groups by statistics",
+               this->skippedRowGroups, this->metaData.rowGroups.size());
+    }
+
+    this->metaData = ParquetFileMetaData();
+    this->columnMap.clear();
+    this->columnValues.clear();
+    this->valueCursor.clear();
+    this->rowGroupIndex = 0;
+    this->rowIndex = 0;
+    this->rowGroupRows = 0;
+    this->output.clear();
+    this->outputPos = 0;
+    this->skippedRowGroups = 0;
+}
@@ -136,6 +136,16 @@ S3Params InitConfig(const string& urlWithOptions) {
 
     params.setGpcheckcloud_newline(s3Cfg.Get(configSection, "gpcheckcloud_newline", "\n"));
 
+    // file format is a property of the data, not of the account, so it comes from the URL
+    string fileFormat = GetOptS3(urlWithOptionsProcessed, "fileformat");
+    if (fileFormat.empty() || strcasecmp(fileFormat.c_str(), "text") == 0) {
+        params.setFileFormat(FILE_FORMAT_TEXT);
+    } else if (strcasecmp(fileFormat.c_str(), "parquet") == 0) {
+        params.setFileFormat(FILE_FORMAT_PARQUET);
+    } else {
+        S3_DIE(S3ConfigError, "\"FATAL: unknown fileformat '" + fileFormat + "'\"", "fileformat");
+    }
+
     CheckEssentialConfig(params);
 
     return params;
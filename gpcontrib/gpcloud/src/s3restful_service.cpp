@@ -1,5 +1,149 @@
 #include "s3restful_service.h"
 
+// Keep at most this many idle easy handles (and their connections) around.
+#define S3_CURL_MAX_IDLE_HANDLES 32
+
+// Idle curl easy handles are kept in a process-wide pool, so that the next request reuses their
+// kept-alive connections and TLS sessions, whichever key or chunk thread it is for. All handles
+// share one DNS and TLS session cache, and one connection cache if libcurl is new enough. The pool
+// is torn down when the last S3RESTfulService is destroyed, i.e. at the end of the query.
+class S3CurlHandlePool {
+   public:
+    static void addRef() {
+        UniqueLock lock(&poolMutex);
+
+        if (refCount++ > 0) {
+            return;
+        }
+
+        for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+            pthread_mutex_init(&shareMutexes[i], NULL);
+        }
+
+        share = curl_share_init();
+        if (share != NULL) {
+            curl_share_setopt(share, CURLSHOPT_LOCKFUNC, shareLock);
+            curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, shareUnlock);
+            curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+            curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900
+            curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+        }
+    }
+
+    static void release() {
+        UniqueLock lock(&poolMutex);
+
+        if (--refCount > 0) {
+            return;
+        }
+
+        for (size_t i = 0; i < idleHandles.size(); i++) {
+            curl_easy_cleanup(idleHandles[i]);
+        }
+        idleHandles.clear();
+
+        if (share != NULL) {
+            curl_share_cleanup(share);
+            share = NULL;
+        }
+
+        for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+            pthread_mutex_destroy(&shareMutexes[i]);
+        }
+
+        S3DEBUG("S3 connections: %" PRIu64 " requests, %" PRIu64 " new, %" PRIu64
+                " reused, %" PRIu64 " us in handshakes",
+                stats.requests, stats.newConnections, stats.reusedConnections, stats.handshakeUs);
+    }
+
+    static CURL *get() {
+        CURLSH *curlShare;
+        {
+            UniqueLock lock(&poolMutex);
+            if (!idleHandles.empty()) {
+                CURL *curl = idleHandles.back();
+                idleHandles.pop_back();
+                return curl;
+            }
+            curlShare = share;
+        }
+
+        CURL *curl = curl_easy_init();
+        S3_CHECK_OR_DIE(curl != NULL, S3RuntimeError, "Failed to create curl handle");
+
+        // curl_easy_reset() keeps the share, so this is set once per handle
+        if (curlShare != NULL) {
+            curl_easy_setopt(curl, CURLOPT_SHARE, curlShare);
+        }
+        return curl;
+    }
+
+    // Return a handle after use. Its options are reset, but its connections are kept.
+    static void put(CURL *curl) {
+        curl_easy_reset(curl);
+
+        UniqueLock lock(&poolMutex);
+        if (refCount > 0 && idleHandles.size() < S3_CURL_MAX_IDLE_HANDLES) {
+            idleHandles.push_back(curl);
+            return;
+        }
+
+        curl_easy_cleanup(curl);
+    }
+
+    static void recordRequest(CURL *curl, CURLcode res) {
+        long numConnects = 0;
+        double connectTime = 0, appConnectTime = 0, nameLookupTime = 0;
+
+        curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &numConnects);
+        curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME, &nameLookupTime);
+        curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME, &connectTime);
+        curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME, &appConnectTime);
+
+        UniqueLock lock(&poolMutex);
+        stats.requests++;
+        if (numConnects > 0) {
+            // APPCONNECT is 0 for plain HTTP
+            double handshake = std::max(connectTime, appConnectTime) - nameLookupTime;
+            stats.newConnections++;
+            stats.handshakeUs += (uint64_t)(std::max(handshake, 0.0) * 1000000);
+        } else if (res == CURLE_OK) {
+            stats.reusedConnections++;
+        }
+    }
+
+    static S3ConnectionStats getStats() {
+        UniqueLock lock(&poolMutex);
+        return stats;
+    }
+
+   private:
+    static void shareLock(CURL *handle, curl_lock_data data, curl_lock_access access,
+                          void *userptr) {
+        pthread_mutex_lock(&shareMutexes[data]);
+    }
+
+    static void shareUnlock(CURL *handle, curl_lock_data data, void *userptr) {
+        pthread_mutex_unlock(&shareMutexes[data]);
+    }
+
+    static pthread_mutex_t poolMutex;
+    static uint64_t refCount;
+    static vector<CURL *> idleHandles;
+    static CURLSH *share;
+    static pthread_mutex_t shareMutexes[CURL_LOCK_DATA_LAST];
+    static S3ConnectionStats stats;
+};
+
+pthread_mutex_t S3CurlHandlePool::poolMutex = PTHREAD_MUTEX_INITIALIZER;
+uint64_t S3CurlHandlePool::refCount = 0;
+vector<CURL *> S3CurlHandlePool::idleHandles;
+CURLSH *S3CurlHandlePool::share = NULL;
+pthread_mutex_t S3CurlHandlePool::shareMutexes[CURL_LOCK_DATA_LAST];
+S3ConnectionStats S3CurlHandlePool::stats;
+
 S3RESTfulService::S3RESTfulService()
     : lowSpeedLimit(0),
       lowSpeedTime(0),
@@ -7,6 +151,7 @@ S3RESTfulService::S3RESTfulService()
       debugCurl(false),
       verifyCert(true),
       chunkBufferSize(64 * 1024) {
+    S3CurlHandlePool::addRef();
 }
 
 S3RESTfulService::S3RESTfulService(const string &proxy)
@@ -16,6 +161,7 @@ S3RESTfulService::S3RESTfulService(const string &proxy)
       debugCurl(false),
       verifyCert(true),
       chunkBufferSize(64 * 1024) {
+    S3CurlHandlePool::addRef();
 }
 
 S3RESTfulService::S3RESTfulService(const S3Params &params)
@@ -30,14 +176,23 @@ S3RESTfulService::S3RESTfulService(const S3Params &params)
     this->chunkBufferSize = params.getChunkSize();
     this->verifyCert = params.isVerifyCert();
     this->proxy = params.getProxy();
+
+    S3CurlHandlePool::addRef();
 }
 
 S3RESTfulService::~S3RESTfulService() {
+    // Pooled handles must be gone before curl_global_cleanup().
+    S3CurlHandlePool::release();
+
     // This function is not thread safe, must NOT call it when any other
     // threads are running, that is, do NOT put it in threads.
     curl_global_cleanup();
 }
 
+S3ConnectionStats S3RESTfulService::getConnectionStats() {
+    return S3CurlHandlePool::getStats();
+}
+
 // curl's write function callback.
 static size_t RESTfulServiceWriteFuncCallback(char *ptr, size_t size, size_t nmemb, void *userp) {
     if (S3QueryIsAbortInProgress()) {
@@ -97,10 +252,12 @@ static size_t RESTfulServiceReadFuncCallback(char *ptr, size_t size, size_t nmem
 struct CURLWrapper {
     CURLWrapper(const string &url, curl_slist *headers, uint64_t lowSpeedLimit,
                 uint64_t lowSpeedTime, bool debugCurl, string proxy) {
-        curl = curl_easy_init();
+        curl = S3CurlHandlePool::get();
         curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl, CURLOPT_FORBID_REUSE, 1L);
         curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+#if LIBCURL_VERSION_NUM >= 0x071900
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+#endif
         curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
         curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, lowSpeedLimit);
         curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, lowSpeedTime);
@@ -114,13 +271,15 @@ struct CURLWrapper {
         }
     }
     ~CURLWrapper() {
-        curl_easy_cleanup(curl);
+        S3CurlHandlePool::put(curl);
     }
     CURL *curl;
 };
 
 void S3RESTfulService::performCurl(CURL *curl, Response &response) {
     CURLcode res = curl_easy_perform(curl);
+    S3CurlHandlePool::recordRequest(curl, res);
+
     if (res != CURLE_OK) {
         if (res == CURLE_COULDNT_RESOLVE_HOST || res == CURLE_COULDNT_RESOLVE_PROXY) {
             S3_DIE(S3ResolveError, curl_easy_strerror(res));
@@ -0,0 +1,538 @@
+#include "parquet_reader.cpp"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "mock_classes.h"
+
+using ::testing::_;
+using ::testing::AtLeast;
+using ::testing::Invoke;
+
+// ================== Parquet file builder ===================
+
+// Writes the Thrift compact protocol, just enough to build Parquet footers and page headers.
+class ThriftCompactWriter {
+   public:
+    ThriftCompactWriter() {
+        lastIds.push_back(0);
+    }
+
+    void field(int16_t id, uint8_t type) {
+        int16_t delta = id - lastIds.back();
+        if (delta > 0 && delta <= 15) {
+            out.push_back((char)((delta << 4) | type));
+        } else {
+            out.push_back((char)type);
+            varint(((uint64_t)id << 1) ^ (uint64_t)(id >> 15));
+        }
+        lastIds.back() = id;
+    }
+
+    void i32(int16_t id, int32_t v) {
+        field(id, THRIFT_I32);
+        zigzag(v);
+    }
+
+    void i64(int16_t id, int64_t v) {
+        field(id, THRIFT_I64);
+        zigzag(v);
+    }
+
+    void binary(int16_t id, const string& s) {
+        field(id, THRIFT_BINARY);
+        varint(s.size());
+        out += s;
+    }
+
+    void beginStruct(int16_t id) {
+        field(id, THRIFT_STRUCT);
+        lastIds.push_back(0);
+    }
+
+    void beginListOfStructs(int16_t id, uint64_t size) {
+        field(id, THRIFT_LIST);
+        out.push_back((char)((std::min(size, (uint64_t)15) << 4) | THRIFT_STRUCT));
+        if (size >= 15) {
+            varint(size);
+        }
+    }
+
+    void beginListElement() {
+        lastIds.push_back(0);
+    }
+
+    void end() {
+        out.push_back((char)THRIFT_STOP);
+        lastIds.pop_back();
+    }
+
+    void varint(uint64_t v) {
+        while (v >= 0x80) {
+            out.push_back((char)((v & 0x7f) | 0x80));
+            v >>= 7;
+        }
+        out.push_back((char)v);
+    }
+
+    void zigzag(int64_t v) {
+        varint(((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+    }
+
+    string out;
+
+   private:
+    vector<int16_t> lastIds;
+};
+
+template <typename T>
+static string plainValue(T v) {
+    return string((const char*)&v, sizeof(T));
+}
+
+static string plainByteArray(const string& s) {
+    return plainValue<uint32_t>(s.size()) + s;
+}
+
+// Definition levels of an optional column (1 = present), as a v1 page prefix.
+static string defLevels(const vector<bool>& present) {
+    string levels;
+    uint64_t groups = (present.size() + 7) / 8;
+    levels.push_back((char)((groups << 1) | 1));  // bit-packed run
+    for (uint64_t g = 0; g < groups; g++) {
+        uint8_t b = 0;
+        for (uint64_t i = 0; i < 8 && g * 8 + i < present.size(); i++) {
+            b |= present[g * 8 + i] << i;
+        }
+        levels.push_back((char)b);
+    }
+    return plainValue<uint32_t>(levels.size()) + levels;
+}
+
+static string pageHeader(int32_t type, const string& body, int32_t numValues, int32_t encoding) {
+    ThriftCompactWriter w;
+    w.i32(1, type);
+    w.i32(2, body.size());
+    w.i32(3, body.size());
+    if (type == PARQUET_DICTIONARY_PAGE) {
+        w.beginStruct(7);
+        w.i32(1, numValues);
+        w.i32(2, encoding);
+        w.end();
+    } else {
+        w.beginStruct(5);
+        w.i32(1, numValues);
+        w.i32(2, encoding);
+        w.i32(3, PARQUET_ENCODING_RLE);
+        w.i32(4, PARQUET_ENCODING_RLE);
+        w.end();
+    }
+    w.end();
+    return w.out + body;
+}
+
+struct TestColumn {
+    TestColumn(const string& name, int32_t type, int32_t convertedType, bool optional)
+        : name(name), type(type), convertedType(convertedType), optional(optional) {
+    }
+
+    string name;
+    int32_t type;
+    int32_t convertedType;
+    bool optional;
+};
+
+struct TestChunk {
+    TestChunk() : hasStats(false), nullCount(0) {
+    }
+
+    string pages;
+    bool hasStats;
+    string minValue;
+    string maxValue;
+    int64_t nullCount;
+};
+
+struct TestRowGroup {
+    int64_t numRows;
+    vector<TestChunk> chunks;
+};
+
+static string buildParquetFile(const vector<TestColumn>& columns,
+                               const vector<TestRowGroup>& rowGroups) {
+    string file = PARQUET_MAGIC;
+    vector<vector<int64_t> > offsets(rowGroups.size());
+
+    for (size_t g = 0; g < rowGroups.size(); g++) {
+        for (size_t c = 0; c < columns.size(); c++) {
+            offsets[g].push_back(file.size());
+            file += rowGroups[g].chunks[c].pages;
+        }
+    }
+
+    int64_t numRows = 0;
+    for (size_t g = 0; g < rowGroups.size(); g++) {
+        numRows += rowGroups[g].numRows;
+    }
+
+    ThriftCompactWriter w;
+    w.i32(1, 1);
+    w.beginListOfStructs(2, columns.size() + 1);
+    w.beginListElement();
+    w.binary(4, "schema");
+    w.i32(5, columns.size());
+    w.end();
+    for (size_t c = 0; c < columns.size(); c++) {
+        w.beginListElement();
+        w.i32(1, columns[c].type);
+        w.i32(3, columns[c].optional ? 1 : 0);
+        w.binary(4, columns[c].name);
+        if (columns[c].convertedType != PARQUET_CT_NONE) {
+            w.i32(6, columns[c].convertedType);
+        }
+        w.end();
+    }
+    w.i64(3, numRows);
+    w.beginListOfStructs(4, rowGroups.size());
+    for (size_t g = 0; g < rowGroups.size(); g++) {
+        w.beginListElement();
+        w.beginListOfStructs(1, columns.size());
+        for (size_t c = 0; c < columns.size(); c++) {
+            const TestChunk& chunk = rowGroups[g].chunks[c];
+            w.beginListElement();
+            w.i64(2, offsets[g][c]);
+            w.beginStruct(3);
+            w.i32(1, columns[c].type);
+            w.i32(4, PARQUET_CODEC_UNCOMPRESSED);
+            w.i64(5, rowGroups[g].numRows);
+            w.i64(6, chunk.pages.size());
+            w.i64(7, chunk.pages.size());
+            w.i64(9, offsets[g][c]);
+            if (chunk.hasStats) {
+                w.beginStruct(12);
+                w.i64(3, chunk.nullCount);
+                w.binary(5, chunk.maxValue);
+                w.binary(6, chunk.minValue);
+                w.end();
+            }
+            w.end();
+            w.end();
+        }
+        w.i64(3, rowGroups[g].numRows);
+        w.end();
+    }
+    w.end();
+
+    file += w.out;
+    file += plainValue<uint32_t>(w.out.size());
+    file += PARQUET_MAGIC;
+    return file;
+}
+
+// Two row groups of (id INT64 required, name UTF8 optional):
+// (1, 'a'), (2, NULL), (3, 'b\tc') and (10, 'd'), (11, 'e').
+static string buildTestFile() {
+    vector<TestColumn> columns;
+    columns.push_back(TestColumn("id", PARQUET_INT64, PARQUET_CT_NONE, false));
+    columns.push_back(TestColumn("name", PARQUET_BYTE_ARRAY, PARQUET_CT_UTF8, true));
+
+    vector<TestRowGroup> rowGroups(2);
+
+    rowGroups[0].numRows = 3;
+    rowGroups[0].chunks.resize(2);
+    rowGroups[0].chunks[0].pages =
+        pageHeader(PARQUET_DATA_PAGE, plainValue<int64_t>(1) + plainValue<int64_t>(2) +
+                   plainValue<int64_t>(3), 3, PARQUET_ENCODING_PLAIN);
+    rowGroups[0].chunks[0].hasStats = true;
+    rowGroups[0].chunks[0].minValue = plainValue<int64_t>(1);
+    rowGroups[0].chunks[0].maxValue = plainValue<int64_t>(3);
+
+    vector<bool> present;
+    present.push_back(true);
+    present.push_back(false);
+    present.push_back(true);
+    rowGroups[0].chunks[1].pages =
+        pageHeader(PARQUET_DATA_PAGE,
+                   defLevels(present) + plainByteArray("a") + plainByteArray("b\tc"), 3,
+                   PARQUET_ENCODING_PLAIN);
+
+    // second row group, name is dictionary encoded: dictionary ['d', 'e'], indices [0, 1]
+    rowGroups[1].numRows = 2;
+    rowGroups[1].chunks.resize(2);
+    rowGroups[1].chunks[0].pages =
+        pageHeader(PARQUET_DATA_PAGE, plainValue<int64_t>(10) + plainValue<int64_t>(11), 2,
+                   PARQUET_ENCODING_PLAIN);
+    rowGroups[1].chunks[0].hasStats = true;
+    rowGroups[1].chunks[0].minValue = plainValue<int64_t>(10);
+    rowGroups[1].chunks[0].maxValue = plainValue<int64_t>(11);
+
+    string indices;
+    indices.push_back(1);                   // bit width
+    indices.push_back((char)(1 << 1 | 1));  // one bit-packed group of 8
+    indices.push_back((char)0x02);          // 0, 1
+    present.assign(2, true);
+    rowGroups[1].chunks[1].pages =
+        pageHeader(PARQUET_DICTIONARY_PAGE, plainByteArray("d") + plainByteArray("e"), 2,
+                   PARQUET_ENCODING_PLAIN) +
+        pageHeader(PARQUET_DATA_PAGE, defLevels(present) + indices, 2,
+                   PARQUET_ENCODING_RLE_DICTIONARY);
+
+    return buildParquetFile(columns, rowGroups);
+}
+
+// Serve range GETs of fetchData() from an in-memory key, and record them.
+class MockFetchRange {
+   public:
+    MockFetchRange(const string& data, vector<std::pair<uint64_t, uint64_t> >& ranges)
+        : data(data), ranges(ranges) {
+    }
+
+    uint64_t operator()(uint64_t offset, S3VectorUInt8& out, uint64_t len, const S3Url& url) {
+        ranges.push_back(std::make_pair(offset, len));
+        out.assign(data.begin() + offset, data.begin() + offset + len);
+        return len;
+    }
+
+   private:
+    const string& data;
+    vector<std::pair<uint64_t, uint64_t> >& ranges;
+};
+
+// ================== ParquetFooterTest ===================
+
+TEST(ParquetFooterTest, ParseSchemaAndRowGroups) {
+    string file = buildTestFile();
+    uint32_t footerLen = readLE<uint32_t>((const uint8_t*)file.data() + file.size() - 8);
+
+    ParquetFileMetaData metaData =
+        ParseParquetFooter((const uint8_t*)file.data() + file.size() - 8 - footerLen, footerLen);
+
+    ASSERT_EQ((size_t)2, metaData.columns.size());
+    EXPECT_EQ("id", metaData.columns[0].name);
+    EXPECT_EQ(PARQUET_INT64, metaData.columns[0].physicalType);
+    EXPECT_FALSE(metaData.columns[0].optional);
+    EXPECT_EQ("name", metaData.columns[1].name);
+    EXPECT_EQ(PARQUET_CT_UTF8, metaData.columns[1].convertedType);
+    EXPECT_TRUE(metaData.columns[1].optional);
+
+    EXPECT_EQ(5, metaData.numRows);
+    ASSERT_EQ((size_t)2, metaData.rowGroups.size());
+    EXPECT_EQ(3, metaData.rowGroups[0].numRows);
+    EXPECT_TRUE(metaData.rowGroups[0].columns[0].stats.hasMinMax);
+    EXPECT_FALSE(metaData.rowGroups[0].columns[1].stats.hasMinMax);
+    EXPECT_EQ(4, metaData.rowGroups[0].columns[0].dataPageOffset);
+}
+
+TEST(ParquetFooterTest, TruncatedFooter) {
+    string file = buildTestFile();
+    uint32_t footerLen = readLE<uint32_t>((const uint8_t*)file.data() + file.size() - 8);
+
+    EXPECT_THROW(ParseParquetFooter((const uint8_t*)file.data() + file.size() - 8 - footerLen,
+                                    footerLen / 2),
+                 S3RuntimeError);
+}
+
+// ================== ParquetDecodeTest ===================
+
+TEST(ParquetDecodeTest, SnappyLiteralAndCopy) {
+    // "abc" literal, then a 9-byte copy at offset 3
+    const uint8_t compressed[] = {12, 0x08, 'a', 'b', 'c', 0x15, 3};
+    vector<uint8_t> out;
+
+    uncompressPage(PARQUET_CODEC_SNAPPY, compressed, sizeof(compressed), out, 12);
+    EXPECT_EQ("abcabcabcabc", string(out.begin(), out.end()));
+
+    EXPECT_THROW(uncompressPage(PARQUET_CODEC_SNAPPY, compressed, sizeof(compressed), out, 13),
+                 S3RuntimeError);
+}
+
+TEST(ParquetDecodeTest, RleAndBitPackedRuns) {
+    // RLE run of five 3s, then one bit-packed group of 8 2-bit values 0..3,0..3
+    const uint8_t data[] = {5 << 1, 3, (1 << 1) | 1, 0xe4, 0xe4};
+    RleBitPackedDecoder decoder(data, sizeof(data), 2);
+
+    for (int i = 0; i < 5; i++) {
+        EXPECT_EQ((uint32_t)3, decoder.next());
+    }
+    for (uint32_t i = 0; i < 8; i++) {
+        EXPECT_EQ(i % 4, decoder.next());
+    }
+    EXPECT_THROW(decoder.next(), S3RuntimeError);
+}
+
+TEST(ParquetDecodeTest, FormatValues) {
+    char buf[64];
+
+    formatDate(buf, sizeof(buf), 0);
+    EXPECT_STREQ("1970-01-01", buf);
+    formatDate(buf, sizeof(buf), -1);
+    EXPECT_STREQ("1969-12-31", buf);
+    formatTimestamp(buf, sizeof(buf), 1500000000123456LL);
+    EXPECT_STREQ("2017-07-14 02:40:00.123456", buf);
+    formatTimestamp(buf, sizeof(buf), -1);
+    EXPECT_STREQ("1969-12-31 23:59:59.999999", buf);
+    formatDecimal(buf, sizeof(buf), -12345, 2);
+    EXPECT_STREQ("-123.45", buf);
+    formatDecimal(buf, sizeof(buf), 5, 3);
+    EXPECT_STREQ("0.005", buf);
+    EXPECT_EQ(-2, (int)decodeBigEndianDecimal(string("\xff\xfe", 2)));
+}
+
+// ================== ParquetStatisticsTest ===================
+
+TEST(ParquetStatisticsTest, IntRange) {
+    ParquetColumnSchema schema;
+    schema.physicalType = PARQUET_INT64;
+    ParquetColumnChunk chunk;
+    chunk.stats.hasMinMax = true;
+    chunk.stats.minValue = plainValue<int64_t>(10);
+    chunk.stats.maxValue = plainValue<int64_t>(20);
+
+    ParquetQual qual;
+    qual.kind = PARQUET_QUAL_INT;
+    qual.intValue = 5;
+
+    qual.op = PARQUET_QUAL_EQ;
+    EXPECT_FALSE(ParquetChunkMayMatch(schema, chunk, 100, qual));
+    qual.op = PARQUET_QUAL_GT;
+    EXPECT_TRUE(ParquetChunkMayMatch(schema, chunk, 100, qual));
+    qual.op = PARQUET_QUAL_LE;
+    EXPECT_FALSE(ParquetChunkMayMatch(schema, chunk, 100, qual));
+
+    qual.intValue = 20;
+    qual.op = PARQUET_QUAL_GE;
+    EXPECT_TRUE(ParquetChunkMayMatch(schema, chunk, 100, qual));
+    qual.op = PARQUET_QUAL_GT;
+    EXPECT_FALSE(ParquetChunkMayMatch(schema, chunk, 100, qual));
+}
+
+TEST(ParquetStatisticsTest, NotSkippedWithoutUsableStats) {
+    ParquetColumnSchema schema;
+    schema.physicalType = PARQUET_INT64;
+    schema.convertedType = PARQUET_CT_UINT_64;
+    ParquetColumnChunk chunk;
+    chunk.stats.hasMinMax = true;
+    chunk.stats.minValue = plainValue<int64_t>(10);
+    chunk.stats.maxValue = plainValue<int64_t>(20);
+
+    ParquetQual qual;
+    qual.kind = PARQUET_QUAL_INT;
+    qual.intValue = 5;
+    EXPECT_TRUE(ParquetChunkMayMatch(schema, chunk, 100, qual));
+
+    // strings with legacy (unordered) statistics
+    schema.physicalType = PARQUET_BYTE_ARRAY;
+    schema.convertedType = PARQUET_CT_UTF8;
+    chunk.stats.minValue = "b";
+    chunk.stats.maxValue = "c";
+    chunk.minMaxOrdered = false;
+    qual.kind = PARQUET_QUAL_STRING;
+    qual.stringValue = "a";
+    EXPECT_TRUE(ParquetChunkMayMatch(schema, chunk, 100, qual));
+
+    chunk.minMaxOrdered = true;
+    EXPECT_FALSE(ParquetChunkMayMatch(schema, chunk, 100, qual));
+}
+
+TEST(ParquetStatisticsTest, AllNullsNeverMatch) {
+    ParquetColumnSchema schema;
+    ParquetColumnChunk chunk;
+    chunk.stats.hasNullCount = true;
+    chunk.stats.nullCount = 100;
+
+    ParquetQual qual;
+    EXPECT_FALSE(ParquetChunkMayMatch(schema, chunk, 100, qual));
+}
+
+// ================== ParquetReaderTest ===================
+
+class ParquetReaderTest : public testing::Test, public ParquetReader {
+   protected:
+    virtual void SetUp() {
+        this->setS3InterfaceService(&s3Interface);
+
+        file = buildTestFile();
+        params = S3Params("s3://abc/def.parquet");
+        params.setKeySize(file.size());
+        params.setChunkSize(8192);
+
+        EXPECT_CALL(s3Interface, fetchData(_, _, _, _))
+            .Times(AtLeast(1))
+            .WillRepeatedly(Invoke(MockFetchRange(file, ranges)));
+    }
+
+    string readAll() {
+        string result;
+        char buf[7];  // small on purpose, rows span read() calls
+        uint64_t n;
+        while ((n = this->read(buf, sizeof(buf))) > 0) {
+            result.append(buf, n);
+        }
+        return result;
+    }
+
+    MockS3Interface s3Interface;
+    S3Params params;
+    string file;
+    vector<std::pair<uint64_t, uint64_t> > ranges;
+};
+
+TEST_F(ParquetReaderTest, ReadAllColumns) {
+    this->open(params);
+
+    EXPECT_EQ("1\ta\n2\t\\N\n3\tb\\\tc\n10\td\n11\te\n", readAll());
+    EXPECT_EQ((uint64_t)0, this->getSkippedRowGroups());
+}
+
+TEST_F(ParquetReaderTest, ProjectionFetchesOnlyNeededColumns) {
+    ParquetScanSpec spec;
+    spec.columnNames.push_back("missing");
+    spec.columnNames.push_back("NAME");
+    spec.columnNames.push_back("id");
+    spec.projected.push_back(true);
+    spec.projected.push_back(true);
+    spec.projected.push_back(false);
+    spec.csv = true;
+    spec.escape = '"';
+    spec.nullString = "";
+    this->setScanSpec(spec);
+
+    this->open(params);
+
+    EXPECT_EQ("\ta\t\n\t\t\n\t\"b\tc\"\t\n\td\t\n\te\t\n", readAll());
+
+    // footer, plus one range per row group, none of them covering the "id" chunks
+    ASSERT_EQ((size_t)3, ranges.size());
+    const ParquetFileMetaData& metaData = this->getMetaData();
+    for (size_t g = 0; g < metaData.rowGroups.size(); g++) {
+        EXPECT_EQ(metaData.rowGroups[g].columns[1].startOffset(), ranges[g + 1].first);
+        EXPECT_EQ((uint64_t)metaData.rowGroups[g].columns[1].totalCompressedSize,
+                  ranges[g + 1].second);
+    }
+}
+
+TEST_F(ParquetReaderTest, SkipRowGroupsByStatistics) {
+    ParquetScanSpec spec;
+    spec.columnNames.push_back("id");
+    spec.columnNames.push_back("name");
+    spec.projected.assign(2, true);
+
+    ParquetQual qual;
+    qual.column = 0;
+    qual.op = PARQUET_QUAL_GE;
+    qual.kind = PARQUET_QUAL_INT;
+    qual.intValue = 5;
+    spec.quals.push_back(qual);
+    this->setScanSpec(spec);
+
+    this->open(params);
+
+    EXPECT_EQ("10\td\n11\te\n", readAll());
+    EXPECT_EQ((uint64_t)1, this->getSkippedRowGroups());
+    EXPECT_EQ((size_t)2, ranges.size());
+}
+
+TEST_F(ParquetReaderTest, NotAParquetFile) {
+    file = string(100, 'x');
+    params.setKeySize(file.size());
+
+    EXPECT_THROW(this->open(params), S3RuntimeError);
+}
@@ -338,3 +338,18 @@ TEST(S3RESTfulService, GetWithWrongProxyUrl) {
 
     EXPECT_THROW(service.get(url, headers), S3ResolveError);
 }
+
+TEST(S3RESTfulService, ConnectionStatsCountFailedRequests) {
+    HTTPHeaders headers;
+    S3RESTfulService service;
+
+    S3ConnectionStats before = S3RESTfulService::getConnectionStats();
+
+    EXPECT_THROW(service.get("http://127.0.0.1:1/", headers), S3ConnectionError);
+    EXPECT_THROW(service.head("http://127.0.0.1:1/", headers), S3ConnectionError);
+
+    S3ConnectionStats after = S3RESTfulService::getConnectionStats();
+    EXPECT_EQ(before.requests + 2, after.requests);
+    EXPECT_EQ(before.newConnections, after.newConnections);
+    EXPECT_EQ(before.reusedConnections, after.reusedConnections);
+}
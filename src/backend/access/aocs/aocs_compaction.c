@@ -290,7 +290,8 @@ static bool
 AOCSSegmentFileFullCompaction(Relation aorel,
 							  AOCSInsertDesc insertDesc,
 							  AOCSFileSegInfo *fsinfo,
-							  Snapshot snapshot)
+							  Snapshot snapshot,
+							  bool isFull)
 {
 	const char *relname;
 	AppendOnlyVisimap visiMap;
@@ -305,8 +306,14 @@ AOCSSegmentFileFullCompaction(Relation aorel,
 	bool	   *proj;
 	int			i;
 	AOTupleId  *aoTupleId;
+	AOTupleId	oldAoTupleId;
 	int64		tupleCount = 0;
 	int64		tuplePerPage = INT_MAX;
+	int64		hiddenTupleCount;
+	int64		chunkRows;
+	int64		lastMovedTupleCount = 0;
+	AOCSDeleteDesc deleteDesc = NULL;
+	HTSU_Result result;
 
 	Assert(Gp_role == GP_ROLE_EXECUTE || Gp_role == GP_ROLE_UTILITY);
 	Assert(RelationIsAoCols(aorel));
@@ -325,9 +332,23 @@ AOCSSegmentFileFullCompaction(Relation aorel,
 						   ShareLock,
 						   snapshot);
 
+	hiddenTupleCount = AppendOnlyVisimap_GetSegmentFileHiddenTupleCount(&visiMap,
+																		compact_segno);
+	chunkRows = AppendOnlyCompaction_ChunkRows(fsinfo->total_tupcount,
+											   hiddenTupleCount, isFull);
+
 	elogif(Debug_appendonly_print_compaction,
-		   LOG, "Compact AO segfile %d, relation %sd",
-		   compact_segno, relname);
+		   LOG, "Compact AO segfile %d, relation %s, chunk rows " INT64_FORMAT,
+		   compact_segno, relname, chunkRows);
+
+	/* See AppendOnlySegmentFileFullCompaction */
+	if (chunkRows > 0)
+		deleteDesc = aocs_delete_init(aorel);
+
+	AppendOnlyCompaction_ReportBegin(aorel, compact_segno,
+									 fsinfo->total_tupcount,
+									 fsinfo->total_tupcount - hiddenTupleCount,
+									 chunkRows > 0);
 
 	proj = palloc0(sizeof(bool) * RelationGetNumberOfAttributes(aorel));
 	for (i = 0; i < RelationGetNumberOfAttributes(aorel); ++i)
@@ -338,6 +359,12 @@ AOCSSegmentFileFullCompaction(Relation aorel,
 								   snapshot, snapshot,
 								   &compact_segno, 1, NULL, proj);
 
+	/* See AppendOnlySegmentFileFullCompaction */
+	if (chunkRows > 0)
+		aocs_set_startrow(scanDesc,
+						  AppendOnlyVisimap_GetFirstVisibleRowNum(&visiMap,
+																  compact_segno));
+
 	tupDesc = RelationGetDescr(aorel);
 	slot = MakeSingleTupleTableSlot(tupDesc);
 	mt_bind = create_memtuple_binding(tupDesc);
@@ -363,13 +390,27 @@ AOCSSegmentFileFullCompaction(Relation aorel,
 		aoTupleId = (AOTupleId *) slot_get_ctid(slot);
 		if (AppendOnlyVisimap_IsVisible(&scanDesc->visibilityMap, aoTupleId))
 		{
+			if (chunkRows > 0 && movedTupleCount >= chunkRows)
+				break;
+
+			oldAoTupleId = *aoTupleId;
 			AOCSMoveTuple(slot,
 						  insertDesc,
 						  resultRelInfo,
 						  estate);
 			movedTupleCount++;
+
+			if (deleteDesc)
+			{
+				result = aocs_delete(deleteDesc, &oldAoTupleId);
+				if (result != HeapTupleMayBeUpdated)
+					elog(ERROR, "could not hide moved tuple (%d," INT64_FORMAT ") of relation %s: %d",
+						 AOTupleIdGet_segmentFileNum(&oldAoTupleId),
+						 AOTupleIdGet_rowNum(&oldAoTupleId),
+						 relname, result);
+			}
 		}
-		else
+		else if (chunkRows == 0)
 		{
 			/* Tuple is invisible and needs to be dropped */
 			AppendOnlyThrowAwayTuple(aorel,
@@ -381,31 +422,54 @@ AOCSSegmentFileFullCompaction(Relation aorel,
 		 * Check for vacuum delay point after approximatly a var block
 		 */
 		tupleCount++;
-		if (VacuumCostActive && tupleCount % tuplePerPage == 0)
+		if (tupleCount % tuplePerPage == 0)
 		{
-			vacuum_delay_point();
+			AppendOnlyCompaction_DelayPoint(movedTupleCount > lastMovedTupleCount);
+			AppendOnlyCompaction_ReportProgress(tupleCount, movedTupleCount);
+			lastMovedTupleCount = movedTupleCount;
 		}
 	}
 
-	SetAOCSFileSegInfoState(aorel, compact_segno,
-							AOSEG_STATE_AWAITING_DROP);
-
-	AppendOnlyVisimap_DeleteSegmentFile(&visiMap,
-										compact_segno);
+	if (deleteDesc)
+	{
+		/*
+		 * Only a chunk of the live tuples was moved. The segment file stays,
+		 * and so do its visibility map and block directory entries.
+		 */
+		aocs_delete_finish(deleteDesc);
 
-	/* Delete all mini pages of the segment files if block directory exists */
-	if (OidIsValid(aorel->rd_appendonly->blkdirrelid))
+		elogif(Debug_appendonly_print_compaction, LOG,
+			   "Finished partial compaction: "
+			   "AO segfile %d, relation %s, moved tuple count " INT64_FORMAT,
+			   compact_segno, relname, movedTupleCount);
+	}
+	else
 	{
-		AppendOnlyBlockDirectory_DeleteSegmentFile(aorel,
-												   snapshot,
-												   compact_segno,
-												   0);
+		SetAOCSFileSegInfoState(aorel, compact_segno,
+								AOSEG_STATE_AWAITING_DROP);
+
+		AppendOnlyVisimap_DeleteSegmentFile(&visiMap,
+											compact_segno);
+
+		/*
+		 * Delete all mini pages of the segment files if block directory
+		 * exists
+		 */
+		if (OidIsValid(aorel->rd_appendonly->blkdirrelid))
+		{
+			AppendOnlyBlockDirectory_DeleteSegmentFile(aorel,
+													   snapshot,
+													   compact_segno,
+													   0);
+		}
+
+		elogif(Debug_appendonly_print_compaction, LOG,
+			   "Finished compaction: "
+			   "AO segfile %d, relation %s, moved tuple count " INT64_FORMAT,
+			   compact_segno, relname, movedTupleCount);
 	}
 
-	elogif(Debug_appendonly_print_compaction, LOG,
-		   "Finished compaction: "
-		   "AO segfile %d, relation %s, moved tuple count " INT64_FORMAT,
-		   compact_segno, relname, movedTupleCount);
+	AppendOnlyCompaction_ReportEnd();
 
 	AppendOnlyVisimap_Finish(&visiMap, NoLock);
 
@@ -633,7 +697,7 @@ AOCSCompact(Relation aorel,
 											   appendOnlyMetaDataSnapshot))
 		{
 			AOCSSegmentFileFullCompaction(aorel, insertDesc, fsinfo,
-										  appendOnlyMetaDataSnapshot);
+										  appendOnlyMetaDataSnapshot, isFull);
 		}
 
 		pfree(fsinfo);
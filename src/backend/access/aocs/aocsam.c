@@ -42,6 +42,7 @@
 #include "storage/smgr.h"
 #include "utils/datumstream.h"
 #include "utils/faultinjector.h"
+#include "utils/fmgroids.h"
 #include "utils/guc.h"
 #include "utils/inval.h"
 #include "utils/lsyscache.h"
@@ -169,6 +170,9 @@ open_ds_write(Relation rel, DatumStreamWrite **ds, TupleDesc relationTupleDesc,
 										/* title */ titleBuf.data,
 										XLogIsNeeded() && RelationNeedsWAL(rel));
 
+		/* See appendonly_insert_init */
+		if (!OidIsValid(rel->rd_appendonly->blkdirrelid))
+			AppendOnlyStorageWrite_EnablePipeline(&ds[i]->ao_write);
 	}
 
 	for (int i = 0; i < RelationGetNumberOfAttributes(rel); i++)
@@ -278,6 +282,8 @@ aocs_initscan(AOCSScanDesc scan)
 
 	ItemPointerSet(&scan->cdb_fake_ctid, 0, 0);
 	scan->cur_seg_row = 0;
+	scan->batchNumSelected = 0;
+	scan->batchNext = 0;
 
 	open_ds_read(scan->aos_rel, scan->ds, scan->relationTupleDesc,
 				 scan->proj_atts, scan->num_proj_atts,
@@ -286,6 +292,583 @@ aocs_initscan(AOCSScanDesc scan)
 	pgstat_count_heap_scan(scan->aos_rel);
 }
 
+/*
+ * Can no row covered by the zone satisfy the zone key?
+ *
+ * The key's sk_func is the btree comparison function of the column type,
+ * and the btree operators are strict, so a zone without values (all NULLs)
+ * never satisfies an operator key.
+ */
+static bool
+zone_excludes_key(MinipageZone *zone, ScanKey key)
+{
+	int32		cmpMin;
+	int32		cmpMax;
+
+	if (key->sk_flags & SK_ISNULL)
+	{
+		if (key->sk_flags & SK_SEARCHNULL)
+			return zone->nullCount == 0;
+		Assert(key->sk_flags & SK_SEARCHNOTNULL);
+		return (zone->flags & MINIPAGE_ZONE_HAS_VALUES) == 0;
+	}
+
+	if ((zone->flags & MINIPAGE_ZONE_HAS_VALUES) == 0)
+		return true;
+
+	cmpMin = DatumGetInt32(FunctionCall2Coll(&key->sk_func,
+											 key->sk_collation,
+											 (Datum) zone->minValue,
+											 key->sk_argument));
+	cmpMax = DatumGetInt32(FunctionCall2Coll(&key->sk_func,
+											 key->sk_collation,
+											 (Datum) zone->maxValue,
+											 key->sk_argument));
+
+	switch (key->sk_strategy)
+	{
+		case BTLessStrategyNumber:
+			return cmpMin >= 0;
+		case BTLessEqualStrategyNumber:
+			return cmpMin > 0;
+		case BTEqualStrategyNumber:
+			return cmpMin > 0 || cmpMax < 0;
+		case BTGreaterEqualStrategyNumber:
+			return cmpMax < 0;
+		case BTGreaterStrategyNumber:
+			return cmpMax <= 0;
+		default:
+			return false;
+	}
+}
+
+static int
+zone_skip_range_cmp(const void *a, const void *b)
+{
+	const AOCSZoneSkipRange *ra = (const AOCSZoneSkipRange *) a;
+	const AOCSZoneSkipRange *rb = (const AOCSZoneSkipRange *) b;
+
+	if (ra->firstRowNum < rb->firstRowNum)
+		return -1;
+	if (ra->firstRowNum > rb->firstRowNum)
+		return 1;
+	return 0;
+}
+
+/*
+ * Add a row range to skip to scan->zoneSkipRanges, growing it as needed.
+ */
+static void
+add_zone_skip_range(AOCSScanDesc scan, int *maxRanges, int *numRanges,
+					int64 firstRowNum, int64 afterRowNum)
+{
+	if (*numRanges >= *maxRanges)
+	{
+		*maxRanges = Max(*maxRanges * 2, 64);
+		if (scan->zoneSkipRanges == NULL)
+			scan->zoneSkipRanges =
+				palloc(sizeof(AOCSZoneSkipRange) * *maxRanges);
+		else
+			scan->zoneSkipRanges =
+				repalloc(scan->zoneSkipRanges,
+						 sizeof(AOCSZoneSkipRange) * *maxRanges);
+	}
+	scan->zoneSkipRanges[*numRanges].firstRowNum = firstRowNum;
+	scan->zoneSkipRanges[*numRanges].afterRowNum = afterRowNum;
+	(*numRanges)++;
+}
+
+/*
+ * Collect the row ranges of the segment file that cannot satisfy the zone
+ * keys, from the zones recorded in the block directory. A range is
+ * excluded if the zone of any key column excludes it, since the keys are
+ * ANDed. The rows before the start row of the scan are skipped as well.
+ * The ranges are sorted and merged so that aocs_getnext() can walk them in
+ * row number order.
+ */
+static void
+build_zone_skip_ranges(AOCSScanDesc scan, AOCSFileSegInfo *seginfo)
+{
+	int			maxRanges = 0;
+	int			numRanges = 0;
+	int			keyNo;
+	int			i;
+
+	if (scan->zoneSkipRanges)
+		pfree(scan->zoneSkipRanges);
+	scan->zoneSkipRanges = NULL;
+	scan->numZoneSkipRanges = 0;
+	scan->nextZoneSkipRange = 0;
+	scan->zoneNextRowNum = 1;
+
+	if (scan->startRowNum > 1)
+		add_zone_skip_range(scan, &maxRanges, &numRanges,
+							1, scan->startRowNum);
+
+	for (keyNo = 0; gp_appendonly_zone_maps && keyNo < scan->numScanKeys; keyNo++)
+	{
+		ScanKey		key = &scan->scanKeys[keyNo];
+		int			attno = key->sk_attno - 1;
+		AppendOnlyBlockZone *zones;
+		int			numZones;
+		int			zoneNo;
+
+		zones = AppendOnlyBlockDirectory_GetZones(scan->aos_rel,
+												  scan->appendOnlyMetaDataSnapshot,
+												  seginfo->segno,
+												  attno,
+												  getAOCSVPEntry(seginfo, attno)->eof,
+												  &numZones);
+
+		for (zoneNo = 0; zoneNo < numZones; zoneNo++)
+		{
+			if (!zone_excludes_key(&zones[zoneNo].zone, key))
+				continue;
+
+			add_zone_skip_range(scan, &maxRanges, &numRanges,
+								zones[zoneNo].firstRowNum,
+								zones[zoneNo].firstRowNum + zones[zoneNo].rowCount);
+		}
+
+		if (zones)
+			pfree(zones);
+	}
+
+	if (numRanges == 0)
+		return;
+
+	qsort(scan->zoneSkipRanges, numRanges, sizeof(AOCSZoneSkipRange),
+		  zone_skip_range_cmp);
+
+	scan->numZoneSkipRanges = 1;
+	for (i = 1; i < numRanges; i++)
+	{
+		AOCSZoneSkipRange *last =
+			&scan->zoneSkipRanges[scan->numZoneSkipRanges - 1];
+
+		if (scan->zoneSkipRanges[i].firstRowNum <= last->afterRowNum)
+			last->afterRowNum = Max(last->afterRowNum,
+									scan->zoneSkipRanges[i].afterRowNum);
+		else
+			scan->zoneSkipRanges[scan->numZoneSkipRanges++] =
+				scan->zoneSkipRanges[i];
+	}
+}
+
+/*
+ * If the next row to read falls into a skip range, move the given columns
+ * past the range. Returns false if the segment file has no rows after it.
+ */
+static bool
+skip_zone_ranges(AOCSScanDesc scan, int *atts, int natts)
+{
+	while (scan->nextZoneSkipRange < scan->numZoneSkipRanges)
+	{
+		AOCSZoneSkipRange *range =
+			&scan->zoneSkipRanges[scan->nextZoneSkipRange];
+		int			i;
+
+		if (range->afterRowNum <= scan->zoneNextRowNum)
+		{
+			scan->nextZoneSkipRange++;
+			continue;
+		}
+		if (range->firstRowNum > scan->zoneNextRowNum)
+			break;
+
+		for (i = 0; i < natts; i++)
+		{
+			if (!datumstreamread_skip_to_row(scan->ds[atts[i]],
+											 range->afterRowNum,
+											 &scan->zoneBlocksSkipped))
+				return false;
+		}
+
+		scan->zoneNextRowNum = range->afterRowNum;
+		scan->nextZoneSkipRange++;
+	}
+
+	return true;
+}
+
+/*
+ * Does the datum satisfy the scan key?
+ *
+ * Keys on the common integer and date columns are compared inline, which
+ * is what makes filtering a whole batch cheap; other types go through the
+ * comparison function.
+ */
+static inline bool
+batch_datum_matches_key(ScanKey key, Datum value, bool isnull)
+{
+	int32		cmp;
+
+	if (key->sk_flags & SK_ISNULL)
+	{
+		if (key->sk_flags & SK_SEARCHNULL)
+			return isnull;
+		return !isnull;
+	}
+
+	if (isnull)
+		return false;
+
+	switch (key->sk_func.fn_oid)
+	{
+		case F_BTINT2CMP:
+			cmp = (int32) DatumGetInt16(value) -
+				(int32) DatumGetInt16(key->sk_argument);
+			break;
+		case F_BTINT4CMP:
+		case F_DATE_CMP:
+			cmp = (DatumGetInt32(value) > DatumGetInt32(key->sk_argument)) -
+				(DatumGetInt32(value) < DatumGetInt32(key->sk_argument));
+			break;
+		case F_BTINT8CMP:
+			cmp = (DatumGetInt64(value) > DatumGetInt64(key->sk_argument)) -
+				(DatumGetInt64(value) < DatumGetInt64(key->sk_argument));
+			break;
+		default:
+			cmp = DatumGetInt32(FunctionCall2Coll(&key->sk_func,
+												  key->sk_collation,
+												  value,
+												  key->sk_argument));
+			break;
+	}
+
+	switch (key->sk_strategy)
+	{
+		case BTLessStrategyNumber:
+			return cmp < 0;
+		case BTLessEqualStrategyNumber:
+			return cmp <= 0;
+		case BTEqualStrategyNumber:
+			return cmp == 0;
+		case BTGreaterEqualStrategyNumber:
+			return cmp >= 0;
+		case BTGreaterStrategyNumber:
+			return cmp > 0;
+		default:
+			return true;
+	}
+}
+
+/*
+ * Decode the next batch of rows of the current segment file, and select
+ * the rows that are visible and pass the scan keys. A batch never crosses a
+ * block boundary of any batch column, so the datums of by-reference columns
+ * stay valid in the block buffers until the batch has been returned. The
+ * late columns are left alone, and caught up by aocs_batch_next(). Returns
+ * false if the segment file has no more rows.
+ */
+static bool
+aocs_fill_batch(AOCSScanDesc scan)
+{
+	DatumStreamRead *firstds;
+	int			numRows = scan->batchSize;
+	int			numSelected;
+	int			keyNo;
+	int			i;
+
+	scan->batchNumSelected = 0;
+	scan->batchNext = 0;
+
+	if (scan->numZoneSkipRanges > 0 &&
+		!skip_zone_ranges(scan, scan->batchAtts, scan->numBatchAtts))
+		return false;
+
+	for (i = 0; i < scan->numBatchAtts; i++)
+	{
+		int			attno = scan->batchAtts[i];
+		int			remaining = datumstreamread_remaining(scan->ds[attno]);
+
+		/*
+		 * Read blocks until one has rows left, so that every call consumes
+		 * at least one row. A skip can leave the stream at the end of a
+		 * block, and a consumed large object block has no rows left either.
+		 */
+		while (remaining <= 0)
+		{
+			if (datumstreamread_block(scan->ds[attno], scan->blockDirectory, attno) < 0)
+				return false;
+			remaining = datumstreamread_remaining(scan->ds[attno]);
+		}
+		numRows = Min(numRows, remaining);
+	}
+
+	Assert(numRows > 0);
+
+	for (i = 0; i < scan->numBatchAtts; i++)
+	{
+		int			attno = scan->batchAtts[i];
+		int			n;
+
+		n = datumstreamread_get_batch(scan->ds[attno],
+									  scan->batchValues[attno],
+									  scan->batchNulls[attno],
+									  (scan->batchCodes != NULL ?
+									   scan->batchCodes[attno] : NULL),
+									  numRows);
+		if (n != numRows)
+			elog(ERROR, "could not read %d rows of column %d of append-only column-oriented relation \"%s\" (read %d)",
+				 numRows, attno + 1, RelationGetRelationName(scan->aos_rel), n);
+	}
+
+	/* The streams are now positioned on the last row of the batch. */
+	firstds = scan->ds[scan->batchAtts[0]];
+	if (firstds->blockFirstRowNum != INT64CONST(-1))
+	{
+		scan->batchFirstRowNum = firstds->blockFirstRowNum +
+			datumstreamread_nth(firstds) - (numRows - 1);
+		scan->zoneNextRowNum = scan->batchFirstRowNum + numRows;
+	}
+	else
+		scan->batchFirstRowNum = scan->cur_seg_row + 1;
+	scan->cur_seg_row += numRows;
+
+	for (i = 0; i < numRows; i++)
+		scan->batchSelection[i] = i;
+	numSelected = numRows;
+
+	/*
+	 * Leave out the deleted rows first, unless the visibility map shows
+	 * that there are none in the batch.
+	 */
+	if (scan->snapshot != SnapshotAny &&
+		!AppendOnlyVisimap_IsRangeVisible(&scan->visibilityMap,
+										  scan->seginfo[scan->cur_seg]->segno,
+										  scan->batchFirstRowNum, numRows))
+	{
+		int			j = 0;
+
+		for (i = 0; i < numRows; i++)
+		{
+			AOTupleId	aoTupleId;
+
+			AOTupleIdInit(&aoTupleId, scan->seginfo[scan->cur_seg]->segno,
+						  scan->batchFirstRowNum + i);
+			if (AppendOnlyVisimap_IsVisible(&scan->visibilityMap, &aoTupleId))
+				scan->batchSelection[j++] = i;
+		}
+		numSelected = j;
+	}
+
+	for (keyNo = 0; keyNo < scan->numScanKeys && numSelected > 0; keyNo++)
+	{
+		ScanKey		key = &scan->scanKeys[keyNo];
+		int			attno = key->sk_attno - 1;
+		Datum	   *values;
+		bool	   *nulls;
+		Datum	   *dictValues;
+		int64		dictId;
+		int			dictCount;
+		int			j = 0;
+
+		if (attno < 0 || attno >= scan->relationTupleDesc->natts ||
+			scan->batchValues[attno] == NULL)
+			continue;
+
+		/*
+		 * The block of a dictionary encoded column has few distinct values.
+		 * Check the key once on each of them, and then just look up the
+		 * result by the code of each row.
+		 */
+		if (scan->batchCodes != NULL && scan->batchCodes[attno] != NULL &&
+			(dictCount = datumstreamread_dictionary(scan->ds[attno],
+													&dictValues, &dictId)) > 0)
+		{
+			int32	   *codes = scan->batchCodes[attno];
+			bool	   *match = scan->keyDictMatch[keyNo];
+			bool		nullMatches = batch_datum_matches_key(key, (Datum) 0, true);
+
+			if (scan->keyDictId[keyNo] != dictId)
+			{
+				for (i = 0; i < dictCount; i++)
+					match[i] = batch_datum_matches_key(key, dictValues[i], false);
+				scan->keyDictId[keyNo] = dictId;
+			}
+
+			for (i = 0; i < numSelected; i++)
+			{
+				int			row = scan->batchSelection[i];
+
+				if (codes[row] < 0 ? nullMatches : match[codes[row]])
+					scan->batchSelection[j++] = row;
+			}
+			numSelected = j;
+			continue;
+		}
+
+		values = scan->batchValues[attno];
+		nulls = scan->batchNulls[attno];
+		for (i = 0; i < numSelected; i++)
+		{
+			int			row = scan->batchSelection[i];
+
+			if (batch_datum_matches_key(key, values[row], nulls[row]))
+				scan->batchSelection[j++] = row;
+		}
+		numSelected = j;
+	}
+
+	scan->batchNumSelected = numSelected;
+	return true;
+}
+
+/*
+ * Return the next selected row of the current segment file from the batch,
+ * decoding more batches as needed. Returns false if the segment file has no
+ * more rows.
+ *
+ * The late columns are moved forward to the row and read here, so blocks
+ * of theirs in which no row was selected are passed over by their headers
+ * without being read or decompressed.
+ */
+static bool
+aocs_batch_next(AOCSScanDesc scan, Datum *d, bool *null, AOTupleId *aoTupleId)
+{
+	int64		rowNum;
+	int			row;
+	int			i;
+
+	while (scan->batchNext >= scan->batchNumSelected)
+	{
+		if (!aocs_fill_batch(scan))
+			return false;
+	}
+
+	row = scan->batchSelection[scan->batchNext++];
+	rowNum = scan->batchFirstRowNum + row;
+	for (i = 0; i < scan->numBatchAtts; i++)
+	{
+		int			attno = scan->batchAtts[i];
+
+		d[attno] = scan->batchValues[attno][row];
+		null[attno] = scan->batchNulls[attno][row];
+	}
+
+	for (i = 0; i < scan->numLateAtts; i++)
+	{
+		int			attno = scan->lateAtts[i];
+		DatumStreamRead *ds = scan->ds[attno];
+
+		if (!datumstreamread_skip_to_row(ds, rowNum, &scan->lateBlocksSkipped) ||
+			datumstreamread_advance(ds) == 0 ||
+			ds->blockFirstRowNum + datumstreamread_nth(ds) != rowNum)
+			elog(ERROR, "could not find row " INT64_FORMAT " in column %d of append-only column-oriented relation \"%s\"",
+				 rowNum, attno + 1, RelationGetRelationName(scan->aos_rel));
+
+		datumstreamread_get(ds, &d[attno], &null[attno]);
+	}
+
+	AOTupleIdInit(aoTupleId, scan->seginfo[scan->cur_seg]->segno, rowNum);
+	return true;
+}
+
+/*
+ * aocs_set_scankeys
+ *
+ * Give the scan simple "column op constant" quals, as btree strategy scan
+ * keys whose sk_func is the comparison function of the column type, or
+ * IS [NOT] NULL keys. Blocks whose zone shows that none of their rows can
+ * satisfy all the keys are skipped without being decompressed, and batch
+ * scans leave out the rows of a batch that fail a key. The keys are only
+ * used to skip data: the caller must still check its quals on every row
+ * returned.
+ */
+void
+aocs_set_scankeys(AOCSScanDesc scan, int nkeys, ScanKey keys)
+{
+	bool	   *keyCol;
+	int			numKeyAtts = 0;
+	int			i;
+
+	scan->numScanKeys = nkeys;
+	scan->scanKeys = keys;
+
+	if (scan->batchValues == NULL)
+		return;
+
+	/*
+	 * Keys on projected pass-by-reference columns can be checked on the
+	 * dictionary of dictionary encoded blocks.
+	 */
+	for (i = 0; i < nkeys; i++)
+	{
+		int			attno = keys[i].sk_attno - 1;
+
+		if (attno < 0 || attno >= scan->relationTupleDesc->natts ||
+			scan->batchValues[attno] == NULL ||
+			scan->relationTupleDesc->attrs[attno]->attbyval)
+			continue;
+
+		if (scan->batchCodes == NULL)
+		{
+			scan->batchCodes = palloc0(sizeof(int32 *) * scan->relationTupleDesc->natts);
+			scan->keyDictMatch = palloc0(sizeof(bool *) * nkeys);
+			scan->keyDictId = palloc(sizeof(int64) * nkeys);
+		}
+		if (scan->batchCodes[attno] == NULL)
+			scan->batchCodes[attno] = palloc(sizeof(int32) * scan->batchSize);
+		scan->keyDictMatch[i] = palloc(sizeof(bool) * DATUMSTREAM_MAX_DICTIONARY_COUNT);
+		scan->keyDictId[i] = -1;
+	}
+
+	if (!gp_appendonly_late_materialization)
+		return;
+
+	/*
+	 * Decode just the projected key columns in batches, and read the other
+	 * projected columns only for the rows that pass the keys. There is
+	 * nothing to gain unless both kinds of column are projected.
+	 */
+	keyCol = palloc0(sizeof(bool) * scan->relationTupleDesc->natts);
+	for (i = 0; i < nkeys; i++)
+	{
+		int			attno = keys[i].sk_attno - 1;
+
+		if (attno >= 0 && attno < scan->relationTupleDesc->natts)
+			keyCol[attno] = true;
+	}
+	for (i = 0; i < scan->num_proj_atts; i++)
+	{
+		if (keyCol[scan->proj_atts[i]])
+			numKeyAtts++;
+	}
+
+	if (numKeyAtts > 0 && numKeyAtts < scan->num_proj_atts)
+	{
+		scan->batchAtts = palloc(sizeof(int) * numKeyAtts);
+		scan->lateAtts = palloc(sizeof(int) * (scan->num_proj_atts - numKeyAtts));
+		scan->numBatchAtts = 0;
+		scan->numLateAtts = 0;
+		for (i = 0; i < scan->num_proj_atts; i++)
+		{
+			int			attno = scan->proj_atts[i];
+
+			if (keyCol[attno])
+				scan->batchAtts[scan->numBatchAtts++] = attno;
+			else
+				scan->lateAtts[scan->numLateAtts++] = attno;
+		}
+	}
+
+	pfree(keyCol);
+}
+
+/*
+ * aocs_set_startrow
+ *
+ * Skip the rows of the segment files before startRowNum. The column blocks
+ * that only hold such rows are passed over without being decompressed.
+ * Must be called before the first aocs_getnext().
+ */
+void
+aocs_set_startrow(AOCSScanDesc scan, int64 startRowNum)
+{
+	scan->startRowNum = startRowNum;
+}
+
 static int
 open_next_scan_seg(AOCSScanDesc scan)
 {
@@ -362,6 +945,9 @@ open_next_scan_seg(AOCSScanDesc scan)
 												  scan->num_proj_atts,
 												  scan->blockDirectory);
 
+				if (scan->numScanKeys > 0 || scan->startRowNum > 1)
+					build_zone_skip_ranges(scan, curSegInfo);
+
 				return scan->cur_seg;
 			}
 		}
@@ -504,6 +1090,27 @@ aocs_beginscan_internal(Relation relation,
 
 	scan->ds = (DatumStreamRead **) palloc0(sizeof(DatumStreamRead *) * nvp);
 
+	/*
+	 * Decode the projected columns a batch of rows at a time, unless
+	 * disabled.
+	 */
+	scan->batchSize = gp_appendonly_scan_batch_size;
+	if (scan->batchSize > 0 && scan->num_proj_atts > 0)
+	{
+		scan->batchValues = (Datum **) palloc0(sizeof(Datum *) * nvp);
+		scan->batchNulls = (bool **) palloc0(sizeof(bool *) * nvp);
+		for (i = 0; i < scan->num_proj_atts; i++)
+		{
+			int			attno = scan->proj_atts[i];
+
+			scan->batchValues[attno] = palloc(sizeof(Datum) * scan->batchSize);
+			scan->batchNulls[attno] = palloc(sizeof(bool) * scan->batchSize);
+		}
+		scan->batchSelection = palloc(sizeof(int) * scan->batchSize);
+	}
+	scan->batchAtts = scan->proj_atts;
+	scan->numBatchAtts = scan->num_proj_atts;
+
 	aocs_initscan(scan);
 
 	scan->blockDirectory = NULL;
@@ -559,6 +1166,39 @@ aocs_endscan(AOCSScanDesc scan)
 	close_cur_scan_seg(scan);
 	close_ds_read(scan->ds, scan->relationTupleDesc->natts);
 
+	if (scan->batchValues)
+	{
+		for (i = 0; i < scan->num_proj_atts; i++)
+		{
+			pfree(scan->batchValues[scan->proj_atts[i]]);
+			pfree(scan->batchNulls[scan->proj_atts[i]]);
+		}
+		pfree(scan->batchValues);
+		pfree(scan->batchNulls);
+		pfree(scan->batchSelection);
+	}
+	if (scan->batchCodes)
+	{
+		for (i = 0; i < scan->relationTupleDesc->natts; i++)
+		{
+			if (scan->batchCodes[i])
+				pfree(scan->batchCodes[i]);
+		}
+		for (i = 0; i < scan->numScanKeys; i++)
+		{
+			if (scan->keyDictMatch[i])
+				pfree(scan->keyDictMatch[i]);
+		}
+		pfree(scan->batchCodes);
+		pfree(scan->keyDictMatch);
+		pfree(scan->keyDictId);
+	}
+	if (scan->lateAtts)
+	{
+		pfree(scan->batchAtts);
+		pfree(scan->lateAtts);
+	}
+
 	pfree(scan->proj_atts);
 	scan->proj_atts = NULL;
 	pfree(scan->ds);
@@ -580,6 +1220,9 @@ aocs_endscan(AOCSScanDesc scan)
 
 	AppendOnlyVisimap_Finish(&scan->visibilityMap, AccessShareLock);
 
+	if (scan->zoneSkipRanges)
+		pfree(scan->zoneSkipRanges);
+
 	pfree(scan);
 }
 
@@ -691,11 +1334,38 @@ ReadNext:
 				return false;
 			}
 			scan->cur_seg_row = 0;
+			scan->batchNumSelected = 0;
+			scan->batchNext = 0;
 		}
 
 		Assert(scan->cur_seg >= 0);
 		curseginfo = scan->seginfo[scan->cur_seg];
 
+		/*
+		 * Batches are not used on segment files of older formats, whose
+		 * datums may need an upgrade in space that holds a single datum.
+		 */
+		if (scan->batchValues != NULL &&
+			curseginfo->formatversion >= AORelationVersion_GetLatest())
+		{
+			if (!aocs_batch_next(scan, d, null, &aoTupleId))
+			{
+				close_cur_scan_seg(scan);
+				err = -1;
+				goto ReadNext;
+			}
+			/* aocs_fill_batch() has left out the invisible rows */
+			goto ReturnTuple;
+		}
+
+		if (scan->numZoneSkipRanges > 0 &&
+			!skip_zone_ranges(scan, scan->proj_atts, scan->num_proj_atts))
+		{
+			close_cur_scan_seg(scan);
+			err = -1;
+			goto ReadNext;
+		}
+
 		/* Read from cur_seg */
 		for (i = 0; i < scan->num_proj_atts; i++)
 		{
@@ -751,6 +1421,7 @@ ReadNext:
 		else
 		{
 			AOTupleIdInit(&aoTupleId, curseginfo->segno, rowNum);
+			scan->zoneNextRowNum = rowNum + 1;
 		}
 
 		if (!isSnapshotAny && !AppendOnlyVisimap_IsVisible(&scan->visibilityMap, &aoTupleId))
@@ -758,6 +1429,8 @@ ReadNext:
 			rowNum = INT64CONST(-1);
 			goto ReadNext;
 		}
+
+ReturnTuple:
 		scan->cdb_fake_ctid = *((ItemPointer) &aoTupleId);
 
 		TupSetVirtualTupleNValid(slot, ncol);
@@ -1352,6 +2025,14 @@ aocs_fetch_init(Relation relation,
 	}
 	if (opts)
 		pfree(opts);
+
+	for (colno = 0; colno < relation->rd_att->natts; colno++)
+	{
+		if (proj[colno])
+			break;
+	}
+	aocsFetchDesc->firstProjectedColNo = colno;
+
 	AppendOnlyVisimap_Init(&aocsFetchDesc->visibilityMap,
 						   relation->rd_appendonly->visimaprelid,
 						   relation->rd_appendonly->visimapidxid,
@@ -1550,6 +2231,211 @@ aocs_fetch(AOCSFetchDesc aocsFetchDesc,
 	return found;
 }
 
+/*
+ * Ask the kernel to read ahead, for each fetched column, the block directory
+ * ranges of the batch TIDs that follow the fetch position. A TID whose row
+ * falls outside the ranges already prefetched for some column counts as one
+ * range, and up to gp_appendonly_prefetch_depth of them are prefetched at a
+ * time.
+ *
+ * Like the row-oriented version, this stays within the segment file that
+ * the columns currently have open.
+ */
+static void
+fetchBatchPrefetch(AOCSFetchDesc aocsFetchDesc)
+{
+	int			numCols = aocsFetchDesc->relation->rd_att->natts;
+	DatumStreamFetchDesc firstFetchDesc;
+	int			numRanges = 0;
+
+	if (gp_appendonly_prefetch_depth <= 0 ||
+		aocsFetchDesc->firstProjectedColNo >= numCols ||
+		aocsFetchDesc->batchNextTid < aocsFetchDesc->batchRefillTid)
+		return;
+
+	firstFetchDesc = aocsFetchDesc->datumStreamFetchDesc[aocsFetchDesc->firstProjectedColNo];
+	if (!firstFetchDesc->currentSegmentFile.isOpen)
+		return;
+
+	if (!aocsFetchDesc->prefetchDirectoryValid)
+	{
+		MemoryContext oldcxt = MemoryContextSwitchTo(aocsFetchDesc->initContext);
+		bool	   *proj = palloc(numCols * sizeof(bool));
+		int			colno;
+
+		for (colno = 0; colno < numCols; colno++)
+			proj[colno] = (aocsFetchDesc->datumStreamFetchDesc[colno] != NULL);
+
+		AppendOnlyBlockDirectory_Init_forSearch(
+												&aocsFetchDesc->prefetchDirectory,
+												aocsFetchDesc->appendOnlyMetaDataSnapshot,
+												(FileSegInfo **) aocsFetchDesc->segmentFileInfo,
+												aocsFetchDesc->totalSegfiles,
+												aocsFetchDesc->relation,
+												numCols,
+												true,
+												proj);
+		aocsFetchDesc->prefetchDirectoryValid = true;
+
+		pfree(proj);
+		MemoryContextSwitchTo(oldcxt);
+	}
+
+	if (aocsFetchDesc->batchPrefetchTid < aocsFetchDesc->batchNextTid)
+		aocsFetchDesc->batchPrefetchTid = aocsFetchDesc->batchNextTid;
+
+	while (aocsFetchDesc->batchPrefetchTid < aocsFetchDesc->batchNumTids &&
+		   numRanges < gp_appendonly_prefetch_depth)
+	{
+		AOTupleId  *aoTupleId = &aocsFetchDesc->batchTids[aocsFetchDesc->batchPrefetchTid];
+		int64		rowNum = AOTupleIdGet_rowNum(aoTupleId);
+		bool		newRange = false;
+		int			colno;
+
+		if (AOTupleIdGet_segmentFileNum(aoTupleId) !=
+			firstFetchDesc->currentSegmentFile.num)
+			break;
+
+		for (colno = 0; colno < numCols; colno++)
+		{
+			DatumStreamFetchDesc datumStreamFetchDesc = aocsFetchDesc->datumStreamFetchDesc[colno];
+			int64		beginFileOffset;
+			int64		afterFileOffset;
+			int64		firstRowNum;
+			int64		lastRowNum;
+
+			if (datumStreamFetchDesc == NULL)
+				continue;
+
+			if (!datumStreamFetchDesc->currentSegmentFile.isOpen ||
+				datumStreamFetchDesc->currentSegmentFile.num !=
+				firstFetchDesc->currentSegmentFile.num)
+				continue;
+
+			if (datumStreamFetchDesc->prefetchEntryValid &&
+				AppendOnlyBlockDirectoryEntry_RangeHasRow(&datumStreamFetchDesc->prefetchEntry,
+														  rowNum))
+				continue;
+
+			if (!AppendOnlyBlockDirectory_GetEntry(&aocsFetchDesc->prefetchDirectory,
+												   aoTupleId,
+												   colno,
+												   &datumStreamFetchDesc->prefetchEntry))
+			{
+				/*
+				 * Leave rows missing from the block directory to the fetch,
+				 * see the row-oriented version.
+				 */
+				datumStreamFetchDesc->prefetchEntryValid = false;
+				aocsFetchDesc->batchPrefetchTid = aocsFetchDesc->batchNumTids;
+				break;
+			}
+			datumStreamFetchDesc->prefetchEntryValid = true;
+
+			AppendOnlyBlockDirectoryEntry_GetBeginRange(&datumStreamFetchDesc->prefetchEntry,
+														&beginFileOffset,
+														&firstRowNum);
+			AppendOnlyBlockDirectoryEntry_GetEndRange(&datumStreamFetchDesc->prefetchEntry,
+													  &afterFileOffset,
+													  &lastRowNum);
+			if (afterFileOffset > datumStreamFetchDesc->currentSegmentFile.logicalEof)
+				afterFileOffset = datumStreamFetchDesc->currentSegmentFile.logicalEof;
+
+			/* It is only a hint, so don't complain if it fails. */
+			if (afterFileOffset > beginFileOffset)
+				(void) FilePrefetch(datumStreamFetchDesc->datumStream->ao_read.file,
+									beginFileOffset,
+									(int) (afterFileOffset - beginFileOffset));
+			newRange = true;
+		}
+
+		if (aocsFetchDesc->batchPrefetchTid >= aocsFetchDesc->batchNumTids)
+			break;
+
+		if (newRange)
+		{
+			aocsFetchDesc->batchRefillTid = aocsFetchDesc->batchPrefetchTid;
+			numRanges++;
+		}
+		aocsFetchDesc->batchPrefetchTid++;
+	}
+
+	/* Nothing left to prefetch until the fetch moves on. */
+	if (aocsFetchDesc->batchRefillTid < aocsFetchDesc->batchNextTid)
+		aocsFetchDesc->batchRefillTid = aocsFetchDesc->batchPrefetchTid;
+}
+
+/*
+ * Start fetching a batch of tuple ids.
+ *
+ * The tuple ids must be sorted, so that the batch visits each segment file
+ * and each block of every column at most once. The array is not copied, and
+ * must stay valid until aocs_fetch_batch_next has returned false.
+ */
+void
+aocs_fetch_batch_begin(AOCSFetchDesc aocsFetchDesc,
+					   AOTupleId *aoTupleIds,
+					   int numTids)
+{
+	int			colno;
+
+	aocsFetchDesc->batchTids = aoTupleIds;
+	aocsFetchDesc->batchNumTids = numTids;
+	aocsFetchDesc->batchNextTid = 0;
+	aocsFetchDesc->batchPrefetchTid = 0;
+	aocsFetchDesc->batchRefillTid = 0;
+
+	for (colno = 0; colno < aocsFetchDesc->relation->rd_att->natts; colno++)
+	{
+		if (aocsFetchDesc->datumStreamFetchDesc[colno] != NULL)
+			aocsFetchDesc->datumStreamFetchDesc[colno]->prefetchEntryValid = false;
+	}
+}
+
+/*
+ * Fetch the next visible tuple of the batch.
+ *
+ * Tuple ids that don't match a visible tuple are skipped. The tuple id of
+ * the returned tuple is stored in the slot.
+ *
+ * Return false when the batch is exhausted.
+ */
+bool
+aocs_fetch_batch_next(AOCSFetchDesc aocsFetchDesc,
+					  TupleTableSlot *slot)
+{
+	int			firstProjectedColNo = aocsFetchDesc->firstProjectedColNo;
+
+	while (aocsFetchDesc->batchNextTid < aocsFetchDesc->batchNumTids)
+	{
+		AOTupleId  *aoTupleId = &aocsFetchDesc->batchTids[aocsFetchDesc->batchNextTid];
+		int			segmentFileNum = AOTupleIdGet_segmentFileNum(aoTupleId);
+
+		fetchBatchPrefetch(aocsFetchDesc);
+
+		aocsFetchDesc->batchNextTid++;
+		if (aocs_fetch(aocsFetchDesc, aoTupleId, slot))
+			return true;
+
+		/*
+		 * The first fetched column is always opened first. If that failed,
+		 * none of the remaining tuple ids in the segment file can be found
+		 * either.
+		 */
+		if (firstProjectedColNo < aocsFetchDesc->relation->rd_att->natts &&
+			!aocsFetchDesc->datumStreamFetchDesc[firstProjectedColNo]->currentSegmentFile.isOpen)
+		{
+			while (aocsFetchDesc->batchNextTid < aocsFetchDesc->batchNumTids &&
+				   AOTupleIdGet_segmentFileNum(&aocsFetchDesc->batchTids[aocsFetchDesc->batchNextTid]) == segmentFileNum)
+				aocsFetchDesc->batchNextTid++;
+		}
+	}
+
+	if (slot != NULL)
+		ExecClearTuple(slot);
+	return false;
+}
+
 void
 aocs_fetch_finish(AOCSFetchDesc aocsFetchDesc)
 {
@@ -1576,6 +2462,9 @@ aocs_fetch_finish(AOCSFetchDesc aocsFetchDesc)
 
 	AppendOnlyBlockDirectory_End_forSearch(&aocsFetchDesc->blockDirectory);
 
+	if (aocsFetchDesc->prefetchDirectoryValid)
+		AppendOnlyBlockDirectory_End_forSearch(&aocsFetchDesc->prefetchDirectory);
+
 	if (aocsFetchDesc->segmentFileInfo)
 	{
 		FreeAllAOCSSegFileInfo(aocsFetchDesc->segmentFileInfo, aocsFetchDesc->totalSegfiles);
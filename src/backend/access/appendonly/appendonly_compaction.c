@@ -31,6 +31,7 @@
 #include "access/heapam.h"
 #include "access/transam.h"
 #include "access/tuptoaster.h"
+#include "access/xact.h"
 #include "catalog/catalog.h"
 #include "catalog/indexing.h"
 #include "catalog/pg_appendonly_fn.h"
@@ -38,17 +39,46 @@
 #include "cdb/cdbvars.h"
 #include "commands/vacuum.h"
 #include "executor/executor.h"
+#include "funcapi.h"
 #include "nodes/execnodes.h"
+#include "storage/backendid.h"
 #include "storage/procarray.h"
 #include "storage/lmgr.h"
+#include "storage/shmem.h"
+#include "utils/builtins.h"
 #include "utils/faultinjector.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/relcache.h"
 #include "utils/guc.h"
 #include "utils/snapmgr.h"
+#include "utils/timestamp.h"
 #include "miscadmin.h"
 
+/*
+ * Progress of the segment file compaction running in a backend, shown by
+ * the gp_stat_appendonly_compaction view. There is one entry per backend,
+ * updated following the st_changecount protocol of PgBackendStatus.
+ */
+typedef struct AppendOnlyCompactionProgress
+{
+	int			changecount;
+	int			pid;			/* 0 when the backend is not compacting */
+	Oid			datid;
+	Oid			relid;
+	int			segno;
+	bool		partial;
+	int64		total_tupcount;
+	int64		live_tupcount;
+	int64		scanned_tupcount;
+	int64		moved_tupcount;
+	TimestampTz start_time;
+} AppendOnlyCompactionProgress;
+
+static AppendOnlyCompactionProgress *CompactionProgressArray = NULL;
+static bool compactionProgressReported = false;
+static bool compactionXactCallbackRegistered = false;
+
 /*
  * Drops a segment file.
  *
@@ -335,6 +365,184 @@ AppendOnlyThrowAwayTuple(Relation rel,
 		   AOTupleIdGet_segmentFileNum(oldAoTupleId), AOTupleIdGet_rowNum(oldAoTupleId));
 }
 
+/*
+ * Returns the maximum number of live tuples to move out of a segment file
+ * in this compaction, or 0 if the whole segment file is compacted.
+ *
+ * With gp_appendonly_compaction_chunk_rows set, a lazy vacuum of a segment
+ * file that has more live tuples than that only moves one chunk of them,
+ * and hides the moved originals in the visibility map, as an UPDATE would.
+ * The segment file stays in use, with a higher ratio of hidden tuples, and
+ * the next vacuum moves the next chunk. The segment file is dropped by the
+ * vacuum that finds no more than a chunk of live tuples in it. This bounds
+ * the work and the I/O burst of each vacuum, at the price of writing some
+ * visibility map entries.
+ *
+ * Each chunk starts at the first row that the visibility map does not hide,
+ * and passes over the blocks before it without decompressing them. Their
+ * headers are still read, so the I/O of a chunk grows with its position in
+ * the segment file, and compacting a whole file in small chunks reads its
+ * beginning many times over.
+ */
+int64
+AppendOnlyCompaction_ChunkRows(int64 totalTupcount, int64 hiddenTupcount,
+							   bool isFull)
+{
+	int64		liveTupcount = totalTupcount - hiddenTupcount;
+
+	if (isFull || gp_appendonly_compaction_chunk_rows <= 0)
+		return 0;
+	if (liveTupcount <= gp_appendonly_compaction_chunk_rows)
+		return 0;
+	return gp_appendonly_compaction_chunk_rows;
+}
+
+/*
+ * Vacuum delay point of the compaction, called after approximately one
+ * varblock of the segment file has been scanned.
+ *
+ * Append-only storage does not go through the shared buffers, so nothing
+ * charges the vacuum cost balance on the way. We charge one page miss per
+ * varblock read, and one dirtied page if tuples were moved since the last
+ * delay point.
+ *
+ * gp_appendonly_compaction_cost_delay throttles the compaction on its own,
+ * whatever vacuum_cost_delay is, if set to 0 or more.
+ */
+void
+AppendOnlyCompaction_DelayPoint(bool moved)
+{
+	int			costDelay = gp_appendonly_compaction_cost_delay;
+	double		msec;
+
+	if (costDelay < 0)
+	{
+		if (!VacuumCostActive)
+			return;
+
+		VacuumCostBalance += VacuumCostPageMiss;
+		if (moved)
+			VacuumCostBalance += VacuumCostPageDirty;
+		vacuum_delay_point();
+		return;
+	}
+
+	CHECK_FOR_INTERRUPTS();
+
+	if (costDelay == 0)
+		return;
+
+	VacuumCostBalance += VacuumCostPageMiss;
+	if (moved)
+		VacuumCostBalance += VacuumCostPageDirty;
+
+	if (VacuumCostBalance >= VacuumCostLimit)
+	{
+		msec = costDelay * (double) VacuumCostBalance / VacuumCostLimit;
+		if (msec > costDelay * 4)
+			msec = costDelay * 4;
+
+		pg_usleep((long) (msec * 1000));
+
+		VacuumCostBalance = 0;
+
+		CHECK_FOR_INTERRUPTS();
+	}
+}
+
+/*
+ * Clears the progress entry of this backend at the end of the transaction
+ * if the compaction errored out before AppendOnlyCompaction_ReportEnd().
+ */
+static void
+AppendOnlyCompaction_XactCallback(XactEvent event, void *arg)
+{
+	if (compactionProgressReported &&
+		(event == XACT_EVENT_COMMIT || event == XACT_EVENT_ABORT ||
+		 event == XACT_EVENT_PREPARE))
+		AppendOnlyCompaction_ReportEnd();
+}
+
+/*
+ * Reports that this backend starts compacting the given segment file.
+ */
+void
+AppendOnlyCompaction_ReportBegin(Relation aorel, int segno,
+								 int64 totalTupcount, int64 liveTupcount,
+								 bool partial)
+{
+	volatile AppendOnlyCompactionProgress *entry;
+
+	if (CompactionProgressArray == NULL || MyBackendId == InvalidBackendId)
+		return;
+
+	if (!compactionXactCallbackRegistered)
+	{
+		RegisterXactCallback(AppendOnlyCompaction_XactCallback, NULL);
+		compactionXactCallbackRegistered = true;
+	}
+
+	entry = &CompactionProgressArray[MyBackendId - 1];
+
+	entry->changecount++;
+	entry->pid = MyProcPid;
+	entry->datid = MyDatabaseId;
+	entry->relid = RelationGetRelid(aorel);
+	entry->segno = segno;
+	entry->partial = partial;
+	entry->total_tupcount = totalTupcount;
+	entry->live_tupcount = liveTupcount;
+	entry->scanned_tupcount = 0;
+	entry->moved_tupcount = 0;
+	entry->start_time = GetCurrentTimestamp();
+	entry->changecount++;
+	Assert((entry->changecount & 1) == 0);
+
+	compactionProgressReported = true;
+}
+
+/*
+ * Reports the number of tuples scanned and moved so far.
+ */
+void
+AppendOnlyCompaction_ReportProgress(int64 scannedTupcount,
+									int64 movedTupcount)
+{
+	volatile AppendOnlyCompactionProgress *entry;
+
+	if (!compactionProgressReported)
+		return;
+
+	entry = &CompactionProgressArray[MyBackendId - 1];
+
+	entry->changecount++;
+	entry->scanned_tupcount = scannedTupcount;
+	entry->moved_tupcount = movedTupcount;
+	entry->changecount++;
+	Assert((entry->changecount & 1) == 0);
+}
+
+/*
+ * Reports that this backend is done compacting its segment file.
+ */
+void
+AppendOnlyCompaction_ReportEnd(void)
+{
+	volatile AppendOnlyCompactionProgress *entry;
+
+	if (!compactionProgressReported)
+		return;
+
+	entry = &CompactionProgressArray[MyBackendId - 1];
+
+	entry->changecount++;
+	entry->pid = 0;
+	entry->changecount++;
+	Assert((entry->changecount & 1) == 0);
+
+	compactionProgressReported = false;
+}
+
 /*
  * Assumes that the segment file lock is already held.
  * Assumes that the segment file should be compacted.
@@ -344,7 +552,8 @@ static void
 AppendOnlySegmentFileFullCompaction(Relation aorel,
 									AppendOnlyInsertDesc insertDesc,
 									FileSegInfo *fsinfo,
-									Snapshot	appendOnlyMetaDataSnapshot)
+									Snapshot	appendOnlyMetaDataSnapshot,
+									bool isFull)
 {
 	const char *relname;
 	AppendOnlyVisimap visiMap;
@@ -357,8 +566,14 @@ AppendOnlySegmentFileFullCompaction(Relation aorel,
 	ResultRelInfo *resultRelInfo;
 	EState	   *estate;
 	AOTupleId  *aoTupleId;
+	AOTupleId	oldAoTupleId;
 	int64		tupleCount = 0;
 	int64		tuplePerPage = INT_MAX;
+	int64		hiddenTupleCount;
+	int64		chunkRows;
+	int64		lastMovedTupleCount = 0;
+	AppendOnlyDeleteDesc deleteDesc = NULL;
+	HTSU_Result result;
 
 	Assert(Gp_role == GP_ROLE_EXECUTE || Gp_role == GP_ROLE_UTILITY);
 	Assert(RelationIsAoRows(aorel));
@@ -377,9 +592,24 @@ AppendOnlySegmentFileFullCompaction(Relation aorel,
 						   ShareUpdateExclusiveLock,
 						   appendOnlyMetaDataSnapshot);
 
+	hiddenTupleCount = AppendOnlyVisimap_GetSegmentFileHiddenTupleCount(&visiMap,
+																		compact_segno);
+	chunkRows = AppendOnlyCompaction_ChunkRows(fsinfo->total_tupcount,
+											   hiddenTupleCount, isFull);
+
 	elogif(Debug_appendonly_print_compaction,
-		   LOG, "Compact AO segno %d, relation %s, insert segno %d",
-		   compact_segno, relname, insertDesc->storageWrite.segmentFileNum);
+		   LOG, "Compact AO segno %d, relation %s, insert segno %d, chunk rows " INT64_FORMAT,
+		   compact_segno, relname, insertDesc->storageWrite.segmentFileNum,
+		   chunkRows);
+
+	/* The moved originals stay in the segment file, hide them */
+	if (chunkRows > 0)
+		deleteDesc = appendonly_delete_init(aorel, appendOnlyMetaDataSnapshot);
+
+	AppendOnlyCompaction_ReportBegin(aorel, compact_segno,
+									 fsinfo->total_tupcount,
+									 fsinfo->total_tupcount - hiddenTupleCount,
+									 chunkRows > 0);
 
 	/*
 	 * Todo: We need to limit the scan to one file and we need to avoid to
@@ -391,6 +621,16 @@ AppendOnlySegmentFileFullCompaction(Relation aorel,
 										 SnapshotAny, appendOnlyMetaDataSnapshot,
 										 &compact_segno, 1, 0, NULL);
 
+	/*
+	 * The rows before the first visible one were moved by the earlier chunks
+	 * or deleted, so a chunk starts there rather than at the beginning of
+	 * the segment file.
+	 */
+	if (chunkRows > 0)
+		appendonly_set_startrow(scanDesc,
+								AppendOnlyVisimap_GetFirstVisibleRowNum(&visiMap,
+																		compact_segno));
+
 	tupDesc = RelationGetDescr(aorel);
 	slot = MakeSingleTupleTableSlot(tupDesc);
 	mt_bind = create_memtuple_binding(tupDesc);
@@ -420,14 +660,28 @@ AppendOnlySegmentFileFullCompaction(Relation aorel,
 		aoTupleId = (AOTupleId *) slot_get_ctid(slot);
 		if (AppendOnlyVisimap_IsVisible(&scanDesc->visibilityMap, aoTupleId))
 		{
+			if (chunkRows > 0 && movedTupleCount >= chunkRows)
+				break;
+
+			oldAoTupleId = *aoTupleId;
 			AppendOnlyMoveTuple(slot,
 								mt_bind,
 								insertDesc,
 								resultRelInfo,
 								estate);
 			movedTupleCount++;
+
+			if (deleteDesc)
+			{
+				result = appendonly_delete(deleteDesc, &oldAoTupleId);
+				if (result != HeapTupleMayBeUpdated)
+					elog(ERROR, "could not hide moved tuple (%d," INT64_FORMAT ") of relation %s: %d",
+						 AOTupleIdGet_segmentFileNum(&oldAoTupleId),
+						 AOTupleIdGet_rowNum(&oldAoTupleId),
+						 relname, result);
+			}
 		}
-		else
+		else if (chunkRows == 0)
 		{
 			/* Tuple is invisible and needs to be dropped */
 			AppendOnlyThrowAwayTuple(aorel,
@@ -439,29 +693,52 @@ AppendOnlySegmentFileFullCompaction(Relation aorel,
 		 * Check for vacuum delay point after approximately a var block
 		 */
 		tupleCount++;
-		if (VacuumCostActive && tupleCount % tuplePerPage == 0)
+		if (tupleCount % tuplePerPage == 0)
 		{
-			vacuum_delay_point();
+			AppendOnlyCompaction_DelayPoint(movedTupleCount > lastMovedTupleCount);
+			AppendOnlyCompaction_ReportProgress(tupleCount, movedTupleCount);
+			lastMovedTupleCount = movedTupleCount;
 		}
 	}
 
-	SetFileSegInfoState(aorel, compact_segno, AOSEG_STATE_AWAITING_DROP);
-
-	AppendOnlyVisimap_DeleteSegmentFile(&visiMap, compact_segno);
+	if (deleteDesc)
+	{
+		/*
+		 * Only a chunk of the live tuples was moved. The segment file stays,
+		 * and so do its visibility map and block directory entries.
+		 */
+		appendonly_delete_finish(deleteDesc);
 
-	/* Delete all mini pages of the segment files if block directory exists */
-	if (OidIsValid(aorel->rd_appendonly->blkdirrelid))
+		elogif(Debug_appendonly_print_compaction, LOG,
+			   "Finished partial compaction: "
+			   "AO segfile %d, relation %s, moved tuple count " INT64_FORMAT,
+			   compact_segno, relname, movedTupleCount);
+	}
+	else
 	{
-		AppendOnlyBlockDirectory_DeleteSegmentFile(aorel,
-												   appendOnlyMetaDataSnapshot,
-												   compact_segno,
-												   0);
+		SetFileSegInfoState(aorel, compact_segno, AOSEG_STATE_AWAITING_DROP);
+
+		AppendOnlyVisimap_DeleteSegmentFile(&visiMap, compact_segno);
+
+		/*
+		 * Delete all mini pages of the segment files if block directory
+		 * exists
+		 */
+		if (OidIsValid(aorel->rd_appendonly->blkdirrelid))
+		{
+			AppendOnlyBlockDirectory_DeleteSegmentFile(aorel,
+													   appendOnlyMetaDataSnapshot,
+													   compact_segno,
+													   0);
+		}
+
+		elogif(Debug_appendonly_print_compaction, LOG,
+			   "Finished compaction: "
+			   "AO segfile %d, relation %s, moved tuple count " INT64_FORMAT,
+			   compact_segno, relname, movedTupleCount);
 	}
 
-	elogif(Debug_appendonly_print_compaction, LOG,
-		   "Finished compaction: "
-		   "AO segfile %d, relation %s, moved tuple count " INT64_FORMAT,
-		   compact_segno, relname, movedTupleCount);
+	AppendOnlyCompaction_ReportEnd();
 
 	AppendOnlyVisimap_Finish(&visiMap, NoLock);
 
@@ -777,7 +1054,8 @@ AppendOnlyCompact(Relation aorel,
 			AppendOnlySegmentFileFullCompaction(aorel,
 												insertDesc,
 												fsinfo,
-												appendOnlyMetaDataSnapshot);
+												appendOnlyMetaDataSnapshot,
+												isFull);
 		}
 		pfree(fsinfo);
 	}
@@ -831,3 +1109,117 @@ AppendOnlyCompaction_IsRelationEmpty(Relation aorel)
 	heap_close(pg_aoseg_rel, AccessShareLock);
 	return empty;
 }
+
+/*
+ * Shared memory for the compaction progress entries.
+ */
+Size
+AppendOnlyCompactionShmemSize(void)
+{
+	return mul_size(sizeof(AppendOnlyCompactionProgress), MaxBackends);
+}
+
+void
+AppendOnlyCompactionShmemInit(void)
+{
+	Size		size = AppendOnlyCompactionShmemSize();
+	bool		found;
+
+	CompactionProgressArray = (AppendOnlyCompactionProgress *)
+		ShmemInitStruct("Append-only Compaction Progress", size, &found);
+
+	if (!found)
+		MemSet(CompactionProgressArray, 0, size);
+}
+
+/*
+ * Returns the segment file compactions running on this segment.
+ */
+Datum
+gp_stat_get_appendonly_compaction(PG_FUNCTION_ARGS)
+{
+#define GP_STAT_GET_APPENDONLY_COMPACTION_COLS	11
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	int			i;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	for (i = 0; i < MaxBackends; i++)
+	{
+		volatile AppendOnlyCompactionProgress *entry = &CompactionProgressArray[i];
+		AppendOnlyCompactionProgress local;
+		Datum		values[GP_STAT_GET_APPENDONLY_COMPACTION_COLS];
+		bool		nulls[GP_STAT_GET_APPENDONLY_COMPACTION_COLS];
+
+		/*
+		 * Follow the protocol of retrying if changecount changes while we
+		 * copy the entry, or if it's odd.
+		 */
+		for (;;)
+		{
+			int			save_changecount = entry->changecount;
+
+			local.pid = entry->pid;
+			if (local.pid != 0)
+				memcpy(&local, (char *) entry, sizeof(AppendOnlyCompactionProgress));
+
+			if (save_changecount == entry->changecount &&
+				(save_changecount & 1) == 0)
+				break;
+
+			/* Make sure we can break out of loop if stuck... */
+			CHECK_FOR_INTERRUPTS();
+		}
+
+		if (local.pid == 0)
+			continue;
+
+		MemSet(nulls, 0, sizeof(nulls));
+
+		values[0] = Int32GetDatum(GpIdentity.segindex);
+		values[1] = Int32GetDatum(local.pid);
+		values[2] = ObjectIdGetDatum(local.datid);
+		values[3] = ObjectIdGetDatum(local.relid);
+		values[4] = Int32GetDatum(local.segno);
+		values[5] = CStringGetTextDatum(local.partial ? "chunk" : "whole");
+		values[6] = Int64GetDatum(local.total_tupcount);
+		values[7] = Int64GetDatum(local.live_tupcount);
+		values[8] = Int64GetDatum(local.scanned_tupcount);
+		values[9] = Int64GetDatum(local.moved_tupcount);
+		values[10] = TimestampTzGetDatum(local.start_time);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	/* clean up and return the tuplestore */
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
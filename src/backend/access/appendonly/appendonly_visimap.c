@@ -70,6 +70,32 @@ typedef struct AppendOnlyVisiMapDeleteData
 } AppendOnlyVisiMapDeleteData;
 
 
+/*
+ * Value structure for the visimap entry cache of a scan.
+ */
+typedef struct AppendOnlyVisiMapCacheData
+{
+	/*
+	 * Key of the visimap entry. The deletion key type is reused.
+	 */
+	AppendOnlyVisiMapDeleteKey key;
+
+	/*
+	 * Tuple id of the visimap entry, invalid if there is no entry for the
+	 * range.
+	 */
+	ItemPointerData tupleTid;
+
+	/*
+	 * Decompressed bitmap of the entry. NULL if all rows are visible.
+	 */
+	Bitmapset  *bitmap;
+} AppendOnlyVisiMapCacheData;
+
+static uint32 hash_delete_key(const void *key, Size keysize);
+
+static int	hash_compare_keys(const void *key1, const void *key2, Size keysize);
+
 
 static void AppendOnlyVisimap_Store(
 						AppendOnlyVisimap *visiMap);
@@ -78,6 +104,9 @@ static void AppendOnlyVisimap_Find(
 					   AppendOnlyVisimap *visiMap,
 					   AOTupleId *tupleId);
 
+static void AppendOnlyVisimap_ResetCache(
+							 AppendOnlyVisimap *visiMap);
+
 /*
  * Finishes the visimap operations.
  * No other function should be called with the given
@@ -140,9 +169,73 @@ AppendOnlyVisimap_Init(
 								appendOnlyMetaDataSnapshot,
 								visiMap->memoryContext);
 
+	visiMap->maxCacheEntries = gp_appendonly_visimap_cache_entries;
+	visiMap->cacheContext = NULL;
+	visiMap->entryCache = NULL;
+	if (visiMap->maxCacheEntries > 0)
+	{
+		visiMap->cacheContext = AllocSetContextCreate(
+													  visiMap->memoryContext,
+													  "VisiMapCacheContext",
+													  ALLOCSET_DEFAULT_MINSIZE,
+													  ALLOCSET_DEFAULT_INITSIZE,
+													  ALLOCSET_DEFAULT_MAXSIZE);
+		AppendOnlyVisimap_ResetCache(visiMap);
+	}
+
 	MemoryContextSwitchTo(oldContext);
 }
 
+/*
+ * Empties the visimap entry cache.
+ */
+static void
+AppendOnlyVisimap_ResetCache(
+							 AppendOnlyVisimap *visiMap)
+{
+	HASHCTL		hash_ctl;
+
+	Assert(visiMap->cacheContext);
+
+	if (visiMap->entryCache != NULL)
+		hash_destroy(visiMap->entryCache);
+	MemoryContextReset(visiMap->cacheContext);
+
+	MemSet(&hash_ctl, 0, sizeof(hash_ctl));
+	hash_ctl.keysize = sizeof(AppendOnlyVisiMapDeleteKey);
+	hash_ctl.entrysize = sizeof(AppendOnlyVisiMapCacheData);
+	hash_ctl.hash = hash_delete_key;
+	hash_ctl.match = hash_compare_keys;
+	hash_ctl.hcxt = visiMap->cacheContext;
+	visiMap->entryCache = hash_create("VisimapScanEntryCache",
+									  16, /* start small and extend */
+									  &hash_ctl,
+									  HASH_ELEM | HASH_FUNCTION | HASH_COMPARE | HASH_CONTEXT);
+}
+
+/*
+ * Drops the cached copy of the entry for the given range, once the entry
+ * is changed.
+ */
+static void
+AppendOnlyVisimap_ForgetCached(
+							   AppendOnlyVisimap *visiMap,
+							   int segno,
+							   int64 firstRowNum)
+{
+	AppendOnlyVisiMapDeleteKey key;
+	AppendOnlyVisiMapCacheData *cached;
+
+	if (visiMap->entryCache == NULL)
+		return;
+
+	key.segno = segno;
+	key.firstRowNum = firstRowNum;
+	cached = hash_search(visiMap->entryCache, &key, HASH_REMOVE, NULL);
+	if (cached)
+		bms_free(cached->bitmap);
+}
+
 /*
  * Moves the visibility map entry so that the given
  * AO tuple id is covered by it.
@@ -158,6 +251,9 @@ AppendOnlyVisimap_Find(
 					   AppendOnlyVisimap *visiMap,
 					   AOTupleId *aoTupleId)
 {
+	AppendOnlyVisiMapDeleteKey key;
+	AppendOnlyVisiMapCacheData *cached;
+
 	Assert(visiMap);
 	Assert(aoTupleId);
 
@@ -166,6 +262,33 @@ AppendOnlyVisimap_Find(
 		   "(tupleId) = %s",
 		   AOTupleIdToString(aoTupleId));
 
+	if (visiMap->entryCache != NULL)
+	{
+		key.segno = AOTupleIdGet_segmentFileNum(aoTupleId);
+		key.firstRowNum = AppendOnlyVisimapEntry_GetFirstRowNum(
+																&visiMap->visimapEntry, aoTupleId);
+		cached = hash_search(visiMap->entryCache, &key, HASH_FIND, NULL);
+		if (cached)
+		{
+			AppendOnlyVisimapEntry *visimapEntry = &visiMap->visimapEntry;
+			MemoryContext oldContext;
+
+			Assert(!visimapEntry->dirty);
+
+			bms_free(visimapEntry->bitmap);
+			visimapEntry->bitmap = NULL;
+
+			oldContext = MemoryContextSwitchTo(visimapEntry->memoryContext);
+			visimapEntry->bitmap = bms_copy(cached->bitmap);
+			MemoryContextSwitchTo(oldContext);
+
+			visimapEntry->segmentFileNum = key.segno;
+			visimapEntry->firstRowNum = key.firstRowNum;
+			memcpy(&visimapEntry->tupleTid, &cached->tupleTid, sizeof(ItemPointerData));
+			return;
+		}
+	}
+
 	if (!AppendOnlyVisimapStore_Find(&visiMap->visimapStore,
 									 AOTupleIdGet_segmentFileNum(aoTupleId),
 									 AppendOnlyVisimapEntry_GetFirstRowNum(
@@ -177,6 +300,26 @@ AppendOnlyVisimap_Find(
 		 */
 		AppendOnlyVisimapEntry_New(&visiMap->visimapEntry, aoTupleId);
 	}
+
+	if (visiMap->entryCache != NULL)
+	{
+		MemoryContext oldContext;
+
+		/*
+		 * Start over rather than evict single entries, the scans that fill
+		 * the cache up mostly move forward anyway.
+		 */
+		if (hash_get_num_entries(visiMap->entryCache) >= visiMap->maxCacheEntries)
+			AppendOnlyVisimap_ResetCache(visiMap);
+
+		cached = hash_search(visiMap->entryCache, &key, HASH_ENTER, NULL);
+
+		oldContext = MemoryContextSwitchTo(visiMap->cacheContext);
+		cached->bitmap = bms_copy(visiMap->visimapEntry.bitmap);
+		MemoryContextSwitchTo(oldContext);
+
+		memcpy(&cached->tupleTid, &visiMap->visimapEntry.tupleTid, sizeof(ItemPointerData));
+	}
 }
 
 /*
@@ -215,6 +358,109 @@ AppendOnlyVisimap_IsVisible(
 											aoTupleId);
 }
 
+/*
+ * Checks if all rowCount rows of the segment file starting at firstRowNum
+ * are visible according to the visibility map, so that a scan can skip the
+ * check of each single row. A negative result only means that some of the
+ * rows may be invisible.
+ *
+ * Assumes that the visibility has been initialized and not finished.
+ */
+bool
+AppendOnlyVisimap_IsRangeVisible(
+								 AppendOnlyVisimap *visiMap,
+								 int segno,
+								 int64 firstRowNum,
+								 int64 rowCount)
+{
+	int64		rowNum = firstRowNum;
+	int64		endRowNum = firstRowNum + rowCount;
+
+	Assert(visiMap);
+
+	while (rowNum < endRowNum)
+	{
+		AOTupleId	aoTupleId;
+		int64		lastRowNum;
+
+		AOTupleIdInit(&aoTupleId, segno, rowNum);
+		if (!AppendOnlyVisimapEntry_CoversTuple(&visiMap->visimapEntry,
+												&aoTupleId))
+		{
+			/* if necessary persist the current entry before moving. */
+			if (AppendOnlyVisimapEntry_HasChanged(&visiMap->visimapEntry))
+			{
+				AppendOnlyVisimap_Store(visiMap);
+			}
+
+			AppendOnlyVisimap_Find(visiMap, &aoTupleId);
+		}
+
+		lastRowNum = Min(endRowNum,
+						 visiMap->visimapEntry.firstRowNum + APPENDONLY_VISIMAP_MAX_RANGE) - 1;
+		if (!AppendOnlyVisimapEntry_IsRangeVisible(&visiMap->visimapEntry,
+												   rowNum, lastRowNum))
+			return false;
+
+		rowNum = lastRowNum + 1;
+	}
+
+	elogif(Debug_appendonly_print_visimap, LOG,
+		   "Append-only visi map: All rows visible: "
+		   "(segno, firstRowNum, rowCount) = (%d, " INT64_FORMAT ", " INT64_FORMAT ")",
+		   segno, firstRowNum, rowCount);
+
+	return true;
+}
+
+/*
+ * Returns the lowest row number of the segment file that is not hidden by
+ * the visibility map. All the rows before it are invisible for good, e.g.
+ * moved away by an earlier chunk of compaction.
+ *
+ * Looks up one visibility map entry per APPENDONLY_VISIMAP_MAX_RANGE rows
+ * before that row number.
+ *
+ * Assumes that the visibility has been initialized and not finished.
+ */
+int64
+AppendOnlyVisimap_GetFirstVisibleRowNum(
+										AppendOnlyVisimap *visiMap,
+										int segno)
+{
+	int64		rowNum = 1;
+
+	Assert(visiMap);
+
+	while (true)
+	{
+		AOTupleId	aoTupleId;
+		int64		visibleRowNum;
+
+		AOTupleIdInit(&aoTupleId, segno, rowNum);
+		if (!AppendOnlyVisimapEntry_CoversTuple(&visiMap->visimapEntry,
+												&aoTupleId))
+		{
+			/* if necessary persist the current entry before moving. */
+			if (AppendOnlyVisimapEntry_HasChanged(&visiMap->visimapEntry))
+			{
+				AppendOnlyVisimap_Store(visiMap);
+			}
+
+			AppendOnlyVisimap_Find(visiMap, &aoTupleId);
+		}
+
+		/* A range without an entry is all visible, so this ends */
+		visibleRowNum =
+			AppendOnlyVisimapEntry_GetFirstVisibleRowNum(&visiMap->visimapEntry,
+														 rowNum);
+		if (visibleRowNum >= 0)
+			return visibleRowNum;
+
+		rowNum = visiMap->visimapEntry.firstRowNum + APPENDONLY_VISIMAP_MAX_RANGE;
+	}
+}
+
 /*
  * Stores the current visibility map entry information
  * in the relation either as update or delete.
@@ -233,6 +479,10 @@ AppendOnlyVisimap_Store(
 	Assert(visiMap);
 	Assert(AppendOnlyVisimapEntry_IsValid(&visiMap->visimapEntry));
 
+	AppendOnlyVisimap_ForgetCached(visiMap,
+								   visiMap->visimapEntry.segmentFileNum,
+								   visiMap->visimapEntry.firstRowNum);
+
 	AppendOnlyVisimapStore_Store(&visiMap->visimapStore, &visiMap->visimapEntry);
 
 }
@@ -252,6 +502,9 @@ AppendOnlyVisimap_DeleteSegmentFile(
 
 	AppendOnlyVisimapStore_DeleteSegmentFile(&visiMap->visimapStore,
 											 segno);
+
+	if (visiMap->entryCache != NULL)
+		AppendOnlyVisimap_ResetCache(visiMap);
 }
 
 /*
@@ -615,6 +868,8 @@ AppendOnlyVisimapDelete_Stash(
 
 	key.segno = visiMap->visimapEntry.segmentFileNum;
 	key.firstRowNum = visiMap->visimapEntry.firstRowNum;
+	AppendOnlyVisimap_ForgetCached(visiMap, key.segno, key.firstRowNum);
+
 	found = false;
 	r = hash_search(visiMapDelete->dirtyEntryCache, &key,
 					HASH_ENTER, &found);
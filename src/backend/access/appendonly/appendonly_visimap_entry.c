@@ -486,6 +486,72 @@ AppendOnlyVisimapEntry_IsVisible(
 	return visibilityBit;
 }
 
+/*
+ * Checks if all rows from firstRowNum to lastRowNum (inclusive) are visible
+ * according to the bitmap.
+ *
+ * Should only be called if the current visimap entry covers both rows.
+ */
+bool
+AppendOnlyVisimapEntry_IsRangeVisible(
+									  AppendOnlyVisimapEntry *visiMapEntry,
+									  int64 firstRowNum,
+									  int64 lastRowNum)
+{
+	int64		firstOffset,
+				lastOffset;
+	int			nextHidden;
+
+	Assert(visiMapEntry);
+	Assert(AppendOnlyVisimapEntry_IsValid(visiMapEntry));
+	Assert(firstRowNum <= lastRowNum);
+
+	if (AppendOnlyVisimapEntry_AreAllVisible(visiMapEntry))
+		return true;
+
+	AppendOnlyVisimapEntry_GetRownumOffset(visiMapEntry,
+										   firstRowNum, &firstOffset);
+	AppendOnlyVisimapEntry_GetRownumOffset(visiMapEntry,
+										   lastRowNum, &lastOffset);
+	Assert(lastOffset < APPENDONLY_VISIMAP_MAX_RANGE);
+
+	nextHidden = bms_next_member(visiMapEntry->bitmap, (int) firstOffset - 1);
+	return (nextHidden < 0 || nextHidden > lastOffset);
+}
+
+/*
+ * Returns the first visible row number at or after rowNum within the range
+ * of the current visibility map entry, or -1 if all of them are hidden.
+ */
+int64
+AppendOnlyVisimapEntry_GetFirstVisibleRowNum(
+											 AppendOnlyVisimapEntry *visiMapEntry,
+											 int64 rowNum)
+{
+	int64		offset;
+	int			nextHidden;
+
+	Assert(visiMapEntry);
+	Assert(AppendOnlyVisimapEntry_IsValid(visiMapEntry));
+
+	if (AppendOnlyVisimapEntry_AreAllVisible(visiMapEntry))
+		return rowNum;
+
+	AppendOnlyVisimapEntry_GetRownumOffset(visiMapEntry,
+										   rowNum, &offset);
+
+	nextHidden = bms_next_member(visiMapEntry->bitmap, (int) offset - 1);
+	while (nextHidden == offset)
+	{
+		offset++;
+		nextHidden = bms_next_member(visiMapEntry->bitmap, nextHidden);
+	}
+
+	if (offset >= APPENDONLY_VISIMAP_MAX_RANGE)
+		return -1;
+	return visiMapEntry->firstRowNum + offset;
+}
+
 /*
  * The minimal size (in uint32's elements) the entry array needs to have to
  * cover the given offset
@@ -1256,19 +1256,31 @@ getNextBlock(AppendOnlyScanDesc scan)
 			return false;
 	}
 
-	if (!AppendOnlyExecutorReadBlock_GetBlockInfo(
-												  &scan->storageRead,
-												  &scan->executorReadBlock))
+	while (true)
 	{
-		if (scan->blockDirectory)
+		if (!AppendOnlyExecutorReadBlock_GetBlockInfo(
+													  &scan->storageRead,
+													  &scan->executorReadBlock))
 		{
-			AppendOnlyBlockDirectory_End_forInsert(scan->blockDirectory);
+			if (scan->blockDirectory)
+			{
+				AppendOnlyBlockDirectory_End_forInsert(scan->blockDirectory);
+			}
+
+			/* done reading the file */
+			CloseScannedFileSeg(scan);
+
+			return false;
 		}
 
-		/* done reading the file */
-		CloseScannedFileSeg(scan);
+		if (scan->executorReadBlock.blockFirstRowNum +
+			scan->executorReadBlock.rowCount > scan->startRowNum)
+			break;
 
-		return false;
+		/* The block ends before the start row, pass it over. */
+		Assert(scan->blockDirectory == NULL);
+		AppendOnlyExecutionReadBlock_FinishedScanBlock(&scan->executorReadBlock);
+		AppendOnlyStorageRead_SkipCurrentBlock(&scan->storageRead);
 	}
 
 	if (scan->blockDirectory)
@@ -1330,6 +1342,16 @@ appendonlygettup(AppendOnlyScanDesc scan,
 			}
 
 			scan->bufferDone = false;
+
+			/*
+			 * Rows of a block without any deleted row need not be checked
+			 * one by one.
+			 */
+			scan->blockAllVisible = isSnapshotAny ||
+				AppendOnlyVisimap_IsRangeVisible(&scan->visibilityMap,
+												 scan->executorReadBlock.segmentFileNum,
+												 scan->executorReadBlock.blockFirstRowNum,
+												 scan->executorReadBlock.rowCount);
 		}
 
 		found = AppendOnlyExecutorReadBlock_ScanNextTuple(&scan->executorReadBlock,
@@ -1344,7 +1366,8 @@ appendonlygettup(AppendOnlyScanDesc scan,
 			 */
 			AOTupleId  *aoTupleId = (AOTupleId *) slot_get_ctid(slot);
 
-			if (!isSnapshotAny && !AppendOnlyVisimap_IsVisible(&scan->visibilityMap, aoTupleId))
+			if (!scan->blockAllVisible &&
+				!AppendOnlyVisimap_IsVisible(&scan->visibilityMap, aoTupleId))
 			{
 				/*
 				 * The tuple is invisible.
@@ -1716,6 +1739,23 @@ appendonly_beginscan(Relation relation,
 											  keys);
 }
 
+/* ----------------
+ *		appendonly_set_startrow	- skip to a row of the segment files
+ *
+ * Pass over the blocks of the segment files that only hold rows before
+ * startRowNum, without reading their contents. Rows before it in the
+ * first block read are still returned. Must be called before the first
+ * appendonly_getnext(), and not when building the block directory.
+ * ----------------
+ */
+void
+appendonly_set_startrow(AppendOnlyScanDesc scan, int64 startRowNum)
+{
+	Assert(scan->blockDirectory == NULL);
+
+	scan->startRowNum = startRowNum;
+}
+
 /* ----------------
  *		appendonly_afterscan	- perform after scan actions
  *
@@ -2420,6 +2460,167 @@ appendonly_fetch(AppendOnlyFetchDesc aoFetchDesc,
 	/* Segment file not in aoseg table.. */
 }
 
+/*
+ * Ask the kernel to read ahead the block directory ranges of the batch TIDs
+ * that follow the fetch position, up to gp_appendonly_prefetch_depth ranges
+ * at a time.
+ *
+ * Only ranges of the segment file currently open are prefetched; the ranges
+ * of the next segment file are looked at once the fetch has opened it.
+ */
+static void
+fetchBatchPrefetch(AppendOnlyFetchDesc aoFetchDesc)
+{
+	int			numRanges = 0;
+
+	if (gp_appendonly_prefetch_depth <= 0 ||
+		!aoFetchDesc->currentSegmentFile.isOpen ||
+		aoFetchDesc->batchNextTid < aoFetchDesc->batchRefillTid)
+		return;
+
+	if (!aoFetchDesc->prefetchDirectoryValid)
+	{
+		MemoryContext oldcxt = MemoryContextSwitchTo(aoFetchDesc->initContext);
+
+		AppendOnlyBlockDirectory_Init_forSearch(
+												&aoFetchDesc->prefetchDirectory,
+												aoFetchDesc->appendOnlyMetaDataSnapshot,
+												aoFetchDesc->segmentFileInfo,
+												aoFetchDesc->totalSegfiles,
+												aoFetchDesc->relation,
+												1,
+												false,
+												NULL);
+		aoFetchDesc->prefetchDirectoryValid = true;
+
+		MemoryContextSwitchTo(oldcxt);
+	}
+
+	if (aoFetchDesc->batchPrefetchTid < aoFetchDesc->batchNextTid)
+		aoFetchDesc->batchPrefetchTid = aoFetchDesc->batchNextTid;
+
+	while (aoFetchDesc->batchPrefetchTid < aoFetchDesc->batchNumTids &&
+		   numRanges < gp_appendonly_prefetch_depth)
+	{
+		AOTupleId  *aoTupleId = &aoFetchDesc->batchTids[aoFetchDesc->batchPrefetchTid];
+		int64		beginFileOffset;
+		int64		afterFileOffset;
+		int64		firstRowNum;
+		int64		lastRowNum;
+
+		if (AOTupleIdGet_segmentFileNum(aoTupleId) !=
+			aoFetchDesc->currentSegmentFile.num)
+			break;
+
+		if (aoFetchDesc->prefetchEntryValid &&
+			AppendOnlyBlockDirectoryEntry_RangeHasRow(&aoFetchDesc->prefetchEntry,
+													  AOTupleIdGet_rowNum(aoTupleId)))
+		{
+			aoFetchDesc->batchPrefetchTid++;
+			continue;
+		}
+
+		if (!AppendOnlyBlockDirectory_GetEntry(&aoFetchDesc->prefetchDirectory,
+											   aoTupleId,
+											   0,
+											   &aoFetchDesc->prefetchEntry))
+		{
+			/*
+			 * Rows missing from the block directory cost an index lookup
+			 * each, typically the tail of a lossy bitmap page. Leave them
+			 * to the fetch rather than looking them up twice.
+			 */
+			aoFetchDesc->prefetchEntryValid = false;
+			aoFetchDesc->batchPrefetchTid = aoFetchDesc->batchNumTids;
+			break;
+		}
+		aoFetchDesc->prefetchEntryValid = true;
+
+		AppendOnlyBlockDirectoryEntry_GetBeginRange(&aoFetchDesc->prefetchEntry,
+													&beginFileOffset,
+													&firstRowNum);
+		AppendOnlyBlockDirectoryEntry_GetEndRange(&aoFetchDesc->prefetchEntry,
+												  &afterFileOffset,
+												  &lastRowNum);
+		if (afterFileOffset > aoFetchDesc->currentSegmentFile.logicalEof)
+			afterFileOffset = aoFetchDesc->currentSegmentFile.logicalEof;
+
+		/* It is only a hint, so don't complain if it fails. */
+		if (afterFileOffset > beginFileOffset)
+			(void) FilePrefetch(aoFetchDesc->storageRead.file,
+								beginFileOffset,
+								(int) (afterFileOffset - beginFileOffset));
+
+		aoFetchDesc->batchRefillTid = aoFetchDesc->batchPrefetchTid;
+		aoFetchDesc->batchPrefetchTid++;
+		numRanges++;
+	}
+
+	/* Nothing left to prefetch until the fetch moves on. */
+	if (aoFetchDesc->batchRefillTid < aoFetchDesc->batchNextTid)
+		aoFetchDesc->batchRefillTid = aoFetchDesc->batchPrefetchTid;
+}
+
+/*
+ * appendonly_fetch_batch_begin -- start fetching a batch of tids.
+ *
+ * The tids must be sorted, so that the batch visits each segment file and
+ * each block at most once. The array is not copied, and must stay valid
+ * until appendonly_fetch_batch_next has returned false.
+ */
+void
+appendonly_fetch_batch_begin(AppendOnlyFetchDesc aoFetchDesc,
+							 AOTupleId *aoTupleIds,
+							 int numTids)
+{
+	aoFetchDesc->batchTids = aoTupleIds;
+	aoFetchDesc->batchNumTids = numTids;
+	aoFetchDesc->batchNextTid = 0;
+	aoFetchDesc->batchPrefetchTid = 0;
+	aoFetchDesc->batchRefillTid = 0;
+	aoFetchDesc->prefetchEntryValid = false;
+}
+
+/*
+ * appendonly_fetch_batch_next -- fetch the next visible tuple of the batch.
+ *
+ * Tids that don't match a visible tuple are skipped. The tid of the returned
+ * tuple is stored in the slot.
+ *
+ * Return false when the batch is exhausted.
+ */
+bool
+appendonly_fetch_batch_next(AppendOnlyFetchDesc aoFetchDesc,
+							TupleTableSlot *slot)
+{
+	while (aoFetchDesc->batchNextTid < aoFetchDesc->batchNumTids)
+	{
+		AOTupleId  *aoTupleId = &aoFetchDesc->batchTids[aoFetchDesc->batchNextTid];
+		int			segmentFileNum = AOTupleIdGet_segmentFileNum(aoTupleId);
+
+		fetchBatchPrefetch(aoFetchDesc);
+
+		aoFetchDesc->batchNextTid++;
+		if (appendonly_fetch(aoFetchDesc, aoTupleId, slot))
+			return true;
+
+		/*
+		 * If the segment file could not be opened, none of the remaining
+		 * tids in it can be found either.
+		 */
+		if (!aoFetchDesc->currentSegmentFile.isOpen)
+		{
+			while (aoFetchDesc->batchNextTid < aoFetchDesc->batchNumTids &&
+				   AOTupleIdGet_segmentFileNum(&aoFetchDesc->batchTids[aoFetchDesc->batchNextTid]) == segmentFileNum)
+				aoFetchDesc->batchNextTid++;
+		}
+	}
+
+	if (slot != NULL)
+		ExecClearTuple(slot);
+	return false;
+}
+
 void
 appendonly_fetch_finish(AppendOnlyFetchDesc aoFetchDesc)
 {
@@ -2433,6 +2634,9 @@ appendonly_fetch_finish(AppendOnlyFetchDesc aoFetchDesc)
 
 	AppendOnlyBlockDirectory_End_forSearch(&aoFetchDesc->blockDirectory);
 
+	if (aoFetchDesc->prefetchDirectoryValid)
+		AppendOnlyBlockDirectory_End_forSearch(&aoFetchDesc->prefetchDirectory);
+
 	if (aoFetchDesc->segmentFileInfo)
 	{
 		FreeAllSegFileInfo(aoFetchDesc->segmentFileInfo, aoFetchDesc->totalSegfiles);
@@ -2748,6 +2952,13 @@ appendonly_insert_init(Relation rel, int segno, bool update_mode)
 	aoInsertDesc->storageWrite.compressionState = cs;
 	aoInsertDesc->storageWrite.verifyWriteCompressionState = verifyCs;
 
+	/*
+	 * Without a block directory nothing needs the file offset of a block as
+	 * soon as it is finished, so blocks can be compressed on helper threads.
+	 */
+	if (!OidIsValid(aoInsertDesc->aoi_rel->rd_appendonly->blkdirrelid))
+		AppendOnlyStorageWrite_EnablePipeline(&aoInsertDesc->storageWrite);
+
 	elogif(Debug_appendonly_print_insert, LOG,
 		   "Append-only insert initialize for table '%s' segment file %u "
 		   "(compression = %s, compression type %s, compression level %d)",
@@ -36,6 +36,15 @@ minipage_size(uint32 nEntry)
 		sizeof(MinipageEntry) * nEntry;
 }
 
+/*
+ * Size of a minipage with nEntry entries that also carries their zones.
+ */
+static inline uint32
+minipage_zones_size(uint32 nEntry)
+{
+	return minipage_size(nEntry) + sizeof(MinipageZone) * nEntry;
+}
+
 static void load_last_minipage(
 				   AppendOnlyBlockDirectory *blockDirectory,
 				   int64 lastSequence,
@@ -61,7 +70,12 @@ static bool insert_new_entry(AppendOnlyBlockDirectory *blockDirectory,
 				 int64 firstRowNum,
 				 int64 fileOffset,
 				 int64 rowCount,
-				 bool addColAction);
+				 bool addColAction,
+				 MinipageZone *zone,
+				 SortSupport zoneSortSupport);
+static void merge_zone(MinipageZone *zone,
+		   MinipageZone *newZone,
+		   SortSupport zoneSortSupport);
 
 void
 AppendOnlyBlockDirectoryEntry_GetBeginRange(
@@ -158,7 +172,9 @@ init_internal(AppendOnlyBlockDirectory *blockDirectory, bool *proj)
 		&blockDirectory->minipages[groupNo];
 
 		minipageInfo->minipage =
-			palloc0(minipage_size(NUM_MINIPAGE_ENTRIES));
+			palloc0(minipage_zones_size(NUM_MINIPAGE_ENTRIES));
+		minipageInfo->zones =
+			palloc0(sizeof(MinipageZone) * NUM_MINIPAGE_ENTRIES);
 		minipageInfo->numMinipageEntries = 0;
 	}
 
@@ -679,7 +695,115 @@ AppendOnlyBlockDirectory_InsertEntry(
 									 bool addColAction)
 {
 	return insert_new_entry(blockDirectory, columnGroupNo, firstRowNum,
-							fileOffset, rowCount, addColAction);
+							fileOffset, rowCount, addColAction,
+							NULL, NULL);
+}
+
+/*
+ * AppendOnlyBlockDirectory_InsertEntryWithZone
+ *
+ * Same as AppendOnlyBlockDirectory_InsertEntry(), but also records the zone
+ * of the values in the new block. zoneSortSupport is the ordering the zone
+ * was computed with; it is needed to merge zones when entries are coalesced
+ * because of gp_blockdirectory_entry_min_range.
+ */
+bool
+AppendOnlyBlockDirectory_InsertEntryWithZone(
+											 AppendOnlyBlockDirectory *blockDirectory,
+											 int columnGroupNo,
+											 int64 firstRowNum,
+											 int64 fileOffset,
+											 int64 rowCount,
+											 bool addColAction,
+											 MinipageZone *zone,
+											 SortSupport zoneSortSupport)
+{
+	return insert_new_entry(blockDirectory, columnGroupNo, firstRowNum,
+							fileOffset, rowCount, addColAction,
+							zone, zoneSortSupport);
+}
+
+/*
+ * AppendOnlyBlockZone_Reset
+ *
+ * Start an empty zone for a new block.
+ */
+void
+AppendOnlyBlockZone_Reset(MinipageZone *zone)
+{
+	zone->minValue = 0;
+	zone->maxValue = 0;
+	zone->nullCount = 0;
+	zone->flags = MINIPAGE_ZONE_VALID;
+}
+
+/*
+ * AppendOnlyBlockZone_Add
+ *
+ * Account for one more value in the zone.
+ */
+void
+AppendOnlyBlockZone_Add(MinipageZone *zone,
+						SortSupport zoneSortSupport,
+						Datum value,
+						bool isnull)
+{
+	if (isnull)
+		zone->nullCount++;
+	else if ((zone->flags & MINIPAGE_ZONE_HAS_VALUES) == 0)
+	{
+		zone->minValue = (int64) value;
+		zone->maxValue = (int64) value;
+		zone->flags |= MINIPAGE_ZONE_HAS_VALUES;
+	}
+	else if (ApplySortComparator(value, false,
+								 (Datum) zone->minValue, false,
+								 zoneSortSupport) < 0)
+		zone->minValue = (int64) value;
+	else if (ApplySortComparator(value, false,
+								 (Datum) zone->maxValue, false,
+								 zoneSortSupport) > 0)
+		zone->maxValue = (int64) value;
+}
+
+/*
+ * merge_zone
+ *
+ * Widen zone so that it also covers newZone. The result is invalid if
+ * either input is.
+ */
+static void
+merge_zone(MinipageZone *zone, MinipageZone *newZone,
+		   SortSupport zoneSortSupport)
+{
+	if (newZone == NULL || zoneSortSupport == NULL ||
+		(zone->flags & MINIPAGE_ZONE_VALID) == 0 ||
+		(newZone->flags & MINIPAGE_ZONE_VALID) == 0)
+	{
+		zone->flags = 0;
+		return;
+	}
+
+	zone->nullCount += newZone->nullCount;
+	if ((newZone->flags & MINIPAGE_ZONE_HAS_VALUES) == 0)
+		return;
+
+	if ((zone->flags & MINIPAGE_ZONE_HAS_VALUES) == 0)
+	{
+		zone->minValue = newZone->minValue;
+		zone->maxValue = newZone->maxValue;
+		zone->flags |= MINIPAGE_ZONE_HAS_VALUES;
+		return;
+	}
+
+	if (ApplySortComparator((Datum) newZone->minValue, false,
+							(Datum) zone->minValue, false,
+							zoneSortSupport) < 0)
+		zone->minValue = newZone->minValue;
+	if (ApplySortComparator((Datum) newZone->maxValue, false,
+							(Datum) zone->maxValue, false,
+							zoneSortSupport) > 0)
+		zone->maxValue = newZone->maxValue;
 }
 
 /*
@@ -694,7 +818,9 @@ insert_new_entry(
 				 int64 firstRowNum,
 				 int64 fileOffset,
 				 int64 rowCount,
-				 bool addColAction)
+				 bool addColAction,
+				 MinipageZone *zone,
+				 SortSupport zoneSortSupport)
 {
 	MinipageEntry *entry = NULL;
 	MinipagePerColumnGroup *minipageInfo;
@@ -739,7 +865,12 @@ insert_new_entry(
 
 		if (gp_blockdirectory_entry_min_range > 0 &&
 			fileOffset - entry->fileOffset < gp_blockdirectory_entry_min_range)
+		{
+			/* The latest entry now covers the new block as well */
+			merge_zone(&minipageInfo->zones[lastEntryNo], zone,
+					   zoneSortSupport);
 			return true;
+		}
 
 		/* Update the rowCount in the latest entry */
 		Assert(entry->rowCount <= firstRowNum - entry->firstRowNum);
@@ -770,6 +901,8 @@ insert_new_entry(
 		 */
 		MemSet(minipageInfo->minipage->entry, 0,
 			   minipageInfo->numMinipageEntries * sizeof(MinipageEntry));
+		MemSet(minipageInfo->zones, 0,
+			   minipageInfo->numMinipageEntries * sizeof(MinipageZone));
 		minipageInfo->numMinipageEntries = 0;
 	}
 
@@ -780,6 +913,12 @@ insert_new_entry(
 	entry->fileOffset = fileOffset;
 	entry->rowCount = rowCount;
 
+	if (zone != NULL)
+		minipageInfo->zones[minipageInfo->numMinipageEntries] = *zone;
+	else
+		MemSet(&minipageInfo->zones[minipageInfo->numMinipageEntries], 0,
+			   sizeof(MinipageZone));
+
 	minipageInfo->numMinipageEntries++;
 
 	ereportif(Debug_appendonly_print_blockdirectory, LOG,
@@ -792,6 +931,121 @@ insert_new_entry(
 	return true;
 }
 
+/*
+ * AppendOnlyBlockDirectory_GetZones
+ *
+ * Return the block directory entries of the given segment file and column
+ * group that carry a valid zone, in row number order. Entries at or beyond
+ * eof are left-overs of aborted inserts and are ignored.
+ *
+ * Returns NULL, with *numZones set to 0, if the relation has no block
+ * directory.
+ */
+AppendOnlyBlockZone *
+AppendOnlyBlockDirectory_GetZones(Relation aoRel,
+								  Snapshot snapshot,
+								  int segno,
+								  int columnGroupNo,
+								  int64 eof,
+								  int *numZones)
+{
+	Relation	blkdirRel;
+	Relation	blkdirIdx;
+	TupleDesc	heapTupleDesc;
+	ScanKeyData scanKeys[2];
+	IndexScanDesc indexScan;
+	HeapTuple	tuple;
+	Datum	   *values;
+	bool	   *nulls;
+	AppendOnlyBlockZone *zones = NULL;
+	int			maxZones = 0;
+
+	*numZones = 0;
+
+	if (!OidIsValid(aoRel->rd_appendonly->blkdirrelid))
+		return NULL;
+
+	Assert(OidIsValid(aoRel->rd_appendonly->blkdiridxid));
+
+	blkdirRel = heap_open(aoRel->rd_appendonly->blkdirrelid, AccessShareLock);
+	blkdirIdx = index_open(aoRel->rd_appendonly->blkdiridxid, AccessShareLock);
+	heapTupleDesc = RelationGetDescr(blkdirRel);
+
+	values = palloc(sizeof(Datum) * heapTupleDesc->natts);
+	nulls = palloc(sizeof(bool) * heapTupleDesc->natts);
+
+	ScanKeyInit(&scanKeys[0],
+				1,				/* segno */
+				BTEqualStrategyNumber,
+				F_INT4EQ,
+				Int32GetDatum(segno));
+	ScanKeyInit(&scanKeys[1],
+				2,				/* columngroup_no */
+				BTEqualStrategyNumber,
+				F_INT4EQ,
+				Int32GetDatum(columnGroupNo));
+
+	indexScan = index_beginscan(blkdirRel, blkdirIdx, snapshot, 2, 0);
+	index_rescan(indexScan, scanKeys, 2, NULL, 0);
+
+	while ((tuple = index_getnext(indexScan, ForwardScanDirection)) != NULL)
+	{
+		struct varlena *value;
+		Minipage   *minipage;
+		MinipageZone *minipageZones;
+		uint32		entryNo;
+
+		heap_deform_tuple(tuple, heapTupleDesc, values, nulls);
+		Assert(!nulls[Anum_pg_aoblkdir_minipage - 1]);
+
+		value = (struct varlena *)
+			DatumGetPointer(values[Anum_pg_aoblkdir_minipage - 1]);
+		minipage = (Minipage *) pg_detoast_datum(value);
+
+		if (minipage->version >= MINIPAGE_VERSION_ZONES)
+		{
+			minipageZones = (MinipageZone *) &minipage->entry[minipage->nEntry];
+
+			for (entryNo = 0; entryNo < minipage->nEntry; entryNo++)
+			{
+				MinipageEntry *entry = &minipage->entry[entryNo];
+
+				if (entry->fileOffset >= eof)
+					break;
+				if ((minipageZones[entryNo].flags & MINIPAGE_ZONE_VALID) == 0)
+					continue;
+
+				if (*numZones >= maxZones)
+				{
+					maxZones = Max(maxZones * 2, NUM_MINIPAGE_ENTRIES);
+					if (zones == NULL)
+						zones = palloc(sizeof(AppendOnlyBlockZone) * maxZones);
+					else
+						zones = repalloc(zones,
+										 sizeof(AppendOnlyBlockZone) * maxZones);
+				}
+
+				zones[*numZones].firstRowNum = entry->firstRowNum;
+				zones[*numZones].rowCount = entry->rowCount;
+				zones[*numZones].zone = minipageZones[entryNo];
+				(*numZones)++;
+			}
+		}
+
+		if ((struct varlena *) minipage != value)
+			pfree(minipage);
+	}
+	index_endscan(indexScan);
+
+	pfree(values);
+	pfree(nulls);
+
+	index_close(blkdirIdx, AccessShareLock);
+	heap_close(blkdirRel, AccessShareLock);
+
+	return zones;
+}
+
 /*
  * AppendOnlyBlockDirectory_DeleteSegmentFile
  *
@@ -922,7 +1176,7 @@ copy_out_minipage(MinipagePerColumnGroup *minipageInfo,
 	value = (struct varlena *)
 		DatumGetPointer(minipage_value);
 	detoast_value = pg_detoast_datum(value);
-	Assert(VARSIZE(detoast_value) <= minipage_size(NUM_MINIPAGE_ENTRIES));
+	Assert(VARSIZE(detoast_value) <= minipage_zones_size(NUM_MINIPAGE_ENTRIES));
 
 	memcpy(minipageInfo->minipage, detoast_value, VARSIZE(detoast_value));
 	if (detoast_value != value)
@@ -931,6 +1185,22 @@ copy_out_minipage(MinipagePerColumnGroup *minipageInfo,
 	Assert(minipageInfo->minipage->nEntry <= NUM_MINIPAGE_ENTRIES);
 
 	minipageInfo->numMinipageEntries = minipageInfo->minipage->nEntry;
+
+	/*
+	 * Minipages written before zones were introduced, or without any zone,
+	 * carry no zone array.
+	 */
+	if (minipageInfo->minipage->version >= MINIPAGE_VERSION_ZONES)
+	{
+		Assert(VARSIZE(minipageInfo->minipage) ==
+			   minipage_zones_size(minipageInfo->numMinipageEntries));
+		memcpy(minipageInfo->zones,
+			   &minipageInfo->minipage->entry[minipageInfo->numMinipageEntries],
+			   sizeof(MinipageZone) * minipageInfo->numMinipageEntries);
+	}
+	else
+		MemSet(minipageInfo->zones, 0,
+			   sizeof(MinipageZone) * minipageInfo->numMinipageEntries);
 }
 
 
@@ -1147,6 +1417,7 @@ write_minipage(AppendOnlyBlockDirectory *blockDirectory,
 	bool	   *nulls = blockDirectory->nulls;
 	Relation	blkdirRel = blockDirectory->blkdirRel;
 	TupleDesc	heapTupleDesc = RelationGetDescr(blkdirRel);
+	uint32		i;
 
 	Assert(minipageInfo->numMinipageEntries > 0);
 
@@ -1166,8 +1437,34 @@ write_minipage(AppendOnlyBlockDirectory *blockDirectory,
 		Int64GetDatum(minipageInfo->minipage->entry[0].firstRowNum);
 	nulls[Anum_pg_aoblkdir_firstrownum - 1] = false;
 
-	SET_VARSIZE(minipageInfo->minipage,
-				minipage_size(minipageInfo->numMinipageEntries));
+	/*
+	 * Append the zones after the entries if any entry has one. Otherwise
+	 * keep the original format, which is also the only one that older
+	 * releases can read: zones read from an existing minipage are dropped
+	 * when gp_appendonly_record_zone_maps is off.
+	 */
+	minipageInfo->minipage->version = MINIPAGE_VERSION_ORIGINAL;
+	for (i = 0; i < minipageInfo->numMinipageEntries; i++)
+	{
+		if (gp_appendonly_record_zone_maps &&
+			(minipageInfo->zones[i].flags & MINIPAGE_ZONE_VALID))
+		{
+			minipageInfo->minipage->version = MINIPAGE_VERSION_ZONES;
+			break;
+		}
+	}
+
+	if (minipageInfo->minipage->version == MINIPAGE_VERSION_ZONES)
+	{
+		memcpy(&minipageInfo->minipage->entry[minipageInfo->numMinipageEntries],
+			   minipageInfo->zones,
+			   sizeof(MinipageZone) * minipageInfo->numMinipageEntries);
+		SET_VARSIZE(minipageInfo->minipage,
+					minipage_zones_size(minipageInfo->numMinipageEntries));
+	}
+	else
+		SET_VARSIZE(minipageInfo->minipage,
+					minipage_size(minipageInfo->numMinipageEntries));
 	minipageInfo->minipage->nEntry = minipageInfo->numMinipageEntries;
 	values[Anum_pg_aoblkdir_minipage - 1] =
 		PointerGetDatum(minipageInfo->minipage);
@@ -70,6 +70,36 @@ test__AppendOnlyVisimapEntry_CoversTuple(void **state)
 	assert_true(result);
 }
 
+static void
+test__AppendOnlyVisimapEntry_GetFirstVisibleRowNum(void **state)
+{
+	AppendOnlyVisimapEntry* visiMapEntry = malloc(sizeof(AppendOnlyVisimapEntry));
+	int64 rowNum;
+
+	visiMapEntry->segmentFileNum = 1;
+	visiMapEntry->firstRowNum = 32768;
+	visiMapEntry->bitmap = NULL;
+
+	/* No row hidden. */
+	assert_true(AppendOnlyVisimapEntry_GetFirstVisibleRowNum(visiMapEntry, 32768) == 32768);
+	assert_true(AppendOnlyVisimapEntry_GetFirstVisibleRowNum(visiMapEntry, 40000) == 40000);
+
+	/* Rows 32768 to 32777 and 32779 hidden. */
+	for (rowNum = 0; rowNum < 10; rowNum++)
+		visiMapEntry->bitmap = bms_add_member(visiMapEntry->bitmap, rowNum);
+	visiMapEntry->bitmap = bms_add_member(visiMapEntry->bitmap, 11);
+
+	assert_true(AppendOnlyVisimapEntry_GetFirstVisibleRowNum(visiMapEntry, 32768) == 32778);
+	assert_true(AppendOnlyVisimapEntry_GetFirstVisibleRowNum(visiMapEntry, 32772) == 32778);
+	assert_true(AppendOnlyVisimapEntry_GetFirstVisibleRowNum(visiMapEntry, 32779) == 32780);
+
+	/* All rows of the entry hidden. */
+	for (rowNum = 0; rowNum < APPENDONLY_VISIMAP_MAX_RANGE; rowNum++)
+		visiMapEntry->bitmap = bms_add_member(visiMapEntry->bitmap, rowNum);
+
+	assert_true(AppendOnlyVisimapEntry_GetFirstVisibleRowNum(visiMapEntry, 32768) == -1);
+	assert_true(AppendOnlyVisimapEntry_GetFirstVisibleRowNum(visiMapEntry, 65535) == -1);
+}
 
 int
 main(int argc, char *argv[])
@@ -78,7 +108,8 @@ main(int argc, char *argv[])
 
 	const		UnitTest tests[] = {
 		unit_test(test__AppendOnlyVisimapEntry_GetFirstRowNum),
-		unit_test(test__AppendOnlyVisimapEntry_CoversTuple)
+		unit_test(test__AppendOnlyVisimapEntry_CoversTuple),
+		unit_test(test__AppendOnlyVisimapEntry_GetFirstVisibleRowNum)
 	};
 
 	MemoryContextInit();
@@ -682,6 +682,9 @@ CREATE VIEW gp_stat_replication AS
          ON G.gp_segment_id = R.gp_segment_id
     );
 
+CREATE VIEW gp_stat_appendonly_compaction AS
+    SELECT * FROM pg_catalog.gp_stat_get_appendonly_compaction();
+
 CREATE VIEW pg_replication_slots AS
     SELECT
             L.slot_name,
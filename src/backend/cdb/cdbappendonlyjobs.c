@@ -0,0 +1,571 @@
+/*-------------------------------------------------------------------------
+ *
+ * cdbappendonlyjobs.c
+ *	  Compress and decompress Append-Only Storage Blocks on helper threads.
+ *
+ * (See .h file for usage comments)
+ *
+ * The pool is a fixed array of job slots shared by all the readers and
+ * writers of the backend, protected by one mutex. A slot goes FREE ->
+ * QUEUED when the backend submits a block, QUEUED -> RUNNING when a thread
+ * (or the backend itself, if it needs the block before any thread got to
+ * it) starts on it, and RUNNING -> DONE when the output has been produced
+ * in the slot. The backend copies the output out and frees the slot. The
+ * slot buffers are only (re)allocated by the backend while the slot is
+ * FREE, with malloc() so that no memory context reset can pull them from
+ * under a running thread.
+ *
+ * Compression and decompression jobs share the threads, which take the
+ * oldest queued job of either kind. Each kind may only hold as many slots
+ * as its own GUC allows, so readers and writers cannot starve each other.
+ *
+ * Readers and writers are identified by an owner number that is never
+ * reused, so a slot left behind by one that went away on error can never
+ * be mistaken for a block of another. Such slots are freed at the end of
+ * the transaction.
+ *
+ * A slot keeps its zstd compression context across jobs, so that it is not
+ * set up again for every block.
+ *
+ * IDENTIFICATION
+ *	    src/backend/cdb/cdbappendonlyjobs.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <pthread.h>
+#include <signal.h>
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+#ifdef HAVE_LIBZSTD
+#include <zstd.h>
+#endif
+
+#include "access/xact.h"
+#include "cdb/cdbappendonlyjobs.h"
+#include "utils/guc.h"
+
+/* Job slots per thread, for each kind of job. */
+#define JOB_SLOTS_PER_WORKER	4
+
+#define JOB_MAX_WORKERS		32
+
+typedef enum JobSlotState
+{
+	JobSlot_Free = 0,
+	JobSlot_Queued,
+	JobSlot_Running,
+	JobSlot_Done
+} JobSlotState;
+
+typedef struct JobSlot
+{
+	JobSlotState state;
+	AppendOnlyJobKind kind;
+
+	int64		owner;
+	int64		key;			/* block offset or number, up to the owner */
+	int64		submitted;		/* submit order, threads take the oldest */
+
+	AppendOnlyCompressionAlgorithm algorithm;
+	int			level;			/* compression level */
+
+	uint8	   *input;
+	int32		inputLen;
+	int32		inputCapacity;
+
+	/*
+	 * outputLimit is the decompressed length for decompression, and the
+	 * most the compressed content may take for compression. outputLen is
+	 * the length produced, or -1 if the job failed, or the content could
+	 * not be compressed to less than its own length.
+	 */
+	uint8	   *output;
+	int32		outputLen;
+	int32		outputLimit;
+	int32		outputCapacity;
+
+#ifdef HAVE_LIBZSTD
+	ZSTD_CCtx  *zstdContext;
+#endif
+} JobSlot;
+
+static pthread_mutex_t jobLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobWork = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t jobDone = PTHREAD_COND_INITIALIZER;
+
+static JobSlot jobSlots[2 * JOB_MAX_WORKERS * JOB_SLOTS_PER_WORKER];
+static int	jobNumWorkers = 0;
+static int64 jobSubmitCount = 0;
+static int64 jobOwnerCount = 0;
+static bool jobXactCallbackRegistered = false;
+
+/*
+ * Run the compression library on the input of the slot, into output.
+ * Returns the output length, or -1. Must not touch any backend state,
+ * since it runs on the threads.
+ */
+static int32
+run_job(JobSlot *slot, uint8 *output)
+{
+	switch (slot->algorithm)
+	{
+#ifdef HAVE_LIBZ
+		case AppendOnlyCompression_Zlib:
+			{
+				uLongf		destLen = slot->outputLimit;
+
+				if (slot->kind == AppendOnlyJob_Decompress)
+				{
+					if (uncompress(output, &destLen,
+								   slot->input, slot->inputLen) != Z_OK ||
+						destLen != (uLongf) slot->outputLimit)
+						return -1;
+				}
+				else if (compress2(output, &destLen,
+								   slot->input, slot->inputLen,
+								   slot->level) != Z_OK ||
+						 destLen >= (uLongf) slot->inputLen)
+					return -1;
+				return (int32) destLen;
+			}
+#endif
+#ifdef HAVE_LIBZSTD
+		case AppendOnlyCompression_Zstd:
+			{
+				size_t		result;
+
+				if (slot->kind == AppendOnlyJob_Decompress)
+				{
+					result = ZSTD_decompress(output, slot->outputLimit,
+											 slot->input, slot->inputLen);
+					if (ZSTD_isError(result) ||
+						result != (size_t) slot->outputLimit)
+						return -1;
+					return (int32) result;
+				}
+
+				if (slot->zstdContext == NULL)
+				{
+					slot->zstdContext = ZSTD_createCCtx();
+					if (slot->zstdContext == NULL)
+						return -1;
+				}
+
+				result = ZSTD_compressCCtx(slot->zstdContext,
+										   output, slot->outputLimit,
+										   slot->input, slot->inputLen,
+										   slot->level);
+				if (ZSTD_isError(result) || result >= (size_t) slot->inputLen)
+					return -1;
+				return (int32) result;
+			}
+#endif
+		default:
+			return -1;
+	}
+}
+
+static JobSlot *
+oldest_queued_slot(void)
+{
+	JobSlot    *oldest = NULL;
+	int			i;
+
+	for (i = 0; i < lengthof(jobSlots); i++)
+	{
+		JobSlot    *slot = &jobSlots[i];
+
+		if (slot->state == JobSlot_Queued &&
+			(oldest == NULL || slot->submitted < oldest->submitted))
+			oldest = slot;
+	}
+
+	return oldest;
+}
+
+static void *
+job_worker_main(void *arg)
+{
+	pthread_mutex_lock(&jobLock);
+	for (;;)
+	{
+		JobSlot    *slot = oldest_queued_slot();
+		int32		outputLen;
+
+		if (slot == NULL)
+		{
+			pthread_cond_wait(&jobWork, &jobLock);
+			continue;
+		}
+
+		slot->state = JobSlot_Running;
+		pthread_mutex_unlock(&jobLock);
+
+		outputLen = run_job(slot, slot->output);
+
+		pthread_mutex_lock(&jobLock);
+		slot->outputLen = outputLen;
+		slot->state = JobSlot_Done;
+		pthread_cond_broadcast(&jobDone);
+	}
+
+	return NULL;
+}
+
+/* The number of threads the GUC asks for a kind of job */
+static int
+kind_workers(AppendOnlyJobKind kind)
+{
+	if (kind == AppendOnlyJob_Compress)
+		return Min(gp_appendonly_compress_workers, JOB_MAX_WORKERS);
+	else
+		return Min(gp_appendonly_decompress_workers, JOB_MAX_WORKERS);
+}
+
+/*
+ * Start threads until there are as many as the kind of job wants. Returns
+ * the number of threads running.
+ */
+static int
+start_workers(AppendOnlyJobKind kind)
+{
+	int			wanted = kind_workers(kind);
+
+	while (jobNumWorkers < wanted)
+	{
+		pthread_t	thread;
+		pthread_attr_t attr;
+		sigset_t	sigs;
+		sigset_t	oldSigs;
+		int			err;
+
+		/* The threads must not run our signal handlers. */
+		sigfillset(&sigs);
+		pthread_sigmask(SIG_BLOCK, &sigs, &oldSigs);
+
+		pthread_attr_init(&attr);
+		pthread_attr_setstacksize(&attr, Max(PTHREAD_STACK_MIN, (256 * 1024)));
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+		err = pthread_create(&thread, &attr, job_worker_main, NULL);
+		pthread_attr_destroy(&attr);
+
+		pthread_sigmask(SIG_SETMASK, &oldSigs, NULL);
+
+		if (err != 0)
+		{
+			elog(LOG, "could not create append-only compression helper thread: error code %d", err);
+			break;
+		}
+		jobNumWorkers++;
+	}
+
+	return jobNumWorkers;
+}
+
+/*
+ * Wait until the slot is not being worked on. Called with the lock held.
+ */
+static void
+wait_slot_idle(JobSlot *slot)
+{
+	while (slot->state == JobSlot_Running)
+		pthread_cond_wait(&jobDone, &jobLock);
+}
+
+/*
+ * Free every slot at the end of the transaction. No reader or writer
+ * survives it.
+ */
+static void
+job_xact_callback(XactEvent event, void *arg)
+{
+	int			i;
+
+	if (event != XACT_EVENT_COMMIT && event != XACT_EVENT_ABORT &&
+		event != XACT_EVENT_PREPARE)
+		return;
+
+	if (jobNumWorkers == 0)
+		return;
+
+	pthread_mutex_lock(&jobLock);
+	for (i = 0; i < lengthof(jobSlots); i++)
+	{
+		wait_slot_idle(&jobSlots[i]);
+		jobSlots[i].state = JobSlot_Free;
+	}
+	pthread_mutex_unlock(&jobLock);
+}
+
+/*
+ * Which library the threads can use for content compressed with
+ * compressType, or AppendOnlyCompression_None.
+ */
+AppendOnlyCompressionAlgorithm
+AppendOnlyCompression_AlgorithmFor(char *compressType)
+{
+	if (compressType == NULL)
+		return AppendOnlyCompression_None;
+#ifdef HAVE_LIBZ
+	if (pg_strcasecmp(compressType, "zlib") == 0)
+		return AppendOnlyCompression_Zlib;
+#endif
+#ifdef HAVE_LIBZSTD
+	if (pg_strcasecmp(compressType, "zstd") == 0)
+		return AppendOnlyCompression_Zstd;
+#endif
+	return AppendOnlyCompression_None;
+}
+
+/*
+ * Get a new owner number for a reader or writer. Each open of a segment
+ * file by a reader should get a new one.
+ */
+int64
+AppendOnlyJobs_NewOwner(void)
+{
+	return ++jobOwnerCount;
+}
+
+/*
+ * Number of job slots the pool offers to a kind of job, starting the
+ * threads if needed. 0 if the pool is disabled for it.
+ */
+int
+AppendOnlyJobs_NumSlots(AppendOnlyJobKind kind)
+{
+	return Min(kind_workers(kind), start_workers(kind)) *
+		JOB_SLOTS_PER_WORKER;
+}
+
+/*
+ * Number of jobs of the owner in the pool.
+ */
+int
+AppendOnlyJobs_NumPending(int64 owner)
+{
+	int			count = 0;
+	int			i;
+
+	if (jobNumWorkers == 0)
+		return 0;
+
+	pthread_mutex_lock(&jobLock);
+	for (i = 0; i < lengthof(jobSlots); i++)
+	{
+		if (jobSlots[i].state != JobSlot_Free &&
+			jobSlots[i].owner == owner)
+			count++;
+	}
+	pthread_mutex_unlock(&jobLock);
+
+	return count;
+}
+
+/*
+ * Queue a job for the block the owner knows by key. For decompression,
+ * outputLen is the decompressed length of the block; for compression, the
+ * most the compressed content may take. The input is copied, so the
+ * caller's buffer can be reused right after. Returns false if the pool is
+ * full or disabled.
+ */
+bool
+AppendOnlyJobs_Submit(int64 owner, int64 key,
+					  AppendOnlyJobKind kind,
+					  AppendOnlyCompressionAlgorithm algorithm,
+					  int level,
+					  uint8 *input, int32 inputLen,
+					  int32 outputLen)
+{
+	JobSlot    *slot = NULL;
+	int			numSlots;
+	int			numUsed = 0;
+	int			i;
+
+	if (algorithm == AppendOnlyCompression_None ||
+		inputLen <= 0 || outputLen <= 0)
+		return false;
+
+	numSlots = AppendOnlyJobs_NumSlots(kind);
+	if (numSlots == 0)
+		return false;
+
+	if (!jobXactCallbackRegistered)
+	{
+		RegisterXactCallback(job_xact_callback, NULL);
+		jobXactCallbackRegistered = true;
+	}
+
+	pthread_mutex_lock(&jobLock);
+	for (i = 0; i < lengthof(jobSlots); i++)
+	{
+		if (jobSlots[i].state == JobSlot_Free)
+		{
+			if (slot == NULL)
+				slot = &jobSlots[i];
+		}
+		else if (jobSlots[i].kind == kind)
+			numUsed++;
+	}
+	pthread_mutex_unlock(&jobLock);
+
+	if (slot == NULL || numUsed >= numSlots)
+		return false;
+
+	/*
+	 * The slot is free, so no thread looks at it, and only the backend
+	 * hands out slots. Its buffers can be set up without the lock.
+	 */
+	if (slot->inputCapacity < inputLen)
+	{
+		uint8	   *buffer = realloc(slot->input, inputLen);
+
+		if (buffer == NULL)
+			return false;
+		slot->input = buffer;
+		slot->inputCapacity = inputLen;
+	}
+	if (slot->outputCapacity < outputLen)
+	{
+		uint8	   *buffer = realloc(slot->output, outputLen);
+
+		if (buffer == NULL)
+			return false;
+		slot->output = buffer;
+		slot->outputCapacity = outputLen;
+	}
+
+	memcpy(slot->input, input, inputLen);
+	slot->inputLen = inputLen;
+	slot->outputLimit = outputLen;
+	slot->outputLen = -1;
+	slot->kind = kind;
+	slot->algorithm = algorithm;
+	slot->level = level;
+	slot->owner = owner;
+	slot->key = key;
+
+	pthread_mutex_lock(&jobLock);
+	slot->submitted = ++jobSubmitCount;
+	slot->state = JobSlot_Queued;
+	pthread_cond_signal(&jobWork);
+	pthread_mutex_unlock(&jobLock);
+
+	return true;
+}
+
+/*
+ * Get the output of the job for the block the owner knows by key into
+ * output. Waits for the thread working on it; a job no thread has started
+ * on yet is run right here. Returns false if there is no such job.
+ *
+ * *outputLen is set to the length of the output, or to -1 if the job
+ * failed, the content could not be compressed to less than its own length,
+ * or the output does not fit in outputCapacity. If input is not NULL, the
+ * input of the job is then copied back to it, which must have room for it.
+ */
+bool
+AppendOnlyJobs_Take(int64 owner, int64 key,
+					uint8 *output, int32 outputCapacity,
+					int32 *outputLen, uint8 *input)
+{
+	JobSlot    *slot = NULL;
+	int32		len;
+	int			i;
+
+	if (jobNumWorkers == 0)
+		return false;
+
+	pthread_mutex_lock(&jobLock);
+	for (i = 0; i < lengthof(jobSlots); i++)
+	{
+		if (jobSlots[i].state != JobSlot_Free &&
+			jobSlots[i].owner == owner &&
+			jobSlots[i].key == key)
+		{
+			slot = &jobSlots[i];
+			break;
+		}
+	}
+
+	if (slot == NULL)
+	{
+		pthread_mutex_unlock(&jobLock);
+		return false;
+	}
+
+	if (slot->state == JobSlot_Queued)
+	{
+		bool		direct = (outputCapacity >= slot->outputLimit);
+
+		/*
+		 * No thread got to it yet. Rather do it ourselves than wait, right
+		 * into the caller's buffer if it is large enough.
+		 */
+		slot->state = JobSlot_Running;
+		pthread_mutex_unlock(&jobLock);
+
+		len = run_job(slot, direct ? output : slot->output);
+
+		pthread_mutex_lock(&jobLock);
+		slot->outputLen = len;
+		slot->state = JobSlot_Done;
+		if (direct)
+		{
+			if (len < 0 && input != NULL)
+				memcpy(input, slot->input, slot->inputLen);
+			slot->state = JobSlot_Free;
+			pthread_mutex_unlock(&jobLock);
+
+			*outputLen = len;
+			return true;
+		}
+	}
+
+	wait_slot_idle(slot);
+	Assert(slot->state == JobSlot_Done);
+
+	len = slot->outputLen;
+	if (len > outputCapacity)
+		len = -1;
+	if (len >= 0)
+		memcpy(output, slot->output, len);
+	else if (input != NULL)
+		memcpy(input, slot->input, slot->inputLen);
+	slot->state = JobSlot_Free;
+	pthread_mutex_unlock(&jobLock);
+
+	*outputLen = len;
+	return true;
+}
+
+/*
+ * Drop the jobs of the owner for keys before beforeKey, which it passed
+ * without taking them. Pass -1 to drop all of them.
+ */
+void
+AppendOnlyJobs_Release(int64 owner, int64 beforeKey)
+{
+	int			i;
+
+	if (jobNumWorkers == 0)
+		return;
+
+	pthread_mutex_lock(&jobLock);
+	for (i = 0; i < lengthof(jobSlots); i++)
+	{
+		JobSlot    *slot = &jobSlots[i];
+
+		if (slot->state == JobSlot_Free || slot->owner != owner)
+			continue;
+		if (beforeKey >= 0 && slot->key >= beforeKey)
+			continue;
+
+		wait_slot_idle(slot);
+		slot->state = JobSlot_Free;
+	}
+	pthread_mutex_unlock(&jobLock);
+}
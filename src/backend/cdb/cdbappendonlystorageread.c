@@ -99,10 +99,22 @@ AppendOnlyStorageRead_Init(AppendOnlyStorageRead *storageRead,
 		AppendOnlyStorageFormat_RegularHeaderLenNeeded(
 													   storageRead->storageAttributes.checksum);
 
+	/*
+	 * Blocks are only decompressed ahead as far as they have been read
+	 * into memory, so read further ahead when doing so.
+	 */
+	if (gp_appendonly_decompress_workers > 0 &&
+		storageRead->storageAttributes.compress)
+		storageRead->decompressAlgorithm =
+			AppendOnlyCompression_AlgorithmFor(storageRead->storageAttributes.compressType);
+
 	/*
 	 * Initialize BufferedRead.
 	 */
-	storageRead->largeReadLen = 2 * storageRead->maxBufferLen;
+	if (storageRead->decompressAlgorithm != AppendOnlyCompression_None)
+		storageRead->largeReadLen = 4 * storageRead->maxBufferLen;
+	else
+		storageRead->largeReadLen = 2 * storageRead->maxBufferLen;
 
 	memoryLen = BufferedReadMemoryLen(storageRead->maxBufferLen,
 									  storageRead->largeReadLen);
@@ -171,6 +183,9 @@ AppendOnlyStorageRead_FinishSession(AppendOnlyStorageRead *storageRead)
 
 	oldMemoryContext = MemoryContextSwitchTo(storageRead->memoryContext);
 
+	if (storageRead->decompressAlgorithm != AppendOnlyCompression_None)
+		AppendOnlyJobs_Release(storageRead->decompressOwner, -1);
+
 	/*
 	 * UNDONE: This expects the MemoryContext to be what was used for the
 	 * 'memory' in ~Init
@@ -305,6 +320,12 @@ AppendOnlyStorageRead_FinishOpenFile(AppendOnlyStorageRead *storageRead,
 
 	storageRead->logicalEof = logicalEof;
 
+	if (storageRead->decompressAlgorithm != AppendOnlyCompression_None)
+	{
+		storageRead->decompressOwner = AppendOnlyJobs_NewOwner();
+		storageRead->decompressAheadOffset = 0;
+	}
+
 	BufferedReadSetFile(
 						&storageRead->bufferedRead,
 						storageRead->file,
@@ -428,6 +449,12 @@ AppendOnlyStorageRead_SetTemporaryRange(AppendOnlyStorageRead *storageRead,
 	Assert(afterFileOffset >= 0);
 	Assert(afterFileOffset <= storageRead->logicalEof);
 
+	if (storageRead->decompressAlgorithm != AppendOnlyCompression_None)
+	{
+		AppendOnlyJobs_Release(storageRead->decompressOwner, -1);
+		storageRead->decompressAheadOffset = 0;
+	}
+
 	BufferedReadSetTemporaryRange(&storageRead->bufferedRead,
 								  beginFileOffset,
 								  afterFileOffset);
@@ -447,6 +474,9 @@ AppendOnlyStorageRead_CloseFile(AppendOnlyStorageRead *storageRead)
 	if (storageRead->file == -1)
 		return;
 
+	if (storageRead->decompressAlgorithm != AppendOnlyCompression_None)
+		AppendOnlyJobs_Release(storageRead->decompressOwner, -1);
+
 	FileClose(storageRead->file);
 
 	storageRead->file = -1;
@@ -764,6 +794,130 @@ AppendOnlyStorageRead_LogBlockHeader(AppendOnlyStorageRead *storageRead,
 	pfree(blockHeaderStr);
 }
 
+/*
+ * Submit the compressed blocks following the current one for decompression
+ * on the helper threads, as far as they are already in memory.
+ *
+ * Only the headers are looked at here. The block checksum is still
+ * verified when the reader gets to the block, before the decompressed
+ * content is used.
+ */
+static void
+AppendOnlyStorageRead_DecompressAhead(AppendOnlyStorageRead *storageRead)
+{
+	int64		offset;
+	int			maxPending = gp_appendonly_decompress_workers;
+	int			numPending;
+
+	/* Blocks the reader went past are of no use anymore. */
+	AppendOnlyJobs_Release(storageRead->decompressOwner,
+						   storageRead->current.headerOffsetInFile);
+
+	/*
+	 * Zero padding to page boundaries, and large content, are left to the
+	 * usual read path.
+	 */
+	if (storageRead->storageAttributes.safeFSWriteSize != 0 ||
+		storageRead->current.isLarge)
+		return;
+
+	offset = Max(storageRead->decompressAheadOffset,
+				 storageRead->current.headerOffsetInFile +
+				 storageRead->current.overallBlockLen);
+
+	numPending = AppendOnlyJobs_NumPending(storageRead->decompressOwner);
+	while (numPending < maxPending)
+	{
+		uint8	   *header;
+		AoHeaderKind headerKind;
+		int32		actualHeaderLen;
+		int32		blockLimitLen;
+		int32		overallBlockLen;
+		int32		contentOffset;
+		int32		uncompressedLen;
+		int			executorBlockKind;
+		bool		hasFirstRowNum;
+		int64		firstRowNum;
+		int			rowCount;
+		bool		isCompressed = false;
+		int32		compressedLen = 0;
+		AOHeaderCheckError checkError;
+		int			i;
+
+		header = BufferedReadPeek(&storageRead->bufferedRead, offset,
+								  storageRead->minimumHeaderLen);
+		if (header == NULL)
+			break;
+
+		for (i = 0; i < storageRead->minimumHeaderLen; i++)
+		{
+			if (header[i] != 0)
+				break;
+		}
+		if (i == storageRead->minimumHeaderLen)
+			break;
+
+		if (AppendOnlyStorageFormat_GetHeaderInfo(header,
+												  storageRead->storageAttributes.checksum,
+												  &headerKind,
+												  &actualHeaderLen) != AOHeaderCheckOk)
+			break;
+
+		header = BufferedReadPeek(&storageRead->bufferedRead, offset,
+								  actualHeaderLen);
+		if (header == NULL)
+			break;
+
+		blockLimitLen = (int32) Min((int64) storageRead->maxBufferLen,
+									storageRead->bufferedRead.fileLen - offset);
+
+		if (headerKind == AoHeaderKind_SmallContent)
+			checkError = AppendOnlyStorageFormat_GetSmallContentHeaderInfo
+				(header, actualHeaderLen,
+				 storageRead->storageAttributes.checksum, blockLimitLen,
+				 &overallBlockLen, &contentOffset, &uncompressedLen,
+				 &executorBlockKind, &hasFirstRowNum,
+				 storageRead->formatVersion, &firstRowNum, &rowCount,
+				 &isCompressed, &compressedLen);
+		else if (headerKind == AoHeaderKind_BulkDenseContent)
+			checkError = AppendOnlyStorageFormat_GetBulkDenseContentHeaderInfo
+				(header, actualHeaderLen,
+				 storageRead->storageAttributes.checksum, blockLimitLen,
+				 &overallBlockLen, &contentOffset, &uncompressedLen,
+				 &executorBlockKind, &hasFirstRowNum,
+				 storageRead->formatVersion, &firstRowNum, &rowCount,
+				 &isCompressed, &compressedLen);
+		else
+			break;
+
+		if (checkError != AOHeaderCheckOk)
+			break;
+
+		header = BufferedReadPeek(&storageRead->bufferedRead, offset,
+								  overallBlockLen);
+		if (header == NULL)
+			break;
+
+		if (isCompressed)
+		{
+			if (!AppendOnlyJobs_Submit(storageRead->decompressOwner,
+									   offset,
+									   AppendOnlyJob_Decompress,
+									   storageRead->decompressAlgorithm,
+									   0,
+									   &header[contentOffset],
+									   compressedLen,
+									   uncompressedLen))
+				break;
+			numPending++;
+		}
+
+		offset += overallBlockLen;
+	}
+
+	storageRead->decompressAheadOffset = offset;
+}
+
 /*
  * Get information on the next Append-Only Storage Block.
  *
@@ -1024,6 +1178,9 @@ AppendOnlyStorageRead_ReadNextBlock(AppendOnlyStorageRead *storageRead)
 		/* UNDONE: Finish the read for the information only header. */
 	}
 
+	if (storageRead->decompressAlgorithm != AppendOnlyCompression_None)
+		AppendOnlyStorageRead_DecompressAhead(storageRead);
+
 	SIMPLE_FAULT_INJECTOR("AppendOnlyStorageRead_ReadNextBlock_success");
 
 	return true;
@@ -1395,6 +1552,7 @@ AppendOnlyStorageRead_Content(AppendOnlyStorageRead *storageRead,
 			 */
 			PGFunction	decompressor;
 			PGFunction *cfns = storageRead->compression_functions;
+			int32		decompressedLen;
 
 			if (cfns == NULL)
 				ereport(ERROR,
@@ -1403,13 +1561,30 @@ AppendOnlyStorageRead_Content(AppendOnlyStorageRead *storageRead,
 
 			decompressor = cfns[COMPRESSION_DECOMPRESS];
 
-			gp_decompress(content,    /* Compressed data in block. */
-						  storageRead->current.compressedLen,
-						  contentOut,
-						  storageRead->current.uncompressedLen,
-						  decompressor,
-						  storageRead->compressionState,
-						  storageRead->bufferCount);
+			/*
+			 * Use the content decompressed ahead on the helper threads, if
+			 * any. Should that have failed, decompress here, to raise the
+			 * proper error.
+			 */
+			if (storageRead->decompressAlgorithm != AppendOnlyCompression_None &&
+				AppendOnlyJobs_Take(storageRead->decompressOwner,
+									storageRead->current.headerOffsetInFile,
+									contentOut,
+									storageRead->current.uncompressedLen,
+									&decompressedLen,
+									NULL) &&
+				decompressedLen == storageRead->current.uncompressedLen)
+			{
+				/* Already decompressed. */
+			}
+			else
+				gp_decompress(content,    /* Compressed data in block. */
+							  storageRead->current.compressedLen,
+							  contentOut,
+							  storageRead->current.uncompressedLen,
+							  decompressor,
+							  storageRead->compressionState,
+							  storageRead->bufferCount);
 
 			if (Debug_appendonly_print_scan)
 				elog(LOG,
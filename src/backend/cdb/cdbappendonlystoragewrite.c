@@ -35,6 +35,28 @@
 #include "utils/faultinjector.h"
 #include "utils/guc.h"
 
+/*
+ * A block handed to the compression threads, with what is needed to make
+ * its header once the compressed content is taken back.
+ */
+typedef struct AppendOnlyStoragePendingBlock
+{
+	int64		blockNo;
+	AoHeaderKind aoHeaderKind;
+	bool		isFirstRowNumSet;
+	int64		firstRowNum;
+	int			executorBlockKind;
+	int			itemCount;
+	int32		sourceLen;
+} AppendOnlyStoragePendingBlock;
+
+/*
+ * Largest write with pipelined compression. The compressed blocks come back
+ * in bursts, so they are written out in larger pieces.
+ */
+#define APPENDONLY_PIPELINE_LARGE_WRITE_LEN (1024 * 1024)
+
+static void AppendOnlyStorageWrite_PipelineDrain(AppendOnlyStorageWrite *storageWrite);
 
 /*----------------------------------------------------------------
  * Initialization
@@ -214,6 +236,17 @@ AppendOnlyStorageWrite_FinishSession(AppendOnlyStorageWrite *storageWrite)
 		storageWrite->verifyWriteBuffer = NULL;
 	}
 
+	if (storageWrite->pipelineAlgorithm != AppendOnlyCompression_None)
+	{
+		AppendOnlyJobs_Release(storageWrite->pipelineOwner, -1);
+		pfree(storageWrite->pipelineBlocks);
+		storageWrite->pipelineBlocks = NULL;
+		pfree(storageWrite->pipelineSourceBuffer);
+		storageWrite->pipelineSourceBuffer = NULL;
+		storageWrite->pipelineCount = 0;
+		storageWrite->pipelineAlgorithm = AppendOnlyCompression_None;
+	}
+
 	if (storageWrite->segmentFileName != NULL)
 	{
 		pfree(storageWrite->segmentFileName);
@@ -243,6 +276,96 @@ AppendOnlyStorageWrite_FinishSession(AppendOnlyStorageWrite *storageWrite)
 
 }
 
+/*
+ * Compress the blocks of this session on the compression threads (see
+ * cdbappendonlyjobs.h), while the caller goes on filling the next ones.
+ *
+ * Must be called before the first segment file is opened. Does nothing if
+ * gp_appendonly_compress_workers is 0, or the compression of the table
+ * cannot be done off the backend.
+ *
+ * The blocks are appended to the segment file some time after they are
+ * finished, so the caller must not rely on the logical start offset of a
+ * block, i.e. not maintain a block directory.
+ */
+void
+AppendOnlyStorageWrite_EnablePipeline(AppendOnlyStorageWrite *storageWrite)
+{
+	AppendOnlyCompressionAlgorithm algorithm;
+	int			numSlots;
+	uint8	   *memory;
+	int32		memoryLen;
+	MemoryContext oldMemoryContext;
+
+	Assert(storageWrite != NULL);
+	Assert(storageWrite->isActive);
+	Assert(storageWrite->file == -1);
+
+	if (!storageWrite->storageAttributes.compress ||
+		gp_appendonly_compress_workers <= 0 ||
+		gp_appendonly_verify_write_block ||
+		storageWrite->pipelineAlgorithm != AppendOnlyCompression_None)
+		return;
+
+	algorithm = AppendOnlyCompression_AlgorithmFor(storageWrite->storageAttributes.compressType);
+	if (algorithm == AppendOnlyCompression_None)
+		return;
+
+	numSlots = AppendOnlyJobs_NumSlots(AppendOnlyJob_Compress);
+	if (numSlots == 0)
+		return;
+
+	oldMemoryContext = MemoryContextSwitchTo(storageWrite->memoryContext);
+
+	storageWrite->pipelineAlgorithm = algorithm;
+	storageWrite->pipelineOwner = AppendOnlyJobs_NewOwner();
+
+	/* Leave some of the slots to the other writers, e.g. other columns. */
+	storageWrite->pipelineMaxBlocks =
+		Max(Min(2 * gp_appendonly_compress_workers, numSlots / 2), 1);
+	storageWrite->pipelineBlocks = (AppendOnlyStoragePendingBlock *)
+		palloc(storageWrite->pipelineMaxBlocks * sizeof(AppendOnlyStoragePendingBlock));
+	storageWrite->pipelineFirst = 0;
+	storageWrite->pipelineCount = 0;
+	storageWrite->pipelineNextBlockNo = 0;
+	storageWrite->pipelineSourceBuffer = (uint8 *) palloc(storageWrite->maxBufferLen);
+
+	/*
+	 * Redo the BufferedAppend with a larger write length, which also means
+	 * fewer WAL records.
+	 */
+	if (storageWrite->largeWriteLen < APPENDONLY_PIPELINE_LARGE_WRITE_LEN)
+	{
+		BufferedAppendFinish(&storageWrite->bufferedAppend);
+		pfree(storageWrite->bufferedAppend.memory);
+
+		storageWrite->largeWriteLen =
+			Min(storageWrite->pipelineMaxBlocks * storageWrite->maxBufferLen,
+				APPENDONLY_PIPELINE_LARGE_WRITE_LEN);
+		storageWrite->largeWriteLen =
+			Max(storageWrite->largeWriteLen, 2 * storageWrite->maxBufferLen);
+
+		memoryLen = BufferedAppendMemoryLen(storageWrite->maxBufferWithCompressionOverrrunLen,
+											storageWrite->largeWriteLen);
+		memory = (uint8 *) palloc(memoryLen);
+
+		BufferedAppendInit(&storageWrite->bufferedAppend,
+						   memory,
+						   memoryLen,
+						   storageWrite->maxBufferWithCompressionOverrrunLen,
+						   storageWrite->largeWriteLen,
+						   storageWrite->relationName);
+	}
+
+	MemoryContextSwitchTo(oldMemoryContext);
+
+	elogif(Debug_appendonly_print_insert, LOG,
+		   "Append-Only Storage Write pipelined compression for table '%s' (pending blocks %d, large write length %d)",
+		   storageWrite->relationName,
+		   storageWrite->pipelineMaxBlocks,
+		   storageWrite->largeWriteLen);
+}
+
 /*----------------------------------------------------------------
  * Open and FlushAndClose
  *----------------------------------------------------------------
@@ -481,6 +604,9 @@ AppendOnlyStorageWrite_FlushAndCloseFile(
 		return;
 	}
 
+	/* Append the blocks still being compressed. */
+	AppendOnlyStorageWrite_PipelineDrain(storageWrite);
+
 	/*
 	 * We pad out append commands to the page boundary.
 	 */
@@ -1130,6 +1256,16 @@ AppendOnlyStorageWrite_VerifyWriteBlock(AppendOnlyStorageWrite *storageWrite,
 #endif
 }
 
+static void AppendOnlyStorageWrite_MakeCompressedBlock(AppendOnlyStorageWrite *storageWrite,
+										   uint8 *header,
+										   uint8 *dataBuffer,
+										   uint8 *sourceData,
+										   int32 sourceLen,
+										   int executorBlockKind,
+										   int itemCount,
+										   int32 *compressedLen,
+										   int32 *bufferLen);
+
 static void
 AppendOnlyStorageWrite_CompressAppend(AppendOnlyStorageWrite *storageWrite,
 									  uint8 *sourceData,
@@ -1192,6 +1328,36 @@ AppendOnlyStorageWrite_CompressAppend(AppendOnlyStorageWrite *storageWrite,
 	}
 #endif
 
+	AppendOnlyStorageWrite_MakeCompressedBlock(storageWrite,
+											   header,
+											   dataBuffer,
+											   sourceData,
+											   sourceLen,
+											   executorBlockKind,
+											   itemCount,
+											   compressedLen,
+											   bufferLen);
+}
+
+/*
+ * Finish a block whose content has been compressed into dataBuffer, right
+ * after its header in the BufferedAppend buffer: store the content as is
+ * instead if it did not get any smaller, and make the header.
+ *
+ * *compressedLen is the compressed length on input, and 0 on output if
+ * the content is stored uncompressed.
+ */
+static void
+AppendOnlyStorageWrite_MakeCompressedBlock(AppendOnlyStorageWrite *storageWrite,
+										   uint8 *header,
+										   uint8 *dataBuffer,
+										   uint8 *sourceData,
+										   int32 sourceLen,
+										   int executorBlockKind,
+										   int itemCount,
+										   int32 *compressedLen,
+										   int32 *bufferLen)
+{
 	/*
 	 * We always store the data compressed if the compressed length is less
 	 * than the uncompressed length.
@@ -1281,6 +1447,170 @@ AppendOnlyStorageWrite_CompressAppend(AppendOnlyStorageWrite *storageWrite,
 	*bufferLen = storageWrite->currentCompleteHeaderLen + dataRoundedUpLen;
 }
 
+/*
+ * Append the oldest block handed to the compression threads.
+ */
+static void
+AppendOnlyStorageWrite_PipelineTakeOne(AppendOnlyStorageWrite *storageWrite)
+{
+	AppendOnlyStoragePendingBlock *pending;
+	bool		saveIsFirstRowNumSet;
+	int64		saveFirstRowNum;
+	int			saveAoHeaderKind;
+	int32		saveCompleteHeaderLen;
+	int32		headerLen;
+	uint8	   *header;
+	uint8	   *dataBuffer;
+	int32		compressedLen;
+	int32		bufferLen;
+
+	Assert(storageWrite->pipelineCount > 0);
+
+	pending = &storageWrite->pipelineBlocks[storageWrite->pipelineFirst];
+
+	/* Make the header as it would have been when the block was finished. */
+	saveIsFirstRowNumSet = storageWrite->isFirstRowNumSet;
+	saveFirstRowNum = storageWrite->firstRowNum;
+	saveAoHeaderKind = storageWrite->getBufferAoHeaderKind;
+	saveCompleteHeaderLen = storageWrite->currentCompleteHeaderLen;
+
+	storageWrite->isFirstRowNumSet = pending->isFirstRowNumSet;
+	storageWrite->firstRowNum = pending->firstRowNum;
+	storageWrite->getBufferAoHeaderKind = pending->aoHeaderKind;
+	headerLen = AppendOnlyStorageWrite_CompleteHeaderLen(storageWrite,
+														 pending->aoHeaderKind);
+	storageWrite->currentCompleteHeaderLen = headerLen;
+
+	header = BufferedAppendGetMaxBuffer(&storageWrite->bufferedAppend);
+	if (header == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_INTERNAL_ERROR),
+				 errmsg("We do not expect files to be have a maximum length"),
+				 errcontext_appendonly_write_storage_block(storageWrite)));
+	dataBuffer = &header[headerLen];
+
+	if (!AppendOnlyJobs_Take(storageWrite->pipelineOwner,
+							 pending->blockNo,
+							 dataBuffer,
+							 storageWrite->maxBufferWithCompressionOverrrunLen - headerLen,
+							 &compressedLen,
+							 storageWrite->pipelineSourceBuffer))
+		elog(ERROR, "append-only block " INT64_FORMAT " was not submitted for compression",
+			 pending->blockNo);
+	if (compressedLen < 0)
+	{
+		/* Did not get any smaller, store the content we got back as is. */
+		compressedLen = pending->sourceLen;
+	}
+
+	AppendOnlyStorageWrite_MakeCompressedBlock(storageWrite,
+											   header,
+											   dataBuffer,
+											   storageWrite->pipelineSourceBuffer,
+											   pending->sourceLen,
+											   pending->executorBlockKind,
+											   pending->itemCount,
+											   &compressedLen,
+											   &bufferLen);
+
+	BufferedAppendFinishBuffer(&storageWrite->bufferedAppend,
+							   bufferLen,
+							   (headerLen +
+								AOStorage_RoundUp(pending->sourceLen, storageWrite->formatVersion) /* non-compressed size */ ),
+							   storageWrite->needsWAL);
+
+	storageWrite->pipelineFirst =
+		(storageWrite->pipelineFirst + 1) % storageWrite->pipelineMaxBlocks;
+	storageWrite->pipelineCount--;
+
+	storageWrite->isFirstRowNumSet = saveIsFirstRowNumSet;
+	storageWrite->firstRowNum = saveFirstRowNum;
+	storageWrite->getBufferAoHeaderKind = saveAoHeaderKind;
+	storageWrite->currentCompleteHeaderLen = saveCompleteHeaderLen;
+}
+
+/*
+ * Append all the blocks handed to the compression threads.
+ */
+static void
+AppendOnlyStorageWrite_PipelineDrain(AppendOnlyStorageWrite *storageWrite)
+{
+	while (storageWrite->pipelineCount > 0)
+		AppendOnlyStorageWrite_PipelineTakeOne(storageWrite);
+}
+
+/*
+ * Hand a finished block to the compression threads, with the header kind
+ * and first row number currently set.
+ *
+ * Returns false if pipelined compression is not enabled, or the threads
+ * are busy with the blocks of other writers. Nothing is pending then, and
+ * the caller compresses and appends the block itself.
+ */
+static bool
+AppendOnlyStorageWrite_PipelineSubmit(AppendOnlyStorageWrite *storageWrite,
+									  uint8 *sourceData,
+									  int32 sourceLen,
+									  int executorBlockKind,
+									  int itemCount)
+{
+	AppendOnlyStoragePendingBlock *pending;
+	int32		headerLen;
+	int			level;
+	bool		submitted;
+
+	if (storageWrite->pipelineAlgorithm == AppendOnlyCompression_None)
+		return false;
+
+	if (storageWrite->pipelineCount == storageWrite->pipelineMaxBlocks)
+		AppendOnlyStorageWrite_PipelineTakeOne(storageWrite);
+
+	headerLen = AppendOnlyStorageWrite_CompleteHeaderLen(storageWrite,
+														 storageWrite->getBufferAoHeaderKind);
+	level = Max(storageWrite->storageAttributes.compressLevel, 1);
+
+	while (true)
+	{
+		submitted = AppendOnlyJobs_Submit(storageWrite->pipelineOwner,
+										  storageWrite->pipelineNextBlockNo,
+										  AppendOnlyJob_Compress,
+										  storageWrite->pipelineAlgorithm,
+										  level,
+										  sourceData,
+										  sourceLen,
+										  storageWrite->maxBufferWithCompressionOverrrunLen - headerLen);
+		if (submitted || storageWrite->pipelineCount == 0)
+			break;
+
+		/* Free one of our own slots and try again. */
+		AppendOnlyStorageWrite_PipelineTakeOne(storageWrite);
+	}
+
+	if (!submitted)
+		return false;
+
+	pending = &storageWrite->pipelineBlocks[(storageWrite->pipelineFirst + storageWrite->pipelineCount) %
+											storageWrite->pipelineMaxBlocks];
+	pending->blockNo = storageWrite->pipelineNextBlockNo++;
+	pending->aoHeaderKind = storageWrite->getBufferAoHeaderKind;
+	pending->isFirstRowNumSet = storageWrite->isFirstRowNumSet;
+	pending->firstRowNum = storageWrite->firstRowNum;
+	pending->executorBlockKind = executorBlockKind;
+	pending->itemCount = itemCount;
+	pending->sourceLen = sourceLen;
+	storageWrite->pipelineCount++;
+
+	elogif(Debug_appendonly_print_insert, LOG,
+		   "Append-only insert handed block for table '%s' to compression "
+		   "(source length = %d, item count %d, pending blocks %d)",
+		   storageWrite->relationName,
+		   sourceLen,
+		   itemCount,
+		   storageWrite->pipelineCount);
+
+	return true;
+}
+
 /*
  * Mark the current buffer "small" buffer as finished.
  *
@@ -1426,6 +1756,15 @@ AppendOnlyStorageWrite_FinishBuffer(AppendOnlyStorageWrite *storageWrite,
 			   storageWrite->bufferCount);
 
 	}
+	else if (AppendOnlyStorageWrite_PipelineSubmit(storageWrite,
+												   storageWrite->uncompressedBuffer,
+												   contentLen,
+												   executorBlockKind,
+												   rowCount))
+	{
+		/* Declare it finished, it is appended once compressed. */
+		storageWrite->currentCompleteHeaderLen = 0;
+	}
 	else
 	{
 		int32		compressedLen = 0;
@@ -1577,42 +1916,54 @@ AppendOnlyStorageWrite_Content(AppendOnlyStorageWrite *storageWrite,
 			 * "fragments
 			 */
 			storageWrite->getBufferAoHeaderKind = AoHeaderKind_SmallContent;
-			AppendOnlyStorageWrite_CompressAppend(storageWrite,
-												  content,
-												  contentLen,
-												  executorBlockKind,
-												  rowCount,
-												  &compressedLen,
-												  &bufferLen);
+			if (AppendOnlyStorageWrite_PipelineSubmit(storageWrite,
+													  content,
+													  contentLen,
+													  executorBlockKind,
+													  rowCount))
+			{
+				/* Appended once compressed. */
+				storageWrite->currentCompleteHeaderLen = 0;
+			}
+			else
+			{
+				AppendOnlyStorageWrite_CompressAppend(storageWrite,
+													  content,
+													  contentLen,
+													  executorBlockKind,
+													  rowCount,
+													  &compressedLen,
+													  &bufferLen);
 
-			/*
-			 * Just before finishing the AO Storage buffer with our
-			 * non-compressed content, let's verify it.
-			 */
-			if (gp_appendonly_verify_write_block)
-				AppendOnlyStorageWrite_VerifyWriteBlock(storageWrite,
-														BufferedAppendCurrentBufferPosition(&storageWrite->bufferedAppend),
-														bufferLen,
-														content,
-														contentLen,
-														executorBlockKind,
-														rowCount,
-														compressedLen);
+				/*
+				 * Just before finishing the AO Storage buffer with our
+				 * non-compressed content, let's verify it.
+				 */
+				if (gp_appendonly_verify_write_block)
+					AppendOnlyStorageWrite_VerifyWriteBlock(storageWrite,
+															BufferedAppendCurrentBufferPosition(&storageWrite->bufferedAppend),
+															bufferLen,
+															content,
+															contentLen,
+															executorBlockKind,
+															rowCount,
+															compressedLen);
 
-			storageWrite->logicalBlockStartOffset =
-				BufferedAppendNextBufferPosition(&(storageWrite->bufferedAppend));
+				storageWrite->logicalBlockStartOffset =
+					BufferedAppendNextBufferPosition(&(storageWrite->bufferedAppend));
 
-			/*
-			 * Finish the current buffer by specifying the used length.
-			 */
-			BufferedAppendFinishBuffer(&storageWrite->bufferedAppend,
-									   bufferLen,
-									   (storageWrite->currentCompleteHeaderLen +
-									       AOStorage_RoundUp(contentLen, storageWrite->formatVersion) /* non-compressed size */ ),
-									   storageWrite->needsWAL);
-
-			/* Declare it finished. */
-			storageWrite->currentCompleteHeaderLen = 0;
+				/*
+				 * Finish the current buffer by specifying the used length.
+				 */
+				BufferedAppendFinishBuffer(&storageWrite->bufferedAppend,
+										   bufferLen,
+										   (storageWrite->currentCompleteHeaderLen +
+										       AOStorage_RoundUp(contentLen, storageWrite->formatVersion) /* non-compressed size */ ),
+										   storageWrite->needsWAL);
+
+				/* Declare it finished. */
+				storageWrite->currentCompleteHeaderLen = 0;
+			}
 		}
 	}
 	else
@@ -1628,6 +1979,7 @@ AppendOnlyStorageWrite_Content(AppendOnlyStorageWrite *storageWrite,
 		/*
 		 * Write the "Large" content in fragments.
 		 */
+		AppendOnlyStorageWrite_PipelineDrain(storageWrite);
 
 		storageWrite->logicalBlockStartOffset =
 			BufferedAppendNextBufferPosition(&(storageWrite->bufferedAppend));
@@ -1699,39 +2051,51 @@ AppendOnlyStorageWrite_Content(AppendOnlyStorageWrite *storageWrite,
 				 */
 				storageWrite->getBufferAoHeaderKind = AoHeaderKind_SmallContent;
 
-				AppendOnlyStorageWrite_CompressAppend(storageWrite,
-													  contentNext,
-													  smallContentLen,
-													  executorBlockKind,
-													   /* rowCount */ 0,
-													  &compressedLen,
-													  &bufferLen);
-
-				/*
-				 * Just before finishing the AO Storage buffer with our
-				 * non-compressed content, let's verify it.
-				 */
-				if (gp_appendonly_verify_write_block)
-					AppendOnlyStorageWrite_VerifyWriteBlock(storageWrite,
-															BufferedAppendCurrentBufferPosition(&storageWrite->bufferedAppend),
-															bufferLen,
-															contentNext,
-															smallContentLen,
-															executorBlockKind,
-															 /* rowCount */ 0,
-															compressedLen);
-
-				/*
-				 * Finish the current buffer by specifying the used length.
-				 */
-				BufferedAppendFinishBuffer(&storageWrite->bufferedAppend,
-										   bufferLen,
-										   (smallContentHeaderLen +
-										   AOStorage_RoundUp(smallContentLen, storageWrite->formatVersion) /* non-compressed size */ ),
-										   storageWrite->needsWAL);
-
-				/* Declare it finished. */
-				storageWrite->currentCompleteHeaderLen = 0;
+				if (AppendOnlyStorageWrite_PipelineSubmit(storageWrite,
+														  contentNext,
+														  smallContentLen,
+														  executorBlockKind,
+														   /* rowCount */ 0))
+				{
+					/* Appended once compressed. */
+					storageWrite->currentCompleteHeaderLen = 0;
+				}
+				else
+				{
+					AppendOnlyStorageWrite_CompressAppend(storageWrite,
+														  contentNext,
+														  smallContentLen,
+														  executorBlockKind,
+														   /* rowCount */ 0,
+														  &compressedLen,
+														  &bufferLen);
+
+					/*
+					 * Just before finishing the AO Storage buffer with our
+					 * non-compressed content, let's verify it.
+					 */
+					if (gp_appendonly_verify_write_block)
+						AppendOnlyStorageWrite_VerifyWriteBlock(storageWrite,
+																BufferedAppendCurrentBufferPosition(&storageWrite->bufferedAppend),
+																bufferLen,
+																contentNext,
+																smallContentLen,
+																executorBlockKind,
+																 /* rowCount */ 0,
+																compressedLen);
+
+					/*
+					 * Finish the current buffer by specifying the used length.
+					 */
+					BufferedAppendFinishBuffer(&storageWrite->bufferedAppend,
+											   bufferLen,
+											   (smallContentHeaderLen +
+											   AOStorage_RoundUp(smallContentLen, storageWrite->formatVersion) /* non-compressed size */ ),
+											   storageWrite->needsWAL);
+
+					/* Declare it finished. */
+					storageWrite->currentCompleteHeaderLen = 0;
+				}
 			}
 
 			countdownContentLen -= smallContentLen;
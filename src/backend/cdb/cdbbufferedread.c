@@ -21,7 +21,11 @@
 #include "miscadmin.h"
 
 static void BufferedReadIo(
-			   BufferedRead *bufferedRead);
+			   BufferedRead *bufferedRead,
+			   int64 inEffectFileLen);
+static void BufferedReadPrefetch(
+			   BufferedRead *bufferedRead,
+			   int64 inEffectFileLen);
 static uint8 *BufferedReadUseBeforeBuffer(
 							BufferedRead *bufferedRead,
 							int32 maxReadAheadLen,
@@ -88,6 +92,7 @@ BufferedReadInit(
 
 	bufferedRead->largeReadPosition = 0;
 	bufferedRead->largeReadLen = 0;
+	bufferedRead->prefetchPosition = 0;
 
 	/*
 	 * Buffer level members.
@@ -138,6 +143,7 @@ BufferedReadSetFile(
 
 	bufferedRead->haveTemporaryLimitInEffect = false;
 	bufferedRead->temporaryLimitFileLen = 0;
+	bufferedRead->prefetchPosition = 0;
 
 	if (fileLen > 0)
 	{
@@ -148,16 +154,58 @@ BufferedReadSetFile(
 			bufferedRead->largeReadLen = bufferedRead->maxLargeReadLen;
 		else
 			bufferedRead->largeReadLen = (int32) fileLen;
-		BufferedReadIo(bufferedRead);
+		BufferedReadIo(bufferedRead, fileLen);
 	}
 }
 
 /*
- * Perform a large read i/o.
+ * Ask the kernel to read ahead the next gp_appendonly_prefetch_depth large
+ * reads after the current one, up to inEffectFileLen, so that they are in
+ * the page cache by the time we get to them.
+ *
+ * The window slides by one large read per call, so the caller processes
+ * the blocks of read N while reads N+1 .. N+depth are in flight.  For a
+ * column-oriented table, each column has its own BufferedRead and thus
+ * its own window.
+ */
+static void
+BufferedReadPrefetch(
+					 BufferedRead *bufferedRead,
+					 int64 inEffectFileLen)
+{
+	int64		readAfterPos;
+	int64		prefetchAfterPos;
+
+	if (gp_appendonly_prefetch_depth <= 0)
+		return;
+
+	readAfterPos = bufferedRead->largeReadPosition + bufferedRead->largeReadLen;
+	if (bufferedRead->prefetchPosition < readAfterPos)
+		bufferedRead->prefetchPosition = readAfterPos;
+
+	prefetchAfterPos = readAfterPos +
+		(int64) gp_appendonly_prefetch_depth * bufferedRead->maxLargeReadLen;
+	if (prefetchAfterPos > inEffectFileLen)
+		prefetchAfterPos = inEffectFileLen;
+
+	if (prefetchAfterPos <= bufferedRead->prefetchPosition)
+		return;
+
+	/* It is only a hint, so don't complain if it fails. */
+	(void) FilePrefetch(bufferedRead->file,
+						bufferedRead->prefetchPosition,
+						(int) (prefetchAfterPos - bufferedRead->prefetchPosition));
+
+	bufferedRead->prefetchPosition = prefetchAfterPos;
+}
+
+/*
+ * Perform a large read i/o, and prefetch the ones that follow it.
  */
 static void
 BufferedReadIo(
-			   BufferedRead *bufferedRead)
+			   BufferedRead *bufferedRead,
+			   int64 inEffectFileLen)
 {
 	int32		largeReadLen;
 	uint8	   *largeReadMemory;
@@ -237,6 +285,8 @@ BufferedReadIo(
 		offset += actualLen;
 	}
 
+	BufferedReadPrefetch(bufferedRead, inEffectFileLen);
+
 	if (VacuumCostActive)
 		VacuumCostBalance += VacuumCostPageMiss;
 }
@@ -320,7 +370,7 @@ BufferedReadUseBeforeBuffer(
 							   remainingFileLen, inEffectFileLen, nextPosition)));
 	}
 
-	BufferedReadIo(bufferedRead);
+	BufferedReadIo(bufferedRead, inEffectFileLen);
 
 	extraLen = maxReadAheadLen - beforeLen;
 	Assert(extraLen > 0);
@@ -440,8 +490,11 @@ BufferedReadSetTemporaryRange(
 
 		bufferedRead->largeReadPosition = beginFileOffset;
 
+		/* Whatever we prefetched was for another part of the file. */
+		bufferedRead->prefetchPosition = 0;
+
 		if (bufferedRead->largeReadLen > 0)
-			BufferedReadIo(bufferedRead);
+			BufferedReadIo(bufferedRead, afterFileOffset);
 	}
 
 	bufferedRead->haveTemporaryLimitInEffect = true;
@@ -544,7 +597,7 @@ BufferedReadGetNextBuffer(
 			return NULL;
 		}
 
-		BufferedReadIo(bufferedRead);
+		BufferedReadIo(bufferedRead, inEffectFileLen);
 
 		if (maxReadAheadLen > bufferedRead->largeReadLen)
 			bufferedRead->bufferLen = bufferedRead->largeReadLen;
@@ -581,6 +634,37 @@ BufferedReadGetNextBuffer(
 	return &bufferedRead->largeReadMemory[bufferedRead->bufferOffset];
 }
 
+/*
+ * Return the address of len bytes of the file at position, if they are
+ * already in memory from the current large read. Otherwise, NULL.
+ */
+uint8 *
+BufferedReadPeek(
+				 BufferedRead *bufferedRead,
+				 int64 position,
+				 int32 len)
+{
+	int64		inEffectFileLen;
+
+	Assert(bufferedRead != NULL);
+	Assert(len > 0);
+
+	if (bufferedRead->file < 0)
+		return NULL;
+
+	if (bufferedRead->haveTemporaryLimitInEffect)
+		inEffectFileLen = bufferedRead->temporaryLimitFileLen;
+	else
+		inEffectFileLen = bufferedRead->fileLen;
+
+	if (position < bufferedRead->largeReadPosition ||
+		position + len > bufferedRead->largeReadPosition + bufferedRead->largeReadLen ||
+		position + len > inEffectFileLen)
+		return NULL;
+
+	return &bufferedRead->largeReadMemory[position - bufferedRead->largeReadPosition];
+}
+
 /*
  * Grow the available length of the current buffer.
  *
@@ -675,6 +759,7 @@ BufferedReadCompleteFile(
 
 	bufferedRead->largeReadPosition = 0;
 	bufferedRead->largeReadLen = 0;
+	bufferedRead->prefetchPosition = 0;
 }
 
 
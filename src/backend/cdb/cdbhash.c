@@ -51,6 +51,11 @@ bool gp_use_legacy_hashops = false;
 /* local function declarations */
 static int	ispowof2(int numsegs);
 static inline int32 jump_consistent_hash(uint64 key, int32 num_segments);
+static CdbHashKernel cdbhash_kernel_for_func(Oid funcid);
+static inline uint32 cdbhash_int8(Datum datum);
+static inline uint32 cdbhash_text(Datum datum);
+static inline uint32 cdbhash_datum(CdbHash *h, int attno, Datum datum);
+static inline unsigned int cdbhash_reduce_value(CdbHash *h, uint32 hash);
 
 /*================================================================
  *
@@ -97,6 +102,7 @@ makeCdbHash(int numsegs, int natts, Oid *hashfuncs)
 
 	/* Load hash function info */
 	h->hashfuncs = (FmgrInfo *) palloc(natts * sizeof(FmgrInfo));
+	h->kernels = (CdbHashKernel *) palloc(natts * sizeof(CdbHashKernel));
 	for (i = 0; i < natts; i++)
 	{
 		Oid			funcid = hashfuncs[i];
@@ -105,6 +111,7 @@ makeCdbHash(int numsegs, int natts, Oid *hashfuncs)
 			is_legacy_hash = true;
 
 		fmgr_info(funcid, &h->hashfuncs[i]);
+		h->kernels[i] = cdbhash_kernel_for_func(funcid);
 	}
 	h->natts = natts;
 	h->is_legacy_hash = is_legacy_hash;
@@ -162,6 +169,8 @@ void freeCdbHash(CdbHash *hash)
 	{
 		if (hash->hashfuncs)
 			pfree(hash->hashfuncs);
+		if (hash->kernels)
+			pfree(hash->kernels);
 		pfree(hash);
 	}
 }
@@ -198,54 +207,118 @@ cdbhash(CdbHash *h, int attno, Datum datum, bool isnull)
 		hashkey = (hashkey << 1) | ((hashkey & 0x80000000) ? 1 : 0);
 
 		if (!isnull)
-		{
-			FunctionCallInfoData fcinfo;
-			uint32		hkey;
-
-			InitFunctionCallInfoData(fcinfo, &h->hashfuncs[attno - 1], 1,
-									 InvalidOid,
-									 NULL, NULL);
-
-			fcinfo.arg[0] = datum;
-			fcinfo.argnull[0] = false;
+			hashkey ^= cdbhash_datum(h, attno, datum);
+	}
+	else
+	{
+		magic_hash_stash = hashkey;
+		if (!isnull)
+			hashkey = cdbhash_datum(h, attno, datum);
+		else
+			hashkey = cdblegacyhash_null();
+		magic_hash_stash = FNV1_32_INIT;
+	}
+	h->hash = hashkey;
+}
 
-			hkey = DatumGetUInt32(FunctionCallInvoke(&fcinfo));
+/*
+ * Hash a batch of rows, without reducing them to segment numbers.
+ *
+ * values and isnull hold h->natts arrays of nrows entries, the values of
+ * attribute 'attno' for row 'i' are at [(attno - 1) * nrows + i]. hashes[i]
+ * gets the same value as h->hash after calling cdbhashinit() and cdbhash()
+ * for every attribute of row 'i', but the hash functions of the common types
+ * are evaluated column by column in tight loops, without fmgr calls.
+ */
+void
+cdbhashbatchraw(CdbHash *h, int nrows, Datum *values, bool *isnull,
+				uint32 *hashes)
+{
+	int			attno;
+	int			i;
 
-			/* Check for null result, since caller is clearly not expecting one */
-			if (fcinfo.isnull)
-				elog(ERROR, "function %u returned NULL", fcinfo.flinfo->fn_oid);
+	Assert(h->natts > 0);
 
-			hashkey ^= hkey;
+	if (h->is_legacy_hash)
+	{
+		/* legacy hashes chain through magic_hash_stash, do them row by row */
+		for (i = 0; i < nrows; i++)
+		{
+			cdbhashinit(h);
+			for (attno = 1; attno <= h->natts; attno++)
+				cdbhash(h, attno, values[(attno - 1) * nrows + i],
+						isnull[(attno - 1) * nrows + i]);
+			hashes[i] = h->hash;
 		}
 	}
 	else
 	{
-		magic_hash_stash = hashkey;
-		if (!isnull)
-		{
-			FunctionCallInfoData fcinfo;
-			uint32		hkey;
+		memset(hashes, 0, nrows * sizeof(uint32));
 
-			InitFunctionCallInfoData(fcinfo, &h->hashfuncs[attno - 1], 1,
-									 InvalidOid,
-									 NULL, NULL);
+		for (attno = 1; attno <= h->natts; attno++)
+		{
+			Datum	   *colvalues = &values[(attno - 1) * nrows];
+			bool	   *colnulls = &isnull[(attno - 1) * nrows];
+
+			/* rotate hashkey left 1 bit at each step */
+			for (i = 0; i < nrows; i++)
+				hashes[i] = (hashes[i] << 1) | ((hashes[i] & 0x80000000) ? 1 : 0);
+
+			switch (h->kernels[attno - 1])
+			{
+				case CDBHASH_KERNEL_INT2:
+					for (i = 0; i < nrows; i++)
+						if (!colnulls[i])
+							hashes[i] ^= DatumGetUInt32(hash_uint32((int32) DatumGetInt16(colvalues[i])));
+					break;
+
+				case CDBHASH_KERNEL_INT4:
+					for (i = 0; i < nrows; i++)
+						if (!colnulls[i])
+							hashes[i] ^= DatumGetUInt32(hash_uint32(DatumGetInt32(colvalues[i])));
+					break;
+
+				case CDBHASH_KERNEL_INT8:
+					for (i = 0; i < nrows; i++)
+						if (!colnulls[i])
+							hashes[i] ^= cdbhash_int8(colvalues[i]);
+					break;
+
+				case CDBHASH_KERNEL_TEXT:
+					for (i = 0; i < nrows; i++)
+						if (!colnulls[i])
+							hashes[i] ^= cdbhash_text(colvalues[i]);
+					break;
+
+				default:
+					for (i = 0; i < nrows; i++)
+						if (!colnulls[i])
+							hashes[i] ^= cdbhash_datum(h, attno, colvalues[i]);
+					break;
+			}
+		}
+	}
+}
 
-			fcinfo.arg[0] = datum;
-			fcinfo.argnull[0] = false;
+/*
+ * Hash a batch of rows and reduce each of them to a segment number.
+ *
+ * Same as cdbhashbatchraw() followed by cdbhashreduceraw() for each row.
+ */
+void
+cdbhashbatch(CdbHash *h, int nrows, Datum *values, bool *isnull,
+			 unsigned int *targets)
+{
+	uint32	   *hashes = (uint32 *) targets;
+	int			i;
 
-			hkey = DatumGetUInt32(FunctionCallInvoke(&fcinfo));
+	StaticAssertStmt(sizeof(unsigned int) == sizeof(uint32),
+					 "targets array is reused for the hash values");
 
-			/* Check for null result, since caller is clearly not expecting one */
-			if (fcinfo.isnull)
-				elog(ERROR, "function %u returned NULL", fcinfo.flinfo->fn_oid);
+	cdbhashbatchraw(h, nrows, values, isnull, hashes);
 
-			hashkey = hkey;
-		}
-		else
-			hashkey = cdblegacyhash_null();
-		magic_hash_stash = FNV1_32_INIT;
-	}
-	h->hash = hashkey;
+	for (i = 0; i < nrows; i++)
+		targets[i] = cdbhash_reduce_value(h, hashes[i]);
 }
 
 /*
@@ -254,36 +327,21 @@ cdbhash(CdbHash *h, int attno, Datum datum, bool isnull)
 unsigned int
 cdbhashreduce(CdbHash *h)
 {
-	int			result = 0;		/* TODO: what is a good initialization value?
-								 * could we guarantee at this point that there
-								 * will not be a negative segid in Greengage
-								 * Database and therefore initialize to this
-								 * value for error checking? */
-
-	Assert(h->reducealg == REDUCE_BITMASK ||
-		   h->reducealg == REDUCE_LAZYMOD ||
-		   h->reducealg == REDUCE_JUMP_HASH);
 	Assert(h->natts > 0);
 
-	/*
-	 * Reduce our 32-bit hash value to a segment number
-	 */
-	switch (h->reducealg)
-	{
-		case REDUCE_BITMASK:
-			result = FASTMOD(h->hash, (uint32) h->numsegs); /* fast mod (bitmask) */
-			break;
-
-		case REDUCE_LAZYMOD:
-			result = (h->hash) % (h->numsegs);	/* simple mod */
-			break;
+	return cdbhash_reduce_value(h, h->hash);
+}
 
-		case REDUCE_JUMP_HASH:
-			result = jump_consistent_hash(h->hash, h->numsegs);
-			break;
-	}
+/*
+ * Reduce a hash value computed earlier, e.g. by cdbhashbatchraw(), to a
+ * segment number.
+ */
+unsigned int
+cdbhashreduceraw(CdbHash *h, uint32 hash)
+{
+	Assert(h->natts > 0);
 
-	return result;
+	return cdbhash_reduce_value(h, hash);
 }
 
 /*
@@ -530,6 +588,145 @@ cdb_eqop_in_hash_opfamily(Oid opfamily, Oid typeoid)
  *================================================================
  */
 
+/*
+ * Pick the inline kernel that computes the same value as the given hash
+ * function, if there is one.
+ */
+static CdbHashKernel
+cdbhash_kernel_for_func(Oid funcid)
+{
+	switch (funcid)
+	{
+		case F_HASHINT2:
+			return CDBHASH_KERNEL_INT2;
+		case F_HASHINT4:
+			return CDBHASH_KERNEL_INT4;
+		case F_HASHINT8:
+			return CDBHASH_KERNEL_INT8;
+#ifdef HAVE_INT64_TIMESTAMP
+		case F_TIMESTAMP_HASH:
+			return CDBHASH_KERNEL_INT8;
+#endif
+		case F_HASHTEXT:
+		case F_HASHVARLENA:
+			return CDBHASH_KERNEL_TEXT;
+		default:
+			return CDBHASH_KERNEL_FMGR;
+	}
+}
+
+/* same as hashint8() */
+static inline uint32
+cdbhash_int8(Datum datum)
+{
+	int64		val = DatumGetInt64(datum);
+	uint32		lohalf = (uint32) val;
+	uint32		hihalf = (uint32) (val >> 32);
+
+	lohalf ^= (val >= 0) ? hihalf : ~hihalf;
+
+	return DatumGetUInt32(hash_uint32(lohalf));
+}
+
+/* same as hashtext() */
+static inline uint32
+cdbhash_text(Datum datum)
+{
+	struct varlena *key = PG_DETOAST_DATUM_PACKED(datum);
+	uint32		result;
+
+	result = DatumGetUInt32(hash_any((unsigned char *) VARDATA_ANY(key),
+									 VARSIZE_ANY_EXHDR(key)));
+
+	/* Avoid leaking memory for toasted inputs */
+	if ((Pointer) key != DatumGetPointer(datum))
+		pfree(key);
+
+	return result;
+}
+
+/*
+ * Compute the hash function of one non-null attribute value.
+ *
+ * The inline kernels must return exactly what the corresponding functions in
+ * hashfunc.c return, or data would be sent to the wrong segment.
+ */
+static inline uint32
+cdbhash_datum(CdbHash *h, int attno, Datum datum)
+{
+	switch (h->kernels[attno - 1])
+	{
+		case CDBHASH_KERNEL_INT2:
+			return DatumGetUInt32(hash_uint32((int32) DatumGetInt16(datum)));
+
+		case CDBHASH_KERNEL_INT4:
+			return DatumGetUInt32(hash_uint32(DatumGetInt32(datum)));
+
+		case CDBHASH_KERNEL_INT8:
+			return cdbhash_int8(datum);
+
+		case CDBHASH_KERNEL_TEXT:
+			return cdbhash_text(datum);
+
+		case CDBHASH_KERNEL_FMGR:
+			break;
+	}
+
+	{
+		FunctionCallInfoData fcinfo;
+		uint32		hkey;
+
+		InitFunctionCallInfoData(fcinfo, &h->hashfuncs[attno - 1], 1,
+								 InvalidOid,
+								 NULL, NULL);
+
+		fcinfo.arg[0] = datum;
+		fcinfo.argnull[0] = false;
+
+		hkey = DatumGetUInt32(FunctionCallInvoke(&fcinfo));
+
+		/* Check for null result, since caller is clearly not expecting one */
+		if (fcinfo.isnull)
+			elog(ERROR, "function %u returned NULL", fcinfo.flinfo->fn_oid);
+
+		return hkey;
+	}
+}
+
+/*
+ * Reduce a 32-bit hash value to a segment number.
+ */
+static inline unsigned int
+cdbhash_reduce_value(CdbHash *h, uint32 hash)
+{
+	int			result = 0;		/* TODO: what is a good initialization value?
+								 * could we guarantee at this point that there
+								 * will not be a negative segid in Greengage
+								 * Database and therefore initialize to this
+								 * value for error checking? */
+
+	Assert(h->reducealg == REDUCE_BITMASK ||
+		   h->reducealg == REDUCE_LAZYMOD ||
+		   h->reducealg == REDUCE_JUMP_HASH);
+
+	switch (h->reducealg)
+	{
+		case REDUCE_BITMASK:
+			result = FASTMOD(hash, (uint32) h->numsegs); /* fast mod (bitmask) */
+			break;
+
+		case REDUCE_LAZYMOD:
+			result = hash % (h->numsegs);	/* simple mod */
+			break;
+
+		case REDUCE_JUMP_HASH:
+			result = jump_consistent_hash(hash, h->numsegs);
+			break;
+	}
+
+	return result;
+}
+
 /*
  * returns 1 is the input int is a power of 2 and 0 otherwise.
  */
@@ -18,8 +18,10 @@
 #include "catalog/pg_amop.h"
 #include "catalog/pg_opclass.h"
 #include "catalog/pg_operator.h"
+#include "catalog/pg_statistic.h"
 #include "nodes/makefuncs.h"	/* makeFuncExpr() */
 #include "nodes/relation.h"		/* PlannerInfo, RelOptInfo */
+#include "optimizer/clauses.h"	/* make_opclause() */
 #include "optimizer/cost.h"		/* cpu_tuple_cost */
 #include "optimizer/pathnode.h" /* Path, pathnode_walker() */
 #include "optimizer/paths.h"
@@ -29,7 +31,9 @@
 #include "parser/parse_oper.h"
 
 #include "utils/catcache.h"
+#include "utils/datum.h"
 #include "utils/lsyscache.h"
+#include "utils/selfuncs.h"
 #include "utils/syscache.h"
 
 #include "cdb/cdbdef.h"			/* CdbSwap() */
@@ -918,6 +922,245 @@ typedef struct
 	bool		has_wts;		/* Does the rel have WorkTableScan? */
 } CdbpathMfjRel;
 
+/* At most this many hot key values are split per join input */
+#define MOTION_SKEW_MAX_KEYS	16
+
+/*
+ * cdbpath_skew_key_expr
+ *
+ * Returns the expression of 'rel' that the distribution key stands for, or
+ * NULL if there is none.
+ */
+static Expr *
+cdbpath_skew_key_expr(CdbpathMfjRel *rel, DistributionKey *distkey)
+{
+	EquivalenceClass *eclass = (EquivalenceClass *) linitial(distkey->dk_eclasses);
+	Relids		relids = rel->path->parent->relids;
+	ListCell   *lc;
+
+	foreach(lc, eclass->ec_members)
+	{
+		EquivalenceMember *em = (EquivalenceMember *) lfirst(lc);
+
+		if (em->em_is_const || em->em_is_child)
+			continue;
+		if (bms_is_subset(em->em_relids, relids))
+			return em->em_expr;
+	}
+	return NULL;
+}
+
+/*
+ * cdbpath_skewed_keys
+ *
+ * Looks up the key values of 'rel' that make up at least
+ * gp_motion_skew_threshold of its rows, going by the statistics of the
+ * distribution key expression.  Returns them as a list of Consts, and their
+ * raw cdbhash values in *hashes.  *nulls is set if NULL keys are that common.
+ */
+static List *
+cdbpath_skewed_keys(PlannerInfo *root, CdbpathMfjRel *rel,
+					DistributionKey *distkey, int numsegments,
+					List **hashes, bool *nulls)
+{
+	Expr	   *keyexpr = cdbpath_skew_key_expr(rel, distkey);
+	VariableStatData vardata;
+	AttStatsSlot sslot;
+	List	   *values = NIL;
+	Oid			hashfunc;
+
+	*hashes = NIL;
+	*nulls = false;
+
+	if (!keyexpr)
+		return NIL;
+
+	examine_variable(root, (Node *) keyexpr, 0, &vardata);
+	if (!HeapTupleIsValid(vardata.statsTuple))
+	{
+		ReleaseVariableStats(vardata);
+		return NIL;
+	}
+
+	if (((Form_pg_statistic) GETSTRUCT(vardata.statsTuple))->stanullfrac >=
+		gp_motion_skew_threshold)
+		*nulls = true;
+
+	hashfunc = cdb_hashproc_in_opfamily_no_error(distkey->dk_opfamily,
+												 vardata.atttype);
+	if (OidIsValid(hashfunc) &&
+		vardata.atttype == exprType((Node *) keyexpr) &&
+		get_attstatsslot(&sslot, vardata.statsTuple,
+						 STATISTIC_KIND_MCV, InvalidOid,
+						 ATTSTATSSLOT_VALUES | ATTSTATSSLOT_NUMBERS))
+	{
+		CdbHash    *h = makeCdbHash(numsegments, 1, &hashfunc);
+		int16		typlen;
+		bool		typbyval;
+		int			i;
+
+		get_typlenbyval(vardata.atttype, &typlen, &typbyval);
+
+		for (i = 0; i < sslot.nvalues && i < sslot.nnumbers; i++)
+		{
+			if (sslot.numbers[i] < gp_motion_skew_threshold)
+				continue;
+
+			values = lappend(values,
+							 makeConst(vardata.atttype,
+									   vardata.atttypmod,
+									   exprCollation((Node *) keyexpr),
+									   typlen,
+									   datumCopy(sslot.values[i], typbyval, typlen),
+									   false,
+									   typbyval));
+			cdbhashinit(h);
+			cdbhash(h, 1, sslot.values[i], false);
+			*hashes = lappend_int(*hashes, (int) h->hash);
+
+			if (list_length(values) >= MOTION_SKEW_MAX_KEYS)
+				break;
+		}
+		free_attstatsslot(&sslot);
+		freeCdbHash(h);
+	}
+
+	ReleaseVariableStats(vardata);
+
+	return values;
+}
+
+/*
+ * cdbpath_cost_skew_broadcast
+ *
+ * Adds the cost of broadcasting the rows of 'partner' that have one of the
+ * hot key values to its Motion: every segment receives those, instead of
+ * one. How many there are comes from the selectivity of "key = value".
+ */
+static void
+cdbpath_cost_skew_broadcast(PlannerInfo *root, CdbpathMfjRel *partner,
+							List *values)
+{
+	CdbMotionPath *motionpath = (CdbMotionPath *) partner->path;
+	DistributionKey *distkey = linitial(partner->path->locus.distkey);
+	Expr	   *keyexpr = cdbpath_skew_key_expr(partner, distkey);
+	int			numsegments = CdbPathLocus_NumSegments(partner->path->locus);
+	Selectivity hotsel = 0.0;
+	Cost		cost_per_row;
+	double		extrarows;
+	ListCell   *lc;
+
+	foreach(lc, values)
+	{
+		Const	   *value = (Const *) lfirst(lc);
+		Oid			eqop = InvalidOid;
+
+		if (keyexpr)
+			eqop = get_opfamily_member(distkey->dk_opfamily,
+									   exprType((Node *) keyexpr),
+									   value->consttype,
+									   HTEqualStrategyNumber);
+		if (OidIsValid(eqop))
+		{
+			Expr	   *clause;
+
+			clause = make_opclause(eqop, BOOLOID, false,
+								   keyexpr, (Expr *) value,
+								   InvalidOid, value->constcollid);
+			hotsel += clause_selectivity(root, (Node *) clause, 0,
+										 JOIN_INNER, NULL, false);
+		}
+		else
+			hotsel += DEFAULT_EQ_SEL;
+	}
+	hotsel = Min(hotsel, 1.0);
+
+	/* as in cdbpath_cost_motion(), for the additional copies received */
+	cost_per_row = (gp_motion_cost_per_row > 0.0)
+		? gp_motion_cost_per_row
+		: 2.0 * cpu_tuple_cost;
+	extrarows = motionpath->subpath->rows * hotsel * (numsegments - 1);
+
+	motionpath->path.rows += extrarows;
+	motionpath->path.total_cost += cost_per_row * 0.5 * extrarows;
+}
+
+/*
+ * cdbpath_split_skewed_keys
+ *
+ * Called when both inputs of a join are redistributed on a single join key.
+ * If one input has hot key values, its Motion is told to spread the rows
+ * with those values round-robin over all segments, and the Motion of the
+ * other input to broadcast its rows with the same values.  Spreading NULL
+ * keys needs nothing from the other input, since they match nothing.
+ * The broadcast rows are added to the cost of the other input's Motion.
+ *
+ * Returns true if any Motion was changed. The join result is then no longer
+ * distributed by the join key.
+ */
+static bool
+cdbpath_split_skewed_keys(PlannerInfo *root, JoinType jointype,
+						  CdbpathMfjRel *outer, CdbpathMfjRel *inner)
+{
+	CdbpathMfjRel *candidates[2];
+	int			i;
+
+	if (gp_motion_skew_threshold <= 0 || jointype == JOIN_LASJ_NOTIN)
+		return false;
+	if (!IsA(outer->path, CdbMotionPath) || !IsA(inner->path, CdbMotionPath))
+		return false;
+	if (!CdbPathLocus_IsHashed(outer->path->locus) ||
+		!CdbPathLocus_IsHashed(inner->path->locus) ||
+		list_length(outer->path->locus.distkey) != 1 ||
+		CdbPathLocus_NumSegments(outer->path->locus) <= 1)
+		return false;
+
+	/* Prefer to spread the bigger input */
+	candidates[0] = outer;
+	candidates[1] = inner;
+	if (outer->bytes < inner->bytes)
+		CdbSwap(CdbpathMfjRel *, candidates[0], candidates[1]);
+
+	for (i = 0; i < 2; i++)
+	{
+		CdbpathMfjRel *spread = candidates[i];
+		CdbpathMfjRel *partner = candidates[1 - i];
+		CdbMotionPath *spreadpath = (CdbMotionPath *) spread->path;
+		CdbMotionPath *partnerpath = (CdbMotionPath *) partner->path;
+		List	   *values;
+		List	   *hashes;
+		bool		nulls;
+
+		values = cdbpath_skewed_keys(root, spread,
+									 linitial(spread->path->locus.distkey),
+									 CdbPathLocus_NumSegments(spread->path->locus),
+									 &hashes, &nulls);
+
+		/* The rows of the other input that match hot keys are duplicated */
+		if (!partner->ok_to_replicate)
+			values = hashes = NIL;
+
+		if (values == NIL && !nulls)
+			continue;
+
+		spreadpath->skewMode = MOTIONSKEW_SPREAD;
+		spreadpath->skewValues = values;
+		spreadpath->skewHashes = hashes;
+		spreadpath->skewNulls = nulls;
+
+		if (values != NIL)
+		{
+			partnerpath->skewMode = MOTIONSKEW_BROADCAST;
+			partnerpath->skewValues = values;
+			partnerpath->skewHashes = hashes;
+			cdbpath_cost_skew_broadcast(root, partner, values);
+		}
+		return true;
+	}
+
+	return false;
+}
+
 CdbPathLocus
 cdbpath_motion_for_join(PlannerInfo *root,
 						JoinType jointype,	/* JOIN_INNER/FULL/LEFT/RIGHT/IN */
@@ -932,6 +1175,7 @@ cdbpath_motion_for_join(PlannerInfo *root,
 	CdbpathMfjRel outer;
 	CdbpathMfjRel inner;
 	int			numsegments;
+	bool		redistribute_both = false;
 
 	outer.path = *p_outer_path;
 	inner.path = *p_inner_path;
@@ -1508,6 +1752,7 @@ cdbpath_motion_for_join(PlannerInfo *root,
 
 			large_rel->move_to.numsegments = numsegments;
 			small_rel->move_to.numsegments = numsegments;
+			redistribute_both = true;
 		}
 
 		/*
@@ -1571,6 +1816,17 @@ cdbpath_motion_for_join(PlannerInfo *root,
 	*p_outer_path = outer.path;
 	*p_inner_path = inner.path;
 
+	/* Spread hot join keys, the result is then no longer hashed. */
+	if (redistribute_both &&
+		cdbpath_split_skewed_keys(root, jointype, &outer, &inner))
+	{
+		CdbPathLocus locus;
+
+		CdbPathLocus_MakeStrewn(&locus,
+								CdbPathLocus_NumSegments(outer.path->locus));
+		return locus;
+	}
+
 	/* Tell caller where the join will be done. */
 	return cdbpathlocus_join(jointype, outer.path->locus, inner.path->locus);
 
@@ -224,6 +224,15 @@ bool		gp_interconnect_log_stats = false;	/* emit stats at log-level */
 
 bool		gp_interconnect_cache_future_packets = true;
 
+int			gp_interconnect_udp_batch_size = 1;	/* packets per sendmmsg() and
+													 * recvmmsg() call */
+bool		gp_interconnect_udp_gso = false;	/* use UDP_SEGMENT on send */
+bool		gp_interconnect_udp_gro = false;	/* use UDP_GRO on receive */
+
+bool		gp_interconnect_shm_transport = false;	/* same-host TCP-IC
+													 * connections use shared
+													 * memory rings */
+
 /*
  * format: dbid:content:address:port,dbid:content:address:port ...
  * example: 1:-1:10.0.0.1:2000 2:0:10.0.0.2:2000 3:1:10.0.0.2:2001
@@ -261,6 +270,8 @@ uint32		gp_interconnect_id = 0;
 
 double		gp_motion_cost_per_row = 0;
 int			gp_segments_for_planner = 0;
+double		gp_motion_skew_threshold = 0;
+int			gp_motion_skew_sample_rows = 10000;
 
 int			gp_hashagg_default_nbatches = 32;
 
@@ -276,6 +287,14 @@ int			gp_hashagg_groups_per_bucket = 5;
 /* Analyzing aid */
 int			gp_motion_slice_noop = 0;
 
+int			gp_motion_send_batch_size = 1;
+
+bool		gp_motion_compression = false;
+int			gp_motion_compression_level = 1;
+int			gp_motion_compression_max_delay = 100;
+
+bool		gp_motion_columnar = false;
+
 /* Greengage Database Experimental Feature GUCs */
 int			gp_distinct_grouping_sets_threshold = 32;
 bool		gp_enable_explain_allstat = FALSE;
@@ -0,0 +1,1302 @@
+/*-------------------------------------------------------------------------
+ *
+ * ic_bench.c
+ *	  Interconnect benchmark driver, independent of SQL.
+ *
+ * Forks N sender and M receiver QEs on localhost and pushes synthetic
+ * tuples between them through the real motion layer and interconnect code,
+ * all-to-all like a redistribute motion. ic_bench is linked with the backend
+ * objects the way the unit tests are (see mock.mk), so SendTuple(),
+ * RecvTupleFrom() and the ic_tcp.c, ic_udpifc.c or ic_proxy code run as they
+ * do in a query.
+ *
+ * The parent process plays the postmaster and the dispatcher: it loads the
+ * GUCs, forks the QEs, collects their listener ports, and hands out a
+ * serialized slice table with a receiving root slice and one sending motion
+ * slice. Sender j and receiver j run on segment j. In proxy mode every
+ * segment also gets an ic_proxy server process.
+ *
+ * There is no catalog: the lookups of the two column types the motion layer
+ * does are answered by the __wrap_ functions below.
+ *
+ * The first column of every tuple carries its creation time, so the
+ * receivers can measure the tuple latency, which includes the time spent
+ * waiting for its packet to fill up. The driver reports throughput, latency
+ * percentiles, chunk and (udpifc) packet and retransmission counts, and CPU
+ * seconds used per GB received.
+ *
+ * Portions Copyright (c) 2024-Present, Greengage Database
+ *
+ * IDENTIFICATION
+ *	    src/backend/cdb/motion/bench/ic_bench.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "access/htup_details.h"
+#include "catalog/pg_type.h"
+#include "cdb/cdbgang.h"
+#include "cdb/cdbinterconnect.h"
+#include "cdb/cdbmotion.h"
+#include "cdb/cdbsrlz.h"
+#include "cdb/cdbvars.h"
+#include "cdb/ml_ipc.h"
+#include "executor/executor.h"
+#include "libpq/pqsignal.h"
+#include "miscadmin.h"
+#include "postmaster/postmaster.h"
+#include "storage/latch.h"
+#include "storage/proc.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+#include "utils/resowner.h"
+#include "utils/syscache.h"
+
+#ifdef ENABLE_IC_PROXY
+#include "cdb/ic_proxy_bgworker.h"
+#include "../ic_proxy.h"
+#include "../ic_proxy_server.h"
+#endif							/* ENABLE_IC_PROXY */
+
+/* the motion node of the slice table: the sending slice is slice 1 */
+#define BENCH_MOTION_ID			1
+
+/* smallest tuple: it has to carry its creation time */
+#define MIN_TUPLE_SIZE			((int) sizeof(int64))
+
+/* room for the serialized slice table */
+#define DISPATCH_BUF_SIZE		(4 * 1024 * 1024)
+
+/* how long to wait for the proxies to listen, in s */
+#define PROXY_START_TIMEOUT		30
+
+/*
+ * Latency histogram, in microseconds: values below 64 get a bucket of their
+ * own, larger ones 32 buckets per power of two (about 3% precision).
+ */
+#define HIST_LINEAR			64
+#define HIST_SUB_BITS		5
+#define HIST_BUCKETS		(HIST_LINEAR + (40 - 6) * (1 << HIST_SUB_BITS))
+
+typedef enum BenchRole
+{
+	ROLE_NONE = 0,
+	ROLE_SENDER,
+	ROLE_RECEIVER,
+	ROLE_PROXY
+} BenchRole;
+
+typedef struct BenchOptions
+{
+	const char *ictype;			/* gp_interconnect_type */
+	int			nsenders;
+	int			nreceivers;
+	int			tuplesize;		/* bytes per tuple, headers not included */
+	double		rate;			/* tuples per second per sender, 0 = no limit */
+	double		duration;		/* seconds */
+	int			work_ns;		/* receiver CPU work per tuple */
+	bool		csv;
+	List	   *settings;		/* "name=value" GUC settings */
+} BenchOptions;
+
+/* What every process reports back, in shared memory */
+typedef struct BenchResult
+{
+	BenchRole	role;
+	bool		failed;
+	char		error[256];
+	pid_t		pid;
+	uint32		listener_port;	/* Gp_listener_port of a QE */
+	double		setup;			/* s spent in SetupInterconnect() */
+	double		elapsed;		/* s, from the end of setup to end of stream */
+	double		cpu_user;
+	double		cpu_sys;
+	uint64		tuples;
+	uint64		bytes;			/* tuple bytes, as serialized */
+	uint64		chunks;			/* tuple chunks sent or received */
+	uint64		packets;		/* udpifc: data packets sent */
+	uint64		retransmits;	/* udpifc */
+	uint64		duplicates;		/* udpifc: duplicate packets received */
+	uint64		crc_errors;		/* udpifc */
+	uint64		hist[HIST_BUCKETS];
+} BenchResult;
+
+/* The serialized slice table, from the parent to the QEs */
+typedef struct BenchDispatch
+{
+	int			len;
+	char		data[FLEXIBLE_ARRAY_MEMBER];
+} BenchDispatch;
+
+static BenchOptions opts;
+static BenchResult *results;
+static BenchDispatch *dispatch;
+static int	nqes;				/* receivers, then senders */
+static int	nsegments;
+static int	nchildren;			/* QEs, then proxies */
+static int	ready_pipe[2];
+static int	go_pipe[2];
+static BenchResult *my_result;
+static PGPROC bench_proc;
+
+#ifdef ENABLE_IC_PROXY
+static pg_atomic_uint32 *proxy_listener_failed;
+static int *proxy_ports;
+#endif
+
+static void usage(void);
+static void fail(BenchResult *res, const char *fmt,...) pg_attribute_printf(2, 3);
+static uint64 now_us(void);
+static uint64 now_ns(void);
+static void hist_add(BenchResult *res, uint64 us);
+static uint64 hist_value(int bucket);
+static double hist_percentile(const uint64 *hist, uint64 total, double pct);
+static void *shared_alloc(Size size);
+static void set_option(const char *name, const char *value);
+static void start_segment_process(int content);
+static void wait_for_go(void);
+static void finish_child(BenchResult *res, uint64 start);
+static void bench_log_hook(ErrorData *edata);
+static TupleDesc bench_tuple_desc(void);
+static CdbProcess *make_process(BenchResult *res, int content);
+static SliceTable *make_slice_table(void);
+static void run_qe(int index);
+static void run_sender(EState *estate, TupleDesc tupdesc, BenchResult *res);
+static void run_receiver(EState *estate, TupleDesc tupdesc, BenchResult *res);
+#ifdef ENABLE_IC_PROXY
+static void proxy_sock_path(int content, char *buf, size_t size);
+static int	free_tcp_port(void);
+static void run_proxy(int content);
+#endif
+static void report(uint64 wall_us);
+
+extern HeapTuple __wrap_SearchSysCache(int cacheId, Datum key1, Datum key2,
+									   Datum key3, Datum key4);
+extern void __wrap_ReleaseSysCache(HeapTuple tuple);
+
+static void
+usage(void)
+{
+	printf("ic_bench pushes synthetic tuples between local QEs over the interconnect.\n\n");
+	printf("Usage:\n  ic_bench [OPTION]...\n\n");
+	printf("Options:\n");
+	printf("  -t TYPE     gp_interconnect_type: tcp, udpifc"
+#ifdef ENABLE_IC_PROXY
+		   " or proxy"
+#endif
+		   " (default udpifc)\n");
+	printf("  -s N        number of senders (default 2)\n");
+	printf("  -r N        number of receivers (default 2)\n");
+	printf("  -l BYTES    tuple size (default 100, minimum %d)\n", MIN_TUPLE_SIZE);
+	printf("  -R RATE     tuples per second per sender, 0 for no limit (default 0)\n");
+	printf("  -d SECS     how long the senders send (default 10)\n");
+	printf("  -P BYTES    gp_max_packet_size\n");
+	printf("  -q N        gp_interconnect_queue_depth\n");
+	printf("  -Q N        gp_interconnect_snd_queue_depth\n");
+	printf("  -f METHOD   gp_interconnect_fc_method: loss or capacity\n");
+	printf("  -D MS       gp_interconnect_default_rtt\n");
+	printf("  -T MS       gp_interconnect_min_rto\n");
+	printf("  -x SECS     gp_interconnect_transmit_timeout\n");
+#ifdef USE_ASSERT_CHECKING
+	printf("  -L PCT      gp_udpic_dropxmit_percent, udpifc data packets to drop\n");
+#endif
+	printf("  -C          set gp_interconnect_full_crc\n");
+	printf("  -o NAME=VALUE\n");
+	printf("              set any other GUC, e.g. -o gp_interconnect_shm_transport=on\n");
+	printf("  -w NS       CPU time receivers spend per tuple (default 0)\n");
+	printf("  -c          print one CSV line instead of the report\n");
+	printf("  -h          show this help\n");
+	printf("\nGUCs not given keep their defaults.\n");
+}
+
+static void
+fail(BenchResult *res, const char *fmt,...)
+{
+	va_list		ap;
+
+	va_start(ap, fmt);
+	vsnprintf(res->error, sizeof(res->error), fmt, ap);
+	va_end(ap);
+	res->failed = true;
+	_exit(1);
+}
+
+static uint64
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64
+now_us(void)
+{
+	return now_ns() / 1000;
+}
+
+static void
+hist_add(BenchResult *res, uint64 us)
+{
+	int			bucket;
+
+	if (us < HIST_LINEAR)
+		bucket = (int) us;
+	else
+	{
+		int			e = 63 - __builtin_clzll(us);
+
+		bucket = HIST_LINEAR + (e - 6) * (1 << HIST_SUB_BITS) +
+			(int) ((us >> (e - HIST_SUB_BITS)) & ((1 << HIST_SUB_BITS) - 1));
+		if (bucket >= HIST_BUCKETS)
+			bucket = HIST_BUCKETS - 1;
+	}
+	res->hist[bucket]++;
+}
+
+/* lower bound of a histogram bucket, in us */
+static uint64
+hist_value(int bucket)
+{
+	int			e;
+	int			sub;
+
+	if (bucket < HIST_LINEAR)
+		return bucket;
+	e = (bucket - HIST_LINEAR) / (1 << HIST_SUB_BITS) + 6;
+	sub = (bucket - HIST_LINEAR) % (1 << HIST_SUB_BITS);
+	return ((uint64) ((1 << HIST_SUB_BITS) + sub)) << (e - HIST_SUB_BITS);
+}
+
+static double
+hist_percentile(const uint64 *hist, uint64 total, double pct)
+{
+	uint64		want = (uint64) ceil(total * pct / 100.0);
+	uint64		seen = 0;
+	int			i;
+
+	if (total == 0)
+		return 0;
+	if (want == 0)
+		want = 1;
+	for (i = 0; i < HIST_BUCKETS; i++)
+	{
+		seen += hist[i];
+		if (seen >= want)
+			return hist_value(i) / 1000.0;
+	}
+	return hist_value(HIST_BUCKETS - 1) / 1000.0;
+}
+
+/* Zeroed memory shared with the children */
+static void *
+shared_alloc(Size size)
+{
+	void	   *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+						 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+	if (p == MAP_FAILED)
+	{
+		fprintf(stderr, "ic_bench: could not map shared memory: %m\n");
+		exit(1);
+	}
+	return p;
+}
+
+/* Set a GUC as "postgres -c" would */
+static void
+set_option(const char *name, const char *value)
+{
+	SetConfigOption(name, value, PGC_POSTMASTER, PGC_S_ARGV);
+}
+
+/*
+ * Catalog stand-ins
+ *
+ * InitSerTupInfo() looks up the column types in pg_type. Answer for the
+ * two types of the benchmark tuples, with the values from pg_type.h.
+ */
+HeapTuple
+__wrap_SearchSysCache(int cacheId, Datum key1, Datum key2, Datum key3, Datum key4)
+{
+	Oid			typid = DatumGetObjectId(key1);
+	Size		hoff = MAXALIGN(offsetof(HeapTupleHeaderData, t_bits));
+	HeapTuple	tuple;
+	Form_pg_type typ;
+
+	if (cacheId != TYPEOID || (typid != INT8OID && typid != BYTEAOID))
+		elog(ERROR, "ic_bench has no catalog, cannot look up %u in cache %d",
+			 typid, cacheId);
+
+	tuple = palloc0(HEAPTUPLESIZE + hoff + sizeof(FormData_pg_type));
+	tuple->t_len = hoff + sizeof(FormData_pg_type);
+	tuple->t_data = (HeapTupleHeader) ((char *) tuple + HEAPTUPLESIZE);
+	tuple->t_data->t_hoff = hoff;
+
+	typ = (Form_pg_type) GETSTRUCT(tuple);
+	namestrcpy(&typ->typname, typid == INT8OID ? "int8" : "bytea");
+	typ->typlen = typid == INT8OID ? 8 : -1;
+	typ->typbyval = typid == INT8OID ? FLOAT8PASSBYVAL : false;
+	typ->typtype = TYPTYPE_BASE;
+	typ->typisdefined = true;
+	typ->typalign = typid == INT8OID ? 'd' : 'i';
+	typ->typstorage = typid == INT8OID ? 'p' : 'x';
+
+	return tuple;
+}
+
+void
+__wrap_ReleaseSysCache(HeapTuple tuple)
+{
+	pfree(tuple);
+}
+
+/*
+ * Child processes
+ */
+
+/* What a postmaster child of segment "content" sets up before its work */
+static void
+start_segment_process(int content)
+{
+	char		buf[32];
+
+	MyProcPid = getpid();
+	close(postmaster_alive_fds[POSTMASTER_FD_OWN]);
+	close(ready_pipe[0]);
+
+	snprintf(buf, sizeof(buf), "%d", content);
+	set_option("gp_contentid", buf);
+	snprintf(buf, sizeof(buf), "%d", content + 2);
+	set_option("gp_dbid", buf);
+
+#ifdef ENABLE_IC_PROXY
+	/* the proxy socket is named after the segment's postmaster */
+	if (Gp_interconnect_type == INTERCONNECT_TYPE_PROXY)
+	{
+		PostPortNumber = proxy_ports[content];
+		ic_proxy_peer_listener_failed = &proxy_listener_failed[content];
+	}
+#endif
+}
+
+/* Block until the parent has dispatched the slice table */
+static void
+wait_for_go(void)
+{
+	char		c;
+
+	close(go_pipe[1]);
+	while (read(go_pipe[0], &c, 1) < 0 && errno == EINTR)
+		;
+	close(go_pipe[0]);
+}
+
+static void
+finish_child(BenchResult *res, uint64 start)
+{
+	struct rusage ru;
+
+	if (res->elapsed == 0)
+		res->elapsed = (now_us() - start) / 1000000.0;
+	getrusage(RUSAGE_SELF, &ru);
+	res->cpu_user = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1000000.0;
+	res->cpu_sys = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1000000.0;
+	_exit(0);
+}
+
+static void
+add_stat(const char *msg, const char *key, uint64 *counter)
+{
+	const char *p = strstr(msg, key);
+
+	if (p != NULL)
+		*counter += strtoul(p + strlen(key), NULL, 10);
+}
+
+/*
+ * TeardownUDPIFCInterconnect() logs its packet statistics with
+ * gp_interconnect_log_stats. Pick them up instead of logging them.
+ */
+static void
+bench_log_hook(ErrorData *edata)
+{
+	if (edata->message == NULL ||
+		strncmp(edata->message, "Interconnect State: ", 20) != 0)
+		return;
+
+	add_stat(edata->message, "snd_pkt_count ", &my_result->packets);
+	add_stat(edata->message, " retransmits ", &my_result->retransmits);
+	add_stat(edata->message, "crc_errors ", &my_result->crc_errors);
+	add_stat(edata->message, "duplicated_pkt_num ", &my_result->duplicates);
+	edata->output_to_server = false;
+}
+
+static void
+init_attr(TupleDesc tupdesc, int attnum, const char *name, Oid typid,
+		  int16 typlen, bool typbyval, char typalign, char typstorage)
+{
+	Form_pg_attribute att = tupdesc->attrs[attnum - 1];
+
+	MemSet(att, 0, ATTRIBUTE_FIXED_PART_SIZE);
+	namestrcpy(&att->attname, name);
+	att->atttypid = typid;
+	att->attlen = typlen;
+	att->attbyval = typbyval;
+	att->attalign = typalign;
+	att->attstorage = typstorage;
+	att->attnum = attnum;
+	att->attcacheoff = -1;
+	att->atttypmod = -1;
+	att->attislocal = true;
+}
+
+/* (created int8, payload bytea), built without TupleDescInitEntry() */
+static TupleDesc
+bench_tuple_desc(void)
+{
+	TupleDesc	tupdesc = CreateTemplateTupleDesc(2, false);
+
+	init_attr(tupdesc, 1, "created", INT8OID, 8, FLOAT8PASSBYVAL, 'd', 'p');
+	init_attr(tupdesc, 2, "payload", BYTEAOID, -1, false, 'i', 'x');
+	return tupdesc;
+}
+
+/*
+ * One QE: set up the interconnect for the dispatched slice table like
+ * standard_ExecutorStart() does, run the motion, tear it down.
+ */
+static void
+run_qe(int index)
+{
+	BenchResult *res = &results[index];
+	bool		sender = (index >= opts.nreceivers);
+	int			content = sender ? index - opts.nreceivers : index;
+
+	my_result = res;
+	res->role = sender ? ROLE_SENDER : ROLE_RECEIVER;
+
+	start_segment_process(content);
+	MyProc = &bench_proc;
+	InitializeLatchSupport();
+	pqsignal(SIGPIPE, SIG_IGN);
+	emit_log_hook = bench_log_hook;
+
+	PG_TRY();
+	{
+		EState	   *estate;
+		SliceTable *sliceTable;
+		TupleDesc	tupdesc;
+		uint64		start;
+
+		CurrentResourceOwner = ResourceOwnerCreate(NULL, "ic_bench");
+		InitMotionLayerIPC();
+
+		/* tell the dispatcher where we listen */
+		res->pid = MyProcPid;
+		res->listener_port = Gp_listener_port;
+		if (write(ready_pipe[1], "r", 1) != 1)
+			fail(res, "could not write to pipe: %m");
+		close(ready_pipe[1]);
+
+		wait_for_go();
+
+		estate = CreateExecutorState();
+		MemoryContextSwitchTo(estate->es_query_cxt);
+
+		sliceTable = (SliceTable *) deserializeNode(dispatch->data, dispatch->len);
+		sliceTable->localSlice = sender ? BENCH_MOTION_ID : 0;
+		estate->es_sliceTable = sliceTable;
+		currentSliceId = sliceTable->localSlice;
+
+		estate->motionlayer_context = createMotionLayerState(sliceTable->nMotions);
+
+		start = now_us();
+		SetupInterconnect(estate);
+		UpdateMotionExpectedReceivers(estate->motionlayer_context, sliceTable);
+		res->setup = (now_us() - start) / 1000000.0;
+
+		tupdesc = bench_tuple_desc();
+		UpdateMotionLayerNode(estate->motionlayer_context, BENCH_MOTION_ID,
+							  false, tupdesc);
+
+		if (sender)
+			run_sender(estate, tupdesc, res);
+		else
+			run_receiver(estate, tupdesc, res);
+
+		EndMotionLayerNode(estate->motionlayer_context, BENCH_MOTION_ID, false);
+		TeardownInterconnect(estate->interconnect_context, false);
+		RemoveMotionLayer(estate->motionlayer_context);
+		CleanUpMotionLayerIPC();
+	}
+	PG_CATCH();
+	{
+		ErrorData  *edata;
+
+		MemoryContextSwitchTo(TopMemoryContext);
+		edata = CopyErrorData();
+		fail(res, "%s", edata->message);
+	}
+	PG_END_TRY();
+
+	finish_child(res, 0);
+}
+
+static void
+run_sender(EState *estate, TupleDesc tupdesc, BenchResult *res)
+{
+	MotionLayerState *mlStates = estate->motionlayer_context;
+	ChunkTransportState *transportStates = estate->interconnect_context;
+	TupleTableSlot *slot = MakeSingleTupleTableSlot(tupdesc);
+	MemoryContext tuplecxt;
+	int			paylen = opts.tuplesize - MIN_TUPLE_SIZE;
+	bytea	   *payload = palloc(VARHDRSZ + paylen);
+	Datum		values[2];
+	bool		nulls[2] = {false, false};
+	uint64		start;
+	uint64		end;
+	uint64		interval_ns = opts.rate > 0 ? (uint64) (1e9 / opts.rate) : 0;
+	uint64		next_due;
+	int			route = GpIdentity.segindex % opts.nreceivers;
+
+	SET_VARSIZE(payload, VARHDRSZ + paylen);
+	memset(VARDATA(payload), 'x', paylen);
+	values[1] = PointerGetDatum(payload);
+
+	tuplecxt = AllocSetContextCreate(CurrentMemoryContext,
+									 "ic_bench tuple",
+									 ALLOCSET_DEFAULT_MINSIZE,
+									 ALLOCSET_DEFAULT_INITSIZE,
+									 ALLOCSET_DEFAULT_MAXSIZE);
+
+	start = now_us();
+	end = start + (uint64) (opts.duration * 1000000);
+	next_due = now_ns();
+
+	/*
+	 * Nothing flushes a packet that is not full but the end of stream, as in
+	 * a motion whose child is slow: rate limited tuples wait for their
+	 * packet to fill up, and the latency shows it.
+	 */
+	while (now_us() < end)
+	{
+		MemoryContext oldcxt;
+		HeapTuple	tuple;
+
+		if (interval_ns > 0)
+		{
+			uint64		now = now_ns();
+
+			if (now < next_due)
+			{
+				if (next_due - now > 50000)
+				{
+					struct timespec ts = {0, (long) Min(next_due - now, 1000000)};
+
+					nanosleep(&ts, NULL);
+				}
+				continue;
+			}
+			next_due += interval_ns;
+		}
+
+		MemoryContextReset(tuplecxt);
+		oldcxt = MemoryContextSwitchTo(tuplecxt);
+		values[0] = Int64GetDatum((int64) now_us());
+		tuple = heap_form_tuple(tupdesc, values, nulls);
+		MemoryContextSwitchTo(oldcxt);
+
+		ExecStoreHeapTuple(tuple, slot, InvalidBuffer, false);
+		if (SendTuple(mlStates, transportStates, BENCH_MOTION_ID, slot,
+					  route) == STOP_SENDING)
+			break;
+		res->tuples++;
+
+		if (++route == opts.nreceivers)
+			route = 0;
+	}
+
+	SendEndOfStream(mlStates, transportStates, BENCH_MOTION_ID);
+
+	res->bytes = mlStates->mnEntries[BENCH_MOTION_ID - 1].stat_tuple_bytes_sent;
+	res->chunks = mlStates->mnEntries[BENCH_MOTION_ID - 1].stat_total_chunks_sent;
+	res->elapsed = (now_us() - start) / 1000000.0;
+}
+
+static void
+run_receiver(EState *estate, TupleDesc tupdesc, BenchResult *res)
+{
+	MotionLayerState *mlStates = estate->motionlayer_context;
+	ChunkTransportState *transportStates = estate->interconnect_context;
+	TupleTableSlot *slot = MakeSingleTupleTableSlot(tupdesc);
+	uint64		start = now_us();
+
+	for (;;)
+	{
+		GenericTuple tuple;
+		int64		created;
+		uint64		now;
+		bool		isnull;
+
+		tuple = RecvTupleFrom(mlStates, transportStates, BENCH_MOTION_ID,
+							  ANY_ROUTE);
+		if (tuple == NULL)
+			break;
+
+		now = now_us();
+		ExecStoreGenericTuple(tuple, slot, true);
+		created = DatumGetInt64(slot_getattr(slot, 1, &isnull));
+		hist_add(res, now > created ? now - created : 0);
+		res->tuples++;
+
+		if (opts.work_ns > 0)
+		{
+			uint64		until = now_ns() + opts.work_ns;
+
+			while (now_ns() < until)
+				;
+		}
+	}
+
+	res->bytes = mlStates->mnEntries[BENCH_MOTION_ID - 1].stat_tuple_bytes_recvd;
+	res->chunks = mlStates->mnEntries[BENCH_MOTION_ID - 1].stat_total_chunks_recvd;
+	res->elapsed = (now_us() - start) / 1000000.0;
+}
+
+#ifdef ENABLE_IC_PROXY
+
+static void
+proxy_sock_path(int content, char *buf, size_t size)
+{
+	int			save_port = PostPortNumber;
+
+	PostPortNumber = proxy_ports[content];
+	ic_proxy_build_server_sock_path(buf, size);
+	PostPortNumber = save_port;
+}
+
+/* A TCP port nobody listens on right now */
+static int
+free_tcp_port(void)
+{
+	struct sockaddr_in addr;
+	socklen_t	len = sizeof(addr);
+	int			fd = socket(AF_INET, SOCK_STREAM, 0);
+	int			port = -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (fd >= 0 &&
+		bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0 &&
+		getsockname(fd, (struct sockaddr *) &addr, &len) == 0)
+		port = ntohs(addr.sin_port);
+	if (fd >= 0)
+		close(fd);
+	return port;
+}
+
+/* The ic_proxy server of a segment, as ICProxyMain() runs it */
+static void
+run_proxy(int content)
+{
+	BenchResult *res = &results[nqes + content];
+	uint64		start = now_us();
+
+	res->role = ROLE_PROXY;
+	start_segment_process(content);
+	close(ready_pipe[1]);
+	close(go_pipe[0]);
+	close(go_pipe[1]);
+
+	(void) ic_proxy_server_main();
+
+	finish_child(res, start);
+}
+
+#endif							/* ENABLE_IC_PROXY */
+
+/*
+ * The dispatcher side
+ */
+
+/* A QE's slice table entry, as makeCdbProcess() in cdbgang.c makes it */
+static CdbProcess *
+make_process(BenchResult *res, int content)
+{
+	CdbProcess *process = makeNode(CdbProcess);
+
+	process->listenerAddr = pstrdup("127.0.0.1");
+
+	if (Gp_interconnect_type == INTERCONNECT_TYPE_UDPIFC)
+		process->listenerPort = (res->listener_port >> 16) & 0x0ffff;
+	else
+		process->listenerPort = (res->listener_port & 0x0ffff);
+
+	process->pid = res->pid;
+	process->contentid = content;
+	process->dbid = content + 2;
+	return process;
+}
+
+/*
+ * Slice 0 is the root slice, run by the receivers. Slice 1 sends to it
+ * through motion node 1 and is run by the senders.
+ */
+static SliceTable *
+make_slice_table(void)
+{
+	SliceTable *table = makeNode(SliceTable);
+	Slice	   *recvSlice = makeNode(Slice);
+	Slice	   *sendSlice = makeNode(Slice);
+	int			i;
+
+	recvSlice->sliceIndex = 0;
+	recvSlice->rootIndex = 0;
+	recvSlice->parentIndex = -1;
+	recvSlice->children = list_make1_int(BENCH_MOTION_ID);
+	recvSlice->gangType = GANGTYPE_PRIMARY_READER;
+	recvSlice->gangSize = opts.nreceivers;
+
+	sendSlice->sliceIndex = BENCH_MOTION_ID;
+	sendSlice->rootIndex = 0;
+	sendSlice->parentIndex = 0;
+	sendSlice->children = NIL;
+	sendSlice->gangType = GANGTYPE_PRIMARY_READER;
+	sendSlice->gangSize = opts.nsenders;
+
+	for (i = 0; i < opts.nreceivers; i++)
+	{
+		recvSlice->primaryProcesses = lappend(recvSlice->primaryProcesses,
+											  make_process(&results[i], i));
+		recvSlice->segments = lappend_int(recvSlice->segments, i);
+	}
+	for (i = 0; i < opts.nsenders; i++)
+	{
+		sendSlice->primaryProcesses = lappend(sendSlice->primaryProcesses,
+											  make_process(&results[opts.nreceivers + i], i));
+		sendSlice->segments = lappend_int(sendSlice->segments, i);
+	}
+
+	table->nMotions = 1;
+	table->nInitPlans = 0;
+	table->localSlice = 0;
+	table->slices = list_make2(recvSlice, sendSlice);
+	table->ic_instance_id = 1;
+
+	return table;
+}
+
+/*
+ * Reporting
+ */
+
+static void
+report(uint64 wall_us)
+{
+	BenchResult total;
+	double		elapsed = 0;
+	double		setup = 0;
+	double		cpu[ROLE_PROXY + 1] = {0};
+	double		cpu_total;
+	double		gb;
+	double		mbps;
+	bool		udpifc = (Gp_interconnect_type == INTERCONNECT_TYPE_UDPIFC);
+	ListCell   *lc;
+	int			i;
+	int			j;
+
+	memset(&total, 0, sizeof(total));
+	for (i = 0; i < nchildren; i++)
+	{
+		BenchResult *r = &results[i];
+
+		cpu[r->role] += r->cpu_user + r->cpu_sys;
+		setup = Max(setup, r->setup);
+		if (r->role == ROLE_SENDER)
+		{
+			total.chunks += r->chunks;
+			total.packets += r->packets;
+			total.retransmits += r->retransmits;
+		}
+		else if (r->role == ROLE_RECEIVER)
+		{
+			total.tuples += r->tuples;
+			total.bytes += r->bytes;
+			total.duplicates += r->duplicates;
+			total.crc_errors += r->crc_errors;
+			elapsed = Max(elapsed, r->elapsed);
+			for (j = 0; j < HIST_BUCKETS; j++)
+				total.hist[j] += r->hist[j];
+		}
+	}
+	if (elapsed <= 0)
+		elapsed = wall_us / 1000000.0;
+
+	cpu_total = cpu[ROLE_SENDER] + cpu[ROLE_RECEIVER] + cpu[ROLE_PROXY];
+	gb = total.bytes / (1024.0 * 1024.0 * 1024.0);
+	mbps = total.bytes / (1024.0 * 1024.0) / elapsed;
+
+	if (opts.csv)
+	{
+		printf("type,senders,receivers,tuple_size,rate,packet_size,queue_depth,snd_queue_depth,fc_method,"
+			   "mb_per_s,tuples_per_s,p50_ms,p90_ms,p99_ms,p999_ms,setup_ms,chunks,packets,retransmits,cpu_s_per_gb\n");
+		printf("%s,%d,%d,%d,%.0f,%d,%d,%d,%s,%.2f,%.0f,%.3f,%.3f,%.3f,%.3f,%.3f," UINT64_FORMAT "," UINT64_FORMAT "," UINT64_FORMAT ",%.3f\n",
+			   opts.ictype, opts.nsenders, opts.nreceivers, opts.tuplesize,
+			   opts.rate, Gp_max_packet_size, Gp_interconnect_queue_depth,
+			   Gp_interconnect_snd_queue_depth,
+			   GetConfigOption("gp_interconnect_fc_method", false, false),
+			   mbps, total.tuples / elapsed,
+			   hist_percentile(total.hist, total.tuples, 50),
+			   hist_percentile(total.hist, total.tuples, 90),
+			   hist_percentile(total.hist, total.tuples, 99),
+			   hist_percentile(total.hist, total.tuples, 99.9),
+			   setup * 1000, total.chunks, total.packets, total.retransmits,
+			   gb > 0 ? cpu_total / gb : 0);
+		return;
+	}
+
+	printf("interconnect:    %s, %d senders, %d receivers\n",
+		   opts.ictype, opts.nsenders, opts.nreceivers);
+	printf("tuples:          %d bytes, %s per sender\n", opts.tuplesize,
+		   opts.rate > 0 ? psprintf("%.0f/s", opts.rate) : "unlimited");
+	printf("packets:         %d bytes", Gp_max_packet_size);
+	if (udpifc)
+		printf(", queue depth %d, send queue depth %d, %s flow control",
+			   Gp_interconnect_queue_depth, Gp_interconnect_snd_queue_depth,
+			   GetConfigOption("gp_interconnect_fc_method", false, false));
+	printf("\n");
+	foreach(lc, opts.settings)
+		printf("setting:         %s\n", (char *) lfirst(lc));
+	printf("\n");
+
+	printf("setup:           %.3f ms\n", setup * 1000);
+	printf("elapsed:         %.3f s\n", elapsed);
+	printf("received:        " UINT64_FORMAT " tuples, %.1f MB\n",
+		   total.tuples, total.bytes / (1024.0 * 1024.0));
+	printf("throughput:      %.1f MB/s, %.0f tuples/s\n", mbps, total.tuples / elapsed);
+	printf("latency:         p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, p99.9 %.3f ms\n",
+		   hist_percentile(total.hist, total.tuples, 50),
+		   hist_percentile(total.hist, total.tuples, 90),
+		   hist_percentile(total.hist, total.tuples, 99),
+		   hist_percentile(total.hist, total.tuples, 99.9));
+	printf("chunks sent:     " UINT64_FORMAT "\n", total.chunks);
+	if (udpifc)
+		printf("packets sent:    " UINT64_FORMAT ", " UINT64_FORMAT
+			   " retransmitted (%.2f%%), " UINT64_FORMAT " duplicates, "
+			   UINT64_FORMAT " CRC errors\n",
+			   total.packets, total.retransmits,
+			   total.packets > 0 ? 100.0 * total.retransmits / total.packets : 0,
+			   total.duplicates, total.crc_errors);
+	printf("cpu:             senders %.2f s, receivers %.2f s", cpu[ROLE_SENDER], cpu[ROLE_RECEIVER]);
+	if (Gp_interconnect_type == INTERCONNECT_TYPE_PROXY)
+		printf(", proxies %.2f s", cpu[ROLE_PROXY]);
+	printf("\n");
+	printf("cpu per GB:      %.2f s\n", gb > 0 ? cpu_total / gb : 0);
+}
+
+static bool
+parse_int_arg(const char *arg, int min, int *value)
+{
+	char	   *end;
+	long		v = strtol(arg, &end, 10);
+
+	if (*arg == '\0' || *end != '\0' || v < min || v > INT_MAX)
+		return false;
+	*value = (int) v;
+	return true;
+}
+
+static bool
+parse_double_arg(const char *arg, double min, double *value)
+{
+	char	   *end;
+	double		v = strtod(arg, &end);
+
+	if (*arg == '\0' || *end != '\0' || v < min)
+		return false;
+	*value = v;
+	return true;
+}
+
+/* Remember a GUC setting of the command line, -o or one of the shortcuts */
+static void
+add_setting(const char *name, const char *value)
+{
+	opts.settings = lappend(opts.settings, psprintf("%s=%s", name, value));
+}
+
+/* Kill the children that are still running */
+static void
+kill_children(pid_t *pids, int from, int to, int sig)
+{
+	int			i;
+
+	for (i = from; i < to; i++)
+		if (pids[i] != 0)
+			kill(pids[i], sig);
+}
+
+/*
+ * Reap children until all of the range [from, to) have exited. Returns false
+ * if one of them failed; the others are killed then.
+ */
+static bool
+reap_children(pid_t *pids, int from, int to)
+{
+	bool		ok = true;
+
+	for (;;)
+	{
+		int			status;
+		pid_t		pid;
+		int			i;
+
+		for (i = from; i < to; i++)
+			if (pids[i] != 0)
+				break;
+		if (i == to)
+			break;
+
+		pid = wait(&status);
+		if (pid < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		for (i = 0; i < nchildren; i++)
+			if (pids[i] == pid)
+				break;
+		if (i == nchildren)
+			continue;
+		pids[i] = 0;
+
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		{
+			if (ok)
+				kill_children(pids, 0, nchildren, SIGTERM);
+			if (results[i].failed || ok)
+				fprintf(stderr, "ic_bench: %s %d failed: %s\n",
+						results[i].role == ROLE_SENDER ? "sender" :
+						results[i].role == ROLE_PROXY ? "proxy" : "receiver",
+						i, results[i].failed ? results[i].error :
+						WIFEXITED(status) ? "exited with an error" :
+						"terminated by signal");
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+int
+main(int argc, char **argv)
+{
+	pid_t	   *pids;
+	SliceTable *sliceTable;
+	char	   *serialized;
+	int			len;
+	int			nready = 0;
+	uint64		wall_start;
+	bool		ok = true;
+	char		c;
+	int			opt;
+	int			i;
+	ListCell   *lc;
+
+	progname = "ic_bench";
+
+	opts.ictype = "udpifc";
+	opts.nsenders = 2;
+	opts.nreceivers = 2;
+	opts.tuplesize = 100;
+	opts.duration = 10;
+
+	MemoryContextInit();
+	MemoryAccounting_Reset();
+
+	while ((opt = getopt(argc, argv, "t:s:r:l:R:d:P:q:Q:f:D:T:x:L:Co:w:ch")) != -1)
+	{
+		bool		valid = true;
+
+		switch (opt)
+		{
+			case 't':
+				opts.ictype = optarg;
+				break;
+			case 's':
+				valid = parse_int_arg(optarg, 1, &opts.nsenders);
+				break;
+			case 'r':
+				valid = parse_int_arg(optarg, 1, &opts.nreceivers);
+				break;
+			case 'l':
+				valid = parse_int_arg(optarg, MIN_TUPLE_SIZE, &opts.tuplesize);
+				break;
+			case 'R':
+				valid = parse_double_arg(optarg, 0, &opts.rate);
+				break;
+			case 'd':
+				valid = parse_double_arg(optarg, 0, &opts.duration);
+				break;
+			case 'P':
+				add_setting("gp_max_packet_size", optarg);
+				break;
+			case 'q':
+				add_setting("gp_interconnect_queue_depth", optarg);
+				break;
+			case 'Q':
+				add_setting("gp_interconnect_snd_queue_depth", optarg);
+				break;
+			case 'f':
+				add_setting("gp_interconnect_fc_method", optarg);
+				break;
+			case 'D':
+				add_setting("gp_interconnect_default_rtt", optarg);
+				break;
+			case 'T':
+				add_setting("gp_interconnect_min_rto", optarg);
+				break;
+			case 'x':
+				add_setting("gp_interconnect_transmit_timeout", optarg);
+				break;
+			case 'L':
+#ifdef USE_ASSERT_CHECKING
+				add_setting("gp_udpic_dropxmit_percent", optarg);
+#else
+				fprintf(stderr, "ic_bench: -L needs a build with assertions enabled\n");
+				exit(1);
+#endif
+				break;
+			case 'C':
+				add_setting("gp_interconnect_full_crc", "on");
+				break;
+			case 'o':
+				if (strchr(optarg, '=') == NULL || optarg[0] == '=')
+					valid = false;
+				else
+					opts.settings = lappend(opts.settings, pstrdup(optarg));
+				break;
+			case 'w':
+				valid = parse_int_arg(optarg, 0, &opts.work_ns);
+				break;
+			case 'c':
+				opts.csv = true;
+				break;
+			case 'h':
+				usage();
+				exit(0);
+			default:
+				valid = false;
+				optarg = NULL;
+				break;
+		}
+		if (!valid)
+		{
+			if (optarg)
+				fprintf(stderr, "ic_bench: invalid argument for -%c: \"%s\"\n", opt, optarg);
+			usage();
+			exit(1);
+		}
+	}
+	if (optind < argc)
+	{
+		fprintf(stderr, "ic_bench: too many command-line arguments\n");
+		exit(1);
+	}
+
+	/*
+	 * Start up like a segment postmaster: GUC defaults, then the command
+	 * line. A bad setting is reported by elog() and ends the program.
+	 */
+	pqinitmask();
+	InitializeGUCOptions();
+	set_option("gp_session_role", "execute");
+	set_option("gp_role", "execute");
+	set_option("gp_session_id", "1");
+	set_option("gp_log_interconnect", "off");
+	set_option("gp_interconnect_log_stats", "on");
+	set_option("gp_interconnect_type", opts.ictype);
+	foreach(lc, opts.settings)
+	{
+		char	   *name = pstrdup(lfirst(lc));
+		char	   *value = strchr(name, '=');
+
+		*value++ = '\0';
+		set_option(name, value);
+	}
+
+	PostmasterPid = getpid();
+	if (pipe(postmaster_alive_fds) < 0 ||
+		fcntl(postmaster_alive_fds[POSTMASTER_FD_WATCH], F_SETFL, O_NONBLOCK) < 0)
+	{
+		fprintf(stderr, "ic_bench: could not create postmaster death monitoring pipe: %m\n");
+		exit(1);
+	}
+
+	nqes = opts.nreceivers + opts.nsenders;
+	nsegments = Max(opts.nreceivers, opts.nsenders);
+	nchildren = nqes;
+#ifdef ENABLE_IC_PROXY
+	if (Gp_interconnect_type == INTERCONNECT_TYPE_PROXY)
+	{
+		StringInfoData addrs;
+
+		nchildren += nsegments;
+		proxy_listener_failed = shared_alloc(nsegments * sizeof(pg_atomic_uint32));
+		proxy_ports = palloc(nsegments * sizeof(int));
+
+		/* format: dbid:segid:hostname:port, see ic_proxy_addr.c */
+		initStringInfo(&addrs);
+		for (i = 0; i < nsegments; i++)
+		{
+			pg_atomic_init_u32(&proxy_listener_failed[i], 0);
+			proxy_ports[i] = free_tcp_port();
+			if (proxy_ports[i] < 0)
+			{
+				fprintf(stderr, "ic_bench: could not find a free port: %m\n");
+				exit(1);
+			}
+			appendStringInfo(&addrs, "%s%d:%d:127.0.0.1:%d",
+							 i > 0 ? "," : "", i + 2, i, proxy_ports[i]);
+		}
+		set_option("gp_interconnect_proxy_addresses", addrs.data);
+	}
+#endif
+
+	results = shared_alloc(nchildren * sizeof(BenchResult));
+	dispatch = shared_alloc(offsetof(BenchDispatch, data) + DISPATCH_BUF_SIZE);
+	pids = palloc0(nchildren * sizeof(pid_t));
+
+	if (pipe(ready_pipe) < 0 || pipe(go_pipe) < 0)
+	{
+		fprintf(stderr, "ic_bench: could not create pipe: %m\n");
+		exit(1);
+	}
+
+	/*
+	 * Start the proxies first, and wait for them to listen: the QEs connect
+	 * to them in SetupInterconnect().
+	 */
+#ifdef ENABLE_IC_PROXY
+	for (i = nqes; i < nchildren; i++)
+	{
+		pids[i] = fork();
+		if (pids[i] < 0)
+		{
+			fprintf(stderr, "ic_bench: could not fork: %m\n");
+			pids[i] = 0;
+			kill_children(pids, nqes, nchildren, SIGTERM);
+			exit(1);
+		}
+		if (pids[i] == 0)
+			run_proxy(i - nqes);
+	}
+	for (i = nqes; i < nchildren && ok; i++)
+	{
+		char		path[MAXPGPATH];
+		struct stat st;
+		uint64		deadline = now_us() + PROXY_START_TIMEOUT * 1000000;
+
+		proxy_sock_path(i - nqes, path, sizeof(path));
+		while (stat(path, &st) < 0)
+		{
+			if (now_us() > deadline || waitpid(pids[i], NULL, WNOHANG) != 0)
+			{
+				fprintf(stderr, "ic_bench: proxy %d did not start listening on \"%s\"\n",
+						i - nqes, path);
+				ok = false;
+				break;
+			}
+			pg_usleep(10000);
+		}
+	}
+	if (!ok)
+	{
+		kill_children(pids, nqes, nchildren, SIGTERM);
+		exit(1);
+	}
+#endif
+
+	for (i = 0; i < nqes; i++)
+	{
+		pids[i] = fork();
+		if (pids[i] < 0)
+		{
+			fprintf(stderr, "ic_bench: could not fork: %m\n");
+			pids[i] = 0;
+			ok = false;
+			break;
+		}
+		if (pids[i] == 0)
+			run_qe(i);
+	}
+
+	/* every QE says when it listens, or closes the pipe by dying */
+	close(ready_pipe[1]);
+	close(go_pipe[0]);
+	while (ok && nready < nqes)
+	{
+		ssize_t		n = read(ready_pipe[0], &c, 1);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		nready++;
+	}
+	close(ready_pipe[0]);
+
+	if (!ok || nready < nqes)
+	{
+		kill_children(pids, 0, nchildren, SIGTERM);
+		reap_children(pids, 0, nchildren);
+		exit(1);
+	}
+
+	/* dispatch the slice table, and release everyone at once */
+	sliceTable = make_slice_table();
+	serialized = serializeNode((Node *) sliceTable, &len, NULL);
+	if (len > DISPATCH_BUF_SIZE)
+	{
+		fprintf(stderr, "ic_bench: slice table too large (%d bytes)\n", len);
+		kill_children(pids, 0, nchildren, SIGTERM);
+		reap_children(pids, 0, nchildren);
+		exit(1);
+	}
+	memcpy(dispatch->data, serialized, len);
+	dispatch->len = len;
+
+	wall_start = now_us();
+	close(go_pipe[1]);
+
+	/* reap in whatever order they finish, a failure may block the others */
+	ok = reap_children(pids, 0, nqes);
+
+	/* the proxies run until they are told to stop */
+	kill_children(pids, nqes, nchildren, SIGTERM);
+	if (!reap_children(pids, nqes, nchildren))
+		ok = false;
+
+	if (!ok)
+		exit(1);
+
+	report(now_us() - wall_start);
+	return 0;
+}
@@ -25,15 +25,75 @@
 #include "cdb/htupfifo.h"
 #include "cdb/ml_ipc.h"
 #include "cdb/tupser.h"
+#include "lib/stringinfo.h"
 #include "utils/memutils.h"
+#include "utils/timestamp.h"
 #include "utils/typcache.h"
 
+#ifdef HAVE_LIBZSTD
+#include <zstd.h>
+#endif
+
 
 /*
  * MOTION NODE INFO DATA STRUCTURES
  */
 int			Gp_max_tuple_chunk_size;
 
+/*
+ * Motion compression (gp_motion_compression).
+ *
+ * The sender stages the tuple chunks for each route in a buffer laid out like
+ * the chunk area of a packet. Once a block worth of chunks is staged, the
+ * buffer is compressed with zstd and sent as a single TC_COMPRESSED chunk.
+ * The receiver decompresses it and feeds the chunks inside to the chunk
+ * sorter as if they had arrived one by one. This works the same for all
+ * interconnect types.
+ *
+ * The block size follows the observed compression ratio, so that a block
+ * still fits into one chunk once compressed. If a motion's data doesn't
+ * compress well, the sender gives up and sends the rest of it uncompressed.
+ *
+ * So that a slow producer doesn't hold its tuples back for long, a staging
+ * buffer is also flushed once its oldest chunk has waited for
+ * gp_motion_compression_max_delay. That is checked as tuples are staged.
+ */
+#define COMPRESS_MAX_BLOCK_CHUNKS	4	/* block size limit, in chunks */
+#define COMPRESS_PROBE_BLOCKS		8	/* blocks to see before giving up */
+#define COMPRESS_MIN_SAVING			0.2 /* give up if saving less than this */
+
+typedef struct MotionCompressState
+{
+	bool		enabled;		/* sender: still compressing? */
+
+	int			bufsize;		/* capacity of each staging buffer */
+	int			blocksize;		/* flush a staging buffer at this length */
+
+	/* sender: one staging buffer per route, plus one for broadcast */
+	int			nbufs;
+	char	  **bufs;
+	int		   *buflens;
+	TimestampTz *stagedsince;	/* when each buffer got its first chunk */
+	TimestampTz lastsweep;		/* last look for overdue buffers */
+
+	TupleChunkListItem item;	/* chunk used to send a block */
+
+	/* receiver: decompression buffer */
+	char	   *recvbuf;
+
+	/* statistics */
+	uint64		nblocks;		/* blocks flushed */
+	uint64		bytes_in;		/* staged bytes flushed */
+	uint64		bytes_out;		/* bytes sent for them */
+	uint64		recv_wire_bytes;	/* compressed chunk bytes received */
+	uint64		recv_logical_bytes; /* bytes they decompressed to */
+} MotionCompressState;
+
+#ifdef HAVE_LIBZSTD
+static ZSTD_CCtx *motion_cctx = NULL;
+static ZSTD_DCtx *motion_dctx = NULL;
+#endif
+
 /*
  * STATIC STATE VARS
  *
@@ -76,6 +136,31 @@ static void statRecvTuple(MotionNodeEntry *pMNEntry, ChunkSorterEntry *pCSEntry)
 static bool ShouldSendRecordCache(MotionConn *conn, SerTupInfo *pSerInfo);
 static void UpdateSentRecordCache(MotionConn *conn);
 
+static MotionCompressState *getCompressState(MotionLayerState *mlStates, MotionNodeEntry *pMNEntry, int nroutes);
+static SendReturnCode sendTupleCompressed(MotionLayerState *mlStates, ChunkTransportState *transportStates,
+										  MotionNodeEntry *pMNEntry, int16 motNodeID,
+										  TupleTableSlot *slot, int16 targetRoute);
+static bool flushCompressBuffer(MotionLayerState *mlStates, ChunkTransportState *transportStates,
+								MotionNodeEntry *pMNEntry, int16 motNodeID, int bufno);
+static bool flushAllCompressBuffers(MotionLayerState *mlStates, ChunkTransportState *transportStates,
+									MotionNodeEntry *pMNEntry, int16 motNodeID);
+static void addCompressedChunkToSorter(MotionLayerState *mlStates, ChunkTransportState *transportStates,
+									   MotionNodeEntry *pMNEntry, TupleChunkListItem tcItem,
+									   int16 motNodeID, int16 srcRoute);
+static bool finishCompressStaging(MotionLayerState *mlStates, ChunkTransportState *transportStates,
+								  MotionNodeEntry *pMNEntry, int16 motNodeID, int bufno);
+static bool stageCompressChunk(MotionLayerState *mlStates, ChunkTransportState *transportStates,
+							   MotionNodeEntry *pMNEntry, int16 motNodeID, int bufno,
+							   const char *chunk, int chunklen);
+
+static SendReturnCode sendTupleColumnar(MotionLayerState *mlStates, ChunkTransportState *transportStates,
+										MotionNodeEntry *pMNEntry, int16 motNodeID,
+										TupleTableSlot *slot, int16 targetRoute);
+static bool flushColumnarBatch(MotionLayerState *mlStates, ChunkTransportState *transportStates,
+							   MotionNodeEntry *pMNEntry, int16 motNodeID, int bufno);
+static void addColumnarChunkToSorter(MotionNodeEntry *pMNEntry, ChunkSorterEntry *pCSEntry,
+									 TupleChunkListItem tcItem, TupleRemapper *remapper);
+
 
 
 /* Helper function to perform the operations necessary to reconstruct a
@@ -297,6 +382,9 @@ UpdateMotionLayerNode(MotionLayerState *mlStates, int16 motNodeID, bool preserve
 	pEntry->cleanedUp = false;
 	pEntry->stopped = false;
 	pEntry->moreNetWork = true;
+	pEntry->compress = NULL;
+	pEntry->columnar_batches = NULL;
+	pEntry->num_columnar_batches = 0;
 
 
 	/* All done!  Go back to caller memory-context. */
@@ -457,6 +545,15 @@ SendTuple(MotionLayerState *mlStates,
 	 */
 	pMNEntry = getMotionNodeEntry(mlStates, motNodeID);
 
+	if (gp_motion_columnar && pMNEntry->ser_tup_info.columnar_maxrows > 0)
+		return sendTupleColumnar(mlStates, transportStates, pMNEntry,
+								 motNodeID, slot, targetRoute);
+
+	if (gp_motion_compression &&
+		(pMNEntry->compress == NULL || pMNEntry->compress->enabled))
+		return sendTupleCompressed(mlStates, transportStates, pMNEntry,
+								   motNodeID, slot, targetRoute);
+
 #ifdef AMS_VERBOSE_LOGGING
 	elog(DEBUG5, "Serializing HeapTuple for sending.");
 #endif
@@ -518,6 +615,158 @@ SendTuple(MotionLayerState *mlStates,
 	return rc;
 }
 
+/*
+ * Serialize a tuple into buf as one TC_WHOLE chunk, to be sent later with
+ * SendSerializedTuple().
+ *
+ * This is for senders that only pick the route of a tuple once the child
+ * has moved on to the next one, see doSendTupleBatch(). Serializing the
+ * tuple straight from the child's slot saves copying it into a slot of its
+ * own first.
+ *
+ * Returns the length of the chunk, or 0 if the tuple was not serialized:
+ * it needs more than one chunk or more than buflen bytes, or the motion
+ * uses the columnar format, which batches the rows itself. The caller then
+ * sends the tuple with SendTuple() while it is still in the slot.
+ */
+int
+SerializeTupleToBuffer(MotionLayerState *mlStates,
+					   int16 motNodeID,
+					   TupleTableSlot *slot,
+					   char *buf,
+					   int buflen)
+{
+	MotionNodeEntry *pMNEntry;
+	struct directTransportBuffer b;
+	TupleChunkListData tcList;
+	MemoryContext oldCtxt;
+	int			len;
+
+	AssertArg(!TupIsNull(slot));
+
+	pMNEntry = getMotionNodeEntry(mlStates, motNodeID);
+
+	if (gp_motion_columnar && pMNEntry->ser_tup_info.columnar_maxrows > 0)
+		return 0;
+
+	/* The chunk must still fit into one packet when it is sent. */
+	b.pri = (unsigned char *) buf;
+	b.prilen = Min(buflen, Gp_max_tuple_chunk_size + TUPLE_CHUNK_HEADER_SIZE);
+
+	oldCtxt = MemoryContextSwitchTo(mlStates->motion_layer_mctx);
+
+	/* any route but broadcast makes SerializeTuple() write into b */
+	len = SerializeTuple(slot, &pMNEntry->ser_tup_info, &b, &tcList, 0);
+
+	MemoryContextSwitchTo(oldCtxt);
+
+	if (len <= 0)
+	{
+		/* it was serialized into a chunk list instead, throw that away */
+		clearTCList(&pMNEntry->ser_tup_info.chunkCache, &tcList);
+		return 0;
+	}
+
+	return len;
+}
+
+/*
+ * Send a tuple serialized by SerializeTupleToBuffer().
+ *
+ * Like SendTuple(), the chunk is copied straight into the transport buffer
+ * of the route if it fits, or staged for compression.
+ */
+SendReturnCode
+SendSerializedTuple(MotionLayerState *mlStates,
+					ChunkTransportState *transportStates,
+					int16 motNodeID,
+					const char *chunk,
+					int len,
+					int16 targetRoute)
+{
+	MotionNodeEntry *pMNEntry;
+	TupleChunkListData tcList;
+	TupleChunkListItem tcItem;
+	bool		ok;
+
+	/*
+	 * Analyze tools.  Do not send any thing if this slice is in the bit mask
+	 */
+	if (gp_motion_slice_noop != 0 && (gp_motion_slice_noop & (1 << currentSliceId)) != 0)
+		return SEND_COMPLETE;
+
+	pMNEntry = getMotionNodeEntry(mlStates, motNodeID);
+
+	tcList.p_first = NULL;
+	tcList.p_last = NULL;
+	tcList.num_chunks = 1;
+	tcList.serialized_data_length = len;
+
+	if (gp_motion_compression &&
+		(pMNEntry->compress == NULL || pMNEntry->compress->enabled))
+	{
+		ChunkTransportStateEntry *pEntry = NULL;
+		MotionCompressState *cs;
+		int			bufno;
+
+		getChunkTransportState(transportStates, motNodeID, &pEntry);
+		cs = getCompressState(mlStates, pMNEntry, pEntry->numConns);
+
+		bufno = (targetRoute == BROADCAST_SEGIDX) ? pEntry->numConns : targetRoute;
+		if (cs->bufs[bufno] == NULL)
+			cs->bufs[bufno] = MemoryContextAlloc(mlStates->motion_layer_mctx,
+												 cs->bufsize);
+
+		ok = stageCompressChunk(mlStates, transportStates, pMNEntry,
+								motNodeID, bufno, chunk, len);
+
+		statSendTuple(mlStates, pMNEntry, &tcList);
+
+		ok &= finishCompressStaging(mlStates, transportStates, pMNEntry,
+									motNodeID, bufno);
+	}
+	else
+	{
+		if (targetRoute != BROADCAST_SEGIDX)
+		{
+			struct directTransportBuffer b;
+
+			getTransportDirectBuffer(transportStates, motNodeID, targetRoute, &b);
+			if (b.pri != NULL && len <= b.prilen)
+			{
+				memcpy(b.pri, chunk, len);
+				putTransportDirectBuffer(transportStates, motNodeID, targetRoute, len);
+
+				statSendTuple(mlStates, pMNEntry, &tcList);
+
+				return SEND_COMPLETE;
+			}
+		}
+
+		/* Broadcast, or the packet is full: let the transport chunk it. */
+		tcItem = getChunkFromCache(&pMNEntry->ser_tup_info.chunkCache);
+		memcpy(tcItem->chunk_data, chunk, len);
+		tcItem->chunk_length = len;
+		tcList.num_chunks = 0;
+		appendChunkToTCList(&tcList, tcItem);
+
+		ok = SendTupleChunkToAMS(mlStates, transportStates, motNodeID,
+								 targetRoute, tcItem);
+		if (ok)
+			statSendTuple(mlStates, pMNEntry, &tcList);
+
+		clearTCList(&pMNEntry->ser_tup_info.chunkCache, &tcList);
+	}
+
+	if (!ok)
+	{
+		pMNEntry->stopped = true;
+		return STOP_SENDING;
+	}
+
+	return SEND_COMPLETE;
+}
+
 TupleChunkListItem
 get_eos_tuplechunklist(void)
 {
@@ -542,6 +791,21 @@ SendEndOfStream(MotionLayerState *mlStates,
 	 */
 	pMNEntry = getMotionNodeEntry(mlStates, motNodeID);
 
+	/*
+	 * Send the columnar batches that are not full yet, and whatever is still
+	 * staged for compression, ahead of the EOS.
+	 */
+	if (pMNEntry->columnar_batches != NULL)
+	{
+		int			i;
+
+		for (i = 0; i < pMNEntry->num_columnar_batches; i++)
+			flushColumnarBatch(mlStates, transportStates, pMNEntry,
+							   motNodeID, i);
+	}
+	if (pMNEntry->compress != NULL)
+		flushAllCompressBuffers(mlStates, transportStates, pMNEntry, motNodeID);
+
 	transportStates->SendEos(transportStates, motNodeID, s_eos_chunk_data);
 
 	/*
@@ -804,6 +1068,17 @@ EndMotionLayerNode(MotionLayerState *mlStates, int16 motNodeID, bool flushCommLa
 				 pMNEntry->stat_total_chunks_sent
 				);
 		}
+		if (pMNEntry->compress != NULL && pMNEntry->compress->nblocks > 0)
+		{
+			elog(LOG, "Interconnect seg%d slice%d compressed " UINT64_FORMAT " blocks, "
+				 UINT64_FORMAT " bytes into " UINT64_FORMAT " bytes%s.",
+				 GpIdentity.segindex,
+				 currentSliceId,
+				 pMNEntry->compress->nblocks,
+				 pMNEntry->compress->bytes_in,
+				 pMNEntry->compress->bytes_out,
+				 pMNEntry->compress->enabled ? "" : ", then gave up");
+		}
 		if (pMNEntry->stat_total_bytes_recvd > 0)
 		{
 			elog(LOG, "Interconnect seg%d slice%d received from slice%d: " UINT64_FORMAT " tuples, "
@@ -1123,6 +1398,25 @@ addChunkToSorter(MotionLayerState *mlStates,
 								   "end of stream");
 			break;
 
+		case TC_COMPRESSED:
+			addCompressedChunkToSorter(mlStates, transportStates, pMNEntry,
+									   tcItem, motNodeID, srcRoute);
+			break;
+
+		case TC_COLUMNAR:
+			/* There shouldn't be any partial tuple data in the list! */
+			if (chunkSorterEntry->chunk_list.num_chunks != 0)
+			{
+				ereport(ERROR,
+						(errcode(ERRCODE_GP_INTERCONNECTION_ERROR),
+						 errmsg("received TC_COLUMNAR chunk from [src=%d,mn=%d] after partial tuple data",
+								srcRoute, motNodeID)));
+			}
+
+			addColumnarChunkToSorter(pMNEntry, chunkSorterEntry, tcItem,
+									 conn->remapper);
+			break;
+
 		default:
 			ereport(ERROR,
 					(errcode(ERRCODE_GP_INTERCONNECTION_ERROR),
@@ -1135,6 +1429,633 @@ addChunkToSorter(MotionLayerState *mlStates,
 
 
 
+/*
+ * Set up the gp_motion_compression state of a motion node. The sender
+ * passes the number of routes, so that it gets its staging buffers; the
+ * receiver passes 0.
+ */
+static MotionCompressState *
+getCompressState(MotionLayerState *mlStates, MotionNodeEntry *pMNEntry, int nroutes)
+{
+	MotionCompressState *cs = pMNEntry->compress;
+	MemoryContext oldCtxt;
+
+	if (cs != NULL && (nroutes == 0 || cs->bufs != NULL))
+		return cs;
+
+	oldCtxt = MemoryContextSwitchTo(mlStates->motion_layer_mctx);
+
+	if (cs == NULL)
+	{
+		int			chunksize;
+
+		cs = palloc0(sizeof(MotionCompressState));
+		cs->enabled = true;
+
+		/*
+		 * A staging buffer holds up to COMPRESS_MAX_BLOCK_CHUNKS chunks, plus
+		 * room for the chunk that crosses the flush threshold. The receiver
+		 * sizes its decompression buffer the same way.
+		 */
+		chunksize = TYPEALIGN(TUPLE_CHUNK_ALIGN,
+							  Gp_max_tuple_chunk_size + TUPLE_CHUNK_HEADER_SIZE);
+		cs->bufsize = (COMPRESS_MAX_BLOCK_CHUNKS + 1) * chunksize;
+		cs->blocksize = 2 * Gp_max_tuple_chunk_size;
+
+		pMNEntry->compress = cs;
+	}
+
+	if (nroutes > 0)
+	{
+		cs->nbufs = nroutes + 1;
+		cs->bufs = palloc0(cs->nbufs * sizeof(char *));
+		cs->buflens = palloc0(cs->nbufs * sizeof(int));
+		cs->stagedsince = palloc0(cs->nbufs * sizeof(TimestampTz));
+		cs->item = palloc(sizeof(TupleChunkListItemData) +
+						  TUPLE_CHUNK_HEADER_SIZE + Gp_max_tuple_chunk_size);
+		cs->item->p_next = NULL;
+		cs->item->inplace = NULL;
+	}
+
+	MemoryContextSwitchTo(oldCtxt);
+
+	return cs;
+}
+
+/*
+ * Serialize a tuple into the staging buffer of its route, and flush the
+ * buffer if it holds a block worth of chunks.
+ *
+ * This is SendTuple() for motions that compress. Like the direct transport
+ * buffer, the staging buffer is handed to SerializeTuple() so that small
+ * tuples are serialized in place.
+ */
+static SendReturnCode
+sendTupleCompressed(MotionLayerState *mlStates,
+					ChunkTransportState *transportStates,
+					MotionNodeEntry *pMNEntry,
+					int16 motNodeID,
+					TupleTableSlot *slot,
+					int16 targetRoute)
+{
+	ChunkTransportStateEntry *pEntry = NULL;
+	MotionCompressState *cs;
+	struct directTransportBuffer b;
+	TupleChunkListData tcList;
+	TupleChunkListItem tcItem;
+	MemoryContext oldCtxt;
+	int			bufno;
+	int			sent;
+	bool		ok = true;
+
+	getChunkTransportState(transportStates, motNodeID, &pEntry);
+	cs = getCompressState(mlStates, pMNEntry, pEntry->numConns);
+
+	bufno = (targetRoute == BROADCAST_SEGIDX) ? pEntry->numConns : targetRoute;
+	if (cs->bufs[bufno] == NULL)
+		cs->bufs[bufno] = MemoryContextAlloc(mlStates->motion_layer_mctx,
+											 cs->bufsize);
+
+	/*
+	 * A tuple serialized in place must still fit into one chunk, as the
+	 * receiver checks chunk sizes against the packet size.
+	 */
+	b.pri = (unsigned char *) cs->bufs[bufno] + cs->buflens[bufno];
+	b.prilen = Min(cs->bufsize - cs->buflens[bufno],
+				   Gp_max_tuple_chunk_size + TUPLE_CHUNK_HEADER_SIZE);
+
+	oldCtxt = MemoryContextSwitchTo(mlStates->motion_layer_mctx);
+
+	sent = SerializeTuple(slot, &pMNEntry->ser_tup_info, &b, &tcList, targetRoute);
+
+	MemoryContextSwitchTo(oldCtxt);
+
+	if (sent > 0)
+	{
+		if (cs->buflens[bufno] == 0 && gp_motion_compression_max_delay > 0)
+			cs->stagedsince[bufno] = GetCurrentTimestamp();
+		cs->buflens[bufno] += sent;
+
+		tcList.num_chunks = 1;
+		tcList.serialized_data_length = sent;
+	}
+	else
+	{
+		/* Stage the chunks one by one, flushing when the buffer is full. */
+		for (tcItem = tcList.p_first; tcItem != NULL; tcItem = tcItem->p_next)
+			ok &= stageCompressChunk(mlStates, transportStates, pMNEntry,
+									 motNodeID, bufno, (char *) tcItem->chunk_data,
+									 tcItem->chunk_length);
+	}
+
+	statSendTuple(mlStates, pMNEntry, &tcList);
+
+	if (sent <= 0)
+		clearTCList(&pMNEntry->ser_tup_info.chunkCache, &tcList);
+
+	ok &= finishCompressStaging(mlStates, transportStates, pMNEntry,
+								motNodeID, bufno);
+
+	if (!ok)
+	{
+		pMNEntry->stopped = true;
+		return STOP_SENDING;
+	}
+
+	return SEND_COMPLETE;
+}
+
+/*
+ * Copy a chunk into a staging buffer, flushing the buffer first if the chunk
+ * doesn't fit.
+ */
+static bool
+stageCompressChunk(MotionLayerState *mlStates,
+				   ChunkTransportState *transportStates,
+				   MotionNodeEntry *pMNEntry,
+				   int16 motNodeID,
+				   int bufno,
+				   const char *chunk,
+				   int chunklen)
+{
+	MotionCompressState *cs = pMNEntry->compress;
+	int			len = TYPEALIGN(TUPLE_CHUNK_ALIGN, chunklen);
+	bool		ok = true;
+
+	if (cs->buflens[bufno] + len > cs->bufsize)
+		ok = flushCompressBuffer(mlStates, transportStates, pMNEntry,
+								 motNodeID, bufno);
+
+	if (cs->buflens[bufno] == 0 && gp_motion_compression_max_delay > 0)
+		cs->stagedsince[bufno] = GetCurrentTimestamp();
+
+	memcpy(cs->bufs[bufno] + cs->buflens[bufno], chunk, chunklen);
+	memset(cs->bufs[bufno] + cs->buflens[bufno] + chunklen, 0, len - chunklen);
+	cs->buflens[bufno] += len;
+
+	return ok;
+}
+
+/*
+ * Called after a chunk was staged into buffer bufno: flush the buffer if it
+ * holds a block, and any buffer whose oldest chunk has waited longer than
+ * gp_motion_compression_max_delay. If we just gave up on compression, send
+ * out everything staged.
+ *
+ * Returns false if there is no receiver left, like SendTupleChunkToAMS().
+ */
+static bool
+finishCompressStaging(MotionLayerState *mlStates,
+					  ChunkTransportState *transportStates,
+					  MotionNodeEntry *pMNEntry,
+					  int16 motNodeID,
+					  int bufno)
+{
+	MotionCompressState *cs = pMNEntry->compress;
+	bool		ok = true;
+
+	if (cs->buflens[bufno] >= cs->blocksize)
+		ok &= flushCompressBuffer(mlStates, transportStates, pMNEntry,
+								  motNodeID, bufno);
+
+	/*
+	 * Look at all the buffers at most once per delay, so that a chunk waits
+	 * for less than twice the delay as long as tuples keep coming.
+	 */
+	if (gp_motion_compression_max_delay > 0)
+	{
+		TimestampTz now = GetCurrentTimestamp();
+
+		if (TimestampDifferenceExceeds(cs->lastsweep, now,
+									   gp_motion_compression_max_delay))
+		{
+			int			i;
+
+			for (i = 0; i < cs->nbufs; i++)
+			{
+				if (cs->buflens[i] > 0 &&
+					TimestampDifferenceExceeds(cs->stagedsince[i], now,
+											   gp_motion_compression_max_delay))
+					ok &= flushCompressBuffer(mlStates, transportStates,
+											  pMNEntry, motNodeID, i);
+			}
+			cs->lastsweep = now;
+		}
+	}
+
+	if (!cs->enabled)
+		ok &= flushAllCompressBuffers(mlStates, transportStates, pMNEntry,
+									  motNodeID);
+
+	return ok;
+}
+
+/*
+ * Send the chunks staged in one buffer: compressed as one TC_COMPRESSED
+ * chunk if compression is still enabled and the block shrinks, otherwise as
+ * they are.
+ *
+ * Returns false if there is no receiver left, like SendTupleChunkToAMS().
+ */
+static bool
+flushCompressBuffer(MotionLayerState *mlStates,
+					ChunkTransportState *transportStates,
+					MotionNodeEntry *pMNEntry,
+					int16 motNodeID,
+					int bufno)
+{
+	MotionCompressState *cs = pMNEntry->compress;
+	TupleChunkListItem item = cs->item;
+	char	   *buf = cs->bufs[bufno];
+	int			buflen = cs->buflens[bufno];
+	int16		targetRoute;
+	bool		compressed = false;
+	bool		ok = true;
+
+	if (buflen == 0)
+		return true;
+
+	targetRoute = (bufno == cs->nbufs - 1) ? BROADCAST_SEGIDX : bufno;
+
+#ifdef HAVE_LIBZSTD
+	if (cs->enabled)
+	{
+		size_t		len;
+
+		if (motion_cctx == NULL)
+		{
+			motion_cctx = ZSTD_createCCtx();
+			if (motion_cctx == NULL)
+				elog(ERROR, "out of memory");
+		}
+
+		/*
+		 * The output buffer only has room for one chunk; zstd fails if the
+		 * block doesn't compress that far, and we send it as it is.
+		 */
+		len = ZSTD_compressCCtx(motion_cctx,
+								item->chunk_data + TUPLE_CHUNK_HEADER_SIZE,
+								Gp_max_tuple_chunk_size,
+								buf, buflen,
+								gp_motion_compression_level);
+
+		cs->nblocks++;
+		cs->bytes_in += buflen;
+
+		if (!ZSTD_isError(len) && len < buflen)
+		{
+			compressed = true;
+			cs->bytes_out += len;
+
+			SetChunkType(item->chunk_data, TC_COMPRESSED);
+			SetChunkDataSize(item->chunk_data, len);
+			item->chunk_length = TUPLE_CHUNK_HEADER_SIZE + len;
+
+			/* Size the next block so that it just fits once compressed. */
+			cs->blocksize = Max(Gp_max_tuple_chunk_size,
+								Min(COMPRESS_MAX_BLOCK_CHUNKS * Gp_max_tuple_chunk_size,
+									(double) buflen / len * Gp_max_tuple_chunk_size * 0.9));
+		}
+		else
+		{
+			cs->bytes_out += buflen;
+			cs->blocksize = Max(Gp_max_tuple_chunk_size, cs->blocksize / 2);
+		}
+
+		if (cs->nblocks >= COMPRESS_PROBE_BLOCKS &&
+			cs->bytes_out > cs->bytes_in * (1.0 - COMPRESS_MIN_SAVING))
+			cs->enabled = false;
+	}
+#endif
+
+	if (compressed)
+		ok = SendTupleChunkToAMS(mlStates, transportStates, motNodeID,
+								 targetRoute, item);
+	else
+	{
+		int			off = 0;
+
+		while (off < buflen && ok)
+		{
+			uint16		size;
+
+			memcpy(&size, buf + off, sizeof(uint16));
+			item->chunk_length = TUPLE_CHUNK_HEADER_SIZE + size;
+			memcpy(item->chunk_data, buf + off, item->chunk_length);
+
+			ok = SendTupleChunkToAMS(mlStates, transportStates, motNodeID,
+									 targetRoute, item);
+
+			off += TYPEALIGN(TUPLE_CHUNK_ALIGN, item->chunk_length);
+		}
+	}
+
+	cs->buflens[bufno] = 0;
+
+	return ok;
+}
+
+static bool
+flushAllCompressBuffers(MotionLayerState *mlStates,
+						ChunkTransportState *transportStates,
+						MotionNodeEntry *pMNEntry,
+						int16 motNodeID)
+{
+	MotionCompressState *cs = pMNEntry->compress;
+	bool		ok = true;
+	int			i;
+
+	for (i = 0; i < cs->nbufs; i++)
+		ok &= flushCompressBuffer(mlStates, transportStates, pMNEntry,
+								  motNodeID, i);
+
+	return ok;
+}
+
+/*
+ * Decompress a TC_COMPRESSED chunk, and add the chunks inside to the chunk
+ * sorter.
+ *
+ * The chunks are passed on in place. Whole tuples are deserialized right
+ * away and partial ones are copied, so the decompression buffer can be
+ * reused for the next block.
+ */
+static void
+addCompressedChunkToSorter(MotionLayerState *mlStates,
+						   ChunkTransportState *transportStates,
+						   MotionNodeEntry *pMNEntry,
+						   TupleChunkListItem tcItem,
+						   int16 motNodeID,
+						   int16 srcRoute)
+{
+#ifdef HAVE_LIBZSTD
+	MotionCompressState *cs = getCompressState(mlStates, pMNEntry, 0);
+	char	   *src = GetChunkDataPtr(tcItem) + TUPLE_CHUNK_HEADER_SIZE;
+	size_t		srclen = tcItem->chunk_length - TUPLE_CHUNK_HEADER_SIZE;
+	unsigned long long contentlen;
+	size_t		len;
+	size_t		off;
+
+	if (cs->recvbuf == NULL)
+		cs->recvbuf = MemoryContextAlloc(mlStates->motion_layer_mctx,
+										 cs->bufsize);
+
+	if (motion_dctx == NULL)
+	{
+		motion_dctx = ZSTD_createDCtx();
+		if (motion_dctx == NULL)
+			elog(ERROR, "out of memory");
+	}
+
+	contentlen = ZSTD_getFrameContentSize(src, srclen);
+	if (contentlen == ZSTD_CONTENTSIZE_UNKNOWN ||
+		contentlen == ZSTD_CONTENTSIZE_ERROR ||
+		contentlen > cs->bufsize)
+		ereport(ERROR,
+				(errcode(ERRCODE_GP_INTERCONNECTION_ERROR),
+				 errmsg("received invalid compressed tuple chunk from [src=%d,mn=%d]",
+						srcRoute, motNodeID)));
+
+	len = ZSTD_decompressDCtx(motion_dctx, cs->recvbuf, cs->bufsize, src, srclen);
+	if (ZSTD_isError(len))
+		ereport(ERROR,
+				(errcode(ERRCODE_GP_INTERCONNECTION_ERROR),
+				 errmsg("could not decompress tuple chunk from [src=%d,mn=%d]: %s",
+						srcRoute, motNodeID, ZSTD_getErrorName(len))));
+
+	cs->recv_wire_bytes += tcItem->chunk_length;
+	cs->recv_logical_bytes += len;
+
+	/* We're done with the compressed chunk itself. */
+	pfree(tcItem);
+
+	for (off = 0; off < len;)
+	{
+		TupleChunkListItem item;
+		TupleChunkType tcType;
+		uint16		size;
+
+		if (len - off < TUPLE_CHUNK_HEADER_SIZE)
+			ereport(ERROR,
+					(errcode(ERRCODE_GP_INTERCONNECTION_ERROR),
+					 errmsg("truncated tuple chunk in compressed block from [src=%d,mn=%d]",
+							srcRoute, motNodeID)));
+
+		memcpy(&size, cs->recvbuf + off, sizeof(uint16));
+		if (off + TUPLE_CHUNK_HEADER_SIZE + size > len)
+			ereport(ERROR,
+					(errcode(ERRCODE_GP_INTERCONNECTION_ERROR),
+					 errmsg("truncated tuple chunk in compressed block from [src=%d,mn=%d]",
+							srcRoute, motNodeID)));
+
+		item = (TupleChunkListItem) palloc(sizeof(TupleChunkListItemData));
+		item->p_next = NULL;
+		item->chunk_length = TUPLE_CHUNK_HEADER_SIZE + size;
+		item->inplace = cs->recvbuf + off;
+
+		GetChunkType(item, &tcType);
+		if (tcType == TC_COMPRESSED || tcType == TC_END_OF_STREAM)
+			ereport(ERROR,
+					(errcode(ERRCODE_GP_INTERCONNECTION_ERROR),
+					 errmsg("received tuple chunk of type %d in compressed block from [src=%d,mn=%d]",
+							tcType, srcRoute, motNodeID)));
+
+		addChunkToSorter(mlStates, transportStates, pMNEntry, item,
+						 motNodeID, srcRoute);
+
+		off += TYPEALIGN(TUPLE_CHUNK_ALIGN, TUPLE_CHUNK_HEADER_SIZE + size);
+	}
+#else
+	ereport(ERROR,
+			(errcode(ERRCODE_GP_INTERCONNECTION_ERROR),
+			 errmsg("received compressed tuple chunk from [src=%d,mn=%d], but compression is not supported by this build",
+					srcRoute, motNodeID)));
+#endif
+}
+
+/*
+ * Add a tuple to the columnar batch of its route, and send the batch once
+ * it is full.
+ *
+ * This is SendTuple() for motions that use the columnar format
+ * (gp_motion_columnar), see SerializeColumnarBatch(). Whether a motion can
+ * use it only depends on its tuple descriptor, so that's decided here
+ * rather than by the planner.
+ */
+static SendReturnCode
+sendTupleColumnar(MotionLayerState *mlStates,
+				  ChunkTransportState *transportStates,
+				  MotionNodeEntry *pMNEntry,
+				  int16 motNodeID,
+				  TupleTableSlot *slot,
+				  int16 targetRoute)
+{
+	ColumnarBatch *batch;
+	MemoryContext oldCtxt;
+	int			bufno;
+	bool		full;
+
+	oldCtxt = MemoryContextSwitchTo(mlStates->motion_layer_mctx);
+
+	if (pMNEntry->columnar_batches == NULL)
+	{
+		ChunkTransportStateEntry *pEntry = NULL;
+
+		getChunkTransportState(transportStates, motNodeID, &pEntry);
+		pMNEntry->num_columnar_batches = pEntry->numConns + 1;
+		pMNEntry->columnar_batches =
+			palloc0(pMNEntry->num_columnar_batches * sizeof(ColumnarBatch));
+	}
+
+	bufno = (targetRoute == BROADCAST_SEGIDX) ?
+		pMNEntry->num_columnar_batches - 1 : targetRoute;
+	batch = &pMNEntry->columnar_batches[bufno];
+
+	if (batch->values == NULL)
+		InitColumnarBatch(&pMNEntry->ser_tup_info, batch);
+
+	full = AddTupleToColumnarBatch(slot, &pMNEntry->ser_tup_info, batch);
+
+	MemoryContextSwitchTo(oldCtxt);
+
+	if (full &&
+		!flushColumnarBatch(mlStates, transportStates, pMNEntry, motNodeID, bufno))
+	{
+		pMNEntry->stopped = true;
+		return STOP_SENDING;
+	}
+
+	return SEND_COMPLETE;
+}
+
+/*
+ * Send a columnar batch as one TC_COLUMNAR chunk. With gp_motion_compression,
+ * the chunk goes through the compression staging buffer of its route.
+ *
+ * Returns false if there is no receiver left, like SendTupleChunkToAMS().
+ */
+static bool
+flushColumnarBatch(MotionLayerState *mlStates,
+				   ChunkTransportState *transportStates,
+				   MotionNodeEntry *pMNEntry,
+				   int16 motNodeID,
+				   int bufno)
+{
+	ColumnarBatch *batch = &pMNEntry->columnar_batches[bufno];
+	SerTupInfo *pSerInfo = &pMNEntry->ser_tup_info;
+	TupleChunkListData tcList;
+	TupleChunkListItem tcItem;
+	MemoryContext oldCtxt;
+	int16		targetRoute;
+	bool		ok;
+
+	if (batch->nrows == 0)
+		return true;
+
+	targetRoute = (bufno == pMNEntry->num_columnar_batches - 1) ?
+		BROADCAST_SEGIDX : bufno;
+
+	oldCtxt = MemoryContextSwitchTo(mlStates->motion_layer_mctx);
+
+	tcList.p_first = NULL;
+	tcList.p_last = NULL;
+	tcList.num_chunks = 0;
+	tcList.serialized_data_length = 0;
+
+	tcItem = getChunkFromCache(&pSerInfo->chunkCache);
+	appendChunkToTCList(&tcList, tcItem);
+
+	SerializeColumnarBatch(pSerInfo, batch, tcItem);
+	tcList.serialized_data_length = tcItem->chunk_length - TUPLE_CHUNK_HEADER_SIZE;
+
+	if (gp_motion_compression &&
+		(pMNEntry->compress == NULL || pMNEntry->compress->enabled))
+	{
+		MotionCompressState *cs;
+
+		cs = getCompressState(mlStates, pMNEntry,
+							  pMNEntry->num_columnar_batches - 1);
+		if (cs->bufs[bufno] == NULL)
+			cs->bufs[bufno] = palloc(cs->bufsize);
+
+		ok = stageCompressChunk(mlStates, transportStates, pMNEntry,
+								motNodeID, bufno, (char *) tcItem->chunk_data,
+								tcItem->chunk_length);
+
+		ok &= finishCompressStaging(mlStates, transportStates, pMNEntry,
+									motNodeID, bufno);
+	}
+	else
+		ok = SendTupleChunkToAMS(mlStates, transportStates, motNodeID,
+								 targetRoute, tcItem);
+
+	if (ok)
+		statSendTuple(mlStates, pMNEntry, &tcList);
+
+	clearTCList(&pSerInfo->chunkCache, &tcList);
+
+	MemoryContextSwitchTo(oldCtxt);
+
+	return ok;
+}
+
+/*
+ * Convert a TC_COLUMNAR chunk into tuples, and add them to the ready list,
+ * like reconstructTuple() does for the row format.
+ */
+static void
+addColumnarChunkToSorter(MotionNodeEntry *pMNEntry,
+						 ChunkSorterEntry *pCSEntry,
+						 TupleChunkListItem tcItem,
+						 TupleRemapper *remapper)
+{
+	SerTupInfo *pSerInfo = &pMNEntry->ser_tup_info;
+	GenericTuple *tups;
+	int			ntups;
+	int			i;
+
+	ntups = CvtColumnarChunkToTups(tcItem, pSerInfo, &tups);
+
+	/* We're done with the chunk now. */
+	pfree(tcItem);
+
+	for (i = 0; i < ntups; i++)
+	{
+		GenericTuple tup = TRCheckAndRemap(remapper, pSerInfo->tupdesc, tups[i]);
+
+		htfifo_addtuple(pCSEntry->ready_tuples, tup);
+
+		/* Stats */
+		statNewTupleArrived(pMNEntry, pCSEntry);
+	}
+
+	pfree(tups);
+}
+
+
+void
+ExplainMotionCompression(MotionLayerState *mlStates, int16 motNodeID,
+						 StringInfo buf)
+{
+	MotionNodeEntry *pMNEntry;
+	MotionCompressState *cs;
+
+	if (mlStates == NULL || motNodeID < 1 || motNodeID > mlStates->mneCount)
+		return;
+
+	pMNEntry = &mlStates->mnEntries[motNodeID - 1];
+	cs = pMNEntry->compress;
+
+	if (!pMNEntry->valid || cs == NULL || cs->recv_wire_bytes == 0)
+		return;
+
+	appendStringInfo(buf, "Motion compression: " UINT64_FORMAT " bytes on wire for "
+					 UINT64_FORMAT " bytes of tuple chunks (ratio %.2f).\n",
+					 cs->recv_wire_bytes, cs->recv_logical_bytes,
+					 (double) cs->recv_logical_bytes / cs->recv_wire_bytes);
+}
+
+
 /*
  * STATISTICS HELPER-FUNCTIONS
  *
@@ -452,6 +452,9 @@ putTransportDirectBuffer(ChunkTransportState *transportStates,
 	{
 		conn->msgSize += length;
 		conn->tupleCount++;
+
+		if (transportStates->PutDirectBuffer)
+			transportStates->PutDirectBuffer(transportStates, conn);
 	}
 
 	/* put buffer. */
@@ -513,7 +516,7 @@ DeregisterReadInterest(ChunkTransportState *transportStates,
 		 */
 		shutdown(conn->sockfd, SHUT_WR);
 
-		MPP_FD_CLR(conn->sockfd, &pEntry->readSet);
+		removeReadInterestTCP(pEntry, conn);
 	}
 	return;
 }
@@ -644,6 +647,11 @@ createChunkTransportState(ChunkTransportState *transportStates,
 	pEntry->motNodeId = motNodeID;
 	pEntry->numConns = numConns;
 	pEntry->scanStart = 0;
+	pEntry->epollFd = -1;
+	pEntry->epollWaitFd = -1;
+	pEntry->readyConns = NULL;
+	pEntry->readyHead = 0;
+	pEntry->numReadyConns = 0;
 	pEntry->sendSlice = sendSlice;
 	pEntry->recvSlice = recvSlice;
 
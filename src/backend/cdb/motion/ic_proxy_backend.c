@@ -211,9 +211,7 @@ ic_proxy_backend_on_read_hello_ack(uv_stream_t *stream, ssize_t nread, const uv_
 
 		pEntry = ic_proxy_backend_get_pentry(backend);
 
-		MPP_FD_SET(backend->conn->sockfd, &pEntry->readSet);
-		if (backend->conn->sockfd > pEntry->highReadSock)
-			pEntry->highReadSock = backend->conn->sockfd;
+		addReadInterestTCP(pEntry, backend->conn);
 	}
 }
 
@@ -0,0 +1,625 @@
+/*-------------------------------------------------------------------------
+ * ic_shm.c
+ *	   Shared memory rings for same-host TCP interconnect connections.
+ *
+ * With gp_interconnect_shm_transport, a sender that finds its TCP
+ * interconnect peer on the same host creates a POSIX shared memory ring and
+ * names it in the registration message. From then on, the packets that
+ * flushBuffer() would write to the socket are copied into the ring, and
+ * readPacket() takes them out of the ring instead of recv()ing them. Neither
+ * side makes a system call while the ring is neither empty nor full.
+ *
+ * The socket stays around for everything else:
+ *
+ * - A receiver that finds the ring empty arms rxWaiting, and the sender
+ *   writes one byte to the socket the next time it adds data. That is what
+ *   wakes up RecvTupleChunkFromAny(), which waits on all its connections at
+ *   once, shared memory or not.
+ * - A sender that finds the ring full sleeps on a futex on the ring's tail,
+ *   which the receiver wakes once it has consumed data. Every few hundred
+ *   milliseconds it also looks at the socket, where stop messages and the
+ *   receiver's teardown show up as usual.
+ * - Setup, stop messages and teardown work exactly as for socket
+ *   connections.
+ *
+ * The receiver unlinks the ring's name as soon as it has mapped it, so a
+ * name only outlives a sender that dies before its receiver gets that far.
+ * The postmaster removes those at startup and after a crash.
+ *
+ * The ring is a byte stream: head and tail count bytes modulo 2^32, and the
+ * data area is a power of two, so packets simply wrap around its end.
+ *
+ * Portions Copyright (c) 2012-Present Pivotal Software, Inc.
+ *
+ *
+ * IDENTIFICATION
+ *	    src/backend/cdb/motion/ic_shm.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "miscadmin.h"
+#include "nodes/execnodes.h"	/* Slice, SliceTable */
+#include "port/atomics.h"
+
+#include "cdb/cdbselect.h"
+#include "cdb/cdbvars.h"
+#include "cdb/ml_ipc.h"
+#include "storage/fd.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <netinet/in.h>
+
+#ifdef IC_HAVE_SHM_RING
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+/* the ring holds this many packets of gp_max_packet_size, at least */
+#define IC_SHM_RING_PACKETS		16
+
+/* socket bytes read per call when draining wakeups */
+#define IC_SHM_DRAIN_SIZE		64
+
+/* where shm_open() keeps its names, see RemoveStaleShmRings() */
+#define IC_SHM_DIR				"/dev/shm"
+#define IC_SHM_PREFIX			"gpic."
+
+typedef struct ICShmRing
+{
+	/* written by the sender */
+	pg_atomic_uint32 head;			/* bytes added */
+	pg_atomic_uint32 txWaiting;		/* sender sleeps on tail */
+	char		pad1[PG_CACHE_LINE_SIZE - 2 * sizeof(pg_atomic_uint32)];
+
+	/* written by the receiver */
+	pg_atomic_uint32 tail;			/* bytes consumed; futex word */
+	pg_atomic_uint32 rxWaiting;		/* receiver wants a wakeup byte */
+	pg_atomic_uint32 rxStop;		/* receiver needs no more data */
+	char		pad2[PG_CACHE_LINE_SIZE - 3 * sizeof(pg_atomic_uint32)];
+
+	uint32		size;			/* bytes in data[], a power of 2 */
+	char		data[FLEXIBLE_ARRAY_MEMBER];
+} ICShmRing;
+
+static void shmRingName(char *name, size_t len, int pid, int icId,
+						int sendSliceIndex, int route);
+static void shmRingWakeReceiver(MotionConn *conn);
+static void shmRingWakeSender(ICShmRing *ring);
+static bool shmRingPeerGone(MotionConn *conn);
+
+/*
+ * Name of the ring of a connection. The sender's pid, the interconnect
+ * instance, the motion and the sender's route make it unique on the host.
+ */
+static void
+shmRingName(char *name, size_t len, int pid, int icId, int sendSliceIndex,
+			int route)
+{
+	snprintf(name, len, "/" IC_SHM_PREFIX "%d.%d.%d.%d", pid, icId,
+			 sendSliceIndex, route);
+}
+
+/*
+ * RemoveStaleShmRings
+ *		Postmaster: remove rings left behind by senders that crashed.
+ *
+ * All segments on the host share the names, so only remove those of
+ * processes that are gone.
+ */
+void
+RemoveStaleShmRings(void)
+{
+	DIR		   *dir;
+	struct dirent *de;
+
+	dir = AllocateDir(IC_SHM_DIR);
+	if (dir == NULL)
+		return;
+
+	while ((de = ReadDir(dir, IC_SHM_DIR)) != NULL)
+	{
+		char		name[MAXPGPATH];
+		int			pid;
+
+		if (strncmp(de->d_name, IC_SHM_PREFIX, strlen(IC_SHM_PREFIX)) != 0 ||
+			sscanf(de->d_name + strlen(IC_SHM_PREFIX), "%d", &pid) != 1)
+			continue;
+
+		if (kill(pid, 0) == 0 || errno != ESRCH)
+			continue;
+
+		snprintf(name, sizeof(name), "/%s", de->d_name);
+		if (shm_unlink(name) == 0)
+			elog(LOG, "removed stale interconnect shared memory ring \"%s\"",
+				 name);
+	}
+
+	FreeDir(dir);
+}
+
+/*
+ * isLocalPeer
+ *		Does a connected socket lead to another process on this host?
+ */
+bool
+isLocalPeer(int sockfd, struct sockaddr_storage *localAddr)
+{
+	struct sockaddr_storage peerAddr;
+	socklen_t	addrsize = sizeof(peerAddr);
+
+	if (getpeername(sockfd, (struct sockaddr *) &peerAddr, &addrsize) != 0)
+		return false;
+
+	if (peerAddr.ss_family != localAddr->ss_family)
+		return false;
+
+	/* the kernel picks the peer's own address as source for local peers */
+	if (peerAddr.ss_family == AF_INET)
+		return ((struct sockaddr_in *) &peerAddr)->sin_addr.s_addr ==
+			((struct sockaddr_in *) localAddr)->sin_addr.s_addr;
+#ifdef HAVE_IPV6
+	if (peerAddr.ss_family == AF_INET6)
+		return memcmp(&((struct sockaddr_in6 *) &peerAddr)->sin6_addr,
+					  &((struct sockaddr_in6 *) localAddr)->sin6_addr,
+					  sizeof(struct in6_addr)) == 0;
+#endif
+
+	return false;
+}
+
+/*
+ * createShmRing
+ *		Sender: create the ring of an outgoing connection.
+ *
+ * Returns false, after logging why, if the connection has to stay on the
+ * socket.
+ */
+bool
+createShmRing(MotionConn *conn, int icId, int sendSliceIndex, int route)
+{
+	char		name[64];
+	uint32		size = 1;
+	Size		mapsize;
+	ICShmRing  *ring;
+	int			fd;
+	int			rc;
+
+	while (size < (uint32) Gp_max_packet_size * IC_SHM_RING_PACKETS)
+		size <<= 1;
+	mapsize = offsetof(ICShmRing, data) + size;
+
+	shmRingName(name, sizeof(name), MyProcPid, icId, sendSliceIndex, route);
+
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0)
+	{
+		elog(LOG, "interconnect could not create shared memory ring \"%s\": %m",
+			 name);
+		return false;
+	}
+
+	/*
+	 * Reserve the memory now. On a full tmpfs, a sparse file would only fail
+	 * later, with SIGBUS on first touch.
+	 */
+	do
+	{
+		rc = posix_fallocate(fd, 0, mapsize);
+	} while (rc == EINTR);
+
+	if (rc != 0)
+	{
+		errno = rc;
+		elog(LOG, "interconnect could not size shared memory ring \"%s\": %m",
+			 name);
+		close(fd);
+		shm_unlink(name);
+		return false;
+	}
+
+	ring = mmap(NULL, mapsize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ring == MAP_FAILED)
+	{
+		elog(LOG, "interconnect could not map shared memory ring \"%s\": %m",
+			 name);
+		shm_unlink(name);
+		return false;
+	}
+
+	pg_atomic_init_u32(&ring->head, 0);
+	pg_atomic_init_u32(&ring->txWaiting, 0);
+	pg_atomic_init_u32(&ring->tail, 0);
+	pg_atomic_init_u32(&ring->rxWaiting, 0);
+	pg_atomic_init_u32(&ring->rxStop, 0);
+	ring->size = size;
+
+	conn->shmRing = ring;
+	conn->shmRingMapSize = mapsize;
+	conn->shmRingOwner = true;
+	strlcpy(conn->shmRingName, name, sizeof(conn->shmRingName));
+
+	return true;
+}
+
+/*
+ * attachShmRing
+ *		Receiver: map the ring named by a registration message.
+ *
+ * The name is removed right away; the mappings keep the memory alive.
+ */
+void
+attachShmRing(MotionConn *conn, int srcPid, int icId, int sendSliceIndex,
+			  int route)
+{
+	char		name[64];
+	struct stat st;
+	ICShmRing  *ring;
+	int			fd;
+
+	shmRingName(name, sizeof(name), srcPid, icId, sendSliceIndex, route);
+
+	fd = shm_open(name, O_RDWR, 0600);
+	if (fd < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_GP_INTERCONNECTION_ERROR),
+				 errmsg("interconnect error attaching shared memory ring from seg%d at %s",
+						conn->remoteContentId, conn->remoteHostAndPort),
+				 errdetail("shm_open \"%s\": %m", name)));
+	shm_unlink(name);
+
+	if (fstat(fd, &st) != 0 || st.st_size < offsetof(ICShmRing, data))
+	{
+		close(fd);
+		ereport(ERROR,
+				(errcode(ERRCODE_GP_INTERCONNECTION_ERROR),
+				 errmsg("interconnect error attaching shared memory ring from seg%d at %s",
+						conn->remoteContentId, conn->remoteHostAndPort),
+				 errdetail("invalid size of shared memory ring \"%s\"", name)));
+	}
+
+	ring = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ring == MAP_FAILED)
+		ereport(ERROR,
+				(errcode(ERRCODE_GP_INTERCONNECTION_ERROR),
+				 errmsg("interconnect error attaching shared memory ring from seg%d at %s",
+						conn->remoteContentId, conn->remoteHostAndPort),
+				 errdetail("mmap \"%s\": %m", name)));
+
+	if (offsetof(ICShmRing, data) + ring->size != st.st_size)
+	{
+		munmap(ring, st.st_size);
+		ereport(ERROR,
+				(errcode(ERRCODE_GP_INTERCONNECTION_ERROR),
+				 errmsg("interconnect error attaching shared memory ring from seg%d at %s",
+						conn->remoteContentId, conn->remoteHostAndPort),
+				 errdetail("invalid size of shared memory ring \"%s\"", name)));
+	}
+
+	conn->shmRing = ring;
+	conn->shmRingMapSize = st.st_size;
+	conn->shmRingOwner = false;
+	conn->shmRingName[0] = '\0';
+}
+
+/*
+ * detachShmRing
+ *		Either side: unmap a connection's ring at teardown.
+ */
+void
+detachShmRing(MotionConn *conn)
+{
+	if (conn->shmRing == NULL)
+		return;
+
+	/* in case the receiver never got to attach */
+	if (conn->shmRingOwner)
+		shm_unlink(conn->shmRingName);
+
+	munmap(conn->shmRing, conn->shmRingMapSize);
+	conn->shmRing = NULL;
+}
+
+/*
+ * stopShmRing
+ *		Receiver: tell the sender we need no more data.
+ *
+ * The stop message on the socket still follows; this just saves a sender
+ * that checks the ring before every packet from polling the socket.
+ */
+void
+stopShmRing(MotionConn *conn)
+{
+	ICShmRing  *ring = conn->shmRing;
+
+	pg_atomic_write_u32(&ring->rxStop, 1);
+	pg_memory_barrier();
+
+	/* a sender waiting for space has to notice */
+	pg_atomic_write_u32(&ring->txWaiting, 0);
+	shmRingWakeSender(ring);
+}
+
+/*
+ * shmRingWakeReceiver
+ *		Sender: send the receiver a wakeup byte if it is waiting for data.
+ */
+static void
+shmRingWakeReceiver(MotionConn *conn)
+{
+	ICShmRing  *ring = conn->shmRing;
+	char		m = 'D';
+
+	/* pairs with the barrier in shmRingRecv() */
+	pg_memory_barrier();
+
+	if (pg_atomic_read_u32(&ring->rxWaiting) == 0 ||
+		pg_atomic_exchange_u32(&ring->rxWaiting, 0) == 0)
+		return;
+
+	/*
+	 * If the socket buffer is full, there are wakeups pending anyway; other
+	 * failures show up on the next wait.
+	 */
+	while (send(conn->sockfd, &m, sizeof(m), 0) < 0 && errno == EINTR)
+		;
+}
+
+/*
+ * shmRingWakeSender
+ *		Receiver: wake up a sender waiting for the tail to move.
+ */
+static void
+shmRingWakeSender(ICShmRing *ring)
+{
+	syscall(SYS_futex, &ring->tail.value, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+/*
+ * shmRingPeerGone
+ *		Sender: has the receiver sent a stop message or hung up?
+ *
+ * Nothing else is ever sent to a sender, so any input means stop.
+ */
+static bool
+shmRingPeerGone(MotionConn *conn)
+{
+	mpp_fd_set	rset;
+	struct timeval timeout;
+	int			n;
+
+	timeout.tv_sec = 0;
+	timeout.tv_usec = 0;
+	MPP_FD_ZERO(&rset);
+	MPP_FD_SET(conn->sockfd, &rset);
+
+	n = select(conn->sockfd + 1, (fd_set *) &rset, NULL, NULL, &timeout);
+
+	return n > 0 && MPP_FD_ISSET(conn->sockfd, &rset);
+}
+
+/*
+ * shmRingSend
+ *		Sender: copy a packet into the ring, waiting for space as needed.
+ *
+ * Returns false if the receiver doesn't want any more data.
+ */
+bool
+shmRingSend(ChunkTransportState *transportStates, MotionConn *conn,
+			const char *buf, int len)
+{
+	ICShmRing  *ring = conn->shmRing;
+	uint32		mask = ring->size - 1;
+	uint32		head = pg_atomic_read_u32(&ring->head);
+
+	while (len > 0)
+	{
+		uint32		tail;
+		uint32		space;
+		uint32		off;
+		uint32		n;
+
+		if (pg_atomic_read_u32(&ring->rxStop))
+			return false;
+
+		tail = pg_atomic_read_u32(&ring->tail);
+		space = ring->size - (head - tail);
+
+		if (space == 0)
+		{
+			struct timespec ts;
+
+			/* ask for a wakeup, then check again so we can't miss it */
+			pg_atomic_write_u32(&ring->txWaiting, 1);
+			pg_memory_barrier();
+			if (pg_atomic_read_u32(&ring->tail) != tail ||
+				pg_atomic_read_u32(&ring->rxStop))
+				continue;
+
+			ts.tv_sec = 0;
+			ts.tv_nsec = 500 * 1000 * 1000;
+			syscall(SYS_futex, &ring->tail.value, FUTEX_WAIT, tail, &ts,
+					NULL, 0);
+
+			ML_CHECK_FOR_INTERRUPTS(transportStates->teardownActive);
+
+			if (transportStates->teardownActive || shmRingPeerGone(conn))
+				return false;
+			continue;
+		}
+
+		/* copy what fits, in up to two pieces */
+		n = Min(space, (uint32) len);
+		off = head & mask;
+		if (off + n <= ring->size)
+			memcpy(ring->data + off, buf, n);
+		else
+		{
+			memcpy(ring->data + off, buf, ring->size - off);
+			memcpy(ring->data, buf + (ring->size - off), n - (ring->size - off));
+		}
+
+		/* publish the data before the new head */
+		pg_write_barrier();
+		head += n;
+		pg_atomic_write_u32(&ring->head, head);
+
+		buf += n;
+		len -= n;
+
+		shmRingWakeReceiver(conn);
+	}
+
+	return true;
+}
+
+/*
+ * shmRingRecv
+ *		Receiver: recv() counterpart for a connection with a ring.
+ *
+ * Copies up to len bytes out of the ring. If the ring is empty, reads the
+ * wakeup bytes off the socket and returns -1 with errno EWOULDBLOCK, having
+ * asked the sender for a wakeup; or 0 if the sender has hung up. Sets
+ * conn->sockReadable to whether more data is known to be waiting.
+ */
+ssize_t
+shmRingRecv(MotionConn *conn, char *buf, int len)
+{
+	ICShmRing  *ring = conn->shmRing;
+	uint32		mask = ring->size - 1;
+	uint32		tail = pg_atomic_read_u32(&ring->tail);
+	uint32		head;
+	uint32		avail;
+	uint32		off;
+	uint32		n;
+
+	head = pg_atomic_read_u32(&ring->head);
+	if (head == tail)
+	{
+		char		drain[IC_SHM_DRAIN_SIZE];
+		ssize_t		r;
+
+		/* read the wakeups we've had so far, and find out about EOF */
+		do
+		{
+			r = recv(conn->sockfd, drain, sizeof(drain), MSG_DONTWAIT);
+		} while (r > 0 || (r < 0 && errno == EINTR));
+
+		if (r == 0)
+			return 0;
+		if (errno != EWOULDBLOCK)
+			return -1;
+
+		/* ask for a wakeup, then check again so we can't miss it */
+		pg_atomic_write_u32(&ring->rxWaiting, 1);
+		pg_memory_barrier();
+		head = pg_atomic_read_u32(&ring->head);
+		if (head == tail)
+		{
+			conn->sockReadable = false;
+			errno = EWOULDBLOCK;
+			return -1;
+		}
+	}
+
+	/* read the data only after seeing the head */
+	pg_read_barrier();
+
+	avail = head - tail;
+	n = Min(avail, (uint32) len);
+	off = tail & mask;
+	if (off + n <= ring->size)
+		memcpy(buf, ring->data + off, n);
+	else
+	{
+		memcpy(buf, ring->data + off, ring->size - off);
+		memcpy(buf + (ring->size - off), ring->data, n - (ring->size - off));
+	}
+
+	/* done with the space before handing it back */
+	pg_memory_barrier();
+
+	tail += n;
+	pg_atomic_write_u32(&ring->tail, tail);
+
+	/* pairs with the barrier in shmRingSend() */
+	pg_memory_barrier();
+	if (pg_atomic_read_u32(&ring->txWaiting) != 0 &&
+		pg_atomic_exchange_u32(&ring->txWaiting, 0) != 0)
+		shmRingWakeSender(ring);
+
+	/*
+	 * If we emptied the ring, ask for a wakeup now: the caller may go on to
+	 * wait for other connections rather than come back here.
+	 */
+	if (n == avail)
+	{
+		pg_atomic_write_u32(&ring->rxWaiting, 1);
+		pg_memory_barrier();
+		head = pg_atomic_read_u32(&ring->head);
+	}
+	conn->sockReadable = (head != tail);
+
+	return n;
+}
+
+#else							/* !IC_HAVE_SHM_RING */
+
+bool
+isLocalPeer(int sockfd, struct sockaddr_storage *localAddr)
+{
+	return false;
+}
+
+void
+RemoveStaleShmRings(void)
+{
+}
+
+bool
+createShmRing(MotionConn *conn, int icId, int sendSliceIndex, int route)
+{
+	return false;
+}
+
+void
+attachShmRing(MotionConn *conn, int srcPid, int icId, int sendSliceIndex,
+			  int route)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_GP_INTERCONNECTION_ERROR),
+			 errmsg("interconnect shared memory rings are not supported by this build")));
+}
+
+void
+detachShmRing(MotionConn *conn)
+{
+}
+
+void
+stopShmRing(MotionConn *conn)
+{
+}
+
+bool
+shmRingSend(ChunkTransportState *transportStates, MotionConn *conn,
+			const char *buf, int len)
+{
+	return false;
+}
+
+ssize_t
+shmRingRecv(MotionConn *conn, char *buf, int len)
+{
+	errno = ENOTSUP;
+	return -1;
+}
+
+#endif							/* IC_HAVE_SHM_RING */
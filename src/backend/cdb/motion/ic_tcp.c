@@ -22,6 +22,7 @@
 #include "libpq/ip.h"
 #include "postmaster/postmaster.h"
 #include "utils/builtins.h"
+#include "utils/memutils.h"
 
 #include "cdb/cdbselect.h"
 #include "cdb/tupchunklist.h"
@@ -40,6 +41,23 @@
 #include <sys/time.h>
 #include <netinet/in.h>
 
+/*
+ * On Linux, RecvTupleChunkFromAny() waits on an edge-triggered epoll instance
+ * per receiving motion instead of select()ing over all of its sockets, so a
+ * wake-up costs the same no matter how many senders there are. Elsewhere we
+ * keep using select().
+ */
+#ifdef __linux__
+#include <sys/epoll.h>
+#define IC_TCP_HAVE_EPOLL
+
+/* max events fetched per epoll_wait() */
+#define IC_TCP_EPOLL_EVENTS 64
+
+/* epoll_event tag of the dispatcher's wait socket */
+#define IC_TCP_EPOLL_WAITFD ((uint32) -1)
+#endif
+
 /*
  * backlog for listen() call: it is important that this be something like a
  * good match for the maximum number of QEs. Slow insert performance will
@@ -82,6 +100,14 @@ static void flushInterconnectListenerBacklog(void);
 
 static void waitOnOutbound(ChunkTransportStateEntry *pEntry);
 
+#ifdef IC_TCP_HAVE_EPOLL
+static void pushReadyConn(ChunkTransportStateEntry *pEntry, MotionConn *conn);
+static bool readPacketNoWait(ChunkTransportState *transportStates,
+							 MotionConn *conn);
+static TupleChunkListItem RecvTupleChunkFromAnyEpoll(ChunkTransportState *transportStates,
+													 ChunkTransportStateEntry *pEntry,
+													 int16 *srcRoute);
+#endif
 static TupleChunkListItem RecvTupleChunkFromAnyTCP(ChunkTransportState *transportStates,
 						 int16 motNodeID,
 						 int16 *srcRoute);
@@ -354,8 +380,13 @@ readPacket(MotionConn *conn, ChunkTransportState *transportStates)
 		/*
 		 * we read at the end of the buffer, we've eliminated any slack above
 		 */
-		if ((n = recv(conn->sockfd, conn->pBuff + bytesRead,
-					  Gp_max_packet_size - bytesRead, 0)) < 0)
+		if (conn->shmRing != NULL)
+			n = shmRingRecv(conn, (char *) conn->pBuff + bytesRead,
+							Gp_max_packet_size - bytesRead);
+		else
+			n = recv(conn->sockfd, conn->pBuff + bytesRead,
+					 Gp_max_packet_size - bytesRead, 0);
+		if (n < 0)
 		{
 			if (errno == EINTR)
 				continue;
@@ -363,6 +394,8 @@ readPacket(MotionConn *conn, ChunkTransportState *transportStates)
 			{
 				int			retry = 0;
 
+				conn->sockReadable = false;
+
 				do
 				{
 					struct timeval timeout = tval;
@@ -425,6 +458,13 @@ readPacket(MotionConn *conn, ChunkTransportState *transportStates)
 		}
 		else
 		{
+			/*
+			 * A short read means we drained the socket; epoll will tell us
+			 * when more arrives. shmRingRecv() knows better for rings.
+			 */
+			if (conn->shmRing == NULL)
+				conn->sockReadable = (n == Gp_max_packet_size - bytesRead);
+
 			bytesRead += n;
 
 			if (!gotHeader && bytesRead >= PACKET_HEADER_SIZE)
@@ -817,6 +857,19 @@ sendRegisterMessage(ChunkTransportState *transportStates, ChunkTransportStateEnt
 		regMsg->srcSessionId = gp_session_id;
 		regMsg->srcCommandCount = sliceTbl->ic_instance_id;
 
+		/*
+		 * Offer a shared memory ring to a receiver on the same host. If we
+		 * can't make one, the connection just stays on the socket.
+		 */
+		regMsg->shmRoute = -1;
+		detachShmRing(conn);
+		if (gp_interconnect_shm_transport &&
+			Gp_interconnect_type == INTERCONNECT_TYPE_TCP &&
+			isLocalPeer(conn->sockfd, &localAddr) &&
+			createShmRing(conn, sliceTbl->ic_instance_id,
+						  pEntry->sendSlice->sliceIndex,
+						  conn - pEntry->conns))
+			regMsg->shmRoute = conn - pEntry->conns;
 
 		conn->state = mcsSendRegMsg;
 		conn->msgPos = conn->pBuff;
@@ -941,6 +994,7 @@ readRegisterMessage(ChunkTransportState *transportStates,
 	msg.srcPid = regMsg->srcPid;
 	msg.srcSessionId = regMsg->srcSessionId;
 	msg.srcCommandCount = regMsg->srcCommandCount;
+	msg.shmRoute = regMsg->shmRoute;
 
 	/* Check for valid message format. */
 	if (msg.msgBytes != sizeof(*regMsg))
@@ -1081,10 +1135,12 @@ readRegisterMessage(ChunkTransportState *transportStates,
 	newConn->msgSize = 0;
 	newConn->stillActive = true;
 
-	MPP_FD_SET(newConn->sockfd, &pEntry->readSet);
+	/* the sender moves the data through shared memory */
+	if (msg.shmRoute >= 0)
+		attachShmRing(newConn, msg.srcPid, msg.srcCommandCount,
+					  msg.sendSliceIndex, msg.shmRoute);
 
-	if (newConn->sockfd > pEntry->highReadSock)
-		pEntry->highReadSock = newConn->sockfd;
+	addReadInterestTCP(pEntry, newConn);
 
 #ifdef AMS_VERBOSE_LOGGING
 	dumpEntryConnections(DEBUG4, pEntry);
@@ -2054,6 +2110,12 @@ TeardownTCPInterconnect(ChunkTransportState *transportStates, bool hasErrors)
 		{
 			conn = pEntry->conns + i;
 
+			if (conn->shmRing != NULL)
+			{
+				stopShmRing(conn);
+				detachShmRing(conn);
+			}
+
 			if (conn->sockfd >= 0)
 			{
 				flushIncomingData(conn->sockfd);
@@ -2071,6 +2133,12 @@ TeardownTCPInterconnect(ChunkTransportState *transportStates, bool hasErrors)
 
 			}
 		}
+		if (pEntry->epollFd >= 0)
+		{
+			close(pEntry->epollFd);
+			pEntry->epollFd = -1;
+			pEntry->epollWaitFd = -1;
+		}
 		removeChunkTransportState(transportStates, aSlice->sliceIndex);
 		pfree(pEntry->conns);
 	}
@@ -2105,6 +2173,8 @@ TeardownTCPInterconnect(ChunkTransportState *transportStates, bool hasErrors)
 		{
 			conn = pEntry->conns + i;
 
+			detachShmRing(conn);
+
 			if (conn->sockfd >= 0)
 			{
 				closesocket(conn->sockfd);
@@ -2514,6 +2584,9 @@ doSendStopMessageTCP(ChunkTransportState *transportStates, int16 motNodeID)
 			MPP_FD_ISSET(conn->sockfd, &pEntry->readSet))
 		{
 			/* someone is trying to send stuff to us, let's stop 'em */
+			if (conn->shmRing != NULL)
+				stopShmRing(conn);
+
 			while ((written = send(conn->sockfd, &m, sizeof(m), 0)) < 0)
 			{
 				if (errno == EINTR)
@@ -2558,9 +2631,321 @@ RecvTupleChunkFromTCP(ChunkTransportState *transportStates,
 	getChunkTransportState(transportStates, motNodeID, &pEntry);
 	conn = pEntry->conns + srcRoute;
 
+#ifdef IC_TCP_HAVE_EPOLL
+	if (pEntry->epollFd >= 0)
+	{
+		TupleChunkListItem tcItem = RecvTupleChunk(conn, transportStates);
+
+		/*
+		 * Whatever this left buffered or unread won't be reported by epoll
+		 * again; make sure RecvTupleChunkFromAny() still gets to it.
+		 */
+		if (conn->recvBytes != 0 || conn->sockReadable)
+			pushReadyConn(pEntry, conn);
+
+		return tcItem;
+	}
+#endif
+
 	return RecvTupleChunk(conn, transportStates);
 }
 
+/*
+ * addReadInterestTCP
+ *		Start watching a registered incoming connection for data.
+ */
+void
+addReadInterestTCP(ChunkTransportStateEntry *pEntry, MotionConn *conn)
+{
+	MPP_FD_SET(conn->sockfd, &pEntry->readSet);
+
+	if (conn->sockfd > pEntry->highReadSock)
+		pEntry->highReadSock = conn->sockfd;
+
+	conn->sockReadable = false;
+	conn->onReadyList = false;
+
+#ifdef IC_TCP_HAVE_EPOLL
+	{
+		struct epoll_event ev;
+
+		if (pEntry->epollFd < 0)
+		{
+			pEntry->epollFd = epoll_create1(EPOLL_CLOEXEC);
+			if (pEntry->epollFd < 0)
+				ereport(ERROR,
+						(errcode(ERRCODE_GP_INTERCONNECTION_ERROR),
+						 errmsg("interconnect error setting up incoming connections"),
+						 errdetail("%s: %m", "epoll_create1")));
+
+			/* keep the ring next to the conns it refers to */
+			if (pEntry->readyConns == NULL)
+				pEntry->readyConns =
+					MemoryContextAlloc(GetMemoryChunkContext(pEntry->conns),
+									   pEntry->numConns * sizeof(int));
+			pEntry->readyHead = 0;
+			pEntry->numReadyConns = 0;
+		}
+
+		/*
+		 * Adding a socket that is already readable reports it right away, so
+		 * nothing that arrived before this point is missed.
+		 */
+		MemSet(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+		ev.data.u32 = (uint32) (conn - pEntry->conns);
+		if (epoll_ctl(pEntry->epollFd, EPOLL_CTL_ADD, conn->sockfd, &ev) < 0)
+			ereport(ERROR,
+					(errcode(ERRCODE_GP_INTERCONNECTION_ERROR),
+					 errmsg("interconnect error setting up incoming connections"),
+					 errdetail("%s: %m", "epoll_ctl")));
+
+		/* data read along with the registration message is ready as well */
+		if (conn->recvBytes != 0)
+			pushReadyConn(pEntry, conn);
+	}
+#endif
+}
+
+/*
+ * removeReadInterestTCP
+ *		Stop watching a connection, e.g. after its EOS.
+ */
+void
+removeReadInterestTCP(ChunkTransportStateEntry *pEntry, MotionConn *conn)
+{
+	MPP_FD_CLR(conn->sockfd, &pEntry->readSet);
+
+#ifdef IC_TCP_HAVE_EPOLL
+	/* a conn still on the ready ring is skipped when it comes up */
+	if (pEntry->epollFd >= 0)
+		(void) epoll_ctl(pEntry->epollFd, EPOLL_CTL_DEL, conn->sockfd, NULL);
+#endif
+}
+
+#ifdef IC_TCP_HAVE_EPOLL
+/*
+ * pushReadyConn
+ *		Queue a connection that may have data, unless it is queued already.
+ */
+static void
+pushReadyConn(ChunkTransportStateEntry *pEntry, MotionConn *conn)
+{
+	int			tail;
+
+	if (conn->onReadyList)
+		return;
+
+	Assert(pEntry->numReadyConns < pEntry->numConns);
+
+	tail = pEntry->readyHead + pEntry->numReadyConns;
+	if (tail >= pEntry->numConns)
+		tail -= pEntry->numConns;
+
+	pEntry->readyConns[tail] = conn - pEntry->conns;
+	pEntry->numReadyConns++;
+	conn->onReadyList = true;
+}
+
+/*
+ * readPacketNoWait
+ *		Read what a ready connection has, without waiting for more.
+ *
+ * Returns true once a whole packet is buffered, or the connection has hit
+ * EOF or an error that readPacket() will report. Returns false if the
+ * connection has run dry first: the edge that put it on the ready ring was
+ * stale, or only part of a packet has arrived so far. readPacket() would
+ * block on that one socket then, while the other senders wait behind it.
+ */
+static bool
+readPacketNoWait(ChunkTransportState *transportStates, MotionConn *conn)
+{
+	for (;;)
+	{
+		int			n;
+
+		if (conn->recvBytes >= PACKET_HEADER_SIZE)
+		{
+			uint32		msgSize;
+
+			memcpy(&msgSize, conn->msgPos, sizeof(uint32));
+			if (conn->recvBytes >= msgSize)
+				return true;
+		}
+
+		/* make room at the end of the buffer, as readPacket() does */
+		if (conn->msgPos != conn->pBuff)
+		{
+			if (conn->recvBytes != 0)
+				memmove(conn->pBuff, conn->msgPos, conn->recvBytes);
+			conn->msgPos = conn->pBuff;
+		}
+
+		ML_CHECK_FOR_INTERRUPTS(transportStates->teardownActive);
+
+		if (conn->shmRing != NULL)
+			n = shmRingRecv(conn, (char *) conn->pBuff + conn->recvBytes,
+							Gp_max_packet_size - conn->recvBytes);
+		else
+			n = recv(conn->sockfd, conn->pBuff + conn->recvBytes,
+					 Gp_max_packet_size - conn->recvBytes, 0);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && errno == EWOULDBLOCK)
+		{
+			/* epoll reports the socket again when more arrives */
+			conn->sockReadable = false;
+			return false;
+		}
+		if (n <= 0)
+			return true;
+
+		if (conn->shmRing == NULL)
+			conn->sockReadable = (n == Gp_max_packet_size - conn->recvBytes);
+		conn->recvBytes += n;
+	}
+}
+
+/*
+ * RecvTupleChunkFromAnyEpoll
+ *		RecvTupleChunkFromAny() on top of the motion's epoll instance.
+ *
+ * The epoll instance is edge-triggered: it reports a socket once when data
+ * arrives, and again only after we've drained it. So a connection stays on
+ * the ready ring until a recv() on it comes up short (see readPacket()) and
+ * its buffered messages are used up. Connections are served round-robin, one
+ * packet at a time, which is the fairness the select() scan gave us, and
+ * the cost of a call no longer depends on the number of connections.
+ *
+ * A connection only gets to RecvTupleChunk() once readPacketNoWait() has a
+ * whole packet for it, so one slow or stale connection never makes us block
+ * in readPacket() while others have data.
+ */
+static TupleChunkListItem
+RecvTupleChunkFromAnyEpoll(ChunkTransportState *transportStates,
+						   ChunkTransportStateEntry *pEntry,
+						   int16 *srcRoute)
+{
+	struct epoll_event events[IC_TCP_EPOLL_EVENTS];
+	int			timeout_ms = tval.tv_sec * 1000 + tval.tv_usec / 1000;
+	int			retry = 0;
+
+	for (;;)
+	{
+		int			n,
+					i;
+
+		while (pEntry->numReadyConns > 0)
+		{
+			int			index = pEntry->readyConns[pEntry->readyHead];
+			MotionConn *conn = pEntry->conns + index;
+			TupleChunkListItem tcItem;
+
+			if (++pEntry->readyHead == pEntry->numConns)
+				pEntry->readyHead = 0;
+			pEntry->numReadyConns--;
+			conn->onReadyList = false;
+
+			/* deregistered, or drained by a RecvTupleChunkFrom() meanwhile */
+			if (conn->sockfd < 0 ||
+				!MPP_FD_ISSET(conn->sockfd, &pEntry->readSet) ||
+				(conn->recvBytes == 0 && !conn->sockReadable))
+				continue;
+
+			/* nothing whole to read yet: back to epoll_wait() for this one */
+			if (!readPacketNoWait(transportStates, conn))
+				continue;
+
+			tcItem = RecvTupleChunk(conn, transportStates);
+			*srcRoute = index;
+
+			/* more to come from this one: line it up behind the others */
+			if (conn->recvBytes != 0 || conn->sockReadable)
+				pushReadyConn(pEntry, conn);
+
+			return tcItem;
+		}
+
+		/* Every 2 seconds */
+		if (Gp_role == GP_ROLE_DISPATCH && retry++ > 4)
+		{
+			retry = 0;
+			/* check to see if the dispatcher should cancel */
+			checkForCancelFromQD(transportStates);
+		}
+
+		/* make sure we check for these. */
+		ML_CHECK_FOR_INTERRUPTS(transportStates->teardownActive);
+
+		/*
+		 * Also monitor the events on dispatch fds, eg, errors or sequence
+		 * request from QEs. Which socket that is changes only as QEs finish,
+		 * so it stays registered until then. It is level-triggered, like the
+		 * select() it replaces.
+		 */
+		if (Gp_role == GP_ROLE_DISPATCH)
+		{
+			int			waitFd;
+
+			waitFd = cdbdisp_getWaitSocketFd(transportStates->estate->dispatcherState);
+			if (waitFd != pEntry->epollWaitFd)
+			{
+				if (pEntry->epollWaitFd != PGINVALID_SOCKET)
+					(void) epoll_ctl(pEntry->epollFd, EPOLL_CTL_DEL,
+									 pEntry->epollWaitFd, NULL);
+				pEntry->epollWaitFd = PGINVALID_SOCKET;
+
+				if (waitFd != PGINVALID_SOCKET)
+				{
+					struct epoll_event ev;
+
+					MemSet(&ev, 0, sizeof(ev));
+					ev.events = EPOLLIN;
+					ev.data.u32 = IC_TCP_EPOLL_WAITFD;
+					if (epoll_ctl(pEntry->epollFd, EPOLL_CTL_ADD, waitFd, &ev) == 0)
+						pEntry->epollWaitFd = waitFd;
+				}
+			}
+		}
+
+		n = epoll_wait(pEntry->epollFd, events, IC_TCP_EPOLL_EVENTS, timeout_ms);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			ereport(ERROR,
+					(errcode(ERRCODE_GP_INTERCONNECTION_ERROR),
+					 errmsg("interconnect error receiving an incoming packet"),
+					 errdetail("%s: %m", "epoll_wait")));
+		}
+
+#ifdef AMS_VERBOSE_LOGGING
+		elog(DEBUG5, "RecvTupleChunkFromAny() epoll_wait() returned %d events", n);
+#endif
+
+		for (i = 0; i < n; i++)
+		{
+			MotionConn *conn;
+
+			if (events[i].data.u32 == IC_TCP_EPOLL_WAITFD)
+			{
+				/* handle events on dispatch connection */
+				checkForCancelFromQD(transportStates);
+				continue;
+			}
+
+			Assert(events[i].data.u32 < (uint32) pEntry->numConns);
+			conn = pEntry->conns + events[i].data.u32;
+
+			/* errors and hangups are found out by reading, too */
+			conn->sockReadable = true;
+			pushReadyConn(pEntry, conn);
+		}
+	}
+}
+#endif   /* IC_TCP_HAVE_EPOLL */
+
 static TupleChunkListItem
 RecvTupleChunkFromAnyTCP(ChunkTransportState *transportStates,
 						 int16 motNodeID,
@@ -2582,6 +2967,11 @@ RecvTupleChunkFromAnyTCP(ChunkTransportState *transportStates,
 
 	getChunkTransportState(transportStates, motNodeID, &pEntry);
 
+#ifdef IC_TCP_HAVE_EPOLL
+	if (pEntry->epollFd >= 0)
+		return RecvTupleChunkFromAnyEpoll(transportStates, pEntry, srcRoute);
+#endif
+
 	int			retry = 0;
 
 	do
@@ -2768,6 +3158,9 @@ flushBuffer(ChunkTransportState *transportStates,
 				sent = 0;
 	mpp_fd_set	wset;
 	mpp_fd_set	rset;
+#ifdef FAULT_INJECTOR
+	bool		splitPacket = false;
+#endif
 
 #ifdef AMS_VERBOSE_LOGGING
 	{
@@ -2782,12 +3175,50 @@ flushBuffer(ChunkTransportState *transportStates,
 	/* first set header length */
 	*(uint32 *) conn->pBuff = conn->msgSize;
 
+	/* same-host connection: the receiver's stop shows up in the ring */
+	if (conn->shmRing != NULL)
+	{
+		if (!shmRingSend(transportStates, conn, (char *) conn->pBuff,
+						 conn->msgSize))
+		{
+#ifdef AMS_VERBOSE_LOGGING
+			print_connection(transportStates, conn->sockfd, "stop from");
+#endif
+			conn->stillActive = false;
+			return false;
+		}
+
+		conn->tupleCount = 0;
+		conn->msgSize = PACKET_HEADER_SIZE;
+
+		return true;
+	}
+
 	/* now send message */
 	sendptr = (char *) conn->pBuff;
 	sent = 0;
 	do
 	{
 		struct timeval timeout;
+		int			len = conn->msgSize - sent;
+
+#ifdef FAULT_INJECTOR
+		/*
+		 * Let tests show the receiver packets that arrive in pieces: send
+		 * half, and the rest a moment later.
+		 */
+		if (sent == 0 &&
+			SIMPLE_FAULT_INJECTOR("interconnect_tcp_split_packet") == FaultInjectorTypeSkip)
+		{
+			len /= 2;
+			splitPacket = true;
+		}
+		else if (splitPacket)
+		{
+			pg_usleep(1000L);
+			splitPacket = false;
+		}
+#endif
 
 		/* check for stop message or peer teardown before sending anything  */
 		timeout.tv_sec = 0;
@@ -2811,7 +3242,7 @@ flushBuffer(ChunkTransportState *transportStates,
 			return false;
 		}
 
-		if ((n = send(conn->sockfd, sendptr + sent, conn->msgSize - sent, 0)) < 0)
+		if ((n = send(conn->sockfd, sendptr + sent, len, 0)) < 0)
 		{
 			int	send_errno = errno;
 			ML_CHECK_FOR_INTERRUPTS(transportStates->teardownActive);
@@ -59,6 +59,9 @@
 #include "pgtime.h"
 #include <netinet/in.h>
 #include <ifaddrs.h>
+#ifdef __linux__
+#include <netinet/udp.h>
+#endif
 
 #ifdef WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -138,6 +141,33 @@ int
 /* 1/4 sec in msec */
 #define RX_THREAD_POLL_TIMEOUT (250)
 
+/*
+ * Batched transmit and receive.
+ *
+ * sendmmsg()/recvmmsg() move up to gp_interconnect_udp_batch_size packets per
+ * system call. On top of that, UDP_SEGMENT lets the kernel split one large
+ * send into MTU sized datagrams, and UDP_GRO lets it hand us several
+ * datagrams from the same peer as one. Without kernel support we fall back to
+ * one sendto()/recvfrom() per packet.
+ */
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+#define IC_HAVE_MMSG
+#if defined(UDP_SEGMENT)
+#define IC_HAVE_UDP_GSO
+#endif
+#if defined(UDP_GRO)
+#define IC_HAVE_UDP_GRO
+#endif
+#endif
+
+/* kernel limits for one UDP_SEGMENT send */
+#define IC_UDP_GSO_MAX_SEGMENTS (64)
+#define IC_UDP_GSO_MAX_BYTES (65000)
+
+/* receive buffer of a coalesced UDP_GRO datagram */
+#define IC_UDP_GRO_BUFFER_SIZE (65535)
+#define IC_UDP_GRO_MAX_BATCH (8)
+
 /*
  * Flags definitions for flag-field of UDP-messages
  *
@@ -436,6 +466,16 @@ struct ICGlobalControlInfo
 	 * id, QD use cursorHistoryTable to handle packets mismatch.
 	 */
 	uint32		ic_instance_id;
+
+	/* Is UDP_GRO enabled on the listener socket? */
+	bool		udpGroEnabled;
+
+	/*
+	 * Set by the main thread when the kernel rejects sendmmsg() or
+	 * UDP_SEGMENT, to stop trying them for the rest of the session.
+	 */
+	bool		mmsgUnsupported;
+	bool		udpGsoUnsupported;
 };
 
 /*
@@ -604,6 +644,8 @@ typedef struct AckSendParam
  * crcErrors                 - the number of crc errors.
  * sndPktNum                 - the number of packets sent by sender.
  * recvPktNum                - the number of packets received by receiver.
+ * sndSyscallNum             - the number of system calls used to send packets.
+ * recvSyscallNum            - the number of system calls used to receive packets.
  * disorderedPktNum          - disordered packet number.
  * duplicatedPktNum          - duplicate packet number.
  * recvAckNum                - the number of Acks received.
@@ -625,6 +667,8 @@ typedef struct ICStatistics
 	int32		crcErrors;
 	int32		sndPktNum;
 	int32		recvPktNum;
+	int32		sndSyscallNum;
+	int32		recvSyscallNum;
 	int32		disorderedPktNum;
 	int32		duplicatedPktNum;
 	int32		recvAckNum;
@@ -634,6 +678,45 @@ typedef struct ICStatistics
 /* Statistics for UDP interconnect. */
 static ICStatistics ic_statistics;
 
+/*
+ * XmitBatch
+ *
+ * Packets handed over by sendBuffers() that have not been passed to the
+ * kernel yet. They are already in the unack queues, so if an error discards
+ * the batch the retransmission logic still covers them. Only used by the
+ * main thread.
+ */
+typedef struct XmitBatch
+{
+	ChunkTransportStateEntry *pEntry;
+	int			count;
+	ICBuffer   *bufs[GP_INTERCONNECT_UDP_MAX_BATCH_SIZE];
+} XmitBatch;
+
+static XmitBatch xmit_batch;
+
+#ifdef IC_HAVE_MMSG
+/*
+ * RxBatch
+ *
+ * Staging buffers the rx thread receives into with recvmmsg(). They are
+ * allocated the first time the thread receives a batch and live until the
+ * thread exits. Only used by the rx thread.
+ */
+typedef struct RxBatch
+{
+	int			count;			/* number of allocated buffers */
+	int			bufSize;
+	icpkthdr   *bufs[GP_INTERCONNECT_UDP_MAX_BATCH_SIZE];
+	struct mmsghdr msgs[GP_INTERCONNECT_UDP_MAX_BATCH_SIZE];
+	struct iovec iovs[GP_INTERCONNECT_UDP_MAX_BATCH_SIZE];
+	struct sockaddr_storage peers[GP_INTERCONNECT_UDP_MAX_BATCH_SIZE];
+	char		control[GP_INTERCONNECT_UDP_MAX_BATCH_SIZE][CMSG_SPACE(sizeof(int))];
+} RxBatch;
+
+static RxBatch rx_batch;
+#endif
+
 /* Cached sockaddr of the listening udp socket */
 static struct sockaddr_storage udp_dummy_packet_sockaddr;
 
@@ -733,11 +816,16 @@ static bool SendChunkUDPIFC(ChunkTransportState *transportStates,
 				ChunkTransportStateEntry *pEntry, MotionConn *conn, TupleChunkListItem tcItem, int16 motionId);
 
 static void doSendStopMessageUDPIFC(ChunkTransportState *transportStates, int16 motNodeID);
+static void PutDirectBufferUDPIFC(ChunkTransportState *transportStates, MotionConn *conn);
 static void dispatcherAYT(void);
 static void checkQDConnectionAlive(void);
 
 
 static void *rxThreadFunc(void *arg);
+static bool processRxPacket(icpkthdr *pkt, int read_count, struct sockaddr_storage *peer, socklen_t peerlen);
+static inline bool rxBatchEnabled(void);
+static int	receiveBatch(icpkthdr **pktp);
+static void freeRxBatch(void);
 
 static bool handleMismatch(icpkthdr *pkt, struct sockaddr_storage *peer, int peer_len);
 static void handleAckedPacket(MotionConn *ackConn, ICBuffer *buf, uint64 now);
@@ -749,10 +837,17 @@ static bool handleAckForDuplicatePkt(MotionConn *conn, icpkthdr *pkt);
 static bool handleAckForDisorderPkt(ChunkTransportState *transportStates, ChunkTransportStateEntry *pEntry, MotionConn *conn, icpkthdr *pkt);
 
 static inline void prepareXmit(MotionConn *conn);
+static inline pg_crc32 packetCRC(icpkthdr *pkt, pg_crc32 crc, int32 offset);
 static inline void addCRC(icpkthdr *pkt);
 static inline bool checkCRC(icpkthdr *pkt);
-static void sendBuffers(ChunkTransportState *transportStates, ChunkTransportStateEntry *pEntry, MotionConn *conn);
+static inline void resetXmitCRC(MotionConn *conn);
+static inline void updateXmitCRC(MotionConn *conn);
+static void sendBuffers(ChunkTransportState *transportStates, ChunkTransportStateEntry *pEntry, MotionConn *conn, bool flush);
 static void sendOnce(ChunkTransportState *transportStates, ChunkTransportStateEntry *pEntry, ICBuffer *buf, MotionConn *conn);
+static bool handleXmitError(MotionConn *conn, const char *call);
+static inline bool xmitBatchEnabled(void);
+static void queueXmit(ChunkTransportState *transportStates, ChunkTransportStateEntry *pEntry, ICBuffer *buf);
+static void flushXmitBatch(ChunkTransportState *transportStates);
 static inline uint64 computeExpirationPeriod(MotionConn *conn, uint32 retry);
 
 static ICBuffer *getSndBuffer(MotionConn *conn);
@@ -1545,6 +1640,9 @@ InitMotionUDPIFC(int *listenerSocketFd, uint16 *listenerPort)
 	pg_atomic_init_u32(&ic_control_info.shutdown, 0);
 	ic_control_info.threadCreated = false;
 	ic_control_info.ic_instance_id = 0;
+	ic_control_info.udpGroEnabled = false;
+	ic_control_info.mmsgUnsupported = false;
+	ic_control_info.udpGsoUnsupported = false;
 
 	old = MemoryContextSwitchTo(ic_control_info.memContext);
 
@@ -1560,6 +1658,19 @@ InitMotionUDPIFC(int *listenerSocketFd, uint16 *listenerPort)
 	setupUDPListeningSocket(listenerSocketFd, listenerPort, &txFamily, &udp_dummy_packet_sockaddr);
 	setupUDPListeningSocket(&ICSenderSocket, &ICSenderPort, &ICSenderFamily, NULL);
 
+#ifdef IC_HAVE_UDP_GRO
+	/* must be done before the rx thread starts reading the socket */
+	if (gp_interconnect_udp_gro && gp_interconnect_udp_batch_size > 1)
+	{
+		int			on = 1;
+
+		if (setsockopt(*listenerSocketFd, SOL_UDP, UDP_GRO, &on, sizeof(on)) == 0)
+			ic_control_info.udpGroEnabled = true;
+		else
+			elog(LOG, "could not enable UDP_GRO on interconnect socket, continuing without it: %m");
+	}
+#endif
+
 	/* Initialize receive control data. */
 	resetMainThreadWaiting(&rx_control_info.mainWaitingState);
 
@@ -2788,6 +2899,9 @@ startOutgoingUDPConnections(ChunkTransportState *transportStates,
 
 	Assert(pEntry && pEntry->valid);
 
+	pEntry->stat_count_xmit_pkts = 0;
+	pEntry->stat_count_xmit_syscalls = 0;
+
 	/*
 	 * Setup a MotionConn entry for each of our outbound connections. Request
 	 * a connection to each receiving backend's listening port. NB: Some
@@ -2819,6 +2933,7 @@ startOutgoingUDPConnections(ChunkTransportState *transportStates,
 			conn->deadlockCheckBeginTime = 0;
 			conn->tupleCount = 0;
 			conn->msgSize = sizeof(conn->conn_info);
+			resetXmitCRC(conn);
 			conn->sentSeq = 0;
 			conn->receivedAckSeq = 0;
 			conn->consumedSeq = 0;
@@ -3029,6 +3144,7 @@ setupOutgoingUDPConnection(ChunkTransportState *transportStates, ChunkTransportS
 	 */
 	conn->msgPos = NULL;
 	conn->msgSize = sizeof(conn->conn_info);
+	resetXmitCRC(conn);
 	conn->stillActive = true;
 	conn->conn_info.seq = 1;
 	Assert(conn->peer.ss_family == AF_INET || conn->peer.ss_family == AF_INET6);
@@ -3130,6 +3246,9 @@ SetupUDPIFCInterconnect_Internal(SliceTable *sliceTable)
 
 	Assert(sliceTable->ic_instance_id > 0);
 
+	xmit_batch.count = 0;
+	xmit_batch.pEntry = NULL;
+
 	if (Gp_role == GP_ROLE_DISPATCH)
 	{
 		Assert(gp_interconnect_id == sliceTable->ic_instance_id);
@@ -3166,6 +3285,7 @@ SetupUDPIFCInterconnect_Internal(SliceTable *sliceTable)
 	interconnect_context->SendEos = SendEosUDPIFC;
 	interconnect_context->SendChunk = SendChunkUDPIFC;
 	interconnect_context->doSendStopMessage = doSendStopMessageUDPIFC;
+	interconnect_context->PutDirectBuffer = PutDirectBufferUDPIFC;
 
 	mySlice = (Slice *) list_nth(interconnect_context->sliceTable->slices, sliceTable->localSlice);
 
@@ -3603,6 +3723,16 @@ TeardownUDPIFCInterconnect_Internal(ChunkTransportState *transportStates,
 			/* now it is safe to remove. */
 			pEntry = removeChunkTransportState(transportStates, mySlice->sliceIndex);
 
+			/* unsent packets of an aborted batch are returned below */
+			xmit_batch.count = 0;
+			xmit_batch.pEntry = NULL;
+
+			if (pEntry->stat_count_xmit_syscalls > 0)
+				elog((gp_interconnect_log_stats ? LOG : DEBUG1),
+					 "Interconnect motion %d: sent " UINT64_FORMAT " packets in " UINT64_FORMAT " system calls (%.2f packets per call)",
+					 pEntry->motNodeId, pEntry->stat_count_xmit_pkts, pEntry->stat_count_xmit_syscalls,
+					 (double) pEntry->stat_count_xmit_pkts / (double) pEntry->stat_count_xmit_syscalls);
+
 			/* connection array allocation may fail in interconnect setup. */
 			if (pEntry->conns)
 			{
@@ -3754,8 +3884,8 @@ TeardownUDPIFCInterconnect_Internal(ChunkTransportState *transportStates,
 		 "UNACK_QUEUE_RING_SLOTS_NUM %d TIMER_SPAN %lld DEFAULT_RTT %d "
 		 "hasErrors %d, ic_instance_id %d ic_id_last_teardown %d "
 		 "snd_buffer_pool.count %d snd_buffer_pool.maxCount %d snd_sock_bufsize %d recv_sock_bufsize %d "
-		 "snd_pkt_count %d retransmits %d crc_errors %d"
-		 " recv_pkt_count %d recv_ack_num %d"
+		 "snd_pkt_count %d snd_syscall_count %d retransmits %d crc_errors %d"
+		 " recv_pkt_count %d recv_syscall_count %d recv_ack_num %d"
 		 " recv_queue_size_avg %f"
 		 " capacity_avg %f"
 		 " freebuf_avg %f "
@@ -3767,8 +3897,8 @@ TeardownUDPIFCInterconnect_Internal(ChunkTransportState *transportStates,
 		 UNACK_QUEUE_RING_SLOTS_NUM, TIMER_SPAN, DEFAULT_RTT,
 		 hasErrors, transportStates->sliceTable->ic_instance_id, rx_control_info.lastTornIcId,
 		 snd_buffer_pool.count, snd_buffer_pool.maxCount, ic_control_info.socketSendBufferSize, ic_control_info.socketRecvBufferSize,
-		 ic_statistics.sndPktNum, ic_statistics.retransmits, ic_statistics.crcErrors,
-		 ic_statistics.recvPktNum, ic_statistics.recvAckNum,
+		 ic_statistics.sndPktNum, ic_statistics.sndSyscallNum, ic_statistics.retransmits, ic_statistics.crcErrors,
+		 ic_statistics.recvPktNum, ic_statistics.recvSyscallNum, ic_statistics.recvAckNum,
 		 (double) ((double) ic_statistics.totalRecvQueueSize) / ((double) ic_statistics.recvQueueSizeCountingTime),
 		 (double) ((double) ic_statistics.totalCapacity) / ((double) ic_statistics.capacityCountingTime),
 		 (double) ((double) ic_statistics.totalBuffers) / ((double) ic_statistics.bufferCountingTime),
@@ -4422,6 +4552,7 @@ handleAcks(ChunkTransportState *transportStates, ChunkTransportStateEntry *pEntr
 		{
 			if (errno == EWOULDBLOCK)	/* had nothing to read. */
 			{
+				flushXmitBatch(transportStates);
 				aggregateStatistics(pEntry);
 				return ret;
 			}
@@ -4593,7 +4724,7 @@ handleAcks(ChunkTransportState *transportStates, ChunkTransportStateEntry *pEntr
 			 * in EOS sending logic and will not check stop message.
 			 */
 			if (shouldSendBuffers)
-				sendBuffers(transportStates, pEntry, ackConn);
+				sendBuffers(transportStates, pEntry, ackConn, false);
 		}
 		else if (DEBUG1 >= log_min_messages)
 			write_log("handleAck: not the ack we're looking for (flags 0x%x)...mot(%d) content(%d:%d) srcpid(%d:%d) dstpid(%d) srcport(%d:%d) dstport(%d) sess(%d:%d) cmd(%d:%d)",
@@ -4608,6 +4739,27 @@ handleAcks(ChunkTransportState *transportStates, ChunkTransportStateEntry *pEntr
 	}
 }
 
+/*
+ * packetCRC
+ * 		finish the CRC of a packet whose payload has been accumulated into
+ * 		crc up to the given offset.
+ *
+ * The CRC covers the payload first and the header (with a zero crc field)
+ * last, so that a sender can accumulate the payload while it is being
+ * written into the buffer, see updateXmitCRC().
+ */
+static inline pg_crc32
+packetCRC(icpkthdr *pkt, pg_crc32 crc, int32 offset)
+{
+	Assert(offset >= sizeof(icpkthdr) && offset <= pkt->len);
+
+	COMP_CRC32C(crc, (char *) pkt + offset, pkt->len - offset);
+	COMP_CRC32C(crc, pkt, sizeof(icpkthdr));
+	FIN_CRC32C(crc);
+
+	return crc;
+}
+
 /*
  * addCRC
  * 		add CRC field to the packet.
@@ -4618,10 +4770,7 @@ addCRC(icpkthdr *pkt)
 	pg_crc32	local_crc;
 
 	INIT_CRC32C(local_crc);
-	COMP_CRC32C(local_crc, pkt, pkt->len);
-	FIN_CRC32C(local_crc);
-
-	pkt->crc = local_crc;
+	pkt->crc = packetCRC(pkt, local_crc, sizeof(icpkthdr));
 }
 
 /*
@@ -4637,9 +4786,11 @@ checkCRC(icpkthdr *pkt)
 	rx_crc = pkt->crc;
 	pkt->crc = 0;
 
+	if (pkt->len < sizeof(icpkthdr))
+		return false;
+
 	INIT_CRC32C(local_crc);
-	COMP_CRC32C(local_crc, pkt, pkt->len);
-	FIN_CRC32C(local_crc);
+	local_crc = packetCRC(pkt, local_crc, sizeof(icpkthdr));
 
 	if (rx_crc != local_crc)
 	{
@@ -4649,6 +4800,45 @@ checkCRC(icpkthdr *pkt)
 	return true;
 }
 
+/*
+ * resetXmitCRC
+ * 		restart the running payload CRC of an empty send buffer.
+ */
+static inline void
+resetXmitCRC(MotionConn *conn)
+{
+	INIT_CRC32C(conn->xmitCrc);
+	conn->xmitCrcLen = sizeof(conn->conn_info);
+}
+
+/*
+ * updateXmitCRC
+ * 		fold the bytes added to the send buffer since the last call into
+ * 		the running payload CRC.
+ *
+ * Called right after the data is written, while it is still in cache, so
+ * that prepareXmit() doesn't have to read the whole packet a second time.
+ */
+static inline void
+updateXmitCRC(MotionConn *conn)
+{
+	if (!gp_interconnect_full_crc || conn->msgSize <= conn->xmitCrcLen)
+		return;
+
+	COMP_CRC32C(conn->xmitCrc, conn->pBuff + conn->xmitCrcLen,
+				conn->msgSize - conn->xmitCrcLen);
+	conn->xmitCrcLen = conn->msgSize;
+}
+
+/*
+ * PutDirectBufferUDPIFC
+ * 		account for a tuple serialized directly into the send buffer.
+ */
+static void
+PutDirectBufferUDPIFC(ChunkTransportState *transportStates, MotionConn *conn)
+{
+	updateXmitCRC(conn);
+}
 
 /*
  * prepareXmit
@@ -4671,10 +4861,62 @@ prepareXmit(MotionConn *conn)
 	{
 		icpkthdr   *pkt = (icpkthdr *) conn->pBuff;
 
-		addCRC(pkt);
+		pkt->crc = packetCRC(pkt, conn->xmitCrc, conn->xmitCrcLen);
 	}
 }
 
+/*
+ * handleXmitError
+ * 		Handle the errno of a failed send system call.
+ *
+ * Returns if the packet can simply be dropped (it will be retransmitted),
+ * otherwise reports an ERROR. EINTR is handled by the callers.
+ */
+static bool
+handleXmitError(MotionConn *conn, const char *call)
+{
+	if (errno == EAGAIN)		/* no space ? not an error. */
+		return true;
+
+	/*
+	 * If Linux iptables (nf_conntrack?) drops an outgoing packet, it may
+	 * return an EPERM to the application. This might be simply because of
+	 * traffic shaping or congestion, so ignore it.
+	 */
+	if (errno == EPERM)
+	{
+		ereport(LOG,
+				(errcode(ERRCODE_GP_INTERCONNECTION_ERROR),
+				 errmsg("Interconnect error writing an outgoing packet: %m"),
+				 errdetail("error during %s() for Remote Connection: contentId=%d at %s",
+						   call, conn->remoteContentId, conn->remoteHostAndPort)));
+		return true;
+	}
+
+	/*
+	 * If the OS can detect an MTU issue on the host network interfaces, we 
+	 * would get EMSGSIZE here. So, bail with a HINT about checking MTU.
+	 */
+	if (errno == EMSGSIZE)
+	{
+		ereport(ERROR, (errcode(ERRCODE_GP_INTERCONNECTION_ERROR),
+						errmsg("Interconnect error writing an outgoing packet: %m"),
+						errdetail("error during %s() call (error:%d).\n"
+							  "For Remote Connection: contentId=%d at %s",
+							  call, errno, conn->remoteContentId,
+							  conn->remoteHostAndPort),
+						errhint("check if interface MTU is equal across the cluster and lower than gp_max_packet_size")));
+	}
+
+	ereport(ERROR, (errcode(ERRCODE_GP_INTERCONNECTION_ERROR),
+					errmsg("Interconnect error writing an outgoing packet: %m"),
+					errdetail("error during %s() call (error:%d).\n"
+							  "For Remote Connection: contentId=%d at %s",
+							  call, errno, conn->remoteContentId,
+							  conn->remoteHostAndPort)));
+	return false;				/* not reached */
+}
+
 /*
  * sendOnce
  * 		Send a packet.
@@ -4702,48 +4944,14 @@ xmit_retry:
 		if (errno == EINTR)
 			goto xmit_retry;
 
-		if (errno == EAGAIN)	/* no space ? not an error. */
-			return;
-
-		/*
-		 * If Linux iptables (nf_conntrack?) drops an outgoing packet, it may
-		 * return an EPERM to the application. This might be simply because of
-		 * traffic shaping or congestion, so ignore it.
-		 */
-		if (errno == EPERM)
-		{
-			ereport(LOG,
-					(errcode(ERRCODE_GP_INTERCONNECTION_ERROR),
-					 errmsg("Interconnect error writing an outgoing packet: %m"),
-					 errdetail("error during sendto() for Remote Connection: contentId=%d at %s",
-							   conn->remoteContentId, conn->remoteHostAndPort)));
-			return;
-		}
-
-		/*
-		 * If the OS can detect an MTU issue on the host network interfaces, we 
-		 * would get EMSGSIZE here. So, bail with a HINT about checking MTU.
-		 */
-		if (errno == EMSGSIZE)
-		{
-			ereport(ERROR, (errcode(ERRCODE_GP_INTERCONNECTION_ERROR),
-							errmsg("Interconnect error writing an outgoing packet: %m"),
-							errdetail("error during sendto() call (error:%d).\n"
-								  "For Remote Connection: contentId=%d at %s",
-								  errno, conn->remoteContentId,
-								  conn->remoteHostAndPort),
-							errhint("check if interface MTU is equal across the cluster and lower than gp_max_packet_size")));
-		}
-
-		ereport(ERROR, (errcode(ERRCODE_GP_INTERCONNECTION_ERROR),
-						errmsg("Interconnect error writing an outgoing packet: %m"),
-						errdetail("error during sendto() call (error:%d).\n"
-								  "For Remote Connection: contentId=%d at %s",
-								  errno, conn->remoteContentId,
-								  conn->remoteHostAndPort)));
-		/* not reached */
+		handleXmitError(conn, "sendto");
+		return;
 	}
 
+	pEntry->stat_count_xmit_pkts++;
+	pEntry->stat_count_xmit_syscalls++;
+	ic_statistics.sndSyscallNum++;
+
 	if (n != buf->pkt->len)
 	{
 		if (DEBUG1 >= log_min_messages)
@@ -4759,6 +4967,200 @@ xmit_retry:
 	return;
 }
 
+/*
+ * xmitBatchEnabled
+ * 		Should sendBuffers() batch packets instead of calling sendOnce()?
+ */
+static inline bool
+xmitBatchEnabled(void)
+{
+#ifdef IC_HAVE_MMSG
+	if (gp_interconnect_udp_batch_size <= 1 || ic_control_info.mmsgUnsupported)
+		return false;
+
+#ifdef USE_ASSERT_CHECKING
+	/* the fault injection hooks wrap sendto(), keep them reachable */
+	if (gp_udpic_dropxmit_percent != 0 || gp_udpic_fault_inject_percent != 0)
+		return false;
+#endif
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+/*
+ * queueXmit
+ * 		Add a packet to the transmit batch, flushing it when full.
+ */
+static void
+queueXmit(ChunkTransportState *transportStates, ChunkTransportStateEntry *pEntry, ICBuffer *buf)
+{
+	if (xmit_batch.count > 0 && xmit_batch.pEntry != pEntry)
+		flushXmitBatch(transportStates);
+
+	xmit_batch.pEntry = pEntry;
+	xmit_batch.bufs[xmit_batch.count++] = buf;
+
+	if (xmit_batch.count >= Min(gp_interconnect_udp_batch_size, GP_INTERCONNECT_UDP_MAX_BATCH_SIZE))
+		flushXmitBatch(transportStates);
+}
+
+/*
+ * flushXmitBatch
+ * 		Send all packets in the transmit batch.
+ *
+ * The packets are passed to sendmmsg(). With gp_interconnect_udp_gso, runs
+ * of packets to the same peer whose lengths are equal (except for the last
+ * one) are merged into one message carrying a UDP_SEGMENT size, which the
+ * kernel or the NIC splits back into one datagram per packet.
+ *
+ * Errors are treated like in sendOnce(): packets the kernel has no room for
+ * are left to the retransmission logic.
+ */
+static void
+flushXmitBatch(ChunkTransportState *transportStates)
+{
+#ifdef IC_HAVE_MMSG
+	ChunkTransportStateEntry *pEntry = xmit_batch.pEntry;
+	int			count = xmit_batch.count;
+	struct mmsghdr msgs[GP_INTERCONNECT_UDP_MAX_BATCH_SIZE];
+	struct iovec iovs[GP_INTERCONNECT_UDP_MAX_BATCH_SIZE];
+	int			firstBuf[GP_INTERCONNECT_UDP_MAX_BATCH_SIZE + 1];
+#ifdef IC_HAVE_UDP_GSO
+	char		control[GP_INTERCONNECT_UDP_MAX_BATCH_SIZE][CMSG_SPACE(sizeof(uint16))];
+#endif
+	bool		useGso;
+	int			start = 0;
+	int			nmsgs;
+	int			sent;
+	int			save_errno;
+	int			i;
+
+	/* reset first, an ERROR below must not leave stale buffers behind */
+	xmit_batch.count = 0;
+	xmit_batch.pEntry = NULL;
+
+	if (count == 0)
+		return;
+
+	for (i = 0; i < count; i++)
+	{
+		iovs[i].iov_base = xmit_batch.bufs[i]->pkt;
+		iovs[i].iov_len = xmit_batch.bufs[i]->pkt->len;
+	}
+
+rebuild:
+#ifdef IC_HAVE_UDP_GSO
+	useGso = gp_interconnect_udp_gso && !ic_control_info.udpGsoUnsupported;
+#else
+	useGso = false;
+#endif
+
+	/* build the messages, firstBuf[m] is the first packet of message m */
+	nmsgs = 0;
+	i = start;
+	while (i < count)
+	{
+		MotionConn *conn = xmit_batch.bufs[i]->conn;
+		struct msghdr *hdr = &msgs[nmsgs].msg_hdr;
+		size_t		segSize = iovs[i].iov_len;
+		size_t		total = segSize;
+		int			nsegs = 1;
+
+		if (useGso)
+		{
+			while (i + nsegs < count &&
+				   nsegs < IC_UDP_GSO_MAX_SEGMENTS &&
+				   xmit_batch.bufs[i + nsegs]->conn == conn &&
+				   iovs[i + nsegs - 1].iov_len == segSize &&
+				   iovs[i + nsegs].iov_len <= segSize &&
+				   total + iovs[i + nsegs].iov_len <= IC_UDP_GSO_MAX_BYTES)
+			{
+				total += iovs[i + nsegs].iov_len;
+				nsegs++;
+			}
+		}
+
+		memset(hdr, 0, sizeof(*hdr));
+		hdr->msg_name = &conn->peer;
+		hdr->msg_namelen = conn->peer_len;
+		hdr->msg_iov = &iovs[i];
+		hdr->msg_iovlen = nsegs;
+
+#ifdef IC_HAVE_UDP_GSO
+		if (nsegs > 1)
+		{
+			struct cmsghdr *cmsg;
+
+			hdr->msg_control = control[nmsgs];
+			hdr->msg_controllen = sizeof(control[nmsgs]);
+			cmsg = CMSG_FIRSTHDR(hdr);
+			cmsg->cmsg_level = SOL_UDP;
+			cmsg->cmsg_type = UDP_SEGMENT;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(uint16));
+			*(uint16 *) CMSG_DATA(cmsg) = (uint16) segSize;
+		}
+#endif
+
+		firstBuf[nmsgs++] = i;
+		i += nsegs;
+	}
+	firstBuf[nmsgs] = count;
+
+	sent = 0;
+	while (sent < nmsgs)
+	{
+		int			n;
+
+		n = sendmmsg(pEntry->txfd, &msgs[sent], nmsgs - sent, 0);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			if (errno == ENOSYS)
+			{
+				/* no sendmmsg() in this kernel, send the rest one by one */
+				ic_control_info.mmsgUnsupported = true;
+				for (i = firstBuf[sent]; i < count; i++)
+					sendOnce(transportStates, pEntry, xmit_batch.bufs[i], xmit_batch.bufs[i]->conn);
+				return;
+			}
+
+			if (useGso && (errno == EINVAL || errno == EIO))
+			{
+				/*
+				 * The kernel or the device cannot segment these packets,
+				 * typically because gp_max_packet_size exceeds the MTU or
+				 * checksum offload is off. Resend without UDP_SEGMENT.
+				 */
+				elog(LOG, "UDP_SEGMENT send failed, disabling gp_interconnect_udp_gso for this session: %m");
+				ic_control_info.udpGsoUnsupported = true;
+				start = firstBuf[sent];
+				goto rebuild;
+			}
+
+			save_errno = errno;
+			if (handleXmitError(xmit_batch.bufs[firstBuf[sent]]->conn, "sendmmsg"))
+			{
+				if (save_errno == EAGAIN)
+					break;
+				/* skip the rejected message, try the rest */
+				sent++;
+			}
+			continue;
+		}
+
+		pEntry->stat_count_xmit_pkts += firstBuf[sent + n] - firstBuf[sent];
+		pEntry->stat_count_xmit_syscalls++;
+		ic_statistics.sndSyscallNum++;
+		sent += n;
+	}
+#endif
+}
+
 
 /*
  * handleStopMsgs
@@ -4797,6 +5199,7 @@ handleStopMsgs(ChunkTransportState *transportStates, ChunkTransportStateEntry *p
 			/* mark buffer empty */
 			conn->tupleCount = 0;
 			conn->msgSize = sizeof(conn->conn_info);
+			resetXmitCRC(conn);
 
 			/* now send our stop-ack EOS */
 			conn->conn_info.flags |= UDPIC_FLAGS_EOS;
@@ -4821,6 +5224,7 @@ handleStopMsgs(ChunkTransportState *transportStates, ChunkTransportStateEntry *p
 
 			conn->tupleCount = 0;
 			conn->msgSize = sizeof(conn->conn_info);
+			resetXmitCRC(conn);
 
 			conn->state = mcsEosSent;
 			conn->curBuff = NULL;
@@ -4864,10 +5268,17 @@ handleStopMsgs(ChunkTransportState *transportStates, ChunkTransportStateEntry *p
  *
  * After sending a buffer, the buffer will be placed into both the unack queue and
  * the corresponding queue in the unack queue ring.
+ *
+ * If batching is enabled, the buffers are collected in xmit_batch and only
+ * passed to the kernel when flush is true or the batch is full, so callers
+ * handling many connections in a row can send all of them with one system
+ * call. Such callers must call flushXmitBatch() when they are done.
  */
 static void
-sendBuffers(ChunkTransportState *transportStates, ChunkTransportStateEntry *pEntry, MotionConn *conn)
+sendBuffers(ChunkTransportState *transportStates, ChunkTransportStateEntry *pEntry, MotionConn *conn, bool flush)
 {
+	bool		batch = xmitBatchEnabled();
+
 	while (conn->capacity > 0 && icBufferListLength(&conn->sndQueue) > 0)
 	{
 		ICBuffer   *buf = NULL;
@@ -4917,7 +5328,10 @@ sendBuffers(ChunkTransportState *transportStates, ChunkTransportStateEntry *pEnt
 		updateStats(TPE_DATA_PKT_SEND, conn, buf->pkt);
 #endif
 
-		sendOnce(transportStates, pEntry, buf, conn);
+		if (batch)
+			queueXmit(transportStates, pEntry, buf);
+		else
+			sendOnce(transportStates, pEntry, buf, conn);
 		ic_statistics.sndPktNum++;
 
 #ifdef AMS_VERBOSE_LOGGING
@@ -4926,6 +5340,9 @@ sendBuffers(ChunkTransportState *transportStates, ChunkTransportStateEntry *pEnt
 
 		buf->conn->sentSeq = buf->pkt->seq;
 	}
+
+	if (flush)
+		flushXmitBatch(transportStates);
 }
 
 /*
@@ -5578,6 +5995,7 @@ SendChunkUDPIFC(ChunkTransportState *transportStates,
 	{
 		memcpy(conn->pBuff + conn->msgSize, tcItem->chunk_data, tcItem->chunk_length);
 		conn->msgSize += length;
+		updateXmitCRC(conn);
 
 		conn->tupleCount++;
 		return true;
@@ -5593,7 +6011,7 @@ SendChunkUDPIFC(ChunkTransportState *transportStates,
 	prepareXmit(conn);
 
 	icBufferListAppend(&conn->sndQueue, conn->curBuff);
-	sendBuffers(transportStates, pEntry, conn);
+	sendBuffers(transportStates, pEntry, conn, true);
 
 	uint64		now = getCurrentTime();
 
@@ -5644,10 +6062,12 @@ SendChunkUDPIFC(ChunkTransportState *transportStates,
 	/* reinitialize connection */
 	conn->tupleCount = 0;
 	conn->msgSize = sizeof(conn->conn_info);
+	resetXmitCRC(conn);
 
 	/* now we can copy the input to the new buffer */
 	memcpy(conn->pBuff + conn->msgSize, tcItem->chunk_data, tcItem->chunk_length);
 	conn->msgSize += length;
+	updateXmitCRC(conn);
 
 	conn->tupleCount++;
 
@@ -5725,10 +6145,11 @@ SendEosUDPIFC(ChunkTransportState *transportStates,
 
 			/* place it into the send queue */
 			icBufferListAppend(&conn->sndQueue, conn->curBuff);
-			sendBuffers(transportStates, pEntry, conn);
+			sendBuffers(transportStates, pEntry, conn, true);
 
 			conn->tupleCount = 0;
 			conn->msgSize = sizeof(conn->conn_info);
+			resetXmitCRC(conn);
 			conn->curBuff = NULL;
 			conn->deadlockCheckBeginTime = now;
 
@@ -6352,12 +6773,28 @@ rxThreadFunc(void *arg)
 			/* we've got something interesting to read */
 			/* handle incoming */
 			/* ready to read on our socket */
-			MotionConn *conn = NULL;
 			int			read_count = 0;
 
 			struct sockaddr_storage peer;
 			socklen_t	peerlen;
 
+			if (rxBatchEnabled())
+			{
+				read_count = receiveBatch(&pkt);
+
+				if (pg_atomic_read_u32(&ic_control_info.shutdown) == 1)
+				{
+					if (DEBUG1 >= log_min_messages)
+					{
+						write_log("udp-ic: rx-thread shutting down");
+					}
+					break;
+				}
+
+				skip_poll = (read_count > 0);
+				continue;
+			}
+
 			peerlen = sizeof(peer);
 			read_count = recvfrom(UDP_listenerFd, (char *) pkt, Gp_max_packet_size, 0,
 								  (struct sockaddr *) &peer, &peerlen);
@@ -6395,6 +6832,8 @@ rxThreadFunc(void *arg)
 				continue;
 			}
 
+			ic_statistics.recvSyscallNum++;
+
 			if (read_count < sizeof(icpkthdr))
 			{
 				if (DEBUG1 >= log_min_messages)
@@ -6408,113 +6847,351 @@ rxThreadFunc(void *arg)
 			 */
 			skip_poll = true;
 
-			/* length must be >= 0 */
-			if (pkt->len < 0)
+			if (processRxPacket(pkt, read_count, &peer, peerlen))
+				pkt = NULL;
+		}
+
+		/* pthread_yield(); */
+	}
+
+	/* Before return, we release the packet. */
+	if (pkt)
+	{
+		pthread_mutex_lock(&ic_control_info.lock);
+		freeRxBuffer(&rx_buffer_pool, pkt);
+		pkt = NULL;
+		pthread_mutex_unlock(&ic_control_info.lock);
+	}
+
+	freeRxBatch();
+
+	/* nothing to return */
+	return NULL;
+}
+
+/*
+ * processRxPacket
+ * 		Validate and dispatch one packet received by the rx thread.
+ *
+ * Returns true if the packet was handed over to a connection (or the startup
+ * cache), in which case the caller must not reuse the buffer.
+ *
+ * NOTE: This function MUST NOT contain elog or ereport statements.
+ */
+static bool
+processRxPacket(icpkthdr *pkt, int read_count, struct sockaddr_storage *peer, socklen_t peerlen)
+{
+	MotionConn *conn = NULL;
+	bool		consumed = false;
+	bool		wakeup_mainthread = false;
+	AckSendParam param;
+
+	/* length must be >= 0 */
+	if (pkt->len < 0)
+	{
+		if (DEBUG3 >= log_min_messages)
+			write_log("received inbound with negative length");
+		return false;
+	}
+
+	if (pkt->len != read_count)
+	{
+		if (DEBUG3 >= log_min_messages)
+			write_log("received inbound packet [%d], short: read %d bytes, pkt->len %d", pkt->seq, read_count, pkt->len);
+		return false;
+	}
+
+	/*
+	 * check the CRC of the payload.
+	 */
+	if (gp_interconnect_full_crc)
+	{
+		if (!checkCRC(pkt))
+		{
+			pg_atomic_add_fetch_u32((pg_atomic_uint32 *) &ic_statistics.crcErrors, 1);
+			if (DEBUG2 >= log_min_messages)
+				write_log("received network data error, dropping bad packet, user data unaffected.");
+			return false;
+		}
+	}
+
+#ifdef AMS_VERBOSE_LOGGING
+	logPkt("GOT MESSAGE", pkt);
+#endif
+
+	memset(&param, 0, sizeof(AckSendParam));
+
+	/*
+	 * Get the connection for the pkt.
+	 *
+	 * The connection hash table should be locked until finishing the
+	 * processing of the packet to avoid the connection addition/removal from
+	 * the hash table during the mean time.
+	 */
+
+	pthread_mutex_lock(&ic_control_info.lock);
+	conn = findConnByHeader(&ic_control_info.connHtab, pkt);
+
+	if (conn != NULL)
+	{
+		/* Handling a regular packet */
+		consumed = handleDataPacket(conn, pkt, peer, &peerlen, &param, &wakeup_mainthread);
+		ic_statistics.recvPktNum++;
+	}
+	else
+	{
+		/*
+		 * There may have two kinds of Mismatched packets: a) Past packets
+		 * from previous command after I was torn down b) Future packets from
+		 * current command before my connections are built.
+		 *
+		 * The handling logic is to "Ack the past and Nak the future".
+		 */
+		if ((pkt->flags & UDPIC_FLAGS_RECEIVER_TO_SENDER) == 0)
+		{
+			if (DEBUG1 >= log_min_messages)
+				write_log("mismatched packet received, seq %d, srcpid %d, dstpid %d, icid %d, sid %d", pkt->seq, pkt->srcPid, pkt->dstPid, pkt->icId, pkt->sessionId);
+
+#ifdef AMS_VERBOSE_LOGGING
+			logPkt("Got a Mismatched Packet", pkt);
+#endif
+
+			consumed = handleMismatch(pkt, peer, peerlen);
+			ic_statistics.mismatchNum++;
+		}
+	}
+	pthread_mutex_unlock(&ic_control_info.lock);
+
+	if (wakeup_mainthread)
+		SetLatch(&ic_control_info.latch);
+
+	/*
+	 * real ack sending is after lock release to decrease the lock holding
+	 * time.
+	 */
+	if (param.msg.len != 0)
+		sendAckWithParam(&param);
+
+	return consumed;
+}
+
+/*
+ * rxBatchEnabled
+ * 		Should the rx thread receive with recvmmsg()?
+ *
+ * Once UDP_GRO is on, the socket may return coalesced datagrams that only
+ * receiveBatch() knows how to split, so it must always be used.
+ */
+static inline bool
+rxBatchEnabled(void)
+{
+#ifdef IC_HAVE_MMSG
+	if (ic_control_info.udpGroEnabled)
+		return true;
+
+	if (gp_interconnect_udp_batch_size <= 1)
+		return false;
+
+#ifdef USE_ASSERT_CHECKING
+	/* the fault injection hooks wrap recvfrom(), keep them reachable */
+	if (gp_udpic_fault_inject_percent != 0)
+		return false;
+#endif
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+/*
+ * receiveBatch
+ * 		Receive and process up to gp_interconnect_udp_batch_size packets with
+ * 		one recvmmsg() call.
+ *
+ * *pktp is the rx buffer held by the rx thread, it may be NULL on return.
+ *
+ * Packets are received into the staging buffers of rx_batch, so the number
+ * of rx buffers taken from rx_buffer_pool is the same as on the recvfrom()
+ * path. Without UDP_GRO, a staging buffer handed over to a connection is
+ * simply swapped with an rx buffer; both are Gp_max_packet_size bytes from
+ * malloc(). With UDP_GRO, a staging buffer may hold several datagrams from
+ * the same peer, each of the size given by the UDP_GRO control message
+ * except the last one, which are copied out one by one.
+ *
+ * Returns the recvmmsg() result.
+ *
+ * NOTE: This function MUST NOT contain elog or ereport statements.
+ */
+static int
+receiveBatch(icpkthdr **pktp)
+{
+#ifdef IC_HAVE_MMSG
+	bool		gro = ic_control_info.udpGroEnabled;
+	int			nbufs;
+	int			n;
+	int			i;
+
+	nbufs = Min(Max(gp_interconnect_udp_batch_size, 1), GP_INTERCONNECT_UDP_MAX_BATCH_SIZE);
+	if (gro)
+		nbufs = Min(nbufs, IC_UDP_GRO_MAX_BATCH);
+
+	/* allocate staging buffers the first time they are needed */
+	if (rx_batch.count == 0)
+		rx_batch.bufSize = gro ? IC_UDP_GRO_BUFFER_SIZE : Gp_max_packet_size;
+	while (rx_batch.count < nbufs)
+	{
+		icpkthdr   *buf = (icpkthdr *) malloc(rx_batch.bufSize);
+
+		if (buf == NULL)
+			break;
+		rx_batch.bufs[rx_batch.count++] = buf;
+	}
+	nbufs = Min(nbufs, rx_batch.count);
+
+	if (nbufs == 0)
+	{
+		setRxThreadError(ENOMEM);
+		return -1;
+	}
+
+	for (i = 0; i < nbufs; i++)
+	{
+		struct msghdr *hdr = &rx_batch.msgs[i].msg_hdr;
+
+		rx_batch.iovs[i].iov_base = rx_batch.bufs[i];
+		rx_batch.iovs[i].iov_len = rx_batch.bufSize;
+
+		memset(hdr, 0, sizeof(*hdr));
+		hdr->msg_name = &rx_batch.peers[i];
+		hdr->msg_namelen = sizeof(rx_batch.peers[i]);
+		hdr->msg_iov = &rx_batch.iovs[i];
+		hdr->msg_iovlen = 1;
+		if (gro)
+		{
+			hdr->msg_control = rx_batch.control[i];
+			hdr->msg_controllen = sizeof(rx_batch.control[i]);
+		}
+	}
+
+	n = recvmmsg(UDP_listenerFd, rx_batch.msgs, nbufs, 0, NULL);
+
+	if (DEBUG5 >= log_min_messages)
+		write_log("received inbound batch of %d", n);
+
+	if (n < 0)
+	{
+		if (errno == EWOULDBLOCK || errno == EINTR)
+			return n;
+
+		write_log("Interconnect error: recvmmsg (%d)", errno);
+
+		/* let main thread report the error, see rxThreadFunc() */
+		setRxThreadError(errno);
+		return n;
+	}
+
+	ic_statistics.recvSyscallNum++;
+
+	for (i = 0; i < n; i++)
+	{
+		struct msghdr *hdr = &rx_batch.msgs[i].msg_hdr;
+		char	   *data = (char *) rx_batch.bufs[i];
+		int			len = rx_batch.msgs[i].msg_len;
+		int			segSize = len;
+		int			off;
+
+#ifdef IC_HAVE_UDP_GRO
+		if (gro)
+		{
+			struct cmsghdr *cmsg;
+
+			for (cmsg = CMSG_FIRSTHDR(hdr); cmsg != NULL; cmsg = CMSG_NXTHDR(hdr, cmsg))
 			{
-				if (DEBUG3 >= log_min_messages)
-					write_log("received inbound with negative length");
+				if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+				{
+					segSize = *(int *) CMSG_DATA(cmsg);
+					break;
+				}
+			}
+		}
+#endif
+
+		if (segSize <= 0)
+			continue;
+
+		for (off = 0; off < len; off += segSize)
+		{
+			int			read_count = Min(segSize, len - off);
+			icpkthdr   *pkt;
+
+			if (read_count < sizeof(icpkthdr))
+			{
+				if (DEBUG1 >= log_min_messages)
+					write_log("Interconnect error: short conn receive (%d)", read_count);
 				continue;
 			}
 
-			if (pkt->len != read_count)
+			if (read_count > Gp_max_packet_size)
 			{
 				if (DEBUG3 >= log_min_messages)
-					write_log("received inbound packet [%d], short: read %d bytes, pkt->len %d", pkt->seq, read_count, pkt->len);
+					write_log("received inbound packet larger than gp_max_packet_size (%d)", read_count);
 				continue;
 			}
 
-			/*
-			 * check the CRC of the payload.
-			 */
-			if (gp_interconnect_full_crc)
+			if (*pktp == NULL)
 			{
-				if (!checkCRC(pkt))
+				pthread_mutex_lock(&ic_control_info.lock);
+				*pktp = getRxBuffer(&rx_buffer_pool);
+				pthread_mutex_unlock(&ic_control_info.lock);
+
+				if (*pktp == NULL)
 				{
-					pg_atomic_add_fetch_u32((pg_atomic_uint32 *) &ic_statistics.crcErrors, 1);
-					if (DEBUG2 >= log_min_messages)
-						write_log("received network data error, dropping bad packet, user data unaffected.");
-					continue;
+					/* the rest of the batch is lost, like in rxThreadFunc() */
+					setRxThreadError(ENOMEM);
+					return n;
 				}
 			}
 
-#ifdef AMS_VERBOSE_LOGGING
-			logPkt("GOT MESSAGE", pkt);
-#endif
-
-			bool		wakeup_mainthread = false;
-			AckSendParam param;
-
-			memset(&param, 0, sizeof(AckSendParam));
-
-			/*
-			 * Get the connection for the pkt.
-			 *
-			 * The connection hash table should be locked until finishing the
-			 * processing of the packet to avoid the connection
-			 * addition/removal from the hash table during the mean time.
-			 */
-
-			pthread_mutex_lock(&ic_control_info.lock);
-			conn = findConnByHeader(&ic_control_info.connHtab, pkt);
-
-			if (conn != NULL)
+			if (gro)
 			{
-				/* Handling a regular packet */
-				if (handleDataPacket(conn, pkt, &peer, &peerlen, &param, &wakeup_mainthread))
-					pkt = NULL;
-				ic_statistics.recvPktNum++;
+				pkt = *pktp;
+				memcpy(pkt, data + off, read_count);
+				if (processRxPacket(pkt, read_count, (struct sockaddr_storage *) hdr->msg_name, hdr->msg_namelen))
+					*pktp = NULL;
 			}
 			else
 			{
-				/*
-				 * There may have two kinds of Mismatched packets: a) Past
-				 * packets from previous command after I was torn down b)
-				 * Future packets from current command before my connections
-				 * are built.
-				 *
-				 * The handling logic is to "Ack the past and Nak the future".
-				 */
-				if ((pkt->flags & UDPIC_FLAGS_RECEIVER_TO_SENDER) == 0)
+				pkt = rx_batch.bufs[i];
+				if (processRxPacket(pkt, read_count, (struct sockaddr_storage *) hdr->msg_name, hdr->msg_namelen))
 				{
-					if (DEBUG1 >= log_min_messages)
-						write_log("mismatched packet received, seq %d, srcpid %d, dstpid %d, icid %d, sid %d", pkt->seq, pkt->srcPid, pkt->dstPid, pkt->icId, pkt->sessionId);
-
-#ifdef AMS_VERBOSE_LOGGING
-					logPkt("Got a Mismatched Packet", pkt);
-#endif
-
-					if (handleMismatch(pkt, &peer, peerlen))
-						pkt = NULL;
-					ic_statistics.mismatchNum++;
+					rx_batch.bufs[i] = *pktp;
+					*pktp = NULL;
 				}
 			}
-			pthread_mutex_unlock(&ic_control_info.lock);
-
-			if (wakeup_mainthread)
-				SetLatch(&ic_control_info.latch);
-
-			/*
-			 * real ack sending is after lock release to decrease the lock
-			 * holding time.
-			 */
-			if (param.msg.len != 0)
-				sendAckWithParam(&param);
 		}
-
-		/* pthread_yield(); */
 	}
 
-	/* Before return, we release the packet. */
-	if (pkt)
-	{
-		pthread_mutex_lock(&ic_control_info.lock);
-		freeRxBuffer(&rx_buffer_pool, pkt);
-		pkt = NULL;
-		pthread_mutex_unlock(&ic_control_info.lock);
-	}
+	return n;
+#else
+	return -1;
+#endif
+}
 
-	/* nothing to return */
-	return NULL;
+/*
+ * freeRxBatch
+ * 		Release the staging buffers of the rx thread.
+ */
+static void
+freeRxBatch(void)
+{
+#ifdef IC_HAVE_MMSG
+	int			i;
+
+	for (i = 0; i < rx_batch.count; i++)
+		free(rx_batch.bufs[i]);
+	rx_batch.count = 0;
+#endif
 }
 
 /*
@@ -0,0 +1,162 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include "cmockery.h"
+
+#include "../ic_udpifc.c"
+
+/*
+ * The slicing-by-8 implementation is the reference for the CRC-32C
+ * implementations the build selected. Compile our own copy of it under
+ * another name, as the build may not have it in libpgport.
+ */
+#define pg_comp_crc32c_sb8 reference_comp_crc32c_sb8
+#include "../../../../port/pg_crc32c_sb8.c"
+#undef pg_comp_crc32c_sb8
+
+#define TEST_BUFSIZE (4 * 3 * 2048 + 64)
+
+static unsigned char test_buf[TEST_BUFSIZE];
+
+static void
+fill_test_buf(void)
+{
+	uint32		x = 12345;
+	int			i;
+
+	for (i = 0; i < TEST_BUFSIZE; i++)
+	{
+		x = x * 1103515245 + 12345;
+		test_buf[i] = (unsigned char) (x >> 16);
+	}
+}
+
+static pg_crc32c
+reference_crc(const void *data, size_t len)
+{
+	pg_crc32c	crc;
+
+	INIT_CRC32C(crc);
+	crc = reference_comp_crc32c_sb8(crc, data, len);
+	FIN_CRC32C(crc);
+
+	return crc;
+}
+
+/*
+ * Lengths around the stream sizes of the PCLMUL variant, at all alignments.
+ */
+static void
+check_against_reference(pg_crc32c (*comp) (pg_crc32c, const void *, size_t))
+{
+	int			len;
+	int			offset;
+
+	for (len = 0; len <= TEST_BUFSIZE - 8; len += (len < 1024 ? 1 : 61))
+	{
+		for (offset = 0; offset < 8; offset++)
+		{
+			pg_crc32c	crc;
+
+			INIT_CRC32C(crc);
+			crc = comp(crc, test_buf + offset, len);
+			FIN_CRC32C(crc);
+
+			assert_int_equal(crc, reference_crc(test_buf + offset, len));
+		}
+	}
+}
+
+static pg_crc32c
+comp_crc32c_selected(pg_crc32c crc, const void *data, size_t len)
+{
+	COMP_CRC32C(crc, data, len);
+	return crc;
+}
+
+static void
+test__crc32c__check_value(void **state)
+{
+	pg_crc32c	crc;
+
+	INIT_CRC32C(crc);
+	COMP_CRC32C(crc, "123456789", 9);
+	FIN_CRC32C(crc);
+
+	assert_int_equal(crc, 0xe3069283);
+	assert_int_equal(reference_crc("123456789", 9), 0xe3069283);
+}
+
+static void
+test__crc32c__matches_sb8(void **state)
+{
+	check_against_reference(comp_crc32c_selected);
+
+#ifdef USE_SSE42_CRC32C_PCLMUL
+	if (__builtin_cpu_supports("sse4.2"))
+		check_against_reference(pg_comp_crc32c_sse42);
+	if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul"))
+		check_against_reference(pg_comp_crc32c_sse42_pclmul);
+#endif
+}
+
+/*
+ * The running payload CRC that the sender keeps while it fills a packet
+ * must give the same CRC as computing it over the whole packet.
+ */
+static void
+test__updateXmitCRC__matches_checkCRC(void **state)
+{
+	MotionConn	conn;
+	icpkthdr   *pkt;
+	uint32		crc;
+	int			pieces[] = {1, 7, 100, 3000, 24, 5000};
+	int			i;
+
+	gp_interconnect_full_crc = true;
+
+	memset(&conn, 0, sizeof(conn));
+	conn.pBuff = palloc0(TEST_BUFSIZE + sizeof(icpkthdr));
+	conn.conn_info.motNodeId = 1;
+	conn.conn_info.seq = 42;
+	conn.msgSize = sizeof(icpkthdr);
+	resetXmitCRC(&conn);
+
+	for (i = 0; i < lengthof(pieces); i++)
+	{
+		memcpy(conn.pBuff + conn.msgSize, test_buf + i, pieces[i]);
+		conn.msgSize += pieces[i];
+		updateXmitCRC(&conn);
+	}
+
+	prepareXmit(&conn);
+
+	pkt = (icpkthdr *) conn.pBuff;
+	crc = pkt->crc;
+	assert_int_equal(pkt->len, conn.msgSize);
+	assert_true(checkCRC(pkt));
+
+	/* a flipped bit is caught; checkCRC() zeroes the crc field */
+	pkt->crc = crc;
+	conn.pBuff[sizeof(icpkthdr) + 200] ^= 0x10;
+	assert_false(checkCRC(pkt));
+
+	pfree(conn.pBuff);
+}
+
+int
+main(int argc, char *argv[])
+{
+	cmockery_parse_arguments(argc, argv);
+
+	const		UnitTest tests[] = {
+		unit_test(test__crc32c__check_value),
+		unit_test(test__crc32c__matches_sb8),
+		unit_test(test__updateXmitCRC__matches_checkCRC)
+	};
+
+	MemoryContextInit();
+	fill_test_buf();
+
+	return run_tests(tests);
+}
@@ -69,6 +69,28 @@ static void addByteStringToChunkList(TupleChunkList tcList, char *data, int data
 	} while (0)
 
 
+/*
+ * The columnar chunk format (TC_COLUMNAR).
+ *
+ * Tuples whose attributes all have fixed-width types, typically the output
+ * of a partial aggregate, can be sent in batches instead of one by one. A
+ * batch is a single chunk that holds a ColumnarHeader, followed by each
+ * attribute in turn: its null bitmap, if it has NULLs in this batch, and
+ * then attlen bytes for each row. Both arrays are padded to
+ * TUPLE_CHUNK_ALIGN. Narrow tuples save the per-tuple headers and the
+ * alignment padding of the row format this way.
+ */
+typedef struct ColumnarHeader
+{
+	uint16		nrows;
+	uint16		natts;
+	uint32		nullatts;		/* bit i set if attribute i has a bitmap */
+} ColumnarHeader;
+
+#define COLUMNAR_MAX_ATTS	32
+
+static int	columnarChunkLength(SerTupInfo *pSerInfo, int nrows, uint32 nullatts);
+
 static inline void
 addPadding(TupleChunkList tcList, TupleChunkListCache *cache, int size)
 {
@@ -180,6 +202,39 @@ InitSerTupInfo(TupleDesc tupdesc, SerTupInfo *pSerInfo)
 			ReleaseSysCache(typeTuple);
 		}
 	}
+
+	/*
+	 * Tuples that only have fixed-width attributes can be sent in the
+	 * columnar format. Work out how many of them fit into one chunk.
+	 */
+	if (!pSerInfo->has_record_types && !tupdesc->tdhasoid &&
+		numAttrs <= COLUMNAR_MAX_ATTS)
+	{
+		int			rowwidth = 0;
+
+		for (i = 0; i < numAttrs; i++)
+		{
+			if (tupdesc->attrs[i]->attisdropped ||
+				pSerInfo->myinfo[i].typlen <= 0)
+				break;
+			rowwidth += pSerInfo->myinfo[i].typlen;
+		}
+
+		if (i == numAttrs)
+		{
+			int			nrows;
+
+			nrows = Min(PG_UINT16_MAX, Gp_max_tuple_chunk_size / rowwidth);
+			while (nrows > 0 &&
+				   columnarChunkLength(pSerInfo, nrows,
+									   ~(uint32) 0) > Gp_max_tuple_chunk_size)
+				nrows--;
+
+			/* Not worth it if only a few rows fit. */
+			if (nrows >= 8)
+				pSerInfo->columnar_maxrows = nrows;
+		}
+	}
 }
 
 
@@ -602,6 +657,149 @@ SerializeTuple(TupleTableSlot *slot, SerTupInfo *pSerInfo, struct directTranspor
 	return 0;
 }
 
+/*
+ * Length of a TC_COLUMNAR chunk holding nrows rows, including the chunk
+ * header. nullatts tells which attributes have a null bitmap.
+ */
+static int
+columnarChunkLength(SerTupInfo *pSerInfo, int nrows, uint32 nullatts)
+{
+	int			len = TUPLE_CHUNK_HEADER_SIZE + sizeof(ColumnarHeader);
+	int			i;
+
+	for (i = 0; i < pSerInfo->tupdesc->natts; i++)
+	{
+		if (nullatts & (1U << i))
+			len += TYPEALIGN(TUPLE_CHUNK_ALIGN, BITMAPLEN(nrows));
+		len += TYPEALIGN(TUPLE_CHUNK_ALIGN, nrows * pSerInfo->myinfo[i].typlen);
+	}
+
+	return len;
+}
+
+/*
+ * Allocate the arrays of a batch for the columnar format, sized for
+ * columnar_maxrows rows, in the current memory context.
+ */
+void
+InitColumnarBatch(SerTupInfo *pSerInfo, ColumnarBatch *batch)
+{
+	int			natts = pSerInfo->tupdesc->natts;
+	int			maxrows = pSerInfo->columnar_maxrows;
+	int			i;
+
+	Assert(maxrows > 0);
+
+	batch->nrows = 0;
+	batch->nullatts = 0;
+	batch->values = (char **) palloc(natts * sizeof(char *));
+	batch->nullbits = (bits8 **) palloc(natts * sizeof(bits8 *));
+
+	for (i = 0; i < natts; i++)
+	{
+		batch->values[i] = palloc(maxrows * pSerInfo->myinfo[i].typlen);
+		batch->nullbits[i] = palloc0(BITMAPLEN(maxrows));
+	}
+}
+
+/*
+ * Add the tuple in a slot to a batch. Returns true if the batch is full, and
+ * must be sent before another tuple is added.
+ */
+bool
+AddTupleToColumnarBatch(TupleTableSlot *slot, SerTupInfo *pSerInfo, ColumnarBatch *batch)
+{
+	int			natts = pSerInfo->tupdesc->natts;
+	int			row = batch->nrows;
+	Datum	   *values;
+	bool	   *isnull;
+	int			i;
+
+	Assert(row < pSerInfo->columnar_maxrows);
+
+	slot_getallattrs(slot);
+	values = slot_get_values(slot);
+	isnull = slot_get_isnull(slot);
+
+	for (i = 0; i < natts; i++)
+	{
+		SerAttrInfo *attrInfo = &pSerInfo->myinfo[i];
+		char	   *dst = batch->values[i] + row * attrInfo->typlen;
+
+		if (isnull[i])
+		{
+			batch->nullbits[i][row >> 3] &= ~(1 << (row & 0x07));
+			batch->nullatts |= 1U << i;
+			memset(dst, 0, attrInfo->typlen);
+			continue;
+		}
+
+		batch->nullbits[i][row >> 3] |= 1 << (row & 0x07);
+
+		if (attrInfo->typbyval)
+			store_att_byval(dst, values[i], attrInfo->typlen);
+		else
+			memcpy(dst, DatumGetPointer(values[i]), attrInfo->typlen);
+	}
+
+	batch->nrows++;
+
+	return batch->nrows == pSerInfo->columnar_maxrows;
+}
+
+/*
+ * Serialize a batch into a TC_COLUMNAR chunk, and empty the batch.
+ *
+ * The chunk always fits into tcItem, as columnar_maxrows is worked out for
+ * a batch in which every attribute has NULLs.
+ */
+void
+SerializeColumnarBatch(SerTupInfo *pSerInfo, ColumnarBatch *batch, TupleChunkListItem tcItem)
+{
+	int			natts = pSerInfo->tupdesc->natts;
+	int			nrows = batch->nrows;
+	ColumnarHeader hdr;
+	char	   *pos;
+	int			len;
+	int			i;
+
+	Assert(nrows > 0);
+
+	hdr.nrows = nrows;
+	hdr.natts = natts;
+	hdr.nullatts = batch->nullatts;
+
+	pos = (char *) tcItem->chunk_data + TUPLE_CHUNK_HEADER_SIZE;
+	memcpy(pos, &hdr, sizeof(ColumnarHeader));
+	pos += sizeof(ColumnarHeader);
+
+	for (i = 0; i < natts; i++)
+	{
+		if (batch->nullatts & (1U << i))
+		{
+			len = BITMAPLEN(nrows);
+			memcpy(pos, batch->nullbits[i], len);
+			memset(pos + len, 0, TYPEALIGN(TUPLE_CHUNK_ALIGN, len) - len);
+			pos += TYPEALIGN(TUPLE_CHUNK_ALIGN, len);
+		}
+
+		len = nrows * pSerInfo->myinfo[i].typlen;
+		memcpy(pos, batch->values[i], len);
+		memset(pos + len, 0, TYPEALIGN(TUPLE_CHUNK_ALIGN, len) - len);
+		pos += TYPEALIGN(TUPLE_CHUNK_ALIGN, len);
+	}
+
+	tcItem->chunk_length = pos - (char *) tcItem->chunk_data;
+	Assert(tcItem->chunk_length == columnarChunkLength(pSerInfo, nrows, hdr.nullatts));
+	Assert(tcItem->chunk_length <= Gp_max_tuple_chunk_size);
+
+	SetChunkType(tcItem->chunk_data, TC_COLUMNAR);
+	SetChunkDataSize(tcItem->chunk_data, tcItem->chunk_length - TUPLE_CHUNK_HEADER_SIZE);
+
+	batch->nrows = 0;
+	batch->nullatts = 0;
+}
+
 /*
  * Reassemble and deserialize a list of tuple chunks, into a tuple.
  */
@@ -853,3 +1051,131 @@ CvtChunksToTup(TupleChunkList tcList, SerTupInfo *pSerInfo, TupleRemapper *remap
 
 	return tup;
 }
+
+/*
+ * Convert a TC_COLUMNAR chunk into the HeapTuples it holds. The tuples are
+ * returned in a palloc'd array, and their number as the result.
+ */
+int
+CvtColumnarChunkToTups(TupleChunkListItem tcItem, SerTupInfo *pSerInfo, GenericTuple **tups)
+{
+	TupleDesc	tupdesc = pSerInfo->tupdesc;
+	int			natts = tupdesc->natts;
+	const char *pos;
+	const char **values;
+	const bits8 **nullbits;
+	ColumnarHeader hdr;
+	GenericTuple *result;
+	int			row;
+	int			i;
+
+	AssertArg(tcItem != NULL);
+	AssertArg(pSerInfo != NULL);
+
+	pos = (const char *) GetChunkDataPtr(tcItem) + TUPLE_CHUNK_HEADER_SIZE;
+
+	if (tcItem->chunk_length < TUPLE_CHUNK_HEADER_SIZE + sizeof(ColumnarHeader))
+		ereport(ERROR,
+				(errcode(ERRCODE_PROTOCOL_VIOLATION),
+				 errmsg("columnar tuple chunk is too short")));
+
+	memcpy(&hdr, pos, sizeof(ColumnarHeader));
+	pos += sizeof(ColumnarHeader);
+
+	if (pSerInfo->columnar_maxrows == 0 ||
+		hdr.natts != natts || hdr.nrows == 0 ||
+		(natts < COLUMNAR_MAX_ATTS && (hdr.nullatts >> natts) != 0) ||
+		columnarChunkLength(pSerInfo, hdr.nrows, hdr.nullatts) != tcItem->chunk_length)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROTOCOL_VIOLATION),
+				 errmsg("invalid columnar tuple chunk")));
+
+	values = palloc(natts * sizeof(char *));
+	nullbits = palloc(natts * sizeof(bits8 *));
+
+	for (i = 0; i < natts; i++)
+	{
+		nullbits[i] = NULL;
+		if (hdr.nullatts & (1U << i))
+		{
+			nullbits[i] = (const bits8 *) pos;
+			pos += TYPEALIGN(TUPLE_CHUNK_ALIGN, BITMAPLEN(hdr.nrows));
+		}
+
+		values[i] = pos;
+		pos += TYPEALIGN(TUPLE_CHUNK_ALIGN, hdr.nrows * pSerInfo->myinfo[i].typlen);
+	}
+
+	result = palloc(hdr.nrows * sizeof(GenericTuple));
+
+	for (row = 0; row < hdr.nrows; row++)
+	{
+		for (i = 0; i < natts; i++)
+		{
+			SerAttrInfo *attrInfo = &pSerInfo->myinfo[i];
+			const char *src = values[i] + row * attrInfo->typlen;
+
+			if (nullbits[i] != NULL && att_isnull(row, nullbits[i]))
+			{
+				pSerInfo->values[i] = (Datum) 0;
+				pSerInfo->nulls[i] = true;
+				continue;
+			}
+
+			pSerInfo->nulls[i] = false;
+
+			/*
+			 * The arrays are only aligned to TUPLE_CHUNK_ALIGN, so copy
+			 * pass-by-value datums out. heap_form_tuple() copies the others.
+			 */
+			if (attrInfo->typbyval)
+			{
+				Datum		d;
+
+				switch (attrInfo->typlen)
+				{
+					case sizeof(char):
+						d = CharGetDatum(*src);
+						break;
+					case sizeof(int16):
+						{
+							int16		v;
+
+							memcpy(&v, src, sizeof(int16));
+							d = Int16GetDatum(v);
+						}
+						break;
+					case sizeof(int32):
+						{
+							int32		v;
+
+							memcpy(&v, src, sizeof(int32));
+							d = Int32GetDatum(v);
+						}
+						break;
+#if SIZEOF_DATUM == 8
+					case sizeof(Datum):
+						memcpy(&d, src, sizeof(Datum));
+						break;
+#endif
+					default:
+						elog(ERROR, "unsupported byval length: %d",
+							 (int) attrInfo->typlen);
+						d = (Datum) 0;	/* keep compiler quiet */
+				}
+				pSerInfo->values[i] = d;
+			}
+			else
+				pSerInfo->values[i] = PointerGetDatum(src);
+		}
+
+		result[row] = (GenericTuple)
+			heap_form_tuple(tupdesc, pSerInfo->values, pSerInfo->nulls);
+	}
+
+	pfree(values);
+	pfree(nullbits);
+
+	*tups = result;
+	return hdr.nrows;
+}
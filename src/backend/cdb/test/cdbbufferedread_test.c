@@ -84,6 +84,56 @@ test__BufferedReadUseBeforeBuffer__IsNextReadLenZero(void **state)
 	PG_END_TRY();	
 }
 
+static void
+test__BufferedReadPrefetch__SlidesWindow(void **state)
+{
+	BufferedRead *bufferedRead = palloc0(sizeof(BufferedRead));
+
+	bufferedRead->file = 1;
+	bufferedRead->maxLargeReadLen = 100;
+	gp_appendonly_prefetch_depth = 2;
+
+	/* The first read asks for the next two reads. */
+	bufferedRead->largeReadPosition = 0;
+	bufferedRead->largeReadLen = 100;
+	expect_value(FilePrefetch, file, 1);
+	expect_value(FilePrefetch, offset, 100);
+	expect_value(FilePrefetch, amount, 200);
+	will_return(FilePrefetch, 0);
+	BufferedReadPrefetch(bufferedRead, 1000);
+	assert_int_equal(bufferedRead->prefetchPosition, 300);
+
+	/* The following ones only for the read that entered the window. */
+	bufferedRead->largeReadPosition = 100;
+	expect_value(FilePrefetch, file, 1);
+	expect_value(FilePrefetch, offset, 300);
+	expect_value(FilePrefetch, amount, 100);
+	will_return(FilePrefetch, 0);
+	BufferedReadPrefetch(bufferedRead, 1000);
+	assert_int_equal(bufferedRead->prefetchPosition, 400);
+
+	/* Nothing beyond the end of the file. */
+	bufferedRead->largeReadPosition = 300;
+	bufferedRead->largeReadLen = 100;
+	expect_value(FilePrefetch, file, 1);
+	expect_value(FilePrefetch, offset, 400);
+	expect_value(FilePrefetch, amount, 50);
+	will_return(FilePrefetch, 0);
+	BufferedReadPrefetch(bufferedRead, 450);
+	assert_int_equal(bufferedRead->prefetchPosition, 450);
+
+	bufferedRead->largeReadPosition = 400;
+	bufferedRead->largeReadLen = 50;
+	BufferedReadPrefetch(bufferedRead, 450);
+
+	/* Disabled. */
+	gp_appendonly_prefetch_depth = 0;
+	bufferedRead->largeReadPosition = 0;
+	bufferedRead->prefetchPosition = 0;
+	BufferedReadPrefetch(bufferedRead, 1000);
+	assert_int_equal(bufferedRead->prefetchPosition, 0);
+}
+
 int
 main(int argc, char* argv[])
 {
@@ -91,7 +141,8 @@ main(int argc, char* argv[])
 
 	const UnitTest tests[] = {
 		unit_test(test__BufferedReadUseBeforeBuffer__IsNextReadLenZero),
-		unit_test(test__BufferedReadInit__IsConsistent)
+		unit_test(test__BufferedReadInit__IsConsistent),
+		unit_test(test__BufferedReadPrefetch__SlidesWindow)
 	};
 
 	MemoryContextInit();
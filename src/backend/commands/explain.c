@@ -2160,6 +2160,8 @@ ExplainNode(PlanState *planstate, List *ancestors,
 									 pMotion->sortColIdx,
 									 "Merge Key",
 									 ancestors, es);
+				if (pMotion->skewMode != MOTIONSKEW_NONE)
+					show_motion_skew_keys(planstate, ancestors, es);
 			}
 			break;
 		case T_AssertOp:
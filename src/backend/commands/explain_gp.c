@@ -349,6 +349,8 @@ static int cdbexplain_collectExtraText(PlanState *planstate,
 									   StringInfo notebuf);
 static int cdbexplain_countLeafPartTables(PlanState *planstate);
 
+static void show_motion_skew_keys(PlanState *planstate, List *ancestors,
+								  ExplainState *es);
 static void show_motion_keys(PlanState *planstate, List *hashExpr, int nkeys,
 							 AttrNumber *keycols, const char *qlabel,
 							 List *ancestors, ExplainState *es);
@@ -1625,6 +1627,48 @@ cdbexplain_showExecStats(struct PlanState *planstate, ExplainState *es)
 		}
 	}
 
+	/*
+	 * Rows received by each segment from a redistributing Motion, to show
+	 * how evenly the hash key spread them.
+	 */
+	if (es->analyze && es->verbose && planstate->type == T_MotionState &&
+		((Motion *) planstate->plan)->motionType == MOTIONTYPE_HASH &&
+		ns->segindex0 >= 0 && ns->ninst > 1)
+	{
+		if (es->format == EXPLAIN_FORMAT_TEXT)
+		{
+			bool		first = true;
+
+			appendStringInfoSpaces(es->str, es->indent * 2);
+			appendStringInfoString(es->str, "Rows per segment: ");
+			for (i = 0; i < ns->ninst; i++)
+			{
+				if (INSTR_TIME_IS_ZERO(ns->insts[i].firststart))
+					continue;
+				appendStringInfo(es->str, "%s%.0f (seg%d)",
+								 first ? "" : ", ",
+								 ns->insts[i].ntuples,
+								 ns->segindex0 + i);
+				first = false;
+			}
+			appendStringInfoChar(es->str, '\n');
+		}
+		else
+		{
+			ExplainOpenGroup("Rows Per Segment", "Rows Per Segment", false, es);
+			for (i = 0; i < ns->ninst; i++)
+			{
+				if (INSTR_TIME_IS_ZERO(ns->insts[i].firststart))
+					continue;
+				ExplainOpenGroup("Segment", NULL, true, es);
+				ExplainPropertyInteger("Segment index", ns->segindex0 + i, es);
+				ExplainPropertyFloat("Rows", ns->insts[i].ntuples, 0, es);
+				ExplainCloseGroup("Segment", NULL, true, es);
+			}
+			ExplainCloseGroup("Rows Per Segment", "Rows Per Segment", false, es);
+		}
+	}
+
 	/*
 	 * Actual work_mem used and wanted
 	 */
@@ -2425,6 +2469,32 @@ show_motion_keys(PlanState *planstate, List *hashExpr, int nkeys, AttrNumber *ke
     }
 }
 
+/*
+ * Show the hot join key values that a hash Motion spreads or broadcasts.
+ */
+static void
+show_motion_skew_keys(PlanState *planstate, List *ancestors, ExplainState *es)
+{
+	Motion	   *motion = (Motion *) planstate->plan;
+	List	   *context;
+	List	   *result = NIL;
+	ListCell   *lc;
+
+	context = set_deparse_context_planstate(es->deparse_cxt,
+											(Node *) planstate,
+											ancestors);
+
+	foreach(lc, motion->skewValues)
+		result = lappend(result,
+						 deparse_expression((Node *) lfirst(lc), context,
+											false, false));
+	if (motion->skewNulls)
+		result = lappend(result, "NULL");
+
+	ExplainPropertyList(motion->skewMode == MOTIONSKEW_SPREAD ?
+						"Spread Keys" : "Broadcast Keys", result, es);
+}
+
 /*
  * Explain a partition selector node, including partition elimination
  * expression and number of statically selected partitions, if available.
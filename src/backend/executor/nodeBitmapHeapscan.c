@@ -218,6 +218,12 @@ freeFetchDesc(BitmapHeapScanState *scanstate)
 		heap_endscan(scanstate->bhs_currentScanDesc_heap);
 		scanstate->bhs_currentScanDesc_heap = NULL;
 	}
+
+	if (scanstate->baos_tids != NULL)
+	{
+		pfree(scanstate->baos_tids);
+		scanstate->baos_tids = NULL;
+	}
 }
 
 /*
@@ -636,7 +642,6 @@ BitmapAppendOnlyNext(BitmapHeapScanState *node)
 	GenericBMIterator *tbmiterator;
 	OffsetNumber psuedoHeapOffset;
 	ItemPointerData psudeoHeapTid;
-	AOTupleId	aoTid;
 	TupleTableSlot *slot;
 
 	/*
@@ -683,6 +688,7 @@ BitmapAppendOnlyNext(BitmapHeapScanState *node)
 	{
 		TBMIterateResult *tbmres = node->tbmres;
 		bool		need_recheck = false;
+		bool		gotTuple;
 
 		CHECK_FOR_INTERRUPTS();
 
@@ -693,7 +699,7 @@ BitmapAppendOnlyNext(BitmapHeapScanState *node)
 		* When ExecReScanBitmapHeapScan get executed, bitmap state (tbmiterator and 
 		* tbmres) gets freed in freeBitmapState. So the tbmres is NULL, and we need
 		* to reinit bitmap state to start scan from begining and reset AO/AOCS bitmap
-		* pages' flags(baos_gotpage, baos_lossy, baos_cindex and baos_ntuples). 
+		* pages' flags(baos_gotpage and baos_lossy), along with the fetch batch.
 		*
 		* Especially when ExecReScan happens on the bitmap append only scan and not all the
 		* matched tuples in bitmap are consumed, for example, Bitmap Heap Scan as inner plan
@@ -703,6 +709,9 @@ BitmapAppendOnlyNext(BitmapHeapScanState *node)
 		*/
 		if (!node->baos_gotpage || tbmres == NULL)
 		{
+			int			ntuples;
+			int			i;
+
 			/*
 			 * Obtain the next psuedo-heap-page-info with item bit-map.  Later, we'll
 			 * convert the (psuedo) heap block number and item number to an
@@ -726,37 +735,55 @@ BitmapAppendOnlyNext(BitmapHeapScanState *node)
 
 			node->baos_gotpage = true;
 
-			/*
-			 * Set cindex to first slot to examine
-			 */
-			node->baos_cindex = 0;
-
 			node->baos_lossy = (tbmres->ntuples < 0);
 			if (!node->baos_lossy)
 			{
-				node->baos_ntuples = tbmres->ntuples;
+				ntuples = tbmres->ntuples;
 			}
 			else
 			{
 				/* Iterate over the first 2^15 tuples [MPP-24326] */
-				node->baos_ntuples = INT16_MAX + 1;
+				ntuples = INT16_MAX + 1;
 			}
-		}
-		else
-		{
+
 			/*
-			 * Continuing in previously obtained page; advance cindex
+			 * Convert the page into a batch of AO TIDs. The offsets come in
+			 * ascending order, and so do the TIDs, which lets the fetch visit
+			 * each block once and read ahead the blocks that follow.
 			 */
-			node->baos_cindex++;
-		}
+			if (node->baos_tids == NULL)
+				node->baos_tids = (AOTupleId *) palloc((INT16_MAX + 1) * sizeof(AOTupleId));
 
-		/*
-		 * Out of range?  If so, nothing more to look at on this page
-		 */
-		if (node->baos_cindex < 0 || node->baos_cindex >= node->baos_ntuples)
-		{
-			node->baos_gotpage = false;
-			continue;
+			for (i = 0; i < ntuples; i++)
+			{
+				/*
+				 * For a lossy page, +1 to convert index to offset, since TID
+				 * offsets are not zero based.
+				 */
+				if (node->baos_lossy)
+					psuedoHeapOffset = i + 1;
+				else
+					psuedoHeapOffset = tbmres->offsets[i];
+
+				ItemPointerSet(&psudeoHeapTid,
+							   tbmres->blockno,
+							   psuedoHeapOffset);
+
+				tbm_convert_appendonly_tid_out(&psudeoHeapTid, &node->baos_tids[i]);
+			}
+
+			if (aoFetchDesc != NULL)
+				appendonly_fetch_batch_begin(aoFetchDesc, node->baos_tids, ntuples);
+			else if (node->baos_lossy || tbmres->recheck)
+			{
+				Assert(aocsLossyFetchDesc != NULL);
+				aocs_fetch_batch_begin(aocsLossyFetchDesc, node->baos_tids, ntuples);
+			}
+			else
+			{
+				Assert(aocsFetchDesc != NULL);
+				aocs_fetch_batch_begin(aocsFetchDesc, node->baos_tids, ntuples);
+			}
 		}
 
 		/* Make sure the bitmap state get initalized */
@@ -766,51 +793,20 @@ BitmapAppendOnlyNext(BitmapHeapScanState *node)
 			need_recheck = true;
 
 		/*
-		 * Must account for lossy page info...
+		 * Fetch the next tuple of the page, if there is one left
 		 */
-		if (node->baos_lossy)
-		{
-			/*
-			 * +1 to convert index to offset, since TID offsets are not zero
-			 * based.
-			 */
-			psuedoHeapOffset = node->baos_cindex + 1;	// We are iterating through all items.
-		}
-		else
-		{
-			Assert(node->baos_cindex <= tbmres->ntuples);
-			psuedoHeapOffset = tbmres->offsets[node->baos_cindex];
-		}
-
-		/*
-		 * Okay to fetch the tuple
-		 */
-		ItemPointerSet(&psudeoHeapTid,
-					   tbmres->blockno,
-					   psuedoHeapOffset);
-
-		tbm_convert_appendonly_tid_out(&psudeoHeapTid, &aoTid);
-
 		if (aoFetchDesc != NULL)
-		{
-			appendonly_fetch(aoFetchDesc, &aoTid, slot);
-		}
+			gotTuple = appendonly_fetch_batch_next(aoFetchDesc, slot);
+		else if (need_recheck)
+			gotTuple = aocs_fetch_batch_next(aocsLossyFetchDesc, slot);
 		else
-		{
-			if (need_recheck)
-			{
-				Assert(aocsLossyFetchDesc != NULL);
-				aocs_fetch(aocsLossyFetchDesc, &aoTid, slot);
-			}
-			else
-			{
-				Assert(aocsFetchDesc != NULL);
-				aocs_fetch(aocsFetchDesc, &aoTid, slot);
-			}
-		}
+			gotTuple = aocs_fetch_batch_next(aocsFetchDesc, slot);
 
-		if (TupIsNull(slot))
+		if (!gotTuple)
+		{
+			node->baos_gotpage = false;
 			continue;
+		}
 
 		pgstat_count_heap_fetch(node->ss.ss_currentRelation);
 
@@ -1032,8 +1028,7 @@ ExecInitBitmapHeapScanForPartition(BitmapHeapScan *node, EState *estate, int efl
 
 	scanstate->baos_gotpage = false;
 	scanstate->baos_lossy = false;
-	scanstate->baos_cindex = 0;
-	scanstate->baos_ntuples = 0;
+	scanstate->baos_tids = NULL;
 
 	/*
 	 * Miscellaneous initialization
@@ -25,10 +25,12 @@
 #include "executor/execdebug.h"
 #include "executor/execUtils.h"
 #include "executor/nodeMotion.h"
-#include "lib/binaryheap.h"
+#include "nodes/nodeFuncs.h"
 #include "utils/tuplesort.h"
 #include "utils/tuplesort_mk_details.h"
 #include "miscadmin.h"
+#include "utils/datum.h"
+#include "utils/lsyscache.h"
 #include "utils/memutils.h"
 
 
@@ -42,22 +44,23 @@
 
 #ifdef CDB_MOTION_DEBUG
 #include "lib/stringinfo.h"		/* StringInfo */
-#include "utils/lsyscache.h"
 #endif
 
 /*
  * CdbTupleHeapInfo
  *
- * A priority queue element holding the next tuple of the
- * sorted tuple stream received from a particular sender.
+ * A merge tree leaf holding the next tuple of the sorted tuple
+ * stream received from a particular sender, NULL once the sender
+ * has reached end of stream. The sort key values are extracted
+ * once, when the tuple arrives, rather than on every comparison.
  * Used by sorted receiver (Merge Receive).
  */
 typedef struct CdbTupleHeapInfo
 {
 	/* Next tuple from this sender */
 	GenericTuple tuple;
-	Datum		datum1;			/* value of first key column */
-	bool		isnull1;		/* is first key column NULL? */
+	Datum	   *datums;			/* values of the key columns */
+	bool	   *isnulls;		/* are the key columns NULL? */
 }			CdbTupleHeapInfo;
 
 /*
@@ -74,8 +77,16 @@ typedef struct CdbTupleHeapInfo
  *			(sortFunctions, cmpFlags)
  *		3) the tuple desc
  *			(tupDesc)
- * Used by sorted receiver (Merge Receive).  It is passed as the
- * context argument to the key comparator.
+ *		4) the loser tree over the senders' streams
+ *			(numStreams, losers)
+ * Used by sorted receiver (Merge Receive).
+ *
+ * The loser tree is a tournament tree with one leaf per sender: each
+ * internal node remembers the stream that lost the match played there, and
+ * losers[0] the overall winner, whose head is the next tuple to return.
+ * When the winner's stream advances, only the matches on the path from its
+ * leaf to the root are replayed, which takes ceil(log2(numStreams))
+ * comparisons; sifting down a binary heap takes up to twice as many.
  */
 typedef struct CdbMergeComparatorContext
 {
@@ -85,9 +96,12 @@ typedef struct CdbMergeComparatorContext
 	MemTupleBinding *mt_bind;
 
 	CdbTupleHeapInfo *tupleheap_entries;
+
+	int			numStreams;
+	int		   *losers;			/* numStreams entries, [0] is the winner */
 } CdbMergeComparatorContext;
 
-static CdbMergeComparatorContext *CdbMergeComparator_CreateContext(CdbTupleHeapInfo *tupleheap_entries,
+static CdbMergeComparatorContext *CdbMergeComparator_CreateContext(int numStreams,
 								 TupleDesc tupDesc,
 								 int numSortCols,
 								 AttrNumber *sortColIdx,
@@ -108,11 +122,20 @@ static TupleTableSlot *execMotionSortedReceiver_mk(MotionState *node);
 
 static void execMotionSortedReceiverFirstTime(MotionState *node);
 
-static int	CdbMergeComparator(Datum lhs, Datum rhs, void *context);
+static int	CdbMergeComparator(CdbMergeComparatorContext *ctx, int lSegIdx, int rSegIdx);
+static void CdbMergeSetHead(CdbMergeComparatorContext *ctx, int iSegIdx, GenericTuple tuple);
+static void CdbMergeBuild(CdbMergeComparatorContext *ctx);
+static void CdbMergeReplay(CdbMergeComparatorContext *ctx, int iSegIdx);
 static uint32 evalHashKey(ExprContext *econtext, List *hashkeys, CdbHash *h);
 
 static void doSendEndOfStream(Motion *motion, MotionState *node);
 static void doSendTuple(Motion *motion, MotionState *node, TupleTableSlot *outerTupleSlot);
+static void doSendTupleToRoute(Motion *motion, MotionState *node, TupleTableSlot *slot, int16 targetRoute);
+static void addTupleToSendBatch(Motion *motion, MotionState *node, TupleTableSlot *outerTupleSlot);
+static void routeSkewedBatch(Motion *motion, MotionState *node, int nrows);
+static void confirmSkewedKeys(Motion *motion, MotionState *node);
+static void doSendTupleBatch(Motion *motion, MotionState *node, TupleTableSlot *lastSlot);
+static void ExecMotionExplainEnd(PlanState *planstate, struct StringInfoData *buf);
 
 
 /*=========================================================================
@@ -323,6 +346,8 @@ execMotionSender(MotionState *node)
 
 		if (done || TupIsNull(outerTupleSlot))
 		{
+			if (node->sendBatchCount > 0)
+				doSendTupleBatch(motion, node, NULL);
 			doSendEndOfStream(motion, node);
 			done = true;
 		}
@@ -336,7 +361,10 @@ execMotionSender(MotionState *node)
 		}
 		else
 		{
-			doSendTuple(motion, node, outerTupleSlot);
+			if (node->sendBatchSize > 0)
+				addTupleToSendBatch(motion, node, outerTupleSlot);
+			else
+				doSendTuple(motion, node, outerTupleSlot);
 			/* doSendTuple() may have set node->stopRequested as a side-effect */
 
 			if (node->stopRequested)
@@ -485,7 +513,7 @@ execMotionUnsortedReceiver(MotionState *node)
  * --------------------
  *
  * The 1st time we execute, we need to pull a tuple from each of our source
- * and store them in our tupleheap, this is what execMotionSortedFirstTime()
+ * and store them in our merge tree, this is what execMotionSortedFirstTime()
  * does.  Once that is done, we can pick the lowest (or whatever the
  * criterion is) value from amongst all the sources.  This works since each
  * stream is sorted itself.
@@ -698,12 +726,12 @@ execMotionSortedReceiver_mk(MotionState *node)
 	return slot;
 }
 
-/* Sorted receiver using binary heap */
+/* Sorted receiver using loser tree */
 static TupleTableSlot *
 execMotionSortedReceiver(MotionState *node)
 {
 	TupleTableSlot *slot;
-	binaryheap *hp = node->tupleheap;
+	CdbMergeComparatorContext *ctx = node->tupleheap_cxt;
 	GenericTuple tuple,
 				inputTuple;
 	Motion	   *motion = (Motion *) node->ps.plan;
@@ -712,7 +740,7 @@ execMotionSortedReceiver(MotionState *node)
 
 	AssertState(motion->motionType == MOTIONTYPE_FIXED &&
 				motion->sendSorted &&
-				hp != NULL);
+				ctx != NULL);
 
 	/* Notify senders and return EOS if caller doesn't want any more data. */
 	if (node->stopRequested)
@@ -749,20 +777,20 @@ execMotionSortedReceiver(MotionState *node)
 			ereport(ERROR, (errmsg("Interconnect is down unexpectedly.")));
 	}
 
-	/* On first call, fill the priority queue with each sender's first tuple. */
+	/* On first call, fill the merge tree with each sender's first tuple. */
 	if (!node->tupleheapReady)
 	{
 		execMotionSortedReceiverFirstTime(node);
 	}
 
 	/*
-	 * Delete from the priority queue the element that we fetched last time.
-	 * Receive and insert the next tuple from that same sender.
+	 * Replace the tuple that we returned last time with the next tuple from
+	 * that same sender, and replay its matches up the merge tree.
 	 */
 	else
 	{
-		/* Old element is still at the head of the pq. */
-		Assert(DatumGetInt32(binaryheap_first(hp)) == node->routeIdNext);
+		/* Old element is still the winner. */
+		Assert(ctx->losers[0] == node->routeIdNext);
 
 		/* Receive the successor of the tuple that we returned last time. */
 		inputTuple = RecvTupleFrom(node->ps.state->motionlayer_context,
@@ -770,27 +798,12 @@ execMotionSortedReceiver(MotionState *node)
 								   motion->motionID,
 								   node->routeIdNext);
 
-		/* Substitute it in the pq for its predecessor. */
+		/* At EOS, the sender's leaf stays empty and loses every match. */
+		CdbMergeSetHead(ctx, node->routeIdNext, inputTuple);
+		CdbMergeReplay(ctx, node->routeIdNext);
+
 		if (inputTuple)
 		{
-			CdbTupleHeapInfo *info = &node->tupleheap_entries[node->routeIdNext];
-			AttrNumber key1_attno = node->tupleheap_cxt->sortKeys[0].ssup_attno;
-
-			info->tuple = inputTuple;
-
-			if (is_memtuple(inputTuple))
-				info->datum1 = memtuple_getattr((MemTuple) inputTuple,
-												node->tupleheap_cxt->mt_bind,
-												key1_attno,
-												&info->isnull1);
-			else
-				info->datum1 = heap_getattr((HeapTuple) inputTuple,
-											key1_attno,
-											node->tupleheap_cxt->tupDesc,
-											&info->isnull1);
-
-			binaryheap_replace_first(hp, Int32GetDatum(node->routeIdNext));
-
 			node->numTuplesFromAMS++;
 
 #ifdef CDB_MOTION_DEBUG
@@ -803,22 +816,19 @@ execMotionSortedReceiver(MotionState *node)
 								 motion->motionID,
 								 node->routeIdNext,
 								 node->numTuplesFromAMS);
-				formatTuple(&buf, inputTuple, node->tupleheap_cxt->tupDesc,
-							node->tupleheap_cxt->mt_bind, node->outputFunArray);
+				formatTuple(&buf, inputTuple, ctx->tupDesc,
+							ctx->mt_bind, node->outputFunArray);
 				elog(DEBUG3, "%s", buf.data);
 				pfree(buf.data);
 			}
 #endif
 		}
-		else
-		{
-			/* At EOS, drop this sender from the priority queue. */
-			binaryheap_remove_first(hp);
-		}
 	}
 
 	/* Finished if all senders have returned EOS. */
-	if (binaryheap_empty(hp))
+	node->routeIdNext = ctx->losers[0];
+	tupHeapInfo = &node->tupleheap_entries[node->routeIdNext];
+	if (tupHeapInfo->tuple == NULL)
 	{
 		Assert(node->numTuplesFromAMS == node->numTuplesToParent);
 		Assert(node->numTuplesFromChild == 0);
@@ -827,19 +837,16 @@ execMotionSortedReceiver(MotionState *node)
 	}
 
 	/*
-	 * Our next result tuple, with lowest key among all senders, is now at the
-	 * head of the priority queue.  Get it from there.
+	 * Our next result tuple, with lowest key among all senders, is the head
+	 * of the winning stream.
 	 *
-	 * We transfer ownership of the tuple from the pq element to our caller,
-	 * but the pq element itself will remain in place until the next time we
-	 * are called, to avoid an unnecessary rearrangement of the priority
-	 * queue.
+	 * We transfer ownership of the tuple from the tree leaf to our caller,
+	 * but the leaf remains the winner until the next time we are called,
+	 * when it gets the sender's next tuple.
 	 */
-	node->routeIdNext = binaryheap_first(hp);
-	tupHeapInfo = &node->tupleheap_entries[node->routeIdNext];
 	tuple = tupHeapInfo->tuple;
 
-	/* Zap dangling tuple ptr for safety. PQ element doesn't own it anymore. */
+	/* Zap dangling tuple ptr for safety. The leaf doesn't own it anymore. */
 	tupHeapInfo->tuple = NULL;
 
 	/* Update counters. */
@@ -875,23 +882,26 @@ void
 execMotionSortedReceiverFirstTime(MotionState *node)
 {
 	GenericTuple inputTuple;
-	binaryheap *hp = node->tupleheap;
 	Motion	   *motion = (Motion *) node->ps.plan;
 	int			iSegIdx;
 	ListCell   *lcProcess;
 	CdbMergeComparatorContext *comparatorContext = node->tupleheap_cxt;
-	AttrNumber	key1_attno = motion->sortColIdx[0];
 	Slice	   *sendSlice = (Slice *) list_nth(node->ps.state->es_sliceTable->slices, motion->motionID);
 
 	Assert(sendSlice->sliceIndex == motion->motionID);
 
 	/*
-	 * Get the first tuple from every sender, and stick it into the heap.
+	 * Get the first tuple from every sender, and stick it into its leaf of
+	 * the merge tree.
 	 */
 	foreach_with_count(lcProcess, sendSlice->primaryProcesses, iSegIdx)
 	{
 		if (lfirst(lcProcess) == NULL)
-			continue;			/* skip this one: we are not receiving from it */
+		{
+			/* skip this one: we are not receiving from it */
+			CdbMergeSetHead(comparatorContext, iSegIdx, NULL);
+			continue;
+		}
 
 		/*
 		 * another place where we are mapping segid space to routeid space. so
@@ -901,25 +911,10 @@ execMotionSortedReceiverFirstTime(MotionState *node)
 								   node->ps.state->interconnect_context,
 								   motion->motionID, iSegIdx);
 
+		CdbMergeSetHead(comparatorContext, iSegIdx, inputTuple);
+
 		if (inputTuple)
 		{
-			CdbTupleHeapInfo *info = &node->tupleheap_entries[iSegIdx];
-
-			info->tuple = inputTuple;
-
-			binaryheap_add_unordered(hp, iSegIdx);
-
-			if (is_memtuple(inputTuple))
-				info->datum1 = memtuple_getattr((MemTuple) inputTuple,
-												comparatorContext->mt_bind,
-												key1_attno,
-												&info->isnull1);
-			else
-				info->datum1 = heap_getattr((HeapTuple) inputTuple,
-											key1_attno,
-											comparatorContext->tupDesc,
-											&info->isnull1);
-
 			node->numTuplesFromAMS++;
 
 #ifdef CDB_MOTION_DEBUG
@@ -942,12 +937,8 @@ execMotionSortedReceiverFirstTime(MotionState *node)
 	}
 	Assert(iSegIdx == node->numInputSegs);
 
-	/*
-	 * Done adding the elements, now arrange the heap to satisfy the heap
-	 * property. This is quicker than inserting the initial elements one by
-	 * one.
-	 */
-	binaryheap_build(hp);
+	/* Done adding the elements, now play the initial tournament. */
+	CdbMergeBuild(comparatorContext);
 
 	node->tupleheapReady = true;
 }								/* execMotionSortedReceiverFirstTime */
@@ -993,6 +984,8 @@ ExecInitMotion(Motion *node, EState *estate, int eflags)
 	motionstate->stopRequested = false;
 	motionstate->hashExprs = NIL;
 	motionstate->cdbhash = NULL;
+	motionstate->sendBatchSize = 0;
+	motionstate->sendBatchCount = 0;
 	motionstate->isExplictGatherMotion = false;
 
 	/* Look up the sending gang's slice table entry. */
@@ -1175,31 +1168,99 @@ ExecInitMotion(Motion *node, EState *estate, int eflags)
 		}
 
 		motionstate->cdbhash = makeCdbHash(numsegments, nkeys, node->hashFuncs);
+
+		/* Hot join keys are routed by doSendTupleBatch() */
+		if (node->skewMode != MOTIONSKEW_NONE)
+		{
+			ListCell   *lc;
+			int			i = 0;
+
+			Assert(nkeys == 1);
+			motionstate->numSkewHashes = list_length(node->skewHashes);
+			motionstate->skewHashes = palloc0((motionstate->numSkewHashes + 1) *
+											  sizeof(uint32));
+			foreach(lc, node->skewHashes)
+				motionstate->skewHashes[i++] = (uint32) lfirst_int(lc);
+
+			/* all of them are handled until the sample says otherwise */
+			motionstate->skewHot = palloc((motionstate->numSkewHashes + 1) *
+										  sizeof(bool));
+			for (i = 0; i < motionstate->numSkewHashes; i++)
+				motionstate->skewHot[i] = true;
+			motionstate->skewHot[i] = node->skewNulls;
+
+			if (node->skewMode == MOTIONSKEW_SPREAD)
+			{
+				motionstate->skewSampleCounts = palloc0((motionstate->numSkewHashes + 1) *
+														sizeof(int));
+				motionstate->skewSampleRows = gp_motion_skew_sample_rows;
+				motionstate->skewSampleLeft = gp_motion_skew_sample_rows;
+			}
+
+			/* start the senders at different targets */
+			motionstate->skewNextTarget =
+				(GpIdentity.segindex > 0 ? GpIdentity.segindex : 0) % numsegments;
+		}
+
+		/*
+		 * Hash and send the tuples in batches, unless disabled or there are
+		 * no keys to hash (the target is then chosen at random). Hot join
+		 * keys are only handled in batches.
+		 */
+		if (nkeys > 0 &&
+			(gp_motion_send_batch_size > 1 || node->skewMode != MOTIONSKEW_NONE))
+		{
+			int			batchSize = Max(gp_motion_send_batch_size, 1);
+			ListCell   *lc;
+			int			k = 0;
+
+			motionstate->sendBatchSize = batchSize;
+
+			/*
+			 * Room for a batch of narrow tuples, and always for one more
+			 * chunk, so that only a tuple larger than a chunk doesn't fit.
+			 */
+			motionstate->sendBatchBufSize = batchSize * 128 +
+				Gp_max_tuple_chunk_size + TUPLE_CHUNK_HEADER_SIZE;
+			motionstate->sendBatchBuf = palloc(motionstate->sendBatchBufSize);
+			motionstate->sendBatchBufUsed = 0;
+			motionstate->sendBatchChunkStart = palloc(batchSize * sizeof(int));
+			motionstate->sendBatchChunkLen = palloc(batchSize * sizeof(int));
+			motionstate->sendBatchValues = palloc(nkeys * batchSize * sizeof(Datum));
+			motionstate->sendBatchIsnull = palloc(nkeys * batchSize * sizeof(bool));
+			motionstate->sendBatchKeyLen = palloc(nkeys * sizeof(int16));
+			motionstate->sendBatchKeyByVal = palloc(nkeys * sizeof(bool));
+			foreach(lc, node->hashExprs)
+			{
+				get_typlenbyval(exprType((Node *) lfirst(lc)),
+								&motionstate->sendBatchKeyLen[k],
+								&motionstate->sendBatchKeyByVal[k]);
+				k++;
+			}
+			motionstate->sendBatchTargets = palloc(batchSize * sizeof(unsigned int));
+			motionstate->sendBatchOrder = palloc(batchSize * sizeof(int));
+			/* one extra target for broadcast rows */
+			motionstate->sendBatchOffsets = palloc((numsegments + 2) * sizeof(int));
+		}
 	}
 
-	/* Merge Receive: Set up the key comparator and priority queue. */
+	/* Merge Receive: Set up the key comparator and merge tree. */
 	if (node->sendSorted && motionstate->mstype == MOTIONSTATE_RECV)
 	{
 		if (gp_enable_motion_mk_sort)
 			create_motion_mk_heap(motionstate);
 		else
 		{
-			/* Allocate context object for the key comparator. */
-			motionstate->tupleheap_entries =
-				palloc(motionstate->numInputSegs * sizeof(CdbTupleHeapInfo));
-			/* Create the priority queue structure. */
 			motionstate->tupleheap_cxt =
-				CdbMergeComparator_CreateContext(motionstate->tupleheap_entries,
+				CdbMergeComparator_CreateContext(motionstate->numInputSegs,
 												 tupDesc,
 												 node->numSortCols,
 												 node->sortColIdx,
 												 node->sortOperators,
 												 node->collations,
 												 node->nullsFirst);
-			motionstate->tupleheap =
-				binaryheap_allocate(motionstate->numInputSegs,
-									CdbMergeComparator,
-									motionstate->tupleheap_cxt);
+			motionstate->tupleheap_entries =
+				motionstate->tupleheap_cxt->tupleheap_entries;
 		}
 	}
 
@@ -1211,6 +1272,14 @@ ExecInitMotion(Motion *node, EState *estate, int eflags)
 						  node->sendSorted,
 						  tupDesc);
 
+	/*
+	 * CDB: Offer extra info for EXPLAIN ANALYZE on the receiving side, where
+	 * the effect of motion compression can be seen.
+	 */
+	if (motionstate->mstype == MOTIONSTATE_RECV &&
+		estate->es_instrument && (estate->es_instrument & INSTRUMENT_CDB))
+		motionstate->ps.cdbexplainfun = ExecMotionExplainEnd;
+
 
 #ifdef CDB_MOTION_DEBUG
 	motionstate->outputFunArray = (Oid *) palloc(tupDesc->natts * sizeof(Oid));
@@ -1306,13 +1375,12 @@ ExecEndMotion(MotionState *node)
 	}
 #endif							/* MEASURE_MOTION_TIME */
 
-	/* Merge Receive: Free the priority queue and associated structures. */
-	if (node->tupleheap != NULL)
+	/* Merge Receive: Free the merge tree and associated structures. */
+	if (node->tupleheap_cxt != NULL)
 	{
-		binaryheap_free(node->tupleheap);
-
 		CdbMergeComparator_DestroyContext(node->tupleheap_cxt);
-		node->tupleheap = NULL;
+		node->tupleheap_cxt = NULL;
+		node->tupleheap_entries = NULL;
 	}
 	if (node->tupleheap_mk)
 	{
@@ -1327,6 +1395,35 @@ ExecEndMotion(MotionState *node)
 		node->cdbhash = NULL;
 	}
 
+	/* Free the send batch */
+	if (node->sendBatchSize > 0)
+	{
+		pfree(node->sendBatchBuf);
+		pfree(node->sendBatchChunkStart);
+		pfree(node->sendBatchChunkLen);
+		pfree(node->sendBatchValues);
+		pfree(node->sendBatchIsnull);
+		pfree(node->sendBatchKeyLen);
+		pfree(node->sendBatchKeyByVal);
+		pfree(node->sendBatchTargets);
+		pfree(node->sendBatchOrder);
+		pfree(node->sendBatchOffsets);
+		node->sendBatchSize = 0;
+		node->sendBatchCount = 0;
+	}
+
+	if (node->skewHashes)
+	{
+		pfree(node->skewHashes);
+		pfree(node->skewHot);
+		if (node->skewSampleCounts)
+			pfree(node->skewSampleCounts);
+		node->skewHashes = NULL;
+		node->skewHot = NULL;
+		node->skewSampleCounts = NULL;
+		node->numSkewHashes = 0;
+	}
+
 	/*
 	 * Free up this motion node's resources in the Motion Layer.
 	 *
@@ -1356,69 +1453,139 @@ ExecEndMotion(MotionState *node)
 
 /*
  * CdbMergeComparator:
- * Used to compare tuples for a sorted motion node.
+ * Used to compare the heads of two streams for a sorted motion node.
+ * Returns < 0 if the head of lSegIdx goes first. A stream at EOS goes
+ * after everything else.
  */
 static int
-CdbMergeComparator(Datum lhs, Datum rhs, void *context)
+CdbMergeComparator(CdbMergeComparatorContext *ctx, int lSegIdx, int rSegIdx)
 {
-	int			lSegIdx = DatumGetInt32(lhs);
-	int			rSegIdx = DatumGetInt32(rhs);
-	CdbMergeComparatorContext *ctx = (CdbMergeComparatorContext *) context;
-	CdbTupleHeapInfo *linfo = (CdbTupleHeapInfo *) &ctx->tupleheap_entries[lSegIdx];
-	CdbTupleHeapInfo *rinfo = (CdbTupleHeapInfo *) &ctx->tupleheap_entries[rSegIdx];
-	GenericTuple ltup = linfo->tuple;
-	GenericTuple rtup = rinfo->tuple;
-	SortSupport	sortKeys = ctx->sortKeys;
-	TupleDesc	tupDesc;
+	CdbTupleHeapInfo *linfo = &ctx->tupleheap_entries[lSegIdx];
+	CdbTupleHeapInfo *rinfo = &ctx->tupleheap_entries[rSegIdx];
 	int			nkey;
-	int			numSortCols = ctx->numSortCols;
-	int			compare;
 
-	Assert(ltup && rtup);
+	if (linfo->tuple == NULL || rinfo->tuple == NULL)
+		return (linfo->tuple == NULL) - (rinfo->tuple == NULL);
+
+	for (nkey = 0; nkey < ctx->numSortCols; nkey++)
+	{
+		int			compare;
+
+		compare = ApplySortComparator(linfo->datums[nkey], linfo->isnulls[nkey],
+									  rinfo->datums[nkey], rinfo->isnulls[nkey],
+									  &ctx->sortKeys[nkey]);
+		if (compare != 0)
+			return compare;
+	}
+
+	return 0;
+}								/* CdbMergeComparator */
+
+/* Does the head of stream 'a' go before that of 'b'? Ties go to the lower stream. */
+static inline bool
+CdbMergeBeats(CdbMergeComparatorContext *ctx, int a, int b)
+{
+	int			compare = CdbMergeComparator(ctx, a, b);
 
-	tupDesc = ctx->tupDesc;
+	return compare < 0 || (compare == 0 && a < b);
+}
+
+/*
+ * CdbMergeSetHead:
+ * Make 'tuple' the head of stream iSegIdx, extracting its sort keys. NULL
+ * marks the stream as exhausted. The merge tree is not updated.
+ */
+static void
+CdbMergeSetHead(CdbMergeComparatorContext *ctx, int iSegIdx, GenericTuple tuple)
+{
+	CdbTupleHeapInfo *info = &ctx->tupleheap_entries[iSegIdx];
+	int			nkey;
 
-	/* First column. We have the Datum for that extracted already. */
-	compare = ApplySortComparator(linfo->datum1, linfo->isnull1,
-								  rinfo->datum1, rinfo->isnull1,
-								  &sortKeys[0]);
-	if (compare != 0)
-		return -compare;
+	info->tuple = tuple;
+	if (tuple == NULL)
+		return;
 
-	/* Rest of the columns. */
-	for (nkey = 1; nkey < numSortCols; nkey++)
+	for (nkey = 0; nkey < ctx->numSortCols; nkey++)
 	{
-		SortSupport ssup = &sortKeys[nkey];
-		AttrNumber	attno = ssup->ssup_attno;
-		Datum		datum1,
-					datum2;
-		bool		isnull1,
-					isnull2;
-
-		if (is_memtuple(ltup))
-			datum1 = memtuple_getattr((MemTuple) ltup, ctx->mt_bind, attno, &isnull1);
-		else
-			datum1 = heap_getattr((HeapTuple) ltup, attno, tupDesc, &isnull1);
+		AttrNumber	attno = ctx->sortKeys[nkey].ssup_attno;
 
-		if (is_memtuple(rtup))
-			datum2 = memtuple_getattr((MemTuple) rtup, ctx->mt_bind, attno, &isnull2);
+		if (is_memtuple(tuple))
+			info->datums[nkey] = memtuple_getattr((MemTuple) tuple, ctx->mt_bind,
+												  attno, &info->isnulls[nkey]);
 		else
-			datum2 = heap_getattr((HeapTuple) rtup, attno, tupDesc, &isnull2);
+			info->datums[nkey] = heap_getattr((HeapTuple) tuple, attno,
+											  ctx->tupDesc, &info->isnulls[nkey]);
+	}
+}								/* CdbMergeSetHead */
 
-		compare = ApplySortComparator(datum1, isnull1,
-									  datum2, isnull2,
-									  ssup);
-		if (compare != 0)
-			return -compare;
+/*
+ * CdbMergeBuild:
+ * Play the initial tournament between the heads of all streams.
+ *
+ * Internal node i of the tree has children 2i and 2i + 1, and node
+ * numStreams + s is the leaf of stream s.
+ */
+static void
+CdbMergeBuild(CdbMergeComparatorContext *ctx)
+{
+	int			n = ctx->numStreams;
+	int		   *winners;
+	int			i;
+
+	if (n == 1)
+	{
+		ctx->losers[0] = 0;
+		return;
 	}
 
-	return 0;
-}								/* CdbMergeComparator */
+	winners = (int *) palloc(n * sizeof(int));
+	for (i = n - 1; i >= 1; i--)
+	{
+		int			left = (2 * i >= n) ? 2 * i - n : winners[2 * i];
+		int			right = (2 * i + 1 >= n) ? 2 * i + 1 - n : winners[2 * i + 1];
+
+		if (CdbMergeBeats(ctx, right, left))
+		{
+			winners[i] = right;
+			ctx->losers[i] = left;
+		}
+		else
+		{
+			winners[i] = left;
+			ctx->losers[i] = right;
+		}
+	}
+	ctx->losers[0] = winners[1];
+	pfree(winners);
+}								/* CdbMergeBuild */
+
+/*
+ * CdbMergeReplay:
+ * Stream iSegIdx got a new head: replay its matches on the way to the root.
+ */
+static void
+CdbMergeReplay(CdbMergeComparatorContext *ctx, int iSegIdx)
+{
+	int			winner = iSegIdx;
+	int			i;
+
+	for (i = (iSegIdx + ctx->numStreams) / 2; i >= 1; i /= 2)
+	{
+		int			challenger = ctx->losers[i];
+
+		if (CdbMergeBeats(ctx, challenger, winner))
+		{
+			ctx->losers[i] = winner;
+			winner = challenger;
+		}
+	}
+	ctx->losers[0] = winner;
+}								/* CdbMergeReplay */
 
 
 /* Create context object for use by CdbMergeComparator */
 static CdbMergeComparatorContext *
-CdbMergeComparator_CreateContext(CdbTupleHeapInfo *tupleheap_entries,
+CdbMergeComparator_CreateContext(int numStreams,
 								 TupleDesc tupDesc,
 								 int numSortCols,
 								 AttrNumber *sortColIdx,
@@ -1430,6 +1597,7 @@ CdbMergeComparator_CreateContext(CdbTupleHeapInfo *tupleheap_entries,
 	int			i;
 
 	Assert(tupDesc &&
+		   numStreams > 0 &&
 		   numSortCols > 0 &&
 		   sortColIdx &&
 		   sortOperators);
@@ -1440,7 +1608,17 @@ CdbMergeComparator_CreateContext(CdbTupleHeapInfo *tupleheap_entries,
 	ctx->numSortCols = numSortCols;
 	ctx->tupDesc = tupDesc;
 	ctx->mt_bind = create_memtuple_binding(tupDesc);
-	ctx->tupleheap_entries = tupleheap_entries;
+
+	/* The merge tree, and the key values of each stream's head */
+	ctx->numStreams = numStreams;
+	ctx->losers = (int *) palloc0(numStreams * sizeof(int));
+	ctx->tupleheap_entries = (CdbTupleHeapInfo *)
+		palloc0(numStreams * sizeof(CdbTupleHeapInfo));
+	for (i = 0; i < numStreams; i++)
+	{
+		ctx->tupleheap_entries[i].datums = (Datum *) palloc(numSortCols * sizeof(Datum));
+		ctx->tupleheap_entries[i].isnulls = (bool *) palloc(numSortCols * sizeof(bool));
+	}
 
 	/* Prepare SortSupport data for each column */
 	ctx->sortKeys = (SortSupport) palloc0(numSortCols * sizeof(SortSupportData));
@@ -1467,10 +1645,20 @@ CdbMergeComparator_CreateContext(CdbTupleHeapInfo *tupleheap_entries,
 void
 CdbMergeComparator_DestroyContext(CdbMergeComparatorContext *ctx)
 {
+	int			i;
+
 	if (!ctx)
 		return;
 	if (ctx->sortKeys)
 		pfree(ctx->sortKeys);
+	for (i = 0; i < ctx->numStreams; i++)
+	{
+		pfree(ctx->tupleheap_entries[i].datums);
+		pfree(ctx->tupleheap_entries[i].isnulls);
+	}
+	pfree(ctx->tupleheap_entries);
+	pfree(ctx->losers);
+	pfree(ctx);
 }								/* CdbMergeComparator_DestroyContext */
 
 
@@ -1574,7 +1762,6 @@ void
 doSendTuple(Motion *motion, MotionState *node, TupleTableSlot *outerTupleSlot)
 {
 	int16		targetRoute;
-	SendReturnCode sendRC;
 	ExprContext *econtext = node->ps.ps_ExprContext;
 
 	/* We got a tuple from the child-plan. */
@@ -1647,6 +1834,19 @@ doSendTuple(Motion *motion, MotionState *node, TupleTableSlot *outerTupleSlot)
 		Assert(!is_null);
 	}
 
+	doSendTupleToRoute(motion, node, outerTupleSlot, targetRoute);
+}
+
+/*
+ * Send one tuple to the given route, and stop sending if the receivers
+ * asked for it.
+ */
+static void
+doSendTupleToRoute(Motion *motion, MotionState *node, TupleTableSlot *outerTupleSlot,
+				   int16 targetRoute)
+{
+	SendReturnCode sendRC;
+
 	CheckAndSendRecordCache(node->ps.state->motionlayer_context,
 							node->ps.state->interconnect_context,
 							motion->motionID,
@@ -1686,6 +1886,289 @@ doSendTuple(Motion *motion, MotionState *node, TupleTableSlot *outerTupleSlot)
 #endif
 }
 
+/*
+ * Send one serialized tuple of the send batch to the given route, and stop
+ * sending if the receivers asked for it.
+ */
+static void
+doSendSerializedTupleToRoute(Motion *motion, MotionState *node,
+							 const char *chunk, int len, int16 targetRoute)
+{
+	SendReturnCode sendRC;
+
+	CheckAndSendRecordCache(node->ps.state->motionlayer_context,
+							node->ps.state->interconnect_context,
+							motion->motionID,
+							targetRoute);
+
+	sendRC = SendSerializedTuple(node->ps.state->motionlayer_context,
+								 node->ps.state->interconnect_context,
+								 motion->motionID,
+								 chunk, len,
+								 targetRoute);
+
+	Assert(sendRC == SEND_COMPLETE || sendRC == STOP_SENDING);
+	if (sendRC == SEND_COMPLETE)
+		node->numTuplesToAMS++;
+	else
+		node->stopRequested = true;
+}
+
+/*
+ * Add a tuple from the child to the send batch of a redistribute motion, and
+ * send the batch when it is full.
+ *
+ * The child may reuse its slot for the next tuple, so the hash keys are
+ * evaluated right away, and the tuple is serialized straight from the slot
+ * into the batch buffer, in the form it is sent in. A tuple that can't be
+ * serialized there is sent at once, together with the batch so far.
+ */
+static void
+addTupleToSendBatch(Motion *motion, MotionState *node, TupleTableSlot *outerTupleSlot)
+{
+	ExprContext *econtext = node->ps.ps_ExprContext;
+	MemoryContext oldContext;
+	ListCell   *hk;
+	int			row;
+	int			k = 0;
+	int			len;
+
+	Assert(motion->motionType == MOTIONTYPE_HASH);
+	Assert(node->sendBatchCount < node->sendBatchSize);
+
+	/* We got a tuple from the child-plan. */
+	node->numTuplesFromChild++;
+
+	/* keep room for a whole chunk */
+	if (node->sendBatchBufSize - node->sendBatchBufUsed <
+		Gp_max_tuple_chunk_size + TUPLE_CHUNK_HEADER_SIZE)
+		doSendTupleBatch(motion, node, NULL);
+
+	/* the key values of a batch live until it is sent */
+	if (node->sendBatchCount == 0)
+		ResetExprContext(econtext);
+
+	row = node->sendBatchCount;
+
+	oldContext = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+
+	econtext->ecxt_outertuple = outerTupleSlot;
+	foreach(hk, node->hashExprs)
+	{
+		ExprState  *keyexpr = (ExprState *) lfirst(hk);
+		int			n = k * node->sendBatchSize + row;
+
+		node->sendBatchValues[n] =
+			ExecEvalExpr(keyexpr, econtext, &node->sendBatchIsnull[n], NULL);
+
+		/* the value may point into the child's tuple */
+		if (!node->sendBatchIsnull[n] && !node->sendBatchKeyByVal[k])
+			node->sendBatchValues[n] = datumCopy(node->sendBatchValues[n], false,
+												 node->sendBatchKeyLen[k]);
+		k++;
+	}
+
+	MemoryContextSwitchTo(oldContext);
+
+	len = SerializeTupleToBuffer(node->ps.state->motionlayer_context,
+								 motion->motionID,
+								 outerTupleSlot,
+								 node->sendBatchBuf + node->sendBatchBufUsed,
+								 node->sendBatchBufSize - node->sendBatchBufUsed);
+
+	node->sendBatchChunkStart[row] = node->sendBatchBufUsed;
+	node->sendBatchChunkLen[row] = len;
+	node->sendBatchBufUsed += len;
+	node->sendBatchCount++;
+
+	if (len == 0)
+		doSendTupleBatch(motion, node, outerTupleSlot);
+	else if (node->sendBatchCount == node->sendBatchSize)
+		doSendTupleBatch(motion, node, NULL);
+}
+
+/*
+ * Route the rows of a batch whose single key has been hashed into
+ * node->sendBatchTargets, minding the hot keys of the motion.
+ *
+ * Rows with a hot key (or a NULL key, if skewNulls) go round-robin to all
+ * segments in MOTIONSKEW_SPREAD mode, or to every segment in
+ * MOTIONSKEW_BROADCAST mode, which gets target h->numsegs. Other rows are
+ * reduced to their segment as usual.
+ *
+ * A spreading Motion counts the hot keys in the first skewSampleRows rows,
+ * and then goes on spreading only those that are hot in the sample too.
+ */
+static void
+routeSkewedBatch(Motion *motion, MotionState *node, int nrows)
+{
+	CdbHash    *h = node->cdbhash;
+	uint32	   *hashes = (uint32 *) node->sendBatchTargets;
+	int			i;
+
+	for (i = 0; i < nrows; i++)
+	{
+		int			slot = -1;
+		int			j;
+
+		if (node->sendBatchIsnull[i])
+			slot = node->numSkewHashes;
+		else
+		{
+			for (j = 0; j < node->numSkewHashes; j++)
+			{
+				if (hashes[i] == node->skewHashes[j])
+				{
+					slot = j;
+					break;
+				}
+			}
+		}
+
+		if (node->skewSampleLeft > 0)
+		{
+			if (slot >= 0)
+				node->skewSampleCounts[slot]++;
+			if (--node->skewSampleLeft == 0)
+				confirmSkewedKeys(motion, node);
+		}
+
+		if (slot < 0 || !node->skewHot[slot])
+			node->sendBatchTargets[i] = cdbhashreduceraw(h, hashes[i]);
+		else if (motion->skewMode == MOTIONSKEW_BROADCAST)
+			node->sendBatchTargets[i] = h->numsegs;
+		else
+		{
+			node->sendBatchTargets[i] = node->skewNextTarget;
+			if (++node->skewNextTarget >= h->numsegs)
+				node->skewNextTarget = 0;
+		}
+	}
+}
+
+/*
+ * End of the sample of a spreading Motion.
+ *
+ * The hot keys come from the planner's statistics, which may be stale or
+ * describe the whole table rather than the rows that reach the join. Keep
+ * spreading only those that made up at least gp_motion_skew_threshold of
+ * the sampled rows. The other input still broadcasts the rows of the keys
+ * dropped here, which costs some traffic but no correctness: each row sent
+ * to its hash segment still meets all its partners there.
+ *
+ * NULL keys match nothing, so they are spread if the sample finds them hot
+ * even where the statistics did not.
+ */
+static void
+confirmSkewedKeys(Motion *motion, MotionState *node)
+{
+	double		minrows = gp_motion_skew_threshold * node->skewSampleRows;
+	int			nhot = 0;
+	int			j;
+
+	for (j = 0; j <= node->numSkewHashes; j++)
+	{
+		node->skewHot[j] = (node->skewSampleCounts[j] > 0 &&
+							node->skewSampleCounts[j] >= minrows);
+		if (node->skewHot[j] && j < node->numSkewHashes)
+			nhot++;
+	}
+
+	elog(DEBUG1, "motionID=%d spreads %d of %d hot join keys%s after sampling %d rows",
+		 motion->motionID, nhot, node->numSkewHashes,
+		 node->skewHot[node->numSkewHashes] ? " and NULL keys" : "",
+		 node->skewSampleRows);
+}
+
+/*
+ * Send all tuples of the send batch.
+ *
+ * The hash keys of the whole batch, evaluated by addTupleToSendBatch(), are
+ * hashed column by column with cdbhashbatch(). The tuples are then grouped
+ * by target segment, keeping their original order within each target, and
+ * each group is copied into its connection in one go.
+ *
+ * If lastSlot is given, the last tuple of the batch is not in the batch
+ * buffer but still in lastSlot, and is sent from there.
+ */
+static void
+doSendTupleBatch(Motion *motion, MotionState *node, TupleTableSlot *lastSlot)
+{
+	ExprContext *econtext = node->ps.ps_ExprContext;
+	CdbHash    *h = node->cdbhash;
+	int			nrows = node->sendBatchCount;
+	int		   *offsets = node->sendBatchOffsets;
+	int			ntargets = h->numsegs;
+	MemoryContext oldContext;
+	int			seg;
+	int			i;
+
+	node->sendBatchCount = 0;
+	node->sendBatchBufUsed = 0;
+	if (nrows == 0)
+		return;
+
+	/* a short batch: close the gaps between the key columns */
+	for (i = 1; nrows < node->sendBatchSize && i < h->natts; i++)
+	{
+		memmove(&node->sendBatchValues[i * nrows],
+				&node->sendBatchValues[i * node->sendBatchSize],
+				nrows * sizeof(Datum));
+		memmove(&node->sendBatchIsnull[i * nrows],
+				&node->sendBatchIsnull[i * node->sendBatchSize],
+				nrows * sizeof(bool));
+	}
+
+	oldContext = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+
+	if (motion->skewMode == MOTIONSKEW_NONE)
+		cdbhashbatch(h, nrows, node->sendBatchValues, node->sendBatchIsnull,
+					 node->sendBatchTargets);
+	else
+	{
+		cdbhashbatchraw(h, nrows, node->sendBatchValues, node->sendBatchIsnull,
+						(uint32 *) node->sendBatchTargets);
+		routeSkewedBatch(motion, node, nrows);
+		if (motion->skewMode == MOTIONSKEW_BROADCAST)
+			ntargets++;
+	}
+
+	MemoryContextSwitchTo(oldContext);
+
+	/* counting sort of the tuples by target segment */
+	memset(offsets, 0, (ntargets + 1) * sizeof(int));
+	for (i = 0; i < nrows; i++)
+	{
+		Assert(node->sendBatchTargets[i] < ntargets &&
+			   "redistribute destination outside segment array");
+		offsets[node->sendBatchTargets[i] + 1]++;
+	}
+	for (seg = 0; seg < ntargets; seg++)
+		offsets[seg + 1] += offsets[seg];
+	for (i = 0; i < nrows; i++)
+		node->sendBatchOrder[offsets[node->sendBatchTargets[i]]++] = i;
+
+	for (i = 0; i < nrows && !node->stopRequested; i++)
+	{
+		int			row = node->sendBatchOrder[i];
+		unsigned int target = node->sendBatchTargets[row];
+		int16		targetRoute;
+
+		targetRoute = (target == h->numsegs) ? BROADCAST_SEGIDX : (int16) target;
+
+		if (node->sendBatchChunkLen[row] > 0)
+			doSendSerializedTupleToRoute(motion, node,
+										 node->sendBatchBuf + node->sendBatchChunkStart[row],
+										 node->sendBatchChunkLen[row],
+										 targetRoute);
+		else
+		{
+			Assert(lastSlot != NULL && row == nrows - 1);
+			doSendTupleToRoute(motion, node, lastSlot, targetRoute);
+		}
+	}
+}
+
 
 /*
  * ExecReScanMotion
@@ -1742,3 +2225,16 @@ ExecSquelchMotion(MotionState *node)
 					node->ps.state->interconnect_context,
 					motion->motionID);
 }
+
+/*
+ * ExecMotionExplainEnd
+ *		Called before ExecEndMotion() when EXPLAIN ANALYZE collects statistics.
+ */
+static void
+ExecMotionExplainEnd(PlanState *planstate, struct StringInfoData *buf)
+{
+	Motion	   *motion = (Motion *) planstate->plan;
+
+	ExplainMotionCompression(planstate->state->motionlayer_context,
+							 motion->motionID, buf);
+}
@@ -27,7 +27,11 @@
 #include "access/relscan.h"
 #include "executor/execdebug.h"
 #include "executor/nodeSeqscan.h"
+#include "lib/stringinfo.h"
+#include "utils/guc.h"
+#include "utils/lsyscache.h"
 #include "utils/rel.h"
+#include "utils/typcache.h"
 
 #include "cdb/cdbappendonlyam.h"
 #include "cdb/cdbaocsam.h"
@@ -37,6 +41,8 @@ static void InitScanRelation(SeqScanState *node, EState *estate, int eflags, Rel
 static TupleTableSlot *SeqNext(SeqScanState *node);
 
 static void InitAOCSScanOpaque(SeqScanState *scanState, Relation currentRelation);
+static void InitAOCSScanKeys(SeqScanState *node, Relation currentRelation);
+static void ExecSeqScanExplainEnd(PlanState *planstate, struct StringInfoData *buf);
 
 /* ----------------------------------------------------------------
  *						Scan Support
@@ -184,6 +190,8 @@ InitScanRelation(SeqScanState *node, EState *estate, int eflags, Relation curren
 						   appendOnlyMetaDataSnapshot,
 						   NULL /* relationTupleDesc */,
 						   node->ss_aocs_proj);
+
+		InitAOCSScanKeys(node, currentRelation);
 	}
 	else
 	{
@@ -396,3 +404,184 @@ InitAOCSScanOpaque(SeqScanState *scanstate, Relation currentRelation)
 	scanstate->ss_aocs_ncol = ncol;
 	scanstate->ss_aocs_proj = proj;
 }
+
+/*
+ * Turn a scan qual into a scan key, if it is a "column op constant" or
+ * "column IS [NOT] NULL" clause on a column that can have block zones.
+ */
+static bool
+MakeAOCSScanKey(Expr *clause, Relation rel, ScanKey key)
+{
+	Var		   *var;
+	Form_pg_attribute attr;
+	TypeCacheEntry *typentry;
+
+	if (IsA(clause, NullTest))
+	{
+		NullTest   *ntest = (NullTest *) clause;
+
+		if (ntest->argisrow || !IsA(ntest->arg, Var))
+			return false;
+		var = (Var *) ntest->arg;
+		if (var->varattno <= 0 || var->varattno > rel->rd_att->natts)
+			return false;
+		attr = rel->rd_att->attrs[var->varattno - 1];
+		if (!attr->attbyval || attr->attlen <= 0)
+			return false;
+
+		ScanKeyEntryInitialize(key,
+							   SK_ISNULL | (ntest->nulltesttype == IS_NULL ?
+											SK_SEARCHNULL : SK_SEARCHNOTNULL),
+							   var->varattno,
+							   InvalidStrategy,
+							   InvalidOid,
+							   InvalidOid,
+							   InvalidOid,
+							   (Datum) 0);
+		return true;
+	}
+
+	if (IsA(clause, OpExpr) && list_length(((OpExpr *) clause)->args) == 2)
+	{
+		OpExpr	   *op = (OpExpr *) clause;
+		Node	   *leftop = (Node *) linitial(op->args);
+		Node	   *rightop = (Node *) lsecond(op->args);
+		Const	   *con;
+		Oid			opno = op->opno;
+		Oid			lefttype;
+		Oid			righttype;
+		int			strategy;
+
+		if (leftop && IsA(leftop, RelabelType))
+			leftop = (Node *) ((RelabelType *) leftop)->arg;
+		if (rightop && IsA(rightop, RelabelType))
+			rightop = (Node *) ((RelabelType *) rightop)->arg;
+
+		if (IsA(leftop, Var) && IsA(rightop, Const))
+		{
+			var = (Var *) leftop;
+			con = (Const *) rightop;
+		}
+		else if (IsA(leftop, Const) && IsA(rightop, Var))
+		{
+			var = (Var *) rightop;
+			con = (Const *) leftop;
+			opno = get_commutator(opno);
+			if (!OidIsValid(opno))
+				return false;
+		}
+		else
+			return false;
+
+		if (con->constisnull)
+			return false;
+		if (var->varattno <= 0 || var->varattno > rel->rd_att->natts)
+			return false;
+		attr = rel->rd_att->attrs[var->varattno - 1];
+		if (!attr->attbyval || attr->attlen <= 0)
+			return false;
+
+		/*
+		 * The zones are ordered by the default btree opclass of the column
+		 * type, so only operators of that opclass, on its input type, can
+		 * be checked against them.
+		 */
+		typentry = lookup_type_cache(attr->atttypid,
+									 TYPECACHE_BTREE_OPFAMILY |
+									 TYPECACHE_CMP_PROC);
+		if (!OidIsValid(typentry->btree_opf) ||
+			!OidIsValid(typentry->cmp_proc))
+			return false;
+
+		op_input_types(opno, &lefttype, &righttype);
+		if (lefttype != typentry->btree_opintype ||
+			righttype != typentry->btree_opintype)
+			return false;
+
+		strategy = get_op_opfamily_strategy(opno, typentry->btree_opf);
+		if (strategy == InvalidStrategy)
+			return false;
+
+		ScanKeyEntryInitialize(key,
+							   0,
+							   var->varattno,
+							   strategy,
+							   InvalidOid,
+							   op->inputcollid,
+							   typentry->cmp_proc,
+							   con->constvalue);
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * Hand the simple quals of an AOCS scan to the access method, so that it
+ * can skip blocks using the zones recorded in the block directory, and
+ * filter the rows of each batch it decodes.
+ */
+static void
+InitAOCSScanKeys(SeqScanState *node, Relation currentRelation)
+{
+	List	   *qual = node->ss.ps.plan->qual;
+	ScanKey		keys;
+	int			nkeys = 0;
+	ListCell   *lc;
+	bool		useZones;
+
+	useZones = gp_appendonly_zone_maps &&
+		OidIsValid(currentRelation->rd_appendonly->blkdirrelid);
+
+	if (qual == NIL ||
+		(!useZones && node->ss_currentScanDesc_aocs->batchSize == 0))
+		return;
+
+	keys = palloc(list_length(qual) * sizeof(ScanKeyData));
+	foreach(lc, qual)
+	{
+		if (MakeAOCSScanKey((Expr *) lfirst(lc), currentRelation, &keys[nkeys]))
+			nkeys++;
+	}
+
+	if (nkeys == 0)
+	{
+		pfree(keys);
+		return;
+	}
+
+	aocs_set_scankeys(node->ss_currentScanDesc_aocs, nkeys, keys);
+
+	/* Report the skipped blocks in EXPLAIN ANALYZE. */
+	if ((useZones || node->ss_currentScanDesc_aocs->numLateAtts > 0) &&
+		node->ss.ps.state->es_instrument &&
+		(node->ss.ps.state->es_instrument & INSTRUMENT_CDB))
+	{
+		node->ss.ps.cdbexplainbuf = makeStringInfo();
+		node->ss.ps.cdbexplainfun = ExecSeqScanExplainEnd;
+	}
+}
+
+/*
+ * ExecSeqScanExplainEnd
+ *      Called before ExecutorEnd to finish EXPLAIN ANALYZE reporting.
+ */
+static void
+ExecSeqScanExplainEnd(PlanState *planstate, struct StringInfoData *buf)
+{
+	SeqScanState *node = (SeqScanState *) planstate;
+	AOCSScanDesc scan = node->ss_currentScanDesc_aocs;
+
+	if (scan == NULL)
+		return;
+
+	if (gp_appendonly_zone_maps &&
+		OidIsValid(scan->aos_rel->rd_appendonly->blkdirrelid))
+		appendStringInfo(planstate->cdbexplainbuf,
+						 INT64_FORMAT " blocks skipped by zone maps.\n",
+						 scan->zoneBlocksSkipped);
+	if (scan->numLateAtts > 0)
+		appendStringInfo(planstate->cdbexplainbuf,
+						 INT64_FORMAT " blocks skipped by late materialization.\n",
+						 scan->lateBlocksSkipped);
+}
@@ -0,0 +1,255 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include "cmockery.h"
+
+#include "postgres.h"
+#include "utils/memutils.h"
+
+#include "../nodeMotion.c"
+
+/* Column 2 of a test tuple: which stream it came from, and where */
+#define STREAM_POS(stream, pos) ((stream) * 100000 + (pos))
+
+static int
+test_int4_cmp(Datum a, Datum b, SortSupport ssup)
+{
+	int32		x = DatumGetInt32(a);
+	int32		y = DatumGetInt32(b);
+
+	return (x > y) - (x < y);
+}
+
+static void
+init_int4_attr(TupleDesc tupdesc, int attnum)
+{
+	Form_pg_attribute att = tupdesc->attrs[attnum - 1];
+
+	MemSet(att, 0, ATTRIBUTE_FIXED_PART_SIZE);
+	att->atttypid = INT4OID;
+	att->attlen = sizeof(int32);
+	att->attbyval = true;
+	att->attalign = 'i';
+	att->attstorage = 'p';
+	att->attnum = attnum;
+	att->attcacheoff = -1;
+	att->atttypmod = -1;
+}
+
+/*
+ * A merge context sorting on column 1 of (key int4, stream_pos int4), set
+ * up without the catalog lookups of CdbMergeComparator_CreateContext().
+ */
+static CdbMergeComparatorContext *
+make_merge_context(int numStreams)
+{
+	CdbMergeComparatorContext *ctx = palloc0(sizeof(*ctx));
+	int			i;
+
+	ctx->numSortCols = 1;
+	ctx->tupDesc = CreateTemplateTupleDesc(2, false);
+	init_int4_attr(ctx->tupDesc, 1);
+	init_int4_attr(ctx->tupDesc, 2);
+
+	ctx->sortKeys = palloc0(sizeof(SortSupportData));
+	ctx->sortKeys[0].ssup_cxt = CurrentMemoryContext;
+	ctx->sortKeys[0].ssup_attno = 1;
+	ctx->sortKeys[0].comparator = test_int4_cmp;
+
+	ctx->numStreams = numStreams;
+	ctx->losers = palloc0(numStreams * sizeof(int));
+	ctx->tupleheap_entries = palloc0(numStreams * sizeof(CdbTupleHeapInfo));
+	for (i = 0; i < numStreams; i++)
+	{
+		ctx->tupleheap_entries[i].datums = palloc(sizeof(Datum));
+		ctx->tupleheap_entries[i].isnulls = palloc(sizeof(bool));
+	}
+
+	return ctx;
+}
+
+static GenericTuple
+make_tuple(CdbMergeComparatorContext *ctx, int key, int stream, int pos)
+{
+	Datum		values[2];
+	bool		nulls[2] = {false, false};
+
+	values[0] = Int32GetDatum(key);
+	values[1] = Int32GetDatum(STREAM_POS(stream, pos));
+
+	return (GenericTuple) heap_form_tuple(ctx->tupDesc, values, nulls);
+}
+
+/* The next tuple of stream s, or NULL at its end */
+static GenericTuple
+next_tuple(CdbMergeComparatorContext *ctx, int **keys, int *lens, int *pos, int s)
+{
+	GenericTuple tuple;
+
+	if (pos[s] == lens[s])
+		return NULL;
+	tuple = make_tuple(ctx, keys[s][pos[s]], s, pos[s]);
+	pos[s]++;
+	return tuple;
+}
+
+/*
+ * Merge the sorted streams keys[0..numStreams-1] the way
+ * execMotionSortedReceiver() does, and check that the rows come out sorted
+ * by key, ties in stream order, and each stream's rows in their own order.
+ */
+static void
+check_merge(int numStreams, int **keys, int *lens)
+{
+	CdbMergeComparatorContext *ctx = make_merge_context(numStreams);
+	int		   *pos = palloc0(numStreams * sizeof(int));
+	int			total = 0;
+	int			merged = 0;
+	int			prev_key = PG_INT32_MIN;
+	int			prev_stream_pos = -1;
+	int			s;
+
+	for (s = 0; s < numStreams; s++)
+	{
+		total += lens[s];
+		CdbMergeSetHead(ctx, s, next_tuple(ctx, keys, lens, pos, s));
+	}
+	CdbMergeBuild(ctx);
+
+	for (;;)
+	{
+		int			winner = ctx->losers[0];
+		HeapTuple	tuple = (HeapTuple) ctx->tupleheap_entries[winner].tuple;
+		bool		isnull;
+		int			key;
+		int			stream_pos;
+
+		if (tuple == NULL)
+			break;
+
+		key = DatumGetInt32(heap_getattr(tuple, 1, ctx->tupDesc, &isnull));
+		stream_pos = DatumGetInt32(heap_getattr(tuple, 2, ctx->tupDesc, &isnull));
+		assert_int_equal(stream_pos / 100000, winner);
+
+		assert_true(key >= prev_key);
+		if (key == prev_key)
+			assert_true(stream_pos > prev_stream_pos);
+		prev_key = key;
+		prev_stream_pos = stream_pos;
+		merged++;
+
+		heap_freetuple(tuple);
+		CdbMergeSetHead(ctx, winner, next_tuple(ctx, keys, lens, pos, winner));
+		CdbMergeReplay(ctx, winner);
+	}
+
+	assert_int_equal(merged, total);
+	for (s = 0; s < numStreams; s++)
+		assert_int_equal(pos[s], lens[s]);
+
+	pfree(pos);
+	CdbMergeComparator_DestroyContext(ctx);
+}
+
+/*
+ * Many senders, as with a gather from a large cluster: keys from a small
+ * range, so there are plenty of ties, and some streams are empty.
+ */
+static void
+test__CdbMerge__many_senders(void **state)
+{
+	int			counts[] = {200, 129, 128, 3, 2};
+	uint32		x = 12345;
+	int			c;
+
+	for (c = 0; c < lengthof(counts); c++)
+	{
+		int			numStreams = counts[c];
+		int		  **keys = palloc(numStreams * sizeof(int *));
+		int		   *lens = palloc(numStreams * sizeof(int));
+		int			s;
+
+		for (s = 0; s < numStreams; s++)
+		{
+			int			key = 0;
+			int			i;
+
+			x = x * 1103515245 + 12345;
+			lens[s] = (x >> 16) % 40;
+			if (s % 7 == 3)
+				lens[s] = 0;
+			keys[s] = palloc((lens[s] + 1) * sizeof(int));
+			for (i = 0; i < lens[s]; i++)
+			{
+				x = x * 1103515245 + 12345;
+				key += (x >> 16) % 3;
+				keys[s][i] = key;
+			}
+		}
+
+		check_merge(numStreams, keys, lens);
+
+		for (s = 0; s < numStreams; s++)
+			pfree(keys[s]);
+		pfree(keys);
+		pfree(lens);
+	}
+}
+
+/* All keys equal: the streams come out one after the other, in order */
+static void
+test__CdbMerge__all_ties(void **state)
+{
+	int			numStreams = 7;
+	int		  **keys = palloc(numStreams * sizeof(int *));
+	int			lens[] = {3, 0, 5, 1, 0, 2, 4};
+	int			s;
+
+	for (s = 0; s < numStreams; s++)
+	{
+		int			i;
+
+		keys[s] = palloc((lens[s] + 1) * sizeof(int));
+		for (i = 0; i < lens[s]; i++)
+			keys[s][i] = 42;
+	}
+
+	check_merge(numStreams, keys, lens);
+}
+
+/* Every stream is empty, or all but the last one */
+static void
+test__CdbMerge__empty_streams(void **state)
+{
+	int			numStreams = 5;
+	int		  **keys = palloc(numStreams * sizeof(int *));
+	int			lens[] = {0, 0, 0, 0, 0};
+	int			last[] = {1, 2, 3};
+	int			s;
+
+	for (s = 0; s < numStreams; s++)
+		keys[s] = palloc(sizeof(int));
+
+	check_merge(numStreams, keys, lens);
+	check_merge(1, keys, lens);
+
+	keys[numStreams - 1] = last;
+	lens[numStreams - 1] = lengthof(last);
+	check_merge(numStreams, keys, lens);
+}
+
+int
+main(int argc, char *argv[])
+{
+	cmockery_parse_arguments(argc, argv);
+
+	const		UnitTest tests[] = {
+		unit_test(test__CdbMerge__many_senders),
+		unit_test(test__CdbMerge__all_ties),
+		unit_test(test__CdbMerge__empty_streams)
+	};
+
+	MemoryContextInit();
+
+	return run_tests(tests);
+}
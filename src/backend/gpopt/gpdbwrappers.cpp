@@ -2456,6 +2456,33 @@ gpdb::EvalConstExpressions(Node *node)
 	return NULL;
 }
 
+Const *
+gpdb::MakeArrayConst(Oid array_type, Oid elem_type, Oid array_collid,
+					 Datum *values, bool *nulls, int num_values)
+{
+	GP_WRAP_START;
+	{
+		int16 elem_len;
+		bool elem_byval;
+		char elem_align;
+		int dims[1];
+		int lbs[1];
+
+		get_typlenbyvalalign(elem_type, &elem_len, &elem_byval, &elem_align);
+		dims[0] = num_values;
+		lbs[0] = 1;
+
+		ArrayType *array =
+			construct_md_array(values, nulls, 1, dims, lbs, elem_type,
+							   elem_len, elem_byval, elem_align);
+
+		return makeConst(array_type, -1, array_collid, -1,
+						 PointerGetDatum(array), false, false);
+	}
+	GP_WRAP_END;
+	return NULL;
+}
+
 SelectedParts *
 gpdb::RunStaticPartitionSelection(PartitionSelector *ps)
 {
@@ -2089,7 +2089,8 @@ CTranslatorDXLToScalar::TranslateDXLScalarCmpToScalar(
 //		CTranslatorDXLToScalar::TranslateDXLScalarArrayToScalar
 //
 //	@doc:
-//		Translates a DXL scalar array into a GPDB ArrayExpr node
+//		Translates a DXL scalar array into a GPDB array Const, or into an
+//		ArrayExpr node if some of its elements are not constants
 //
 //---------------------------------------------------------------------------
 Expr *
@@ -2100,11 +2101,41 @@ CTranslatorDXLToScalar::TranslateDXLScalarArrayToScalar(
 	CDXLScalarArray *dxlop =
 		CDXLScalarArray::Cast(scalar_array_node->GetOperator());
 
-	ArrayExpr *expr = MakeNode(ArrayExpr);
-	expr->element_typeid = CMDIdGPDB::CastMdid(dxlop->ElementTypeMDid())->Oid();
-	expr->array_typeid = CMDIdGPDB::CastMdid(dxlop->ArrayTypeMDid())->Oid();
+	Oid elem_type = CMDIdGPDB::CastMdid(dxlop->ElementTypeMDid())->Oid();
+	Oid array_type = CMDIdGPDB::CastMdid(dxlop->ArrayTypeMDid())->Oid();
 	// GPDB_91_MERGE_FIXME: collation
-	expr->array_collid = gpdb::TypeCollation(expr->array_typeid);
+	Oid array_collid = gpdb::TypeCollation(array_type);
+
+	if (!dxlop->IsMultiDimensional() && IsConstArray(scalar_array_node))
+	{
+		// build the array constant straight from the element values, there
+		// is no need to go through an ArrayExpr of one Const per element
+		const ULONG arity = scalar_array_node->Arity();
+		Datum *values = (Datum *) gpdb::GPDBAlloc(arity * sizeof(Datum));
+		bool *nulls = (bool *) gpdb::GPDBAlloc(arity * sizeof(bool));
+		for (ULONG ul = 0; ul < arity; ul++)
+		{
+			CDXLScalarConstValue *const_op = CDXLScalarConstValue::Cast(
+				(*scalar_array_node)[ul]->GetOperator());
+			Const *constant = (Const *) TranslateDXLDatumToScalar(
+				const_cast<CDXLDatum *>(const_op->GetDatumVal()));
+			values[ul] = constant->constvalue;
+			nulls[ul] = constant->constisnull;
+			gpdb::GPDBFree(constant);
+		}
+
+		Const *array_const = gpdb::MakeArrayConst(
+			array_type, elem_type, array_collid, values, nulls, (int) arity);
+		gpdb::GPDBFree(values);
+		gpdb::GPDBFree(nulls);
+
+		return (Expr *) array_const;
+	}
+
+	ArrayExpr *expr = MakeNode(ArrayExpr);
+	expr->element_typeid = elem_type;
+	expr->array_typeid = array_type;
+	expr->array_collid = array_collid;
 	expr->multidims = dxlop->IsMultiDimensional();
 	expr->elements =
 		TranslateScalarChildren(expr->elements, scalar_array_node, colid_var);
@@ -2346,4 +2377,36 @@ CTranslatorDXLToScalar::HasConstNull(CDXLNode *dxlnode)
 	return dxlop->GetDatumVal()->IsNull();
 }
 
+//---------------------------------------------------------------------------
+//	@function:
+//		CTranslatorDXLToScalar::IsConstArray
+//
+//	@doc:
+//		Check if the operator is a non-empty array whose elements are all
+//		constants
+//
+//---------------------------------------------------------------------------
+BOOL
+CTranslatorDXLToScalar::IsConstArray(const CDXLNode *scalar_array_node)
+{
+	GPOS_ASSERT(NULL != scalar_array_node);
+
+	const ULONG arity = scalar_array_node->Arity();
+	if (0 == arity)
+	{
+		return false;
+	}
+
+	for (ULONG ul = 0; ul < arity; ul++)
+	{
+		if (EdxlopScalarConstValue !=
+			(*scalar_array_node)[ul]->GetOperator()->GetDXLOperator())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
 // EOF
@@ -1867,7 +1867,42 @@ CTranslatorScalarToDXL::TranslateArrayExprToDXL(
 
 	CDXLNode *dxlnode = GPOS_NEW(m_mp) CDXLNode(m_mp, dxlop);
 
-	TranslateScalarChildren(dxlnode, parrayexpr->elements, var_colid_mapping);
+	// Arrays of constants, such as large IN lists, are translated in bulk:
+	// the element type is looked up once instead of once per element.
+	ListCell *lc = NULL;
+	BOOL all_consts = !parrayexpr->multidims;
+	ForEach(lc, parrayexpr->elements)
+	{
+		Node *elem = (Node *) lfirst(lc);
+		if (!IsA(elem, Const) ||
+			((Const *) elem)->consttype != parrayexpr->element_typeid)
+		{
+			all_consts = false;
+			break;
+		}
+	}
+
+	if (!all_consts)
+	{
+		TranslateScalarChildren(dxlnode, parrayexpr->elements,
+								var_colid_mapping);
+		return dxlnode;
+	}
+
+	CMDIdGPDB *elem_mdid = GPOS_NEW(m_mp)
+		CMDIdGPDB(IMDId::EmdidGeneral, parrayexpr->element_typeid);
+	const IMDType *md_type = m_md_accessor->RetrieveType(elem_mdid);
+	elem_mdid->Release();
+
+	ForEach(lc, parrayexpr->elements)
+	{
+		const Const *constant = (Const *) lfirst(lc);
+		CDXLDatum *datum_dxl = TranslateDatumToDXL(
+			m_mp, md_type, constant->consttypmod, constant->constisnull,
+			constant->constlen, constant->constvalue);
+		dxlnode->AddChild(GPOS_NEW(m_mp) CDXLNode(
+			m_mp, GPOS_NEW(m_mp) CDXLScalarConstValue(m_mp, datum_dxl)));
+	}
 
 	return dxlnode;
 }
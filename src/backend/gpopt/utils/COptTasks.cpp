@@ -357,6 +357,78 @@ COptTasks::LoadSearchStrategy(CMemoryPool *mp, char *path)
 	return search_strategy_arr;
 }
 
+//---------------------------------------------------------------------------
+//	@function:
+//		COptTasks::IsSimpleQuery
+//
+//	@doc:
+//		Check if the query is a select from a single, non-partitioned and
+//		non-inherited relation with at most a filter, a projection, an
+//		ordering and a limit on top of it. For such queries no join order,
+//		aggregate, subquery or partition exploration can apply, so the only
+//		plan alternatives come from index and limit xforms
+//
+//---------------------------------------------------------------------------
+BOOL
+COptTasks::IsSimpleQuery(const Query *query)
+{
+	if (CMD_SELECT != query->commandType || NULL != query->utilityStmt ||
+		query->hasAggs || query->hasWindowFuncs || query->hasSubLinks ||
+		query->hasModifyingCTE || query->hasForUpdate ||
+		query->hasFuncsWithExecRestrictions || NULL != query->cteList ||
+		NULL != query->groupClause || NULL != query->havingQual ||
+		NULL != query->windowClause || NULL != query->distinctClause ||
+		NULL != query->scatterClause || NULL != query->rowMarks ||
+		NULL != query->setOperations)
+	{
+		return false;
+	}
+
+	if (1 != gpdb::ListLength(query->rtable) || NULL == query->jointree ||
+		1 != gpdb::ListLength(query->jointree->fromlist) ||
+		!IsA(gpdb::ListNth(query->jointree->fromlist, 0), RangeTblRef))
+	{
+		return false;
+	}
+
+	RangeTblEntry *rte = (RangeTblEntry *) gpdb::ListNth(query->rtable, 0);
+	if (RTE_RELATION != rte->rtekind)
+	{
+		return false;
+	}
+
+	return gpdb::RelPartIsNone(rte->relid) &&
+		   !(rte->inh && gpdb::HasSubclassSlow(rte->relid));
+}
+
+//---------------------------------------------------------------------------
+//	@function:
+//		COptTasks::CreateSimpleQuerySearchStrategy
+//
+//	@doc:
+//		Generate a single stage search strategy for simple queries. Every
+//		search stage includes all implementation xforms; the only exploration
+//		kept is the one that produces index, bitmap and local limit
+//		alternatives, so plans are still chosen by cost among the available
+//		access paths
+//
+//---------------------------------------------------------------------------
+CSearchStageArray *
+COptTasks::CreateSimpleQuerySearchStrategy(CMemoryPool *mp)
+{
+	CXformSet *xform_set = GPOS_NEW(mp) CXformSet(mp);
+	(void) xform_set->ExchangeSet(CXform::ExfSelect2IndexGet);
+	(void) xform_set->ExchangeSet(CXform::ExfSelect2BitmapBoolOp);
+	(void) xform_set->ExchangeSet(CXform::ExfSplitLimit);
+	(void) xform_set->ExchangeSet(CXform::ExfCollapseProject);
+
+	CSearchStageArray *search_strategy_arr =
+		GPOS_NEW(mp) CSearchStageArray(mp);
+	search_strategy_arr->Append(GPOS_NEW(mp) CSearchStage(xform_set));
+
+	return search_strategy_arr;
+}
+
 //---------------------------------------------------------------------------
 //	@function:
 //		COptTasks::CreateOptimizerConfig
@@ -444,6 +516,31 @@ COptTasks::SetCostModelParams(ICostModel *cost_model)
 			cost_param->GetLowerBoundVal() * optimizer_sort_factor,
 			cost_param->GetUpperBoundVal() * optimizer_sort_factor);
 	}
+
+	if (gp_motion_compression && (optimizer_motion_compression_factor > 1.0 ||
+								  optimizer_motion_compression_factor < 1.0))
+	{
+		// motion compression shrinks the bytes moved per tuple; scale the
+		// network cost of motions by the configured compression ratio
+		const CDouble motion_factor(optimizer_motion_compression_factor);
+		const CCostModelParamsGPDB::ECostParam motion_params[] = {
+			CCostModelParamsGPDB::EcpGatherSendCostUnit,
+			CCostModelParamsGPDB::EcpGatherRecvCostUnit,
+			CCostModelParamsGPDB::EcpRedistributeSendCostUnit,
+			CCostModelParamsGPDB::EcpRedistributeRecvCostUnit,
+			CCostModelParamsGPDB::EcpBroadcastSendCostUnit,
+			CCostModelParamsGPDB::EcpBroadcastRecvCostUnit};
+
+		for (ULONG ul = 0; ul < GPOS_ARRAY_SIZE(motion_params); ul++)
+		{
+			ICostModelParams::SCostParam *cost_param =
+				cost_model->GetCostModelParams()->PcpLookup(motion_params[ul]);
+			cost_model->GetCostModelParams()->SetParam(
+				cost_param->Id(), cost_param->Get() * motion_factor,
+				cost_param->GetLowerBoundVal() * motion_factor,
+				cost_param->GetUpperBoundVal() * motion_factor);
+		}
+	}
 }
 
 
@@ -514,9 +611,17 @@ COptTasks::OptimizeTask(void *ptr)
 	}
 
 
-	// load search strategy
+	// load search strategy; simple queries get a reduced search unless the
+	// user supplied a strategy of their own
 	CSearchStageArray *search_strategy_arr =
 		LoadSearchStrategy(mp, optimizer_search_strategy_path);
+	if (NULL == search_strategy_arr &&
+		optimizer_enable_simple_query_fast_path &&
+		IsSimpleQuery(opt_ctxt->m_query))
+	{
+		elog(DEBUG2, "[OPT]: Using simple query search strategy");
+		search_strategy_arr = CreateSimpleQuerySearchStrategy(mp);
+	}
 
 	CBitSet *trace_flags = NULL;
 	CBitSet *enabled_trace_flags = NULL;
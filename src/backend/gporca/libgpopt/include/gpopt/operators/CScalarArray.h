@@ -16,11 +16,13 @@
 #include "gpopt/operators/CScalar.h"
 #include "gpopt/operators/CScalarConst.h"
 #include "naucrates/md/IMDId.h"
+#include "naucrates/statistics/CPoint.h"
 
 namespace gpopt
 {
 using namespace gpos;
 using namespace gpmd;
+using namespace gpnaucrates;
 
 typedef CDynamicPtrArray<CScalarConst, CleanupRelease> CScalarConstArray;
 
@@ -47,6 +49,13 @@ private:
 	// const values
 	CScalarConstArray *m_pdrgPconst;
 
+	// sorted and de-duplicated non-null const values as stats points,
+	// derived on first request
+	CPointArray *m_pdrgppointSorted;
+
+	// have sorted points been derived
+	BOOL m_fSortedPointsDerived;
+
 	// private copy ctor
 	CScalarArray(const CScalarArray &);
 
@@ -125,6 +134,10 @@ public:
 	// CScalarConst array
 	CScalarConstArray *PdrgPconst() const;
 
+	// sorted and de-duplicated points of the const values, NULL if some
+	// const value is not comparable for stats purposes
+	CPointArray *PdrgppointSorted();
+
 	// print
 	IOstream &OsPrint(IOstream &os) const;
 
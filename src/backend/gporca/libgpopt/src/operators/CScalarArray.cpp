@@ -14,6 +14,7 @@
 #include "gpos/base.h"
 
 #include "gpopt/base/CColRefSet.h"
+#include "gpopt/base/CUtils.h"
 #include "gpopt/base/CDrvdPropScalar.h"
 #include "gpopt/operators/CExpressionHandle.h"
 #include "naucrates/md/IMDAggregate.h"
@@ -28,7 +29,9 @@ CScalarArray::CScalarArray(CMemoryPool *mp, IMDId *elem_type_mdid,
 	: CScalar(mp),
 	  m_pmdidElem(elem_type_mdid),
 	  m_pmdidArray(array_type_mdid),
-	  m_fMultiDimensional(is_multidimenstional)
+	  m_fMultiDimensional(is_multidimenstional),
+	  m_pdrgppointSorted(NULL),
+	  m_fSortedPointsDerived(false)
 {
 	GPOS_ASSERT(elem_type_mdid->IsValid());
 	GPOS_ASSERT(array_type_mdid->IsValid());
@@ -44,7 +47,9 @@ CScalarArray::CScalarArray(CMemoryPool *mp, IMDId *elem_type_mdid,
 	  m_pmdidElem(elem_type_mdid),
 	  m_pmdidArray(array_type_mdid),
 	  m_fMultiDimensional(is_multidimenstional),
-	  m_pdrgPconst(pdrgPconst)
+	  m_pdrgPconst(pdrgPconst),
+	  m_pdrgppointSorted(NULL),
+	  m_fSortedPointsDerived(false)
 {
 	GPOS_ASSERT(elem_type_mdid->IsValid());
 	GPOS_ASSERT(array_type_mdid->IsValid());
@@ -56,6 +61,7 @@ CScalarArray::~CScalarArray()
 	m_pmdidElem->Release();
 	m_pmdidArray->Release();
 	m_pdrgPconst->Release();
+	CRefCount::SafeRelease(m_pdrgppointSorted);
 }
 
 //---------------------------------------------------------------------------
@@ -174,6 +180,67 @@ CScalarArray::PdrgPconst() const
 	return m_pdrgPconst;
 }
 
+//---------------------------------------------------------------------------
+//	@function:
+//		CScalarArray::PdrgppointSorted
+//
+//	@doc:
+//		Sorted and de-duplicated non-null const values as stats points.
+//		Stats of an IN list are derived many times during optimization, so
+//		the array is sorted once here rather than on every derivation
+//
+//---------------------------------------------------------------------------
+CPointArray *
+CScalarArray::PdrgppointSorted()
+{
+	if (m_fSortedPointsDerived)
+	{
+		return m_pdrgppointSorted;
+	}
+	m_fSortedPointsDerived = true;
+
+	const ULONG size = m_pdrgPconst->Size();
+	CPointArray *pdrgppoint = GPOS_NEW(m_mp) CPointArray(m_mp, size);
+	for (ULONG ul = 0; ul < size; ul++)
+	{
+		IDatum *datum = (*m_pdrgPconst)[ul]->GetDatum();
+		if (!datum->StatsAreComparable(datum))
+		{
+			pdrgppoint->Release();
+			return NULL;
+		}
+		if (datum->IsNull())
+		{
+			continue;
+		}
+		datum->AddRef();
+		pdrgppoint->Append(GPOS_NEW(m_mp) CPoint(datum));
+	}
+
+	if (1 < pdrgppoint->Size())
+	{
+		pdrgppoint->Sort(&CUtils::CPointCmp);
+	}
+
+	m_pdrgppointSorted = GPOS_NEW(m_mp) CPointArray(m_mp, pdrgppoint->Size());
+	IDatum *prev_datum = NULL;
+	for (ULONG ul = 0; ul < pdrgppoint->Size(); ul++)
+	{
+		CPoint *point = (*pdrgppoint)[ul];
+		IDatum *datum = point->GetDatum();
+		if (NULL != prev_datum && prev_datum->StatsAreEqual(datum))
+		{
+			continue;
+		}
+		point->AddRef();
+		m_pdrgppointSorted->Append(point);
+		prev_datum = datum;
+	}
+	pdrgppoint->Release();
+
+	return m_pdrgppointSorted;
+}
+
 IOstream &
 CScalarArray::OsPrint(IOstream &os) const
 {
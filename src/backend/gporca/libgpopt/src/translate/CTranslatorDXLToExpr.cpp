@@ -3210,6 +3210,36 @@ CTranslatorDXLToExpr::PexprArray(const CDXLNode *dxlnode)
 	IMDId *array_type_mdid = dxl_op->ArrayTypeMDid();
 	array_type_mdid->AddRef();
 
+	// an array of constants is translated directly into its collapsed form,
+	// keeping the constants in the operator instead of creating a child
+	// expression per element (see CUtils::PexprCollapseConstArray)
+	const ULONG arity = dxlnode->Arity();
+	BOOL fAllConsts = (0 < arity);
+	for (ULONG ul = 0; fAllConsts && ul < arity; ul++)
+	{
+		fAllConsts = (EdxlopScalarConstValue ==
+					  (*dxlnode)[ul]->GetOperator()->GetDXLOperator());
+	}
+
+	if (fAllConsts)
+	{
+		CScalarConstArray *pdrgPconst =
+			GPOS_NEW(m_mp) CScalarConstArray(m_mp, arity);
+		for (ULONG ul = 0; ul < arity; ul++)
+		{
+			CDXLScalarConstValue *dxl_const_op =
+				CDXLScalarConstValue::Cast((*dxlnode)[ul]->GetOperator());
+			pdrgPconst->Append(
+				CTranslatorDXLToExprUtils::PopConst(m_mp, m_pmda, dxl_const_op));
+		}
+
+		return GPOS_NEW(m_mp) CExpression(
+			m_mp, GPOS_NEW(m_mp) CScalarArray(m_mp, elem_type_mdid,
+											  array_type_mdid,
+											  dxl_op->IsMultiDimensional(),
+											  pdrgPconst));
+	}
+
 	CScalarArray *popArray = GPOS_NEW(m_mp) CScalarArray(
 		m_mp, elem_type_mdid, array_type_mdid, dxl_op->IsMultiDimensional());
 
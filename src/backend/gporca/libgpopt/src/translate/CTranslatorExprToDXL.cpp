@@ -7255,6 +7255,28 @@ CTranslatorExprToDXL::PdxlnArray(CExpression *pexpr)
 		GPOS_NEW(m_mp) CDXLScalarArray(m_mp, elem_type_mdid, array_type_mdid,
 									   pop->FMultiDimensional()));
 
+	if (CUtils::FScalarArrayCollapsed(pexpr))
+	{
+		// translate the constants kept in the operator without wrapping each
+		// of them in an expression first; consecutive constants nearly
+		// always share a type, so only look up the type when it changes
+		CScalarConstArray *pdrgPconst = pop->PdrgPconst();
+		const ULONG size = pdrgPconst->Size();
+		const IMDType *pmdtype = NULL;
+		for (ULONG ul = 0; ul < size; ul++)
+		{
+			IDatum *datum = (*pdrgPconst)[ul]->GetDatum();
+			if (NULL == pmdtype || !pmdtype->MDId()->Equals(datum->MDId()))
+			{
+				pmdtype = m_pmda->RetrieveType(datum->MDId());
+			}
+			pdxlnArray->AddChild(GPOS_NEW(m_mp) CDXLNode(
+				m_mp, pmdtype->GetDXLOpScConst(m_mp, datum)));
+		}
+
+		return pdxlnArray;
+	}
+
 	const ULONG arity = CUtils::UlScalarArrayArity(pexpr);
 
 	for (ULONG ul = 0; ul < arity; ul++)
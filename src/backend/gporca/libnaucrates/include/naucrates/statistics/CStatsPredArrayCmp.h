@@ -43,10 +43,14 @@ private:
 
 	CPointArray *m_points;
 
+	// are the points already sorted, de-duplicated and free of NULLs
+	BOOL m_is_sorted_and_deduped;
+
 public:
 	// ctor
 	CStatsPredArrayCmp(ULONG colid, CStatsPred::EStatsCmpType stats_cmp_type,
-					   CPointArray *points);
+					   CPointArray *points,
+					   BOOL is_sorted_and_deduped = false);
 
 	// dtor
 	virtual ~CStatsPredArrayCmp()
@@ -74,6 +78,12 @@ public:
 		return m_points;
 	}
 
+	BOOL
+	IsSortedAndDeduped() const
+	{
+		return m_is_sorted_and_deduped;
+	}
+
 	// conversion function
 	static CStatsPredArrayCmp *
 	ConvertPredStats(CStatsPred *pred_stats)
@@ -800,32 +800,42 @@ CFilterStatsProcessor::MakeHistArrayCmpAnyFilter(CMemoryPool *mp,
 	//    from base_histogram that should be selected.
 	// 4. Compute and adjust the resultant scale factor for the filter.
 
-	// First, de-duplicate the constants in the array list
+	// First, de-duplicate the constants in the array list, unless that was
+	// already done when the predicate was built
 	CPointArray *points = pred_stats->GetPoints();
-	if (points->Size() > 1)
+	CPointArray *deduped_points = NULL;
+	if (pred_stats->IsSortedAndDeduped())
 	{
-		points->Sort(&CUtils::CPointCmp);
+		points->AddRef();
+		deduped_points = points;
 	}
-
-	CPointArray *deduped_points = GPOS_NEW(mp) CPointArray(mp);
-	IDatum *prev_datum = NULL;
-
-	for (ULONG ul = 0; ul < points->Size(); ++ul)
+	else
 	{
-		CPoint *point = (*points)[ul];
-		IDatum *datum = point->GetDatum();
-		GPOS_ASSERT(datum->StatsAreComparable(datum));
-		if (datum->IsNull())
+		if (points->Size() > 1)
 		{
-			continue;
+			points->Sort(&CUtils::CPointCmp);
 		}
-		if (prev_datum != NULL && prev_datum->StatsAreEqual(datum))
+
+		deduped_points = GPOS_NEW(mp) CPointArray(mp);
+		IDatum *prev_datum = NULL;
+
+		for (ULONG ul = 0; ul < points->Size(); ++ul)
 		{
-			continue;
+			CPoint *point = (*points)[ul];
+			IDatum *datum = point->GetDatum();
+			GPOS_ASSERT(datum->StatsAreComparable(datum));
+			if (datum->IsNull())
+			{
+				continue;
+			}
+			if (prev_datum != NULL && prev_datum->StatsAreEqual(datum))
+			{
+				continue;
+			}
+			point->AddRef();
+			deduped_points->Append(point);
+			prev_datum = datum;
 		}
-		point->AddRef();
-		deduped_points->Append(point);
-		prev_datum = datum;
 	}
 	CDouble dummy_rows(deduped_points->Size());
 
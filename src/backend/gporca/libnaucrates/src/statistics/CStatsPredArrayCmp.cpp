@@ -23,8 +23,12 @@ using namespace gpmd;
 // Ctor
 CStatsPredArrayCmp::CStatsPredArrayCmp(ULONG colid,
 									   CStatsPred::EStatsCmpType stats_cmp_type,
-									   CPointArray *points)
-	: CStatsPred(colid), m_stats_cmp_type(stats_cmp_type), m_points(points)
+									   CPointArray *points,
+									   BOOL is_sorted_and_deduped)
+	: CStatsPred(colid),
+	  m_stats_cmp_type(stats_cmp_type),
+	  m_points(points),
+	  m_is_sorted_and_deduped(is_sorted_and_deduped)
 {
 	GPOS_ASSERT(CStatsPred::EstatscmptEq == m_stats_cmp_type);
 }
@@ -20,6 +20,7 @@
 #include "gpopt/operators/CExpressionHandle.h"
 #include "gpopt/operators/CExpressionUtils.h"
 #include "gpopt/operators/CPredicateUtils.h"
+#include "gpopt/operators/CScalarArray.h"
 #include "gpopt/operators/CScalarCmp.h"
 #include "gpopt/operators/CScalarIdent.h"
 #include "naucrates/base/IDatumBool.h"
@@ -1132,7 +1133,24 @@ CStatsPredUtils::ProcessArrayCmp(CMemoryPool *mp, CExpression *predicate_expr,
 		pred_stats = result_pred_stats;
 	}
 
-	const ULONG num_array_elems = CUtils::UlScalarArrayArity(expr_scalar_array);
+	ULONG num_array_elems = CUtils::UlScalarArrayArity(expr_scalar_array);
+
+	// a collapsed array of constants keeps its points sorted and
+	// de-duplicated, use them instead of collecting the elements one by one
+	CPointArray *sorted_points = NULL;
+	if (is_array_cmp_any && is_array_cmp_eq &&
+		CUtils::FScalarArrayCollapsed(expr_scalar_array))
+	{
+		sorted_points = CScalarArray::PopConvert(expr_scalar_array->Pop())
+							->PdrgppointSorted();
+	}
+	if (NULL != sorted_points)
+	{
+		points->Release();
+		sorted_points->AddRef();
+		points = sorted_points;
+		num_array_elems = 0;
+	}
 
 	for (ULONG ul = 0; ul < num_array_elems; ++ul)
 	{
@@ -1176,7 +1194,8 @@ CStatsPredUtils::ProcessArrayCmp(CMemoryPool *mp, CExpression *predicate_expr,
 		{
 			// "a = ANY (ARRAY[...])"
 			CStatsPredArrayCmp *pred_stats_array_cmp = GPOS_NEW(mp)
-				CStatsPredArrayCmp(col_ref->Id(), stats_cmp_type, points);
+				CStatsPredArrayCmp(col_ref->Id(), stats_cmp_type, points,
+								   NULL != sorted_points);
 			pred_stats->Append(pred_stats_array_cmp);
 		}
 
@@ -127,6 +127,8 @@ private:
 
 	static CStatsPred *PstatspredArrayCmpAnyDuplicate(CMemoryPool *mp);
 
+	static CStatsPred *PstatspredArrayCmpAnySorted(CMemoryPool *mp);
+
 
 	// conjunctive predicates
 	static CStatsPred *PstatspredConj(CMemoryPool *mp);
@@ -20,7 +20,12 @@
 #include "gpos/io/COstreamString.h"
 #include "gpos/string/CWStringDynamic.h"
 
+#include "gpopt/operators/CScalarArray.h"
+#include "naucrates/base/CDatumInt4GPDB.h"
 #include "naucrates/dxl/CDXLUtils.h"
+#include "naucrates/dxl/gpdb_types.h"
+#include "naucrates/md/CMDIdGPDB.h"
+#include "naucrates/md/CMDTypeInt4GPDB.h"
 #include "naucrates/statistics/CFilterStatsProcessor.h"
 #include "naucrates/statistics/CStatisticsUtils.h"
 
@@ -243,7 +248,10 @@ CFilterCardinalityTest::EresUnittest_CStatisticsFilterArrayCmpAny()
 		 PstatspredArrayCmpAnySimple},
 		{"../data/dxl/statistics/ArrayCmpAny-Input-1.xml",
 		 "../data/dxl/statistics/ArrayCmpAny-Output-1.xml",
-		 PstatspredArrayCmpAnyDuplicate}};
+		 PstatspredArrayCmpAnyDuplicate},
+		{"../data/dxl/statistics/ArrayCmpAny-Input-1.xml",
+		 "../data/dxl/statistics/ArrayCmpAny-Output-1.xml",
+		 PstatspredArrayCmpAnySorted}};
 
 	const ULONG ulTestCases = GPOS_ARRAY_SIZE(rgstatsdisjtc);
 
@@ -291,6 +299,43 @@ CFilterCardinalityTest::PstatspredArrayCmpAnyDuplicate(CMemoryPool *mp)
 	return GPOS_NEW(mp) CStatsPredConj(pdrgpstatspred);
 }
 
+// create a 'col IN (...)' filter from the sorted points of a collapsed
+// array of constants with duplicates and NULLs (unsorted)
+CStatsPred *
+CFilterCardinalityTest::PstatspredArrayCmpAnySorted(CMemoryPool *mp)
+{
+	CStatsPredPtrArry *pdrgpstatspred = GPOS_NEW(mp) CStatsPredPtrArry(mp);
+
+	const INT rgiVal[] = {15, 1, 0, 2, 1, 15, 2, 0, 1};
+	const BOOL rgfNull[] = {false, false, true, false, false,
+							false, false, true, false};
+	CScalarConstArray *pdrgPconst = GPOS_NEW(mp) CScalarConstArray(mp);
+	for (ULONG ul = 0; ul < GPOS_ARRAY_SIZE(rgiVal); ul++)
+	{
+		IDatum *datum = GPOS_NEW(mp) CDatumInt4GPDB(
+			CTestUtils::m_sysidDefault, rgiVal[ul], rgfNull[ul]);
+		pdrgPconst->Append(GPOS_NEW(mp) CScalarConst(mp, datum));
+	}
+	CScalarArray *popArray = GPOS_NEW(mp) CScalarArray(
+		mp, GPOS_NEW(mp) CMDIdGPDB(IMDId::EmdidGeneral, GPDB_INT4),
+		GPOS_NEW(mp) CMDIdGPDB(IMDId::EmdidGeneral, GPDB_INT4_ARRAY_TYPE),
+		false /* is_multidimenstional */, pdrgPconst);
+
+	// the NULLs and duplicates are gone, and the points are in order
+	CPointArray *arr = popArray->PdrgppointSorted();
+	GPOS_RTL_ASSERT(NULL != arr && 3 == arr->Size());
+	GPOS_RTL_ASSERT((*arr)[0]->IsLessThan((*arr)[1]));
+	GPOS_RTL_ASSERT((*arr)[1]->IsLessThan((*arr)[2]));
+	GPOS_RTL_ASSERT(arr == popArray->PdrgppointSorted());
+	arr->AddRef();
+	popArray->Release();
+
+	pdrgpstatspred->Append(GPOS_NEW(mp) CStatsPredArrayCmp(
+		1, CStatsPred::EstatscmptEq, arr, true /* is_sorted_and_deduped */));
+
+	return GPOS_NEW(mp) CStatsPredConj(pdrgpstatspred);
+}
+
 // reads a DXL document, generates the statistics object, performs a
 // filter operation on it, serializes it into a DXL document and
 // compares the generated DXL document with the expected DXL document.
@@ -1306,6 +1306,10 @@ _copyMotion(const Motion *from)
 
 	COPY_NODE_FIELD(hashExprs);
 	COPY_POINTER_FIELD(hashFuncs, list_length(from->hashExprs) * sizeof(Oid));
+	COPY_SCALAR_FIELD(skewMode);
+	COPY_NODE_FIELD(skewValues);
+	COPY_NODE_FIELD(skewHashes);
+	COPY_SCALAR_FIELD(skewNulls);
 
 	COPY_SCALAR_FIELD(isBroadcast);
 
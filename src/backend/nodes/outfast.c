@@ -582,6 +582,10 @@ _outMotion(StringInfo str, Motion *node)
 
 	WRITE_NODE_FIELD(hashExprs);
 	WRITE_OID_ARRAY(hashFuncs, list_length(node->hashExprs));
+	WRITE_ENUM_FIELD(skewMode, MotionSkewMode);
+	WRITE_NODE_FIELD(skewValues);
+	WRITE_NODE_FIELD(skewHashes);
+	WRITE_BOOL_FIELD(skewNulls);
 
 	WRITE_INT_FIELD(isBroadcast);
 
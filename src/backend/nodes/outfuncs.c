@@ -1183,6 +1183,10 @@ _outMotion(StringInfo str, const Motion *node)
 	appendStringInfoLiteral(str, " :hashFuncs");
 	for (i = 0; i < list_length(node->hashExprs); i++)
 		appendStringInfo(str, " %u", node->hashFuncs[i]);
+	WRITE_ENUM_FIELD(skewMode, MotionSkewMode);
+	WRITE_NODE_FIELD(skewValues);
+	WRITE_NODE_FIELD(skewHashes);
+	WRITE_BOOL_FIELD(skewNulls);
 
 	WRITE_INT_FIELD(isBroadcast);
 
@@ -2239,6 +2243,10 @@ _outCdbMotionPath(StringInfo str, const CdbMotionPath *node)
     _outPathInfo(str, &node->path);
 
     WRITE_NODE_FIELD(subpath);
+	WRITE_ENUM_FIELD(skewMode, MotionSkewMode);
+	WRITE_NODE_FIELD(skewValues);
+	WRITE_NODE_FIELD(skewHashes);
+	WRITE_BOOL_FIELD(skewNulls);
 }
 
 #ifndef COMPILING_BINARY_FUNCS
@@ -2210,6 +2210,10 @@ _readMotion(void)
 
 	READ_NODE_FIELD(hashExprs);
 	READ_OID_ARRAY(hashFuncs, list_length(local_node->hashExprs));
+	READ_ENUM_FIELD(skewMode, MotionSkewMode);
+	READ_NODE_FIELD(skewValues);
+	READ_NODE_FIELD(skewHashes);
+	READ_BOOL_FIELD(skewNulls);
 
 	READ_INT_FIELD(isBroadcast);
 
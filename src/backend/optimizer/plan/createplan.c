@@ -7157,6 +7157,16 @@ cdbpathtoplan_create_motion_plan(PlannerInfo *root,
 									hashOpfamilies,
                                     false /* useExecutorVarFormat */,
 									numsegments);
+
+		/* Hot join keys picked by cdbpath_motion_for_join() */
+		if (path->skewMode != MOTIONSKEW_NONE)
+		{
+			Assert(list_length(hashExprs) == 1);
+			motion->skewMode = path->skewMode;
+			motion->skewValues = path->skewValues;
+			motion->skewHashes = path->skewHashes;
+			motion->skewNulls = path->skewNulls;
+		}
     }
     else
         Insist(0);
@@ -0,0 +1,388 @@
+/*-------------------------------------------------------------------------
+ *
+ * aocompaction.c
+ *	  Background compaction of append-only tables.
+ *
+ * When gp_appendonly_compaction_worker is on, an auxiliary process on the
+ * master runs a lazy VACUUM of every append-only table of a database, once
+ * every gp_appendonly_compaction_worker_naptime seconds, with the compaction
+ * throttled by gp_appendonly_compaction_worker_cost_delay. Together with
+ * gp_appendonly_compaction_chunk_rows, this compacts the segment files of
+ * the tables a bounded chunk at a time, without a DBA having to schedule
+ * VACUUMs. Progress is shown in the gp_stat_appendonly_compaction view.
+ *
+ * A background worker stays connected to one database, so the process
+ * handles a single database per run. It then records the next database in
+ * shared memory and exits with a non-zero code, and the postmaster starts
+ * it again to handle that one.
+ *
+ * IDENTIFICATION
+ *	    src/backend/postmaster/aocompaction.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+/* These are always necessary for a bgworker */
+#include "miscadmin.h"
+#include "postmaster/bgworker.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/proc.h"
+#include "storage/shmem.h"
+
+#include "access/heapam.h"
+#include "access/htup_details.h"
+#include "access/xact.h"
+#include "catalog/pg_appendonly_fn.h"
+#include "catalog/pg_class.h"
+#include "catalog/pg_database.h"
+#include "cdb/cdbpartition.h"
+#include "cdb/cdbvars.h"
+#include "commands/vacuum.h"
+#include "postmaster/aocompaction.h"
+#include "postmaster/postmaster.h"
+#include "tcop/tcopprot.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/ps_status.h"
+#include "utils/syscache.h"
+
+/*
+ * Shared state of the compaction process, kept across its restarts.
+ */
+typedef struct AppendOnlyCompactionWorkerShmemStruct
+{
+	NameData	nextdb;			/* database of the next run, empty for the
+								 * default one */
+} AppendOnlyCompactionWorkerShmemStruct;
+
+static AppendOnlyCompactionWorkerShmemStruct *AOCompactionWorkerShmem = NULL;
+
+static volatile sig_atomic_t got_SIGHUP = false;
+
+bool		gp_appendonly_compaction_worker = false;
+int			gp_appendonly_compaction_worker_naptime = 60;
+int			gp_appendonly_compaction_worker_cost_delay = 20;
+
+static void AppendOnlyCompactionWorkerVacuumDatabase(void);
+static List *get_appendonly_table_list(void);
+static void set_next_database(void);
+
+/* SIGHUP: set flag to reload config file */
+static void
+sigHupHandler(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_SIGHUP = true;
+
+	if (MyProc)
+		SetLatch(&MyProc->procLatch);
+
+	errno = save_errno;
+}
+
+Size
+AppendOnlyCompactionWorkerShmemSize(void)
+{
+	return sizeof(AppendOnlyCompactionWorkerShmemStruct);
+}
+
+void
+AppendOnlyCompactionWorkerShmemInit(void)
+{
+	bool		found;
+
+	AOCompactionWorkerShmem = (AppendOnlyCompactionWorkerShmemStruct *)
+		ShmemInitStruct("Append-only Compaction Worker",
+						AppendOnlyCompactionWorkerShmemSize(),
+						&found);
+
+	if (!found)
+		MemSet(AOCompactionWorkerShmem, 0, AppendOnlyCompactionWorkerShmemSize());
+}
+
+bool
+AppendOnlyCompactionWorkerStartRule(Datum main_arg)
+{
+	/* we only compact in the background on master when -E is specified */
+	if (IsUnderMasterDispatchMode() &&
+		gp_appendonly_compaction_worker)
+		return true;
+
+	return false;
+}
+
+/*
+ * AppendOnlyCompactionWorkerMain
+ */
+void
+AppendOnlyCompactionWorkerMain(Datum main_arg)
+{
+	NameData	dbname;
+	int			rc;
+
+	pqsignal(SIGHUP, sigHupHandler);
+
+	/* We're now ready to receive signals */
+	BackgroundWorkerUnblockSignals();
+
+	/*
+	 * Take the database of this run. It is cleared first, so that we fall
+	 * back to the default database if it can't be connected to any more.
+	 */
+	namecpy(&dbname, &AOCompactionWorkerShmem->nextdb);
+	MemSet(&AOCompactionWorkerShmem->nextdb, 0, sizeof(NameData));
+	if (NameStr(dbname)[0] == '\0')
+		namestrcpy(&dbname, DB_FOR_COMMON_ACCESS);
+
+	/* Sleep before each run, the postmaster restarts us right away */
+	rc = WaitLatch(&MyProc->procLatch,
+				   WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+				   gp_appendonly_compaction_worker_naptime * 1000L);
+	ResetLatch(&MyProc->procLatch);
+
+	/* emergency bailout if postmaster has died */
+	if (rc & WL_POSTMASTER_DEATH)
+		proc_exit(1);
+
+	if (got_SIGHUP)
+	{
+		got_SIGHUP = false;
+		ProcessConfigFile(PGC_SIGHUP);
+	}
+
+	/* Connect to our database */
+	BackgroundWorkerInitializeConnection(NameStr(dbname), NULL);
+
+	/* disable orca here */
+	optimizer = false;
+
+	AppendOnlyCompactionWorkerVacuumDatabase();
+
+	StartTransactionCommand();
+	set_next_database();
+	CommitTransactionCommand();
+
+	/* One database done, exit non-zero to be restarted for the next one */
+	proc_exit(1);
+}
+
+/*
+ * Vacuums all the append-only tables of the current database.
+ */
+static void
+AppendOnlyCompactionWorkerVacuumDatabase(void)
+{
+	MemoryContext workerContext;
+	List	   *tables;
+	ListCell   *lc;
+	char		costDelay[32];
+
+	workerContext = AllocSetContextCreate(TopMemoryContext,
+										  "AppendOnlyCompactionWorker",
+										  ALLOCSET_DEFAULT_MINSIZE,
+										  ALLOCSET_DEFAULT_INITSIZE,
+										  ALLOCSET_DEFAULT_MAXSIZE);
+
+	/*
+	 * Like autovacuum, create a memory context to act as fake PortalContext,
+	 * so that the contexts created in the vacuum code are cleaned up for each
+	 * table.
+	 */
+	PortalContext = AllocSetContextCreate(workerContext,
+										  "AppendOnlyCompactionWorker Portal",
+										  ALLOCSET_DEFAULT_INITSIZE,
+										  ALLOCSET_DEFAULT_MINSIZE,
+										  ALLOCSET_DEFAULT_MAXSIZE);
+
+	/* Throttle the compaction on the segments running our vacuums */
+	snprintf(costDelay, sizeof(costDelay), "%d",
+			 gp_appendonly_compaction_worker_cost_delay);
+	SetConfigOption("gp_appendonly_compaction_cost_delay", costDelay,
+					PGC_USERSET, PGC_S_SESSION);
+
+	StartTransactionCommand();
+	MemoryContextSwitchTo(workerContext);
+	tables = get_appendonly_table_list();
+	CommitTransactionCommand();
+
+	foreach(lc, tables)
+	{
+		Oid			relid = lfirst_oid(lc);
+		VacuumStmt	vacstmt;
+		RangeVar	rangevar;
+		char	   *relname;
+		char	   *nspname;
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (got_SIGHUP)
+		{
+			got_SIGHUP = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		/* clean up memory before each iteration */
+		MemoryContextResetAndDeleteChildren(PortalContext);
+
+		StartTransactionCommand();
+
+		/* the relation may have been dropped since we listed it */
+		MemoryContextSwitchTo(PortalContext);
+		relname = get_rel_name(relid);
+		nspname = relname ? get_namespace_name(get_rel_namespace(relid)) : NULL;
+		if (relname == NULL || nspname == NULL)
+		{
+			CommitTransactionCommand();
+			continue;
+		}
+
+		/* See autovacuum_do_vac_analyze */
+		MemSet(&vacstmt, 0, sizeof(vacstmt));
+		MemSet(&rangevar, 0, sizeof(rangevar));
+
+		rangevar.type = T_RangeVar;
+		rangevar.schemaname = nspname;
+		rangevar.relname = relname;
+		rangevar.location = -1;
+
+		vacstmt.type = T_VacuumStmt;
+		vacstmt.options = VACOPT_VACUUM | VACOPT_NOWAIT;
+		vacstmt.freeze_min_age = -1;
+		vacstmt.freeze_table_age = -1;
+		vacstmt.multixact_freeze_min_age = -1;
+		vacstmt.multixact_freeze_table_age = -1;
+		vacstmt.relation = &rangevar;
+		vacstmt.va_cols = NIL;
+		vacstmt.auto_stats = false;
+
+		set_ps_display(relname, false);
+
+		/*
+		 * We will abort vacuuming the current table if something errors out,
+		 * and continue with the next one.
+		 */
+		PG_TRY();
+		{
+			MemoryContextSwitchTo(TopTransactionContext);
+			vacuum(&vacstmt, relid, false, NULL, false, true);
+		}
+		PG_CATCH();
+		{
+			HOLD_INTERRUPTS();
+			errcontext("append-only compaction of table \"%s.%s\"",
+					   nspname, relname);
+			EmitErrorReport();
+
+			AbortOutOfAnyTransaction();
+			FlushErrorState();
+			MemoryContextResetAndDeleteChildren(PortalContext);
+
+			/* restart our transaction for the following operations */
+			StartTransactionCommand();
+			RESUME_INTERRUPTS();
+		}
+		PG_END_TRY();
+
+		CommitTransactionCommand();
+	}
+
+	set_ps_display("", false);
+
+	MemoryContextSwitchTo(TopMemoryContext);
+	MemoryContextDelete(workerContext);
+	PortalContext = NULL;
+}
+
+/*
+ * Returns the OIDs of the append-only tables of the current database that
+ * hold data: partitioned parents and temporary tables are left out.
+ */
+static List *
+get_appendonly_table_list(void)
+{
+	Relation	pg_appendonly;
+	HeapScanDesc scan;
+	HeapTuple	tuple;
+	List	   *result = NIL;
+
+	pg_appendonly = heap_open(AppendOnlyRelationId, AccessShareLock);
+	scan = heap_beginscan_catalog(pg_appendonly, 0, NULL);
+
+	while ((tuple = heap_getnext(scan, ForwardScanDirection)) != NULL)
+	{
+		Oid			relid = ((Form_pg_appendonly) GETSTRUCT(tuple))->relid;
+		HeapTuple	classtup;
+		Form_pg_class classForm;
+		bool		wanted;
+
+		classtup = SearchSysCache1(RELOID, ObjectIdGetDatum(relid));
+		if (!HeapTupleIsValid(classtup))
+			continue;
+		classForm = (Form_pg_class) GETSTRUCT(classtup);
+		wanted = (classForm->relkind == RELKIND_RELATION &&
+				  classForm->relpersistence != RELPERSISTENCE_TEMP);
+		ReleaseSysCache(classtup);
+
+		if (wanted && !rel_is_partitioned(relid))
+			result = lappend_oid(result, relid);
+	}
+
+	heap_endscan(scan);
+	heap_close(pg_appendonly, AccessShareLock);
+
+	return result;
+}
+
+/*
+ * Records the database of the next run: the one following the current
+ * database in OID order, among those that accept connections and are not
+ * templates.
+ */
+static void
+set_next_database(void)
+{
+	Relation	pg_database;
+	HeapScanDesc scan;
+	HeapTuple	tuple;
+	Oid			firstOid = InvalidOid;
+	Oid			nextOid = InvalidOid;
+	NameData	firstName;
+	NameData	nextName;
+
+	pg_database = heap_open(DatabaseRelationId, AccessShareLock);
+	scan = heap_beginscan_catalog(pg_database, 0, NULL);
+
+	while ((tuple = heap_getnext(scan, ForwardScanDirection)) != NULL)
+	{
+		Form_pg_database dbForm = (Form_pg_database) GETSTRUCT(tuple);
+		Oid			dbOid = HeapTupleGetOid(tuple);
+
+		if (!dbForm->datallowconn || dbForm->datistemplate)
+			continue;
+
+		if (!OidIsValid(firstOid) || dbOid < firstOid)
+		{
+			firstOid = dbOid;
+			namecpy(&firstName, &dbForm->datname);
+		}
+		if (dbOid > MyDatabaseId &&
+			(!OidIsValid(nextOid) || dbOid < nextOid))
+		{
+			nextOid = dbOid;
+			namecpy(&nextName, &dbForm->datname);
+		}
+	}
+
+	heap_endscan(scan);
+	heap_close(pg_database, AccessShareLock);
+
+	if (OidIsValid(nextOid))
+		namecpy(&AOCompactionWorkerShmem->nextdb, &nextName);
+	else if (OidIsValid(firstOid))
+		namecpy(&AOCompactionWorkerShmem->nextdb, &firstName);
+}
@@ -112,6 +112,7 @@
 #include "miscadmin.h"
 #include "pg_getopt.h"
 #include "pgstat.h"
+#include "postmaster/aocompaction.h"
 #include "postmaster/autovacuum.h"
 #include "postmaster/bgworker_internals.h"
 #include "postmaster/bgwriter.h"
@@ -146,6 +147,7 @@
 #include "cdb/cdbvars.h"
 #include "cdb/cdbendpoint.h"
 #include "cdb/ic_proxy_bgworker.h"
+#include "cdb/ml_ipc.h"				/* RemoveStaleShmRings */
 
 /*
  * This is set in backends that are handling a GPDB specific message (FTS or
@@ -422,6 +424,13 @@ static BackgroundWorker PMAuxProcList[MaxPMAuxProc] =
 	 PerfmonMain, {0}, {0}, 0, 0,
 	 PerfmonStartRule},
 
+	{"appendonly compaction process",
+	 BGWORKER_SHMEM_ACCESS | BGWORKER_BACKEND_DATABASE_CONNECTION,
+	 BgWorkerStart_RecoveryFinished,
+	 0, /* restart immediately, it exits with non-zero code after each database */
+	 AppendOnlyCompactionWorkerMain, {0}, {0}, 0, 0,
+	 AppendOnlyCompactionWorkerStartRule},
+
 #ifdef ENABLE_IC_PROXY
 	{"ic proxy process",
 	 BGWORKER_SHMEM_ACCESS,
@@ -1428,6 +1437,9 @@ PostmasterMain(int argc, char *argv[])
 	 */
 	RemovePgTempFiles();
 
+	/* and interconnect rings of backends that crashed before */
+	RemoveStaleShmRings();
+
 	/*
 	 * Forcibly remove the files signaling a standby promotion
 	 * request. Otherwise, the existence of those files triggers
@@ -4377,6 +4389,7 @@ PostmasterStateMachine(void)
 
 		shmem_exit(1);
 		reset_shared(PostPortNumber);
+		RemoveStaleShmRings();
 
 		StartupPID = StartupDataBase();
 		Assert(StartupPID != 0);
@@ -24,11 +24,13 @@
 #include "access/twophase.h"
 #include "access/distributedlog.h"
 #include "access/appendonlywriter.h"
+#include "access/appendonly_compaction.h"
 #include "cdb/cdblocaldistribxact.h"
 #include "cdb/cdbvars.h"
 #include "commands/async.h"
 #include "miscadmin.h"
 #include "pgstat.h"
+#include "postmaster/aocompaction.h"
 #include "postmaster/autovacuum.h"
 #include "postmaster/bgworker_internals.h"
 #include "postmaster/bgwriter.h"
@@ -139,6 +141,8 @@ CreateSharedMemoryAndSemaphores(int port)
 		size = add_size(size, PredicateLockShmemSize());
 		if (Gp_role == GP_ROLE_DISPATCH)
 			size = add_size(size, AppendOnlyWriterShmemSize());
+		size = add_size(size, AppendOnlyCompactionShmemSize());
+		size = add_size(size, AppendOnlyCompactionWorkerShmemSize());
 
 		if (IsResQueueEnabled() && Gp_role == GP_ROLE_DISPATCH)
 		{
@@ -290,6 +294,12 @@ CreateSharedMemoryAndSemaphores(int port)
 	if (Gp_role == GP_ROLE_DISPATCH)
 		InitAppendOnlyWriter();
 
+	/*
+	 * Set up append only compaction progress and worker state
+	 */
+	AppendOnlyCompactionShmemInit();
+	AppendOnlyCompactionWorkerShmemInit();
+
 	/*
 	 * Set up resource manager 
 	 */
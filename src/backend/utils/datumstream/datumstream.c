@@ -31,6 +31,7 @@
 #include "cdb/cdbappendonlystoragewrite.h"
 #include "utils/datumstream.h"
 #include "utils/guc.h"
+#include "utils/typcache.h"
 #include "catalog/pg_compression.h"
 #include "utils/faultinjector.h"
 
@@ -265,6 +266,66 @@ datumstreamread_advancelarge(DatumStreamRead * acc)
 	}
 }
 
+/*
+ * Get up to maxRows datums following the current position of the stream,
+ * advancing past them. Returns the number of datums returned, 0 when the
+ * current block is exhausted. For dictionary encoded blocks, codes, if not
+ * NULL, gets the dictionary code of each datum, see
+ * datumstreamread_dictionary().
+ */
+int
+datumstreamread_get_batch(DatumStreamRead * acc,
+						  Datum *values,
+						  bool *nulls,
+						  int32 *codes,
+						  int maxRows)
+{
+	if (acc->largeObjectState == DatumStreamLargeObjectState_None)
+		return DatumStreamBlockRead_GetBatch(&acc->blockRead,
+											 values, nulls, codes, maxRows);
+
+	/* A large object block holds a single datum. */
+	if (maxRows <= 0 ||
+		acc->largeObjectState != DatumStreamLargeObjectState_HaveAoContent)
+		return 0;
+
+	datumstreamread_advancelarge(acc);
+	datumstreamread_getlarge(acc, &values[0], &nulls[0]);
+	return 1;
+}
+
+/*
+ * Number of datums left in the current block of the stream.
+ */
+int
+datumstreamread_remaining(DatumStreamRead * acc)
+{
+	if (acc->largeObjectState == DatumStreamLargeObjectState_None)
+		return DatumStreamBlockRead_Remaining(&acc->blockRead);
+
+	return (acc->largeObjectState == DatumStreamLargeObjectState_HaveAoContent) ? 1 : 0;
+}
+
+/*
+ * The distinct values of the current block, if it is dictionary encoded.
+ * Returns their number, 0 if the block is not dictionary encoded. The
+ * values stay valid until the next block is read. *dictionaryId changes
+ * with every dictionary read.
+ */
+int
+datumstreamread_dictionary(DatumStreamRead * acc,
+						   Datum **values,
+						   int64 *dictionaryId)
+{
+	if (acc->largeObjectState != DatumStreamLargeObjectState_None ||
+		acc->blockRead.dictionary_count == 0)
+		return 0;
+
+	*values = acc->blockRead.dictionary_values;
+	*dictionaryId = acc->blockRead.dictionary_id;
+	return acc->blockRead.dictionary_count;
+}
+
 int
 datumstreamread_nthlarge(DatumStreamRead * acc)
 {
@@ -303,7 +364,14 @@ datumstreamwrite_put(
 					 bool null,
 					 void **toFree)
 {
-	return DatumStreamBlockWrite_Put(&acc->blockWrite, d, null, toFree);
+	int			result;
+
+	result = DatumStreamBlockWrite_Put(&acc->blockWrite, d, null, toFree);
+
+	if (result >= 0 && acc->zoneSortSupport != NULL)
+		AppendOnlyBlockZone_Add(&acc->zone, acc->zoneSortSupport, d, null);
+
+	return result;
 }
 
 int
@@ -323,6 +391,36 @@ init_datumstream_typeinfo(
 	typeInfo->byval = attr->attbyval;
 }
 
+/*
+ * Set up the ordering used to compute block zones for a column, or return
+ * NULL if zones are not kept for its type. Only fixed-length pass-by-value
+ * types with a btree ordering are supported, since the zone stores the raw
+ * Datums. No zones are kept unless gp_appendonly_record_zone_maps is on.
+ */
+static SortSupport
+create_zone_sortsupport(DatumStreamTypeInfo * typeInfo)
+{
+	TypeCacheEntry *typentry;
+	SortSupport ssup;
+
+	if (!gp_appendonly_record_zone_maps ||
+		!typeInfo->byval || typeInfo->datumlen <= 0 ||
+		typeInfo->datumlen > sizeof(int64))
+		return NULL;
+
+	typentry = lookup_type_cache(typeInfo->typid, TYPECACHE_LT_OPR);
+	if (!OidIsValid(typentry->lt_opr))
+		return NULL;
+
+	ssup = palloc0(sizeof(SortSupportData));
+	ssup->ssup_cxt = CurrentMemoryContext;
+	ssup->ssup_collation = InvalidOid;
+	ssup->ssup_nulls_first = false;
+	PrepareSortSupportFromOrderingOp(typentry->lt_opr, ssup);
+
+	return ssup;
+}
+
 /*
  * DeltaRange compression supported for folowing datatypes
  * INTEGER, BIGINT, DATE, TIME and TIMESTAMP
@@ -637,6 +735,9 @@ create_datumstreamwrite(
 				  /* errcontextCallback */ datumstreamwrite_context_callback,
 								/* errcontextArg */ (void *) acc);
 
+	acc->zoneSortSupport = create_zone_sortsupport(&acc->typeInfo);
+	AppendOnlyBlockZone_Reset(&acc->zone);
+
 	return acc;
 }
 
@@ -854,6 +955,16 @@ datumstreamread_open_file(DatumStreamRead * ds, char *fn, int64 eof, int64 eofUn
 
 	AppendOnlyStorageRead_OpenFile(&ds->ao_read, fn, version, ds->eof);
 
+	/*
+	 * Forget the position in the previous file, so that the remaining row
+	 * count and datumstreamread_skip_to_row() start from the beginning of
+	 * this one.
+	 */
+	ds->blockFirstRowNum = 0;
+	ds->blockRowCount = 0;
+	DatumStreamBlockRead_Reset(&ds->blockRead);
+	ds->largeObjectState = DatumStreamLargeObjectState_None;
+
 	ds->need_close_file = true;
 }
 
@@ -1012,13 +1123,16 @@ datumstreamwrite_block(DatumStreamWrite *acc,
 	}
 
 	/* Insert an entry to the block directory */
-	AppendOnlyBlockDirectory_InsertEntry(
+	AppendOnlyBlockDirectory_InsertEntryWithZone(
 		blockDirectory,
 		columnGroupNo,
 		acc->blockFirstRowNum,
 		AppendOnlyStorageWrite_LogicalBlockStartOffset(&acc->ao_write),
 		itemCount,
-		addColAction);
+		addColAction,
+		acc->zoneSortSupport != NULL ? &acc->zone : NULL,
+		acc->zoneSortSupport);
+	AppendOnlyBlockZone_Reset(&acc->zone);
 
 	return writesz;
 }
@@ -1101,6 +1215,41 @@ datumstreamwrite_lob(DatumStreamWrite * acc,
 	return varLen;
 }
 
+/*
+ * Compute the zone of the current block by reading all its values, and
+ * rewind the block afterwards. Returns false if zones are not kept for the
+ * column type.
+ */
+static bool
+datumstreamread_block_zone(DatumStreamRead * acc, MinipageZone *zone)
+{
+	Datum		value;
+	bool		isnull;
+
+	if (!acc->zoneSortSupportChecked)
+	{
+		MemoryContext oldcxt = MemoryContextSwitchTo(acc->memctxt);
+
+		acc->zoneSortSupport = create_zone_sortsupport(&acc->typeInfo);
+		acc->zoneSortSupportChecked = true;
+		MemoryContextSwitchTo(oldcxt);
+	}
+
+	if (acc->zoneSortSupport == NULL ||
+		acc->largeObjectState != DatumStreamLargeObjectState_None)
+		return false;
+
+	AppendOnlyBlockZone_Reset(zone);
+	while (datumstreamread_advance(acc) > 0)
+	{
+		datumstreamread_get(acc, &value, &isnull);
+		AppendOnlyBlockZone_Add(zone, acc->zoneSortSupport, value, isnull);
+	}
+	datumstreamread_rewind_block(acc);
+
+	return true;
+}
+
 static bool
 datumstreamread_block_info(DatumStreamRead * acc)
 {
@@ -1369,17 +1518,96 @@ datumstreamread_block(DatumStreamRead * acc,
 
 	if (blockDirectory)
 	{
-		AppendOnlyBlockDirectory_InsertEntry(blockDirectory,
-											 colGroupNo,
-											 acc->blockFirstRowNum,
-											 acc->blockFileOffset,
-											 acc->blockRowCount,
-											 false);
+		MinipageZone zone;
+		bool		haveZone;
+
+		haveZone = datumstreamread_block_zone(acc, &zone);
+
+		AppendOnlyBlockDirectory_InsertEntryWithZone(blockDirectory,
+													 colGroupNo,
+													 acc->blockFirstRowNum,
+													 acc->blockFileOffset,
+													 acc->blockRowCount,
+													 false,
+													 haveZone ? &zone : NULL,
+													 acc->zoneSortSupport);
 	}
 
 	return 0;
 }
 
+/*
+ * Skip forward so that the next datumstreamread_advance() returns the first
+ * row whose row number is at least rowNum. Blocks that end before rowNum are
+ * passed over using their headers only, without reading or decompressing
+ * their contents; *blocksSkipped is incremented for each of them.
+ *
+ * Returns false if the segment file has no more rows at or after rowNum, or
+ * if the blocks do not carry row numbers (pre-4.0 format). In the latter
+ * case nothing is skipped.
+ */
+bool
+datumstreamread_skip_to_row(DatumStreamRead * acc,
+							int64 rowNum,
+							int64 *blocksSkipped)
+{
+	bool		readOK;
+
+	Assert(acc);
+
+	while (rowNum >= acc->blockFirstRowNum + acc->blockRowCount)
+	{
+		acc->blockFirstRowNum += acc->blockRowCount;
+
+		readOK = AppendOnlyStorageRead_GetBlockInfo(&acc->ao_read,
+													&acc->getBlockInfo.contentLen,
+													&acc->getBlockInfo.execBlockKind,
+													&acc->getBlockInfo.firstRow,
+													&acc->getBlockInfo.rowCnt,
+													&acc->getBlockInfo.isLarge,
+													&acc->getBlockInfo.isCompressed);
+		if (!readOK)
+			return false;
+
+		if (acc->getBlockInfo.firstRow < 0)
+		{
+			/* No row numbers to skip by, just read the block as usual. */
+			acc->blockFileOffset = acc->ao_read.current.headerOffsetInFile;
+			acc->blockRowCount = acc->getBlockInfo.rowCnt;
+			datumstreamread_block_content(acc);
+			return true;
+		}
+
+		acc->blockFirstRowNum = acc->getBlockInfo.firstRow;
+		acc->blockFileOffset = acc->ao_read.current.headerOffsetInFile;
+		acc->blockRowCount = acc->getBlockInfo.rowCnt;
+
+		if (rowNum < acc->blockFirstRowNum + acc->blockRowCount)
+		{
+			datumstreamread_block_content(acc);
+			break;
+		}
+
+		AppendOnlyStorageRead_SkipCurrentBlock(&acc->ao_read);
+
+		/* Nothing of the skipped block can be returned. */
+		DatumStreamBlockRead_Reset(&acc->blockRead);
+		acc->largeObjectState = DatumStreamLargeObjectState_None;
+		(*blocksSkipped)++;
+	}
+
+	/*
+	 * rowNum is in the current block, or in the gap before it. Position on
+	 * the row right before it. A large object block holds a single row, so
+	 * there is nothing to position within it.
+	 */
+	if (acc->largeObjectState == DatumStreamLargeObjectState_None &&
+		rowNum - 1 > acc->blockFirstRowNum + datumstreamread_nth(acc))
+		datumstreamread_find(acc, (int32) (rowNum - 1 - acc->blockFirstRowNum));
+
+	return true;
+}
+
 void
 datumstreamread_rewind_block(DatumStreamRead * datumStream)
 {
@@ -13,6 +13,7 @@
  */
 
 #include "postgres.h"
+#include "access/hash.h"
 #include "access/tupmacs.h"
 #include "access/tuptoaster.h"
 #include "utils/datumstreamblock.h"
@@ -55,6 +56,121 @@ att_align_zero(char *data, char alignchar)
 	return data;
 }
 
+/*
+ * Length of the item at p, as laid out in datum data.
+ */
+static inline int32
+datumstream_item_len(DatumStreamTypeInfo * typeInfo, uint8 * p)
+{
+	if (typeInfo->datumlen == -1)
+		return VARSIZE_ANY(p);
+	else if (typeInfo->datumlen == -2)
+		return strlen((char *) p) + 1;
+	else
+		return typeInfo->datumlen;
+}
+
+/*
+ * Does the item at p get aligned in datum data? Only regular varlena are;
+ * SHORT varlena, C strings and fixed-length items are stored back to back.
+ */
+static inline bool
+datumstream_item_is_aligned(DatumStreamTypeInfo * typeInfo, uint8 * p)
+{
+	return typeInfo->datumlen == -1 && !VARATT_IS_SHORT(p);
+}
+
+/*
+ * Bit-packing of the dictionary codes and frame-of-reference values, least
+ * significant bit first.
+ */
+typedef struct DatumStreamBitPack
+{
+	uint8	   *p;
+	uint64		bits;
+	int			bitCount;
+} DatumStreamBitPack;
+
+static inline int32
+DatumStreamBitPack_Size(int32 count, int width)
+{
+	return (int32) (((int64) count * width + 7) / 8);
+}
+
+static inline int
+DatumStreamBitPack_Width(uint64 maxValue)
+{
+	int			width = 0;
+
+	while (width < 64 && (maxValue >> width) != 0)
+		width++;
+
+	return width;
+}
+
+static inline void
+DatumStreamBitPack_Init(DatumStreamBitPack * bp, uint8 * p)
+{
+	bp->p = p;
+	bp->bits = 0;
+	bp->bitCount = 0;
+}
+
+static inline void
+DatumStreamBitPack_Put(DatumStreamBitPack * bp, uint64 value, int width)
+{
+	while (width > 0)
+	{
+		int			take = Min(width, 32);
+
+		bp->bits |= (value & ((UINT64CONST(1) << take) - 1)) << bp->bitCount;
+		bp->bitCount += take;
+		value >>= take;
+		width -= take;
+
+		while (bp->bitCount >= 8)
+		{
+			*(bp->p++) = (uint8) bp->bits;
+			bp->bits >>= 8;
+			bp->bitCount -= 8;
+		}
+	}
+}
+
+static inline void
+DatumStreamBitPack_Flush(DatumStreamBitPack * bp)
+{
+	if (bp->bitCount > 0)
+		*(bp->p++) = (uint8) bp->bits;
+	bp->bits = 0;
+	bp->bitCount = 0;
+}
+
+static inline uint64
+DatumStreamBitPack_Get(DatumStreamBitPack * bp, int width)
+{
+	uint64		value = 0;
+	int			shift = 0;
+
+	while (width > 0)
+	{
+		int			take = Min(width, 32);
+
+		while (bp->bitCount < take)
+		{
+			bp->bits |= ((uint64) *(bp->p++)) << bp->bitCount;
+			bp->bitCount += 8;
+		}
+		value |= (bp->bits & ((UINT64CONST(1) << take) - 1)) << shift;
+		bp->bits >>= take;
+		bp->bitCount -= take;
+		shift += take;
+		width -= take;
+	}
+
+	return value;
+}
+
 /*
  * DatumStreamBlockRead.
  */
@@ -144,6 +260,165 @@ DatumStreamBlockRead_ResetOrig(DatumStreamBlockRead * dsr)
 
 	dsr->buffer_beginp = NULL;
 	dsr->datump = NULL;
+
+	dsr->dictionary_count = 0;
+}
+
+/* Numbers the dictionaries read, for DatumStreamBlockRead.dictionary_id. */
+static int64 datumStreamDictionaryCount = 0;
+
+static void
+DatumStreamBlockRead_BadEncoding(DatumStreamBlockRead * dsr, const char *detail)
+{
+	ereport(ERROR,
+			(errmsg("bad datum stream Original block encoding"),
+			 errdetail_internal("%s", detail),
+			 errdetail_datumstreamblockread(dsr),
+			 errcontext_datumstreamblockread(dsr)));
+}
+
+/*
+ * Decode the dictionary or frame-of-reference encoded datum data of an
+ * Original block into plain datum data in decode_buffer, and point the
+ * read at it.
+ */
+static void
+DatumStreamBlockRead_DecodeOrig(
+								DatumStreamBlockRead * dsr,
+								uint8 * encoded,
+								int32 encodedSize,
+								bool isDictionary)
+{
+	DatumStreamBlock_Encoding_Extension *extension;
+	DatumStreamTypeInfo *typeInfo = &dsr->typeInfo;
+	DatumStreamBitPack bp;
+	uint8	   *packed;
+	uint8	   *out;
+	uint8	   *out_afterp;
+	int32		i;
+
+	if (encodedSize < (int32) sizeof(DatumStreamBlock_Encoding_Extension))
+		DatumStreamBlockRead_BadEncoding(dsr, "The encoding header does not fit.");
+
+	extension = (DatumStreamBlock_Encoding_Extension *) encoded;
+	if (extension->item_count < 0 ||
+		extension->item_count > dsr->logical_row_count ||
+		extension->decoded_size < 0 ||
+		extension->bit_width < 0 || extension->bit_width > 64 ||
+		extension->dictionary_count < 0 ||
+		extension->dictionary_count > DATUMSTREAM_MAX_DICTIONARY_COUNT ||
+		extension->dictionary_size < 0 ||
+		(int64) sizeof(DatumStreamBlock_Encoding_Extension) +
+		extension->dictionary_size +
+		DatumStreamBitPack_Size(extension->item_count, extension->bit_width) > encodedSize)
+		DatumStreamBlockRead_BadEncoding(dsr, "The encoding header is corrupt.");
+
+	if (dsr->decode_buffer_size < extension->decoded_size)
+	{
+		if (dsr->decode_buffer != NULL)
+			pfree(dsr->decode_buffer);
+		dsr->decode_buffer_size = Max(extension->decoded_size, BLCKSZ);
+		dsr->decode_buffer = MemoryContextAlloc(dsr->memctxt,
+												dsr->decode_buffer_size);
+	}
+	out = dsr->decode_buffer;
+	out_afterp = out + extension->decoded_size;
+
+	packed = encoded + sizeof(DatumStreamBlock_Encoding_Extension) +
+		extension->dictionary_size;
+	DatumStreamBitPack_Init(&bp, packed);
+
+	if (isDictionary)
+	{
+		uint8	   *p = encoded + sizeof(DatumStreamBlock_Encoding_Extension);
+		uint8	   *dictionary_afterp = p + extension->dictionary_size;
+
+		if (typeInfo->byval ||
+			(extension->dictionary_count == 0 && extension->item_count > 0))
+			DatumStreamBlockRead_BadEncoding(dsr, "The dictionary is corrupt.");
+
+		if (dsr->dictionary_values == NULL)
+			dsr->dictionary_values =
+				MemoryContextAlloc(dsr->memctxt,
+								   DATUMSTREAM_MAX_DICTIONARY_COUNT * sizeof(Datum));
+		if (dsr->dictionary_codes_size < extension->item_count)
+		{
+			if (dsr->dictionary_codes != NULL)
+				pfree(dsr->dictionary_codes);
+			dsr->dictionary_codes_size = Max(extension->item_count, 1024);
+			dsr->dictionary_codes =
+				MemoryContextAlloc(dsr->memctxt,
+								   dsr->dictionary_codes_size * sizeof(uint16));
+		}
+
+		/* The distinct items are laid out as in plain datum data. */
+		for (i = 0; i < extension->dictionary_count; i++)
+		{
+			if (i > 0 && typeInfo->datumlen == -1 && *p == 0)
+				p = (uint8 *) att_align_nominal(p, typeInfo->align);
+			if (p >= dictionary_afterp ||
+				p + datumstream_item_len(typeInfo, p) > dictionary_afterp)
+				DatumStreamBlockRead_BadEncoding(dsr, "The dictionary is corrupt.");
+
+			dsr->dictionary_values[i] = PointerGetDatum(p);
+			p += datumstream_item_len(typeInfo, p);
+		}
+
+		for (i = 0; i < extension->item_count; i++)
+		{
+			uint64		code = DatumStreamBitPack_Get(&bp, extension->bit_width);
+			uint8	   *item;
+			int32		len;
+
+			if (code >= (uint64) extension->dictionary_count)
+				DatumStreamBlockRead_BadEncoding(dsr, "A dictionary code is out of range.");
+			dsr->dictionary_codes[i] = (uint16) code;
+
+			item = (uint8 *) DatumGetPointer(dsr->dictionary_values[code]);
+			len = datumstream_item_len(typeInfo, item);
+			if (datumstream_item_is_aligned(typeInfo, item))
+				out = (uint8 *) att_align_zero((char *) out, typeInfo->align);
+			if (out + len > out_afterp)
+				DatumStreamBlockRead_BadEncoding(dsr, "The decoded data size is wrong.");
+
+			memcpy(out, item, len);
+			out += len;
+		}
+
+		dsr->dictionary_count = extension->dictionary_count;
+		dsr->dictionary_id = ++datumStreamDictionaryCount;
+	}
+	else
+	{
+		uint64		reference = (uint64) extension->reference;
+
+		if (!typeInfo->byval ||
+			(int64) extension->item_count * typeInfo->datumlen != extension->decoded_size)
+			DatumStreamBlockRead_BadEncoding(dsr, "The decoded data size is wrong.");
+
+		for (i = 0; i < extension->item_count; i++)
+		{
+			uint64		value = reference +
+				DatumStreamBitPack_Get(&bp, extension->bit_width);
+
+			if (typeInfo->datumlen == 8)
+				((int64 *) out)[i] = (int64) value;
+			else if (typeInfo->datumlen == 4)
+				((int32 *) out)[i] = (int32) value;
+			else if (typeInfo->datumlen == 2)
+				((int16 *) out)[i] = (int16) value;
+			else
+				DatumStreamBlockRead_BadEncoding(dsr, "Frame-of-reference encoding of an unexpected type.");
+		}
+		out += extension->decoded_size;
+	}
+
+	if (out != out_afterp)
+		DatumStreamBlockRead_BadEncoding(dsr, "The decoded data size is wrong.");
+
+	dsr->physical_data_size = extension->decoded_size;
+	dsr->datum_beginp = dsr->decode_buffer;
+	dsr->datum_afterp = out_afterp;
 }
 
 void
@@ -287,6 +562,12 @@ DatumStreamBlockRead_GetReadyOrig(
 	dsr->datum_beginp = dsr->buffer_beginp + alignedHeaderSize;
 	dsr->datum_afterp = dsr->datum_beginp + dsr->physical_data_size;
 
+	if ((blockOrig->flags & (DSB_HAS_DICTIONARY_ENCODING | DSB_HAS_FOR_ENCODING)) != 0)
+		DatumStreamBlockRead_DecodeOrig(dsr,
+										dsr->datum_beginp,
+										dsr->physical_data_size,
+										(blockOrig->flags & DSB_HAS_DICTIONARY_ENCODING) != 0);
+
 	/*
 	 * PERFORMANCE EXPERIMENT: Only do integrity and trace checking for DEBUG
 	 * builds...
@@ -3640,6 +3921,234 @@ DatumStreamBlockWrite_GetReady(
 	}
 }
 
+/*
+ * Frame-of-reference encode the items of the block into encoding_buffer.
+ * Returns the encoded size, or -1 if it would not be under limitSize.
+ */
+static int32
+DatumStreamBlockWrite_EncodeFOR(
+								DatumStreamBlockWrite * dsw,
+								int32 limitSize)
+{
+	DatumStreamBlock_Encoding_Extension *extension;
+	DatumStreamBitPack bp;
+	int32		count = dsw->physical_datum_count;
+	int32		datumlen = dsw->typeInfo->datumlen;
+	int64		minValue = 0;
+	int64		maxValue = 0;
+	int			width;
+	int32		encodedSize;
+	int32		i;
+
+#define FOR_ITEM(i) \
+	(datumlen == 8 ? ((int64 *) dsw->datum_buffer)[i] : \
+	 datumlen == 4 ? (int64) ((int32 *) dsw->datum_buffer)[i] : \
+	 (int64) ((int16 *) dsw->datum_buffer)[i])
+
+	for (i = 0; i < count; i++)
+	{
+		int64		value = FOR_ITEM(i);
+
+		if (i == 0 || value < minValue)
+			minValue = value;
+		if (i == 0 || value > maxValue)
+			maxValue = value;
+	}
+
+	width = DatumStreamBitPack_Width((uint64) maxValue - (uint64) minValue);
+	if (width >= datumlen * 8)
+		return -1;
+
+	encodedSize = sizeof(DatumStreamBlock_Encoding_Extension) +
+		DatumStreamBitPack_Size(count, width);
+	if (encodedSize >= limitSize)
+		return -1;
+
+	extension = (DatumStreamBlock_Encoding_Extension *) dsw->encoding_buffer;
+	memset(extension, 0, sizeof(DatumStreamBlock_Encoding_Extension));
+	extension->item_count = count;
+	extension->decoded_size = count * datumlen;
+	extension->reference = minValue;
+	extension->bit_width = width;
+
+	DatumStreamBitPack_Init(&bp, dsw->encoding_buffer +
+							sizeof(DatumStreamBlock_Encoding_Extension));
+	for (i = 0; i < count; i++)
+		DatumStreamBitPack_Put(&bp, (uint64) FOR_ITEM(i) - (uint64) minValue, width);
+	DatumStreamBitPack_Flush(&bp);
+
+#undef FOR_ITEM
+
+	Assert(bp.p - dsw->encoding_buffer == encodedSize);
+	return encodedSize;
+}
+
+/*
+ * Dictionary encode the items of the block into encoding_buffer. Returns
+ * the encoded size, or -1 if there are too many distinct items or it would
+ * not be under limitSize.
+ */
+static int32
+DatumStreamBlockWrite_EncodeDictionary(
+									   DatumStreamBlockWrite * dsw,
+									   int32 limitSize)
+{
+#define DICTIONARY_HASH_SIZE (2 * DATUMSTREAM_MAX_DICTIONARY_COUNT)
+	DatumStreamTypeInfo *typeInfo = dsw->typeInfo;
+	DatumStreamBlock_Encoding_Extension *extension;
+	DatumStreamBitPack bp;
+	int32		count = dsw->physical_datum_count;
+	int32		dictionaryCount = 0;
+	uint8	   *dictionary_beginp;
+	uint8	   *out;
+	uint8	   *limitp;
+	uint8	   *p;
+	int			width;
+	int32		encodedSize;
+	int32		i;
+
+	dictionary_beginp = dsw->encoding_buffer +
+		sizeof(DatumStreamBlock_Encoding_Extension);
+	limitp = dsw->encoding_buffer + limitSize;
+	out = dictionary_beginp;
+
+	for (i = 0; i < DICTIONARY_HASH_SIZE; i++)
+		dsw->encoding_hash[i] = -1;
+
+	p = dsw->datum_buffer;
+	for (i = 0; i < count; i++)
+	{
+		int32		len;
+		uint32		h;
+		int32		entry;
+
+		if (i > 0 && typeInfo->datumlen == -1 && *p == 0)
+			p = (uint8 *) att_align_nominal(p, typeInfo->align);
+		len = datumstream_item_len(typeInfo, p);
+
+		h = DatumGetUInt32(hash_any(p, len)) & (DICTIONARY_HASH_SIZE - 1);
+		for (;;)
+		{
+			uint8	   *item;
+
+			entry = dsw->encoding_hash[h];
+			if (entry < 0)
+				break;
+
+			item = dictionary_beginp + dsw->encoding_entry_offsets[entry];
+			if (datumstream_item_len(typeInfo, item) == len &&
+				memcmp(item, p, len) == 0)
+				break;
+			h = (h + 1) & (DICTIONARY_HASH_SIZE - 1);
+		}
+
+		if (entry < 0)
+		{
+			uint8	   *item = out;
+
+			if (dictionaryCount >= DATUMSTREAM_MAX_DICTIONARY_COUNT)
+				return -1;
+
+			/* Check the space before any zero padding is written. */
+			if (item + MAXIMUM_ALIGNOF + len > limitp)
+				return -1;
+			if (datumstream_item_is_aligned(typeInfo, p))
+				item = (uint8 *) att_align_zero((char *) item, typeInfo->align);
+			memcpy(item, p, len);
+			out = item + len;
+
+			entry = dictionaryCount++;
+			dsw->encoding_entry_offsets[entry] = item - dictionary_beginp;
+			dsw->encoding_hash[h] = entry;
+		}
+
+		dsw->encoding_codes[i] = entry;
+		p += len;
+	}
+
+	width = DatumStreamBitPack_Width(dictionaryCount > 0 ? dictionaryCount - 1 : 0);
+	encodedSize = (out - dsw->encoding_buffer) +
+		DatumStreamBitPack_Size(count, width);
+	if (encodedSize >= limitSize)
+		return -1;
+
+	extension = (DatumStreamBlock_Encoding_Extension *) dsw->encoding_buffer;
+	memset(extension, 0, sizeof(DatumStreamBlock_Encoding_Extension));
+	extension->item_count = count;
+	/* Leaves out any zero padding after the last item. */
+	extension->decoded_size = p - dsw->datum_buffer;
+	extension->dictionary_count = dictionaryCount;
+	extension->dictionary_size = out - dictionary_beginp;
+	extension->bit_width = width;
+
+	DatumStreamBitPack_Init(&bp, out);
+	for (i = 0; i < count; i++)
+		DatumStreamBitPack_Put(&bp, dsw->encoding_codes[i], width);
+	DatumStreamBitPack_Flush(&bp);
+
+#undef DICTIONARY_HASH_SIZE
+
+	Assert(bp.p - dsw->encoding_buffer == encodedSize);
+	return encodedSize;
+}
+
+/*
+ * Encode the datum data of an Original block, when gp_appendonly_block_encodings
+ * is on and it pays: frame-of-reference for 2, 4 and 8 byte pass-by-value
+ * types, dictionary for pass-by-reference types. The encoded data is left
+ * in encoding_buffer, and its size returned, with the flag of the encoding
+ * in *flag. Returns -1 if the block is best left plain.
+ */
+static int32
+DatumStreamBlockWrite_EncodeOrig(
+								 DatumStreamBlockWrite * dsw,
+								 int16 *flag)
+{
+	int32		plainSize = dsw->datump - dsw->datum_buffer;
+	int32		limitSize;
+	int32		encodedSize;
+
+	*flag = 0;
+
+	if (!gp_appendonly_block_encodings || dsw->physical_datum_count < 2)
+		return -1;
+
+	/* Only worth decoding on every read when it saves a quarter at least. */
+	limitSize = plainSize - plainSize / 4;
+
+	if (dsw->encoding_buffer == NULL)
+	{
+		dsw->encoding_buffer = MemoryContextAlloc(dsw->memctxt,
+												  dsw->maxDataBlockSize);
+		dsw->encoding_codes = MemoryContextAlloc(dsw->memctxt,
+												 dsw->maxDatumPerBlock * sizeof(int32));
+		dsw->encoding_hash = MemoryContextAlloc(dsw->memctxt,
+												2 * DATUMSTREAM_MAX_DICTIONARY_COUNT * sizeof(int32));
+		dsw->encoding_entry_offsets = MemoryContextAlloc(dsw->memctxt,
+														 DATUMSTREAM_MAX_DICTIONARY_COUNT * sizeof(int32));
+	}
+
+	if (dsw->typeInfo->byval)
+	{
+		if (dsw->typeInfo->datumlen != 2 &&
+			dsw->typeInfo->datumlen != 4 &&
+			dsw->typeInfo->datumlen != 8)
+			return -1;
+
+		encodedSize = DatumStreamBlockWrite_EncodeFOR(dsw, limitSize);
+		*flag = DSB_HAS_FOR_ENCODING;
+	}
+	else
+	{
+		encodedSize = DatumStreamBlockWrite_EncodeDictionary(dsw, limitSize);
+		*flag = DSB_HAS_DICTIONARY_ENCODING;
+	}
+
+	if (encodedSize < 0)
+		*flag = 0;
+	return encodedSize;
+}
+
 static int64
 DatumStreamBlockWrite_BlockOrig(
 								DatumStreamBlockWrite * dsw,
@@ -3651,9 +4160,13 @@ DatumStreamBlockWrite_BlockOrig(
 	int32		rowCount;
 	int64		writesz;
 	bool		minimalIntegrityChecks;
+	int16		encodingFlag;
+	int32		encodedSize;
 
 	p = buffer;
 
+	encodedSize = DatumStreamBlockWrite_EncodeOrig(dsw, &encodingFlag);
+
 	/* First write header */
 	block.version = DatumStreamVersion_Original;
 	block.flags = dsw->has_null ? DSB_HAS_NULLBITMAP : 0;
@@ -3677,6 +4190,11 @@ DatumStreamBlockWrite_BlockOrig(
 	}
 
 	block.sz = dsw->datump - dsw->datum_buffer;
+	if (encodedSize >= 0)
+	{
+		block.flags |= encodingFlag;
+		block.sz = encodedSize;
+	}
 
 	/*
 	 * Serialize the different data in to the write buffer.
@@ -3704,7 +4222,7 @@ DatumStreamBlockWrite_BlockOrig(
 	}
 
 	/* Next write data */
-	memcpy(p, dsw->datum_buffer, block.sz);
+	memcpy(p, (encodedSize >= 0 ? dsw->encoding_buffer : dsw->datum_buffer), block.sz);
 	p += block.sz;
 
 	/* Calculate write size. */
@@ -4753,7 +5271,44 @@ DatumStreamBlock_IntegrityCheckOrig(
 		p += blockOrig->nullsz;
 	}
 
-	if (typeInfo->datumlen == -1)
+	if ((blockOrig->flags & (DSB_HAS_DICTIONARY_ENCODING | DSB_HAS_FOR_ENCODING)) != 0)
+	{
+		DatumStreamBlock_Encoding_Extension *extension;
+
+		extension = (DatumStreamBlock_Encoding_Extension *) p;
+		if (blockOrig->sz < (int32) sizeof(DatumStreamBlock_Encoding_Extension) ||
+			extension->dictionary_size < 0 ||
+			extension->bit_width < 0 || extension->bit_width > 64 ||
+			(int64) sizeof(DatumStreamBlock_Encoding_Extension) +
+			extension->dictionary_size +
+			DatumStreamBitPack_Size(extension->item_count, extension->bit_width) != blockOrig->sz)
+		{
+			ereport(ERROR,
+					(errmsg("Bad datum stream Original block encoding.  Encoded data size %d does not match the encoding header (dictionary size %d, item count %d, bit width %d)",
+							blockOrig->sz,
+							extension->dictionary_size,
+							extension->item_count,
+							extension->bit_width),
+					 errdetailCallback(errdetailArg),
+					 errcontextCallback(errcontextArg)));
+		}
+
+		/* The distinct items of a dictionary are laid out as datum data. */
+		if ((blockOrig->flags & DSB_HAS_DICTIONARY_ENCODING) != 0 &&
+			typeInfo->datumlen == -1)
+		{
+			DatumStreamBlock_IntegrityCheckVarlena(
+												   p + sizeof(DatumStreamBlock_Encoding_Extension),
+												   extension->dictionary_size,
+												   DatumStreamVersion_Original,
+												   typeInfo,
+												   errdetailCallback,
+												   errdetailArg,
+												   errcontextCallback,
+												   errcontextArg);
+		}
+	}
+	else if (typeInfo->datumlen == -1)
 	{
 		/*
 		 * Variable length items (i.e. varlena).
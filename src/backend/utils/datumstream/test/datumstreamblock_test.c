@@ -166,13 +166,116 @@ test__DeltaCompression__Core(void **state)
 	free(dsw);
 }
 
+/*
+ * Unit test for the bit-packing of dictionary codes and frame-of-reference
+ * values.
+ */
+static void
+test__BitPack__RoundTrip(void **state)
+{
+	uint8		buffer[256];
+	DatumStreamBitPack bp;
+	int			width;
+	int			i;
+
+	assert_int_equal(DatumStreamBitPack_Width(0), 0);
+	assert_int_equal(DatumStreamBitPack_Width(1), 1);
+	assert_int_equal(DatumStreamBitPack_Width(255), 8);
+	assert_int_equal(DatumStreamBitPack_Width(256), 9);
+	assert_int_equal(DatumStreamBitPack_Width(UINT64CONST(0xFFFFFFFFFFFFFFFF)), 64);
+
+	for (width = 1; width <= 64; width++)
+	{
+		uint64		mask = (width == 64) ? ~UINT64CONST(0) :
+			(UINT64CONST(1) << width) - 1;
+
+		memset(buffer, 0xFF, sizeof(buffer));
+		DatumStreamBitPack_Init(&bp, buffer);
+		for (i = 0; i < 17; i++)
+			DatumStreamBitPack_Put(&bp, (UINT64CONST(0x9E3779B97F4A7C15) * i) & mask, width);
+		DatumStreamBitPack_Flush(&bp);
+		assert_int_equal(bp.p - buffer, DatumStreamBitPack_Size(17, width));
+
+		DatumStreamBitPack_Init(&bp, buffer);
+		for (i = 0; i < 17; i++)
+			assert_true(DatumStreamBitPack_Get(&bp, width) ==
+						((UINT64CONST(0x9E3779B97F4A7C15) * i) & mask));
+	}
+}
+
+/*
+ * Unit test for frame-of-reference encoding an Original block and decoding
+ * it on read.
+ */
+static void
+test__FrameOfReference__RoundTrip(void **state)
+{
+	DatumStreamTypeInfo typeInfo;
+	DatumStreamBlockWrite *dsw = malloc(sizeof(DatumStreamBlockWrite));
+	DatumStreamBlockRead *dsr = malloc(sizeof(DatumStreamBlockRead));
+	int16		flag;
+	int32		encodedSize;
+	int32		i;
+
+	typeInfo.datumlen = 4;
+	typeInfo.typid = INT4OID;
+	typeInfo.align = 'i';
+	typeInfo.byval = true;
+
+	memset(dsw, 0, sizeof(DatumStreamBlockWrite));
+	dsw->typeInfo = &typeInfo;
+	dsw->datumStreamVersion = DatumStreamVersion_Original;
+	dsw->maxDataBlockSize = 32768;
+	dsw->maxDatumPerBlock = 1000;
+	dsw->datum_buffer = malloc(dsw->maxDataBlockSize);
+	dsw->encoding_buffer = malloc(dsw->maxDataBlockSize);
+
+	/* Values within 1000 of each other take 10 bits rather than 32. */
+	for (i = 0; i < 1000; i++)
+		((int32 *) dsw->datum_buffer)[i] = -500 + (i * 37) % 1000;
+	dsw->physical_datum_count = 1000;
+	dsw->datump = dsw->datum_buffer + 1000 * sizeof(int32);
+
+	gp_appendonly_block_encodings = true;
+	encodedSize = DatumStreamBlockWrite_EncodeOrig(dsw, &flag);
+	assert_int_equal(flag, DSB_HAS_FOR_ENCODING);
+	assert_int_equal(encodedSize,
+					 sizeof(DatumStreamBlock_Encoding_Extension) + (1000 * 10 + 7) / 8);
+
+	memset(dsr, 0, sizeof(DatumStreamBlockRead));
+	memcpy(&dsr->typeInfo, &typeInfo, sizeof(DatumStreamTypeInfo));
+	dsr->logical_row_count = 1000;
+	dsr->decode_buffer_size = 1000 * sizeof(int32);
+	dsr->decode_buffer = malloc(dsr->decode_buffer_size);
+
+	DatumStreamBlockRead_DecodeOrig(dsr, dsw->encoding_buffer, encodedSize, false);
+	assert_int_equal(dsr->physical_data_size, 1000 * sizeof(int32));
+	assert_true(dsr->datum_beginp == dsr->decode_buffer);
+	assert_int_equal(memcmp(dsr->decode_buffer, dsw->datum_buffer, 1000 * sizeof(int32)), 0);
+
+	/* Values that need all the bits are left plain. */
+	((int32 *) dsw->datum_buffer)[0] = PG_INT32_MIN;
+	((int32 *) dsw->datum_buffer)[1] = PG_INT32_MAX;
+	encodedSize = DatumStreamBlockWrite_EncodeOrig(dsw, &flag);
+	assert_int_equal(encodedSize, -1);
+	assert_int_equal(flag, 0);
+
+	free(dsr->decode_buffer);
+	free(dsr);
+	free(dsw->encoding_buffer);
+	free(dsw->datum_buffer);
+	free(dsw);
+}
+
 int 
 main(int argc, char* argv[]) 
 {
 	cmockery_parse_arguments(argc, argv);
 
 	const UnitTest tests[] = {
-			unit_test(test__DeltaCompression__Core)
+			unit_test(test__DeltaCompression__Core),
+			unit_test(test__BitPack__RoundTrip),
+			unit_test(test__FrameOfReference__RoundTrip)
 	};
 	return run_tests(tests);
 }
@@ -38,6 +38,7 @@
 #include "optimizer/planmain.h"
 #include "pgstat.h"
 #include "parser/scansup.h"
+#include "postmaster/aocompaction.h"
 #include "postmaster/syslogger.h"
 #include "postmaster/fts.h"
 #include "replication/walsender.h"
@@ -80,6 +81,7 @@ static bool check_verify_gpfdists_cert(bool *newval, void **extra, GucSource sou
 static bool check_dispatch_log_stats(bool *newval, void **extra, GucSource source);
 static bool check_gp_hashagg_default_nbatches(int *newval, void **extra, GucSource source);
 static bool check_gp_workfile_compression(bool *newval, void **extra, GucSource source);
+static bool check_gp_motion_compression(bool *newval, void **extra, GucSource source);
 
 /* Helper function for guc setter */
 bool gpvars_check_gp_resqueue_priority_default_value(char **newval,
@@ -142,6 +144,17 @@ bool		gp_appendonly_verify_block_checksums = true;
 bool		gp_appendonly_verify_write_block = false;
 bool		gp_appendonly_compaction = true;
 int			gp_appendonly_compaction_threshold = 0;
+int			gp_appendonly_compaction_chunk_rows = 0;
+int			gp_appendonly_compaction_cost_delay = -1;
+int			gp_appendonly_prefetch_depth = 4;
+int			gp_appendonly_compress_workers = 0;
+int			gp_appendonly_decompress_workers = 0;
+int			gp_appendonly_scan_batch_size = 0;
+int			gp_appendonly_visimap_cache_entries = 1024;
+bool		gp_appendonly_zone_maps = true;
+bool		gp_appendonly_record_zone_maps = false;
+bool		gp_appendonly_late_materialization = false;
+bool		gp_appendonly_block_encodings = false;
 bool		gp_heap_require_relhasoids_match = true;
 bool		gp_local_distributed_cache_stats = false;
 bool		debug_xlog_record_read = false;
@@ -366,6 +379,7 @@ bool		optimizer_enable_dynamicbitmapscan;
 bool		optimizer_enable_indexscan;
 bool		optimizer_enable_indexonlyscan;
 bool		optimizer_enable_tablescan;
+bool		optimizer_enable_simple_query_fast_path;
 bool		optimizer_enable_hashagg;
 bool		optimizer_enable_groupagg;
 bool		optimizer_expand_fulljoin;
@@ -398,6 +412,7 @@ int			optimizer_penalize_broadcast_threshold;
 double		optimizer_cost_threshold;
 double		optimizer_nestloop_factor;
 double		optimizer_sort_factor;
+double		optimizer_motion_compression_factor;
 
 /* Optimizer hints */
 int			optimizer_join_arity_for_associativity_commutativity;
@@ -916,7 +931,7 @@ struct config_bool ConfigureNamesBool_gp[] =
 	{
 		{"gp_enable_motion_mk_sort", PGC_USERSET, QUERY_TUNING_METHOD,
 			gettext_noop("Enable multi-key sort in sorted motion recv."),
-			gettext_noop("A faster sort for recv motion"),
+			gettext_noop("When off, sorted motions merge their input streams with a loser tree."),
 			GUC_NO_SHOW_ALL | GUC_NOT_IN_SAMPLE
 
 		},
@@ -1081,6 +1096,52 @@ struct config_bool ConfigureNamesBool_gp[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"gp_appendonly_zone_maps", PGC_USERSET, APPENDONLY_TABLES,
+			gettext_noop("Skip column-oriented table blocks whose min/max zone cannot satisfy the scan quals."),
+			gettext_noop("Zones are kept in the block directory, so only tables with "
+						 "a block directory (i.e. with an index) can be skipped.")
+		},
+		&gp_appendonly_zone_maps,
+		true,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"gp_appendonly_record_zone_maps", PGC_USERSET, APPENDONLY_TABLES,
+			gettext_noop("Record the min/max zones of column-oriented table blocks in the block directory."),
+			gettext_noop("Block directories written this way cannot be read by "
+						 "older releases. When off, they are written in the "
+						 "original format.")
+		},
+		&gp_appendonly_record_zone_maps,
+		false,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"gp_appendonly_late_materialization", PGC_USERSET, APPENDONLY_TABLES,
+			gettext_noop("Read the columns of column-oriented tables that the scan quals do not use only for rows that pass them."),
+			gettext_noop("The qual columns are decoded first, and the other columns "
+						 "skip the blocks in which no row passes. Only batch scans "
+						 "do this.")
+		},
+		&gp_appendonly_late_materialization,
+		false,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"gp_appendonly_block_encodings", PGC_USERSET, APPENDONLY_TABLES,
+			gettext_noop("Dictionary or frame-of-reference encode the blocks of column-oriented tables when it saves space."),
+			gettext_noop("Applies to columns without RLE_TYPE compression. Blocks "
+						 "written this way cannot be read by older releases.")
+		},
+		&gp_appendonly_block_encodings,
+		false,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"gp_appendonly_compaction", PGC_SUSET, APPENDONLY_TABLES,
 			gettext_noop("Perform append-only compaction instead of eof truncation on vacuum."),
@@ -1221,6 +1282,65 @@ struct config_bool ConfigureNamesBool_gp[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"gp_motion_compression", PGC_USERSET, GP_ARRAY_TUNING,
+			gettext_noop("Compresses the tuples sent by motions."),
+			gettext_noop("Tuple chunks are compressed with zstd in blocks. A motion stops "
+						 "compressing if its data doesn't compress well.")
+		},
+		&gp_motion_compression,
+		false,
+		check_gp_motion_compression, NULL, NULL
+	},
+
+	{
+		{"gp_motion_columnar", PGC_USERSET, GP_ARRAY_TUNING,
+			gettext_noop("Sends tuples of fixed-width columns in batches, column by column."),
+			gettext_noop("Applies to motions whose columns all have fixed-width types. "
+						 "Saves the per-tuple headers and padding of the row format.")
+		},
+		&gp_motion_columnar,
+		false,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"gp_interconnect_udp_gso", PGC_USERSET, GP_ARRAY_TUNING,
+			gettext_noop("Use UDP generic segmentation offload to send interconnect packets."),
+			gettext_noop("Consecutive packets to the same peer are passed to the kernel as one "
+						 "UDP_SEGMENT send. Requires gp_max_packet_size to fit in the interface MTU.")
+		},
+		&gp_interconnect_udp_gso,
+		false,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"gp_interconnect_udp_gro", PGC_BACKEND, GP_ARRAY_TUNING,
+			gettext_noop("Use UDP generic receive offload to receive interconnect packets."),
+			gettext_noop("Lets the kernel coalesce incoming packets from the same peer, "
+						 "which are split again by the interconnect receive thread. "
+						 "Each host reads it from its own configuration when a session "
+						 "starts, so change it with a configuration reload.")
+		},
+		&gp_interconnect_udp_gro,
+		false,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"gp_interconnect_shm_transport", PGC_USERSET, GP_ARRAY_TUNING,
+			gettext_noop("Move same-host TCP interconnect traffic through shared memory."),
+			gettext_noop("When a sender connects to a receiver on the same host, tuple data "
+						 "goes through a shared memory ring and the socket is only used for "
+						 "setup, wakeups and teardown. Linux only; the UDP interconnect "
+						 "always uses its sockets.")
+		},
+		&gp_interconnect_shm_transport,
+		false,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"gp_interconnect_log_stats", PGC_USERSET, QUERY_TUNING_OTHER,
 			gettext_noop("Emit statistics from the UDP-IC at the end of every statement."),
@@ -2554,6 +2674,17 @@ struct config_bool ConfigureNamesBool_gp[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"optimizer_enable_simple_query_fast_path", PGC_USERSET, DEVELOPER_OPTIONS,
+			gettext_noop("Enables the optimizer's reduced search for simple single-table queries."),
+			NULL,
+			GUC_NO_SHOW_ALL | GUC_NOT_IN_SAMPLE
+		},
+		&optimizer_enable_simple_query_fast_path,
+		false,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"optimizer_enable_hashagg", PGC_USERSET, DEVELOPER_OPTIONS,
 			gettext_noop("Enables Pivotal Optimizer (GPORCA) to use hash aggregates."),
@@ -3206,6 +3337,16 @@ struct config_bool ConfigureNamesBool_gp[] =
 		false, NULL, NULL
     },
 
+	{
+		{"gp_appendonly_compaction_worker", PGC_POSTMASTER, APPENDONLY_TABLES,
+			gettext_noop("Starts a process on the master that vacuums append-only tables in the background."),
+			NULL
+		},
+		&gp_appendonly_compaction_worker,
+		false,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"gp_log_endpoints", PGC_SUSET, LOGGING_WHAT,
 			gettext_noop("Prints endpoints information to server log."),
@@ -3596,6 +3737,108 @@ struct config_int ConfigureNamesInt_gp[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"gp_appendonly_compaction_chunk_rows", PGC_USERSET, APPENDONLY_TABLES,
+			gettext_noop("Maximum number of live tuples that lazy vacuum moves out of an append-only segment file at a time."),
+			gettext_noop("Segment files with more live tuples are compacted over several vacuums, "
+						 "hiding the moved tuples. Each vacuum still reads the block headers "
+						 "of the rows moved before, so small chunks make the total I/O grow "
+						 "quadratically with the segment file size. 0 compacts whole segment files.")
+		},
+		&gp_appendonly_compaction_chunk_rows,
+		0, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"gp_appendonly_compaction_cost_delay", PGC_USERSET, APPENDONLY_TABLES,
+			gettext_noop("Vacuum cost delay in milliseconds, for append-only compaction."),
+			gettext_noop("-1 uses vacuum_cost_delay."),
+			GUC_UNIT_MS
+		},
+		&gp_appendonly_compaction_cost_delay,
+		-1, -1, 100,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"gp_appendonly_compaction_worker_naptime", PGC_SIGHUP, APPENDONLY_TABLES,
+			gettext_noop("Time to sleep between runs of the append-only compaction process."),
+			NULL,
+			GUC_UNIT_S
+		},
+		&gp_appendonly_compaction_worker_naptime,
+		60, 1, INT_MAX / 1000,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"gp_appendonly_compaction_worker_cost_delay", PGC_SIGHUP, APPENDONLY_TABLES,
+			gettext_noop("Append-only compaction cost delay in milliseconds, for the append-only compaction process."),
+			gettext_noop("-1 uses vacuum_cost_delay."),
+			GUC_UNIT_MS
+		},
+		&gp_appendonly_compaction_worker_cost_delay,
+		20, -1, 100,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"gp_appendonly_prefetch_depth", PGC_USERSET, APPENDONLY_TABLES,
+			gettext_noop("Number of large reads ahead that append-only scans ask the kernel to prefetch."),
+			gettext_noop("Each segment file, and each column of a column-oriented table, "
+						 "keeps this many reads in flight. Bitmap scans also read ahead "
+						 "this many block directory ranges. 0 disables prefetching.")
+		},
+		&gp_appendonly_prefetch_depth,
+		4, 0, 64,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"gp_appendonly_compress_workers", PGC_USERSET, APPENDONLY_TABLES,
+			gettext_noop("Number of helper threads that compress append-only blocks during inserts."),
+			gettext_noop("Applies to zlib and zstd compressed tables without indexes. "
+						 "0 compresses every block in the backend itself.")
+		},
+		&gp_appendonly_compress_workers,
+		0, 0, 32,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"gp_appendonly_decompress_workers", PGC_USERSET, APPENDONLY_TABLES,
+			gettext_noop("Number of helper threads that decompress append-only blocks ahead of the scan."),
+			gettext_noop("Applies to zlib and zstd compressed tables. "
+						 "0 decompresses every block in the backend itself.")
+		},
+		&gp_appendonly_decompress_workers,
+		0, 0, 32,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"gp_appendonly_scan_batch_size", PGC_USERSET, APPENDONLY_TABLES,
+			gettext_noop("Number of rows that column-oriented table scans decode per column at a time."),
+			gettext_noop("Simple quals on the scanned columns are checked on each batch before "
+						 "rows are returned. 0 decodes the columns row by row.")
+		},
+		&gp_appendonly_scan_batch_size,
+		0, 0, 65536,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"gp_appendonly_visimap_cache_entries", PGC_USERSET, APPENDONLY_TABLES,
+			gettext_noop("Number of decompressed visibility map entries that an append-only table scan keeps in memory."),
+			gettext_noop("Each entry covers 32768 rows and takes at most 4 kB. "
+						 "0 reads an entry from the visibility map every time the scan moves to it.")
+		},
+		&gp_appendonly_visimap_cache_entries,
+		1024, 0, 65536,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"gp_workfile_max_entries", PGC_POSTMASTER, RESOURCES,
 			gettext_noop("Sets the maximum number of entries that can be stored in the workfile directory"),
@@ -3792,6 +4035,16 @@ struct config_int ConfigureNamesInt_gp[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"gp_interconnect_udp_batch_size", PGC_USERSET, GP_ARRAY_TUNING,
+			gettext_noop("Sets the maximum number of packets sent or received by one system call in the UDP interconnect."),
+			gettext_noop("1 sends and receives one packet per system call.")
+		},
+		&gp_interconnect_udp_batch_size,
+		1, 1, GP_INTERCONNECT_UDP_MAX_BATCH_SIZE,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"gp_interconnect_cursor_ic_table_size", PGC_USERSET, GP_ARRAY_TUNING,
 			gettext_noop("Sets the size of Cursor Table in the UDP interconnect"),
@@ -4250,6 +4503,51 @@ struct config_int ConfigureNamesInt_gp[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"gp_motion_skew_sample_rows", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Sets the number of rows in which each sender checks the hot join keys before spreading them."),
+			gettext_noop("The hot keys that gp_motion_skew_threshold picks from the statistics "
+						 "are only spread further if they make up that fraction of the first "
+						 "rows a sender sends. 0 spreads them throughout.")
+		},
+		&gp_motion_skew_sample_rows,
+		10000, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"gp_motion_send_batch_size", PGC_USERSET, GP_ARRAY_TUNING,
+			gettext_noop("Sets the number of tuples a redistribute motion hashes and sends as one batch."),
+			gettext_noop("1 hashes and sends every tuple as soon as it is produced.")
+		},
+		&gp_motion_send_batch_size,
+		1, 1, 1024,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"gp_motion_compression_level", PGC_USERSET, GP_ARRAY_TUNING,
+			gettext_noop("Sets the zstd compression level used by gp_motion_compression."),
+			NULL
+		},
+		&gp_motion_compression_level,
+		1, 1, 19,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"gp_motion_compression_max_delay", PGC_USERSET, GP_ARRAY_TUNING,
+			gettext_noop("Sets the longest time a tuple waits to be compressed by gp_motion_compression."),
+			gettext_noop("A motion compresses the tuples for each target in blocks. A block that "
+						 "is not full yet is sent once its first tuple has waited this long. "
+						 "0 only sends full blocks."),
+			GUC_UNIT_MS
+		},
+		&gp_motion_compression_max_delay,
+		100, 0, INT_MAX / 1000,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"gp_reject_percent_threshold", PGC_USERSET, GP_ERROR_HANDLING,
 			gettext_noop("Reject limit in percent starts calculating after this number of rows processed"),
@@ -4844,6 +5142,20 @@ struct config_real ConfigureNamesReal_gp[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"gp_motion_skew_threshold", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Sets the fraction of rows above which a join key value is spread across segments."),
+			gettext_noop("When a join redistributes both inputs, the rows of join key values "
+						 "that make up at least this fraction of one input are spread across "
+						 "all segments, and the matching rows of the other input are broadcast. "
+						 "0 disables this. Only the Postgres planner does this; GPORCA plans "
+						 "always redistribute by hash.")
+		},
+		&gp_motion_skew_threshold,
+		0, 0, 1,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"gp_selectivity_damping_factor", PGC_USERSET, QUERY_TUNING_METHOD,
 			gettext_noop("Factor used in selectivity damping."),
@@ -4950,6 +5262,20 @@ struct config_real ConfigureNamesReal_gp[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"optimizer_motion_compression_factor", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Set the motion cost factor in the optimizer when gp_motion_compression is on."),
+			gettext_noop("The network cost of motions is multiplied by this factor. Set it to the "
+						 "bytes on wire divided by the bytes of tuple chunks that EXPLAIN ANALYZE "
+						 "reports for the compressed motions of the workload. 1.0 leaves the "
+						 "costs unchanged."),
+			GUC_NO_SHOW_ALL | GUC_NOT_IN_SAMPLE
+		},
+		&optimizer_motion_compression_factor,
+		1.0, 0.0, DBL_MAX,
+		NULL, NULL, NULL
+	},
+
 	/* End-of-list marker */
 	{
 		{NULL, 0, 0, NULL, NULL}, NULL, 0.0, 0.0, 0.0, NULL, NULL
@@ -5801,6 +6127,19 @@ check_gp_workfile_compression(bool *newval, void **extra, GucSource source)
 	return true;
 }
 
+static bool
+check_gp_motion_compression(bool *newval, void **extra, GucSource source)
+{
+#ifndef HAVE_LIBZSTD
+	if (*newval)
+	{
+		GUC_check_errmsg("motion compression is not supported by this build");
+		return false;
+	}
+#endif
+	return true;
+}
+
 static void
 dispatch_sync_pg_variable_internal(struct config_generic * gconfig, bool is_explicit)
 {
@@ -18,6 +18,7 @@
 #include "utils/rel.h"
 #include "access/memtup.h"
 #include "executor/tuptable.h"
+#include "fmgr.h"
 
 #define APPENDONLY_COMPACTION_SEGNO_INVALID (-1)
 
@@ -39,5 +40,17 @@ extern void AppendOnlyThrowAwayTuple(Relation rel,
 extern void AppendOnlyTruncateToEOF(Relation aorel);
 extern bool HasLockForSegmentFileDrop(Relation aorel);
 extern bool AppendOnlyCompaction_IsRelationEmpty(Relation aorel);
+extern int64 AppendOnlyCompaction_ChunkRows(int64 totalTupcount,
+							   int64 hiddenTupcount, bool isFull);
+extern void AppendOnlyCompaction_DelayPoint(bool moved);
+extern void AppendOnlyCompaction_ReportBegin(Relation aorel, int segno,
+								 int64 totalTupcount, int64 liveTupcount,
+								 bool partial);
+extern void AppendOnlyCompaction_ReportProgress(int64 scannedTupcount,
+									int64 movedTupcount);
+extern void AppendOnlyCompaction_ReportEnd(void);
+extern Size AppendOnlyCompactionShmemSize(void);
+extern void AppendOnlyCompactionShmemInit(void);
+extern Datum gp_stat_get_appendonly_compaction(PG_FUNCTION_ARGS);
 
 #endif
@@ -57,6 +57,17 @@ typedef struct AppendOnlyVisimap
 	 */
 	AppendOnlyVisimapStore visimapStore;
 
+	/*
+	 * Decompressed entries that were already read from the visimap table,
+	 * keyed by segment file and first row number, including the ranges
+	 * without an entry. Used by AppendOnlyVisimap_Find, so that moving back
+	 * to an entry does not search and decompress it again. Kept in
+	 * cacheContext, and NULL if gp_appendonly_visimap_cache_entries is 0.
+	 */
+	MemoryContext cacheContext;
+	HTAB	   *entryCache;
+	int			maxCacheEntries;
+
 } AppendOnlyVisimap;
 
 /*
@@ -109,6 +120,16 @@ bool AppendOnlyVisimap_IsVisible(
 							AppendOnlyVisimap *visiMap,
 							AOTupleId *tupleId);
 
+bool AppendOnlyVisimap_IsRangeVisible(
+							AppendOnlyVisimap *visiMap,
+							int segno,
+							int64 firstRowNum,
+							int64 rowCount);
+
+int64 AppendOnlyVisimap_GetFirstVisibleRowNum(
+							AppendOnlyVisimap *visiMap,
+							int segno);
+
 void AppendOnlyVisimap_Finish(
 						 AppendOnlyVisimap *visiMap,
 						 LOCKMODE lockmode);
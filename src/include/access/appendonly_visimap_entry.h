@@ -123,6 +123,15 @@ bool AppendOnlyVisimapEntry_IsVisible(
 								 AppendOnlyVisimapEntry *visiMapEntry,
 								 AOTupleId *aoTupleId);
 
+bool AppendOnlyVisimapEntry_IsRangeVisible(
+								 AppendOnlyVisimapEntry *visiMapEntry,
+								 int64 firstRowNum,
+								 int64 lastRowNum);
+
+int64 AppendOnlyVisimapEntry_GetFirstVisibleRowNum(
+								 AppendOnlyVisimapEntry *visiMapEntry,
+								 int64 rowNum);
+
 HTSU_Result AppendOnlyVisimapEntry_HideTuple(
 								 AppendOnlyVisimapEntry *visiMapEntry,
 								 AOTupleId *aoTupleId);
@@ -152,6 +152,8 @@
 
  CREATE FUNCTION gp_update_ao_master_stats(regclass) RETURNS int8 LANGUAGE internal VOLATILE MODIFIES SQL DATA AS 'gp_update_ao_master_stats' WITH (OID=7173, DESCRIPTION="append only tables utility function");
 
+ CREATE FUNCTION gp_stat_get_appendonly_compaction(OUT gp_segment_id int4, OUT pid int4, OUT datid oid, OUT relid oid, OUT segno int4, OUT mode text, OUT total_tupcount int8, OUT live_tupcount int8, OUT scanned_tupcount int8, OUT moved_tupcount int8, OUT start_time timestamptz) RETURNS SETOF record LANGUAGE internal VOLATILE EXECUTE ON ALL SEGMENTS AS 'gp_stat_get_appendonly_compaction' WITH (OID=7174, DESCRIPTION="statistics: append only segment file compactions in progress");
+
 -- the bitmap index access method routines
  CREATE FUNCTION bmgettuple(internal, internal) RETURNS bool LANGUAGE internal VOLATILE STRICT AS 'bmgettuple' WITH (OID=7050, DESCRIPTION="bitmap(internal)");
 
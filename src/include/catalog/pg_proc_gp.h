@@ -318,6 +318,10 @@ DESCR("show append only table compression ratio");
 DATA(insert OID = 7173 ( gp_update_ao_master_stats  PGNSP PGUID 12 1 0 0 0 f f f f f f v 1 0 20 "2205" _null_ _null_ _null_ _null_ gp_update_ao_master_stats _null_ _null_ _null_ m a ));
 DESCR("append only tables utility function");
 
+/* gp_stat_get_appendonly_compaction(OUT gp_segment_id int4, OUT pid int4, OUT datid oid, OUT relid oid, OUT segno int4, OUT mode text, OUT total_tupcount int8, OUT live_tupcount int8, OUT scanned_tupcount int8, OUT moved_tupcount int8, OUT start_time timestamptz) => SETOF record */
+DATA(insert OID = 7174 ( gp_stat_get_appendonly_compaction  PGNSP PGUID 12 1 1000 0 0 f f f f f t v 0 0 2249 "" "{23,23,26,26,23,25,20,20,20,20,1184}" "{o,o,o,o,o,o,o,o,o,o,o}" "{gp_segment_id,pid,datid,relid,segno,mode,total_tupcount,live_tupcount,scanned_tupcount,moved_tupcount,start_time}" _null_ gp_stat_get_appendonly_compaction _null_ _null_ _null_ n s ));
+DESCR("statistics: append only segment file compactions in progress");
+
 
 /* the bitmap index access method routines */
 /* bmgettuple(internal, internal) => bool */
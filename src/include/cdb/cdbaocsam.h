@@ -71,6 +71,16 @@ typedef struct AOCSInsertDescData
 
 typedef AOCSInsertDescData *AOCSInsertDesc;
 
+/*
+ * A range of row numbers [firstRowNum, afterRowNum) of a segment file that
+ * the block zones show cannot satisfy the scan's zone keys.
+ */
+typedef struct AOCSZoneSkipRange
+{
+	int64		firstRowNum;
+	int64		afterRowNum;
+} AOCSZoneSkipRange;
+
 /*
  * used for scan of append only relations using BufferedRead and VarBlocks
  */
@@ -126,6 +136,60 @@ typedef struct AOCSScanDescData
 
 	AppendOnlyVisimap visibilityMap;
 
+	/*
+	 * Simple quals of the scan, see aocs_set_scankeys(). They drive zone
+	 * map skipping, and filter the rows of each batch.
+	 */
+	int			numScanKeys;
+	ScanKey		scanKeys;
+
+	/*
+	 * Zone map skipping. The skip ranges are rebuilt from the block
+	 * directory for each segment file, plus the rows before startRowNum,
+	 * see aocs_set_startrow().
+	 */
+	AOCSZoneSkipRange *zoneSkipRanges;
+	int			numZoneSkipRanges;
+	int			nextZoneSkipRange;
+	int64		zoneNextRowNum;		/* lowest row number not yet passed */
+	int64		zoneBlocksSkipped;	/* column blocks skipped, for EXPLAIN */
+	int64		startRowNum;
+
+	/*
+	 * Batch scanning, see aocs_fill_batch(). Up to batchSize rows of each
+	 * projected column are decoded at a time into batchValues[attno] and
+	 * batchNulls[attno]. batchSelection holds the rows of the batch that
+	 * pass the scan keys, batchNext the next of them to return.
+	 */
+	int			batchSize;
+	Datum	  **batchValues;
+	bool	  **batchNulls;
+	int		   *batchSelection;
+	int			batchNumSelected;
+	int			batchNext;
+	int64		batchFirstRowNum;	/* row number of the first row */
+
+	/*
+	 * Filtering on dictionary codes. For key columns of pass-by-reference
+	 * types, batchCodes[attno] gets the dictionary code of each row of a
+	 * dictionary encoded block. keyDictMatch[keyNo] caches whether each
+	 * value of the dictionary keyDictId[keyNo] satisfies the key.
+	 */
+	int32	  **batchCodes;
+	bool	  **keyDictMatch;
+	int64	   *keyDictId;
+
+	/*
+	 * Late materialization, see aocs_set_scankeys(). Only the batchAtts
+	 * columns are decoded in batches. The lateAtts columns are read just
+	 * for the selected rows, skipping blocks that have none.
+	 */
+	int		   *batchAtts;
+	int			numBatchAtts;
+	int		   *lateAtts;
+	int			numLateAtts;
+	int64		lateBlocksSkipped;	/* column blocks skipped, for EXPLAIN */
+
 }	AOCSScanDescData;
 
 typedef AOCSScanDescData *AOCSScanDesc;
@@ -163,6 +227,23 @@ typedef struct AOCSFetchDescData
 
 	AppendOnlyVisimap visibilityMap;
 
+	/* First column to fetch; the others follow its segment file. */
+	int			firstProjectedColNo;
+
+	/*
+	 * Sorted TIDs of the current batch, and how far they have been fetched
+	 * and prefetched (see aocs_fetch_batch_begin and the row-oriented
+	 * counterpart in AppendOnlyFetchDescData).
+	 */
+	AOTupleId  *batchTids;
+	int			batchNumTids;
+	int			batchNextTid;
+
+	bool		prefetchDirectoryValid;
+	AppendOnlyBlockDirectory prefetchDirectory;
+	int			batchPrefetchTid;
+	int			batchRefillTid;
+
 } AOCSFetchDescData;
 
 typedef AOCSFetchDescData *AOCSFetchDesc;
@@ -208,6 +289,8 @@ extern AOCSScanDesc aocs_beginrangescan(Relation relation, Snapshot snapshot,
 		int *segfile_no_arr, int segfile_count,
 	TupleDesc relationTupleDesc, bool *proj);
 
+extern void aocs_set_scankeys(AOCSScanDesc scan, int nkeys, ScanKey keys);
+extern void aocs_set_startrow(AOCSScanDesc scan, int64 startRowNum);
 extern void aocs_afterscan(AOCSScanDesc scan);
 extern void aocs_rescan(AOCSScanDesc scan);
 extern void aocs_endscan(AOCSScanDesc scan);
@@ -234,6 +317,11 @@ extern AOCSFetchDesc aocs_fetch_init(Relation relation,
 extern bool aocs_fetch(AOCSFetchDesc aocsFetchDesc,
 					   AOTupleId *aoTupleId,
 					   TupleTableSlot *slot);
+extern void aocs_fetch_batch_begin(AOCSFetchDesc aocsFetchDesc,
+								   AOTupleId *aoTupleIds,
+								   int numTids);
+extern bool aocs_fetch_batch_next(AOCSFetchDesc aocsFetchDesc,
+								  TupleTableSlot *slot);
 extern void aocs_fetch_finish(AOCSFetchDesc aocsFetchDesc);
 
 extern AOCSUpdateDesc aocs_update_init(Relation rel, int segno);
@@ -221,6 +221,17 @@ typedef struct AppendOnlyScanDescData
 	 */ 
 	AppendOnlyVisimap visibilityMap;
 
+	/*
+	 * True if the visibility map shows no deleted row in the current block.
+	 */
+	bool		blockAllVisible;
+
+	/*
+	 * Blocks that only hold rows before this row number are passed over
+	 * without reading their contents, see appendonly_set_startrow().
+	 */
+	int64		startRowNum;
+
 }	AppendOnlyScanDescData;
 
 typedef AppendOnlyScanDescData *AppendOnlyScanDesc;
@@ -312,6 +323,28 @@ typedef struct AppendOnlyFetchDescData
 
 	AppendOnlyVisimap visibilityMap;
 
+	/*
+	 * Sorted TIDs of the current batch (see appendonly_fetch_batch_begin).
+	 * The array belongs to the caller.
+	 */
+	AOTupleId  *batchTids;
+	int			batchNumTids;
+	int			batchNextTid;
+
+	/*
+	 * Block directory ranges ahead of the fetch position are looked up in
+	 * a directory of their own, so that the one used for fetching keeps its
+	 * current minipage.  batchPrefetchTid is the next TID to look at, and
+	 * batchRefillTid the first TID of the last range prefetched; the next
+	 * round of prefetching starts when the fetch gets there.
+	 */
+	bool		prefetchDirectoryValid;
+	AppendOnlyBlockDirectory prefetchDirectory;
+	AppendOnlyBlockDirectoryEntry prefetchEntry;
+	bool		prefetchEntryValid;
+	int			batchPrefetchTid;
+	int			batchRefillTid;
+
 }	AppendOnlyFetchDescData;
 
 typedef AppendOnlyFetchDescData *AppendOnlyFetchDesc;
@@ -335,6 +368,7 @@ extern AppendOnlyScanDesc appendonly_beginrangescan(Relation relation,
 		Snapshot appendOnlyMetaDataSnapshot, 
 		int *segfile_no_arr, int segfile_count,
 		int nkeys, ScanKey keys);
+extern void appendonly_set_startrow(AppendOnlyScanDesc scan, int64 startRowNum);
 extern void appendonly_afterscan(AppendOnlyScanDesc scan);
 extern void appendonly_rescan(AppendOnlyScanDesc scan, ScanKey key);
 extern void appendonly_endscan(AppendOnlyScanDesc scan);
@@ -349,6 +383,11 @@ extern bool appendonly_fetch(
 	AppendOnlyFetchDesc aoFetchDesc,
 	AOTupleId *aoTid,
 	TupleTableSlot *slot);
+extern void appendonly_fetch_batch_begin(AppendOnlyFetchDesc aoFetchDesc,
+							 AOTupleId *aoTupleIds,
+							 int numTids);
+extern bool appendonly_fetch_batch_next(AppendOnlyFetchDesc aoFetchDesc,
+							TupleTableSlot *slot);
 extern void appendonly_fetch_finish(AppendOnlyFetchDesc aoFetchDesc);
 extern AppendOnlyInsertDesc appendonly_insert_init(Relation rel, int segno, bool update_mode);
 extern Oid appendonly_insert(
@@ -18,6 +18,7 @@
 #include "access/aocssegfiles.h"
 #include "access/appendonlytid.h"
 #include "access/skey.h"
+#include "utils/sortsupport.h"
 
 extern int gp_blockdirectory_entry_min_range;
 extern int gp_blockdirectory_minipage_size;
@@ -48,6 +49,31 @@ typedef struct MinipageEntry
 	int64 rowCount;
 } MinipageEntry;
 
+/*
+ * The zone (min/max/null count) of the values covered by a minipage entry.
+ *
+ * Zones are only kept for column groups holding a single fixed-length
+ * pass-by-value column with a btree ordering, so the min and max values
+ * are stored as the raw Datum.
+ */
+typedef struct MinipageZone
+{
+	int64 minValue;
+	int64 maxValue;
+	int32 nullCount;
+	int32 flags;
+} MinipageZone;
+
+#define MINIPAGE_ZONE_VALID			0x0001	/* the zone covers the whole entry */
+#define MINIPAGE_ZONE_HAS_VALUES	0x0002	/* minValue/maxValue are set */
+
+/*
+ * Minipage versions. A minipage with zones stores nEntry MinipageZones
+ * right after the nEntry MinipageEntries.
+ */
+#define MINIPAGE_VERSION_ORIGINAL	0
+#define MINIPAGE_VERSION_ZONES		1
+
 /*
  * Define a varlena type for a minipage.
  */
@@ -69,10 +95,22 @@ typedef struct Minipage
 typedef struct MinipagePerColumnGroup
 {
 	Minipage *minipage;
+	MinipageZone *zones;	/* parallel to minipage->entry */
 	uint32 numMinipageEntries;
 	ItemPointerData tupleTid;
 } MinipagePerColumnGroup;
 
+/*
+ * A block directory entry that carries a valid zone, as returned by
+ * AppendOnlyBlockDirectory_GetZones().
+ */
+typedef struct AppendOnlyBlockZone
+{
+	int64 firstRowNum;
+	int64 rowCount;
+	MinipageZone zone;
+} AppendOnlyBlockZone;
+
 /*
  * I don't know the ideal value here. But let us put approximate
  * 8 minipages per heap page.
@@ -199,6 +237,15 @@ extern bool AppendOnlyBlockDirectory_InsertEntry(
 	int64 fileOffset,
 	int64 rowCount,
 	bool addColAction);
+extern bool AppendOnlyBlockDirectory_InsertEntryWithZone(
+	AppendOnlyBlockDirectory *blockDirectory,
+	int columnGroupNo,
+	int64 firstRowNum,
+	int64 fileOffset,
+	int64 rowCount,
+	bool addColAction,
+	MinipageZone *zone,
+	SortSupport zoneSortSupport);
 extern bool AppendOnlyBlockDirectory_addCol_InsertEntry(
 	AppendOnlyBlockDirectory *blockDirectory,
 	int columnGroupNo,
@@ -218,6 +265,19 @@ extern void AppendOnlyBlockDirectory_End_forSearch(
 	AppendOnlyBlockDirectory *blockDirectory);
 extern void AppendOnlyBlockDirectory_End_addCol(
 	AppendOnlyBlockDirectory *blockDirectory);
+extern AppendOnlyBlockZone *AppendOnlyBlockDirectory_GetZones(
+	Relation aoRel,
+	Snapshot snapshot,
+	int segno,
+	int columnGroupNo,
+	int64 eof,
+	int *numZones);
+extern void AppendOnlyBlockZone_Reset(MinipageZone *zone);
+extern void AppendOnlyBlockZone_Add(
+	MinipageZone *zone,
+	SortSupport zoneSortSupport,
+	Datum value,
+	bool isnull);
 extern void AppendOnlyBlockDirectory_DeleteSegmentFile(
 	Relation aoRel,
 		Snapshot snapshot,
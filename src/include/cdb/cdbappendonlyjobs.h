@@ -0,0 +1,67 @@
+/*-------------------------------------------------------------------------
+ *
+ * cdbappendonlyjobs.h
+ *	  Compress and decompress Append-Only Storage Blocks on helper threads.
+ *
+ * A backend can start a small pool of threads that compress or decompress
+ * blocks while the backend goes on with other work:
+ *
+ * - AppendOnlyStorageRead submits the compressed content of the blocks
+ *   that follow the current one, as far as they are already in memory, and
+ *   takes the decompressed content when the scan reaches them
+ *   (gp_appendonly_decompress_workers).
+ * - AppendOnlyStorageWrite submits each block it fills, and takes the
+ *   compressed content back in submit order to append it to the segment
+ *   file (gp_appendonly_compress_workers).
+ *
+ * The threads only ever call the compression library. They never touch
+ * memory contexts, elog or any other backend state, so any failure is just
+ * reported back, and the backend then does the work the usual way, which
+ * raises the proper error.
+ *
+ * IDENTIFICATION
+ *	    src/include/cdb/cdbappendonlyjobs.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef CDBAPPENDONLYJOBS_H
+#define CDBAPPENDONLYJOBS_H
+
+/*
+ * The bulk-compression libraries that the threads can call directly.
+ */
+typedef enum AppendOnlyCompressionAlgorithm
+{
+	AppendOnlyCompression_None = 0,
+	AppendOnlyCompression_Zlib,
+	AppendOnlyCompression_Zstd
+} AppendOnlyCompressionAlgorithm;
+
+typedef enum AppendOnlyJobKind
+{
+	AppendOnlyJob_Compress,
+	AppendOnlyJob_Decompress
+} AppendOnlyJobKind;
+
+extern AppendOnlyCompressionAlgorithm AppendOnlyCompression_AlgorithmFor(char *compressType);
+
+extern int64 AppendOnlyJobs_NewOwner(void);
+
+extern int	AppendOnlyJobs_NumSlots(AppendOnlyJobKind kind);
+
+extern int	AppendOnlyJobs_NumPending(int64 owner);
+
+extern bool AppendOnlyJobs_Submit(int64 owner, int64 key,
+					  AppendOnlyJobKind kind,
+					  AppendOnlyCompressionAlgorithm algorithm,
+					  int level,
+					  uint8 *input, int32 inputLen,
+					  int32 outputLen);
+
+extern bool AppendOnlyJobs_Take(int64 owner, int64 key,
+					uint8 *output, int32 outputCapacity,
+					int32 *outputLen, uint8 *input);
+
+extern void AppendOnlyJobs_Release(int64 owner, int64 beforeKey);
+
+#endif   /* CDBAPPENDONLYJOBS_H */
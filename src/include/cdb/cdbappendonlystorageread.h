@@ -16,6 +16,7 @@
 
 #include "catalog/pg_appendonly.h"
 #include "catalog/pg_compression.h"
+#include "cdb/cdbappendonlyjobs.h"
 #include "cdb/cdbappendonlystorage.h"
 #include "cdb/cdbappendonlystoragelayer.h"
 #include "cdb/cdbbufferedread.h"
@@ -189,6 +190,15 @@ typedef struct AppendOnlyStorageRead
 										 * pointers. The array index
 										 * corresponds to COMP_FUNC_*	*/
 
+	/*
+	 * Decompression of the following blocks on helper threads, see
+	 * cdbappendonlyjobs.h. AppendOnlyCompression_None when not done.
+	 * decompressAheadOffset is the file offset of the next block to submit.
+	 */
+	AppendOnlyCompressionAlgorithm decompressAlgorithm;
+	int64		decompressOwner;
+	int64		decompressAheadOffset;
+
 } AppendOnlyStorageRead;
 
 extern void AppendOnlyStorageRead_Init(AppendOnlyStorageRead *storageRead,
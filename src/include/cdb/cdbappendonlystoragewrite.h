@@ -16,6 +16,7 @@
 
 #include "catalog/pg_appendonly.h"
 #include "catalog/pg_compression.h"
+#include "cdb/cdbappendonlyjobs.h"
 #include "cdb/cdbappendonlystorage.h"
 #include "cdb/cdbappendonlystoragelayer.h"
 #include "cdb/cdbbufferedappend.h"
@@ -174,6 +175,26 @@ typedef struct AppendOnlyStorageWrite
 
 	bool needsWAL;
 
+	/*
+	 * Blocks handed to the compression threads and not yet appended, in
+	 * the order they were finished, when pipelined compression is enabled
+	 * by AppendOnlyStorageWrite_EnablePipeline. pipelineAlgorithm is
+	 * AppendOnlyCompression_None otherwise.
+	 */
+	AppendOnlyCompressionAlgorithm pipelineAlgorithm;
+	int64		pipelineOwner;
+	struct AppendOnlyStoragePendingBlock *pipelineBlocks;
+	int			pipelineMaxBlocks;
+	int			pipelineFirst;
+	int			pipelineCount;
+	int64		pipelineNextBlockNo;
+
+	/*
+	 * Buffer the content of a block that the threads could not compress is
+	 * taken back into.
+	 */
+	uint8	   *pipelineSourceBuffer;
+
 } AppendOnlyStorageWrite;
 
 extern void AppendOnlyStorageWrite_Init(AppendOnlyStorageWrite *storageWrite,
@@ -184,6 +205,7 @@ extern void AppendOnlyStorageWrite_Init(AppendOnlyStorageWrite *storageWrite,
 										AppendOnlyStorageAttributes *storageAttributes,
 										bool needsWAL);
 extern void AppendOnlyStorageWrite_FinishSession(AppendOnlyStorageWrite *storageWrite);
+extern void AppendOnlyStorageWrite_EnablePipeline(AppendOnlyStorageWrite *storageWrite);
 
 extern void AppendOnlyStorageWrite_TransactionCreateFile(AppendOnlyStorageWrite *storageWrite,
 											 RelFileNodeBackend *relFileNode,
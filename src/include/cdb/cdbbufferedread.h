@@ -50,6 +50,12 @@ typedef struct BufferedRead
 							 * The position within the current file of the current read
 							 * and the number of bytes read into in largeReadMemory.
 							 */
+
+	int64				 prefetchPosition;
+							/*
+							 * The end of the file range that we have asked the
+							 * kernel to read ahead (see gp_appendonly_prefetch_depth).
+							 */
 	
 	/*
 	 * Buffer level members.
@@ -143,6 +149,18 @@ extern uint8 *BufferedReadGetNextBuffer(
     int32              maxReadAheadLen,
     int32              *nextBufferLen);
 
+/*
+ * Return the address of len bytes of the file at position, if they are
+ * already in memory from the current large read. Otherwise, NULL.
+ *
+ * This does not change the read position. The bytes are only valid until
+ * the next buffer is requested.
+ */
+extern uint8 *BufferedReadPeek(
+    BufferedRead       *bufferedRead,
+    int64              position,
+    int32              len);
+
 /*
  * Grow the available length of the current buffer.
  *
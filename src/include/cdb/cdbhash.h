@@ -30,6 +30,20 @@ typedef enum
 	REDUCE_JUMP_HASH
 } CdbHashReduce;
 
+/*
+ * How the hash value of one distribution key column is computed. Hash
+ * functions of the common fixed-width and text types are computed inline,
+ * everything else is called through fmgr.
+ */
+typedef enum
+{
+	CDBHASH_KERNEL_FMGR = 0,
+	CDBHASH_KERNEL_INT2,		/* hashint2 */
+	CDBHASH_KERNEL_INT4,		/* hashint4, also used for date */
+	CDBHASH_KERNEL_INT8,		/* hashint8, timestamp_hash */
+	CDBHASH_KERNEL_TEXT			/* hashtext, hashvarlena */
+} CdbHashKernel;
+
 /*
  * Structure that holds Greengage Database hashing information.
  */
@@ -43,6 +57,7 @@ typedef struct CdbHash
 
 	int			natts;
 	FmgrInfo   *hashfuncs;
+	CdbHashKernel *kernels;
 } CdbHash;
 
 /*
@@ -67,6 +82,17 @@ extern void cdbhash(CdbHash *h, int attno, Datum datum, bool isnull);
  */
 extern unsigned int cdbhashreduce(CdbHash *h);
 
+/*
+ * Hash a batch of rows and reduce each of them to a segment number.
+ */
+extern void cdbhashbatch(CdbHash *h, int nrows, Datum *values, bool *isnull,
+						 unsigned int *targets);
+
+extern void cdbhashbatchraw(CdbHash *h, int nrows, Datum *values, bool *isnull,
+							uint32 *hashes);
+
+extern unsigned int cdbhashreduceraw(CdbHash *h, uint32 hash);
+
 /*
  * Return a random segment number, for a randomly distributed policy.
  */
@@ -233,6 +233,13 @@ struct MotionConn
 	/* size of the message in the buffer, if any. */
 	int32		msgSize;
 
+	/*
+	 * UDP sender with gp_interconnect_full_crc: running CRC-32C of the
+	 * payload bytes in pBuff up to offset xmitCrcLen.
+	 */
+	uint32		xmitCrc;
+	int32		xmitCrcLen;
+
 	/* position of message inside of buffer, "cursor" pointer */
 	uint8	   *msgPos;
 
@@ -242,6 +249,22 @@ struct MotionConn
 	 */
 	int32		recvBytes;
 
+	/*
+	 * TCP receiver with epoll: the socket may still hold unread data, i.e.
+	 * readiness was reported and no recv() has come up short since.
+	 */
+	bool		sockReadable;
+	bool		onReadyList;
+
+	/*
+	 * TCP with gp_interconnect_shm_transport: shared memory ring that
+	 * carries the data of a same-host connection, see ic_shm.c.
+	 */
+	struct ICShmRing *shmRing;
+	Size		shmRingMapSize;
+	bool		shmRingOwner;	/* sender side: created it */
+	char		shmRingName[64];
+
 	int			tupleCount;
 
 	/*
@@ -333,6 +356,18 @@ typedef struct ChunkTransportStateEntry
 
     int         scanStart;
 
+	/*
+	 * TCP receiver with epoll: edge-triggered epoll instance watching the
+	 * sockets in readSet, the dispatcher socket registered with it on the
+	 * QD, and a FIFO ring of the conns that may have data to read (indexes
+	 * into conns).
+	 */
+	int			epollFd;
+	int			epollWaitFd;
+	int		   *readyConns;
+	int			readyHead;
+	int			numReadyConns;
+
     /* slice table entries */
     struct Slice   *sendSlice;
     struct Slice   *recvSlice;
@@ -352,6 +387,8 @@ typedef struct ChunkTransportStateEntry
 	uint64 stat_count_resent;
 	uint64 stat_max_resent;
 	uint64 stat_count_dropped;
+	uint64 stat_count_xmit_pkts;
+	uint64 stat_count_xmit_syscalls;
 
 }	ChunkTransportStateEntry;
 
@@ -438,6 +475,16 @@ typedef struct MotionNodeEntry
 	bool            moreNetWork;
 	bool            stopped;
 
+	/* State of gp_motion_compression, see cdbmotion.c. NULL if unused. */
+	struct MotionCompressState *compress;
+
+	/*
+	 * gp_motion_columnar batches, one per route plus one for broadcast. NULL
+	 * if unused.
+	 */
+	ColumnarBatch *columnar_batches;
+	int			num_columnar_batches;
+
 	/*
 	 * PER-MOTION-NODE STATISTICS
 	 */
@@ -528,6 +575,12 @@ typedef struct ChunkTransportState
 	void (*doSendStopMessage)(struct ChunkTransportState *transportStates, int16 motNodeID);
 	void (*SendEos)(struct ChunkTransportState *transportStates, int motNodeID, TupleChunkListItem tcItem);
 
+	/*
+	 * Optional: called by putTransportDirectBuffer() after data was placed
+	 * directly into a connection's buffer, and conn->msgSize advanced.
+	 */
+	void (*PutDirectBuffer)(struct ChunkTransportState *transportStates, MotionConn *conn);
+
 	/* ic_proxy backend context */
 	struct ICProxyBackendContext *proxyContext;
 } ChunkTransportState;
@@ -95,6 +95,19 @@ extern SendReturnCode SendTuple(MotionLayerState *mlStates,
 		  						TupleTableSlot *slot,
 								int16 targetRoute);
 
+/* Serialize a tuple for a later SendSerializedTuple(), see cdbmotion.c. */
+extern int SerializeTupleToBuffer(MotionLayerState *mlStates,
+								  int16 motNodeID,
+								  TupleTableSlot *slot,
+								  char *buf,
+								  int buflen);
+extern SendReturnCode SendSerializedTuple(MotionLayerState *mlStates,
+										  ChunkTransportState *transportStates,
+										  int16 motNodeID,
+										  const char *chunk,
+										  int len,
+										  int16 targetRoute);
+
 
 /* Send or broadcast an END_OF_STREAM token to the corresponding motion-node
  * on other segments.
@@ -134,4 +147,12 @@ extern void UpdateMotionExpectedReceivers(MotionLayerState *mlStates,
  */
 extern TupleChunkListItem get_eos_tuplechunklist(void);
 
+/*
+ * Append a summary of gp_motion_compression on the receiving side of a motion
+ * node to an EXPLAIN ANALYZE buffer.
+ */
+extern void ExplainMotionCompression(MotionLayerState *mlStates,
+									 int16 motNodeID,
+									 struct StringInfoData *buf);
+
 #endif   /* CDBMOTION_H */
@@ -467,6 +467,30 @@ extern bool gp_interconnect_log_stats;
 
 extern bool gp_interconnect_cache_future_packets;
 
+/*
+ * Parameters for batched UDP-IC transmit/receive
+ *
+ * gp_interconnect_udp_batch_size is the max number of packets moved by one
+ * sendmmsg()/recvmmsg() call, 1 (the default) disables batching.
+ * gp_interconnect_udp_gso and gp_interconnect_udp_gro additionally let the
+ * kernel segment outgoing and coalesce incoming packets (UDP_SEGMENT/UDP_GRO),
+ * where supported.
+ */
+#define GP_INTERCONNECT_UDP_MAX_BATCH_SIZE 64
+extern int	gp_interconnect_udp_batch_size;
+extern bool gp_interconnect_udp_gso;
+extern bool gp_interconnect_udp_gro;
+
+/*
+ * Parameter gp_interconnect_shm_transport
+ *
+ * With the TCP interconnect, move the data of connections between backends
+ * on the same host through a shared memory ring instead of the socket, when
+ * the peer turns out to be local. Off by default until the rings have a
+ * track record.
+ */
+extern bool gp_interconnect_shm_transport;
+
 #define UNDEF_SEGMENT -2
 
 /*
@@ -584,6 +608,27 @@ extern double   gp_motion_cost_per_row;
  */
 extern int      gp_segments_for_planner;
 
+/*
+ * "gp_motion_skew_threshold"
+ *
+ * If >0, a join that redistributes both inputs spreads the join key values
+ * that make up at least this fraction of one input across all segments, and
+ * broadcasts the matching rows of the other input.  0 disables this.
+ * Postgres planner only: GPORCA's hash redistribution
+ * (CPhysicalMotionHashDistribute) knows nothing about hot keys.
+ */
+extern double   gp_motion_skew_threshold;
+
+/*
+ * "gp_motion_skew_sample_rows"
+ *
+ * The hot keys come from the planner's statistics.  Each sender of the
+ * spreading Motion counts them in the first this many rows it sends, and
+ * then keeps spreading only the keys that are hot in its own rows too.
+ * 0 trusts the statistics throughout.
+ */
+extern int      gp_motion_skew_sample_rows;
+
 /*
  * Enable/disable the special optimization of MIN/MAX aggregates as
  * Index Scan with limit.
@@ -826,6 +871,23 @@ extern bool		gp_statistics_use_fkeys;
 /* Analyze tools */
 extern int gp_motion_slice_noop;
 
+/*
+ * Number of tuples a redistribute motion hashes and sends as one batch. 1,
+ * the default, sends every tuple as soon as it is produced.
+ */
+extern int gp_motion_send_batch_size;
+
+/*
+ * Compress tuple chunks sent by motions, the zstd level to use, and how long
+ * (in ms) a chunk may wait to be compressed
+ */
+extern bool gp_motion_compression;
+extern int gp_motion_compression_level;
+extern int gp_motion_compression_max_delay;
+
+/* Send tuples of fixed-width columns in batches, column by column */
+extern bool gp_motion_columnar;
+
 /* Disable setting of hint-bits while reading db pages */
 extern bool gp_disable_tuple_hints;
 
@@ -44,6 +44,8 @@ typedef struct RegisterMessage
 	int32       srcPid;
 	int32       srcSessionId;
 	int32       srcCommandCount;
+	int32       shmRoute;		/* sender's route, if it created a shared
+								 * memory ring for the connection; or -1 */
 } RegisterMessage;
 
 /* 2 bytes to store the size of the entire packet.	a packet is composed of
@@ -214,6 +216,33 @@ extern void DeregisterReadInterest(ChunkTransportState *transportStates,
 
 extern void readPacket(MotionConn *conn, ChunkTransportState *transportStates);
 
+/*
+ * Turn read interest in a TCP (or proxy) receiving connection on or off:
+ * maintains the readSet and, where available, the epoll instance used by
+ * RecvTupleChunkFromAny().
+ */
+extern void addReadInterestTCP(ChunkTransportStateEntry *pEntry, MotionConn *conn);
+extern void removeReadInterestTCP(ChunkTransportStateEntry *pEntry, MotionConn *conn);
+
+/*
+ * Shared memory rings for same-host TCP interconnect connections
+ * (gp_interconnect_shm_transport), see ic_shm.c.
+ */
+#if defined(__linux__) && defined(HAVE_SHM_OPEN) && defined(HAVE_POSIX_FALLOCATE)
+#define IC_HAVE_SHM_RING
+#endif
+
+extern bool isLocalPeer(int sockfd, struct sockaddr_storage *localAddr);
+extern bool createShmRing(MotionConn *conn, int icId, int sendSliceIndex, int route);
+extern void attachShmRing(MotionConn *conn, int srcPid, int icId, int sendSliceIndex,
+						  int route);
+extern void detachShmRing(MotionConn *conn);
+extern void stopShmRing(MotionConn *conn);
+extern bool shmRingSend(ChunkTransportState *transportStates, MotionConn *conn,
+						const char *buf, int len);
+extern ssize_t shmRingRecv(MotionConn *conn, char *buf, int len);
+extern void RemoveStaleShmRings(void);
+
 /* 
  * Return a UDP receive buffer to our freelist.
  *
@@ -26,6 +26,8 @@ typedef enum TupleChunkType
 	TC_PARTIAL_END,				/* Contains the final portion of a tuple. */
 	TC_END_OF_STREAM,			/* Indicates "end of tuples" from this source. */
 	TC_EMPTY,					/* Empty tuple */
+	TC_COMPRESSED,				/* A compressed block of other chunks. */
+	TC_COLUMNAR,				/* A batch of whole tuples, column by column. */
 	TC_MAXVAL					/* For range checks on type values. */
 } TupleChunkType;
 
@@ -60,8 +60,27 @@ typedef struct SerTupInfo
 
 	/* true if tupdesc contains record types */
 	bool		has_record_types;
+
+	/*
+	 * Rows that fit into one TC_COLUMNAR chunk, or 0 if the tuples can't be
+	 * sent in the columnar format.
+	 */
+	int			columnar_maxrows;
 }	SerTupInfo;
 
+/*
+ * A batch of rows waiting to be sent as one TC_COLUMNAR chunk. The values
+ * of each attribute are kept together, attlen bytes per row, with a null
+ * bitmap laid out like the one in a heap tuple.
+ */
+typedef struct ColumnarBatch
+{
+	int			nrows;
+	char	  **values;			/* per attribute */
+	bits8	  **nullbits;		/* per attribute */
+	uint32		nullatts;		/* attributes with NULLs in this batch */
+} ColumnarBatch;
+
 /*
  * forward declaration to avoid #including cdbmotion.h here, which would create a circular
  * dependency
@@ -84,6 +103,18 @@ extern void SerializeRecordCacheIntoChunks(SerTupInfo *pSerInfo,
 /* Convert a tuple into chunks directly in a set of transport buffers */
 extern int SerializeTuple(TupleTableSlot *tuple, SerTupInfo *pSerInfo, struct directTransportBuffer *b, TupleChunkList tcList, int16 targetRoute);
 
+/* Allocate an empty batch for the columnar format */
+extern void InitColumnarBatch(SerTupInfo *pSerInfo, ColumnarBatch *batch);
+
+/* Add a tuple to a batch.  Returns true if the batch is full. */
+extern bool AddTupleToColumnarBatch(TupleTableSlot *slot, SerTupInfo *pSerInfo, ColumnarBatch *batch);
+
+/* Convert a batch into a TC_COLUMNAR chunk, and empty the batch */
+extern void SerializeColumnarBatch(SerTupInfo *pSerInfo, ColumnarBatch *batch, TupleChunkListItem tcItem);
+
+/* Convert a TC_COLUMNAR chunk back into HeapTuples */
+extern int	CvtColumnarChunkToTups(TupleChunkListItem tcItem, SerTupInfo *pSerInfo, GenericTuple **tups);
+
 /* Convert a sequence of chunks containing serialized tuple data into a
  * HeapTuple or MemTuple.
  */
@@ -674,6 +674,10 @@ Expr *TransformArrayConstToArrayExpr(Const *constant);
 // transform array Const to an ArrayExpr
 Node *EvalConstExpressions(Node *node);
 
+// build a one-dimensional array Const from the given element values
+Const *MakeArrayConst(Oid array_type, Oid elem_type, Oid array_collid,
+					  Datum *values, bool *nulls, int num_values);
+
 // static partition selection given a PartitionSelector node
 SelectedParts *RunStaticPartitionSelection(PartitionSelector *ps);
 
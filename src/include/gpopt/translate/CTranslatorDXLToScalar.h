@@ -312,6 +312,9 @@ public:
 	// check if the operator is a NULL constant
 	static BOOL HasConstNull(CDXLNode *dxlnode);
 
+	// check if the operator is a non-empty array of constants only
+	static BOOL IsConstArray(const CDXLNode *scalar_array_node);
+
 	// are there subqueries in the tree
 	BOOL
 	HasSubqueries() const
@@ -139,6 +139,12 @@ private:
 	// load search strategy from given path
 	static CSearchStageArray *LoadSearchStrategy(CMemoryPool *mp, char *path);
 
+	// is query a plain single-table select eligible for the reduced search
+	static BOOL IsSimpleQuery(const Query *query);
+
+	// search strategy that skips all exploration not needed by simple queries
+	static CSearchStageArray *CreateSimpleQuerySearchStrategy(CMemoryPool *mp);
+
 	// helper for converting wide character string to regular string
 	static CHAR *CreateMultiByteCharStringFromWCString(const WCHAR *wcstr);
 
@@ -1931,11 +1931,13 @@ typedef struct BitmapHeapScanState
 	int			prefetch_pages;
 	int			prefetch_target;
 
-	/* These are used by AO/AOCS scans, to work with lossy bitmap pages */
+	/*
+	 * These are used by AO/AOCS scans, which fetch the tuples of each bitmap
+	 * page as one sorted batch of AO TIDs (all 2^15 of them on a lossy page).
+	 */
 	bool		baos_gotpage;
-	int			baos_cindex;
 	bool		baos_lossy;
-	int			baos_ntuples;
+	struct AOTupleId *baos_tids;
 
 } BitmapHeapScanState;
 
@@ -2903,6 +2905,31 @@ typedef struct MotionState
 	List	   *hashExprs;		/* state struct used for evaluating the hash expressions */
 	struct CdbHash *cdbhash;	/* hash api object */
 
+	/* For batched hash motion send, see doSendTupleBatch() */
+	int			sendBatchSize;	/* max tuples per batch, 0 if not batching */
+	int			sendBatchCount;	/* tuples currently in the batch */
+	char	   *sendBatchBuf;	/* the batched tuples, serialized */
+	int			sendBatchBufSize;
+	int			sendBatchBufUsed;
+	int		   *sendBatchChunkStart;	/* offset of each tuple in sendBatchBuf */
+	int		   *sendBatchChunkLen;	/* its length, 0 if it is not in there */
+	Datum	   *sendBatchValues;	/* hash key values, one array per key */
+	bool	   *sendBatchIsnull;
+	int16	   *sendBatchKeyLen;	/* typlen of each hash key */
+	bool	   *sendBatchKeyByVal;	/* typbyval of each hash key */
+	unsigned int *sendBatchTargets; /* target segment of each tuple */
+	int		   *sendBatchOrder;	/* tuple numbers grouped by target */
+	int		   *sendBatchOffsets;	/* start of each target in sendBatchOrder */
+
+	/* For hot join keys, see Motion.skewMode */
+	uint32	   *skewHashes;		/* raw hash values of the hot keys */
+	int			numSkewHashes;
+	int			skewNextTarget;	/* next round-robin target for spread rows */
+	bool	   *skewHot;		/* is each hot key, and NULL last, handled */
+	int		   *skewSampleCounts;	/* their rows in the sample */
+	int			skewSampleRows;	/* size of the sample */
+	int			skewSampleLeft;	/* rows still to sample */
+
 	/* For Motion recv */
 	int			routeIdNext;	/* for a sorted motion node, the routeId to get next (same as
 								 * the routeId last returned ) */
@@ -2912,8 +2939,7 @@ typedef struct MotionState
 	/* For sorted Motion recv */
 	struct MotionMKHeapContext *tupleheap_mk;		/* data structure for match merge in sorted motion node */
 
-	struct binaryheap *tupleheap;
-	struct CdbTupleHeapInfo *tupleheap_entries;
+	struct CdbTupleHeapInfo *tupleheap_entries;	/* leaves of the merge tree */
 	struct CdbMergeComparatorContext *tupleheap_cxt;
 
 	/* The following can be used for debugging, usage stats, etc.  */
@@ -1279,6 +1279,20 @@ typedef enum MotionType
 	MOTIONTYPE_EXPLICIT		/* Send tuples to the segment explicitly specified in their segid column */
 } MotionType;
 
+/*
+ * How a hash Motion treats the skewed ("hot") key values listed in
+ * Motion.skewValues.  The two inputs of a join that are redistributed on
+ * the join key get complementary modes: the skewed input spreads its hot
+ * rows round-robin over all segments, and the other input broadcasts its
+ * rows with the same keys, so every hot row still meets its partners.
+ */
+typedef enum MotionSkewMode
+{
+	MOTIONSKEW_NONE,		/* no special handling */
+	MOTIONSKEW_SPREAD,		/* send hot rows round-robin */
+	MOTIONSKEW_BROADCAST	/* send hot rows to all segments */
+} MotionSkewMode;
+
 /*
  * Motion Node
  *
@@ -1295,6 +1309,12 @@ typedef struct Motion
 	List		*hashExprs;			/* list of hash expressions */
 	Oid			*hashFuncs;			/* corresponding hash functions */
 
+	/* For Hash with a single hash expression: skewed key handling */
+	MotionSkewMode skewMode;
+	List	   *skewValues;			/* hot key values, as Consts */
+	List	   *skewHashes;			/* their raw cdbhash values (int list) */
+	bool		skewNulls;			/* spread NULL keys too (SPREAD only) */
+
 	/*
 	 * The isBroadcast field is only used for motionType=MOTIONTYPE_FIXED,
 	 * if it is other kind of motion, please do not access this field.
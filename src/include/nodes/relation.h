@@ -1155,6 +1155,12 @@ typedef struct CdbMotionPath
 {
 	Path		path;
     Path	   *subpath;
+
+	/* skewed join key handling for hashed motions, see Motion */
+	MotionSkewMode skewMode;
+	List	   *skewValues;		/* hot key values, as Consts */
+	List	   *skewHashes;		/* their raw cdbhash values (int list) */
+	bool		skewNulls;		/* spread NULL keys too */
 } CdbMotionPath;
 
 /*
@@ -6,8 +6,8 @@
  * The speed of CRC-32C calculation has a big impact on performance, so we
  * jump through some hoops to get the best implementation for each
  * platform. Some CPU architectures have special instructions for speeding
- * up CRC calculations (e.g. Intel SSE 4.2), on other platforms we use the
- * Slicing-by-8 algorithm which uses lookup tables.
+ * up CRC calculations (e.g. Intel SSE 4.2, ARMv8 CRC extension), on other
+ * platforms we use the Slicing-by-8 algorithm which uses lookup tables.
  *
  * The public interface consists of four macros:
  *
@@ -40,12 +40,26 @@ typedef uint32 pg_crc32c;
 #define EQ_CRC32C(c1, c2) ((c1) == (c2))
 
 #if defined(USE_SSE42_CRC32C)
-/* Use SSE4.2 instructions. */
+/*
+ * Use SSE4.2 instructions, and the variant that combines interleaved streams
+ * with the carry-less multiply instruction if the target CPU has that too.
+ * This is the compile-time counterpart of the choice made in
+ * pg_crc32c_choose.c.
+ */
+#if defined(__x86_64__) && defined(__GNUC__) && defined(__PCLMUL__)
+#define USE_SSE42_CRC32C_PCLMUL
+#define COMP_CRC32C(crc, data, len) \
+	((crc) = pg_comp_crc32c_sse42_pclmul((crc), (data), (len)))
+#else
 #define COMP_CRC32C(crc, data, len) \
 	((crc) = pg_comp_crc32c_sse42((crc), (data), (len)))
+#endif
 #define FIN_CRC32C(crc) ((crc) ^= 0xFFFFFFFF)
 
 extern pg_crc32c pg_comp_crc32c_sse42(pg_crc32c crc, const void *data, size_t len);
+#ifdef USE_SSE42_CRC32C_PCLMUL
+extern pg_crc32c pg_comp_crc32c_sse42_pclmul(pg_crc32c crc, const void *data, size_t len);
+#endif
 
 #elif defined(USE_SSE42_CRC32C_WITH_RUNTIME_CHECK)
 /*
@@ -60,6 +74,36 @@ extern pg_crc32c pg_comp_crc32c_sse42(pg_crc32c crc, const void *data, size_t le
 extern pg_crc32c pg_comp_crc32c_sb8(pg_crc32c crc, const void *data, size_t len);
 extern pg_crc32c (*pg_comp_crc32c) (pg_crc32c crc, const void *data, size_t len);
 
+/*
+ * On x86-64, large inputs are also split into interleaved streams whose CRCs
+ * are combined using the carry-less multiply instruction, if the CPU has it.
+ */
+#if defined(__x86_64__) && defined(__GNUC__)
+#define USE_SSE42_CRC32C_PCLMUL
+extern pg_crc32c pg_comp_crc32c_sse42_pclmul(pg_crc32c crc, const void *data, size_t len);
+#endif
+
+#elif defined(USE_ARMV8_CRC32C)
+/* Use ARMv8 CRC Extension instructions. */
+#define COMP_CRC32C(crc, data, len) \
+	((crc) = pg_comp_crc32c_armv8((crc), (data), (len)))
+#define FIN_CRC32C(crc) ((crc) ^= 0xFFFFFFFF)
+
+extern pg_crc32c pg_comp_crc32c_armv8(pg_crc32c crc, const void *data, size_t len);
+
+#elif defined(USE_ARMV8_CRC32C_WITH_RUNTIME_CHECK)
+/*
+ * Use ARMv8 instructions, but perform a runtime check first to check that
+ * they are available.
+ */
+#define COMP_CRC32C(crc, data, len) \
+	((crc) = pg_comp_crc32c((crc), (data), (len)))
+#define FIN_CRC32C(crc) ((crc) ^= 0xFFFFFFFF)
+
+extern pg_crc32c pg_comp_crc32c_armv8(pg_crc32c crc, const void *data, size_t len);
+extern pg_crc32c pg_comp_crc32c_sb8(pg_crc32c crc, const void *data, size_t len);
+extern pg_crc32c (*pg_comp_crc32c) (pg_crc32c crc, const void *data, size_t len);
+
 #else
 /*
  * Use slicing-by-8 algorithm.
@@ -0,0 +1,25 @@
+/*-------------------------------------------------------------------------
+ *
+ * aocompaction.h
+ *	  Background compaction of append-only tables.
+ *
+ *
+ * IDENTIFICATION
+ *	    src/include/postmaster/aocompaction.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef AOCOMPACTION_H
+#define AOCOMPACTION_H
+
+extern bool gp_appendonly_compaction_worker;
+extern int	gp_appendonly_compaction_worker_naptime;
+extern int	gp_appendonly_compaction_worker_cost_delay;
+
+extern bool AppendOnlyCompactionWorkerStartRule(Datum main_arg);
+extern void AppendOnlyCompactionWorkerMain(Datum main_arg);
+
+extern Size AppendOnlyCompactionWorkerShmemSize(void);
+extern void AppendOnlyCompactionWorkerShmemInit(void);
+
+#endif   /* AOCOMPACTION_H */
@@ -65,6 +65,14 @@ typedef struct DatumStreamWrite
 
 	DatumStreamBlockWrite blockWrite;
 
+	/*
+	 * Zone (min/max/null count) of the block being filled, recorded in the
+	 * block directory along with the block. zoneSortSupport is NULL when the
+	 * column type does not support zones.
+	 */
+	SortSupport zoneSortSupport;
+	MinipageZone zone;
+
 	/*
 	 * EOFs of current segment file.
 	 */
@@ -166,6 +174,13 @@ typedef struct DatumStreamRead
 	/* AO Storage */
 	bool		need_close_file;
 
+	/*
+	 * Ordering used to compute block zones when (re)building the block
+	 * directory. Set up on first use.
+	 */
+	SortSupport zoneSortSupport;
+	bool		zoneSortSupportChecked;
+
 }	DatumStreamRead;
 
 /*
@@ -186,6 +201,10 @@ typedef struct DatumStreamFetchDescData
 
 	CurrentBlock currentBlock;
 
+	/* Last block directory range prefetched by a batch fetch. */
+	AppendOnlyBlockDirectoryEntry prefetchEntry;
+	bool		prefetchEntryValid;
+
 }	DatumStreamFetchDescData;
 
 typedef DatumStreamFetchDescData *DatumStreamFetchDesc;
@@ -242,6 +261,16 @@ datumstreamread_nth(DatumStreamRead * acc)
 	}
 }
 
+extern int	datumstreamread_get_batch(DatumStreamRead * ds,
+									  Datum *values,
+									  bool *nulls,
+									  int32 *codes,
+									  int maxRows);
+extern int	datumstreamread_remaining(DatumStreamRead * ds);
+extern int	datumstreamread_dictionary(DatumStreamRead * ds,
+									   Datum **values,
+									   int64 *dictionaryId);
+
 /* ------------------------------------------------------------------------------ */
 
 extern int datumstreamwrite_put(
@@ -312,6 +341,9 @@ extern int	datumstreamread_block(DatumStreamRead * ds,
 extern void datumstreamread_find(DatumStreamRead * datumStream,
 					 int32 rowNumInBlock);
 extern void datumstreamread_rewind_block(DatumStreamRead * datumStream);
+extern bool datumstreamread_skip_to_row(DatumStreamRead * datumStream,
+							int64 rowNum,
+							int64 *blocksSkipped);
 extern bool datumstreamread_find_block(DatumStreamRead * datumStream,
 						   DatumStreamFetchDesc datumStreamFetchDesc,
 						   int64 rowNum);
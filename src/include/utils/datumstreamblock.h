@@ -197,12 +197,61 @@ typedef struct DatumStreamBlock_Delta_Extension
 }	DatumStreamBlock_Delta_Extension;
 
 
+/*
+ * Datum Stream Block extension for Original blocks whose datum data is
+ * dictionary or frame-of-reference encoded. It takes the place of the
+ * datum data, and is followed by the encoded data.
+ *
+ * Dictionary: the distinct items, laid out as in plain datum data, then a
+ * code per item, bit_width bits each, numbering the distinct items.
+ *
+ * Frame-of-reference: per item, the difference of the (signed) integer
+ * value from reference, bit_width bits each.
+ *
+ * Bit-packed values are stored least significant bit first.
+ * 32 bytes.
+ */
+typedef struct DatumStreamBlock_Encoding_Extension
+{
+	int32		item_count;
+	/*
+	 * Number of items, i.e. the non-NULL rows.
+	 */
+
+	int32		decoded_size;
+	/*
+	 * Size of the plain datum data the items decode to.
+	 */
+
+	int32		dictionary_count;
+	int32		dictionary_size;
+	/*
+	 * Number and total size of the distinct items. 0 for frame-of-reference.
+	 */
+
+	int64		reference;
+	/*
+	 * Smallest value of the items, for frame-of-reference.
+	 */
+
+	int16		bit_width;
+	int16		unused1;
+	int32		unused2;
+}	DatumStreamBlock_Encoding_Extension;
+
+/*
+ * Most distinct items a dictionary encoded block can have.
+ */
+#define DATUMSTREAM_MAX_DICTIONARY_COUNT 4096
+
 /* Flags */
 enum
 {
 	DSB_HAS_NULLBITMAP = 0x1,
 	DSB_HAS_RLE_COMPRESSION = 0x2,
 	DSB_HAS_DELTA_COMPRESSION = 0x4,
+	DSB_HAS_DICTIONARY_ENCODING = 0x8,
+	DSB_HAS_FOR_ENCODING = 0x10,
 };
 
 typedef struct DatumStreamBitMapWrite
@@ -1082,6 +1131,12 @@ typedef struct DatumStreamBlockWrite
 	bool	   *delta_sign;
 	int32		deltas_maxcount;
 
+	/* Dictionary and frame-of-reference encoding buffers, made on first use */
+	uint8	   *encoding_buffer;
+	int32	   *encoding_codes;
+	int32	   *encoding_hash;
+	int32	   *encoding_entry_offsets;
+
 	/* EOF of current file */
 	int64		savings;
 	int64		remember_savings;
@@ -1164,6 +1219,25 @@ typedef struct DatumStreamBlockRead
 	bool		delta_block_was_compressed;
 	DatumStreamBitMapRead delta_bitmap;
 
+	/*
+	 * Dictionary and frame-of-reference encoded blocks are decoded into
+	 * decode_buffer, and datum_beginp points there instead.
+	 *
+	 * For dictionary encoded blocks, dictionary_count is the number of
+	 * distinct items, which are in dictionary_values, and dictionary_codes
+	 * has the number of the distinct item of each physical item.
+	 * dictionary_id is unique to each dictionary block read in the backend,
+	 * so callers can tell whether work done on the dictionary still applies.
+	 */
+	uint8	   *decode_buffer;
+	int32		decode_buffer_size;
+
+	int32		dictionary_count;
+	Datum	   *dictionary_values;
+	uint16	   *dictionary_codes;
+	int32		dictionary_codes_size;
+	int64		dictionary_id;
+
 	/*
 	 * Keep less frequently accessed fields down here for possible better CPU data cache
 	 * performance.
@@ -2062,6 +2136,109 @@ DatumStreamBlockRead_Nth(DatumStreamBlockRead * dsr)
 	return dsr->nth;
 }
 
+/*
+ * Number of datums in the block after the current position.
+ */
+inline static int
+DatumStreamBlockRead_Remaining(DatumStreamBlockRead * dsr)
+{
+	return dsr->logical_row_count - (dsr->nth + 1);
+}
+
+/*
+ * Get up to maxRows datums following the current position into values and
+ * nulls, and advance past them. Returns the number of datums returned, 0 at
+ * the end of the block.
+ *
+ * Blocks of fixed-length pass-by-value items without NULLs, RLE_TYPE or
+ * delta compression store the items back to back, so they are copied out
+ * directly. Anything else is read datum by datum.
+ *
+ * For dictionary encoded blocks, codes, if not NULL, gets the number of
+ * the distinct item of each datum, or -1 for NULL.
+ */
+inline static int
+DatumStreamBlockRead_GetBatch(DatumStreamBlockRead * dsr,
+							  Datum *values,
+							  bool *nulls,
+							  int32 *codes,
+							  int maxRows)
+{
+	int			n = Min(maxRows, DatumStreamBlockRead_Remaining(dsr));
+	int			i;
+
+	if (n <= 0)
+		return 0;
+
+	if (!dsr->has_null &&
+		dsr->typeInfo.byval &&
+		dsr->typeInfo.datumlen > 0 &&
+		(dsr->datumStreamVersion == DatumStreamVersion_Original ||
+		 (!dsr->rle_block_was_compressed && !dsr->delta_block_was_compressed)))
+	{
+		uint8	   *p = dsr->datump;
+
+		/* The block read pre-positions datump to the first item. */
+		if (dsr->physical_datum_index >= 0)
+			p += dsr->typeInfo.datumlen;
+
+		Assert(p + n * dsr->typeInfo.datumlen <= dsr->datum_afterp);
+
+		if (dsr->typeInfo.datumlen == 4)
+		{
+			for (i = 0; i < n; i++)
+				values[i] = ((uint32 *) p)[i];
+		}
+		else if (dsr->typeInfo.datumlen == 8)
+		{
+			for (i = 0; i < n; i++)
+				values[i] = ((Datum *) p)[i];
+		}
+		else if (dsr->typeInfo.datumlen == 2)
+		{
+			for (i = 0; i < n; i++)
+				values[i] = ((uint16 *) p)[i];
+		}
+		else
+		{
+			Assert(dsr->typeInfo.datumlen == 1);
+			for (i = 0; i < n; i++)
+				values[i] = p[i];
+		}
+		memset(nulls, 0, n * sizeof(bool));
+
+		/* Leave the block positioned on the last item returned. */
+		dsr->nth += n;
+		dsr->physical_datum_index += n;
+		dsr->datump = p + (n - 1) * dsr->typeInfo.datumlen;
+
+		return n;
+	}
+
+	if (codes != NULL && dsr->dictionary_count > 0)
+	{
+		for (i = 0; i < n; i++)
+		{
+			if (DatumStreamBlockRead_Advance(dsr) == 0)
+				break;
+			DatumStreamBlockRead_Get(dsr, &values[i], &nulls[i]);
+			codes[i] = nulls[i] ? -1 :
+				dsr->dictionary_codes[dsr->physical_datum_index];
+		}
+
+		return i;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		if (DatumStreamBlockRead_Advance(dsr) == 0)
+			break;
+		DatumStreamBlockRead_Get(dsr, &values[i], &nulls[i]);
+	}
+
+	return i;
+}
+
 extern void DatumStreamBlockRead_GetReadyOrig(
 								  DatumStreamBlockRead * dsr,
 								  uint8 * buffer,
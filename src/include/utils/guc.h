@@ -282,6 +282,75 @@ extern bool enable_implicit_timeformat_YYYYMMDDHH24MISS;
  * 10% of the tuples are hidden.
  */
 extern int  gp_appendonly_compaction_threshold;
+
+/*
+ * Maximum number of live tuples that a lazy vacuum moves out of a segment
+ * file at a time. 0 compacts whole segment files. A chunk skips the rows
+ * moved before without decompressing them, but still reads their block
+ * headers, see AppendOnlyCompaction_ChunkRows().
+ */
+extern int	gp_appendonly_compaction_chunk_rows;
+
+/*
+ * Cost delay of append-only compaction, in milliseconds. -1 uses
+ * vacuum_cost_delay.
+ */
+extern int	gp_appendonly_compaction_cost_delay;
+
+/*
+ * Number of large reads of an append-only segment file that are
+ * prefetched ahead of the one being read. 0 disables prefetching.
+ */
+extern int	gp_appendonly_prefetch_depth;
+
+/*
+ * Number of helper threads that compress the blocks of append-only inserts.
+ * 0 compresses in the backend only.
+ */
+extern int	gp_appendonly_compress_workers;
+
+/*
+ * Number of helper threads that decompress append-only blocks ahead of the
+ * scan. 0 decompresses in the backend only.
+ */
+extern int	gp_appendonly_decompress_workers;
+
+/*
+ * Number of rows that column-oriented table scans decode per column at a
+ * time. 0 decodes row by row, which stays the default until the batch
+ * path has seen more use.
+ */
+extern int	gp_appendonly_scan_batch_size;
+
+/*
+ * Number of decompressed visibility map entries of append-only tables that
+ * a scan keeps in memory. 0 disables the cache.
+ */
+extern int	gp_appendonly_visimap_cache_entries;
+
+/*
+ * Use the block zones recorded in the block directory to skip blocks of
+ * column-oriented tables during sequential scans.
+ */
+extern bool gp_appendonly_zone_maps;
+
+/*
+ * Record block zones in the block directory of column-oriented tables.
+ */
+extern bool gp_appendonly_record_zone_maps;
+
+/*
+ * Decode the columns of column-oriented tables that are not used by the
+ * scan quals only for the rows that pass the quals. Needs a batch scan, and
+ * is off by default along with it.
+ */
+extern bool gp_appendonly_late_materialization;
+
+/*
+ * Dictionary or frame-of-reference encode the blocks of column-oriented
+ * tables written, where it saves space.
+ */
+extern bool gp_appendonly_block_encodings;
 extern bool gp_heap_require_relhasoids_match;
 extern bool	debug_xlog_record_read;
 extern bool Debug_cancel_print;
@@ -492,6 +561,7 @@ extern bool optimizer_enable_dynamicbitmapscan;
 extern bool optimizer_enable_indexscan;
 extern bool optimizer_enable_indexonlyscan;
 extern bool optimizer_enable_tablescan;
+extern bool optimizer_enable_simple_query_fast_path;
 extern bool optimizer_enable_eageragg;
 extern bool optimizer_enable_orderedagg;
 extern bool optimizer_expand_fulljoin;
@@ -526,6 +596,7 @@ extern int optimizer_penalize_broadcast_threshold;
 extern double optimizer_cost_threshold;
 extern double optimizer_nestloop_factor;
 extern double optimizer_sort_factor;
+extern double optimizer_motion_compression_factor;
 
 /* Optimizer hints */
 extern int optimizer_array_expansion_threshold;
@@ -14,6 +14,17 @@
 		"explain_memory_verbosity",
 		"gin_fuzzy_search_limit",
 		"gp_allow_date_field_width_5digits",
+		"gp_appendonly_block_encodings",
+		"gp_appendonly_compaction_chunk_rows",
+		"gp_appendonly_compaction_cost_delay",
+		"gp_appendonly_compress_workers",
+		"gp_appendonly_decompress_workers",
+		"gp_appendonly_late_materialization",
+		"gp_appendonly_prefetch_depth",
+		"gp_appendonly_record_zone_maps",
+		"gp_appendonly_scan_batch_size",
+		"gp_appendonly_visimap_cache_entries",
+		"gp_appendonly_zone_maps",
 		"gp_blockdirectory_entry_min_range",
 		"gp_blockdirectory_minipage_size",
 		"gp_debug_linger",
@@ -43,12 +54,15 @@
 		"gp_interconnect_proxy_addresses",
 		"gp_interconnect_queue_depth",
 		"gp_interconnect_setup_timeout",
+		"gp_interconnect_shm_transport",
 		"gp_interconnect_snd_queue_depth",
 		"gp_interconnect_tcp_listener_backlog",
 		"gp_interconnect_timer_checking_period",
 		"gp_interconnect_timer_period",
 		"gp_interconnect_transmit_timeout",
 		"gp_interconnect_type",
+		"gp_interconnect_udp_batch_size",
+		"gp_interconnect_udp_gso",
 		"gp_interconnect_address_type",
 		"gp_log_endpoints",
 		"gp_log_interconnect",
@@ -59,6 +73,13 @@
 		"gp_max_packet_size",
 		"gp_max_partition_level",
 		"gp_mk_sort_check",
+		"gp_motion_columnar",
+		"gp_motion_compression",
+		"gp_motion_compression_level",
+		"gp_motion_compression_max_delay",
+		"gp_motion_send_batch_size",
+		"gp_motion_skew_sample_rows",
+		"gp_motion_skew_threshold",
 		"gp_motion_slice_noop",
 		"gp_partitioning_dynamic_selection_log",
 		"gp_perfmon_print_packet_info",
@@ -141,6 +141,9 @@
 		"gp_allow_rename_relation_without_lock",
 		"gp_appendonly_compaction",
 		"gp_appendonly_compaction_threshold",
+		"gp_appendonly_compaction_worker",
+		"gp_appendonly_compaction_worker_cost_delay",
+		"gp_appendonly_compaction_worker_naptime",
 		"gp_appendonly_verify_block_checksums",
 		"gp_appendonly_verify_write_block",
 		"gp_auth_time_override",
@@ -211,6 +214,7 @@
 		"gp_ignore_window_exclude",
 		"gp_instrument_shmem_size",
 		"gp_interconnect_cache_future_packets",
+		"gp_interconnect_udp_gro",
 		"gp_is_writer",
 		"gp_keep_all_xlog",
 		"gp_keep_partition_children_locks",
@@ -401,6 +405,7 @@
 		"optimizer_enable_partition_propagation",
 		"optimizer_enable_partition_selection",
 		"optimizer_enable_range_predicate_dpe",
+		"optimizer_enable_simple_query_fast_path",
 		"optimizer_enable_sort",
 		"optimizer_enable_space_pruning",
 		"optimizer_enable_streaming_material",
@@ -453,6 +458,7 @@
 		"optimizer_search_strategy_path",
 		"optimizer_segments",
 		"optimizer_sort_factor",
+		"optimizer_motion_compression_factor",
 		"optimizer_trace_fallback",
 		"optimizer_skew_factor",
 		"optimizer_use_external_constant_expression_evaluation_for_ints",
@@ -3,6 +3,9 @@
  * pg_crc32c_sse42.c
  *	  Compute CRC-32C checksum using Intel SSE 4.2 instructions.
  *
+ * pg_comp_crc32c_sse42_pclmul() is a variant for large inputs on CPUs that
+ * also have the carry-less multiply instruction (PCLMULQDQ).
+ *
  * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
  *
@@ -66,3 +69,92 @@ pg_comp_crc32c_sse42(pg_crc32c crc, const void *data, size_t len)
 
 	return crc;
 }
+
+#ifdef USE_SSE42_CRC32C_PCLMUL
+
+#include <wmmintrin.h>
+
+/*
+ * Lengths of the three interleaved streams used by
+ * pg_comp_crc32c_sse42_pclmul(), and the constants that shift a CRC forward
+ * over one or two streams' worth of zero bytes. Each constant is
+ * x^(8 * len - 33) mod P, bit-reflected: the carry-less product contributes
+ * one extra power of x, and the final crc32 instruction another 32.
+ */
+#define CRC32C_LONG_STREAM		2048
+#define CRC32C_LONG_SHIFT1		0xa51b6135	/* 2048 bytes */
+#define CRC32C_LONG_SHIFT2		0x82f89c77	/* 4096 bytes */
+#define CRC32C_SHORT_STREAM		256
+#define CRC32C_SHORT_SHIFT1		0xb9e02b86	/* 256 bytes */
+#define CRC32C_SHORT_SHIFT2		0xdd7e3b0c	/* 512 bytes */
+
+#define CRC32C_PCLMUL_TARGET __attribute__((target("sse4.2,pclmul")))
+
+/*
+ * Shift a CRC forward over the zero bytes described by the constant k.
+ */
+static inline CRC32C_PCLMUL_TARGET uint64
+crc32c_shift(uint64 crc, uint32 k)
+{
+	__m128i		prod;
+
+	prod = _mm_clmulepi64_si128(_mm_cvtsi32_si128((int) crc),
+								_mm_cvtsi32_si128((int) k), 0);
+	return _mm_crc32_u64(0, (uint64) _mm_cvtsi128_si64(prod));
+}
+
+/*
+ * Compute CRC-32C over three adjacent streams of 'stream' bytes each, and
+ * fold the results together.
+ *
+ * A single crc32 instruction has a latency of three cycles but can start
+ * every cycle, so the serial loop in pg_comp_crc32c_sse42() leaves two thirds
+ * of the unit idle. Running three independent streams keeps it busy; the CRC
+ * of the concatenation is then shift(crc0, 2 * stream) ^ shift(crc1, stream)
+ * ^ crc2, since CRC is linear.
+ */
+static inline CRC32C_PCLMUL_TARGET pg_crc32c
+crc32c_3way(pg_crc32c crc, const unsigned char *p, size_t stream,
+			uint32 shift1, uint32 shift2)
+{
+	const unsigned char *end = p + stream;
+	uint64		crc0 = crc;
+	uint64		crc1 = 0;
+	uint64		crc2 = 0;
+
+	do
+	{
+		crc0 = _mm_crc32_u64(crc0, *((const uint64 *) p));
+		crc1 = _mm_crc32_u64(crc1, *((const uint64 *) (p + stream)));
+		crc2 = _mm_crc32_u64(crc2, *((const uint64 *) (p + 2 * stream)));
+		p += 8;
+	} while (p < end);
+
+	return (pg_crc32c) (crc32c_shift(crc0, shift2) ^
+						crc32c_shift(crc1, shift1) ^ crc2);
+}
+
+CRC32C_PCLMUL_TARGET pg_crc32c
+pg_comp_crc32c_sse42_pclmul(pg_crc32c crc, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+	const unsigned char *pend = p + len;
+
+	while (pend - p >= 3 * CRC32C_LONG_STREAM)
+	{
+		crc = crc32c_3way(crc, p, CRC32C_LONG_STREAM,
+						  CRC32C_LONG_SHIFT1, CRC32C_LONG_SHIFT2);
+		p += 3 * CRC32C_LONG_STREAM;
+	}
+
+	while (pend - p >= 3 * CRC32C_SHORT_STREAM)
+	{
+		crc = crc32c_3way(crc, p, CRC32C_SHORT_STREAM,
+						  CRC32C_SHORT_SHIFT1, CRC32C_SHORT_SHIFT2);
+		p += 3 * CRC32C_SHORT_STREAM;
+	}
+
+	return pg_comp_crc32c_sse42(crc, p, pend - p);
+}
+
+#endif   /* USE_SSE42_CRC32C_PCLMUL */
@@ -0,0 +1,40 @@
+-- Zone map skipping and late materialization of column-oriented tables
+-- across several segment files, with large rows: the block position of a
+-- column must not carry over from one segment file to the next, and a
+-- large-object block holds a single row.
+create table aocs_zone_segfiles (a int, b int, c text) with (appendonly=true, orientation=column, blocksize=8192) distributed by (a);
+create index aocs_zone_segfiles_b on aocs_zone_segfiles(b);
+
+-- Two concurrent inserts go to two segment files.
+1: set gp_appendonly_record_zone_maps = on;
+2: set gp_appendonly_record_zone_maps = on;
+1: begin;
+2: begin;
+1: insert into aocs_zone_segfiles select i, i, repeat('x', 20) from generate_series(1, 20000) i;
+2: insert into aocs_zone_segfiles select i, i, case when i % 1000 = 0 then repeat('y', 100000) else 'y' end from generate_series(20001, 40000) i;
+1: commit;
+2: commit;
+1: insert into aocs_zone_segfiles select i, i, case when i % 500 = 0 then repeat('z', 50000) else 'z' end from generate_series(40001, 60000) i;
+0U: select count(distinct segno) > 1 as several_segfiles from gp_toolkit.__gp_aocsseg('aocs_zone_segfiles') where tupcount > 0;
+
+set enable_indexscan = off;
+set enable_bitmapscan = off;
+set gp_appendonly_scan_batch_size = 1024;
+set gp_appendonly_late_materialization = on;
+select count(*), min(a), max(a), sum(length(c)) from aocs_zone_segfiles where b between 30500 and 31500;
+select count(*), min(a), max(a), sum(length(c)) from aocs_zone_segfiles where b > 59000;
+select count(*), min(a), max(a), sum(length(c)) from aocs_zone_segfiles where b >= 39000 and b <= 41000;
+select count(*), min(a), max(a), sum(length(c)) from aocs_zone_segfiles where b < 100;
+-- The same without skipping and late materialization
+set gp_appendonly_zone_maps = off;
+set gp_appendonly_late_materialization = off;
+select count(*), min(a), max(a), sum(length(c)) from aocs_zone_segfiles where b between 30500 and 31500;
+select count(*), min(a), max(a), sum(length(c)) from aocs_zone_segfiles where b > 59000;
+select count(*), min(a), max(a), sum(length(c)) from aocs_zone_segfiles where b >= 39000 and b <= 41000;
+select count(*), min(a), max(a), sum(length(c)) from aocs_zone_segfiles where b < 100;
+reset gp_appendonly_zone_maps;
+reset gp_appendonly_late_materialization;
+reset gp_appendonly_scan_batch_size;
+reset enable_indexscan;
+reset enable_bitmapscan;
+drop table aocs_zone_segfiles;
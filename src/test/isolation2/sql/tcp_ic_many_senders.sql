@@ -0,0 +1,24 @@
+-- Test that a TCP interconnect receiver keeps serving its other senders while
+-- one connection has only part of a packet, or was reported readable by a
+-- stale epoll edge. Every packet is sent in two pieces here, with a pause in
+-- between.
+
+CREATE TABLE tcp_ic_many_senders(a int, b text) DISTRIBUTED BY (a);
+INSERT INTO tcp_ic_many_senders SELECT i, repeat('x', i % 500) FROM generate_series(1, 20000) i;
+
+SELECT gp_inject_fault_infinite('interconnect_tcp_split_packet', 'skip', dbid)
+    FROM gp_segment_configuration WHERE role = 'p';
+
+SET optimizer = off;
+SET gp_enable_multiphase_agg = off;
+-- same-host connections would bypass the sockets
+SET gp_interconnect_shm_transport = off;
+
+-- every segment receives from every segment
+SELECT count(*), sum(cnt) FROM (SELECT b, count(*) AS cnt FROM tcp_ic_many_senders GROUP BY b) s;
+
+-- the QD receives from every segment, and watches the dispatcher as well
+SELECT count(*), sum(length(b)) FROM (SELECT b FROM tcp_ic_many_senders LIMIT 100000) s;
+
+SELECT gp_inject_fault('interconnect_tcp_split_packet', 'reset', dbid)
+    FROM gp_segment_configuration WHERE role = 'p';
@@ -0,0 +1,34 @@
+-- Test the shared memory rings of same-host TCP interconnect connections
+-- (gp_interconnect_shm_transport). All segments of the test cluster run on
+-- one host, so every connection between two backends gets a ring.
+
+SET gp_interconnect_shm_transport = on;
+SET optimizer = off;
+SET gp_enable_multiphase_agg = off;
+
+-- rows up to a few kB, so that the rings wrap around and fill up
+CREATE TABLE tcp_ic_shm_ring(a int, b text) DISTRIBUTED BY (a);
+INSERT INTO tcp_ic_shm_ring SELECT i, repeat('x', i % 3000) FROM generate_series(1, 20000) i;
+
+-- every segment receives from every segment
+SELECT count(*), sum(cnt) FROM (SELECT b, count(*) AS cnt FROM tcp_ic_shm_ring GROUP BY b) s;
+
+-- the QD receives from any segment
+SELECT count(*), sum(length(b)) FROM (SELECT b FROM tcp_ic_shm_ring LIMIT 100000) s;
+
+-- the QD merges, receiving from one segment at a time
+SELECT sum(a) FROM (SELECT a FROM tcp_ic_shm_ring ORDER BY a) s;
+
+-- the receiver stops early, while senders may be waiting for ring space
+SELECT count(*) FROM (SELECT b FROM tcp_ic_shm_ring LIMIT 10) s;
+SELECT a, length(b) FROM tcp_ic_shm_ring ORDER BY a LIMIT 3;
+
+-- a sender fails while the others are still streaming
+BEGIN;
+SELECT count(*) FROM (SELECT b FROM tcp_ic_shm_ring WHERE 1 / (a - 15000) <> 7 LIMIT 100000) s;
+ABORT;
+
+-- the rings are torn down with the queries, and leave no names behind
+!\retcode test -z "$(ls /dev/shm | grep '^gpic\.')";
+
+SELECT count(*), sum(length(b)) FROM (SELECT b FROM tcp_ic_shm_ring LIMIT 100000) s;
@@ -3733,6 +3733,81 @@ UPDATE d SET с2 = 2 WHERE с1 = 1;
 DROP TABLE d;
 DROP FUNCTION trig_proc();
 
+-- The reduced search for simple single-table queries must pick the same
+-- plans as the full search.
+create table simple_fast_path (a int, b int, c text) distributed by (a);
+create index simple_fast_path_b on simple_fast_path (b);
+insert into simple_fast_path select i, i % 1000, i::text from generate_series(1, 10000) i;
+analyze simple_fast_path;
+create function simple_fast_path_same_plan(query text) returns bool as $$
+declare
+  fast_plan text := '';
+  full_plan text := '';
+  line text;
+begin
+  set optimizer_enable_simple_query_fast_path = on;
+  for line in execute 'explain ' || query loop
+    fast_plan := fast_plan || line || E'\n';
+  end loop;
+  set optimizer_enable_simple_query_fast_path = off;
+  for line in execute 'explain ' || query loop
+    full_plan := full_plan || line || E'\n';
+  end loop;
+  reset optimizer_enable_simple_query_fast_path;
+  return fast_plan = full_plan;
+end;
+$$ language plpgsql;
+select simple_fast_path_same_plan('select * from simple_fast_path where a = 42');
+select simple_fast_path_same_plan('select a, c from simple_fast_path where b = 7');
+select simple_fast_path_same_plan('select * from simple_fast_path where b = 7 or b = 9');
+select simple_fast_path_same_plan('select a from simple_fast_path where b between 10 and 20 order by b limit 5');
+select simple_fast_path_same_plan('select * from simple_fast_path where a in (1, 2, 3)');
+select simple_fast_path_same_plan('select c from simple_fast_path where c like ''12%'' order by a limit 10');
+drop function simple_fast_path_same_plan(text);
+drop table simple_fast_path;
+
+-- Constant arrays are translated in bulk, and their stats points sorted and
+-- de-duplicated once. The results must not depend on the order of the
+-- elements, duplicates or NULL elements, for IN lists, = ANY and <> ALL, and
+-- for lists too long to be expanded into disjunctions.
+create table const_array (a int, t text) distributed by (a);
+insert into const_array select i, 'v' || i from generate_series(1, 1000) i;
+insert into const_array values (null, null);
+analyze const_array;
+select count(*), sum(a) from const_array where a in (42, 7, 900, 7, 3, 42, 1000, 5000);
+select count(*), sum(a) from const_array where a in (42, null, 7, 7);
+select count(*), sum(a) from const_array where a not in (42, 7, 900, 7);
+select count(*), sum(a) from const_array where a not in (42, null, 7);
+select count(*), sum(a) from const_array where a = any (array[900, 3, 3, 42, null]);
+select count(*), sum(a) from const_array where a <> all (array[900, 3, 3, 42]);
+select count(*), sum(a) from const_array where a <> all (array[900, null, 3]);
+select count(*), sum(a) from const_array where a < any (array[5, 2, 5, null]);
+select count(*), sum(a) from const_array where a > all (array[995, 990, 995]);
+select t from const_array where t in ('v9', 'v10', 'v9', 'v1', 'x') order by t;
+select t from const_array where t = any (array['v20', null, 'v2', 'v20']) order by t;
+create function const_array_count(query text, nulls bool) returns text as $$
+declare
+  list text;
+  result text;
+begin
+  select string_agg(case when nulls and i % 97 = 0 then 'null'
+                         else ((i * 37) % 600)::text end, ', ')
+    into list from generate_series(1, 800) i;
+  execute format('select count(*) || '' '' || coalesce(sum(a), 0) from const_array where ' || query, list)
+    into result;
+  return result;
+end;
+$$ language plpgsql;
+select const_array_count('a in (%s)', false);
+select const_array_count('a in (%s)', true);
+select const_array_count('a not in (%s)', false);
+select const_array_count('a not in (%s)', true);
+select const_array_count('a = any (array[%s])', true);
+select const_array_count('a <> all (array[%s])', false);
+select const_array_count('a <> all (array[%s])', true);
+drop function const_array_count(text, bool);
+drop table const_array;
+
 reset optimizer_trace_fallback;
 
 -- start_ignore
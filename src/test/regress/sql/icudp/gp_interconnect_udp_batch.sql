@@ -0,0 +1,62 @@
+--
+-- Interconnect packet batching: sendmmsg()/recvmmsg() with various batch
+-- sizes, UDP_SEGMENT sends and UDP_GRO receives must all deliver the same
+-- rows as one packet per system call.
+--
+CREATE TABLE udp_batch_table(dkey INT, jkey INT, tval TEXT default 'abcdefghijklmnopqrstuvwxyz') DISTRIBUTED BY (dkey);
+INSERT INTO udp_batch_table SELECT i, i + 5000 FROM generate_series(1, 5000) i;
+
+-- One packet per system call
+SET gp_interconnect_udp_batch_size = 1;
+SHOW gp_interconnect_udp_batch_size;
+SELECT count(*), sum(length(a.tval)) FROM udp_batch_table a JOIN udp_batch_table b ON a.jkey = b.dkey + 5000;
+SELECT count(*), sum(length(foo.tval))
+  FROM (SELECT 5001 AS jkey, tval FROM udp_batch_table ORDER BY dkey LIMIT 3000) foo
+    JOIN udp_batch_table USING (jkey);
+
+-- Mid-size batch
+SET gp_interconnect_udp_batch_size = 32;
+SHOW gp_interconnect_udp_batch_size;
+SELECT count(*), sum(length(a.tval)) FROM udp_batch_table a JOIN udp_batch_table b ON a.jkey = b.dkey + 5000;
+SELECT count(*), sum(length(foo.tval))
+  FROM (SELECT 5001 AS jkey, tval FROM udp_batch_table ORDER BY dkey LIMIT 3000) foo
+    JOIN udp_batch_table USING (jkey);
+
+-- Largest batch size
+SET gp_interconnect_udp_batch_size = 64;
+SHOW gp_interconnect_udp_batch_size;
+SELECT count(*), sum(length(a.tval)) FROM udp_batch_table a JOIN udp_batch_table b ON a.jkey = b.dkey + 5000;
+SELECT count(*), sum(length(foo.tval))
+  FROM (SELECT 5001 AS jkey, tval FROM udp_batch_table ORDER BY dkey LIMIT 3000) foo
+    JOIN udp_batch_table USING (jkey);
+
+-- Segmentation offload on the sending side
+SET gp_interconnect_udp_gso = on;
+SHOW gp_interconnect_udp_gso;
+SELECT count(*), sum(length(a.tval)) FROM udp_batch_table a JOIN udp_batch_table b ON a.jkey = b.dkey + 5000;
+SELECT count(*), sum(length(foo.tval))
+  FROM (SELECT 5001 AS jkey, tval FROM udp_batch_table ORDER BY dkey LIMIT 3000) foo
+    JOIN udp_batch_table USING (jkey);
+
+-- Receive offload is set up with the interconnect socket, so it takes a
+-- configuration reload and new sessions. It is only turned on along with
+-- batching.
+-- start_ignore
+\! gpconfig -c gp_interconnect_udp_gro -v on
+\! gpconfig -c gp_interconnect_udp_batch_size -v 64
+\! gpstop -u
+-- end_ignore
+\c
+SELECT DISTINCT current_setting('gp_interconnect_udp_gro') FROM gp_dist_random('gp_id');
+SELECT count(*), sum(length(a.tval)) FROM udp_batch_table a JOIN udp_batch_table b ON a.jkey = b.dkey + 5000;
+SELECT count(*), sum(length(foo.tval))
+  FROM (SELECT 5001 AS jkey, tval FROM udp_batch_table ORDER BY dkey LIMIT 3000) foo
+    JOIN udp_batch_table USING (jkey);
+
+-- start_ignore
+\! gpconfig -r gp_interconnect_udp_gro
+\! gpconfig -r gp_interconnect_udp_batch_size
+\! gpstop -u
+-- end_ignore
+\c
+DROP TABLE udp_batch_table;
@@ -0,0 +1,83 @@
+--
+-- Motions that compress their tuples (gp_motion_compression)
+--
+CREATE TABLE motion_compress (a int, b int, t text) DISTRIBUTED BY (a);
+INSERT INTO motion_compress
+  SELECT i, i % 100, repeat('compressible ' || (i % 7), 20)
+  FROM generate_series(1, 20000) i;
+-- a few tuples larger than a chunk, that don't compress
+INSERT INTO motion_compress
+  SELECT i, i % 100, (SELECT string_agg(md5(i::text || j::text), '')
+                      FROM generate_series(1, 400) j)
+  FROM generate_series(20001, 20010) i;
+ANALYZE motion_compress;
+
+CREATE TABLE motion_compress_copy (a int, b int, t text) DISTRIBUTED BY (b);
+CREATE TABLE motion_compress_fixed (a int, b int) DISTRIBUTED BY (b);
+
+-- Returns true if EXPLAIN ANALYZE shows that a motion received compressed
+-- chunks.
+CREATE FUNCTION motion_compression_reported(query text) RETURNS bool AS $$
+DECLARE
+  line text;
+BEGIN
+  FOR line IN EXECUTE 'EXPLAIN (ANALYZE, VERBOSE) ' || query LOOP
+    IF line LIKE '%Motion compression:%' THEN
+      RETURN true;
+    END IF;
+  END LOOP;
+  RETURN false;
+END;
+$$ LANGUAGE plpgsql;
+
+SET gp_motion_compression = on;
+
+-- Redistribute all the rows, and check that they arrive intact. The batched
+-- send path stages serialized tuples, the unbatched one whole slots.
+INSERT INTO motion_compress_copy SELECT * FROM motion_compress;
+SELECT count(*), sum(length(t)) FROM motion_compress_copy;
+SELECT count(*) FROM (SELECT * FROM motion_compress
+                      EXCEPT ALL SELECT * FROM motion_compress_copy) x;
+TRUNCATE motion_compress_copy;
+
+SET gp_motion_send_batch_size = 64;
+INSERT INTO motion_compress_copy SELECT * FROM motion_compress;
+SELECT count(*) FROM (SELECT * FROM motion_compress
+                      EXCEPT ALL SELECT * FROM motion_compress_copy) x;
+TRUNCATE motion_compress_copy;
+RESET gp_motion_send_batch_size;
+
+-- Only full blocks, and blocks flushed after every 1 ms
+SET gp_motion_compression_max_delay = 0;
+INSERT INTO motion_compress_copy SELECT * FROM motion_compress;
+SELECT count(*) FROM (SELECT * FROM motion_compress
+                      EXCEPT ALL SELECT * FROM motion_compress_copy) x;
+TRUNCATE motion_compress_copy;
+SET gp_motion_compression_max_delay = 1;
+INSERT INTO motion_compress_copy SELECT * FROM motion_compress;
+SELECT count(*) FROM (SELECT * FROM motion_compress
+                      EXCEPT ALL SELECT * FROM motion_compress_copy) x;
+TRUNCATE motion_compress_copy;
+RESET gp_motion_compression_max_delay;
+
+-- Columnar batches go through the compression buffers too
+SET gp_motion_columnar = on;
+INSERT INTO motion_compress_fixed SELECT a, b FROM motion_compress;
+SELECT count(*), sum(a), sum(b) FROM motion_compress_fixed;
+RESET gp_motion_columnar;
+
+-- The receiving motion reports the compression in EXPLAIN ANALYZE
+SELECT motion_compression_reported(
+  'SELECT sum(r * length(t)) FROM (SELECT row_number() OVER (PARTITION BY b ORDER BY a) r, t FROM motion_compress) s');
+
+-- A cost factor for compressed motions doesn't change the results
+SET optimizer_motion_compression_factor = 0.5;
+SELECT b, count(*) FROM motion_compress GROUP BY b ORDER BY b LIMIT 3;
+RESET optimizer_motion_compression_factor;
+
+RESET gp_motion_compression;
+
+DROP FUNCTION motion_compression_reported(text);
+DROP TABLE motion_compress;
+DROP TABLE motion_compress_copy;
+DROP TABLE motion_compress_fixed;
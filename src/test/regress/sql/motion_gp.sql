@@ -98,3 +98,109 @@ $$) order by id;
 CREATE TABLE motion_noatts ();
 INSERT INTO motion_noatts SELECT;
 SELECT * FROM motion_noatts;
+
+-- Redistribute motions hash and send tuples in batches of
+-- gp_motion_send_batch_size. Check that every row lands on the same segment
+-- as when the tuples are sent one at a time, for the types with inline hash
+-- kernels, a type hashed through fmgr, and NULLs.
+CREATE TABLE motion_batch_src (i2 int2, i4 int4, i8 int8, d date, ts timestamp, t text, n numeric)
+  DISTRIBUTED RANDOMLY;
+INSERT INTO motion_batch_src
+  SELECT g, g * 7, g * 1000000007, '2000-01-01'::date + g,
+         '2000-01-01'::timestamp + g * interval '1 hour', 'row ' || g, g / 3.0
+  FROM generate_series(1, 1000) g;
+INSERT INTO motion_batch_src VALUES (NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+INSERT INTO motion_batch_src VALUES (-1, -7, -1000000007, '1999-12-31', '1999-12-31', repeat('x', 10000), -1);
+
+SET gp_motion_send_batch_size = 1;
+CREATE TABLE motion_batch_one AS SELECT * FROM motion_batch_src
+  DISTRIBUTED BY (i2, i4, i8, d, ts, t, n);
+SET gp_motion_send_batch_size = 7;
+CREATE TABLE motion_batch_many AS SELECT * FROM motion_batch_src
+  DISTRIBUTED BY (i2, i4, i8, d, ts, t, n);
+RESET gp_motion_send_batch_size;
+
+SELECT count(*) FROM motion_batch_many;
+SELECT count(*) FROM
+  (SELECT gp_segment_id, * FROM motion_batch_one
+   EXCEPT
+   SELECT gp_segment_id, * FROM motion_batch_many) d;
+
+-- Motions whose columns all have fixed-width types can send tuples in
+-- batches, column by column. Check redistributed and gathered tuples against
+-- the source, with NULLs and a pass-by-reference type.
+CREATE TABLE motion_columnar_src (b bool, c "char", i2 int2, i4 int4, i8 int8, f8 float8, ts timestamp, iv interval)
+  DISTRIBUTED RANDOMLY;
+INSERT INTO motion_columnar_src
+  SELECT g % 2 = 0, chr(65 + g % 26)::"char", g, g * 7, g * 1000000007, g / 3.0,
+         '2000-01-01'::timestamp + g * interval '1 hour', g * interval '1 minute'
+  FROM generate_series(1, 5000) g;
+INSERT INTO motion_columnar_src VALUES (NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+INSERT INTO motion_columnar_src
+  SELECT NULL, c, i2, NULL, i8, NULL, ts, NULL FROM motion_columnar_src WHERE i4 < 100;
+
+SET gp_motion_columnar = on;
+CREATE TABLE motion_columnar_dst AS SELECT * FROM motion_columnar_src
+  DISTRIBUTED BY (i4);
+SELECT count(*) FROM
+  (SELECT * FROM motion_columnar_src EXCEPT ALL SELECT * FROM motion_columnar_dst) d;
+SELECT count(*) FROM
+  (SELECT * FROM motion_columnar_dst EXCEPT ALL SELECT * FROM motion_columnar_src) d;
+SELECT count(*), count(b), count(i4), sum(i4), max(i8) FROM motion_columnar_dst;
+SELECT i4, i8, b, c FROM motion_columnar_dst ORDER BY i4 LIMIT 3;
+RESET gp_motion_columnar;
+
+-- A join that redistributes both inputs on a skewed key spreads the hot
+-- values of one input over all segments and broadcasts the matching rows of
+-- the other. Check that joins still find every match exactly once.
+CREATE TABLE motion_skew_a (id int, k int) DISTRIBUTED BY (id);
+CREATE TABLE motion_skew_b (id int, k int) DISTRIBUTED BY (id);
+INSERT INTO motion_skew_a
+  SELECT g, CASE WHEN g % 2 = 0 THEN 1 ELSE g END FROM generate_series(1, 10000) g;
+INSERT INTO motion_skew_a SELECT g, NULL FROM generate_series(10001, 12000) g;
+INSERT INTO motion_skew_b SELECT g, g % 100 FROM generate_series(1, 10000) g;
+ANALYZE motion_skew_a;
+ANALYZE motion_skew_b;
+
+SET gp_motion_skew_threshold = 0.1;
+SELECT count(*), count(b.id) FROM motion_skew_a a JOIN motion_skew_b b ON a.k = b.k;
+SELECT count(*), count(b.id) FROM motion_skew_a a LEFT JOIN motion_skew_b b ON a.k = b.k;
+SELECT count(*), count(a.id) FROM motion_skew_b b LEFT JOIN motion_skew_a a ON a.k = b.k;
+
+-- EXPLAIN shows the hot keys of both Motions, and EXPLAIN ANALYZE VERBOSE the
+-- rows that each segment received from a redistributing Motion. Which input
+-- ends up where in the plan, and the counts per segment, are up to the
+-- planner and the hash function, so only print those lines, sorted, and
+-- without the counts.
+create or replace function motion_skew_explain(sql text, do_analyze bool) returns setof text
+as $$
+declare
+  line text;
+begin
+  for line in EXECUTE 'EXPLAIN (ANALYZE ' || do_analyze || ', VERBOSE) ' || sql
+  loop
+    if line ~ '(Spread|Broadcast) Keys: ' then
+      RETURN NEXT btrim(line);
+    elsif line ~ 'Rows per segment: ' then
+      RETURN NEXT regexp_replace(btrim(line), '\d+ \(seg\d+\)', 'N (segN)', 'g');
+    end if;
+  end loop;
+end;
+$$ language plpgsql;
+
+-- GPORCA plans don't split hot keys
+SET optimizer = off;
+SELECT * FROM motion_skew_explain('SELECT count(*) FROM motion_skew_a a JOIN motion_skew_b b ON a.k = b.k', false) ORDER BY 1;
+SELECT * FROM motion_skew_explain('SELECT count(*) FROM motion_skew_a a JOIN motion_skew_b b ON a.k = b.k', true) ORDER BY 1;
+RESET optimizer;
+
+-- The senders check the hot keys in their first rows, and stop spreading
+-- those that the statistics got wrong. Key 1 is no longer hot after this
+-- update, but the statistics don't know until the next ANALYZE.
+UPDATE motion_skew_a SET k = id WHERE k = 1 AND id % 10 <> 0;
+SET gp_motion_skew_sample_rows = 100;
+SELECT count(*), count(b.id) FROM motion_skew_a a JOIN motion_skew_b b ON a.k = b.k;
+SELECT count(*), count(b.id) FROM motion_skew_a a LEFT JOIN motion_skew_b b ON a.k = b.k;
+SELECT count(*), count(a.id) FROM motion_skew_b b LEFT JOIN motion_skew_a a ON a.k = b.k;
+RESET gp_motion_skew_sample_rows;
+RESET gp_motion_skew_threshold;